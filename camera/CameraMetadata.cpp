@@ -129,7 +129,12 @@ void CameraMetadata::acquire(CameraMetadata &other) {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return;
     }
-    acquire(other.release());
+    // The buffer of another CameraMetadata has been validated when it was
+    // acquired or built, so skip the structure walk; every result frame is
+    // handed along this way several times.
+    camera_metadata_t *buffer = other.release();
+    clear();
+    mBuffer = buffer;
 }
 
 status_t CameraMetadata::append(const CameraMetadata &other) {
@@ -508,13 +513,16 @@ status_t CameraMetadata::writeToParcel(Parcel& data,
                 ALOGV("%s: Metadata written to blob. Validation success",
                         __FUNCTION__);
             }
-        }
 
-        // Not too big of a problem since receiving side does hard validation
-        // Don't check the size since the compact size could be larger
-        if (validate_camera_metadata_structure(metadata, /*size*/NULL) != OK) {
-            ALOGW("%s: Failed to validate metadata %p before writing blob",
-                   __FUNCTION__, metadata);
+            // Not too big of a problem since receiving side does hard
+            // validation, so only walk the source when logging; results go
+            // through here on every frame.
+            // Don't check the size since the compact size could be larger
+            if (validate_camera_metadata_structure(metadata,
+                        /*size*/NULL) != OK) {
+                ALOGW("%s: Failed to validate metadata %p before writing blob",
+                       __FUNCTION__, metadata);
+            }
         }
 
     } while(false);
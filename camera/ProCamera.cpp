@@ -101,20 +101,21 @@ void ProCamera::onResultReceived(int32_t requestId, camera_metadata* result) {
 
     CameraMetadata tmp(result);
 
-    // Unblock waitForFrame(id) callers
+    // Unblock waitForFrame(id) callers. Only copy the result when the
+    // listener takes ownership of it too.
     {
         Mutex::Autolock al(mWaitMutex);
         mMetadataReady = true;
-        mLatestMetadata = tmp; // make copy
+        if (listener != NULL) {
+            mLatestMetadata = tmp; // make copy
+        } else {
+            mLatestMetadata.acquire(tmp);
+        }
         mWaitCondition.broadcast();
     }
 
-    result = tmp.release();
-
     if (listener != NULL) {
-        listener->onResultReceived(requestId, result);
-    } else {
-        free_camera_metadata(result);
+        listener->onResultReceived(requestId, tmp.release());
     }
 
 }
@@ -19,7 +19,9 @@
 #include <utils/Log.h>
 
 #include <binder/IPCThreadState.h>
+#include <utils/Condition.h>
 #include <utils/Errors.h>
+#include <utils/Mutex.h>
 #include <utils/Thread.h>
 #include <utils/Timers.h>
 
@@ -30,6 +32,7 @@
 #include <media/openmax/OMX_IVCommon.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaCodec.h>
 #include <media/stagefright/MediaErrors.h>
@@ -61,6 +64,9 @@ static uint32_t gVideoWidth = 0;            // default width+height
 static uint32_t gVideoHeight = 0;
 static uint32_t gBitRate = 4000000;         // 4Mbps
 static uint32_t gTimeLimitSec = kMaxTimeLimitSec;
+static bool gRawOutput = false;             // raw H.264 instead of .mp4
+static bool gPipelined = false;             // asynchronous encoder output
+static bool gBench = false;                 // report frame stats at the end
 
 // Set by signal handler to stop recording.
 static bool gStopRequested;
@@ -69,6 +75,21 @@ static bool gStopRequested;
 static struct sigaction gOrigSigactionINT;
 static struct sigaction gOrigSigactionHUP;
 
+// Frame statistics for --bench.  The latencies are measured from the
+// frame's capture timestamp, to when the encoder hands the frame over,
+// and to when it has been written out.
+static struct {
+    uint32_t numEncoded;
+    uint32_t numLongIntervals;
+    int64_t frameIntervalUsec;
+    int64_t lastPtsUsec;
+    int64_t sumEncodeLatencyUsec;
+    int64_t maxEncodeLatencyUsec;
+    uint32_t numWritten;
+    int64_t sumWriteLatencyUsec;
+    int64_t maxWriteLatencyUsec;
+} gBenchStats;
+
 
 /*
  * Catch keyboard interrupt signals.  On receipt, the "stop requested"
@@ -117,6 +138,95 @@ static status_t configureSignals()
     return NO_ERROR;
 }
 
+/*
+ * Records that the encoder produced the frame captured at ptsUsec.  A gap
+ * of more than 1.5 display frame intervals since the previous frame is
+ * counted as a dropped frame; note that a static screen produces these
+ * as well, since SurfaceFlinger only sends frames that changed.
+ */
+static void benchFrameEncoded(int64_t ptsUsec) {
+    if (!gBench) {
+        return;
+    }
+
+    int64_t latencyUsec = systemTime(SYSTEM_TIME_MONOTONIC) / 1000 - ptsUsec;
+    gBenchStats.sumEncodeLatencyUsec += latencyUsec;
+    if (latencyUsec > gBenchStats.maxEncodeLatencyUsec) {
+        gBenchStats.maxEncodeLatencyUsec = latencyUsec;
+    }
+
+    if (gBenchStats.numEncoded > 0 && gBenchStats.frameIntervalUsec > 0
+            && ptsUsec - gBenchStats.lastPtsUsec
+                    > gBenchStats.frameIntervalUsec * 3 / 2) {
+        gBenchStats.numLongIntervals++;
+    }
+    gBenchStats.lastPtsUsec = ptsUsec;
+    gBenchStats.numEncoded++;
+}
+
+/*
+ * Records that the frame captured at ptsUsec has been written out.
+ */
+static void benchFrameWritten(int64_t ptsUsec) {
+    if (!gBench) {
+        return;
+    }
+
+    int64_t latencyUsec = systemTime(SYSTEM_TIME_MONOTONIC) / 1000 - ptsUsec;
+    gBenchStats.sumWriteLatencyUsec += latencyUsec;
+    if (latencyUsec > gBenchStats.maxWriteLatencyUsec) {
+        gBenchStats.maxWriteLatencyUsec = latencyUsec;
+    }
+    gBenchStats.numWritten++;
+}
+
+/*
+ * Prints the --bench results.
+ */
+static void printBenchStats(FILE* fp, int64_t elapsedNsec) {
+    double elapsedSec = elapsedNsec / 1000000000.0;
+
+    fprintf(fp, "Frames encoded:     %u (%.2f fps over %.2f s)\n",
+            gBenchStats.numEncoded,
+            elapsedSec > 0 ? gBenchStats.numEncoded / elapsedSec : 0.0,
+            elapsedSec);
+    fprintf(fp, "Frames dropped:     %u (intervals > 1.5 frames)\n",
+            gBenchStats.numLongIntervals);
+    if (gBenchStats.numEncoded > 0) {
+        fprintf(fp, "Encode latency:     avg %.2f ms, max %.2f ms\n",
+                gBenchStats.sumEncodeLatencyUsec
+                    / (gBenchStats.numEncoded * 1000.0),
+                gBenchStats.maxEncodeLatencyUsec / 1000.0);
+    }
+    if (gBenchStats.numWritten > 0) {
+        fprintf(fp, "End-to-end latency: avg %.2f ms, max %.2f ms\n",
+                gBenchStats.sumWriteLatencyUsec
+                    / (gBenchStats.numWritten * 1000.0),
+                gBenchStats.maxWriteLatencyUsec / 1000.0);
+    }
+}
+
+/*
+ * Writes a buffer of raw H.264 data to fd.
+ */
+static status_t writeRaw(int fd, const sp<ABuffer>& buffer) {
+    const uint8_t* data = buffer->data();
+    size_t size = buffer->size();
+
+    while (size > 0) {
+        ssize_t n = TEMP_FAILURE_RETRY(write(fd, data, size));
+        if (n < 0) {
+            status_t err = -errno;
+            fprintf(stderr, "Failed writing raw output: %s\n",
+                    strerror(errno));
+            return err;
+        }
+        data += n;
+        size -= n;
+    }
+    return NO_ERROR;
+}
+
 /*
  * Returns "true" if the device is rotated 90 degrees.
  */
@@ -129,7 +239,8 @@ static bool isDeviceRotated(int orientation) {
  * Configures and starts the MediaCodec encoder.  Obtains an input surface
  * from the codec.
  */
-static status_t prepareEncoder(float displayFps, sp<MediaCodec>* pCodec,
+static status_t prepareEncoder(float displayFps,
+        const sp<AMessage>& callback, sp<MediaCodec>* pCodec,
         sp<IGraphicBufferProducer>* pBufferProducer) {
     status_t err;
 
@@ -178,6 +289,18 @@ static status_t prepareEncoder(float displayFps, sp<MediaCodec>* pCodec,
         return err;
     }
 
+    if (callback != NULL) {
+        err = codec->setCallback(callback);
+        if (err != NO_ERROR) {
+            codec->release();
+            codec.clear();
+
+            fprintf(stderr, "ERROR: unable to set codec callback (err=%d)\n",
+                    err);
+            return err;
+        }
+    }
+
     ALOGV("Starting codec");
     err = codec->start();
     if (err != NO_ERROR) {
@@ -284,14 +407,14 @@ static status_t prepareVirtualDisplay(const DisplayInfo& mainDpyInfo,
 }
 
 /*
- * Runs the MediaCodec encoder, sending the output to the MediaMuxer.  The
- * input frames are coming from the virtual display as fast as SurfaceFlinger
- * wants to send them.
+ * Runs the MediaCodec encoder, sending the output to the MediaMuxer, or to
+ * rawFd if the muxer is NULL.  The input frames are coming from the virtual
+ * display as fast as SurfaceFlinger wants to send them.
  *
  * The muxer must *not* have been started before calling.
  */
 static status_t runEncoder(const sp<MediaCodec>& encoder,
-        const sp<MediaMuxer>& muxer) {
+        const sp<MediaMuxer>& muxer, int rawFd) {
     static int kTimeout = 250000;   // be responsive on signal
     status_t err;
     ssize_t trackIdx = -1;
@@ -330,32 +453,52 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
         case NO_ERROR:
             // got a buffer
             if ((flags & MediaCodec::BUFFER_FLAG_CODECCONFIG) != 0) {
-                // ignore this -- we passed the CSD into MediaMuxer when
-                // we got the format change notification
-                ALOGV("Got codec config buffer (%u bytes); ignoring", size);
+                if (muxer == NULL) {
+                    // the raw stream carries the SPS/PPS in-band
+                    err = writeRaw(rawFd, buffers[bufIndex]);
+                    if (err != NO_ERROR) {
+                        return err;
+                    }
+                } else {
+                    // ignore this -- we passed the CSD into MediaMuxer when
+                    // we got the format change notification
+                    ALOGV("Got codec config buffer (%u bytes); ignoring",
+                            size);
+                }
                 size = 0;
             }
             if (size != 0) {
                 ALOGV("Got data in buffer %d, size=%d, pts=%lld",
                         bufIndex, size, ptsUsec);
-                CHECK(trackIdx != -1);
 
                 // If the virtual display isn't providing us with timestamps,
                 // use the current time.
                 if (ptsUsec == 0) {
                     ptsUsec = systemTime(SYSTEM_TIME_MONOTONIC) / 1000;
                 }
-
-                // The MediaMuxer docs are unclear, but it appears that we
-                // need to pass either the full set of BufferInfo flags, or
-                // (flags & BUFFER_FLAG_SYNCFRAME).
-                err = muxer->writeSampleData(buffers[bufIndex], trackIdx,
-                        ptsUsec, flags);
-                if (err != NO_ERROR) {
-                    fprintf(stderr, "Failed writing data to muxer (err=%d)\n",
-                            err);
-                    return err;
+                benchFrameEncoded(ptsUsec);
+
+                if (muxer == NULL) {
+                    err = writeRaw(rawFd, buffers[bufIndex]);
+                    if (err != NO_ERROR) {
+                        return err;
+                    }
+                } else {
+                    CHECK(trackIdx != -1);
+
+                    // The MediaMuxer docs are unclear, but it appears that
+                    // we need to pass either the full set of BufferInfo
+                    // flags, or (flags & BUFFER_FLAG_SYNCFRAME).
+                    err = muxer->writeSampleData(buffers[bufIndex], trackIdx,
+                            ptsUsec, flags);
+                    if (err != NO_ERROR) {
+                        fprintf(stderr,
+                                "Failed writing data to muxer (err=%d)\n",
+                                err);
+                        return err;
+                    }
                 }
+                benchFrameWritten(ptsUsec);
                 debugNumFrames++;
             }
             err = encoder->releaseOutputBuffer(bufIndex);
@@ -374,7 +517,7 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
             ALOGV("Got -EAGAIN, looping");
             break;
         case INFO_FORMAT_CHANGED:           // INFO_OUTPUT_FORMAT_CHANGED
-            {
+            if (muxer != NULL) {
                 // format includes CSD, which we must provide to muxer
                 ALOGV("Encoder format changed");
                 sp<AMessage> newFormat;
@@ -417,13 +560,267 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
     return NO_ERROR;
 }
 
+/*
+ * Receives the encoder output in pipelined mode.  The encoder posts its
+ * output through the codec callback; each buffer goes to the muxer's
+ * per-track queue with writeSampleDataAsync() (or straight to the raw
+ * output) and is released back to the encoder once it has been written,
+ * so nothing is copied and the encoder never waits on the file.
+ *
+ * The looper must not be started until setOutput() has been called.
+ */
+class EncoderOutput : public AHandler {
+public:
+    enum {
+        kWhatCodecNotify,
+        kWhatSampleWritten,
+        kWhatSync,
+    };
+
+    EncoderOutput() : mRawFd(-1), mTrackIdx(-1), mStopping(false),
+            mDone(false), mErr(NO_ERROR), mNumFrames(0) {}
+
+    void setOutput(const sp<MediaCodec>& encoder,
+            const sp<MediaMuxer>& muxer, int rawFd) {
+        mEncoder = encoder;
+        mMuxer = muxer;
+        mRawFd = rawFd;
+    }
+
+    /*
+     * Blocks until a stop is requested, endWhenNsec is reached, the
+     * encoder signals EOS, or something fails.  Output arriving afterwards
+     * is released unwritten.
+     */
+    status_t waitUntilDone(int64_t endWhenNsec) {
+        Mutex::Autolock _l(mLock);
+        while (!gStopRequested && !mDone && mErr == NO_ERROR) {
+            if (systemTime(CLOCK_MONOTONIC) > endWhenNsec) {
+                if (gVerbose) {
+                    printf("Time limit reached\n");
+                }
+                break;
+            }
+            mCond.waitRelative(mLock, 250000000LL);   // be responsive on signal
+        }
+        mStopping = true;
+        return mErr;
+    }
+
+    uint32_t getNumFrames() {
+        Mutex::Autolock _l(mLock);
+        return mNumFrames;
+    }
+
+    /*
+     * Waits for the looper to finish the output it is handling.  Call
+     * after waitUntilDone(): no writeSampleDataAsync() call is in progress
+     * or will be made once this returns, so the muxer can be stopped.
+     */
+    void sync() {
+        sp<AMessage> response;
+        (new AMessage(kWhatSync, id()))->postAndAwaitResponse(&response);
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage>& msg) {
+        switch (msg->what()) {
+        case kWhatCodecNotify:
+            onCodecNotify(msg);
+            break;
+        case kWhatSampleWritten:
+            {
+                size_t bufIndex;
+                int64_t ptsUsec;
+                CHECK(msg->findSize("index", &bufIndex));
+                CHECK(msg->findInt64("ptsUsec", &ptsUsec));
+
+                benchFrameWritten(ptsUsec);
+                mEncoder->releaseOutputBuffer(bufIndex);
+            }
+            break;
+        case kWhatSync:
+            {
+                uint32_t replyID;
+                CHECK(msg->senderAwaitsResponse(&replyID));
+                (new AMessage)->postReply(replyID);
+            }
+            break;
+        default:
+            TRESPASS();
+        }
+    }
+
+private:
+    sp<MediaCodec> mEncoder;
+    sp<MediaMuxer> mMuxer;
+    int mRawFd;
+    Vector<sp<ABuffer> > mBuffers;
+    ssize_t mTrackIdx;
+
+    Mutex mLock;
+    Condition mCond;
+    bool mStopping;
+    bool mDone;
+    status_t mErr;
+    uint32_t mNumFrames;
+
+    void fail(const char* what, status_t err) {
+        fprintf(stderr, "%s (err=%d)\n", what, err);
+
+        Mutex::Autolock _l(mLock);
+        if (mErr == NO_ERROR) {
+            mErr = err;
+        }
+        mCond.signal();
+    }
+
+    bool isStopping() {
+        Mutex::Autolock _l(mLock);
+        return mStopping || mErr != NO_ERROR;
+    }
+
+    void onCodecNotify(const sp<AMessage>& msg) {
+        int32_t callbackID;
+        CHECK(msg->findInt32("callbackID", &callbackID));
+
+        switch (callbackID) {
+        case MediaCodec::CB_OUTPUT_AVAILABLE:
+            onOutputAvailable(msg);
+            break;
+        case MediaCodec::CB_OUTPUT_FORMAT_CHANGED:
+            if (mMuxer != NULL && mTrackIdx < 0) {
+                // format includes CSD, which we must provide to muxer
+                ALOGV("Encoder format changed");
+                sp<AMessage> newFormat;
+                CHECK(msg->findMessage("format", &newFormat));
+                mTrackIdx = mMuxer->addTrack(newFormat);
+                ALOGV("Starting muxer");
+                status_t err = mMuxer->start();
+                if (err != NO_ERROR) {
+                    fail("Unable to start muxer", err);
+                }
+            }
+            break;
+        case MediaCodec::CB_OUTPUT_BUFFERS_CHANGED:
+            // not expected for an encoder; handle it anyway
+            ALOGV("Encoder buffers changed");
+            mBuffers.clear();
+            break;
+        case MediaCodec::CB_ERROR:
+            {
+                int32_t err;
+                CHECK(msg->findInt32("err", &err));
+                fail("Encoder failed", err);
+            }
+            break;
+        default:
+            // CB_INPUT_AVAILABLE; the input comes from the surface
+            break;
+        }
+    }
+
+    void onOutputAvailable(const sp<AMessage>& msg) {
+        size_t bufIndex, size;
+        int64_t ptsUsec;
+        int32_t flags;
+        CHECK(msg->findSize("index", &bufIndex));
+        CHECK(msg->findSize("size", &size));
+        CHECK(msg->findInt64("timeUs", &ptsUsec));
+        CHECK(msg->findInt32("flags", &flags));
+
+        if ((flags & MediaCodec::BUFFER_FLAG_EOS) != 0) {
+            // Not expecting EOS from SurfaceFlinger.  Go with it.
+            ALOGD("Received end-of-stream");
+            Mutex::Autolock _l(mLock);
+            mDone = true;
+            mCond.signal();
+        }
+
+        if (mBuffers.isEmpty()) {
+            status_t err = mEncoder->getOutputBuffers(&mBuffers);
+            if (err != NO_ERROR) {
+                fail("Unable to get output buffers", err);
+                return;
+            }
+        }
+
+        const sp<ABuffer>& buffer = mBuffers[bufIndex];
+
+        bool isConfig = (flags & MediaCodec::BUFFER_FLAG_CODECCONFIG) != 0;
+        if (isStopping() || size == 0 || (isConfig && mMuxer != NULL)) {
+            // the muxer got the CSD with the format change notification
+            mEncoder->releaseOutputBuffer(bufIndex);
+            return;
+        }
+
+        // If the virtual display isn't providing us with timestamps,
+        // use the current time.
+        if (ptsUsec == 0) {
+            ptsUsec = systemTime(SYSTEM_TIME_MONOTONIC) / 1000;
+        }
+        if (!isConfig) {
+            benchFrameEncoded(ptsUsec);
+
+            Mutex::Autolock _l(mLock);
+            mNumFrames++;
+        }
+
+        if (mMuxer == NULL) {
+            status_t err = writeRaw(mRawFd, buffer);
+            if (err != NO_ERROR) {
+                fail("Raw output failed", err);
+            } else if (!isConfig) {
+                benchFrameWritten(ptsUsec);
+            }
+            mEncoder->releaseOutputBuffer(bufIndex);
+            return;
+        }
+
+        CHECK(mTrackIdx >= 0);
+
+        sp<AMessage> notify = new AMessage(kWhatSampleWritten, id());
+        notify->setSize("index", bufIndex);
+        notify->setInt64("ptsUsec", ptsUsec);
+
+        status_t err = mMuxer->writeSampleDataAsync(buffer, mTrackIdx,
+                ptsUsec, flags, notify);
+        if (err != NO_ERROR) {
+            fail("Failed writing data to muxer", err);
+            mEncoder->releaseOutputBuffer(bufIndex);
+        }
+    }
+};
+
+/*
+ * Pipelined counterpart of runEncoder(): the output is handled on the
+ * EncoderOutput's looper, this just waits for the recording to end.
+ */
+static status_t runPipelinedEncoder(const sp<EncoderOutput>& output) {
+    int64_t startWhenNsec = systemTime(CLOCK_MONOTONIC);
+    int64_t endWhenNsec = startWhenNsec + seconds_to_nanoseconds(gTimeLimitSec);
+
+    // This is set by the signal handler.
+    gStopRequested = false;
+
+    status_t err = output->waitUntilDone(endWhenNsec);
+
+    ALOGV("Encoder stopping (req=%d)", gStopRequested);
+    if (gVerbose) {
+        printf("Encoder stopping; recorded %u frames in %lld seconds\n",
+                output->getNumFrames(),
+                nanoseconds_to_seconds(systemTime(CLOCK_MONOTONIC) - startWhenNsec));
+    }
+    return err;
+}
+
 /*
  * Main "do work" method.
  *
- * Configures codec, muxer, and virtual display, then starts moving bits
- * around.
+ * Configures codec, muxer (unless the output is raw, to rawFd), and
+ * virtual display, then starts moving bits around.
  */
-static status_t recordScreen(const char* fileName) {
+static status_t recordScreen(const char* fileName, int rawFd) {
     status_t err;
 
     // Configure signal handler.
@@ -458,10 +855,23 @@ static status_t recordScreen(const char* fileName) {
         gVideoHeight = rotated ? mainDpyInfo.w : mainDpyInfo.h;
     }
 
+    // In pipelined mode the encoder output is delivered to its own looper,
+    // which is started once everything is in place.
+    sp<ALooper> outputLooper;
+    sp<EncoderOutput> output;
+    sp<AMessage> callback;
+    if (gPipelined) {
+        outputLooper = new ALooper;
+        outputLooper->setName("screenrecord_output");
+        output = new EncoderOutput;
+        outputLooper->registerHandler(output);
+        callback = new AMessage(EncoderOutput::kWhatCodecNotify, output->id());
+    }
+
     // Configure and start the encoder.
     sp<MediaCodec> encoder;
     sp<IGraphicBufferProducer> bufferProducer;
-    err = prepareEncoder(mainDpyInfo.fps, &encoder, &bufferProducer);
+    err = prepareEncoder(mainDpyInfo.fps, callback, &encoder, &bufferProducer);
 
     if (err != NO_ERROR && !gSizeSpecified) {
         // fallback is defined for landscape; swap if we're in portrait
@@ -474,7 +884,8 @@ static status_t recordScreen(const char* fileName) {
                     gVideoWidth, gVideoHeight, newWidth, newHeight);
             gVideoWidth = newWidth;
             gVideoHeight = newHeight;
-            err = prepareEncoder(mainDpyInfo.fps, &encoder, &bufferProducer);
+            err = prepareEncoder(mainDpyInfo.fps, callback, &encoder,
+                    &bufferProducer);
         }
     }
     if (err != NO_ERROR) {
@@ -492,15 +903,32 @@ static status_t recordScreen(const char* fileName) {
     }
 
     // Configure, but do not start, muxer.
-    sp<MediaMuxer> muxer = new MediaMuxer(fileName,
-            MediaMuxer::OUTPUT_FORMAT_MPEG_4);
-    if (gRotate) {
-        muxer->setOrientationHint(90);
+    sp<MediaMuxer> muxer;
+    if (!gRawOutput) {
+        muxer = new MediaMuxer(fileName, MediaMuxer::OUTPUT_FORMAT_MPEG_4);
+        if (gRotate) {
+            muxer->setOrientationHint(90);
+        }
+    }
+
+    memset(&gBenchStats, 0, sizeof(gBenchStats));
+    if (mainDpyInfo.fps > 0) {
+        gBenchStats.frameIntervalUsec = (int64_t)(1000000 / mainDpyInfo.fps);
     }
+    int64_t startWhenNsec = systemTime(CLOCK_MONOTONIC);
 
     // Main encoder loop.
-    err = runEncoder(encoder, muxer);
+    if (gPipelined) {
+        output->setOutput(encoder, muxer, rawFd);
+        outputLooper->start();
+        err = runPipelinedEncoder(output);
+    } else {
+        err = runEncoder(encoder, muxer, rawFd);
+    }
     if (err != NO_ERROR) {
+        if (outputLooper != NULL) {
+            outputLooper->stop();
+        }
         encoder->release();
         encoder.clear();
 
@@ -515,10 +943,29 @@ static status_t recordScreen(const char* fileName) {
     bufferProducer = NULL;
     SurfaceComposerClient::destroyDisplay(dpy);
 
-    encoder->stop();
-    muxer->stop();
+    if (gPipelined) {
+        // The muxer still holds on to encoder buffers until it has written
+        // them, so it goes first, once the output looper is no longer
+        // feeding it.
+        if (muxer != NULL) {
+            output->sync();
+            muxer->stop();
+        }
+        encoder->stop();
+        outputLooper->stop();
+    } else {
+        encoder->stop();
+        if (muxer != NULL) {
+            muxer->stop();
+        }
+    }
     encoder->release();
 
+    if (gBench) {
+        printBenchStats(rawFd == STDOUT_FILENO ? stderr : stdout,
+                systemTime(CLOCK_MONOTONIC) - startWhenNsec);
+    }
+
     return 0;
 }
 
@@ -617,7 +1064,7 @@ static void usage() {
     fprintf(stderr,
         "Usage: screenrecord [options] <filename>\n"
         "\n"
-        "Records the device's display to a .mp4 file.\n"
+        "Records the device's display to a .mp4 file, or a raw H.264 stream.\n"
         "\n"
         "Options:\n"
         "--size WIDTHxHEIGHT\n"
@@ -630,6 +1077,15 @@ static void usage() {
         "    Set the maximum recording time, in seconds.  Default / maximum is %d.\n"
         "--rotate\n"
         "    Rotate the output 90 degrees.\n"
+        "--output-format FORMAT\n"
+        "    \"mp4\" (the default) or \"h264\" for a raw H.264 elementary stream.\n"
+        "    With h264 the filename may be \"-\" to write to stdout, e.g. a pipe.\n"
+        "--pipelined\n"
+        "    Take the encoder output asynchronously and hand it to the muxer\n"
+        "    without waiting for it to be written.\n"
+        "--bench\n"
+        "    At the end, report the frames encoded and dropped, and the latency\n"
+        "    from capture to encoded and to written.\n"
         "--verbose\n"
         "    Display interesting information on stdout.\n"
         "--help\n"
@@ -652,6 +1108,9 @@ int main(int argc, char* const argv[]) {
         { "bit-rate",   required_argument,  NULL, 'b' },
         { "time-limit", required_argument,  NULL, 't' },
         { "rotate",     no_argument,        NULL, 'r' },
+        { "output-format", required_argument, NULL, 'o' },
+        { "pipelined",  no_argument,        NULL, 'p' },
+        { "bench",      no_argument,        NULL, 'B' },
         { NULL,         0,                  NULL, 0 }
     };
 
@@ -704,6 +1163,22 @@ int main(int argc, char* const argv[]) {
         case 'r':
             gRotate = true;
             break;
+        case 'o':
+            if (strcmp(optarg, "mp4") == 0) {
+                gRawOutput = false;
+            } else if (strcmp(optarg, "h264") == 0) {
+                gRawOutput = true;
+            } else {
+                fprintf(stderr, "Unknown output format '%s'\n", optarg);
+                return 2;
+            }
+            break;
+        case 'p':
+            gPipelined = true;
+            break;
+        case 'B':
+            gBench = true;
+            break;
         default:
             if (ic != '?') {
                 fprintf(stderr, "getopt_long returned unexpected value 0x%x\n", ic);
@@ -717,20 +1192,44 @@ int main(int argc, char* const argv[]) {
         return 2;
     }
 
-    // MediaMuxer tries to create the file in the constructor, but we don't
-    // learn about the failure until muxer.start(), which returns a generic
-    // error code without logging anything.  We attempt to create the file
-    // now for better diagnostics.
     const char* fileName = argv[optind];
-    int fd = open(fileName, O_CREAT | O_RDWR, 0644);
-    if (fd < 0) {
-        fprintf(stderr, "Unable to open '%s': %s\n", fileName, strerror(errno));
-        return 1;
+    int rawFd = -1;
+    if (gRawOutput) {
+        if (strcmp(fileName, "-") == 0) {
+            if (gVerbose) {
+                fprintf(stderr, "--verbose can't be used when writing to stdout\n");
+                return 2;
+            }
+            rawFd = STDOUT_FILENO;
+        } else {
+            rawFd = open(fileName, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+            if (rawFd < 0) {
+                fprintf(stderr, "Unable to open '%s': %s\n", fileName,
+                        strerror(errno));
+                return 1;
+            }
+        }
+        // A pipe reader going away shows up as EPIPE from write().
+        signal(SIGPIPE, SIG_IGN);
+    } else {
+        // MediaMuxer tries to create the file in the constructor, but we
+        // don't learn about the failure until muxer.start(), which returns
+        // a generic error code without logging anything.  We attempt to
+        // create the file now for better diagnostics.
+        int fd = open(fileName, O_CREAT | O_RDWR, 0644);
+        if (fd < 0) {
+            fprintf(stderr, "Unable to open '%s': %s\n", fileName,
+                    strerror(errno));
+            return 1;
+        }
+        close(fd);
     }
-    close(fd);
 
-    status_t err = recordScreen(fileName);
-    if (err == NO_ERROR) {
+    status_t err = recordScreen(fileName, rawFd);
+    if (gRawOutput && rawFd != STDOUT_FILENO) {
+        close(rawFd);
+    }
+    if (err == NO_ERROR && !gRawOutput) {
         // Try to notify the media scanner.  Not fatal if this fails.
         notifyMediaScanner(fileName);
     }
@@ -18,6 +18,8 @@
 #define LOG_TAG "stagefright"
 #include <media/stagefright/foundation/ADebug.h>
 
+#include <pthread.h>
+#include <sys/resource.h>
 #include <sys/time.h>
 
 #include <stdlib.h>
@@ -67,6 +69,16 @@ static bool gWriteMP4;
 static bool gDisplayHistogram;
 static String8 gWriteMP4Filename;
 
+enum BenchmarkMode {
+    BENCHMARK_NONE,
+    BENCHMARK_EXTRACT,  // read compressed buffers from the extractor only
+    BENCHMARK_DECODE,   // decode and drop the output
+    BENCHMARK_RENDER,   // decode and queue the output to gSurface
+};
+
+static BenchmarkMode gBenchmarkMode;
+static long gNumBenchmarkInstances;
+
 static sp<ANativeWindow> gSurface;
 
 static int64_t getNowUs() {
@@ -394,6 +406,303 @@ static void playSource(OMXClient *client, sp<MediaSource> &source) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+struct BenchmarkRun {
+    const char *mFilename;
+    bool mAudioOnly;
+    OMXClient *mClient;
+
+    status_t mStatus;
+    String8 mComponentName;
+    int64_t mNumFrames;
+    int64_t mNumBytes;
+    int64_t mElapsedUs;
+    Vector<int64_t> mReadTimesUs;
+};
+
+static const char *benchmarkModeName(BenchmarkMode mode) {
+    switch (mode) {
+        case BENCHMARK_EXTRACT: return "extract";
+        case BENCHMARK_DECODE:  return "decode";
+        case BENCHMARK_RENDER:  return "render";
+        default:                return "none";
+    }
+}
+
+static int64_t getCPUTimeUs() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ll
+        + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static long getMaxRSSKB() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss;
+}
+
+static sp<MediaSource> createBenchmarkTrack(
+        const char *filename, bool audioOnly) {
+    sp<DataSource> dataSource = DataSource::CreateFromURI(filename);
+
+    if (dataSource == NULL) {
+        return NULL;
+    }
+
+    sp<MediaExtractor> extractor = MediaExtractor::Create(dataSource);
+
+    if (extractor == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        sp<MetaData> meta = extractor->getTrackMetaData(i);
+
+        const char *mime;
+        if (meta == NULL || !meta->findCString(kKeyMIMEType, &mime)) {
+            continue;
+        }
+
+        if (!strncasecmp(mime, audioOnly ? "audio/" : "video/", 6)) {
+            return extractor->getTrack(i);
+        }
+    }
+
+    return NULL;
+}
+
+static void runBenchmark(BenchmarkRun *run) {
+    sp<MediaSource> source =
+        createBenchmarkTrack(run->mFilename, run->mAudioOnly);
+
+    if (source == NULL) {
+        run->mStatus = ERROR_UNSUPPORTED;
+        return;
+    }
+
+    const char *mime;
+    CHECK(source->getFormat()->findCString(kKeyMIMEType, &mime));
+
+    if (gBenchmarkMode != BENCHMARK_EXTRACT
+            && strcasecmp(MEDIA_MIMETYPE_AUDIO_RAW, mime)) {
+        int flags = 0;
+        if (gPreferSoftwareCodec) {
+            flags |= OMXCodec::kPreferSoftwareCodecs;
+        }
+        if (gForceToUseHardwareCodec) {
+            flags |= OMXCodec::kHardwareCodecsOnly;
+        }
+
+        sp<MediaSource> decoder = OMXCodec::Create(
+                run->mClient->interface(), source->getFormat(),
+                false /* createEncoder */, source,
+                NULL /* matchComponentName */,
+                flags,
+                gBenchmarkMode == BENCHMARK_RENDER ? gSurface : NULL);
+
+        if (decoder == NULL) {
+            run->mStatus = ERROR_UNSUPPORTED;
+            return;
+        }
+
+        source = decoder;
+    }
+
+    status_t err = source->start();
+
+    if (err != OK) {
+        run->mStatus = err;
+        return;
+    }
+
+    const char *componentName;
+    if (source->getFormat()->findCString(
+                kKeyDecoderComponent, &componentName)) {
+        run->mComponentName.setTo(componentName);
+    }
+
+    int64_t startUs = getNowUs();
+
+    MediaSource::ReadOptions options;
+    for (long i = 0; i < gNumRepetitions; ++i) {
+        long numFrames = 0;
+
+        for (;;) {
+            MediaBuffer *buffer;
+
+            int64_t readStartUs = getNowUs();
+            err = source->read(&buffer, &options);
+            int64_t readUs = getNowUs() - readStartUs;
+
+            options.clearSeekTo();
+
+            if (err == INFO_FORMAT_CHANGED) {
+                continue;
+            } else if (err != OK) {
+                break;
+            }
+
+            if (buffer->range_length() > 0) {
+                run->mReadTimesUs.push(readUs);
+                ++run->mNumFrames;
+                run->mNumBytes += buffer->range_length();
+            }
+
+            if (gBenchmarkMode == BENCHMARK_RENDER
+                    && buffer->graphicBuffer() != NULL) {
+                int64_t timeUs;
+                CHECK(buffer->meta_data()->findInt64(kKeyTime, &timeUs));
+
+                native_window_set_buffers_timestamp(
+                        gSurface.get(), timeUs * 1000);
+
+                if (gSurface->queueBuffer(
+                            gSurface.get(),
+                            buffer->graphicBuffer().get(), -1) == OK) {
+                    buffer->meta_data()->setInt32(kKeyRendered, 1);
+                }
+            }
+
+            buffer->release();
+            buffer = NULL;
+
+            if (gMaxNumFrames > 0 && ++numFrames == gMaxNumFrames) {
+                break;
+            }
+        }
+
+        if (err != OK && err != ERROR_END_OF_STREAM) {
+            run->mStatus = err;
+            break;
+        }
+
+        options.setSeekTo(0);
+    }
+
+    run->mElapsedUs = getNowUs() - startUs;
+
+    source->stop();
+}
+
+static void *benchmarkThread(void *me) {
+    runBenchmark(static_cast<BenchmarkRun *>(me));
+
+    return NULL;
+}
+
+// Expects "sorted" in increasing order.
+static int64_t percentile(const Vector<int64_t> &sorted, size_t pct) {
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+
+    size_t index = sorted.size() * pct / 100;
+    if (index >= sorted.size()) {
+        index = sorted.size() - 1;
+    }
+
+    return sorted.itemAt(index);
+}
+
+static void printJSONString(const char *s) {
+    putchar('"');
+    for (; *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') {
+            putchar('\\');
+        }
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+// Runs gNumBenchmarkInstances concurrent instances of the selected track
+// of "filename" and prints one JSON object per instance followed by one
+// for the aggregate. CPU time and memory high-water only cover this
+// process, OMX components hosted by mediaserver are not accounted for.
+static void benchmarkFile(
+        OMXClient *client, const char *filename, bool audioOnly) {
+    size_t numInstances = gNumBenchmarkInstances;
+
+    BenchmarkRun *runs = new BenchmarkRun[numInstances];
+    pthread_t *threads = new pthread_t[numInstances];
+
+    int64_t startUs = getNowUs();
+    int64_t startCPUUs = getCPUTimeUs();
+
+    for (size_t i = 0; i < numInstances; ++i) {
+        BenchmarkRun *run = &runs[i];
+        run->mFilename = filename;
+        run->mAudioOnly = audioOnly;
+        run->mClient = client;
+        run->mStatus = OK;
+        run->mNumFrames = 0;
+        run->mNumBytes = 0;
+        run->mElapsedUs = 0;
+
+        CHECK_EQ(pthread_create(&threads[i], NULL, benchmarkThread, run), 0);
+    }
+
+    for (size_t i = 0; i < numInstances; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    int64_t elapsedUs = getNowUs() - startUs;
+    int64_t cpuUs = getCPUTimeUs() - startCPUUs;
+
+    int64_t totalFrames = 0;
+    int64_t totalBytes = 0;
+    status_t status = OK;
+    for (size_t i = 0; i < numInstances; ++i) {
+        BenchmarkRun *run = &runs[i];
+        run->mReadTimesUs.sort(CompareIncreasing);
+
+        printf("{\"file\": ");
+        printJSONString(filename);
+        printf(", \"mode\": \"%s\", \"instance\": %d, \"component\": ",
+               benchmarkModeName(gBenchmarkMode), i);
+        printJSONString(run->mComponentName.string());
+        printf(", \"status\": %d, \"frames\": %lld, \"bytes\": %lld, "
+               "\"elapsed_us\": %lld, \"fps\": %.2f, "
+               "\"latency_us\": {\"p50\": %lld, \"p90\": %lld, "
+               "\"p99\": %lld, \"max\": %lld}}\n",
+               run->mStatus, run->mNumFrames, run->mNumBytes,
+               run->mElapsedUs,
+               run->mElapsedUs > 0
+                    ? run->mNumFrames * 1E6 / run->mElapsedUs : 0.0,
+               percentile(run->mReadTimesUs, 50),
+               percentile(run->mReadTimesUs, 90),
+               percentile(run->mReadTimesUs, 99),
+               percentile(run->mReadTimesUs, 100));
+
+        totalFrames += run->mNumFrames;
+        totalBytes += run->mNumBytes;
+        if (run->mStatus != OK) {
+            status = run->mStatus;
+        }
+    }
+
+    printf("{\"file\": ");
+    printJSONString(filename);
+    printf(", \"mode\": \"%s\", \"instances\": %d, \"status\": %d, "
+           "\"frames\": %lld, \"bytes\": %lld, \"elapsed_us\": %lld, "
+           "\"fps\": %.2f, \"cpu_us\": %lld, \"max_rss_kb\": %ld}\n",
+           benchmarkModeName(gBenchmarkMode), numInstances, status,
+           totalFrames, totalBytes, elapsedUs,
+           elapsedUs > 0 ? totalFrames * 1E6 / elapsedUs : 0.0,
+           cpuUs, getMaxRSSKB());
+    fflush(stdout);
+
+    delete[] threads;
+    threads = NULL;
+
+    delete[] runs;
+    runs = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 struct DetectSyncSource : public MediaSource {
     DetectSyncSource(const sp<MediaSource> &source);
 
@@ -608,6 +917,9 @@ static void usage(const char *me) {
     fprintf(stderr, "       -T allocate buffers from a surface texture\n");
     fprintf(stderr, "       -d(ump) output_filename (raw stream data to a file)\n");
     fprintf(stderr, "       -D(ump) output_filename (decoded PCM data to a file)\n");
+    fprintf(stderr, "       -B(enchmark) extract|decode|render, print JSON "
+                    "throughput and latency stats per file\n");
+    fprintf(stderr, "       -j number of concurrent benchmark instances\n");
 }
 
 static void dumpCodecProfiles(const sp<IOMX>& omx, bool queryDecoders) {
@@ -675,11 +987,13 @@ int main(int argc, char **argv) {
     gPlaybackAudio = false;
     gWriteMP4 = false;
     gDisplayHistogram = false;
+    gBenchmarkMode = BENCHMARK_NONE;
+    gNumBenchmarkInstances = 1;
 
     sp<ALooper> looper;
 
     int res;
-    while ((res = getopt(argc, argv, "han:lm:b:ptsrow:kxSTd:D:")) >= 0) {
+    while ((res = getopt(argc, argv, "han:lm:b:ptsrow:kxSTd:D:B:j:")) >= 0) {
         switch (res) {
             case 'a':
             {
@@ -708,9 +1022,25 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'B':
+            {
+                if (!strcasecmp(optarg, "extract")) {
+                    gBenchmarkMode = BENCHMARK_EXTRACT;
+                } else if (!strcasecmp(optarg, "decode")) {
+                    gBenchmarkMode = BENCHMARK_DECODE;
+                } else if (!strcasecmp(optarg, "render")) {
+                    gBenchmarkMode = BENCHMARK_RENDER;
+                } else {
+                    usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            }
+
             case 'm':
             case 'n':
             case 'b':
+            case 'j':
             {
                 char *end;
                 long x = strtol(optarg, &end, 10);
@@ -723,6 +1053,8 @@ int main(int argc, char **argv) {
                     gNumRepetitions = x;
                 } else if (res == 'm') {
                     gMaxNumFrames = x;
+                } else if (res == 'j') {
+                    gNumBenchmarkInstances = x;
                 } else {
                     CHECK_EQ(res, 'b');
                     gReproduceBug = x;
@@ -807,6 +1139,19 @@ int main(int argc, char **argv) {
         gPlaybackAudio = false;
     }
 
+    if (gBenchmarkMode == BENCHMARK_RENDER) {
+        if (audioOnly) {
+            gBenchmarkMode = BENCHMARK_DECODE;
+        } else {
+            // All instances would have to share the one surface.
+            gNumBenchmarkInstances = 1;
+
+            if (!useSurfaceAlloc) {
+                useSurfaceTexAlloc = true;
+            }
+        }
+    }
+
     argc -= optind;
     argv += optind;
 
@@ -958,6 +1303,11 @@ int main(int argc, char **argv) {
 
         const char *filename = argv[k];
 
+        if (gBenchmarkMode != BENCHMARK_NONE) {
+            benchmarkFile(&client, filename, audioOnly);
+            continue;
+        }
+
         sp<DataSource> dataSource = DataSource::CreateFromURI(filename);
 
         if (strncasecmp(filename, "sine:", 5) && dataSource == NULL) {
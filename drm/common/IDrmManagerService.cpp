@@ -1478,18 +1478,23 @@ status_t BnDrmManagerService::onTransact(
         readDecryptHandleFromParcelData(&handle, data);
 
         const int numBytes = data.readInt32();
-        char* buffer = new char[numBytes];
-
         const off64_t offset = data.readInt64();
 
-        ssize_t result = pread(uniqueId, &handle, buffer, numBytes, offset);
-        reply->writeInt32(result);
-        if (0 < result) {
-            reply->write(buffer, result);
+        // Decrypt straight into the reply rather than into a temporary
+        // buffer that then gets copied into it.
+        reply->writeInt32(0);
+        void* buffer = (0 < numBytes) ? reply->writeInplace(numBytes) : NULL;
+
+        ssize_t result = DRM_ERROR_UNKNOWN;
+        if (NULL != buffer || 0 == numBytes) {
+            result = pread(uniqueId, &handle, buffer, numBytes, offset);
         }
+        const size_t written = (0 < result) ? ((result + 3) & ~3) : 0;
+        reply->setDataSize(sizeof(int32_t) + written);
+        reply->setDataPosition(0);
+        reply->writeInt32(result);
 
         clearDecryptHandle(&handle);
-        delete [] buffer, buffer = NULL;
         return DRM_NO_ERROR;
     }
 
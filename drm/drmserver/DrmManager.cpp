@@ -111,15 +111,84 @@ status_t DrmManager::loadPlugIns(const String8& plugInDirPath) {
             delete info;
         }
     }
+    rebuildPlugInIndex();
     return DRM_NO_ERROR;
 }
 
+void DrmManager::rebuildPlugInIndex() {
+    mMimeTypeToPlugInIdMap.clear();
+    mFileSuffixToPlugInIdMap.clear();
+    mSuffixPathCache.clear();
+    mAnyPathCache.clear();
+
+    for (size_t index = 0; index < mSupportInfoToPlugInIdMap.size(); index++) {
+        DrmSupportInfo info(mSupportInfoToPlugInIdMap.keyAt(index));
+        const String8& plugInId = mSupportInfoToPlugInIdMap.valueAt(index);
+
+        DrmSupportInfo::MimeTypeIterator mimeIt = info.getMimeTypeIterator();
+        while (mimeIt.hasNext()) {
+            String8 mimeType(mimeIt.next());
+            mimeType.toLower();
+            if (mMimeTypeToPlugInIdMap.indexOfKey(mimeType) < 0) {
+                mMimeTypeToPlugInIdMap.add(mimeType, plugInId);
+            }
+        }
+
+        DrmSupportInfo::FileSuffixIterator suffixIt = info.getFileSuffixIterator();
+        while (suffixIt.hasNext()) {
+            String8 suffix(suffixIt.next());
+            suffix.toLower();
+            ssize_t i = mFileSuffixToPlugInIdMap.indexOfKey(suffix);
+            if (i < 0) {
+                i = mFileSuffixToPlugInIdMap.add(suffix, Vector<String8>());
+            }
+            Vector<String8>& ids = mFileSuffixToPlugInIdMap.editValueAt(i);
+            if (ids.isEmpty() || ids[ids.size() - 1] != plugInId) {
+                ids.push(plugInId);
+            }
+        }
+    }
+}
+
+bool DrmManager::lookUpPathCache(
+        const KeyedVector<String8, PathResult>& cache,
+        const String8& path, const struct stat& st, String8* plugInId) const {
+    ssize_t index = cache.indexOfKey(path);
+    if (index < 0) {
+        return false;
+    }
+    const PathResult& result = cache.valueAt(index);
+    if (result.dev != st.st_dev || result.ino != st.st_ino
+            || result.mtime != st.st_mtime || result.size != st.st_size) {
+        return false;
+    }
+    *plugInId = result.plugInId;
+    return true;
+}
+
+void DrmManager::addToPathCache(
+        KeyedVector<String8, PathResult>* cache,
+        const String8& path, const struct stat& st, const String8& plugInId) {
+    if (cache->size() >= kMaxPathCacheSize && cache->indexOfKey(path) < 0) {
+        // Scans walk the tree once, so there is no point in keeping old paths.
+        cache->clear();
+    }
+    PathResult result;
+    result.dev = st.st_dev;
+    result.ino = st.st_ino;
+    result.mtime = st.st_mtime;
+    result.size = st.st_size;
+    result.plugInId = plugInId;
+    cache->replaceValueFor(path, result);
+}
+
 status_t DrmManager::unloadPlugIns() {
     Mutex::Autolock _l(mLock);
     mConvertSessionMap.clear();
     mDecryptSessionMap.clear();
     mPlugInManager.unloadPlugIns();
     mSupportInfoToPlugInIdMap.clear();
+    rebuildPlugInIndex();
     return DRM_NO_ERROR;
 }
 
@@ -205,18 +274,27 @@ DrmInfoStatus* DrmManager::processDrmInfo(int uniqueId, const DrmInfo* drmInfo)
 }
 
 bool DrmManager::canHandle(int uniqueId, const String8& path) {
-    bool result = false;
+    struct stat st;
+    const bool cacheable = (stat(path.string(), &st) == 0);
+    String8 plugInId("");
+    if (cacheable && lookUpPathCache(mAnyPathCache, path, st, &plugInId)) {
+        return EMPTY_STRING != plugInId;
+    }
+
     Vector<String8> plugInPathList = mPlugInManager.getPlugInIdList();
 
     for (unsigned int i = 0; i < plugInPathList.size(); ++i) {
         IDrmEngine& rDrmEngine = mPlugInManager.getPlugIn(plugInPathList[i]);
-        result = rDrmEngine.canHandle(uniqueId, path);
-
-        if (result) {
+        if (rDrmEngine.canHandle(uniqueId, path)) {
+            plugInId = plugInPathList[i];
             break;
         }
     }
-    return result;
+
+    if (cacheable) {
+        addToPathCache(&mAnyPathCache, path, st, plugInId);
+    }
+    return EMPTY_STRING != plugInId;
 }
 
 DrmInfo* DrmManager::acquireDrmInfo(int uniqueId, const DrmInfoRequest* drmInfoRequest) {
@@ -565,13 +643,11 @@ String8 DrmManager::getSupportedPlugInId(const String8& mimeType) {
     String8 plugInId("");
 
     if (EMPTY_STRING != mimeType) {
-        for (unsigned int index = 0; index < mSupportInfoToPlugInIdMap.size(); index++) {
-            const DrmSupportInfo& drmSupportInfo = mSupportInfoToPlugInIdMap.keyAt(index);
-
-            if (drmSupportInfo.isSupportedMimeType(mimeType)) {
-                plugInId = mSupportInfoToPlugInIdMap.valueFor(drmSupportInfo);
-                break;
-            }
+        String8 key(mimeType);
+        key.toLower();
+        ssize_t index = mMimeTypeToPlugInIdMap.indexOfKey(key);
+        if (index >= 0) {
+            plugInId = mMimeTypeToPlugInIdMap.valueAt(index);
         }
     }
     return plugInId;
@@ -579,21 +655,33 @@ String8 DrmManager::getSupportedPlugInId(const String8& mimeType) {
 
 String8 DrmManager::getSupportedPlugInIdFromPath(int uniqueId, const String8& path) {
     String8 plugInId("");
-    const String8 fileSuffix = path.getPathExtension();
+    String8 fileSuffix = path.getPathExtension();
+    fileSuffix.toLower();
 
-    for (unsigned int index = 0; index < mSupportInfoToPlugInIdMap.size(); index++) {
-        const DrmSupportInfo& drmSupportInfo = mSupportInfoToPlugInIdMap.keyAt(index);
+    ssize_t index = mFileSuffixToPlugInIdMap.indexOfKey(fileSuffix);
+    if (index < 0) {
+        return plugInId;
+    }
 
-        if (drmSupportInfo.isSupportedFileSuffix(fileSuffix)) {
-            String8 key = mSupportInfoToPlugInIdMap.valueFor(drmSupportInfo);
-            IDrmEngine& drmEngine = mPlugInManager.getPlugIn(key);
+    struct stat st;
+    const bool cacheable = (stat(path.string(), &st) == 0);
+    if (cacheable && lookUpPathCache(mSuffixPathCache, path, st, &plugInId)) {
+        return plugInId;
+    }
 
-            if (drmEngine.canHandle(uniqueId, path)) {
-                plugInId = key;
-                break;
-            }
+    const Vector<String8>& plugInIds = mFileSuffixToPlugInIdMap.valueAt(index);
+    for (size_t i = 0; i < plugInIds.size(); i++) {
+        IDrmEngine& drmEngine = mPlugInManager.getPlugIn(plugInIds[i]);
+
+        if (drmEngine.canHandle(uniqueId, path)) {
+            plugInId = plugInIds[i];
+            break;
         }
     }
+
+    if (cacheable) {
+        addToPathCache(&mSuffixPathCache, path, st, plugInId);
+    }
     return plugInId;
 }
 
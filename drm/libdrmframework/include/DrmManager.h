@@ -17,6 +17,7 @@
 #ifndef __DRM_MANAGER_H__
 #define __DRM_MANAGER_H__
 
+#include <sys/stat.h>
 #include <utils/Errors.h>
 #include <utils/threads.h>
 #include <drm/drm_framework_common.h>
@@ -133,6 +134,15 @@ public:
     void onInfo(const DrmInfoEvent& event);
 
 private:
+    // Which plug-in handled a path, valid while the file keeps its identity.
+    struct PathResult {
+        dev_t dev;
+        ino_t ino;
+        time_t mtime;
+        off_t size;
+        String8 plugInId;
+    };
+
     String8 getSupportedPlugInId(int uniqueId, const String8& path, const String8& mimeType);
 
     String8 getSupportedPlugInId(const String8& mimeType);
@@ -141,9 +151,20 @@ private:
 
     bool canHandle(int uniqueId, const String8& path);
 
+    void rebuildPlugInIndex();
+
+    bool lookUpPathCache(
+            const KeyedVector<String8, PathResult>& cache,
+            const String8& path, const struct stat& st, String8* plugInId) const;
+
+    void addToPathCache(
+            KeyedVector<String8, PathResult>* cache,
+            const String8& path, const struct stat& st, const String8& plugInId);
+
 private:
     enum {
         kMaxNumUniqueIds = 0x1000,
+        kMaxPathCacheSize = 64,
     };
 
     bool mUniqueIdArray[kMaxNumUniqueIds];
@@ -157,6 +178,13 @@ private:
     Mutex mConvertLock;
     TPlugInManager<IDrmEngine> mPlugInManager;
     KeyedVector< DrmSupportInfo, String8 > mSupportInfoToPlugInIdMap;
+    // Lower case mime type / file suffix to plug-in ids, in the order
+    // mSupportInfoToPlugInIdMap would match them.
+    KeyedVector< String8, String8 > mMimeTypeToPlugInIdMap;
+    KeyedVector< String8, Vector<String8> > mFileSuffixToPlugInIdMap;
+    // Results of getSupportedPlugInIdFromPath() and canHandle(), guarded by mLock.
+    KeyedVector< String8, PathResult > mSuffixPathCache;
+    KeyedVector< String8, PathResult > mAnyPathCache;
     KeyedVector< int, IDrmEngine*> mConvertSessionMap;
     KeyedVector< int, sp<IDrmServiceListener> > mServiceListeners;
     KeyedVector< int, IDrmEngine*> mDecryptSessionMap;
@@ -24,6 +24,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <openssl/aes.h>
+#include <openssl/evp.h>
 #include <openssl/hmac.h>
 
 #include "FwdLockFile.h"
@@ -52,6 +53,8 @@
 
 #define SIG_CALC_BUFFER_SIZE (16 * SHA1_BLOCK_SIZE)
 
+#define KEY_STREAM_NUM_BLOCKS 64
+
 /**
  * Data type for the per-file state information needed by the decoder.
  */
@@ -66,10 +69,11 @@ typedef struct FwdLockFile_Session {
     unsigned char headerSignature[SHA1_HASH_SIZE];
     off64_t dataOffset;
     off64_t filePos;
-    AES_KEY encryptionRoundKeys;
+    EVP_CIPHER_CTX encryptionContext;
     HMAC_CTX signingContext;
-    unsigned char keyStream[AES_BLOCK_SIZE];
+    unsigned char keyStream[KEY_STREAM_NUM_BLOCKS * AES_BLOCK_SIZE];
     uint64_t blockIndex;
+    size_t numKeyStreamBlocks;
 } FwdLockFile_Session_t;
 
 static FwdLockFile_Session_t *sessionPtrs[MAX_NUM_SESSIONS] = { NULL };
@@ -190,10 +194,15 @@ static int FwdLockFile_DeriveKeys(FwdLockFile_Session_t * pSession) {
                 // Encrypt the 16-byte value {0, 0, ..., 0} to produce the encryption key.
                 memset(pData->value, 0, KEY_SIZE);
                 AES_encrypt(pData->value, pData->key, &pData->sessionRoundKeys);
-                if (AES_set_encrypt_key(pData->key, KEY_SIZE_IN_BITS,
-                                        &pSession->encryptionRoundKeys) != 0) {
+                // The keystream is generated through EVP, which uses the AES instructions of the
+                // CPU where they are available.
+                EVP_CIPHER_CTX_init(&pSession->encryptionContext);
+                if (!EVP_EncryptInit_ex(&pSession->encryptionContext, EVP_aes_128_ecb(), NULL,
+                                        pData->key, NULL)) {
+                    EVP_CIPHER_CTX_cleanup(&pSession->encryptionContext);
                     result = FALSE;
                 } else {
+                    EVP_CIPHER_CTX_set_padding(&pSession->encryptionContext, 0);
                     // Encrypt the 16-byte value {1, 0, ..., 0} to produce the signing key.
                     ++pData->value[0];
                     AES_encrypt(pData->value, pData->key, &pData->sessionRoundKeys);
@@ -236,23 +245,81 @@ static void FwdLockFile_CalculateCounter(const unsigned char *pNonce,
 }
 
 /**
- * Decrypts the byte at the current file position using AES-128-CTR. In CTR (or "counter") mode,
- * encryption and decryption are performed using the same algorithm.
+ * Generates the keystream for a run of consecutive blocks, starting with the given block.
  *
  * @param[in,out] pSession A reference to a file session.
- * @param[in] pByte The byte to decrypt.
+ * @param[in] blockIndex The index number of the first block.
+ * @param[in] numBlocks The number of blocks, at most KEY_STREAM_NUM_BLOCKS.
+ *
+ * @return A Boolean value indicating whether the keystream was generated.
  */
-void FwdLockFile_DecryptByte(FwdLockFile_Session_t * pSession, unsigned char *pByte) {
-    uint64_t blockIndex = pSession->filePos / AES_BLOCK_SIZE;
-    uint64_t blockOffset = pSession->filePos % AES_BLOCK_SIZE;
-    if (blockIndex != pSession->blockIndex) {
-        // The first 16 bytes of the encrypted session key is used as the nonce.
-        unsigned char counter[AES_BLOCK_SIZE];
-        FwdLockFile_CalculateCounter(pSession->pEncryptedSessionKey, blockIndex, counter);
-        AES_encrypt(counter, pSession->keyStream, &pSession->encryptionRoundKeys);
-        pSession->blockIndex = blockIndex;
+static int FwdLockFile_GenerateKeyStream(FwdLockFile_Session_t *pSession,
+                                         uint64_t blockIndex,
+                                         size_t numBlocks) {
+    int outLength = 0;
+    size_t i;
+    assert(0 < numBlocks && numBlocks <= KEY_STREAM_NUM_BLOCKS);
+    // The first 16 bytes of the encrypted session key is used as the nonce.
+    for (i = 0; i < numBlocks; ++i) {
+        FwdLockFile_CalculateCounter(pSession->pEncryptedSessionKey, blockIndex + i,
+                                     &pSession->keyStream[i * AES_BLOCK_SIZE]);
+    }
+    if (!EVP_EncryptUpdate(&pSession->encryptionContext, pSession->keyStream, &outLength,
+                           pSession->keyStream, (int)(numBlocks * AES_BLOCK_SIZE)) ||
+            outLength != (int)(numBlocks * AES_BLOCK_SIZE)) {
+        pSession->blockIndex = INVALID_BLOCK_INDEX;
+        pSession->numKeyStreamBlocks = 0;
+        return FALSE;
+    }
+    pSession->blockIndex = blockIndex;
+    pSession->numKeyStreamBlocks = numBlocks;
+    return TRUE;
+}
+
+/**
+ * Decrypts data read at the current file position using AES-128-CTR. In CTR (or "counter") mode,
+ * encryption and decryption are performed using the same algorithm. The keystream is generated
+ * for up to KEY_STREAM_NUM_BLOCKS blocks at a time and kept for the reads that follow.
+ *
+ * @param[in,out] pSession A reference to a file session.
+ * @param[in,out] pBuffer The data to decrypt.
+ * @param[in] numBytes The number of bytes to decrypt.
+ *
+ * @return A Boolean value indicating whether the data was decrypted.
+ */
+static int FwdLockFile_Decrypt(FwdLockFile_Session_t *pSession,
+                               unsigned char *pBuffer,
+                               size_t numBytes) {
+    while (numBytes > 0) {
+        uint64_t blockIndex = pSession->filePos / AES_BLOCK_SIZE;
+        size_t offset;
+        size_t numBytesToDecrypt;
+        size_t i;
+        if (pSession->blockIndex == INVALID_BLOCK_INDEX || blockIndex < pSession->blockIndex ||
+                blockIndex >= pSession->blockIndex + pSession->numKeyStreamBlocks) {
+            uint64_t lastBlockIndex = (pSession->filePos + numBytes - 1) / AES_BLOCK_SIZE;
+            uint64_t numBlocks = lastBlockIndex - blockIndex + 1;
+            if (numBlocks > KEY_STREAM_NUM_BLOCKS) {
+                numBlocks = KEY_STREAM_NUM_BLOCKS;
+            }
+            if (!FwdLockFile_GenerateKeyStream(pSession, blockIndex, (size_t)numBlocks)) {
+                return FALSE;
+            }
+        }
+        offset = (size_t)(blockIndex - pSession->blockIndex) * AES_BLOCK_SIZE +
+                (size_t)(pSession->filePos % AES_BLOCK_SIZE);
+        numBytesToDecrypt = pSession->numKeyStreamBlocks * AES_BLOCK_SIZE - offset;
+        if (numBytesToDecrypt > numBytes) {
+            numBytesToDecrypt = numBytes;
+        }
+        for (i = 0; i < numBytesToDecrypt; ++i) {
+            pBuffer[i] ^= pSession->keyStream[offset + i];
+        }
+        pBuffer += numBytesToDecrypt;
+        numBytes -= numBytesToDecrypt;
+        pSession->filePos += numBytesToDecrypt;
     }
-    *pByte ^= pSession->keyStream[blockOffset];
+    return TRUE;
 }
 
 int FwdLockFile_attach(int fileDesc) {
@@ -288,6 +355,7 @@ int FwdLockFile_attach(int fileDesc) {
                     pSession->encryptedSessionKeyLength + TOP_HEADER_SIZE + 2 * SHA1_HASH_SIZE;
             pSession->filePos = 0;
             pSession->blockIndex = INVALID_BLOCK_INDEX;
+            pSession->numKeyStreamBlocks = 0;
         } else {
             FwdLockFile_ReleaseSession(sessionId);
             sessionId = -1;
@@ -303,11 +371,11 @@ ssize_t FwdLockFile_read(int fileDesc, void *pBuffer, size_t numBytes) {
         numBytesRead = -1;
     } else {
         FwdLockFile_Session_t *pSession = sessionPtrs[sessionId];
-        ssize_t i;
         numBytesRead = read(pSession->fileDesc, pBuffer, numBytes);
-        for (i = 0; i < numBytesRead; ++i) {
-            FwdLockFile_DecryptByte(pSession, &((unsigned char *)pBuffer)[i]);
-            ++pSession->filePos;
+        if (numBytesRead > 0 &&
+                !FwdLockFile_Decrypt(pSession, pBuffer, (size_t)numBytesRead)) {
+            errno = EIO;
+            numBytesRead = -1;
         }
     }
     return numBytesRead;
@@ -357,6 +425,7 @@ int FwdLockFile_detach(int fileDesc) {
     if (sessionId < 0) {
         return -1;
     }
+    EVP_CIPHER_CTX_cleanup(&sessionPtrs[sessionId]->encryptionContext);
     HMAC_CTX_cleanup(&sessionPtrs[sessionId]->signingContext);
     FwdLockFile_ReleaseSession(sessionId);
     return 0;
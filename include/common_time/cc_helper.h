@@ -19,6 +19,8 @@
 
 #include <stdint.h>
 #include <common_time/ICommonClock.h>
+#include <common_time/local_clock.h>
+#include <utils/LinearTransform.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -40,6 +42,11 @@ namespace android {
 // ref counted ICommonClock interface across all clients and automatically
 // registering and unregistering a listener whenever there are CCHelper
 // instances active in the process.
+//
+// Conversions between local and common time are done in process using a copy
+// of the service's local to common transform which is refreshed from the
+// service at most every kTransformLifetimeMs of local time, or sooner if the
+// timeline changes.  Local time is read straight from the local time HAL.
 class CCHelper {
   public:
     CCHelper();
@@ -59,9 +66,29 @@ class CCHelper {
         void onTimelineChanged(uint64_t timelineID);
     };
 
+    enum ServiceCall {
+        COMMON_TO_LOCAL,
+        LOCAL_TO_COMMON,
+        GET_COMMON_TIME,
+        GET_LOCAL_TIME,
+    };
+
     static bool verifyClock_l();
+    static bool verifyLocalClock_l();
+    static status_t callService_l(ServiceCall call, int64_t in, int64_t* out);
+    static status_t refreshTransform_l(int64_t localTime);
+    static status_t getTransform_l(int64_t localTime);
+    static int64_t estimateLocalTime_l();
+
+    // how long a transform fetched from the service is trusted for
+    static const int64_t kTransformLifetimeMs = 100;
 
     static Mutex lock_;
+    static LocalClock* local_clock_;
+    static uint64_t local_freq_;
+    static bool xform_valid_;
+    static int64_t xform_expires_;
+    static LinearTransform xform_;
     static sp<ICommonClock> common_clock_;
     static sp<ICommonClockListener> common_clock_listener_;
     static uint32_t ref_count_;
@@ -22,6 +22,7 @@
 
 #include <hardware/local_time_hal.h>
 #include <utils/Errors.h>
+#include <utils/LinearTransform.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -38,9 +39,26 @@ class LocalClock {
     int32_t  getDebugLog(struct local_time_debug_event* records,
                          int max_records);
 
+    // Fetch a transform from CLOCK_MONOTONIC nanoseconds to local time ticks.
+    // The HAL is sampled at most every kSampleIntervalMs, so callers which
+    // need local time often can read the monotonic clock and transform it
+    // rather than going to the HAL each time.
+    bool     getMonotonicToLocalTransform(LinearTransform* xform);
+
   private:
+    static const int64_t kSampleIntervalMs = 1000;
+
+    static void sampleLocked(int64_t* monoTime, int64_t* localTime);
+
     static Mutex dev_lock_;
     static local_time_hw_device_t* dev_;
+    static uint64_t local_freq_;
+
+    // last HAL sample, and the transform derived from it
+    static bool xform_valid_;
+    static int64_t sample_mono_;
+    static int64_t sample_local_;
+    static LinearTransform xform_;
 };
 
 }  // namespace android
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _THREAD_CPU_STATS_H
+#define _THREAD_CPU_STATS_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <cpustats/CentralTendencyStatistics.h>
+#include <cpustats/ThreadCpuUsage.h>
+
+namespace android {
+
+// Rolling per-thread CPU usage statistics, for threads which want their CPU
+// consumption to show up in a dump without turning on a debug build.
+// Construct one on the thread to be measured, giving it a name, and call
+// sample() once per cycle of the thread's loop; the CPU time used since the
+// previous call is counted as one cycle.  Every kWindowNs of wall clock time
+// the statistics for the window just ended are published, and dump() prints
+// the most recently published window for every live instance in the process.
+// sample() may only be called by the thread which constructed the object;
+// dump() may be called from any thread.
+
+class ThreadCpuStats
+{
+
+public:
+    explicit ThreadCpuStats(const char *name);
+    ~ThreadCpuStats();
+
+    // Count the CPU time used by the current thread since the previous call.
+    void sample();
+
+    // Print the published statistics of every registered thread to fd.
+    static void dump(int fd);
+
+    static const long long kWindowNs = 10000000000LL;
+
+private:
+    ThreadCpuUsage mCpuUsage;
+    CentralTendencyStatistics mCurrent;     // cycles in the current window, owner thread only
+
+    // last complete window, protected by sMutex
+    CentralTendencyStatistics mPublished;
+    long long mPublishedElapsedNs;
+
+    char mName[32];
+    ThreadCpuStats *mNext;                  // registry link, protected by sMutex
+
+    static ThreadCpuStats *sHead;
+    static pthread_mutex_t sMutex;
+
+    // not copyable
+    ThreadCpuStats(const ThreadCpuStats&);
+    ThreadCpuStats& operator=(const ThreadCpuStats&);
+};
+
+}   // namespace android
+
+#endif //  _THREAD_CPU_STATS_H
@@ -345,15 +345,32 @@ public:
             status_t    obtainBuffer(Buffer* audioBuffer, int32_t waitCount)
                                 __attribute__((__deprecated__));
 
+    /* Direct access to the captured data in the shared buffer, for TRANSFER_OBTAIN clients
+     * that process the samples in place rather than copy them out with read().
+     * On entry buffers[0].frameCount is the maximum total number of frames wanted.
+     * On return buffers[0] is set as by obtainBuffer(), and buffers[1] holds the frames that
+     * continue at the start of the buffer when the data wraps around its end, or is empty.
+     * Release the frames once processed with releaseBuffer() on each of the two, or with
+     * a single releaseBuffer() of buffers[0] grown by the frameCount and size of buffers[1].
+     * waitCount is interpreted as by obtainBuffer().
+     */
+            status_t    obtainBuffers(Buffer buffers[2], int32_t waitCount);
+
 private:
     /* If nonContig is non-NULL, it is an output parameter that will be set to the number of
      * additional non-contiguous frames that are available immediately.
-     * FIXME We could pass an array of Buffers instead of only one Buffer to obtainBuffer(),
-     * in case the requested amount of frames is in two or more non-contiguous regions.
+     * If wrapBuffer is non-NULL, it is an output parameter that will be set to the frames
+     * available from the start of the record buffer after the end of audioBuffer, up to the
+     * requested total, so that the caller can drain both and release them together.
      * FIXME requested and elapsed are both relative times.  Consider changing to absolute time.
      */
             status_t    obtainBuffer(Buffer* audioBuffer, const struct timespec *requested,
-                                     struct timespec *elapsed = NULL, size_t *nonContig = NULL);
+                                     struct timespec *elapsed = NULL, size_t *nonContig = NULL,
+                                     Buffer* wrapBuffer = NULL);
+
+    // Converts the waitCount of the public obtain calls to a timeout, using *timeout if needed
+    static const struct timespec *waitCountToTimeout(int32_t waitCount,
+                                                     struct timespec *timeout);
 public:
 
     /* Release an emptied buffer of "audioBuffer->frameCount" frames for AudioFlinger to re-fill. */
@@ -20,6 +20,7 @@
 #define ANDROID_AUDIOSYSTEM_H_
 
 #include <hardware/audio_effect.h>
+#include <media/IAudioFlinger.h>
 #include <media/IAudioFlingerClient.h>
 #include <system/audio.h>
 #include <system/audio_policy.h>
@@ -252,6 +253,11 @@ public:
 
     static status_t setLowRamDevice(bool isLowRamDevice);
 
+    // apply a batch of volume and parameter updates in one transaction,
+    // see IAudioFlinger::applyUpdates()
+    static status_t applyUpdates(const Vector<IAudioFlinger::Update>& updates,
+            Vector<status_t> *statuses);
+
     // Check if hw offload is possible for given format, stream type, sample rate,
     // bit rate, duration, video and streaming or offload property is enabled
     static bool isOffloadSupported(const audio_offload_info_t& info);
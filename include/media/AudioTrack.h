@@ -397,6 +397,28 @@ public:
             status_t    setPositionUpdatePeriod(uint32_t updatePeriod);
             status_t    getPositionUpdatePeriod(uint32_t *updatePeriod) const;
 
+    /* Sets the refill watermark, which switches a TRANSFER_CALLBACK track to "pull" mode:
+     * instead of waking up every notificationFrames, the callback thread sleeps until the server
+     * signals that the number of frames queued in the buffer has dropped to watermarkFrames,
+     * then asks for the whole refill with as few EVENT_MORE_DATA as possible: one, or two when
+     * the refill wraps around the end of the buffer.  Tracks with large buffers thus wake up
+     * once per refill rather than at the notification cadence.
+     * Calling setRefillWatermark with watermarkFrames == 0 restores the notificationFrames
+     * cadence.  The watermark is kept if the IAudioTrack is re-created, unless the new buffer
+     * is too small for it.
+     *
+     * Parameters:
+     *
+     * watermarkFrames:  fill level in frames at which the client is woken up to refill.
+     *
+     * Returned status (from utils/Errors.h) can be:
+     *  - NO_ERROR: successful operation
+     *  - INVALID_OPERATION: the AudioTrack does not use TRANSFER_CALLBACK, or is offloaded.
+     *  - BAD_VALUE: watermarkFrames is not less than frameCount().
+     */
+            status_t    setRefillWatermark(uint32_t watermarkFrames);
+            uint32_t    getRefillWatermark() const { return mWatermarkFrames; }
+
     /* Sets playback head position.
      * Only supported for static buffer mode.
      *
@@ -521,12 +543,15 @@ public:
 private:
     /* If nonContig is non-NULL, it is an output parameter that will be set to the number of
      * additional non-contiguous frames that are available immediately.
-     * FIXME We could pass an array of Buffers instead of only one Buffer to obtainBuffer(),
-     * in case the requested amount of frames is in two or more non-contiguous regions.
+     * If wrapBuffer is non-NULL, it is an output parameter that will be set to the frames
+     * available after the end of the track buffer, up to the requested total, so that the
+     * caller can fill both regions and then release them together with a single releaseBuffer()
+     * of audioBuffer->size + wrapBuffer->size bytes from audioBuffer->raw.
      * FIXME requested and elapsed are both relative times.  Consider changing to absolute time.
      */
             status_t    obtainBuffer(Buffer* audioBuffer, const struct timespec *requested,
-                                     struct timespec *elapsed = NULL, size_t *nonContig = NULL);
+                                     struct timespec *elapsed = NULL, size_t *nonContig = NULL,
+                                     Buffer* wrapBuffer = NULL);
 public:
 
 //EL_FIXME to be reconciled with new obtainBuffer() return codes and control block proxy
@@ -710,6 +735,8 @@ protected:
                                                     // notification callback,
                                                     // at initial source sample rate
     bool                    mRefreshRemaining;      // processAudioBuffer() should refresh next 2
+    uint32_t                mWatermarkFrames;       // 0, or refill watermark in frames for
+                                                    // pull mode, see setRefillWatermark()
 
     // These are private to processAudioBuffer(), and are not protected by a lock
     uint32_t                mRemainingFrames;       // number of frames to request in obtainBuffer()
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_EFFECTLOUDNESSENHANCERAPI_H_
+#define ANDROID_EFFECTLOUDNESSENHANCERAPI_H_
+
+#include <audio_effects/effect_loudnessenhancer.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// Extensions to the loudness enhancer control interface implemented by the effect library in
+// media/libeffects/loudness.
+
+// Parameter selecting the quality/CPU trade-off of the compressor: the number of frames over
+// which the compressor gain is held constant between two updates of its envelope detector.
+// 1 updates the gain on every frame, which is the reference quality. Larger values compute the
+// gain once per block from the block peak and ramp to it linearly over the next block, which
+// costs far less CPU at the price of a slower reaction within a block.
+// The value is an uint32_t between 1 and LOUDNESS_ENHANCER_GAIN_UPDATE_FRAMES_MAX.
+#define LOUDNESS_ENHANCER_PARAM_GAIN_UPDATE_FRAMES (LOUDNESS_ENHANCER_PARAM_TARGET_GAIN_MB + 1)
+#define LOUDNESS_ENHANCER_GAIN_UPDATE_FRAMES_MAX 64
+
+// Property giving the default value of LOUDNESS_ENHANCER_PARAM_GAIN_UPDATE_FRAMES for new
+// effect instances, so that a device can trade quality for CPU without changing applications.
+#define LOUDNESS_ENHANCER_GAIN_UPDATE_FRAMES_PROPERTY "media.loudness.gain_update_frames"
+#define LOUDNESS_ENHANCER_GAIN_UPDATE_FRAMES_DEFAULT 1
+
+#if __cplusplus
+}  // extern "C"
+#endif
+
+#endif /*ANDROID_EFFECTLOUDNESSENHANCERAPI_H_*/
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_EFFECTVISUALIZERAPI_H_
+#define ANDROID_EFFECTVISUALIZERAPI_H_
+
+#include <audio_effects/effect_visualizer.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// Extensions to the visualizer effect control interface shared by the effect library in
+// media/libeffects/visualizer and the Visualizer client in libmedia.
+
+// Command code for the server side FFT. The effect computes the FFT of the current capture
+// once, caches it, and returns the cached result to every client asking again within the
+// minimum FFT period, so that several Visualizer clients on the same session do not each pay
+// for a capture and an FFT.
+//
+// The reply is getCaptureSize() bytes of FFT in the same 8 bit signed format as
+// Visualizer::getFft(), or twice that if replySize is 2 x capture size: the 8 bit unsigned
+// waveform the FFT was computed from, followed by the FFT.
+// An effect library that predates this command returns -EINVAL.
+#define VISUALIZER_CMD_CAPTURE_FFT (EFFECT_CMD_FIRST_PROPRIETARY + 2)
+
+// Property giving the minimum period in milliseconds between two FFTs computed by the effect.
+// Requests arriving sooner are served from the cache even if new audio has been captured.
+#define VISUALIZER_FFT_PERIOD_PROPERTY "media.visualizer.fft_period_ms"
+#define VISUALIZER_FFT_PERIOD_MS_DEFAULT 20
+
+#if __cplusplus
+}  // extern "C"
+#endif
+
+#endif /*ANDROID_EFFECTVISUALIZERAPI_H_*/
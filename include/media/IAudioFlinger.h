@@ -38,6 +38,7 @@
 #include <media/IEffect.h>
 #include <media/IEffectClient.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -58,6 +59,22 @@ public:
     };
     typedef uint32_t track_flags_t;
 
+    // One of the updates carried by applyUpdates()
+    struct Update {
+        enum Type {
+            STREAM_VOLUME,      // setStreamVolume(mStream, mValue, mIoHandle)
+            PARAMETERS,         // setParameters(mIoHandle, mKeyValuePairs)
+            VOICE_VOLUME,       // setVoiceVolume(mValue)
+        };
+        Type                mType;
+        audio_stream_type_t mStream;
+        float               mValue;
+        audio_io_handle_t   mIoHandle;
+        String8             mKeyValuePairs;
+    };
+    // maximum number of updates in a single applyUpdates() transaction
+    static const size_t kMaxUpdates = 64;
+
     // invariant on exit for all APIs that return an sp<>:
     //   (return value != 0) == (*status == NO_ERROR)
 
@@ -226,6 +243,12 @@ public:
     // and should be called at most once.  For a definition of what "low RAM" means, see
     // android.app.ActivityManager.isLowRamDevice().
     virtual status_t setLowRamDevice(bool isLowRamDevice) = 0;
+
+    // Apply in order, and in a single transaction, up to kMaxUpdates updates that would
+    // otherwise each take a setStreamVolume(), setParameters() or setVoiceVolume() call.
+    // If statuses is not NULL, it receives the status of each update.
+    // Returns NO_ERROR if all updates succeeded, or else the status of the first one that failed.
+    virtual status_t applyUpdates(const Vector<Update>& updates, Vector<status_t> *statuses) = 0;
 };
 
 
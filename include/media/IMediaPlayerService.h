@@ -55,6 +55,11 @@ public:
     virtual status_t         decode(int fd, int64_t offset, int64_t length, uint32_t *pSampleRate,
                                     int* pNumChannels, audio_format_t* pFormat,
                                     const sp<IMemoryHeap>& heap, size_t *pSize) = 0;
+    // Like decode(), but the PCM is in read-only memory owned by the media server, and is shared
+    // with every other client decoding the same content.  Returns 0 on error.
+    virtual sp<IMemory>      decodeShared(int fd, int64_t offset, int64_t length,
+                                    uint32_t *pSampleRate, int* pNumChannels,
+                                    audio_format_t* pFormat) = 0;
     virtual sp<IOMX>            getOMX() = 0;
     virtual sp<ICrypto>         makeCrypto() = 0;
     virtual sp<IDrm>            makeDrm() = 0;
@@ -142,6 +142,7 @@ public:
     enum InternalOptionType {
         INTERNAL_OPTION_SUSPEND,  // data is a bool
         INTERNAL_OPTION_REPEAT_PREVIOUS_FRAME_DELAY,  // data is an int64_t
+        INTERNAL_OPTION_MAX_FPS,  // data is a float
     };
     virtual status_t setInternalOption(
             node_id node,
@@ -193,6 +194,10 @@ public:
     DECLARE_META_INTERFACE(OMXObserver);
 
     virtual void onMessage(const omx_message &msg) = 0;
+
+    // Delivers several messages in a single transaction, the default
+    // implementation hands them to onMessage one at a time.
+    virtual void onMessages(const List<omx_message> &messages);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -51,7 +51,7 @@ typedef void SoundPoolCallback(SoundPoolEvent event, SoundPool* soundPool, void*
 // tracks samples used by application
 class Sample  : public RefBase {
 public:
-    enum sample_state { UNLOADED, LOADING, READY, UNLOADING };
+    enum sample_state { UNLOADED, LOADING, READY, UNLOADING, EVICTED };
     Sample(int sampleID, const char* url);
     Sample(int sampleID, int fd, int64_t offset, int64_t length);
     ~Sample();
@@ -66,6 +66,14 @@ public:
     void startLoad() { mState = LOADING; }
     sp<IMemory> getIMemory() { return mData; }
 
+    // keep the compressed data in memory so that the sample can be evicted
+    // and decoded again when it is next played
+    void setKeepCompressed(bool keep) { mKeepCompressed = keep; }
+    bool canReload() { return mUrl != 0 || mCompressed != 0; }
+    void evict();
+    uint32_t lastUsed() { return mLastUsed; }
+    void setLastUsed(uint32_t lastUsed) { mLastUsed = lastUsed; }
+
     // hack
     void init(int numChannels, int sampleRate, audio_format_t format, size_t size,
             sp<IMemory> data ) {
@@ -74,6 +82,8 @@ public:
 
 private:
     void init();
+    status_t copyCompressed();
+    void closeSource();
 
     size_t              mSize;
     volatile int32_t    mRefCount;
@@ -88,6 +98,9 @@ private:
     char*               mUrl;
     sp<IMemory>         mData;
     sp<MemoryHeapBase>  mHeap;
+    sp<MemoryHeapBase>  mCompressed;
+    bool                mKeepCompressed;
+    uint32_t            mLastUsed;
 };
 
 // stores pending events for stolen channels
@@ -143,6 +156,7 @@ public:
     void clearNextEvent() { mNextEvent.clear(); }
     void nextEvent();
     int nextChannelID() { return mNextEvent.channelID(); }
+    sp<Sample> nextSample() { return mNextEvent.sample(); }
     void dump();
 
 private:
@@ -186,6 +200,13 @@ public:
     audio_stream_type_t streamType() const { return mStreamType; }
     int srcQuality() const { return mSrcQuality; }
 
+    // Caps the memory held by decoded samples, 0 means no limit. Once over
+    // budget, the least recently used samples that are not playing are
+    // evicted and decoded again on their next play(), synchronously on the
+    // thread calling play(). Samples loaded from a file descriptor after
+    // this call keep a compressed copy in memory.
+    void setMemoryBudget(size_t bytes);
+
     // called from SoundPoolThread
     void sampleLoaded(int sampleID);
 
@@ -205,6 +226,8 @@ private:
     SoundChannel* findNextChannel (int channelID);
     SoundChannel* allocateChannel_l(int priority);
     void moveToFront_l(SoundChannel* channel);
+    bool isPlaying_l(const sp<Sample>& sample);
+    void evict_l(const sp<Sample>& keep);
     void notify(SoundPoolEvent event);
     void dump();
 
@@ -231,6 +254,10 @@ private:
     int                     mNextSampleID;
     int                     mNextChannelID;
     bool                    mQuit;
+    size_t                  mMemoryBudget;
+    uint32_t                mUseCount;
+    int                     mReloading;         // play() calls decoding without mLock
+    Condition               mReloadCondition;   // signaled when mReloading drops to 0
 
     // callback
     Mutex                   mCallbackLock;
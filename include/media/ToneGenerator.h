@@ -20,6 +20,7 @@
 #include <utils/RefBase.h>
 #include <utils/KeyedVector.h>
 #include <utils/threads.h>
+#include <binder/IMemory.h>
 #include <media/AudioSystem.h>
 #include <media/AudioTrack.h>
 
@@ -157,7 +158,8 @@ public:
     bool startTone(tone_type toneType, int durationMs = -1);
     void stopTone();
 
-    bool isInited() { return (mState == TONE_IDLE)?false:true;}
+    // In static mode the AudioTrack for streamed tones is only created on first use
+    bool isInited() { return (mState == TONE_IDLE && !mStaticMode)?false:true;}
 
     // returns the audio session this ToneGenerator belongs to or 0 if an error occured.
     int getSessionId() { return (mpAudioTrack == 0) ? 0 : mpAudioTrack->getSessionId(); }
@@ -245,6 +247,41 @@ private:
 
     static const ToneDescriptor sToneDescriptors[];
 
+    // Static mode is enabled by property media.tonegen.static.  In static mode, a tone whose
+    // total duration (limited by durationMs) is at most TONEGEN_MAX_STATIC_MS is rendered once
+    // into a PCM buffer, and played by a static AudioTrack that is cached and shared by all
+    // ToneGenerator instances in the process.  Other tones are still streamed by audioCallback().
+    static const unsigned int TONEGEN_MAX_STATIC_MS = 2000;
+    static const size_t TONEGEN_MAX_STATIC_TONES = 8;  // maximum number of cached static tones
+
+    // A rendered tone and its static AudioTrack, shared by all instances
+    class StaticTone : public RefBase {
+    public:
+        StaticTone(audio_stream_type_t streamType, tone_type toneType, int durationMs,
+                uint32_t samplingRate)
+            : mStreamType(streamType), mToneType(toneType), mDurationMs(durationMs),
+              mSamplingRate(samplingRate) { }
+
+        const audio_stream_type_t mStreamType;
+        const tone_type mToneType;
+        const int mDurationMs;
+        const uint32_t mSamplingRate;
+        sp<IMemory> mBuffer;        // rendered PCM, mono 16-bit
+        sp<AudioTrack> mTrack;      // static AudioTrack playing mBuffer
+    };
+
+    // Cache of static tones, most recently used last, protected by sStaticLock
+    static Mutex sStaticLock;
+    static Vector< sp<StaticTone> > sStaticTones;
+
+    sp<StaticTone> getStaticTone(tone_type toneType, int durationMs);
+    void stopStaticTone();
+    static size_t renderTone(const ToneDescriptor *toneDesc, uint32_t samplingRate,
+            unsigned int maxSmp, short *out, bool *complete);
+
+    bool mStaticMode;  // whether static mode is enabled
+    sp<StaticTone> mpStaticTone;  // static tone currently playing, if any
+
     bool mThreadCanCallJava;
     unsigned int mTotalSmp;  // Total number of audio samples played (gives current time)
     unsigned int mNextSegSmp;  // Position of next segment transition expressed in samples
@@ -156,6 +156,10 @@ private:
     };
 
     status_t doFft(uint8_t *fft, uint8_t *waveform);
+    // get the FFT, and the waveform it was computed from if waveform is not NULL, from the
+    // effect which computes it once for all clients. Returns BAD_VALUE and clears
+    // mServerFft if the effect does not support it.
+    status_t getServerFft(uint8_t *fft, uint8_t *waveform);
     void periodicCapture();
     uint32_t initCaptureSize();
 
@@ -169,6 +173,7 @@ private:
     void *mCaptureCbkUser;
     sp<CaptureThread> mCaptureThread;
     uint32_t mCaptureFlags;
+    bool mServerFft;    // false once the effect has rejected VISUALIZER_CMD_CAPTURE_FFT
 };
 
 
@@ -60,6 +60,14 @@ enum {
     // Add more here...
 };
 
+// Or'ed into the seek option of getFrameAtTime(). Only the sync frame
+// nearest to the requested time is decoded and the frame is scaled down to
+// thumbnail size. Consecutive calls on the same data source reuse the
+// decoder.
+enum {
+    FRAME_OPTION_THUMBNAIL = 0x100,
+};
+
 class MediaMetadataRetriever: public RefBase
 {
 public:
@@ -231,6 +231,9 @@ public:
     static  status_t        decode(int fd, int64_t offset, int64_t length, uint32_t *pSampleRate,
                                    int* pNumChannels, audio_format_t* pFormat,
                                    const sp<IMemoryHeap>& heap, size_t *pSize);
+    static  sp<IMemory>     decodeShared(int fd, int64_t offset, int64_t length,
+                                   uint32_t *pSampleRate, int* pNumChannels,
+                                   audio_format_t* pFormat);
             status_t        invoke(const Parcel& request, Parcel *reply);
             status_t        setMetadataFilter(const Parcel& filter);
             status_t        getMetadata(bool update_only, bool apply_filter, Parcel *metadata);
@@ -51,6 +51,8 @@ public:
 
     virtual void    onTimestamp(const AudioTimestamp& timestamp);
 
+    virtual status_t getTimestamp(AudioTimestamp& timestamp);
+
     // NBAIO_Source end
 
 #if 0   // until necessary
@@ -59,6 +61,8 @@ public:
 
 private:
     MonoPipe * const mPipe;
+    bool            mTimestampValid;
+    AudioTimestamp  mTimestamp;     // most recent from onTimestamp(), in framesRead() units
 };
 
 }   // namespace android
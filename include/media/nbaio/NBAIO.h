@@ -77,6 +77,16 @@ typedef ssize_t (*writeVia_t)(void *user, void *buffer, size_t count);
 typedef ssize_t (*readVia_t)(void *user, const void *buffer,
                              size_t count, int64_t readPTS);
 
+// Flow statistics of a port, see NBAIO_Port::getStats()
+struct NBAIO_Stats {
+    size_t  mFrames;        // framesWritten() for a sink, framesRead() for a source
+    size_t  mFramesLost;    // framesUnderrun() for a sink, framesOverrun() for a source
+    size_t  mLosses;        // underruns() for a sink, overruns() for a source
+    size_t  mLag;           // frames available but not yet consumed, as of the most recent
+                            // availableToRead() or read(); 0 if not applicable
+    size_t  mMaxLag;        // largest mLag since construction
+};
+
 // Abstract class (interface) representing a data port.
 class NBAIO_Port : public RefBase {
 
@@ -114,6 +124,12 @@ public:
     // or if re-negotiation is required.
     virtual NBAIO_Format format() const { return mNegotiated ? mFormat : Format_Invalid; }
 
+    // Fill in the statistics of this port, for monitoring.  It is called from a thread other
+    // than the one using the port, so the values may be slightly inconsistent with each other.
+    // Not const because implementations may need to do I/O.
+    // Returns NO_ERROR, or INVALID_OPERATION if the port keeps no statistics.
+    virtual status_t getStats(NBAIO_Stats& stats) { return INVALID_OPERATION; }
+
 protected:
     NBAIO_Port(NBAIO_Format format) : mNegotiated(false), mFormat(format),
                                       mBitShift(Format_frameBitShift(format)) { }
@@ -143,6 +159,9 @@ public:
     // Number of underruns since construction, where a set of contiguous lost frames is one event.
     virtual size_t underruns() const { return 0; }
 
+    // NBAIO_Port interface, from the counters above
+    virtual status_t getStats(NBAIO_Stats& stats);
+
     // Estimate of number of frames that could be written successfully now without blocking.
     // When a write() is actually attempted, the implementation is permitted to return a smaller or
     // larger transfer count, however it will make a good faith effort to give an accurate estimate.
@@ -246,6 +265,9 @@ public:
     // Not const because implementations may need to do I/O.
     virtual size_t overruns() /*const*/ { return 0; }
 
+    // NBAIO_Port interface, from the counters above
+    virtual status_t getStats(NBAIO_Stats& stats);
+
     // Estimate of number of frames that could be read successfully now.
     // When a read() is actually attempted, the implementation is permitted to return a smaller or
     // larger transfer count, however it will make a good faith effort to give an accurate estimate.
@@ -310,6 +332,11 @@ public:
     // Default implementation ignores the timestamp.
     virtual void    onTimestamp(const AudioTimestamp& timestamp) { }
 
+    // Returns NO_ERROR if a timestamp is available, so that whoever reads from this source can
+    // map positions in framesRead() units to presentation times further down the graph.
+    // The timestamp is the most recent one received by onTimestamp().
+    virtual status_t getTimestamp(AudioTimestamp& timestamp) { return INVALID_OPERATION; }
+
 protected:
     NBAIO_Source(NBAIO_Format format = Format_Invalid) : NBAIO_Port(format), mFramesRead(0) { }
     virtual ~NBAIO_Source() { }
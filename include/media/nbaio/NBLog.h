@@ -20,7 +20,9 @@
 #define ANDROID_MEDIA_NBLOG_H
 
 #include <binder/IMemory.h>
+#include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
+#include <utils/String8.h>
 #include <media/nbaio/roundup.h>
 
 namespace android {
@@ -38,8 +40,13 @@ enum Event {
     EVENT_RESERVED,
     EVENT_STRING,               // ASCII string, not NUL-terminated
     EVENT_TIMESTAMP,            // clock_gettime(CLOCK_MONOTONIC)
+    EVENT_FORMAT_DEF,           // uint16_t format ID, then printf format string, not NUL-terminated
+    EVENT_FORMAT,               // uint16_t format ID, then the raw unformatted arguments
 };
 
+// maximum length of the additional data of an Entry
+static const size_t kMaxLength = 255;
+
 // ---------------------------------------------------------------------------
 
 // representation of a single log entry in private memory
@@ -48,8 +55,6 @@ struct Entry {
         : mEvent(event), mLength(length), mData(data) { }
     /*virtual*/ ~Entry() { }
 
-    int     readAt(size_t offset) const;
-
 private:
     friend class Writer;
     Event       mEvent;     // event type
@@ -67,6 +72,15 @@ private:
 //  byte[2+mLength-1]   mData[mLength-1]
 //  byte[2+mLength]     duplicate copy of mLength to permit reverse scan
 //  byte[3+mLength]     start of next log entry
+//
+// EVENT_FORMAT arguments are stored in the order of the conversions in the format string:
+//  int, char, short    4 bytes
+//  long, long long     8 bytes, sign- or zero-extended per the conversion, so that a 32-bit log
+//                      can be decoded on a 64-bit host
+//  double              8 bytes
+//  pointer             8 bytes
+//  string              1 byte length, then the characters, not NUL-terminated
+// All multi-byte values are in the writer's native byte order.
 
 // located in shared memory
 struct Shared {
@@ -118,7 +132,7 @@ public:
     Writer(size_t size, void *shared);
     Writer(size_t size, const sp<IMemory>& iMemory);
 
-    virtual ~Writer() { }
+    virtual ~Writer();
 
     virtual void    log(const char *string);
     virtual void    logf(const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
@@ -133,17 +147,44 @@ public:
             bool    enable()    { return setEnabled(true); }
             bool    disable()   { return setEnabled(false); }
 
+    // In binary mode, logf() and logvf() do not format on the calling thread.  Instead the
+    // format string is logged once as an EVENT_FORMAT_DEF, and each call logs only its ID and
+    // the raw arguments as an EVENT_FORMAT, which the Reader formats at dump time.
+    // Formats that cannot be logged this way (%n, '*' widths, long double, wide strings, or too
+    // many arguments) and calls whose arguments do not fit in one entry fall back to vsnprintf.
+    // Return value is the previous isBinary().
+    virtual bool    setBinary(bool binary);
+            bool    isBinary() const    { return mFormats != NULL; }
+
     sp<IMemory>     getIMemory() const  { return mIMemory; }
 
 private:
     void    log(Event event, const void *data, size_t length);
     void    log(const Entry *entry, bool trusted = false);
+    size_t  copyIn(size_t rear, const void *data, size_t length);
+    bool    logBinary(const char *fmt, va_list ap);
+
+    // maximum number of distinct format strings per Writer in binary mode
+    static const size_t kMaxFormats = 64;
+    // maximum number of arguments per format string in binary mode
+    static const size_t kMaxArgs = 16;
+
+    // a format string known to this Writer, indexed by format ID
+    struct Format {
+        const char *mFmt;       // the caller's format string, compared by address
+        int32_t     mDefRear;   // mRear at the most recent EVENT_FORMAT_DEF for this format
+        bool        mDefined;   // whether an EVENT_FORMAT_DEF has been logged
+        bool        mBinary;    // whether the format can be logged in binary
+        uint8_t     mNumArgs;
+        uint8_t     mArgTypes[kMaxArgs];
+    };
 
     const size_t    mSize;      // circular buffer size in bytes, must be a power of 2
     Shared* const   mShared;    // raw pointer to shared memory
     const sp<IMemory> mIMemory; // ref-counted version
     int32_t         mRear;      // my private copy of mShared->mRear
     bool            mEnabled;   // whether to actually log
+    Format*         mFormats;   // kMaxFormats hashed by address in binary mode, otherwise NULL
 };
 
 // ---------------------------------------------------------------------------
@@ -162,6 +203,7 @@ public:
 
     virtual bool    isEnabled() const;
     virtual bool    setEnabled(bool enabled);
+    virtual bool    setBinary(bool binary);
 
 private:
     mutable Mutex   mLock;
@@ -182,11 +224,22 @@ public:
     void    dump(int fd, size_t indent = 0);
     bool    isIMemory(const sp<IMemory>& iMemory) const;
 
+    // Copy up to 'size' raw bytes logged since the previous drain() into 'buffer', and return
+    // the number of bytes copied.  The copy starts at the writer's buffer index *position,
+    // which may be in the middle of an entry if bytes were lost.  *lost is set to the number
+    // of bytes that were overwritten by the writer before they could be drained.
+    // drain() has its own read index, independent of dump().
+    size_t  drain(void *buffer, size_t size, uint32_t *position, size_t *lost);
+
 private:
     const size_t    mSize;      // circular buffer size in bytes, must be a power of 2
     const Shared* const mShared; // raw pointer to shared memory
     const sp<IMemory> mIMemory; // ref-counted version
     int32_t     mFront;         // index of oldest acknowledged Entry
+    int32_t     mDrainFront;    // index of oldest byte not yet drained
+    // format strings from EVENT_FORMAT_DEF, indexed by format ID, kept across dumps because
+    // the definition may have been overwritten by the time its EVENT_FORMAT is dumped
+    KeyedVector<uint16_t, String8> mFormats;
 
     static const size_t kSquashTimestamp = 5; // squash this many or more adjacent timestamps
 };
@@ -52,11 +52,21 @@ public:
     virtual ssize_t write(const void *buffer, size_t count);
     //virtual ssize_t writeVia(writeVia_t via, size_t total, void *user, size_t block);
 
+    // NBAIO_Port interface.  Overruns happen on the read side, so they would otherwise be
+    // invisible to the writer: mFramesLost and mLosses are the totals over all PipeReaders,
+    // past and present, and mMaxLag is the largest lag seen by any of them.
+    virtual status_t getStats(NBAIO_Stats& stats);
+
 private:
     const size_t    mMaxFrames;     // always a power of 2
     void * const    mBuffer;
     volatile int32_t mRear;         // written by android_atomic_release_store
     volatile int32_t mReaders;      // number of PipeReader clients currently attached to this Pipe
+
+    // updated atomically by the PipeReaders
+    volatile int32_t mReaderFramesOverrun;
+    volatile int32_t mReaderOverruns;
+    volatile int32_t mReaderMaxLag;
 };
 
 }   // namespace android
@@ -47,17 +47,30 @@ public:
 
     virtual ssize_t read(void *buffer, size_t count, int64_t readPTS);
 
+    // including this reader's lag behind the writer
+    virtual status_t getStats(NBAIO_Stats& stats);
+
     // NBAIO_Source end
 
+    // Like read(), but if fewer than count frames are available, then first wait up to timeoutNs
+    // for the writer to provide them.  The writer does not signal readers, so the wait is a sleep
+    // for the time the missing frames take at the nominal sample rate.
+    // Returns fewer than count frames on timeout, and the same errors as read().
+    ssize_t readBlocking(void *buffer, size_t count, int64_t readPTS, int64_t timeoutNs);
+
 #if 0   // until necessary
     Pipe& pipe() const { return mPipe; }
 #endif
 
 private:
+    void        updateLag(size_t lag);
+
     Pipe&       mPipe;
     int32_t     mFront;         // follows behind mPipe.mRear
     size_t      mFramesOverrun;
     size_t      mOverruns;
+    size_t      mLag;           // frames from mFront to mPipe.mRear at the most recent check
+    size_t      mMaxLag;
 };
 
 }   // namespace android
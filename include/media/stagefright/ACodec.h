@@ -172,6 +172,7 @@ private:
     uint32_t mQuirks;
     sp<IOMX> mOMX;
     IOMX::node_id mNode;
+    bool mOMXLivesLocally;
     sp<MemoryDealer> mDealer[2];
 
     sp<ANativeWindow> mNativeWindow;
@@ -202,6 +203,7 @@ private:
     int32_t mMetaDataBuffersToSubmit;
 
     int64_t mRepeatFrameDelayUs;
+    float mMaxFps;
 
     status_t setCyclicIntraMacroblockRefresh(const sp<AMessage> &msg, int32_t mode);
     status_t allocateBuffersOnPort(OMX_U32 portIndex);
@@ -88,6 +88,8 @@ private:
     int64_t mAutoRampStartUs;
 
     List<MediaBuffer * > mBuffersReceived;
+    // Buffers returned by the client, reused for the next callbacks
+    List<MediaBuffer * > mFreeBuffers;
 
     void trackMaxAmplitude(int16_t *data, int nSamples);
 
@@ -99,6 +101,7 @@ private:
 
     void queueInputBuffer_l(MediaBuffer *buffer, int64_t timeUs);
     void releaseQueuedFrames_l();
+    MediaBuffer *getFreeBuffer_l(size_t size);
     void waitOutstandingEncodingFrames_l();
     status_t reset();
 
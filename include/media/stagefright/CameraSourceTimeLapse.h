@@ -45,6 +45,10 @@ public:
 
     virtual ~CameraSourceTimeLapse();
 
+    // Restores the preview fps range changed by trySettingPreviewFpsRange(),
+    // then stops as CameraSource does.
+    virtual status_t stop();
+
     // If the frame capture interval is large, read will block for a long time.
     // Due to the way the mediaRecorder framework works, a stop() call from
     // mediaRecorder waits until the read returns, causing a long wait for
@@ -70,6 +74,12 @@ private:
     // to know if current frame needs to be skipped.
     bool mSkipCurrentFrame;
 
+    // The camera's preview fps range before trySettingPreviewFpsRange()
+    // lowered it, valid if mPreviewFpsRangeChanged.
+    bool mPreviewFpsRangeChanged;
+    int mOriginalMinPreviewFps;
+    int mOriginalMaxPreviewFps;
+
     // Lock for accessing mCameraIdle
     Mutex mCameraIdleLock;
 
@@ -145,6 +155,16 @@ private:
     // Otherwise returns false.
     bool trySettingVideoSize(int32_t width, int32_t height);
 
+    // Lowers the camera's preview fps range to the slowest supported range
+    // that still produces frames at least as often as they are captured,
+    // so the sensor doesn't run at the video rate only to have most frames
+    // skipped. Keeps the current range if none is slower.
+    void trySettingPreviewFpsRange(int64_t timeBetweenFrameCaptureUs);
+
+    // Puts back the range replaced by trySettingPreviewFpsRange(), if any,
+    // while the camera is still ours.
+    void restorePreviewFpsRange();
+
     // When video camera is used for time lapse capture, returns true
     // until enough time has passed for the next time lapse frame. When
     // the frame needs to be encoded, it returns false and also modifies
@@ -59,24 +59,27 @@ private:
         size_t mCropLeft, mCropTop, mCropRight, mCropBottom;
     };
 
+    // Where the samples of one source row are. The chroma of pixels
+    // 2k and 2k + 1 is mU[k * mChromaStep], mV[k * mChromaStep].
+    struct YUVRow {
+        const uint8_t *mY, *mU, *mV;
+        size_t mYStep;
+        size_t mChromaStep;
+        bool mSwapRB;
+    };
+
     OMX_COLOR_FORMATTYPE mSrcFormat, mDstFormat;
     uint8_t *mClip;
 
     uint8_t *initClip();
 
-    status_t convertCbYCrY(
-            const BitmapParams &src, const BitmapParams &dst);
+    size_t dstBytesPerPixel() const;
 
-    status_t convertYUV420Planar(
-            const BitmapParams &src, const BitmapParams &dst);
+    void getRow(const BitmapParams &src, size_t y, YUVRow *row) const;
 
-    status_t convertQCOMYUV420SemiPlanar(
-            const BitmapParams &src, const BitmapParams &dst);
-
-    status_t convertYUV420SemiPlanar(
-            const BitmapParams &src, const BitmapParams &dst);
+    void convertRow(const YUVRow &row, size_t width, void *dst);
 
-    status_t convertTIYUV420PackedSemiPlanar(
+    status_t convertScaled(
             const BitmapParams &src, const BitmapParams &dst);
 
     ColorConverter(const ColorConverter &);
@@ -51,6 +51,21 @@ private:
     int64_t mLength;
     Mutex mLock;
 
+    // Set when the file is mapped, in which case readAt() copies from the mapping without
+    // any lock or syscall. mMapData points at mOffset in the mapping, which starts at the
+    // page boundary below it.
+    void *mMapBase;
+    size_t mMapSize;
+    const uint8_t *mMapData;
+    int64_t mMapDataSize;
+
+    // Access pattern tracking for the page cache hints of the pread() path, see
+    // updateAccessHints(). Protected by mHintLock, which is never held across a read.
+    Mutex mHintLock;
+    int64_t mNextSequentialOffset;
+    int32_t mSequentialReads;
+    int64_t mReadAheadOffset;
+
     /*for DRM*/
     sp<DecryptHandle> mDecryptHandle;
     DrmManagerClient *mDrmManagerClient;
@@ -60,6 +75,9 @@ private:
 
     ssize_t readAtDRM(off64_t offset, void *data, size_t size);
 
+    void mapFile();
+    void updateAccessHints(off64_t offset, size_t size);
+
     FileSource(const FileSource &);
     FileSource &operator=(const FileSource &);
 };
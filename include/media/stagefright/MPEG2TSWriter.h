@@ -52,6 +52,11 @@ private:
         kWhatSourceNotify = 'noti'
     };
 
+    enum {
+        kTSPacketSize       = 188,
+        kTSPacketsPerBatch  = 64,
+    };
+
     struct SourceInfo;
 
     FILE *mFile;
@@ -73,15 +78,26 @@ private:
     int mPMTContinuityCounter;
     uint32_t mCrcTable[256];
 
+    // PAT and PMT packets with their CRC, minus the continuity counter.
+    sp<ABuffer> mProgramAssociationTable;
+    sp<ABuffer> mProgramMap;
+
+    // Packets of the access unit being written, flushed in one write.
+    sp<ABuffer> mTSPackets;
+
     void init();
 
     void writeTS();
+    sp<ABuffer> buildProgramAssociationTable();
+    sp<ABuffer> buildProgramMap();
     void writeProgramAssociationTable();
     void writeProgramMap();
     void writeAccessUnit(int32_t sourceIndex, const sp<ABuffer> &buffer);
     void initCrcTable();
     uint32_t crc32(const uint8_t *start, size_t length);
 
+    uint8_t *appendTSPacket();
+    void flushTSPackets();
     ssize_t internalWrite(const void *data, size_t size);
     status_t reset();
 
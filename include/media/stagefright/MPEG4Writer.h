@@ -23,6 +23,7 @@
 #include <media/stagefright/MediaWriter.h>
 #include <utils/List.h>
 #include <utils/threads.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -97,6 +98,17 @@ private:
     bool mAreGeoTagsAvailable;
     int32_t mStartTimeOffsetMs;
 
+    // Fragmented file: the moov box only describes the tracks and is
+    // written before the first movie fragment, each chunk is then written
+    // as a moof box followed by the mdat box of its samples.
+    int64_t mFragmentDurationUs;  // 0 unless the file is fragmented
+    uint32_t mFragmentSequenceNumber;
+    off64_t mFragmentedMoovOffset;
+    off64_t mFragmentedMoovSize;  // 0 until the moov box is written
+
+    // Samples are written out in batches of about this many bytes
+    size_t mWriteBatchBytes;
+
     Mutex mLock;
 
     List<Track *> mTracks;
@@ -109,16 +121,32 @@ private:
     size_t numTracks();
     int64_t estimateMoovBoxSize(int32_t bitRate);
 
+    // Description of a sample of a movie fragment
+    struct FragmentSample {
+        uint32_t            mSize;
+        uint32_t            mDurationTicks;     // In track timescale
+        uint32_t            mCttsOffsetTicks;   // In track timescale
+        bool                mIsSync;
+    };
+
     struct Chunk {
         Track               *mTrack;        // Owner
         int64_t             mTimeStampUs;   // Timestamp of the 1st sample
         List<MediaBuffer *> mSamples;       // Sample data
+        size_t              mSizeBytes;     // Total size of the samples
+
+        // Fragmented file only: one entry per sample, and the decoding
+        // time of the 1st sample in track timescale
+        Vector<FragmentSample> mFragmentSamples;
+        int64_t             mDecodingTimeTicks;
 
         // Convenient constructor
-        Chunk(): mTrack(NULL), mTimeStampUs(0) {}
+        Chunk(): mTrack(NULL), mTimeStampUs(0), mSizeBytes(0),
+                 mDecodingTimeTicks(0) {}
 
         Chunk(Track *track, int64_t timeUs, List<MediaBuffer *> samples)
-            : mTrack(track), mTimeStampUs(timeUs), mSamples(samples) {
+            : mTrack(track), mTimeStampUs(timeUs), mSamples(samples),
+              mSizeBytes(0), mDecodingTimeTicks(0) {
         }
 
     };
@@ -140,6 +168,15 @@ private:
     List<ChunkInfo> mChunkInfos;            // Chunk infos
     Condition       mChunkReadyCondition;   // Signal that chunks are available
 
+    // Memory held by the chunks waiting for the writer thread. Track
+    // threads are held back in bufferChunk() above mChunkQueueBudgetBytes.
+    size_t          mQueuedChunkBytes;
+    size_t          mPeakQueuedChunkBytes;
+    size_t          mChunkQueueBudgetBytes;  // 0 for no limit
+    uint32_t        mNumChunkQueueWaits;
+    int64_t         mChunkQueueWaitTimeUs;
+    Condition       mChunkWrittenCondition;  // Signal that a chunk was written
+
     // Writer thread handling
     status_t startWriterThread();
     void stopWriterThread();
@@ -159,6 +196,10 @@ private:
     // Actually write the given chunk to the file.
     void writeChunkToFile(Chunk* chunk);
 
+    // Write the given chunk as a movie fragment, preceded by the
+    // moov box if it is the first one.
+    void writeFragmentToFile(Chunk* chunk);
+
     // Adjust other track media clock (presumably wall clock)
     // based on audio track media clock with the drift time.
     int64_t mDriftTimeUs;
@@ -182,15 +223,21 @@ private:
     // Acquire lock before calling these methods
     off64_t addSample_l(MediaBuffer *buffer);
     off64_t addLengthPrefixedSample_l(MediaBuffer *buffer);
+    // Writes and releases all the given samples, returns the offset of
+    // the first one.
+    off64_t addSamples_l(bool isAvc, List<MediaBuffer *> *samples);
 
     bool exceedsFileSizeLimit();
     bool use32BitFileOffset() const;
+    bool isFragmented() const { return mFragmentDurationUs > 0; }
+    int64_t fragmentDurationUs() const { return mFragmentDurationUs; }
     bool exceedsFileDurationLimit();
     bool isFileStreamable() const;
     void trackProgressStatus(size_t trackId, int64_t timeUs, status_t err = OK);
     void writeCompositionMatrix(int32_t degrees);
     void writeMvhdBox(int64_t durationUs);
     void writeMoovBox(int64_t durationUs);
+    void writeMvexBox(int64_t durationUs);
     void writeFtypBox(MetaData *param);
     void writeUdtaBox();
     void writeGeoDataBox();
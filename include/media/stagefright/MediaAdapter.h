@@ -21,10 +21,14 @@
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MetaData.h>
+#include <utils/KeyedVector.h>
+#include <utils/List.h>
 #include <utils/threads.h>
 
 namespace android {
 
+struct AMessage;
+
 // Convert the MediaMuxer's push model into MPEG4Writer's pull model.
 // Used only by the MediaMuxer for now.
 struct MediaAdapter : public MediaSource, public MediaBufferObserver {
@@ -56,14 +60,33 @@ public:
     // deep copy, such that after pushBuffer return, the buffer can be re-used.
     status_t pushBuffer(MediaBuffer *buffer);
 
+    // pushBufferAsync() takes ownership of the buffer and returns as soon as
+    // it is queued, only waiting while kMaxQueuedBuffers buffers are queued
+    // already. notify, if not NULL, is posted once the buffer is released.
+    // On error the buffer is not taken and notify is not posted.
+    status_t pushBufferAsync(MediaBuffer *buffer, const sp<AMessage> &notify);
+
 private:
+    enum {
+        kMaxQueuedBuffers = 16,
+        kDrainTimeOutNs = 1000000000LL,  // 1 second without progress
+    };
+
     Mutex mAdapterLock;
     // Make sure the read() wait for the incoming buffer.
     Condition mBufferReadCond;
-    // Make sure the pushBuffer() wait for the current buffer consumed.
+    // Make sure the pushBuffer() wait for the current buffer consumed, and
+    // pushBufferAsync() for room in the queue.
     Condition mBufferReturnedCond;
 
+    // Buffers pushed and not read yet, in order.
+    List<MediaBuffer *> mQueuedBuffers;
+    // The buffer pushBuffer() waits for, until it is returned.
     MediaBuffer *mCurrentMediaBuffer;
+    // Notifications of the buffers pushed by pushBufferAsync().
+    KeyedVector<MediaBuffer *, sp<AMessage> > mReleaseNotifications;
+
+    void releaseBuffer_l(MediaBuffer *buffer);
 
     bool mStarted;
     sp<MetaData> mOutputFormat;
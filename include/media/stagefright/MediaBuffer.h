@@ -96,6 +96,10 @@ private:
     // count to 0 without signalling the observer.
     void claim();
 
+    // For use by MediaBufferGroup, takes the first reference of a buffer whose reference
+    // count is 0. Fails if the buffer is in use, or another thread took it first.
+    bool tryAcquire();
+
     MediaBufferObserver *mObserver;
     MediaBuffer *mNextBuffer;
     int mRefCount;
@@ -36,7 +36,9 @@ public:
 
     // Blocks until a buffer is available and returns it to the caller,
     // the returned buffer will have a reference count of 1.
-    status_t acquire_buffer(MediaBuffer **buffer);
+    // If nonBlocking is true and no buffer is available, returns WOULD_BLOCK
+    // instead of waiting.
+    status_t acquire_buffer(MediaBuffer **buffer, bool nonBlocking = false);
 
 protected:
     virtual void signalBufferReturned(MediaBuffer *buffer);
@@ -44,11 +46,16 @@ protected:
 private:
     friend class MediaBuffer;
 
+    // Buffers are taken and returned without mLock, which only serializes add_buffer()
+    // and the threads waiting for a buffer.
     Mutex mLock;
     Condition mCondition;
+    volatile int32_t mNumWaiters;
 
     MediaBuffer *mFirstBuffer, *mLastBuffer;
 
+    MediaBuffer *tryAcquire();
+
     MediaBufferGroup(const MediaBufferGroup &);
     MediaBufferGroup &operator=(const MediaBufferGroup &);
 };
@@ -44,6 +44,14 @@ struct MediaCodec : public AHandler {
         BUFFER_FLAG_EOS         = 4,
     };
 
+    enum CallbackID {
+        CB_INPUT_AVAILABLE          = 1,
+        CB_OUTPUT_AVAILABLE         = 2,
+        CB_ERROR                    = 3,
+        CB_OUTPUT_FORMAT_CHANGED    = 4,
+        CB_OUTPUT_BUFFERS_CHANGED   = 5,
+    };
+
     static sp<MediaCodec> CreateByType(
             const sp<ALooper> &looper, const char *mime, bool encoder);
 
@@ -117,6 +125,16 @@ struct MediaCodec : public AHandler {
     // pending, an error is pending.
     void requestActivityNotification(const sp<AMessage> &notify);
 
+    // Switches the codec to asynchronous mode, must be called before start.
+    // A copy of "callback" is posted with "callbackID" set to one of the
+    // CallbackID values whenever an input buffer is free ("index"), an
+    // output buffer is ready ("index", "offset", "size", "timeUs", "flags"),
+    // the output format ("format") or the output buffers changed, or an
+    // error ("err") occurred. dequeueInputBuffer and dequeueOutputBuffer
+    // must not be used in this mode. A NULL callback reverts to
+    // synchronous mode.
+    status_t setCallback(const sp<AMessage> &callback);
+
     status_t getName(AString *componentName) const;
 
     status_t setParameters(const sp<AMessage> &params);
@@ -166,6 +184,7 @@ private:
         kWhatRequestActivityNotification    = 'racN',
         kWhatGetName                        = 'getN',
         kWhatSetParameters                  = 'setP',
+        kWhatSetCallback                    = 'setC',
     };
 
     enum {
@@ -179,6 +198,7 @@ private:
         kFlagSawMediaServerDie          = 128,
         kFlagIsEncoder                  = 256,
         kFlagGatherCodecSpecificData    = 512,
+        kFlagErrorCallbackPosted        = 1024,
     };
 
     struct BufferInfo {
@@ -196,6 +216,7 @@ private:
     AString mComponentName;
     uint32_t mReplyID;
     uint32_t mFlags;
+    status_t mStickyError;  // reported to the callback, valid while kFlagStickyError is set
     sp<Surface> mNativeWindow;
     SoftwareRenderer *mSoftRenderer;
     sp<AMessage> mOutputFormat;
@@ -214,6 +235,7 @@ private:
     List<sp<ABuffer> > mCSD;
 
     sp<AMessage> mActivityNotify;
+    sp<AMessage> mCallback;
 
     bool mHaveInputSurface;
 
@@ -234,6 +256,7 @@ private:
 
     bool handleDequeueInputBuffer(uint32_t replyID, bool newRequest = false);
     bool handleDequeueOutputBuffer(uint32_t replyID, bool newRequest = false);
+    void setOutputBufferInfo(const sp<AMessage> &msg, size_t index);
     void cancelPendingDequeueOperations();
 
     void extractCSD(const sp<AMessage> &format);
@@ -243,6 +266,7 @@ private:
             const sp<Surface> &surface);
 
     void postActivityNotificationIfPossible();
+    void postPendingCallbacks();
 
     status_t onSetParameters(const sp<AMessage> &params);
 
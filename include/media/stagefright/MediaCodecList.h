@@ -79,6 +79,12 @@ private:
     KeyedVector<AString, size_t> mCodecQuirks;
     KeyedVector<AString, size_t> mTypes;
 
+    // Lookup tables built once the list is complete. mCodecIndicesByType
+    // is keyed by (type bit << 1) | encoder and holds ascending indices
+    // into mCodecInfos.
+    KeyedVector<AString, size_t> mCodecIndicesByName;
+    KeyedVector<uint32_t, Vector<size_t> > mCodecIndicesByType;
+
     MediaCodecList();
     ~MediaCodecList();
 
@@ -100,6 +106,8 @@ private:
     status_t addTypeFromAttributes(const char **attrs);
     void addType(const char *name);
 
+    void buildLookupTables();
+
     friend class ExtendedUtils;
 
     DISALLOW_EVIL_CONSTRUCTORS(MediaCodecList);
@@ -114,6 +114,25 @@ public:
     status_t writeSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
                              int64_t timeUs, uint32_t flags) ;
 
+    /**
+     * Send a sample buffer for muxing without waiting for it to be written.
+     * The muxer keeps a reference to the buffer instead of copying it, and
+     * the buffer must not be modified until notify is posted, which happens
+     * once the writer is done with it. This method only blocks while the
+     * track already has a full queue of buffers waiting to be written.
+     * @param buffer the incoming sample buffer.
+     * @param trackIndex the buffer's track index number.
+     * @param timeUs the buffer's time stamp.
+     * @param flags the only supported flag for now is
+     *              MediaCodec::BUFFER_FLAG_SYNCFRAME.
+     * @param notify posted with the buffer set as "buffer" once it is
+     *               released, may be NULL. It is not posted on error.
+     * @return OK if no error.
+     */
+    status_t writeSampleDataAsync(const sp<ABuffer> &buffer, size_t trackIndex,
+                                  int64_t timeUs, uint32_t flags,
+                                  const sp<AMessage> &notify);
+
 private:
     sp<MPEG4Writer> mWriter;
     Vector< sp<MediaAdapter> > mTrackList;  // Each track has its MediaAdapter.
@@ -129,6 +148,9 @@ private:
     };
     State mState;
 
+    MediaBuffer *wrapSampleData(const sp<ABuffer> &buffer,
+                                int64_t timeUs, uint32_t flags);
+
     DISALLOW_EVIL_CONSTRUCTORS(MediaMuxer);
 };
 
@@ -74,6 +74,7 @@ enum {
     kKeyDecoderComponent  = 'decC',  // cstring
     kKeyBufferID          = 'bfID',
     kKeyMaxInputSize      = 'inpS',
+    kKeyMaxOutputSize     = 'outS',  // int32_t, lets decoders batch frames
     kKeyThumbnailTime     = 'thbT',  // int64_t (usecs)
     kKeyTrackID           = 'trID',
     kKeyIsDRM             = 'idrm',  // int32_t (bool)
@@ -89,6 +90,9 @@ enum {
     kKeyYear              = 'year',  // cstring
     kKeyAlbumArt          = 'albA',  // compressed image data
     kKeyAlbumArtMIME      = 'alAM',  // cstring
+    // Album art left in the extractor's data source instead of kKeyAlbumArt.
+    kKeyAlbumArtOffset    = 'alAO',  // int64_t
+    kKeyAlbumArtSize      = 'alAS',  // int32_t
     kKeyAuthor            = 'auth',  // cstring
     kKeyCDTrackNumber     = 'cdtr',  // cstring
     kKeyDiscNumber        = 'dnum',  // cstring
@@ -106,6 +110,10 @@ enum {
     kKey64BitFileOffset   = 'fobt',  // int32_t (bool)
     kKey2ByteNalLength    = '2NAL',  // int32_t (bool)
 
+    // Set this key to author a fragmented file, in movie fragments
+    // of about the given duration
+    kKeyFragmentDurationUs = 'frgd',  // int64_t
+
     // Identify the file output format for authoring
     // Please see <media/mediarecorder.h> for the supported
     // file output formats.
@@ -232,6 +240,9 @@ private:
         typed_data &operator=(const MetaData::typed_data &);
 
         void clear();
+        bool isEmpty() const {
+            return mType == 0;
+        }
         void setData(uint32_t type, const void *data, size_t size);
         void getData(uint32_t *type, const void **data, size_t *size) const;
         String8 asString() const;
@@ -240,9 +251,11 @@ private:
         uint32_t mType;
         size_t mSize;
 
+        // values of up to 16 bytes, which covers all the types but strings and
+        // codec specific data, are stored inline without an allocation
         union {
             void *ext_data;
-            float reservoir;
+            int64_t reservoir[2];
         } u;
 
         bool usesReservoir() const {
@@ -265,6 +278,8 @@ private:
         int32_t mLeft, mTop, mRight, mBottom;
     };
 
+    // Copies share the storage of the vector until either side is modified. Items emptied
+    // by clear() stay in place so that the storage is reused when the keys are set again.
     KeyedVector<uint32_t, typed_data> mItems;
 
     // MetaData &operator=(const MetaData &);
@@ -67,6 +67,13 @@ struct NuMediaExtractor : public RefBase {
 
     status_t advance();
     status_t readSampleData(const sp<ABuffer> &buffer);
+
+    // Hands out the current sample without copying it and advances to the
+    // next one. The returned buffer references the track source's own
+    // buffer, its "timeUs" meta entry holds the sample time. Sources may
+    // have a single buffer per track, so it must be released before the
+    // next call into the extractor that reads from the same track.
+    status_t readSampleBuffer(sp<ABuffer> *buffer);
     status_t getSampleTrackIndex(size_t *trackIndex);
     status_t getSampleTime(int64_t *sampleTimeUs);
     status_t getSampleMeta(sp<MetaData> *sampleMeta);
@@ -109,6 +116,9 @@ private:
 
     void releaseTrackSamples();
 
+    size_t getSampleSize(const TrackInfo *info) const;
+    void copySample(const TrackInfo *info, uint8_t *dst) const;
+
     bool getTotalBitrate(int64_t *bitRate) const;
     void updateDurationAndBitrate();
 
@@ -60,6 +60,11 @@ struct OMXCodec : public MediaSource,
 
         // Secure decoding mode
         kUseSecureInputBuffers = 256,
+
+        // Decode through MediaCodec instead of driving the component
+        // directly, see also the media.stagefright.omxcodec.mediacodec
+        // property. Ignored where the MediaCodec path can't be used.
+        kUseMediaCodec = 512,
     };
     static sp<MediaSource> Create(
             const sp<IOMX> &omx,
@@ -32,6 +32,11 @@ struct ABuffer : public RefBase {
     ABuffer(size_t capacity);
     ABuffer(void *data, size_t capacity);
 
+    // Same as ABuffer(capacity), with the payload taken from a process wide pool of
+    // recently freed payloads of the same size class, and returned to it when the buffer
+    // is destroyed. Meant for the buffers allocated per packet or access unit.
+    static sp<ABuffer> CreatePooled(size_t capacity);
+
     void setFarewellMessage(const sp<AMessage> msg);
 
     uint8_t *base() { return (uint8_t *)mData; }
@@ -63,6 +68,9 @@ private:
 
     bool mOwnsData;
 
+    // size class of the payload in the pool, or -1 if it was malloc'ed
+    int32_t mPoolClass;
+
     DISALLOW_EVIL_CONSTRUCTORS(ABuffer);
 };
 
@@ -53,6 +53,10 @@ struct ALooper : public RefBase {
 
     static int64_t GetNowUs();
 
+    // Appends the queue statistics of every looper with a registered handler to s,
+    // for dumpsys.
+    static void DumpStats(AString *s);
+
 protected:
     virtual ~ALooper();
 
@@ -71,12 +75,18 @@ private:
 
     List<Event> mEventQueue;
 
+    // how late the messages were delivered compared to the time they were posted for
+    uint32_t mNumDelivered;
+    int64_t mTotalLatencyUs;
+    int64_t mMaxLatencyUs;
+
     struct LooperThread;
     sp<LooperThread> mThread;
     bool mRunningLocally;
 
     void post(const sp<AMessage> &msg, int64_t delayUs);
     bool loop();
+    void dumpStats(AString *s);
 
     DISALLOW_EVIL_CONSTRUCTORS(ALooper);
 };
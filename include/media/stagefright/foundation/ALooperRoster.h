@@ -42,6 +42,8 @@ struct ALooperRoster {
 
     sp<ALooper> findLooper(ALooper::handler_id handlerID);
 
+    void dumpStats(AString *s);
+
 private:
     struct HandlerInfo {
         wp<ALooper> mLooper;
@@ -20,6 +20,7 @@
 
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/KeyedVector.h>
+#include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/Thread.h>
 
@@ -27,14 +28,18 @@
 
 namespace android {
 
+struct ABuffer;
 struct AMessage;
 
 // Helper class to manage a number of live sockets (datagram and stream-based)
-// on a single thread. Clients are notified about activity through AMessages.
+// on one or more threads. Clients are notified about activity through
+// AMessages.
 struct ANetworkSession : public RefBase {
     ANetworkSession();
 
-    status_t start();
+    // Sessions are spread over "numThreads" I/O threads, the
+    // notifications of any one session are posted in order.
+    status_t start(size_t numThreads = 1);
     status_t stop();
 
     status_t createRTSPClient(
@@ -77,6 +82,13 @@ struct ANetworkSession : public RefBase {
             int32_t sessionID, const void *data, ssize_t size = -1,
             bool timeValid = false, int64_t timeUs = -1ll);
 
+    // Queues all of "datagrams" with a single wakeup of the session's
+    // thread. UDP sessions send the buffers themselves, which must not be
+    // changed afterwards. The time, if valid, goes with the last one.
+    status_t sendDatagrams(
+            int32_t sessionID, const List<sp<ABuffer> > &datagrams,
+            bool timeValid = false, int64_t timeUs = -1ll);
+
     status_t switchToWebSocketMode(int32_t sessionID);
 
     enum NotificationReason {
@@ -88,6 +100,10 @@ struct ANetworkSession : public RefBase {
         kWhatBinaryData,
         kWhatWebSocketMessage,
         kWhatNetworkStall,
+
+        // Every few seconds for sessions sending timed data, the average
+        // and maximum time from the timestamp of a send to its write.
+        kWhatSendLatency,
     };
 
 protected:
@@ -98,12 +114,10 @@ private:
     struct Session;
 
     Mutex mLock;
-    sp<Thread> mThread;
+    Vector<sp<NetworkThread> > mThreads;
 
     int32_t mNextSessionID;
 
-    int mPipeFd[2];
-
     KeyedVector<int32_t, sp<Session> > mSessions;
 
     enum Mode {
@@ -122,8 +136,8 @@ private:
             const sp<AMessage> &notify,
             int32_t *sessionID);
 
-    void threadLoop();
-    void interrupt();
+    void addSessionToThreadLocked(const sp<Session> &session);
+    void addClientSession(int s, bool isRTSP, const sp<AMessage> &notify);
 
     static status_t MakeSocketNonBlocking(int s);
 
@@ -19,10 +19,12 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include <utils/threads.h>
 #include <utils/Log.h>
 #include <utils/RefBase.h>
+#include <media/AudioTimestamp.h>
 #include <media/nbaio/roundup.h>
 #include <media/SingleStateQueue.h>
 #include <private/media/StaticAudioTrackState.h>
@@ -46,6 +48,8 @@ namespace android {
 #define CBLK_OVERRUN   0x100 // set by server immediately on input overrun, cleared by client
 #define CBLK_INTERRUPT 0x200 // set by client on interrupt(), cleared by client in obtainBuffer()
 #define CBLK_STREAM_END_DONE 0x400 // set by server on render completion, cleared by client
+#define CBLK_WATERMARK 0x800 // set by client: mMinimum is a refill watermark, so server must not
+                             // limit it to half the buffer
 
 //EL_FIXME 20 seconds may not be enough and must be reconciled with new obtainBuffer implementation
 #define MAX_RUN_OFFLOADED_TIMEOUT_MS 20000 //assuming upto a maximum of 20 seconds of offloaded
@@ -69,6 +73,16 @@ struct AudioTrackSharedStatic {
                                         // "for entertainment purposes only"
 };
 
+// Presentation timestamp published by the server every mix cycle, so that the client can read it
+// without a binder call.  Protected by a sequence lock: the server is the only writer, and makes
+// mSequence odd while it updates the other fields; a reader retries if mSequence was odd or changed.
+struct AudioTrackSharedTimestamp {
+    volatile int32_t    mSequence;  // 0 if no timestamp has been published
+    uint32_t            mPosition;  // in frames released by server, not including client's epoch
+    struct timespec     mTime;      // CLOCK_MONOTONIC when mPosition is expected to be presented,
+                                    // or 0 if the timestamp has been withdrawn by the server
+};
+
 // ----------------------------------------------------------------------------
 
 // Important: do not add any virtual methods, including ~
@@ -138,6 +152,9 @@ public:
                 } u;
 
                 // Cache line boundary (32 bytes)
+
+                // AudioTrack only, written by server and read by client
+                AudioTrackSharedTimestamp   mTimestamp;
 };
 
 // ----------------------------------------------------------------------------
@@ -220,6 +237,24 @@ public:
     status_t    obtainBuffer(Buffer* buffer, const struct timespec *requested = NULL,
             struct timespec *elapsed = NULL);
 
+    // Batched variant of obtainBuffer(), for callers that would otherwise make a second call
+    // when the available frames wrap around the end of the buffer.
+    // buffers[0] is set as by obtainBuffer(), except that on entry its mFrameCount is the
+    // maximum total number of desired frames in both buffers.
+    // buffers[1] is set to the frames available from the start of the buffer, up to that total,
+    // and has mFrameCount 0 if there are none; its mNonContig is the remaining available frames.
+    // Both buffers are then released in one call to releaseBuffer(), whose mFrameCount is the sum.
+    status_t    obtainBuffers(Buffer buffers[2], const struct timespec *requested = NULL,
+            struct timespec *elapsed = NULL);
+
+    // Enable or disable the refill watermark mode, for playback only.
+    // When refill > 0, the server wakes up the client only once at least refill frames are
+    // available to the client, even if that is more than half of the buffer, and a blocking
+    // obtainBuffer() does not return until that many frames are available, so that the client
+    // wakes up once per refill.  Non-blocking calls still return whatever is available.
+    // When refill == 0, the caller should also restore the previous minimum with setMinimum().
+    void        setWatermark(size_t refill);
+
     // Release (some of) the frames last obtained.
     // On entry, buffer->mFrameCount should have the number of frames to release,
     // which must (cumulatively) be <= the number of frames last obtained but not yet released.
@@ -260,6 +295,7 @@ public:
 
 private:
     size_t      mEpoch;
+    size_t      mWatermark;     // 0, or minimum frames for a blocking obtainBuffer() to return
 };
 
 // ----------------------------------------------------------------------------
@@ -301,6 +337,11 @@ public:
     bool        getStreamEndDone() const;
 
     status_t    waitStreamEndDone(const struct timespec *requested);
+
+    // Return the most recent presentation timestamp published by the server, without
+    // blocking and without a binder call.  The position does not include the epoch.
+    // Returns WOULD_BLOCK if the server has not published one since the track was last reset.
+    status_t    getTimestamp(AudioTimestamp& timestamp) const;
 };
 
 class StaticAudioTrackClientProxy : public AudioTrackClientProxy {
@@ -426,6 +467,14 @@ public:
 
     // Return the total number of frames that AudioFlinger has obtained and released
     virtual size_t      framesReleased() const { return mCblk->mServer; }
+
+    // Publish the presentation timestamp for AudioTrackClientProxy::getTimestamp(),
+    // or withdraw it until the next call to setTimestamp()
+    void                setTimestamp(const AudioTimestamp& timestamp);
+    void                clearTimestamp();
+
+private:
+    void                writeTimestamp(int32_t sequence, const AudioTimestamp& timestamp);
 };
 
 class StaticAudioTrackServerProxy : public AudioTrackServerProxy {
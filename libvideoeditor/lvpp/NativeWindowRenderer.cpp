@@ -78,38 +78,21 @@ static const char fSrcNormal[] =
     "  gl_FragColor = texture2D(texSampler, texCoords);\n"
     "}\n";
 
-static const char fSrcSepia[] =
-    "#extension GL_OES_EGL_image_external : require\n"
-    "precision mediump float;\n"
-    "uniform samplerExternalOES texSampler;\n"
-    "varying vec2 texCoords;\n"
-    RGB2YUV_MATRIX
-    YUV2RGB_MATRIX
-    "void main() {\n"
-    "  vec4 rgb = texture2D(texSampler, texCoords);\n"
-    "  vec4 yuv = rgb2yuv * rgb;\n"
-    "  yuv = vec4(yuv.x, 117.0, 139.0, 1.0);\n"
-    "  gl_FragColor = yuv2rgb * yuv;\n"
-    "}\n";
-
-static const char fSrcNegative[] =
-    "#extension GL_OES_EGL_image_external : require\n"
-    "precision mediump float;\n"
-    "uniform samplerExternalOES texSampler;\n"
-    "varying vec2 texCoords;\n"
-    RGB2YUV_MATRIX
-    YUV2RGB_MATRIX
-    "void main() {\n"
-    "  vec4 rgb = texture2D(texSampler, texCoords);\n"
-    "  vec4 yuv = rgb2yuv * rgb;\n"
-    "  yuv = vec4(255.0 - yuv.x, yuv.y, yuv.z, 1.0);\n"
-    "  gl_FragColor = yuv2rgb * yuv;\n"
-    "}\n";
-
-static const char fSrcGradient[] =
+// The effects program works in YUV space like the VSS color effects
+// (see M4VSS3GPP_externalVideoEffectColor and M4VFL_modifyLumaWithScale):
+// luma may be negated and scaled by the fade factor, chroma may be replaced
+// by a constant (faded to 128 from top to bottom for the gradient effect)
+// and is pulled towards 128 at the end of a fade.
+static const char fSrcEffects[] =
     "#extension GL_OES_EGL_image_external : require\n"
     "precision mediump float;\n"
     "uniform samplerExternalOES texSampler;\n"
+    "uniform float negate;\n"
+    "uniform float lumaScale;\n"
+    "uniform float chromaScale;\n"
+    "uniform float replaceChroma;\n"
+    "uniform float gradient;\n"
+    "uniform vec2 chroma;\n"
     "varying vec2 texCoords;\n"
     "varying float topDown;\n"
     RGB2YUV_MATRIX
@@ -117,10 +100,10 @@ static const char fSrcGradient[] =
     "void main() {\n"
     "  vec4 rgb = texture2D(texSampler, texCoords);\n"
     "  vec4 yuv = rgb2yuv * rgb;\n"
-    "  vec4 mixin = vec4(15.0/31.0, 59.0/63.0, 31.0/31.0, 1.0);\n"
-    "  vec4 yuv2 = rgb2yuv * vec4((mixin.xyz * topDown), 1);\n"
-    "  yuv = vec4(yuv.x, yuv2.y, yuv2.z, 1);\n"
-    "  gl_FragColor = yuv2rgb * yuv;\n"
+    "  float y = mix(yuv.x, 255.0 - yuv.x, negate) * lumaScale;\n"
+    "  vec2 uv = mix(yuv.yz, chroma, replaceChroma) - 128.0;\n"
+    "  uv *= mix(1.0, topDown, gradient) * chromaScale;\n"
+    "  gl_FragColor = yuv2rgb * vec4(y, uv + 128.0, 1.0);\n"
     "}\n";
 
 namespace android {
@@ -130,7 +113,7 @@ NativeWindowRenderer::NativeWindowRenderer(sp<ANativeWindow> nativeWindow,
     : mNativeWindow(nativeWindow)
     , mDstWidth(width)
     , mDstHeight(height)
-    , mLastVideoEffect(-1)
+    , mLastProgram(-1)
     , mNextTextureId(100)
     , mActiveInputs(0)
     , mThreadCmd(CMD_IDLE) {
@@ -229,11 +212,11 @@ void NativeWindowRenderer::createPrograms() {
     GLuint vShader;
     loadShader(GL_VERTEX_SHADER, vSrcNormal, &vShader);
 
-    const char* fSrc[NUMBER_OF_EFFECTS] = {
-        fSrcNormal, fSrcSepia, fSrcNegative, fSrcGradient
+    const char* fSrc[NUMBER_OF_PROGRAMS] = {
+        fSrcNormal, fSrcEffects
     };
 
-    for (int i = 0; i < NUMBER_OF_EFFECTS; i++) {
+    for (int i = 0; i < NUMBER_OF_PROGRAMS; i++) {
         GLuint fShader;
         loadShader(GL_FRAGMENT_SHADER, fSrc[i], &fShader);
         createProgram(vShader, fShader, &mProgram[i]);
@@ -339,7 +322,7 @@ void NativeWindowRenderer::render(RenderInput* input) {
          1.0f,  1.0f,
     };
 
-    updateProgramAndHandle(input->mVideoEffect);
+    updateProgramAndHandle(input->mEffectParams);
 
     glVertexAttribPointer(mPositionHandle, 2, GL_FLOAT, GL_FALSE, 0,
         mPositionCoordinates);
@@ -438,36 +421,86 @@ void NativeWindowRenderer::copyI420Buffer(MediaBuffer* src, uint8_t* dst,
     }
 }
 
-void NativeWindowRenderer::updateProgramAndHandle(uint32_t videoEffect) {
-    if (mLastVideoEffect == videoEffect) {
-        return;
+void NativeWindowRenderer::updateProgramAndHandle(
+        const VideoEffectParams& params) {
+    // Framing is drawn by the application as an overlay and the fifties
+    // effect is not supported in preview, so neither needs the effects program.
+    uint32_t effects = params.effects &
+            ~(VIDEO_EFFECT_FRAMING | VIDEO_EFFECT_FIFTIES);
+    int i = (effects == VIDEO_EFFECT_NONE) ? PROGRAM_NORMAL : PROGRAM_EFFECTS;
+
+    if (mLastProgram != i) {
+        mLastProgram = i;
+        glUseProgram(mProgram[i]);
+        CHECK_GL_ERROR;
+
+        mPositionHandle = glGetAttribLocation(mProgram[i], "vPosition");
+        mTexPosHandle = glGetAttribLocation(mProgram[i], "vTexPos");
+        mTexMatrixHandle = glGetUniformLocation(mProgram[i], "texMatrix");
+        if (i == PROGRAM_EFFECTS) {
+            mNegateHandle = glGetUniformLocation(mProgram[i], "negate");
+            mLumaScaleHandle = glGetUniformLocation(mProgram[i], "lumaScale");
+            mChromaScaleHandle = glGetUniformLocation(mProgram[i], "chromaScale");
+            mReplaceChromaHandle = glGetUniformLocation(mProgram[i], "replaceChroma");
+            mGradientHandle = glGetUniformLocation(mProgram[i], "gradient");
+            mChromaHandle = glGetUniformLocation(mProgram[i], "chroma");
+        }
+        CHECK_GL_ERROR;
     }
 
-    mLastVideoEffect = videoEffect;
-    int i;
-    switch (mLastVideoEffect) {
-        case VIDEO_EFFECT_NONE:
-            i = 0;
-            break;
-        case VIDEO_EFFECT_SEPIA:
-            i = 1;
-            break;
-        case VIDEO_EFFECT_NEGATIVE:
-            i = 2;
-            break;
-        case VIDEO_EFFECT_GRADIENT:
-            i = 3;
-            break;
-        default:
-            i = 0;
-            break;
+    if (i == PROGRAM_EFFECTS) {
+        setEffectUniforms(params);
+    }
+}
+
+void NativeWindowRenderer::setEffectUniforms(const VideoEffectParams& params) {
+    uint32_t effects = params.effects;
+
+    // The chroma replacing effects are applied in the same order as
+    // applyEffectsAndRenderingMode() does, so the last one wins.
+    GLfloat replaceChroma = 1.0f;
+    GLfloat gradient = 0.0f;
+    GLfloat u = 128.0f, v = 128.0f;
+    if (effects & VIDEO_EFFECT_COLOR_RGB16) {
+        uint16_t rgb = params.colorRGB16;
+        u = U16((rgb & 0xf800) >> 11, (rgb & 0x07e0) >> 5, rgb & 0x001f);
+        v = V16((rgb & 0xf800) >> 11, (rgb & 0x07e0) >> 5, rgb & 0x001f);
+    } else if (effects & VIDEO_EFFECT_GRADIENT) {
+        uint16_t rgb = params.gradientRGB16;
+        u = U16((rgb & 0xf800) >> 11, (rgb & 0x07e0) >> 5, rgb & 0x001f);
+        v = V16((rgb & 0xf800) >> 11, (rgb & 0x07e0) >> 5, rgb & 0x001f);
+        gradient = 1.0f;
+    } else if (effects & VIDEO_EFFECT_SEPIA) {
+        u = 117.0f;
+        v = 139.0f;
+    } else if (effects & VIDEO_EFFECT_GREEN) {
+        u = 0.0f;
+        v = 0.0f;
+    } else if (effects & VIDEO_EFFECT_PINK) {
+        u = 255.0f;
+        v = 255.0f;
+    } else if (!(effects & VIDEO_EFFECT_BLACKANDWHITE)) {
+        replaceChroma = 0.0f;
+    }
+
+    // Fading scales luma, and also desaturates chroma once the luma
+    // factor drops to a quarter, as M4VFL_modifyLumaWithScale() does.
+    GLfloat lumaScale = 1.0f;
+    GLfloat chromaScale = 1.0f;
+    if (effects & (VIDEO_EFFECT_FADEFROMBLACK | VIDEO_EFFECT_FADETOBLACK)) {
+        lumaScale = params.fadeLumaFactor / 1024.0f;
+        if (params.fadeLumaFactor <= 256) {
+            chromaScale = lumaScale;
+        }
     }
-    glUseProgram(mProgram[i]);
-    CHECK_GL_ERROR;
 
-    mPositionHandle = glGetAttribLocation(mProgram[i], "vPosition");
-    mTexPosHandle = glGetAttribLocation(mProgram[i], "vTexPos");
-    mTexMatrixHandle = glGetUniformLocation(mProgram[i], "texMatrix");
+    glUniform1f(mNegateHandle,
+            (effects & VIDEO_EFFECT_NEGATIVE) ? 1.0f : 0.0f);
+    glUniform1f(mLumaScaleHandle, lumaScale);
+    glUniform1f(mChromaScaleHandle, chromaScale);
+    glUniform1f(mReplaceChromaHandle, replaceChroma);
+    glUniform1f(mGradientHandle, gradient);
+    glUniform2f(mChromaHandle, u, v);
     CHECK_GL_ERROR;
 }
 
@@ -605,9 +638,10 @@ void RenderInput::updateVideoSize(sp<MetaData> meta) {
     }
 }
 
-void RenderInput::render(MediaBuffer* buffer, uint32_t videoEffect,
+void RenderInput::render(MediaBuffer* buffer,
+        const VideoEffectParams& effectParams,
         M4xVSS_MediaRendering renderingMode, bool isExternalBuffer) {
-    mVideoEffect = videoEffect;
+    mEffectParams = effectParams;
     mRenderingMode = renderingMode;
     mIsExternalBuffer = isExternalBuffer;
     mBuffer = buffer;
@@ -30,7 +30,10 @@
 // an ANativeWindow.  It can apply "rendering mode" and color effects to
 // the frames. "Rendering mode" is the option to do resizing, cropping,
 // or black-bordering when the source and destination aspect ratio are
-// different. Color effects include sepia, negative, and gradient.
+// different. Color effects include black and white, pink, green, sepia,
+// negative, gradient, RGB16 color and the fades to and from black, all
+// applied by one fragment shader so the decoded frame is never touched
+// by the CPU.
 //
 // The input to NativeWindowRenderer is provided by the RenderInput class,
 // and there can be multiple active RenderInput at the same time. Although
@@ -49,6 +52,20 @@ class GLConsumer;
 class Surface;
 class RenderInput;
 
+// Per-frame parameters of the video effects applied while rendering.
+struct VideoEffectParams {
+    VideoEffectParams()
+        : effects(0), colorRGB16(0), gradientRGB16(0), fadeLumaFactor(1024) {}
+
+    // VIDEO_EFFECT_* bits as defined in VideoEditorTools.h
+    uint32_t effects;
+    // RGB565 colors used by VIDEO_EFFECT_COLOR_RGB16 and VIDEO_EFFECT_GRADIENT
+    uint16_t colorRGB16;
+    uint16_t gradientRGB16;
+    // Luma scale of the fade effects, 0 (black) to 1024 (unchanged)
+    int32_t fadeLumaFactor;
+};
+
 class NativeWindowRenderer {
 public:
     NativeWindowRenderer(sp<ANativeWindow> nativeWindow, int width, int height);
@@ -78,7 +95,8 @@ private:
             int width, int height);
     void copyI420Buffer(MediaBuffer* src, uint8_t* dst,
             int srcWidth, int srcHeight, int stride);
-    void updateProgramAndHandle(uint32_t videoEffect);
+    void updateProgramAndHandle(const VideoEffectParams& params);
+    void setEffectUniforms(const VideoEffectParams& params);
     void calculatePositionCoordinates(M4xVSS_MediaRendering renderingMode,
             int srcWidth, int srcHeight);
 
@@ -89,21 +107,26 @@ private:
     EGLSurface mEglSurface;
     EGLContext mEglContext;
     enum {
-        EFFECT_NORMAL,
-        EFFECT_SEPIA,
-        EFFECT_NEGATIVE,
-        EFFECT_GRADIENT,
-        NUMBER_OF_EFFECTS
+        PROGRAM_NORMAL,
+        PROGRAM_EFFECTS,
+        NUMBER_OF_PROGRAMS
     };
-    GLuint mProgram[NUMBER_OF_EFFECTS];
+    GLuint mProgram[NUMBER_OF_PROGRAMS];
 
-    // We use one shader program for each effect. mLastVideoEffect remembers
-    // the program used for the last frame. when the effect used changes,
-    // we change the program used and update the handles.
-    uint32_t mLastVideoEffect;
+    // Frames without effects use a plain copy program, all other frames use
+    // the effects program whose behaviour is driven by uniforms.
+    // mLastProgram remembers the program used for the last frame. When it
+    // changes, we change the program used and update the handles.
+    int mLastProgram;
     GLint mPositionHandle;
     GLint mTexPosHandle;
     GLint mTexMatrixHandle;
+    GLint mNegateHandle;
+    GLint mLumaScaleHandle;
+    GLint mChromaScaleHandle;
+    GLint mReplaceChromaHandle;
+    GLint mGradientHandle;
+    GLint mChromaHandle;
 
     // This is the vertex coordinates used for the frame texture.
     // It's calculated according the the rendering mode and the source and
@@ -153,11 +176,11 @@ public:
     // we look for kKeyWidth, kKeyHeight, and (optionally) kKeyCropRect.
     void updateVideoSize(sp<MetaData> meta);
 
-    // Renders the buffer with the given video effect and rending mode.
+    // Renders the buffer with the given video effects and rending mode.
     // The video effets are defined in VideoEditorTools.h
     // Set isExternalBuffer to true only when the buffer given is not
     // provided by the Surface.
-    void render(MediaBuffer *buffer, uint32_t videoEffect,
+    void render(MediaBuffer *buffer, const VideoEffectParams& effectParams,
         M4xVSS_MediaRendering renderingMode, bool isExternalBuffer);
 private:
     RenderInput(NativeWindowRenderer* renderer, GLuint textureId);
@@ -169,7 +192,7 @@ private:
     int mWidth, mHeight;
 
     // These are only valid during render() calls
-    uint32_t mVideoEffect;
+    VideoEffectParams mEffectParams;
     M4xVSS_MediaRendering mRenderingMode;
     bool mIsExternalBuffer;
     MediaBuffer* mBuffer;
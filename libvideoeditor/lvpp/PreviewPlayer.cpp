@@ -1062,7 +1062,9 @@ void PreviewPlayer::onVideoEvent() {
     }
 
     if (mVideoRenderer != NULL) {
-        mVideoRenderer->render(mVideoBuffer, mCurrentVideoEffect,
+        VideoEffectParams effectParams;
+        getVideoEffectParams_l(timeUs, &effectParams);
+        mVideoRenderer->render(mVideoBuffer, effectParams,
                 mRenderingMode, mIsVideoSourceJpg);
     }
 
@@ -1454,6 +1456,58 @@ void PreviewPlayer::setVideoPostProcessingNode(
     }
 }
 
+void PreviewPlayer::getVideoEffectParams_l(
+        int64_t timeUs, VideoEffectParams* params) {
+
+    params->effects = mCurrentVideoEffect;
+    if (!(mCurrentVideoEffect & (VIDEO_EFFECT_COLOR_RGB16 |
+            VIDEO_EFFECT_GRADIENT | VIDEO_EFFECT_FADEFROMBLACK |
+            VIDEO_EFFECT_FADETOBLACK))) {
+        return;
+    }
+
+    // Same clip-relative time as used to enable the effects above
+    M4OSA_Int64 ctsMs =
+        ((timeUs + mDecVideoTsStoryBoard) / 1000) - mPlayBeginTimeMsec;
+
+    for (uint32_t i = 0; i < mNumberEffects; i++) {
+        const M4VSS3GPP_EffectSettings& settings = mEffectsSettings[i];
+        if ((settings.uiStartTime > ctsMs) ||
+            ((settings.uiStartTime + settings.uiDuration) < ctsMs) ||
+            (settings.uiDuration == 0)) {
+            continue;
+        }
+
+        M4OSA_Double percentageDone = 0;
+        switch ((M4OSA_UInt32)settings.VideoEffectType) {
+            case M4xVSS_kVideoEffectType_ColorRGB16:
+                params->colorRGB16 = settings.xVSS.uiRgb16InputColor;
+                break;
+
+            case M4xVSS_kVideoEffectType_Gradient:
+                params->gradientRGB16 = settings.xVSS.uiRgb16InputColor;
+                break;
+
+            case M4VSS3GPP_kVideoEffectType_FadeFromBlack:
+                computePercentageDone((M4OSA_UInt32)ctsMs, settings.uiStartTime,
+                    settings.uiDuration, &percentageDone);
+                params->fadeLumaFactor = (params->fadeLumaFactor *
+                    (M4OSA_Int32)(percentageDone * 1024)) >> 10;
+                break;
+
+            case M4VSS3GPP_kVideoEffectType_FadeToBlack:
+                computePercentageDone((M4OSA_UInt32)ctsMs, settings.uiStartTime,
+                    settings.uiDuration, &percentageDone);
+                params->fadeLumaFactor = (params->fadeLumaFactor *
+                    (M4OSA_Int32)((1.0 - percentageDone) * 1024)) >> 10;
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
 status_t PreviewPlayer::setImageClipProperties(uint32_t width,uint32_t height) {
     mVideoWidth = width;
     mVideoHeight = height;
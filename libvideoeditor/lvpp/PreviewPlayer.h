@@ -272,6 +272,7 @@ private:
     void postVideoEvent_l(int64_t delayUs = -1);
     void setVideoPostProcessingNode(
                     M4VSS3GPP_VideoEffectType type, M4OSA_Bool enable);
+    void getVideoEffectParams_l(int64_t timeUs, VideoEffectParams* params);
     void postProgressCallbackEvent_l();
     void shutdownVideoDecoder_l();
     void onProgressCbEvent();
@@ -45,6 +45,45 @@ VideoEditorBGAudioProcessing::VideoEditorBGAudioProcessing() {
     mBTChannelCount = 1;
 }
 
+static inline M4OSA_Int16 clamp16(M4OSA_Int32 sample) {
+    if ((sample >> 15) ^ (sample >> 31)) {
+        sample = 0x7FFF ^ (sample >> 31);
+    }
+    return (M4OSA_Int16)sample;
+}
+
+static inline M4OSA_Int32 toGain(M4OSA_Float volume) {
+    if (volume <= 0.0) {
+        return 0;
+    }
+    if (volume >= VideoEditorBGAudioProcessing::kMaxGain) {
+        return VideoEditorBGAudioProcessing::kMaxGain
+                << VideoEditorBGAudioProcessing::kGainShift;
+    }
+    return (M4OSA_Int32)(volume * (1 << VideoEditorBGAudioProcessing::kGainShift));
+}
+
+// Returns the peak absolute amplitude of the samples.
+static M4OSA_Int32 peakAmplitude(const M4OSA_Int16 *data, size_t n) {
+    M4OSA_Int32 peak = 0;
+    for (size_t i = 0; i < n; ++i) {
+        M4OSA_Int32 v = data[i];
+        v = (v < 0) ? -v : v;
+        peak = (v > peak) ? v : peak;
+    }
+    return peak;
+}
+
+// out[i] = clamp(pt[i] * ptGain + bt[i] * btGain), gains in Q(kGainShift).
+// The loop has no data dependent branches so the compiler can vectorize it.
+static void mixBlock(M4OSA_Int16 *out, const M4OSA_Int16 *pt,
+        const M4OSA_Int16 *bt, size_t n, M4OSA_Int32 ptGain, M4OSA_Int32 btGain) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = clamp16((pt[i] * ptGain + bt[i] * btGain)
+                >> VideoEditorBGAudioProcessing::kGainShift);
+    }
+}
+
 M4OSA_Int32 VideoEditorBGAudioProcessing::mixAndDuck(
         void *primaryTrackBuffer,
         void *backgroundTrackBuffer,
@@ -58,42 +97,26 @@ M4OSA_Int32 VideoEditorBGAudioProcessing::mixAndDuck(
     M4AM_Buffer16* pBackgroundTrack = (M4AM_Buffer16*)backgroundTrackBuffer;
     M4AM_Buffer16* pMixedOutBuffer  = (M4AM_Buffer16*)outBuffer;
 
+    const M4OSA_Int16 *pPTdata = (M4OSA_Int16*)pPrimaryTrack->m_dataAddress;
+    const M4OSA_Int16 *pBTdata = (M4OSA_Int16*)pBackgroundTrack->m_dataAddress;
+    M4OSA_Int16 *pOutData = (M4OSA_Int16*)pMixedOutBuffer->m_dataAddress;
+
     // Output size if same as PT size
     pMixedOutBuffer->m_bufferSize = pPrimaryTrack->m_bufferSize;
 
-    // Before mixing, we need to have only PT as out buffer
-    memcpy((void *)pMixedOutBuffer->m_dataAddress,
-        (void *)pPrimaryTrack->m_dataAddress, pMixedOutBuffer->m_bufferSize);
-
-    // Initialize ducking variables
-    // Initially contains the input primary track
-    M4OSA_Int16 *pPTMdata2 = (M4OSA_Int16*)pMixedOutBuffer->m_dataAddress;
-
-    // Contains BG track processed data(like channel conversion etc..
-    M4OSA_Int16 *pBTMdata1 = (M4OSA_Int16*) pBackgroundTrack->m_dataAddress;
-
     // Since we need to give sample count and not buffer size
-    M4OSA_UInt32 uiPCMsize = pMixedOutBuffer->m_bufferSize / 2 ;
+    size_t n = pPrimaryTrack->m_bufferSize / sizeof(M4OSA_Int16);
+    if (pBackgroundTrack->m_bufferSize / sizeof(M4OSA_Int16) < n) {
+        n = pBackgroundTrack->m_bufferSize / sizeof(M4OSA_Int16);
+    }
 
+    // The ducking decision is made on the primary track samples that are
+    // about to be mixed, so the background track is already on its way down
+    // while the loud primary track block plays.
+    M4OSA_Float previousDuckingFactor = mDuckingFactor;
     if ((mDucking_enable) && (mPTVolLevel != 0.0)) {
-        M4OSA_Int32 peakDbValue = 0;
-        M4OSA_Int32 previousDbValue = 0;
-        M4OSA_Int16 *pPCM16Sample = (M4OSA_Int16*)pPrimaryTrack->m_dataAddress;
-        const size_t n = pPrimaryTrack->m_bufferSize / sizeof(M4OSA_Int16);
-
-        for (size_t loopIndex = 0; loopIndex < n; ++loopIndex) {
-            if (pPCM16Sample[loopIndex] >= 0) {
-                peakDbValue = previousDbValue > pPCM16Sample[loopIndex] ?
-                        previousDbValue : pPCM16Sample[loopIndex];
-                previousDbValue = peakDbValue;
-            } else {
-                peakDbValue = previousDbValue > -pPCM16Sample[loopIndex] ?
-                        previousDbValue: -pPCM16Sample[loopIndex];
-                previousDbValue = peakDbValue;
-            }
-        }
-
-        mAudioVolumeArray[mAudVolArrIndex] = getDecibelSound(peakDbValue);
+        mAudioVolumeArray[mAudVolArrIndex] =
+                getDecibelSound(peakAmplitude(pPTdata, n));
 
         // Check for threshold is done after kProcessingWindowSize cycles
         if (mAudVolArrIndex >= kProcessingWindowSize - 1) {
@@ -137,56 +160,26 @@ M4OSA_Int32 VideoEditorBGAudioProcessing::mixAndDuck(
         }
     } // end if - mDucking_enable
 
-
-    // Mixing logic
     ALOGV("Out of Ducking analysis uiPCMsize %d %f %f",
             mDoDucking, mDuckingFactor, mBTVolLevel);
-    while (uiPCMsize-- > 0) {
-
-        // Set vol factor for BT and PT
-        *pBTMdata1 = (M4OSA_Int16)(*pBTMdata1*mBTVolLevel);
-        *pPTMdata2 = (M4OSA_Int16)(*pPTMdata2*mPTVolLevel);
-
-        // Mix the two samples
-        if (mDoDucking) {
-
-            // Duck the BG track to ducking factor value before mixing
-            *pBTMdata1 = (M4OSA_Int16)((*pBTMdata1)*(mDuckingFactor));
-
-            // mix as normal case
-            *pBTMdata1 = (M4OSA_Int16)(*pBTMdata1 /2 + *pPTMdata2 /2);
-        } else {
-
-            *pBTMdata1 = (M4OSA_Int16)((*pBTMdata1)*(mDuckingFactor));
-            *pBTMdata1 = (M4OSA_Int16)(*pBTMdata1 /2 + *pPTMdata2 /2);
-        }
-
-        M4OSA_Int32 temp;
-        if (*pBTMdata1 < 0) {
-            temp = -(*pBTMdata1) * 2; // bring to original Amplitude level
-
-            if (temp > 32767) {
-                *pBTMdata1 = -32766; // less then max allowed value
-            } else {
-                *pBTMdata1 = (M4OSA_Int16)(-temp);
-            }
-        } else {
-            temp = (*pBTMdata1) * 2; // bring to original Amplitude level
-            if ( temp > 32768) {
-                *pBTMdata1 = 32767; // less than max allowed value
-            } else {
-                *pBTMdata1 = (M4OSA_Int16)temp;
-            }
-        }
 
-        pBTMdata1++;
-        pPTMdata2++;
+    // Mix in blocks of kMixBlockSize samples. The background track gain
+    // ramps from the previous to the new ducking factor over the buffer
+    // instead of stepping at the buffer boundary.
+    const M4OSA_Int32 ptGain = toGain(mPTVolLevel);
+    const size_t numBlocks = (n + kMixBlockSize - 1) / kMixBlockSize;
+    for (size_t block = 0; block < numBlocks; ++block) {
+        const size_t offset = block * kMixBlockSize;
+        const size_t count =
+                (n - offset < kMixBlockSize) ? n - offset : kMixBlockSize;
+        const M4OSA_Float duck = previousDuckingFactor +
+                (mDuckingFactor - previousDuckingFactor) *
+                (M4OSA_Float)(block + 1) / numBlocks;
+
+        mixBlock(pOutData + offset, pPTdata + offset, pBTdata + offset, count,
+                ptGain, toGain(mBTVolLevel * duck));
     }
 
-    memcpy((void *)pMixedOutBuffer->m_dataAddress,
-        (void *)pBackgroundTrack->m_dataAddress,
-        pBackgroundTrack->m_bufferSize);
-
     ALOGV("mixAndDuck: X");
     return M4NO_ERROR;
 }
@@ -60,14 +60,23 @@ public:
 
     void setMixParams(const AudioMixSettings& params);
 
+    // Mixes the background track into the primary track. The mixed output
+    // buffer may be the primary track buffer itself.
     M4OSA_Int32 mixAndDuck(
                     void* primaryTrackBuffer,
                     void* backgroundTrackBuffer,
                     void* mixedOutputBuffer);
 
+    enum {
+        // Track gains are applied in Q12 fixed point, up to 4x
+        kGainShift = 12,
+        kMaxGain = 4,
+    };
+
 private:
     enum {
         kProcessingWindowSize = 10,
+        kMixBlockSize = 256,
     };
 
     M4OSA_Int32 mInSampleRate;
@@ -43,7 +43,7 @@
 using namespace android;
 static M4OSA_ERR copyBufferToQueue(
     VideoEditorVideoDecoder_Context* pDecShellContext,
-    MediaBuffer* pDecodedBuffer);
+    MediaBuffer* pDecodedBuffer, M4_MediaTime bufferCts);
 
 class VideoEditorVideoDecoderSource : public MediaSource {
     public:
@@ -1344,6 +1344,11 @@ M4OSA_ERR VideoEditorVideoDecoder_decode(M4OSA_Context context,
     MediaBuffer* pNextBuffer = NULL;
     status_t errStatus;
     bool needSeek = bJump;
+    // The buffer held in pDecoderBuffer still needs copying to the queue.
+    // The copy is deferred until the next buffer arrives, since a later
+    // frame which is still no later than *pTime makes it unrenderable.
+    bool queuePending = false;
+    M4_MediaTime pendingCts = 0;
 
     ALOGV("VideoEditorVideoDecoder_decode begin");
 
@@ -1392,8 +1397,9 @@ M4OSA_ERR VideoEditorVideoDecoder_decode(M4OSA_Context context,
             lerr = M4WAR_NO_MORE_AU;
             // If we decoded a buffer before EOS, we still need to put it
             // into the queue.
-            if (pDecoderBuffer && bJump) {
-                copyBufferToQueue(pDecShellContext, pDecoderBuffer);
+            if (pDecoderBuffer && (queuePending || bJump)) {
+                copyBufferToQueue(pDecShellContext, pDecoderBuffer,
+                    pDecShellContext->m_lastDecodedCTS);
             }
             goto VIDEOEDITOR_VideoDecode_cleanUP;
         } else if (INFO_FORMAT_CHANGED == errStatus) {
@@ -1421,15 +1427,27 @@ M4OSA_ERR VideoEditorVideoDecoder_decode(M4OSA_Context context,
             continue;
         }
 
-        // Now we have a good next buffer, release the previous one.
+        pNextBuffer->meta_data()->findInt64(kKeyTime, &lFrameTime);
+
+        // Now we have a good next buffer, release the previous one. It only
+        // has to be queued if render() could still pick it, which is not
+        // the case once a later frame at or before *pTime exists.
         if (pDecoderBuffer != NULL) {
+            if (queuePending && (M4_MediaTime)(lFrameTime/1000) > *pTime) {
+                lerr = copyBufferToQueue(pDecShellContext, pDecoderBuffer,
+                    pendingCts);
+            }
+            queuePending = false;
             pDecoderBuffer->release();
             pDecoderBuffer = NULL;
+            if (lerr != M4NO_ERROR) {
+                pNextBuffer->release();
+                goto VIDEOEDITOR_VideoDecode_cleanUP;
+            }
         }
         pDecoderBuffer = pNextBuffer;
 
         // Record the timestamp of last decoded buffer
-        pDecoderBuffer->meta_data()->findInt64(kKeyTime, &lFrameTime);
         pDecShellContext->m_lastDecodedCTS = (M4_MediaTime)(lFrameTime/1000);
         ALOGV("VideoEditorVideoDecoder_decode,decoded frametime = %lf,size = %d",
             (M4_MediaTime)lFrameTime, pDecoderBuffer->size() );
@@ -1453,10 +1471,16 @@ M4OSA_ERR VideoEditorVideoDecoder_decode(M4OSA_Context context,
                 pDecShellContext->mFrameIntervalMs +
                 tolerance;
         if (!bJump || targetTimeMs > *pTime) {
-            lerr = copyBufferToQueue(pDecShellContext, pDecoderBuffer);
-            if (lerr != M4NO_ERROR) {
-                goto VIDEOEDITOR_VideoDecode_cleanUP;
-            }
+            queuePending = true;
+            pendingCts = pDecShellContext->m_lastDecodedCTS;
+        }
+    }
+
+    if (queuePending) {
+        M4OSA_ERR err = copyBufferToQueue(pDecShellContext, pDecoderBuffer,
+            pendingCts);
+        if (lerr == M4NO_ERROR) {
+            lerr = err;
         }
     }
 
@@ -1479,7 +1503,7 @@ VIDEOEDITOR_VideoDecode_cleanUP:
 
 static M4OSA_ERR copyBufferToQueue(
     VideoEditorVideoDecoder_Context* pDecShellContext,
-    MediaBuffer* pDecoderBuffer) {
+    MediaBuffer* pDecoderBuffer, M4_MediaTime bufferCts) {
 
     M4OSA_ERR lerr = M4NO_ERROR;
     VIDEOEDITOR_BUFFER_Buffer* tmpDecBuffer;
@@ -1565,7 +1589,7 @@ static M4OSA_ERR copyBufferToQueue(
         lerr = M4ERR_PARAMETER;
     }
 
-    tmpDecBuffer->buffCTS = pDecShellContext->m_lastDecodedCTS;
+    tmpDecBuffer->buffCTS = bufferCts;
     tmpDecBuffer->state = VIDEOEDITOR_BUFFER_kFilled;
     tmpDecBuffer->size = pDecoderBuffer->size();
 
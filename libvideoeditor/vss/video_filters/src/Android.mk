@@ -53,5 +53,10 @@ LOCAL_LDLIBS := \
 
 LOCAL_CFLAGS += -Wno-multichar
 
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_SRC_FILES += M4VFL_transitionNEON.c.neon
+LOCAL_CFLAGS += -DM4VFL_NEON
+endif
+
 include $(BUILD_SHARED_LIBRARY)
 
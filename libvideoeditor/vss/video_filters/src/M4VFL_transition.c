@@ -25,6 +25,7 @@
 #include "M4OSA_Memory.h"
 
 #include "M4VFL_transition.h"
+#include "M4VFL_transitionRows.h"
 
 #include <string.h>
 
@@ -36,6 +37,39 @@
 
 #define LUM_FACTOR_MAX 10
 
+static void M4VFL_blendRow_C(const UInt8 *src1, const UInt8 *src2, UInt8 *dst,
+                             const unsigned short *factors, UInt32 count)
+{
+    UInt32 i;
+
+    for (i = 0; i < count; i++)
+    {
+        UInt32 f = factors[i];
+        dst[i] = (UInt8)((f * src2[i] + (1024 - f) * src1[i]) >> 10);
+    }
+}
+
+static void M4VFL_scaleRow_C(const UInt8 *src, UInt8 *dst, unsigned long factor, UInt32 count)
+{
+    UInt32 i;
+
+    for (i = 0; i < count; i++)
+    {
+        dst[i] = (UInt8)((src[i] * factor) >> LUM_FACTOR_MAX);
+    }
+}
+
+const M4VFL_RowFunctions M4VFL_rowFunctions =
+{
+#ifdef M4VFL_NEON
+    M4VFL_blendRow_NEON,
+    M4VFL_scaleRow_NEON,
+#else
+    M4VFL_blendRow_C,
+    M4VFL_scaleRow_C,
+#endif
+};
+
 
 unsigned char M4VFL_modifyLumaByStep(M4ViComImagePlane *plane_in, M4ViComImagePlane *plane_out,
                                      M4VFL_ModifLumParam *lum_param, void *user_data)
@@ -200,6 +234,19 @@ unsigned char M4VFL_modifyLumaWithScale(M4ViComImagePlane *plane_in,
     p_dest_line = p_dest;
     p_src_line = p_src;
 
+    if (lum_factor <= (1 << LUM_FACTOR_MAX))
+    {
+        /* no overflow into the neighbouring pixel, so scale a byte at a time */
+        for (j = u_height; j != 0; j--)
+        {
+            M4VFL_rowFunctions.scaleRow((const UInt8 *) p_src_line, (UInt8 *) p_dest_line,
+                                        lum_factor, u_width & ~1UL);
+            p_dest_line += u_stride_out;
+            p_src_line += u_stride;
+        }
+        return 0;
+    }
+
     for (j = u_height; j != 0; j--)
     {
         p_dest = p_dest_line;
@@ -272,6 +319,9 @@ unsigned char M4VFL_modifyLumaWithScale(M4ViComImagePlane *plane_in,
 #define NULL    0
 #endif
 
+/** Columns blended per pass; must be even */
+#define M4VFL_BLEND_BLOCK   1024
+
 #ifndef FALSE
 #define FALSE   0
 #define TRUE    !FALSE
@@ -293,9 +343,11 @@ unsigned char M4VIFI_ImageBlendingonYUV420 (void *pUserData,
     UInt32   u32_stride_Y2, u32_stride2_Y2, u32_stride_U2, u32_stride_V2;
     UInt32   u32_stride_Y3, u32_stride2_Y3, u32_stride_U3, u32_stride_V3;
     UInt32   u32_height,  u32_width;
-    UInt32   u32_blendfactor, u32_startA, u32_endA, u32_blend_inc, u32_x_accum;
+    UInt32   u32_startA, u32_endA, u32_blend_inc, u32_x_accum;
     UInt32   u32_col, u32_row, u32_rangeA, u32_progress;
-    UInt32   u32_U1,u32_V1,u32_U2,u32_V2, u32_Y1, u32_Y2;
+    UInt32   u32_x0, u32_count;
+    unsigned short u16_factorsY[M4VFL_BLEND_BLOCK];
+    unsigned short u16_factorsUV[M4VFL_BLEND_BLOCK >> 1];
 
 
     /* Check the Y plane height is EVEN and image plane heights are same */
@@ -388,121 +440,67 @@ unsigned char M4VIFI_ImageBlendingonYUV420 (void *pUserData,
         u32_blend_inc   = (u32_rangeA * MAX_SHORT) / (u32_width);
     }
 
-    /* Two YUV420 rows are computed at each pass */
-    for (u32_row = u32_height; u32_row != 0; u32_row -=2)
+    /*
+     * The blending factor only depends on the column, so compute it once per
+     * block of columns and blend whole rows with the row kernel. Luma column x
+     * gets startA + ((x * inc) >> 16), and each chroma sample uses the factor
+     * of the first of its two luma columns.
+     */
+    for (u32_x0 = 0; u32_x0 < u32_width; u32_x0 += M4VFL_BLEND_BLOCK)
     {
-        /* Set pointers to the beginning of the row for each input image1 plane */
-        pu8_data_Y_current1 = pu8_data_Y_start1;
-        pu8_data_U1 = pu8_data_U_start1;
-        pu8_data_V1 = pu8_data_V_start1;
-
-        /* Set pointers to the beginning of the row for each input image2 plane */
-        pu8_data_Y_current2 = pu8_data_Y_start2;
-        pu8_data_U2 = pu8_data_U_start2;
-        pu8_data_V2 = pu8_data_V_start2;
-
-        /* Set pointers to the beginning of the row for each output image plane */
-        pu8_data_Y_current3 = pu8_data_Y_start3;
-        pu8_data_U3 = pu8_data_U_start3;
-        pu8_data_V3 = pu8_data_V_start3;
-
-        /* Set pointers to the beginning of the next row for image luma plane */
-        pu8_data_Y_next1 = pu8_data_Y_current1 + u32_stride_Y1;
-        pu8_data_Y_next2 = pu8_data_Y_current2 + u32_stride_Y2;
-        pu8_data_Y_next3 = pu8_data_Y_current3 + u32_stride_Y3;
-
-        /* Initialise blendfactor */
-        u32_blendfactor   = u32_startA;
-        /* Blendfactor Increment accumulator */
-        u32_x_accum = 0;
-
-        /* Loop on each column of the output image */
-        for (u32_col = u32_width; u32_col != 0 ; u32_col -=2)
-        {
-            /* Update the blending factor */
-            u32_blendfactor = u32_startA + (u32_x_accum >> 16);
-
-            /* Get Luma value (x,y) of input Image1 */
-            u32_Y1 = *pu8_data_Y_current1++;
+        u32_count = u32_width - u32_x0;
+        if (u32_count > M4VFL_BLEND_BLOCK)
+            u32_count = M4VFL_BLEND_BLOCK;
 
-            /* Get chrominance2 value */
-            u32_U1 = *pu8_data_U1++;
-            u32_V1 = *pu8_data_V1++;
-
-            /* Get Luma value (x,y) of input Image2 */
-            u32_Y2 = *pu8_data_Y_current2++;
-
-            /* Get chrominance2 value */
-            u32_U2 = *pu8_data_U2++;
-            u32_V2 = *pu8_data_V2++;
-
-            /* Compute Luma value (x,y) of Output image */
-            *pu8_data_Y_current3++  = (UInt8)((u32_blendfactor * u32_Y2 +
-                                                     (1024 - u32_blendfactor)*u32_Y1) >> 10);
-            /* Compute chroma(U) value of Output image */
-            *pu8_data_U3++          = (UInt8)((u32_blendfactor * u32_U2 +
-                                                     (1024 - u32_blendfactor)*u32_U1) >> 10);
-            /* Compute chroma(V) value of Output image */
-            *pu8_data_V3++          = (UInt8)((u32_blendfactor * u32_V2 +
-                                                     (1024 - u32_blendfactor)*u32_V1) >> 10);
-
-            /* Get Luma value (x,y+1) of input Image1 */
-            u32_Y1 = *pu8_data_Y_next1++;
-
-             /* Get Luma value (x,y+1) of input Image2 */
-            u32_Y2 = *pu8_data_Y_next2++;
-
-            /* Compute Luma value (x,y+1) of Output image*/
-            *pu8_data_Y_next3++ = (UInt8)((u32_blendfactor * u32_Y2 +
-                                                    (1024 - u32_blendfactor)*u32_Y1) >> 10);
-            /* Update accumulator */
-            u32_x_accum += u32_blend_inc;
-
-            /* Update the blending factor */
-            u32_blendfactor = u32_startA + (u32_x_accum >> 16);
-
-            /* Get Luma value (x+1,y) of input Image1 */
-            u32_Y1 = *pu8_data_Y_current1++;
-
-            /* Get Luma value (x+1,y) of input Image2 */
-            u32_Y2 = *pu8_data_Y_current2++;
-
-            /* Compute Luma value (x+1,y) of Output image*/
-            *pu8_data_Y_current3++ = (UInt8)((u32_blendfactor * u32_Y2 +
-                                                 (1024 - u32_blendfactor)*u32_Y1) >> 10);
-
-            /* Get Luma value (x+1,y+1) of input Image1 */
-            u32_Y1 = *pu8_data_Y_next1++;
-
-            /* Get Luma value (x+1,y+1) of input Image2 */
-            u32_Y2 = *pu8_data_Y_next2++;
-
-            /* Compute Luma value (x+1,y+1) of Output image*/
-            *pu8_data_Y_next3++ = (UInt8)((u32_blendfactor * u32_Y2 +
-                                                 (1024 - u32_blendfactor)*u32_Y1) >> 10);
-            /* Update accumulator */
-            u32_x_accum += u32_blend_inc;
-
-            /* Working pointers are incremented just after each storage */
-
-        }/* End of row scanning */
-
-        /* Update working pointer of input image1 for next row */
-        pu8_data_Y_start1 += u32_stride2_Y1;
-        pu8_data_U_start1 += u32_stride_U1;
-        pu8_data_V_start1 += u32_stride_V1;
-
-        /* Update working pointer of input image2 for next row */
-        pu8_data_Y_start2 += u32_stride2_Y2;
-        pu8_data_U_start2 += u32_stride_U2;
-        pu8_data_V_start2 += u32_stride_V2;
-
-        /* Update working pointer of output image for next row */
-        pu8_data_Y_start3 += u32_stride2_Y3;
-        pu8_data_U_start3 += u32_stride_U3;
-        pu8_data_V_start3 += u32_stride_V3;
+        for (u32_col = 0; u32_col < u32_count; u32_col++)
+        {
+            u32_x_accum = (u32_x0 + u32_col) * u32_blend_inc;
+            u16_factorsY[u32_col] = (unsigned short)(u32_startA + (u32_x_accum >> 16));
+        }
+        for (u32_col = 0; u32_col < (u32_count >> 1); u32_col++)
+        {
+            u16_factorsUV[u32_col] = u16_factorsY[u32_col << 1];
+        }
 
-    }/* End of column scanning */
+        pu8_data_Y_current1 = pu8_data_Y_start1 + u32_x0;
+        pu8_data_U1 = pu8_data_U_start1 + (u32_x0 >> 1);
+        pu8_data_V1 = pu8_data_V_start1 + (u32_x0 >> 1);
+        pu8_data_Y_current2 = pu8_data_Y_start2 + u32_x0;
+        pu8_data_U2 = pu8_data_U_start2 + (u32_x0 >> 1);
+        pu8_data_V2 = pu8_data_V_start2 + (u32_x0 >> 1);
+        pu8_data_Y_current3 = pu8_data_Y_start3 + u32_x0;
+        pu8_data_U3 = pu8_data_U_start3 + (u32_x0 >> 1);
+        pu8_data_V3 = pu8_data_V_start3 + (u32_x0 >> 1);
+
+        /* Two YUV420 rows are computed at each pass */
+        for (u32_row = u32_height; u32_row != 0; u32_row -=2)
+        {
+            pu8_data_Y_next1 = pu8_data_Y_current1 + u32_stride_Y1;
+            pu8_data_Y_next2 = pu8_data_Y_current2 + u32_stride_Y2;
+            pu8_data_Y_next3 = pu8_data_Y_current3 + u32_stride_Y3;
+
+            M4VFL_rowFunctions.blendRow(pu8_data_Y_current1, pu8_data_Y_current2,
+                                        pu8_data_Y_current3, u16_factorsY, u32_count);
+            M4VFL_rowFunctions.blendRow(pu8_data_Y_next1, pu8_data_Y_next2,
+                                        pu8_data_Y_next3, u16_factorsY, u32_count);
+            M4VFL_rowFunctions.blendRow(pu8_data_U1, pu8_data_U2,
+                                        pu8_data_U3, u16_factorsUV, u32_count >> 1);
+            M4VFL_rowFunctions.blendRow(pu8_data_V1, pu8_data_V2,
+                                        pu8_data_V3, u16_factorsUV, u32_count >> 1);
+
+            pu8_data_Y_current1 += u32_stride2_Y1;
+            pu8_data_U1 += u32_stride_U1;
+            pu8_data_V1 += u32_stride_V1;
+
+            pu8_data_Y_current2 += u32_stride2_Y2;
+            pu8_data_U2 += u32_stride_U2;
+            pu8_data_V2 += u32_stride_V2;
+
+            pu8_data_Y_current3 += u32_stride2_Y3;
+            pu8_data_U3 += u32_stride_U3;
+            pu8_data_V3 += u32_stride_V3;
+        }
+    }
 
     return M4VIFI_OK;
 }
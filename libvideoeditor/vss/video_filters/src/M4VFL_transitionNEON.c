@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ ******************************************************************************
+ * @file        M4VFL_transitionNEON.c
+ * @brief       NEON versions of the transition row kernels
+ ******************************************************************************
+*/
+
+#include <arm_neon.h>
+
+#include "M4VFL_transitionRows.h"
+
+void M4VFL_blendRow_NEON(const UInt8 *src1, const UInt8 *src2, UInt8 *dst,
+                         const unsigned short *factors, UInt32 count)
+{
+    const uint16x8_t one = vdupq_n_u16(1024);
+    UInt32 i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        uint16x8_t f2 = vld1q_u16(factors + i);
+        uint16x8_t f1 = vsubq_u16(one, f2);
+        uint16x8_t s1 = vmovl_u8(vld1_u8(src1 + i));
+        uint16x8_t s2 = vmovl_u8(vld1_u8(src2 + i));
+
+        /* 1024 * 255 does not fit in 16 bits, so accumulate in 32 */
+        uint32x4_t lo = vmull_u16(vget_low_u16(f2), vget_low_u16(s2));
+        uint32x4_t hi = vmull_u16(vget_high_u16(f2), vget_high_u16(s2));
+        lo = vmlal_u16(lo, vget_low_u16(f1), vget_low_u16(s1));
+        hi = vmlal_u16(hi, vget_high_u16(f1), vget_high_u16(s1));
+
+        uint16x8_t out = vcombine_u16(vshrn_n_u32(lo, 10), vshrn_n_u32(hi, 10));
+        vst1_u8(dst + i, vmovn_u16(out));
+    }
+
+    for (; i < count; i++)
+    {
+        UInt32 f = factors[i];
+        dst[i] = (UInt8)((f * src2[i] + (1024 - f) * src1[i]) >> 10);
+    }
+}
+
+void M4VFL_scaleRow_NEON(const UInt8 *src, UInt8 *dst, unsigned long factor, UInt32 count)
+{
+    const uint16x4_t f = vdup_n_u16((uint16_t)factor);
+    UInt32 i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        uint16x8_t s = vmovl_u8(vld1_u8(src + i));
+        uint32x4_t lo = vmull_u16(vget_low_u16(s), f);
+        uint32x4_t hi = vmull_u16(vget_high_u16(s), f);
+        uint16x8_t out = vcombine_u16(vshrn_n_u32(lo, 10), vshrn_n_u32(hi, 10));
+        vst1_u8(dst + i, vmovn_u16(out));
+    }
+
+    for (; i < count; i++)
+    {
+        dst[i] = (UInt8)((src[i] * factor) >> 10);
+    }
+}
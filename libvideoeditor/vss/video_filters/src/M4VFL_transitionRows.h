@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ ******************************************************************************
+ * @file        M4VFL_transitionRows.h
+ * @brief       Per-row kernels shared by the transition filters
+ * @note        The C versions live in M4VFL_transition.c. When the library is
+ *              built with M4VFL_NEON, M4VFL_rowFunctions points at the NEON
+ *              versions from M4VFL_transitionNEON.c instead; both produce
+ *              identical output.
+ ******************************************************************************
+*/
+
+#ifndef __M4VFL_TRANSITIONROWS_H__
+#define __M4VFL_TRANSITIONROWS_H__
+
+#include "M4VFL_transition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct S_M4VFL_RowFunctions
+{
+    /* dst[i] = (factors[i] * src2[i] + (1024 - factors[i]) * src1[i]) >> 10 */
+    void (*blendRow)(const UInt8 *src1, const UInt8 *src2, UInt8 *dst,
+                     const unsigned short *factors, UInt32 count);
+    /* dst[i] = (src[i] * factor) >> 10, for factor <= 1024 */
+    void (*scaleRow)(const UInt8 *src, UInt8 *dst, unsigned long factor, UInt32 count);
+} M4VFL_RowFunctions;
+
+extern const M4VFL_RowFunctions M4VFL_rowFunctions;
+
+#ifdef M4VFL_NEON
+void M4VFL_blendRow_NEON(const UInt8 *src1, const UInt8 *src2, UInt8 *dst,
+                         const unsigned short *factors, UInt32 count);
+void M4VFL_scaleRow_NEON(const UInt8 *src, UInt8 *dst, unsigned long factor, UInt32 count);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __M4VFL_TRANSITIONROWS_H__ */
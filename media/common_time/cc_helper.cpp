@@ -15,6 +15,7 @@
  */
 
 #include <stdint.h>
+#include <time.h>
 
 #include <common_time/cc_helper.h>
 #include <common_time/ICommonClock.h>
@@ -26,6 +27,11 @@ Mutex CCHelper::lock_;
 sp<ICommonClock> CCHelper::common_clock_;
 sp<ICommonClockListener> CCHelper::common_clock_listener_;
 uint32_t CCHelper::ref_count_ = 0;
+LocalClock* CCHelper::local_clock_ = NULL;
+uint64_t CCHelper::local_freq_ = 0;
+bool CCHelper::xform_valid_ = false;
+int64_t CCHelper::xform_expires_ = 0;
+LinearTransform CCHelper::xform_;
 
 bool CCHelper::verifyClock_l() {
     bool ret = false;
@@ -53,10 +59,93 @@ bailout:
     if (!ret) {
         common_clock_listener_ = NULL;
         common_clock_ = NULL;
+        xform_valid_ = false;
     }
     return ret;
 }
 
+bool CCHelper::verifyLocalClock_l() {
+    if (local_clock_ == NULL) {
+        local_clock_ = new LocalClock();
+        if (!local_clock_->initCheck()) {
+            delete local_clock_;
+            local_clock_ = NULL;
+            return false;
+        }
+        local_freq_ = local_clock_->getLocalFreq();
+    }
+
+    return (local_freq_ != 0);
+}
+
+// Fetch the service's current local to common transform by converting two
+// local times one second apart.  The service applies the same transform to
+// both, so the pair gives its exact offset and rate at this moment.
+status_t CCHelper::refreshTransform_l(int64_t localTime) {
+    xform_valid_ = false;
+
+    if (!verifyClock_l())
+        return DEAD_OBJECT;
+
+    int64_t localTime1 = localTime + static_cast<int64_t>(local_freq_);
+    int64_t commonTime, commonTime1;
+    status_t status = common_clock_->localTimeToCommonTime(localTime,
+                                                           &commonTime);
+    if (DEAD_OBJECT == status) {
+        if (!verifyClock_l())
+            return DEAD_OBJECT;
+        status = common_clock_->localTimeToCommonTime(localTime, &commonTime);
+    }
+    if (OK != status)
+        return status;
+
+    status = common_clock_->localTimeToCommonTime(localTime1, &commonTime1);
+    if (OK != status)
+        return status;
+
+    int64_t delta = commonTime1 - commonTime;
+    if ((delta <= 0) || (delta > 0x7FFFFFFF) || (local_freq_ > 0xFFFFFFFF))
+        return INVALID_OPERATION;
+
+    xform_.a_zero = localTime;
+    xform_.b_zero = commonTime;
+    xform_.a_to_b_numer = static_cast<int32_t>(delta);
+    xform_.a_to_b_denom = static_cast<uint32_t>(local_freq_);
+    LinearTransform::reduce(&xform_.a_to_b_numer, &xform_.a_to_b_denom);
+
+    xform_expires_ = localTime +
+        static_cast<int64_t>(local_freq_ * kTransformLifetimeMs / 1000);
+    xform_valid_ = true;
+
+    return OK;
+}
+
+// Conversions only need to know roughly what the local time is now to decide
+// whether the cached transform has expired, so use LocalClock's monotonic
+// clock estimate and leave the HAL alone.
+int64_t CCHelper::estimateLocalTime_l() {
+    LinearTransform monoToLocal;
+    int64_t localTime;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t monoTime = (static_cast<int64_t>(ts.tv_sec) * 1000000000LL) +
+                       ts.tv_nsec;
+
+    if (local_clock_->getMonotonicToLocalTransform(&monoToLocal) &&
+        monoToLocal.doForwardTransform(monoTime, &localTime))
+        return localTime;
+
+    return local_clock_->getLocalTime();
+}
+
+status_t CCHelper::getTransform_l(int64_t localTime) {
+    if (xform_valid_ && (localTime < xform_expires_))
+        return OK;
+
+    return refreshTransform_l(localTime);
+}
+
 CCHelper::CCHelper() {
     Mutex::Autolock lock(&lock_);
     ref_count_++;
@@ -81,8 +170,10 @@ CCHelper::~CCHelper() {
 }
 
 void CCHelper::CommonClockListener::onTimelineChanged(uint64_t timelineID) {
-    // do nothing; listener is only really used as a token so the server can
-    // find out when clients die.
+    // The listener is mostly a token so the server can find out when clients
+    // die, but a new timeline also means our cached transform is stale.
+    Mutex::Autolock lock(&lock_);
+    xform_valid_ = false;
 }
 
 // Helper methods which attempts to make calls to the common time binder
@@ -113,17 +204,110 @@ void CCHelper::CommonClockListener::onTimelineChanged(uint64_t timelineID) {
 
 CCHELPER_METHOD(isCommonTimeValid(bool* valid, uint32_t* timelineID),
                 isCommonTimeValid(valid, timelineID))
-CCHELPER_METHOD(commonTimeToLocalTime(int64_t commonTime, int64_t* localTime),
-                commonTimeToLocalTime(commonTime, localTime))
-CCHELPER_METHOD(localTimeToCommonTime(int64_t localTime, int64_t* commonTime),
-                localTimeToCommonTime(localTime, commonTime))
-CCHELPER_METHOD(getCommonTime(int64_t* commonTime),
-                getCommonTime(commonTime))
 CCHELPER_METHOD(getCommonFreq(uint64_t* freq),
                 getCommonFreq(freq))
-CCHELPER_METHOD(getLocalTime(int64_t* localTime),
-                getLocalTime(localTime))
-CCHELPER_METHOD(getLocalFreq(uint64_t* freq),
-                getLocalFreq(freq))
+
+// The remaining helpers use the local time HAL and the cached transform, and
+// only go to the service when the local clock can't be opened in this process.
+status_t CCHelper::callService_l(ServiceCall call, int64_t in, int64_t* out) {
+    status_t status = DEAD_OBJECT;
+
+    for (int attempt = 0; (attempt < 2) && (DEAD_OBJECT == status); ++attempt) {
+        if (!verifyClock_l())
+            return DEAD_OBJECT;
+
+        switch (call) {
+            case COMMON_TO_LOCAL:
+                status = common_clock_->commonTimeToLocalTime(in, out);
+                break;
+            case LOCAL_TO_COMMON:
+                status = common_clock_->localTimeToCommonTime(in, out);
+                break;
+            case GET_COMMON_TIME:
+                status = common_clock_->getCommonTime(out);
+                break;
+            case GET_LOCAL_TIME:
+                status = common_clock_->getLocalTime(out);
+                break;
+        }
+    }
+
+    return status;
+}
+
+status_t CCHelper::commonTimeToLocalTime(int64_t commonTime,
+                                         int64_t* localTime) {
+    Mutex::Autolock lock(&lock_);
+
+    if (!verifyLocalClock_l())
+        return callService_l(COMMON_TO_LOCAL, commonTime, localTime);
+
+    status_t status = getTransform_l(estimateLocalTime_l());
+    if (OK != status)
+        return status;
+
+    return xform_.doReverseTransform(commonTime, localTime)
+        ? OK : INVALID_OPERATION;
+}
+
+status_t CCHelper::localTimeToCommonTime(int64_t localTime,
+                                         int64_t* commonTime) {
+    Mutex::Autolock lock(&lock_);
+
+    if (!verifyLocalClock_l())
+        return callService_l(LOCAL_TO_COMMON, localTime, commonTime);
+
+    status_t status = getTransform_l(estimateLocalTime_l());
+    if (OK != status)
+        return status;
+
+    return xform_.doForwardTransform(localTime, commonTime)
+        ? OK : INVALID_OPERATION;
+}
+
+status_t CCHelper::getCommonTime(int64_t* commonTime) {
+    Mutex::Autolock lock(&lock_);
+
+    if (!verifyLocalClock_l())
+        return callService_l(GET_COMMON_TIME, 0, commonTime);
+
+    int64_t localTime = local_clock_->getLocalTime();
+    status_t status = getTransform_l(localTime);
+    if (OK != status)
+        return status;
+
+    return xform_.doForwardTransform(localTime, commonTime)
+        ? OK : INVALID_OPERATION;
+}
+
+status_t CCHelper::getLocalTime(int64_t* localTime) {
+    Mutex::Autolock lock(&lock_);
+
+    if (!verifyLocalClock_l())
+        return callService_l(GET_LOCAL_TIME, 0, localTime);
+
+    *localTime = local_clock_->getLocalTime();
+    return OK;
+}
+
+status_t CCHelper::getLocalFreq(uint64_t* freq) {
+    Mutex::Autolock lock(&lock_);
+
+    if (!verifyLocalClock_l()) {
+        if (!verifyClock_l())
+            return DEAD_OBJECT;
+
+        status_t status = common_clock_->getLocalFreq(freq);
+        if (DEAD_OBJECT == status) {
+            if (!verifyClock_l())
+                return DEAD_OBJECT;
+            status = common_clock_->getLocalFreq(freq);
+        }
+        return status;
+    }
+
+    *freq = local_freq_;
+    return OK;
+}
 
 }  // namespace android
@@ -19,6 +19,7 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <time.h>
 
 #include <common_time/local_clock.h>
 #include <hardware/hardware.h>
@@ -30,6 +31,11 @@ namespace android {
 
 Mutex LocalClock::dev_lock_;
 local_time_hw_device_t* LocalClock::dev_ = NULL;
+uint64_t LocalClock::local_freq_ = 0;
+bool LocalClock::xform_valid_ = false;
+int64_t LocalClock::sample_mono_ = 0;
+int64_t LocalClock::sample_local_ = 0;
+LinearTransform LocalClock::xform_;
 
 LocalClock::LocalClock() {
     int res;
@@ -67,7 +73,13 @@ uint64_t LocalClock::getLocalFreq() {
     assert(NULL != dev_);
     assert(NULL != dev_->get_local_freq);
 
-    return dev_->get_local_freq(dev_);
+    // The nominal frequency of the local clock never changes, so only ask
+    // the HAL once.
+    AutoMutex lock(&dev_lock_);
+    if (!local_freq_)
+        local_freq_ = dev_->get_local_freq(dev_);
+
+    return local_freq_;
 }
 
 status_t LocalClock::setLocalSlew(int16_t rate) {
@@ -76,9 +88,74 @@ status_t LocalClock::setLocalSlew(int16_t rate) {
     if (!dev_->set_local_slew)
         return INVALID_OPERATION;
 
+    // Slewing changes the rate of the local clock, so whatever rate was
+    // measured against the monotonic clock no longer holds.
+    AutoMutex lock(&dev_lock_);
+    xform_valid_ = false;
+    sample_mono_ = 0;
+
     return static_cast<status_t>(dev_->set_local_slew(dev_, rate));
 }
 
+static int64_t monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (static_cast<int64_t>(ts.tv_sec) * 1000000000LL) + ts.tv_nsec;
+}
+
+// Take a (monotonic, local) pair, using the midpoint of two monotonic reads
+// which bracket the HAL read.
+void LocalClock::sampleLocked(int64_t* monoTime, int64_t* localTime) {
+    int64_t before = monotonicNs();
+    *localTime = dev_->get_local_time(dev_);
+    int64_t after = monotonicNs();
+
+    *monoTime = before + ((after - before) / 2);
+}
+
+bool LocalClock::getMonotonicToLocalTransform(LinearTransform* xform) {
+    assert(NULL != dev_);
+
+    AutoMutex lock(&dev_lock_);
+
+    if (!local_freq_)
+        local_freq_ = dev_->get_local_freq(dev_);
+    if (!local_freq_ || (local_freq_ > 0x7FFFFFFF))
+        return false;
+
+    int64_t now = monotonicNs();
+    if (xform_valid_ && ((now - sample_mono_) < (kSampleIntervalMs * 1000000LL))) {
+        *xform = xform_;
+        return true;
+    }
+
+    int64_t mono, local;
+    sampleLocked(&mono, &local);
+
+    // Measure the rate against the previous sample when there is one far
+    // enough back to be meaningful; otherwise trust the nominal frequency.
+    int64_t monoDelta = mono - sample_mono_;
+    int64_t localDelta = local - sample_local_;
+    if (sample_mono_ && (monoDelta >= 1000000LL) && (monoDelta <= 0x7FFFFFFF) &&
+            (localDelta > 0) && (localDelta <= 0x7FFFFFFF)) {
+        xform_.a_to_b_numer = static_cast<int32_t>(localDelta);
+        xform_.a_to_b_denom = static_cast<uint32_t>(monoDelta);
+    } else {
+        xform_.a_to_b_numer = static_cast<int32_t>(local_freq_);
+        xform_.a_to_b_denom = 1000000000;
+    }
+    LinearTransform::reduce(&xform_.a_to_b_numer, &xform_.a_to_b_denom);
+    xform_.a_zero = mono;
+    xform_.b_zero = local;
+
+    sample_mono_ = mono;
+    sample_local_ = local;
+    xform_valid_ = true;
+
+    *xform = xform_;
+    return true;
+}
+
 int32_t LocalClock::getDebugLog(struct local_time_debug_event* records,
                                 int max_records) {
     assert(NULL != dev_);
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ThreadCpuStats"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cpustats/ThreadCpuStats.h>
+
+namespace android {
+
+ThreadCpuStats *ThreadCpuStats::sHead = NULL;
+pthread_mutex_t ThreadCpuStats::sMutex = PTHREAD_MUTEX_INITIALIZER;
+
+ThreadCpuStats::ThreadCpuStats(const char *name)
+    : mPublishedElapsedNs(0), mNext(NULL)
+{
+    strncpy(mName, name, sizeof(mName) - 1);
+    mName[sizeof(mName) - 1] = '\0';
+
+    pthread_mutex_lock(&sMutex);
+    mNext = sHead;
+    sHead = this;
+    pthread_mutex_unlock(&sMutex);
+}
+
+ThreadCpuStats::~ThreadCpuStats()
+{
+    pthread_mutex_lock(&sMutex);
+    for (ThreadCpuStats **link = &sHead; *link != NULL; link = &(*link)->mNext) {
+        if (*link == this) {
+            *link = mNext;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sMutex);
+}
+
+void ThreadCpuStats::sample()
+{
+    double ns;
+    if (mCpuUsage.sampleAndEnable(ns)) {
+        mCurrent.sample(ns);
+    }
+
+    // elapsed() is expensive, so don't call it every cycle
+    if ((mCurrent.n() & 127) != 1) {
+        return;
+    }
+    long long elapsed = mCpuUsage.elapsed();
+    if (elapsed < kWindowNs) {
+        return;
+    }
+
+    pthread_mutex_lock(&sMutex);
+    mPublished = mCurrent;
+    mPublishedElapsedNs = elapsed;
+    pthread_mutex_unlock(&sMutex);
+
+    mCurrent.reset();
+    mCpuUsage.resetElapsed();
+}
+
+void ThreadCpuStats::dump(int fd)
+{
+    char buffer[256];
+
+    pthread_mutex_lock(&sMutex);
+    snprintf(buffer, sizeof(buffer), "Thread CPU usage, last %lld s window:\n"
+            "  %-32s %8s %7s %10s %10s %10s %10s\n", kWindowNs / 1000000000LL,
+            "name", "cycles", "% cpu", "mean us", "stddev us", "min us", "max us");
+    write(fd, buffer, strlen(buffer));
+    for (ThreadCpuStats *stats = sHead; stats != NULL; stats = stats->mNext) {
+        const CentralTendencyStatistics& s = stats->mPublished;
+        unsigned n = s.n();
+        if (n == 0 || stats->mPublishedElapsedNs <= 0) {
+            snprintf(buffer, sizeof(buffer), "  %-32s (no complete window yet)\n",
+                    stats->mName);
+        } else {
+            double percent = s.mean() * n * 100.0 / stats->mPublishedElapsedNs;
+            snprintf(buffer, sizeof(buffer),
+                    "  %-32s %8u %7.2f %10.1f %10.1f %10.1f %10.1f\n",
+                    stats->mName, n, percent, s.mean() * .001, s.stddev() * .001,
+                    s.minimum() * .001, s.maximum() * .001);
+        }
+        write(fd, buffer, strlen(buffer));
+    }
+    pthread_mutex_unlock(&sMutex);
+}
+
+}   // namespace android
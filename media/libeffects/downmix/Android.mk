@@ -4,7 +4,7 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
-	EffectDownmix.c
+	EffectDownmix.c.arm
 
 LOCAL_SHARED_LIBRARIES := \
 	libcutils liblog
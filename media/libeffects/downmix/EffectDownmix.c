@@ -27,6 +27,12 @@
 // Do not submit with DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER defined, strictly for testing
 //#define DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER 0
 
+#if defined(__arm__) && !defined(__thumb__) && defined(__ARM_NEON__)
+#define USE_NEON (true)
+#else
+#define USE_NEON (false)
+#endif
+
 #define MINUS_3_DB_IN_Q19_12 2896 // -3dB = 0.707 * 2^12 = 2896
 
 typedef enum {
@@ -778,6 +784,220 @@ int Downmix_getParameter(downmix_object_t *pDownmixer, int32_t param, size_t *pS
 } /* end Downmix_getParameter */
 
 
+/*----------------------------------------------------------------------------
+ * NEON fold loops
+ *----------------------------------------------------------------------------
+ * Each of them consumes *pNumFrames rounded down to a multiple of 4 and advances *ppSrc,
+ * *ppDst and *pNumFrames, leaving the remaining frames to the scalar loops below. Front,
+ * side and back channels are loaded as L/R pairs so that every lane of a register holds
+ * the same channel as the output lane it contributes to. The results are bit-exact with the
+ * scalar code: the sums are computed in 32 bits exactly as in Q19.12, vshr.s32 is the same
+ * arithmetic shift, and vqmovn.s32 the same saturation as clamp16().
+ *----------------------------------------------------------------------------
+ */
+static inline void Downmix_foldFromQuad_neon(int16_t **ppSrc, int16_t **ppDst,
+        size_t *pNumFrames, bool accumulate) {
+#if USE_NEON
+    size_t count = *pNumFrames & ~3;
+    if (count == 0) {
+        return;
+    }
+    *pNumFrames -= count;
+    int16_t *pSrc = *ppSrc;
+    int16_t *pDst = *ppDst;
+    int acc = accumulate;
+    asm (
+        "1:                                      \n"
+        "vld2.32        {d0-d3}, [%[src]]!       \n"    // q0 = FL FR, q1 = RL RR of 4 frames
+        "vaddl.s16      q8, d0, d2               \n"    // front + rear of frames 0 and 1
+        "vaddl.s16      q9, d1, d3               \n"    // front + rear of frames 2 and 3
+        "vshr.s32       q8, q8, #1               \n"
+        "vshr.s32       q9, q9, #1               \n"
+        "cmp            %[acc], #0               \n"
+        "beq            2f                       \n"
+        "vld1.16        {d20, d21}, [%[dst]]     \n"    // accumulate in destination
+        "vaddw.s16      q8, q8, d20              \n"
+        "vaddw.s16      q9, q9, d21              \n"
+        "2:                                      \n"
+        "subs           %[count], %[count], #4   \n"    // update loop counter
+        "vqmovn.s32     d0, q8                   \n"    // clamp to 16 bits
+        "vqmovn.s32     d1, q9                   \n"
+        "vst1.16        {d0, d1}, [%[dst]]!      \n"    // store 4 stereo frames
+        "bne            1b                       \n"    // loop
+        : [src]     "+r" (pSrc),
+          [dst]     "+r" (pDst),
+          [count]   "+r" (count)
+        : [acc]     "r" (acc)
+        : "cc", "memory",
+          "q0", "q1", "q8", "q9", "q10"
+    );
+    *ppSrc = pSrc;
+    *ppDst = pDst;
+#endif
+}
+
+static inline void Downmix_foldFromSurround_neon(int16_t **ppSrc, int16_t **ppDst,
+        size_t *pNumFrames, bool accumulate) {
+#if USE_NEON
+    size_t count = *pNumFrames & ~3;
+    if (count == 0) {
+        return;
+    }
+    *pNumFrames -= count;
+    int16_t *pSrc = *ppSrc;
+    int16_t *pDst = *ppDst;
+    int acc = accumulate;
+    asm (
+        "vdup.16        d30, %[gain]             \n"    // d30 = -3dB in Q19.12
+        "1:                                      \n"
+        "vld2.32        {d0-d3}, [%[src]]!       \n"    // q0 = FL FR, q1 = FC RC of 4 frames
+        "vshll.s16      q8, d0, #12              \n"    // FL FR of frames 0 and 1
+        "vshll.s16      q9, d1, #12              \n"    // FL FR of frames 2 and 3
+        "vmull.s16      q10, d2, d30             \n"    // FC(-3dB) RC(-3dB) of frames 0 and 1
+        "vmull.s16      q11, d3, d30             \n"    // FC(-3dB) RC(-3dB) of frames 2 and 3
+        "vrev64.32      q12, q10                 \n"
+        "vrev64.32      q13, q11                 \n"
+        "vadd.i32       q10, q10, q12            \n"    // FC + RC in both lanes of each frame
+        "vadd.i32       q11, q11, q13            \n"
+        "vadd.i32       q8, q8, q10              \n"
+        "vadd.i32       q9, q9, q11              \n"
+        "vshr.s32       q8, q8, #13              \n"
+        "vshr.s32       q9, q9, #13              \n"
+        "cmp            %[acc], #0               \n"
+        "beq            2f                       \n"
+        "vld1.16        {d20, d21}, [%[dst]]     \n"    // accumulate in destination
+        "vaddw.s16      q8, q8, d20              \n"
+        "vaddw.s16      q9, q9, d21              \n"
+        "2:                                      \n"
+        "subs           %[count], %[count], #4   \n"    // update loop counter
+        "vqmovn.s32     d0, q8                   \n"    // clamp to 16 bits
+        "vqmovn.s32     d1, q9                   \n"
+        "vst1.16        {d0, d1}, [%[dst]]!      \n"    // store 4 stereo frames
+        "bne            1b                       \n"    // loop
+        : [src]     "+r" (pSrc),
+          [dst]     "+r" (pDst),
+          [count]   "+r" (count)
+        : [acc]     "r" (acc),
+          [gain]    "r" (MINUS_3_DB_IN_Q19_12)
+        : "cc", "memory",
+          "q0", "q1", "q8", "q9", "q10", "q11", "q12", "q13", "q15"
+    );
+    *ppSrc = pSrc;
+    *ppDst = pDst;
+#endif
+}
+
+static inline void Downmix_foldFrom5Point1_neon(int16_t **ppSrc, int16_t **ppDst,
+        size_t *pNumFrames, bool accumulate) {
+#if USE_NEON
+    size_t count = *pNumFrames & ~3;
+    if (count == 0) {
+        return;
+    }
+    *pNumFrames -= count;
+    int16_t *pSrc = *ppSrc;
+    int16_t *pDst = *ppDst;
+    int acc = accumulate;
+    asm (
+        "vdup.16        d30, %[gain]             \n"    // d30 = -3dB in Q19.12
+        "1:                                      \n"
+        "vld3.32        {d0, d2, d4}, [%[src]]!  \n"    // FL FR, FC LFE, RL RR of frames 0 and 1
+        "vld3.32        {d1, d3, d5}, [%[src]]!  \n"    // FL FR, FC LFE, RL RR of frames 2 and 3
+        "vaddl.s16      q8, d0, d4               \n"    // FL + RL, FR + RR
+        "vaddl.s16      q9, d1, d5               \n"
+        "vshl.i32       q8, q8, #12              \n"
+        "vshl.i32       q9, q9, #12              \n"
+        "vmull.s16      q10, d2, d30             \n"    // FC(-3dB) LFE(-3dB)
+        "vmull.s16      q11, d3, d30             \n"
+        "vrev64.32      q12, q10                 \n"
+        "vrev64.32      q13, q11                 \n"
+        "vadd.i32       q10, q10, q12            \n"    // FC + LFE in both lanes of each frame
+        "vadd.i32       q11, q11, q13            \n"
+        "vadd.i32       q8, q8, q10              \n"
+        "vadd.i32       q9, q9, q11              \n"
+        "vshr.s32       q8, q8, #13              \n"
+        "vshr.s32       q9, q9, #13              \n"
+        "cmp            %[acc], #0               \n"
+        "beq            2f                       \n"
+        "vld1.16        {d20, d21}, [%[dst]]     \n"    // accumulate in destination
+        "vaddw.s16      q8, q8, d20              \n"
+        "vaddw.s16      q9, q9, d21              \n"
+        "2:                                      \n"
+        "subs           %[count], %[count], #4   \n"    // update loop counter
+        "vqmovn.s32     d0, q8                   \n"    // clamp to 16 bits
+        "vqmovn.s32     d1, q9                   \n"
+        "vst1.16        {d0, d1}, [%[dst]]!      \n"    // store 4 stereo frames
+        "bne            1b                       \n"    // loop
+        : [src]     "+r" (pSrc),
+          [dst]     "+r" (pDst),
+          [count]   "+r" (count)
+        : [acc]     "r" (acc),
+          [gain]    "r" (MINUS_3_DB_IN_Q19_12)
+        : "cc", "memory",
+          "q0", "q1", "q2", "q8", "q9", "q10", "q11", "q12", "q13", "q15"
+    );
+    *ppSrc = pSrc;
+    *ppDst = pDst;
+#endif
+}
+
+static inline void Downmix_foldFrom7Point1_neon(int16_t **ppSrc, int16_t **ppDst,
+        size_t *pNumFrames, bool accumulate) {
+#if USE_NEON
+    size_t count = *pNumFrames & ~3;
+    if (count == 0) {
+        return;
+    }
+    *pNumFrames -= count;
+    int16_t *pSrc = *ppSrc;
+    int16_t *pDst = *ppDst;
+    int acc = accumulate;
+    asm (
+        "vdup.16        d30, %[gain]             \n"    // d30 = -3dB in Q19.12
+        "1:                                      \n"
+        "vld4.32        {d0, d2, d4, d6}, [%[src]]!  \n"    // FL FR, FC LFE, RL RR, SL SR
+        "vld4.32        {d1, d3, d5, d7}, [%[src]]!  \n"    // of frames 0 and 1, then 2 and 3
+        "vaddl.s16      q8, d0, d4               \n"    // FL + RL, FR + RR
+        "vaddl.s16      q9, d1, d5               \n"
+        "vaddw.s16      q8, q8, d6               \n"    // + SL, + SR
+        "vaddw.s16      q9, q9, d7               \n"
+        "vshl.i32       q8, q8, #12              \n"
+        "vshl.i32       q9, q9, #12              \n"
+        "vmull.s16      q10, d2, d30             \n"    // FC(-3dB) LFE(-3dB)
+        "vmull.s16      q11, d3, d30             \n"
+        "vrev64.32      q12, q10                 \n"
+        "vrev64.32      q13, q11                 \n"
+        "vadd.i32       q10, q10, q12            \n"    // FC + LFE in both lanes of each frame
+        "vadd.i32       q11, q11, q13            \n"
+        "vadd.i32       q8, q8, q10              \n"
+        "vadd.i32       q9, q9, q11              \n"
+        "vshr.s32       q8, q8, #13              \n"
+        "vshr.s32       q9, q9, #13              \n"
+        "cmp            %[acc], #0               \n"
+        "beq            2f                       \n"
+        "vld1.16        {d20, d21}, [%[dst]]     \n"    // accumulate in destination
+        "vaddw.s16      q8, q8, d20              \n"
+        "vaddw.s16      q9, q9, d21              \n"
+        "2:                                      \n"
+        "subs           %[count], %[count], #4   \n"    // update loop counter
+        "vqmovn.s32     d0, q8                   \n"    // clamp to 16 bits
+        "vqmovn.s32     d1, q9                   \n"
+        "vst1.16        {d0, d1}, [%[dst]]!      \n"    // store 4 stereo frames
+        "bne            1b                       \n"    // loop
+        : [src]     "+r" (pSrc),
+          [dst]     "+r" (pDst),
+          [count]   "+r" (count)
+        : [acc]     "r" (acc),
+          [gain]    "r" (MINUS_3_DB_IN_Q19_12)
+        : "cc", "memory",
+          "q0", "q1", "q2", "q3", "q8", "q9", "q10", "q11", "q12", "q13", "q15"
+    );
+    *ppSrc = pSrc;
+    *ppDst = pDst;
+#endif
+}
+
+
 /*----------------------------------------------------------------------------
  * Downmix_foldFromQuad()
  *----------------------------------------------------------------------------
@@ -800,6 +1020,7 @@ void Downmix_foldFromQuad(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool ac
     // sample at index 1 is FR
     // sample at index 2 is RL
     // sample at index 3 is RR
+    Downmix_foldFromQuad_neon(&pSrc, &pDst, &numFrames, accumulate);
     if (accumulate) {
         while (numFrames) {
             // FL + RL
@@ -847,6 +1068,7 @@ void Downmix_foldFromSurround(int16_t *pSrc, int16_t*pDst, size_t numFrames, boo
     // sample at index 1 is FR
     // sample at index 2 is FC
     // sample at index 3 is RC
+    Downmix_foldFromSurround_neon(&pSrc, &pDst, &numFrames, accumulate);
     // code is mostly duplicated between the two values of accumulate to avoid repeating the test
     // for every sample
     if (accumulate) {
@@ -908,6 +1130,7 @@ void Downmix_foldFrom5Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
     // sample at index 3 is LFE
     // sample at index 4 is RL
     // sample at index 5 is RR
+    Downmix_foldFrom5Point1_neon(&pSrc, &pDst, &numFrames, accumulate);
     // code is mostly duplicated between the two values of accumulate to avoid repeating the test
     // for every sample
     if (accumulate) {
@@ -973,6 +1196,7 @@ void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
     // sample at index 5 is RR
     // sample at index 6 is SL
     // sample at index 7 is SR
+    Downmix_foldFrom7Point1_neon(&pSrc, &pDst, &numFrames, accumulate);
     // code is mostly duplicated between the two values of accumulate to avoid repeating the test
     // for every sample
     if (accumulate) {
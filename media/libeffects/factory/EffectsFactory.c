@@ -18,9 +18,13 @@
 //#define LOG_NDEBUG 0
 
 #include "EffectsFactory.h"
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <cutils/misc.h>
 #include <cutils/config_utils.h>
@@ -37,6 +41,10 @@ static list_elem_t *gCurLib;    // current library in enumeration process
 static list_elem_t *gCurEffect; // current effect in enumeration process
 static uint32_t gCurEffectIdx;       // current effect index in enumeration process
 static lib_entry_t *gCachedLibrary;  // last library accessed by getLibrary()
+static list_elem_t *gUuidIndex[UUID_INDEX_SIZE]; // lists of uuid_index_entry_t, hashed by UUID
+static desc_cache_record_t *gDescCache; // descriptor cache, only used during init
+static uint32_t gDescCacheCount;     // number of records in gDescCache
+static int gDescCacheDirty;          // records were added to gDescCache since it was read
 
 static int gInitDone; // true is global initialization has been preformed
 static int gCanQueryEffect; // indicates that call to EffectQueryEffect() is valid, i.e. that the list of effects
@@ -51,6 +59,10 @@ static int init();
 static int loadEffectConfigFile(const char *path);
 static int loadLibraries(cnode *root);
 static int loadLibrary(cnode *root, const char *name);
+static int openLibrary(lib_entry_t *l);
+static int getLibraryDescriptor(lib_entry_t *l,
+               const effect_uuid_t *uuid,
+               effect_descriptor_t *desc);
 static int loadEffects(cnode *root);
 static int loadEffect(cnode *node);
 // To get and add the effect pointed by the passed node to the gSubEffectList
@@ -66,6 +78,14 @@ static int findEffect(const effect_uuid_t *type,
 int findSubEffect(const effect_uuid_t *uuid,
                lib_entry_t **lib,
                effect_descriptor_t **desc);
+static void buildUuidIndex();
+static int findInUuidIndex(const effect_uuid_t *uuid,
+               int isSubEffect,
+               lib_entry_t **lib,
+               effect_descriptor_t **desc);
+static void readDescriptorCache();
+static void writeDescriptorCache();
+static desc_cache_record_t *findCacheRecord(const lib_entry_t *l, const effect_uuid_t *uuid);
 static void dumpEffectDescriptor(effect_descriptor_t *desc, char *str, size_t len);
 static int stringToUuid(const char *str, effect_uuid_t *uuid);
 static int uuidToString(const effect_uuid_t *uuid, char *str, size_t maxLen);
@@ -304,6 +324,15 @@ int EffectCreate(const effect_uuid_t *uuid, int32_t sessionId, int32_t ioId, eff
         }
     }
 
+    // the library is only opened at its first effect creation when its descriptors were cached
+    if (l->desc == NULL) {
+        ret = openLibrary(l);
+        if (ret < 0) {
+            ALOGW("EffectCreate() could not open library %s", l->path);
+            goto exit;
+        }
+    }
+
     // create effect in library
     ret = l->desc->create_effect(uuid, sessionId, ioId, &itfe);
     if (ret != 0) {
@@ -456,13 +485,21 @@ int init() {
 
     pthread_mutex_init(&gLibLock, NULL);
 
+    readDescriptorCache();
+
     if (access(AUDIO_EFFECT_VENDOR_CONFIG_FILE, R_OK) == 0) {
         loadEffectConfigFile(AUDIO_EFFECT_VENDOR_CONFIG_FILE);
     } else if (access(AUDIO_EFFECT_DEFAULT_CONFIG_FILE, R_OK) == 0) {
         loadEffectConfigFile(AUDIO_EFFECT_DEFAULT_CONFIG_FILE);
     }
 
+    writeDescriptorCache();
+    free(gDescCache);
+    gDescCache = NULL;
+    gDescCacheCount = 0;
+
     updateNumEffects();
+    buildUuidIndex();
     gInitDone = 1;
     ALOGV("init() done");
     return 0;
@@ -507,8 +544,7 @@ int loadLibraries(cnode *root)
 int loadLibrary(cnode *root, const char *name)
 {
     cnode *node;
-    void *hdl;
-    audio_effect_library_t *desc;
+    struct stat st;
     list_elem_t *e;
     lib_entry_t *l;
 
@@ -517,55 +553,129 @@ int loadLibrary(cnode *root, const char *name)
         return -EINVAL;
     }
 
-    hdl = dlopen(node->value, RTLD_NOW);
-    if (hdl == NULL) {
+    if (stat(node->value, &st) != 0) {
         ALOGW("loadLibrary() failed to open %s", node->value);
-        goto error;
+        return -EINVAL;
+    }
+
+    // add entry for library in gLibraryList
+    l = malloc(sizeof(lib_entry_t));
+    l->name = strndup(name, PATH_MAX);
+    l->path = strndup(node->value, PATH_MAX);
+    l->handle = NULL;
+    l->desc = NULL;
+    l->effects = NULL;
+    l->mtime = st.st_mtime;
+    l->size = st.st_size;
+    pthread_mutex_init(&l->lock, NULL);
+
+    // a library unknown to the descriptor cache is opened right away, so that it is checked
+    // before being listed as it used to be. Others are opened on demand.
+    if (findCacheRecord(l, NULL) == NULL && openLibrary(l) != 0) {
+        pthread_mutex_destroy(&l->lock);
+        free(l->path);
+        free(l->name);
+        free(l);
+        return -EINVAL;
+    }
+
+    e = malloc(sizeof(list_elem_t));
+    e->object = l;
+    pthread_mutex_lock(&gLibLock);
+    e->next = gLibraryList;
+    gLibraryList = e;
+    pthread_mutex_unlock(&gLibLock);
+    ALOGV("getLibrary() linked library %p for path %s", l, node->value);
+
+    return 0;
+}
+
+int openLibrary(lib_entry_t *l)
+{
+    void *hdl;
+    audio_effect_library_t *desc;
+
+    if (l->desc != NULL) {
+        return 0;
+    }
+
+    hdl = dlopen(l->path, RTLD_NOW);
+    if (hdl == NULL) {
+        ALOGW("openLibrary() failed to open %s", l->path);
+        return -EINVAL;
     }
 
     desc = (audio_effect_library_t *)dlsym(hdl, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
     if (desc == NULL) {
-        ALOGW("loadLibrary() could not find symbol %s", AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+        ALOGW("openLibrary() could not find symbol %s", AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
         goto error;
     }
 
     if (AUDIO_EFFECT_LIBRARY_TAG != desc->tag) {
-        ALOGW("getLibrary() bad tag %08x in lib info struct", desc->tag);
+        ALOGW("openLibrary() bad tag %08x in lib info struct", desc->tag);
         goto error;
     }
 
     if (EFFECT_API_VERSION_MAJOR(desc->version) !=
             EFFECT_API_VERSION_MAJOR(EFFECT_LIBRARY_API_VERSION)) {
-        ALOGW("loadLibrary() bad lib version %08x", desc->version);
+        ALOGW("openLibrary() bad lib version %08x", desc->version);
         goto error;
     }
 
-    // add entry for library in gLibraryList
-    l = malloc(sizeof(lib_entry_t));
-    l->name = strndup(name, PATH_MAX);
-    l->path = strndup(node->value, PATH_MAX);
     l->handle = hdl;
     l->desc = desc;
-    l->effects = NULL;
-    pthread_mutex_init(&l->lock, NULL);
-
-    e = malloc(sizeof(list_elem_t));
-    e->object = l;
-    pthread_mutex_lock(&gLibLock);
-    e->next = gLibraryList;
-    gLibraryList = e;
-    pthread_mutex_unlock(&gLibLock);
-    ALOGV("getLibrary() linked library %p for path %s", l, node->value);
-
+    ALOGV("openLibrary() opened %s", l->path);
     return 0;
 
 error:
-    if (hdl != NULL) {
-        dlclose(hdl);
-    }
+    dlclose(hdl);
     return -EINVAL;
 }
 
+// Gets the descriptor of the effect with the given UUID in the library, from the descriptor
+// cache if possible, or else from the library, opening it if needed, and adds it to the cache.
+int getLibraryDescriptor(lib_entry_t *l,
+               const effect_uuid_t *uuid,
+               effect_descriptor_t *desc)
+{
+    desc_cache_record_t *r;
+    int ret;
+
+    r = findCacheRecord(l, uuid);
+    if (r != NULL) {
+        r->used = 1;
+        if (r->status == 0) {
+            *desc = r->desc;
+        }
+        return r->status;
+    }
+
+    if (openLibrary(l) != 0) {
+        return -EINVAL;
+    }
+    ret = l->desc->get_descriptor(uuid, desc);
+
+    if (strlen(l->path) < EFFECTS_DESC_CACHE_PATH_MAX) {
+        r = realloc(gDescCache, (gDescCacheCount + 1) * sizeof(desc_cache_record_t));
+        if (r != NULL) {
+            gDescCache = r;
+            r = &gDescCache[gDescCacheCount++];
+            memset(r, 0, sizeof(desc_cache_record_t));
+            strcpy(r->path, l->path);
+            r->mtime = l->mtime;
+            r->size = l->size;
+            r->uuid = *uuid;
+            r->status = ret;
+            r->used = 1;
+            if (ret == 0) {
+                r->desc = *desc;
+            }
+            gDescCacheDirty = 1;
+        }
+    }
+    return ret;
+}
+
 // This will find the library and UUID tags of the sub effect pointed by the
 // node, gets the effect descriptor and lib_entry_t and adds the subeffect -
 // sub_entry_t to the gSubEffectList
@@ -595,7 +705,7 @@ int addSubEffect(cnode *root)
         return -EINVAL;
     }
     d = malloc(sizeof(effect_descriptor_t));
-    if (l->desc->get_descriptor(&uuid, d) != 0) {
+    if (getLibraryDescriptor(l, &uuid, d) != 0) {
         char s[40];
         uuidToString(&uuid, s, 40);
         ALOGW("Error querying effect %s on lib %s", s, l->name);
@@ -670,7 +780,7 @@ int loadEffect(cnode *root)
     }
 
     d = malloc(sizeof(effect_descriptor_t));
-    if (l->desc->get_descriptor(&uuid, d) != 0) {
+    if (getLibraryDescriptor(l, &uuid, d) != 0) {
         char s[40];
         uuidToString(&uuid, s, 40);
         ALOGW("Error querying effect %s on lib %s", s, l->name);
@@ -749,43 +859,10 @@ int findSubEffect(const effect_uuid_t *uuid,
                lib_entry_t **lib,
                effect_descriptor_t **desc)
 {
-    list_sub_elem_t *e = gSubEffectList;
-    list_elem_t *subefx;
-    sub_effect_entry_t *effect;
-    lib_entry_t *l = NULL;
-    effect_descriptor_t *d = NULL;
-    int found = 0;
-    int ret = 0;
-
     if (uuid == NULL)
         return -EINVAL;
 
-    while (e != NULL && !found) {
-        subefx = (list_elem_t*)(e->sub_elem);
-        while (subefx != NULL) {
-            effect = (sub_effect_entry_t*)subefx->object;
-            l = (lib_entry_t *)effect->lib;
-            d = (effect_descriptor_t *)effect->object;
-            if (memcmp(&d->uuid, uuid, sizeof(effect_uuid_t)) == 0) {
-                ALOGV("uuid matched");
-                found = 1;
-                break;
-            }
-            subefx = subefx->next;
-        }
-        e = e->next;
-    }
-    if (!found) {
-        ALOGV("findSubEffect() effect not found");
-        ret = -ENOENT;
-    } else {
-        ALOGV("findSubEffect() found effect: %s in lib %s", d->name, l->name);
-        *lib = l;
-        if (desc != NULL) {
-            *desc = d;
-        }
-    }
-    return ret;
+    return findInUuidIndex(uuid, 1, lib, desc);
 }
 
 lib_entry_t *getLibrary(const char *name)
@@ -853,6 +930,10 @@ int findEffect(const effect_uuid_t *type,
     int found = 0;
     int ret = 0;
 
+    if (type == NULL && uuid != NULL) {
+        return findInUuidIndex(uuid, 0, lib, desc);
+    }
+
     while (e && !found) {
         l = (lib_entry_t *)e->object;
         list_elem_t *efx = l->effects;
@@ -884,6 +965,197 @@ int findEffect(const effect_uuid_t *type,
     return ret;
 }
 
+static uint32_t uuidHash(const effect_uuid_t *uuid)
+{
+    return (uuid->timeLow ^ (uuid->timeMid << 16) ^ uuid->clockSeq ^
+            (uuid->node[4] << 8) ^ uuid->node[5]) & (UUID_INDEX_SIZE - 1);
+}
+
+static void addToUuidIndex(effect_descriptor_t *d, lib_entry_t *l, int isSubEffect)
+{
+    uint32_t h = uuidHash(&d->uuid);
+    list_elem_t *e;
+    uuid_index_entry_t *entry;
+
+    // keep the first match in list order, as found by walking the lists
+    for (e = gUuidIndex[h]; e != NULL; e = e->next) {
+        entry = (uuid_index_entry_t *)e->object;
+        if (entry->isSubEffect == isSubEffect &&
+                memcmp(&entry->desc->uuid, &d->uuid, sizeof(effect_uuid_t)) == 0) {
+            return;
+        }
+    }
+    entry = malloc(sizeof(uuid_index_entry_t));
+    entry->desc = d;
+    entry->lib = l;
+    entry->isSubEffect = isSubEffect;
+    e = malloc(sizeof(list_elem_t));
+    e->object = entry;
+    e->next = gUuidIndex[h];
+    gUuidIndex[h] = e;
+}
+
+// Index all effects and sub effects by UUID, once the lists are complete: the descriptors of
+// proxy effects are only final after their sub effects were loaded.
+void buildUuidIndex()
+{
+    list_elem_t *e;
+    list_sub_elem_t *se;
+
+    for (e = gLibraryList; e != NULL; e = e->next) {
+        lib_entry_t *l = (lib_entry_t *)e->object;
+        list_elem_t *efx;
+        for (efx = l->effects; efx != NULL; efx = efx->next) {
+            addToUuidIndex((effect_descriptor_t *)efx->object, l, 0);
+        }
+    }
+    for (se = gSubEffectList; se != NULL; se = se->next) {
+        list_elem_t *subefx;
+        for (subefx = se->sub_elem; subefx != NULL; subefx = subefx->next) {
+            sub_effect_entry_t *sub = (sub_effect_entry_t *)subefx->object;
+            addToUuidIndex((effect_descriptor_t *)sub->object, sub->lib, 1);
+        }
+    }
+}
+
+int findInUuidIndex(const effect_uuid_t *uuid,
+               int isSubEffect,
+               lib_entry_t **lib,
+               effect_descriptor_t **desc)
+{
+    list_elem_t *e;
+
+    for (e = gUuidIndex[uuidHash(uuid)]; e != NULL; e = e->next) {
+        uuid_index_entry_t *entry = (uuid_index_entry_t *)e->object;
+        if (entry->isSubEffect == isSubEffect &&
+                memcmp(&entry->desc->uuid, uuid, sizeof(effect_uuid_t)) == 0) {
+            ALOGV("findInUuidIndex() found effect: %s in lib %s",
+                    entry->desc->name, entry->lib->name);
+            *lib = entry->lib;
+            if (desc != NULL) {
+                *desc = entry->desc;
+            }
+            return 0;
+        }
+    }
+    ALOGV("findInUuidIndex() effect not found");
+    return -ENOENT;
+}
+
+// Fills fingerprint with the current build fingerprint, zero padded so that it can be written
+// and compared as a whole
+static void getBuildFingerprint(char *fingerprint)
+{
+    memset(fingerprint, 0, EFFECTS_DESC_CACHE_FINGERPRINT_MAX);
+    property_get("ro.build.fingerprint", fingerprint, "");
+}
+
+void readDescriptorCache()
+{
+    desc_cache_header_t header;
+    char fingerprint[EFFECTS_DESC_CACHE_FINGERPRINT_MAX];
+    uint32_t i;
+    int fd;
+
+    getBuildFingerprint(fingerprint);
+    fd = open(EFFECTS_DESC_CACHE_FILE, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    if (read(fd, &header, sizeof(header)) != sizeof(header) ||
+            header.magic != EFFECTS_DESC_CACHE_MAGIC ||
+            header.version != EFFECTS_DESC_CACHE_VERSION ||
+            header.recordSize != sizeof(desc_cache_record_t) ||
+            header.count > 1024) {
+        ALOGW("readDescriptorCache() ignoring invalid %s", EFFECTS_DESC_CACHE_FILE);
+        goto exit;
+    }
+    if (memcmp(header.fingerprint, fingerprint, sizeof(fingerprint)) != 0) {
+        ALOGV("readDescriptorCache() ignoring %s from another build", EFFECTS_DESC_CACHE_FILE);
+        goto exit;
+    }
+    gDescCache = malloc(header.count * sizeof(desc_cache_record_t));
+    if (gDescCache == NULL) {
+        goto exit;
+    }
+    if (read(fd, gDescCache, header.count * sizeof(desc_cache_record_t)) !=
+            (ssize_t)(header.count * sizeof(desc_cache_record_t))) {
+        ALOGW("readDescriptorCache() ignoring truncated %s", EFFECTS_DESC_CACHE_FILE);
+        free(gDescCache);
+        gDescCache = NULL;
+        goto exit;
+    }
+    for (i = 0; i < header.count; i++) {
+        gDescCache[i].path[EFFECTS_DESC_CACHE_PATH_MAX - 1] = '\0';
+        gDescCache[i].used = 0;
+    }
+    gDescCacheCount = header.count;
+    ALOGV("readDescriptorCache() read %u records", gDescCacheCount);
+
+exit:
+    close(fd);
+}
+
+// Writes back the records used or added during init, if that is not exactly the records read
+void writeDescriptorCache()
+{
+    desc_cache_header_t header;
+    uint32_t i;
+    uint32_t count = 0;
+    int fd;
+    int ok;
+
+    for (i = 0; i < gDescCacheCount; i++) {
+        if (gDescCache[i].used) {
+            count++;
+        }
+    }
+    if (!gDescCacheDirty && count == gDescCacheCount) {
+        return;
+    }
+
+    fd = open(EFFECTS_DESC_CACHE_FILE ".tmp", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        ALOGV("writeDescriptorCache() cannot create %s", EFFECTS_DESC_CACHE_FILE ".tmp");
+        return;
+    }
+    header.magic = EFFECTS_DESC_CACHE_MAGIC;
+    header.version = EFFECTS_DESC_CACHE_VERSION;
+    header.recordSize = sizeof(desc_cache_record_t);
+    header.count = count;
+    getBuildFingerprint(header.fingerprint);
+    ok = write(fd, &header, sizeof(header)) == sizeof(header);
+    for (i = 0; i < gDescCacheCount && ok; i++) {
+        if (gDescCache[i].used) {
+            ok = write(fd, &gDescCache[i], sizeof(desc_cache_record_t)) ==
+                    sizeof(desc_cache_record_t);
+        }
+    }
+    close(fd);
+    if (!ok || rename(EFFECTS_DESC_CACHE_FILE ".tmp", EFFECTS_DESC_CACHE_FILE) != 0) {
+        ALOGW("writeDescriptorCache() failed to write %s", EFFECTS_DESC_CACHE_FILE);
+        unlink(EFFECTS_DESC_CACHE_FILE ".tmp");
+    }
+}
+
+// Returns the valid cache record for the given library and UUID, or any valid record for the
+// library if uuid is NULL
+desc_cache_record_t *findCacheRecord(const lib_entry_t *l, const effect_uuid_t *uuid)
+{
+    uint32_t i;
+
+    for (i = 0; i < gDescCacheCount; i++) {
+        desc_cache_record_t *r = &gDescCache[i];
+        if (r->mtime != l->mtime || r->size != l->size || strcmp(r->path, l->path) != 0) {
+            continue;
+        }
+        if (uuid == NULL || memcmp(&r->uuid, uuid, sizeof(effect_uuid_t)) == 0) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
 void dumpEffectDescriptor(effect_descriptor_t *desc, char *str, size_t len) {
     char s[256];
 
@@ -18,6 +18,7 @@
 #define ANDROID_EFFECTSFACTORY_H_
 
 #include <cutils/log.h>
+#include <cutils/properties.h>
 #include <pthread.h>
 #include <dirent.h>
 #include <media/EffectsFactoryApi.h>
@@ -41,6 +42,8 @@ typedef struct list_sub_elem_s {
     struct list_sub_elem_s *next;
 } list_sub_elem_t;
 
+// desc and handle are NULL until the library is opened, which is deferred to the first
+// EffectCreate() when all its descriptors were found in the descriptor cache
 typedef struct lib_entry_s {
     audio_effect_library_t *desc;
     char *name;
@@ -48,6 +51,8 @@ typedef struct lib_entry_s {
     void *handle;
     list_elem_t *effects; //list of effect_descriptor_t
     pthread_mutex_t lock;
+    int64_t mtime;  // modification time of the library file, in seconds
+    int64_t size;   // size of the library file, in bytes
 } lib_entry_t;
 
 typedef struct effect_entry_s {
@@ -66,6 +71,45 @@ typedef struct sub_effect_entry_s {
     void *object;
 } sub_effect_entry_t;
 
+// Entry of the UUID index of all effects and sub effects, built at init
+typedef struct uuid_index_entry_s {
+    effect_descriptor_t *desc;
+    lib_entry_t *lib;
+    int isSubEffect;
+} uuid_index_entry_t;
+
+#define UUID_INDEX_SIZE 64  // number of buckets, must be a power of 2
+
+// Persisted cache of the descriptors returned by get_descriptor(), so that enumerating effects
+// does not require loading every library listed in audio_effects.conf.
+// The cache file is a desc_cache_header_t followed by count desc_cache_record_t.
+// The whole file is discarded when the build fingerprint changes, as an OTA can replace a
+// library while preserving its modification time and size; otherwise a record is valid as long
+// as the library file keeps the same modification time and size.
+#define EFFECTS_DESC_CACHE_FILE "/data/misc/media/audio_effects.cache"
+#define EFFECTS_DESC_CACHE_MAGIC 0x43534645  // "EFSC"
+#define EFFECTS_DESC_CACHE_VERSION 2
+#define EFFECTS_DESC_CACHE_PATH_MAX 256
+#define EFFECTS_DESC_CACHE_FINGERPRINT_MAX PROPERTY_VALUE_MAX
+
+typedef struct desc_cache_header_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;    // sizeof(desc_cache_record_t)
+    uint32_t count;
+    char fingerprint[EFFECTS_DESC_CACHE_FINGERPRINT_MAX];  // ro.build.fingerprint
+} desc_cache_header_t;
+
+typedef struct desc_cache_record_s {
+    char path[EFFECTS_DESC_CACHE_PATH_MAX];
+    int64_t mtime;
+    int64_t size;
+    effect_uuid_t uuid;     // UUID passed to get_descriptor()
+    int32_t status;         // get_descriptor() return value
+    int32_t used;           // in memory only: record was used or added by this process
+    effect_descriptor_t desc;
+} desc_cache_record_t;
+
 #if __cplusplus
 }  // extern "C"
 #endif
@@ -17,6 +17,7 @@
 #define LOG_TAG "EffectLE"
 //#define LOG_NDEBUG 0
 #include <cutils/log.h>
+#include <cutils/properties.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,8 +25,15 @@
 #include <time.h>
 #include <math.h>
 #include <audio_effects/effect_loudnessenhancer.h>
+#include <media/EffectLoudnessEnhancerApi.h>
 #include "dsp/core/dynamic_range_compression.h"
 
+#if defined(__arm__) && !defined(__thumb__) && defined(__ARM_NEON__)
+#define USE_NEON (true)
+#else
+#define USE_NEON (false)
+#endif
+
 extern "C" {
 
 // effect_handle_t interface implementation for LE effect
@@ -54,6 +62,8 @@ struct LoudnessEnhancerContext {
     effect_config_t mConfig;
     uint8_t mState;
     int32_t mTargetGainmB;// target gain in mB
+    uint32_t mGainUpdateFrames; // frames per compressor gain update, 1 for per sample
+    float mBlockGain;       // compressor gain reached at the end of the previous block
     // in this implementation, there is no coupling between the compression on the left and right
     // channels
     le_fx::AdaptiveDynamicRangeCompression* mCompressor;
@@ -71,9 +81,11 @@ void LE_reset(LoudnessEnhancerContext *pContext)
         float targetAmp = pow(10, pContext->mTargetGainmB/2000.0f); // mB to linear amplification
         ALOGV("LE_reset(): Target gain=%dmB <=> factor=%.2fX", pContext->mTargetGainmB, targetAmp);
         pContext->mCompressor->Initialize(targetAmp, pContext->mConfig.inputCfg.samplingRate);
+        pContext->mCompressor->set_block_size(pContext->mGainUpdateFrames);
     } else {
         ALOGE("LE_reset(%p): null compressors, can't apply target gain", pContext);
     }
+    pContext->mBlockGain = 1.0f;
 }
 
 static inline int16_t clamp16(int32_t sample)
@@ -83,6 +95,121 @@ static inline int16_t clamp16(int32_t sample)
     return sample;
 }
 
+// Returns the largest absolute value of the count samples in buffer.
+static uint16_t LE_peak(const int16_t *buffer, size_t count)
+{
+    int32_t peak = 0;
+#if USE_NEON
+    size_t neonCount = count & ~7;
+    if (neonCount != 0) {
+        uint16_t peaks[4];
+        asm (
+            "vmov.i16       d4, #0                   \n"
+            "1:                                      \n"
+            "vld1.16        {d0, d1}, [%[in]]!       \n"    // load 8 samples
+            "subs           %[count], %[count], #8   \n"    // update loop counter
+            "vqabs.s16      q0, q0                   \n"
+            "vmax.u16       d0, d0, d1               \n"
+            "vmax.u16       d4, d4, d0               \n"    // running max of each lane
+            "bne            1b                       \n"    // loop
+            "vst1.16        {d4}, [%[peaks]]         \n"
+            : [in]      "+r" (buffer),
+              [count]   "+r" (neonCount)
+            : [peaks]   "r" (peaks)
+            : "cc", "memory",
+              "q0", "q2"
+        );
+        for (size_t i = 0; i < 4; i++) {
+            if (peaks[i] > peak) {
+                peak = peaks[i];
+            }
+        }
+        count &= 7;
+    }
+#endif
+    for (size_t i = 0; i < count; i++) {
+        int32_t sample = buffer[i];
+        if (sample < 0) {
+            sample = -sample;
+        }
+        if (sample > peak) {
+            peak = sample;
+        }
+    }
+    return peak;
+}
+
+// Applies to frameCount stereo frames in place a gain starting at gain + step on the first
+// frame and increasing by step on each frame, clamping to +/-32767 like the per sample
+// compressor.
+static void LE_applyGainRamp(int16_t *buffer, size_t frameCount, float gain, float step)
+{
+    gain += step;
+#if USE_NEON
+    size_t count = frameCount & ~3;
+    if (count != 0) {
+        const float gains[4] = { gain, gain, gain + step, gain + step };
+        const float limit = 32767.0f;
+        asm (
+            "vld1.32        {d4, d5}, [%[gains]]     \n"    // gains of frames 0 and 1
+            "vdup.32        q3, %[step]              \n"
+            "vadd.f32       q3, q3, q3               \n"    // q3 = 2 * step
+            "vadd.f32       q8, q2, q3               \n"    // gains of frames 2 and 3
+            "vadd.f32       q3, q3, q3               \n"    // q3 = 4 * step
+            "vdup.32        q14, %[limit]            \n"
+            "vneg.f32       q15, q14                 \n"
+            "1:                                      \n"
+            "vld1.16        {d0, d1}, [%[buf]]       \n"    // load 4 stereo frames
+            "subs           %[count], %[count], #4   \n"    // update loop counter
+            "vmovl.s16      q10, d0                  \n"
+            "vmovl.s16      q11, d1                  \n"
+            "vcvt.f32.s32   q10, q10                 \n"
+            "vcvt.f32.s32   q11, q11                 \n"
+            "vmul.f32       q10, q10, q2             \n"    // apply gain
+            "vmul.f32       q11, q11, q8             \n"
+            "vmin.f32       q10, q10, q14            \n"    // clamp to +/-32767
+            "vmin.f32       q11, q11, q14            \n"
+            "vmax.f32       q10, q10, q15            \n"
+            "vmax.f32       q11, q11, q15            \n"
+            "vcvt.s32.f32   q10, q10                 \n"    // truncate like (int16_t)
+            "vcvt.s32.f32   q11, q11                 \n"
+            "vmovn.i32      d0, q10                  \n"
+            "vmovn.i32      d1, q11                  \n"
+            "vadd.f32       q2, q2, q3               \n"    // next gains
+            "vadd.f32       q8, q8, q3               \n"
+            "vst1.16        {d0, d1}, [%[buf]]!      \n"    // store 4 stereo frames
+            "bne            1b                       \n"    // loop
+            : [buf]     "+r" (buffer),
+              [count]   "+r" (count)
+            : [gains]   "r" (gains),
+              [step]    "r" (step),
+              [limit]   "r" (limit)
+            : "cc", "memory",
+              "q0", "q2", "q3", "q8", "q10", "q11", "q14", "q15"
+        );
+        gain += step * (frameCount & ~3);
+        frameCount &= 3;
+    }
+#endif
+    for (size_t i = 0; i < frameCount * 2; i += 2) {
+        float left = gain * buffer[i];
+        float right = gain * buffer[i + 1];
+        if (left > 32767.0f) {
+            left = 32767.0f;
+        } else if (left < -32767.0f) {
+            left = -32767.0f;
+        }
+        if (right > 32767.0f) {
+            right = 32767.0f;
+        } else if (right < -32767.0f) {
+            right = -32767.0f;
+        }
+        buffer[i] = (int16_t) left;
+        buffer[i + 1] = (int16_t) right;
+        gain += step;
+    }
+}
+
 //----------------------------------------------------------------------------
 // LE_setConfig()
 //----------------------------------------------------------------------------
@@ -171,12 +298,22 @@ int LE_init(LoudnessEnhancerContext *pContext)
     pContext->mConfig.outputCfg.mask = EFFECT_CONFIG_ALL;
 
     pContext->mTargetGainmB = LOUDNESS_ENHANCER_DEFAULT_TARGET_GAIN_MB;
+    pContext->mGainUpdateFrames = LOUDNESS_ENHANCER_GAIN_UPDATE_FRAMES_DEFAULT;
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get(LOUDNESS_ENHANCER_GAIN_UPDATE_FRAMES_PROPERTY, value, NULL) > 0) {
+        uint32_t frames = atoi(value);
+        if (frames >= 1 && frames <= LOUDNESS_ENHANCER_GAIN_UPDATE_FRAMES_MAX) {
+            pContext->mGainUpdateFrames = frames;
+        }
+    }
+    pContext->mBlockGain = 1.0f;
     float targetAmp = pow(10, pContext->mTargetGainmB/2000.0f); // mB to linear amplification
     ALOGV("LE_init(): Target gain=%dmB <=> factor=%.2fX", pContext->mTargetGainmB, targetAmp);
 
     if (pContext->mCompressor == NULL) {
         pContext->mCompressor = new le_fx::AdaptiveDynamicRangeCompression();
         pContext->mCompressor->Initialize(targetAmp, pContext->mConfig.inputCfg.samplingRate);
+        pContext->mCompressor->set_block_size(pContext->mGainUpdateFrames);
     }
 
     LE_setConfig(pContext, &pContext->mConfig);
@@ -283,13 +420,32 @@ int LE_process(
     uint16_t inIdx;
     float inputAmp = pow(10, pContext->mTargetGainmB/2000.0f);
     float leftSample, rightSample;
-    for (inIdx = 0 ; inIdx < inBuffer->frameCount ; inIdx++) {
-        // makeup gain is applied on the input of the compressor
-        leftSample  = inputAmp * (float)inBuffer->s16[2*inIdx];
-        rightSample = inputAmp * (float)inBuffer->s16[2*inIdx +1];
-        pContext->mCompressor->Compress(&leftSample, &rightSample);
-        inBuffer->s16[2*inIdx]    = (int16_t) leftSample;
-        inBuffer->s16[2*inIdx +1] = (int16_t) rightSample;
+    const uint32_t blockFrames = pContext->mGainUpdateFrames;
+    if (blockFrames > 1) {
+        // the compressor gain is updated once per block from the block peak, and the gain
+        // ramps linearly to it over the block. A short last block is treated as a full one.
+        int16_t *buffer = inBuffer->s16;
+        size_t remaining = inBuffer->frameCount;
+        while (remaining > 0) {
+            size_t frames = remaining < blockFrames ? remaining : blockFrames;
+            // makeup gain is applied on the input of the compressor
+            float peak = inputAmp * LE_peak(buffer, frames * 2);
+            float gain = pContext->mCompressor->CompressBlock(peak);
+            float step = (gain - pContext->mBlockGain) / frames;
+            LE_applyGainRamp(buffer, frames, inputAmp * pContext->mBlockGain, inputAmp * step);
+            pContext->mBlockGain = gain;
+            buffer += frames * 2;
+            remaining -= frames;
+        }
+    } else {
+        for (inIdx = 0 ; inIdx < inBuffer->frameCount ; inIdx++) {
+            // makeup gain is applied on the input of the compressor
+            leftSample  = inputAmp * (float)inBuffer->s16[2*inIdx];
+            rightSample = inputAmp * (float)inBuffer->s16[2*inIdx +1];
+            pContext->mCompressor->Compress(&leftSample, &rightSample);
+            inBuffer->s16[2*inIdx]    = (int16_t) leftSample;
+            inBuffer->s16[2*inIdx +1] = (int16_t) rightSample;
+        }
     }
 
     if (inBuffer->raw != outBuffer->raw) {
@@ -387,6 +543,12 @@ int LE_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             p->vsize = sizeof(int32_t);
             *replySize += sizeof(int32_t);
             break;
+        case LOUDNESS_ENHANCER_PARAM_GAIN_UPDATE_FRAMES:
+            ALOGV("get gain update frames = %u", pContext->mGainUpdateFrames);
+            *((uint32_t *)p->data + 1) = pContext->mGainUpdateFrames;
+            p->vsize = sizeof(uint32_t);
+            *replySize += sizeof(uint32_t);
+            break;
         default:
             p->status = -EINVAL;
         }
@@ -409,6 +571,16 @@ int LE_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             ALOGV("set target gain(mB) = %d", pContext->mTargetGainmB);
             LE_reset(pContext); // apply parameter update
             break;
+        case LOUDNESS_ENHANCER_PARAM_GAIN_UPDATE_FRAMES: {
+            uint32_t frames = *((uint32_t *)p->data + 1);
+            if (frames < 1 || frames > LOUDNESS_ENHANCER_GAIN_UPDATE_FRAMES_MAX) {
+                *(int32_t *)pReplyData = -EINVAL;
+                break;
+            }
+            pContext->mGainUpdateFrames = frames;
+            ALOGV("set gain update frames = %u", pContext->mGainUpdateFrames);
+            LE_reset(pContext); // apply parameter update
+            } break;
         default:
             *(int32_t *)pReplyData = -EINVAL;
         }
@@ -70,11 +70,21 @@ bool AdaptiveDynamicRangeCompression::Initialize(
   } else {
     alpha_release_ = 0.0f;
   }
+  alpha_attack_block_ = alpha_attack_;
+  alpha_release_block_ = alpha_release_;
   // Feed-forward topology
   slope_ = 1.0f / kCompressionRatio - 1.0f;
   return true;
 }
 
+void AdaptiveDynamicRangeCompression::set_block_size(int frames) {
+  // Running the one pole smoother of the envelope detector once per block of
+  // N frames with alpha^N gives the same time constants as running it on
+  // every sample.
+  alpha_attack_block_ = std::pow(alpha_attack_, (float) frames);
+  alpha_release_block_ = std::pow(alpha_release_, (float) frames);
+}
+
 float AdaptiveDynamicRangeCompression::Compress(float x) {
   const float max_abs_x = std::max(std::fabs(x), kMinLogAbsValue);
   const float max_abs_x_dB = math::fast_log(max_abs_x);
@@ -137,5 +147,25 @@ void AdaptiveDynamicRangeCompression::Compress(float *x1, float *x2) {
   }
 }
 
+float AdaptiveDynamicRangeCompression::CompressBlock(float max_abs_x) {
+  max_abs_x = std::max(max_abs_x, kMinLogAbsValue);
+  const float max_abs_x_dB = math::fast_log(max_abs_x);
+  // Subtract Threshold from log-encoded input to get the amount of overshoot
+  const float overshoot = max_abs_x_dB - knee_threshold_;
+  // Hard half-wave rectifier
+  const float rect = std::max(overshoot, 0.0f);
+  // Multiply rectified overshoot with slope
+  const float cv = rect * slope_;
+  const float prev_state = state_;
+  if (cv <= state_) {
+    state_ = alpha_attack_block_ * state_ + (1.0f - alpha_attack_block_) * cv;
+  } else {
+    state_ = alpha_release_block_ * state_ + (1.0f - alpha_release_block_) * cv;
+  }
+  compressor_gain_ *=
+      math::ExpApproximationViaTaylorExpansionOrder5(state_ - prev_state);
+  return compressor_gain_;
+}
+
 }  // namespace le_fx
 
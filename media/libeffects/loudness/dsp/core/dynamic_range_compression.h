@@ -58,6 +58,17 @@ class AdaptiveDynamicRangeCompression {
   // Stereo channel version of the compressor
   void Compress(float *x1, float *x2);
 
+  // Block version of the stereo compressor: updates the envelope detector once
+  // for a block of frames whose largest absolute value over both channels is
+  // max_abs_x, and returns the gain reached at the end of the block. The
+  // caller applies the gain, typically ramping to it over the block. The block
+  // length is the one given to set_block_size().
+  float CompressBlock(float max_abs_x);
+
+  // Sets the number of frames per call to CompressBlock(.), which scales the
+  // attack and release constants. Initialize(.) resets it to 1.
+  void set_block_size(int frames);
+
   // This version is slower than Compress(.) but faster than CompressSlow(.)
   float CompressNormalSpeed(float x);
 
@@ -101,6 +112,9 @@ class AdaptiveDynamicRangeCompression {
   float alpha_attack_;
   // release constant for exponential dumping
   float alpha_release_;
+  // attack and release constants for one block of CompressBlock(.)
+  float alpha_attack_block_;
+  float alpha_release_block_;
   float slope_;
   // The knee threshold
   float knee_threshold_;
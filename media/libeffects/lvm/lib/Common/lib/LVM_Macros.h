@@ -22,6 +22,22 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/**********************************************************************************
+   LVM_USE_NEON
+        Set when building for ARM with NEON, in which case the hot filter and mixing
+        primitives of Common/src use NEON inline assembly instead of the C loops.
+
+        The NEON code computes (A * B) >> ShiftR from the full 64 bit product
+        (VMULL + VSHRN), which gives exactly the same 32 bit result as the
+        MUL32x32INTO32 and MUL32x16INTO32 macros below, so the output is bit-exact
+        with the C reference.
+***********************************************************************************/
+#if defined(__arm__) && !defined(__thumb__) && defined(__ARM_NEON__)
+#define LVM_USE_NEON 1
+#else
+#define LVM_USE_NEON 0
+#endif
+
 /**********************************************************************************
    MUL32x32INTO32(A,B,C,ShiftR)
         C = (A * B) >> ShiftR
@@ -20,6 +20,7 @@
 ***********************************************************************************/
 
 #include "VectorArithmetic.h"
+#include "LVM_Macros.h"
 
 
 /**********************************************************************************
@@ -32,6 +33,29 @@ void Add2_Sat_32x32( const LVM_INT32  *src,
 {
     LVM_INT32 a,b,c;
     LVM_INT16 ii;
+#if LVM_USE_NEON
+    /* VQADD saturates exactly like the C code below, 4 samples at a time */
+    if (n >= 4)
+    {
+        LVM_INT32 count = n & ~3;
+        n -= count;
+        asm (
+            "1:                                          \n"
+            "vld1.32        {d0, d1}, [%[src]]!          \n"
+            "vld1.32        {d2, d3}, [%[dst]]           \n"
+            "subs           %[count], %[count], #4       \n"    /* update loop counter */
+            "vqadd.s32      q0, q0, q1                   \n"
+            "vst1.32        {d0, d1}, [%[dst]]!          \n"
+            "bne            1b                           \n"    /* loop */
+            : [src]     "+r" (src),
+              [dst]     "+r" (dst),
+              [count]   "+r" (count)
+            :
+            : "cc", "memory",
+              "q0", "q1"
+        );
+    }
+#endif
     for (ii = n; ii != 0; ii--)
     {
         a=*src;
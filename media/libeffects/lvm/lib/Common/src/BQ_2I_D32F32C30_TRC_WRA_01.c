@@ -48,6 +48,53 @@ void BQ_2I_D32F32C30_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
 
+#if LVM_USE_NEON
+        /* Left and right are filtered together in the two lanes of a D register,
+           the delays stay in registers for the whole block */
+        if (NrSamples > 0)
+        {
+            LVM_INT32 n = NrSamples;
+            asm (
+                "vld1.32        {d0, d1}, [%[coefs]]         \n"    /* d0 = A2 A1, d1 = A0 -B2 */
+                "vld1.32        {d2[0]}, [%[b1]]             \n"    /* d2[0] = -B1 */
+                "vld1.32        {d4-d7}, [%[delays]]         \n"    /* x(n-1), x(n-2), y(n-1), y(n-2) */
+                "1:                                          \n"
+                "vld1.32        {d16}, [%[in]]!              \n"    /* x(n) L R */
+                "subs           %[n], %[n], #1               \n"    /* update loop counter */
+                "vmull.s32      q9, d5, d0[0]                \n"    /* A2 * x(n-2) */
+                "vmull.s32      q10, d4, d0[1]               \n"    /* A1 * x(n-1) */
+                "vmull.s32      q11, d16, d1[0]              \n"    /* A0 * x(n) */
+                "vmull.s32      q12, d7, d1[1]               \n"    /* -B2 * y(n-2) */
+                "vmull.s32      q13, d6, d2[0]               \n"    /* -B1 * y(n-1) */
+                "vshrn.i64      d18, q9, #30                 \n"
+                "vshrn.i64      d20, q10, #30                \n"
+                "vshrn.i64      d22, q11, #30                \n"
+                "vshrn.i64      d24, q12, #30                \n"
+                "vshrn.i64      d26, q13, #30                \n"
+                "vadd.i32       d18, d18, d20                \n"
+                "vadd.i32       d22, d22, d24                \n"
+                "vadd.i32       d18, d18, d26                \n"
+                "vadd.i32       d18, d18, d22                \n"    /* y(n) L R */
+                "vmov           d5, d4                       \n"    /* x(n-2) = x(n-1) */
+                "vmov           d4, d16                      \n"    /* x(n-1) = x(n) */
+                "vmov           d7, d6                       \n"    /* y(n-2) = y(n-1) */
+                "vmov           d6, d18                      \n"    /* y(n-1) = y(n) */
+                "vst1.32        {d18}, [%[out]]!             \n"
+                "bne            1b                           \n"    /* loop */
+                "vst1.32        {d4-d7}, [%[delays]]         \n"
+                : [in]      "+r" (pDataIn),
+                  [out]     "+r" (pDataOut),
+                  [n]       "+r" (n)
+                : [coefs]   "r" (pBiquadState->coefs),
+                  [b1]      "r" (&pBiquadState->coefs[4]),
+                  [delays]  "r" (pBiquadState->pDelays)
+                : "cc", "memory",
+                  "q0", "q1", "q2", "q3", "q8", "q9", "q10", "q11", "q12", "q13"
+            );
+            return;
+        }
+#endif
+
          for (ii = NrSamples; ii != 0; ii--)
          {
 
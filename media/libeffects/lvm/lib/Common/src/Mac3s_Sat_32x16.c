@@ -34,6 +34,35 @@ void Mac3s_Sat_32x16(  const LVM_INT32 *src,
     LVM_INT16 ii;
     LVM_INT32 srcval,temp, dInVal, dOutVal;
 
+#if LVM_USE_NEON
+    /* (src * val) >> 15 from the 64 bit product, then a saturated add,
+       4 samples at a time */
+    if (n >= 4)
+    {
+        LVM_INT32 count = n & ~3;
+        n -= count;
+        asm (
+            "vdup.32        d4, %[val]                   \n"
+            "1:                                          \n"
+            "vld1.32        {d0, d1}, [%[src]]!          \n"
+            "vld1.32        {d2, d3}, [%[dst]]           \n"
+            "subs           %[count], %[count], #4       \n"    /* update loop counter */
+            "vmull.s32      q8, d0, d4[0]                \n"
+            "vmull.s32      q9, d1, d4[0]                \n"
+            "vshrn.i64      d0, q8, #15                  \n"
+            "vshrn.i64      d1, q9, #15                  \n"
+            "vqadd.s32      q0, q0, q1                   \n"
+            "vst1.32        {d0, d1}, [%[dst]]!          \n"
+            "bne            1b                           \n"    /* loop */
+            : [src]     "+r" (src),
+              [dst]     "+r" (dst),
+              [count]   "+r" (count)
+            : [val]     "r" ((LVM_INT32)val)
+            : "cc", "memory",
+              "q0", "q1", "q2", "q8", "q9"
+        );
+    }
+#endif
 
     for (ii = n; ii != 0; ii--)
     {
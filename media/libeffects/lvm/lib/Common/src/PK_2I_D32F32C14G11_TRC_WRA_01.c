@@ -47,6 +47,49 @@ void PK_2I_D32F32C14G11_TRC_WRA_01 ( Biquad_Instance_t       *pInstance,
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
 
+#if LVM_USE_NEON
+        /* Left and right are filtered together in the two lanes of a D register,
+           the delays stay in registers for the whole block */
+        if (NrSamples > 0)
+        {
+            LVM_INT32 n = NrSamples;
+            asm (
+                "vld1.32        {d0, d1}, [%[coefs]]         \n"    /* d0 = A0 -B2, d1 = -B1 Gain */
+                "vld1.32        {d4-d7}, [%[delays]]         \n"    /* x(n-1), x(n-2), y(n-1), y(n-2) */
+                "1:                                          \n"
+                "vld1.32        {d16}, [%[in]]!              \n"    /* x(n) L R */
+                "subs           %[n], %[n], #1               \n"    /* update loop counter */
+                "vsub.i32       d17, d16, d5                 \n"    /* x(n) - x(n-2) */
+                "vmull.s32      q9, d17, d0[0]               \n"    /* A0 * (x(n) - x(n-2)) */
+                "vmull.s32      q10, d7, d0[1]               \n"    /* -B2 * y(n-2) */
+                "vmull.s32      q11, d6, d1[0]               \n"    /* -B1 * y(n-1) */
+                "vshrn.i64      d18, q9, #14                 \n"
+                "vshrn.i64      d20, q10, #14                \n"
+                "vshrn.i64      d22, q11, #14                \n"
+                "vadd.i32       d18, d18, d20                \n"
+                "vadd.i32       d18, d18, d22                \n"    /* y(n) L R */
+                "vmull.s32      q12, d18, d1[1]              \n"    /* Gain * y(n) */
+                "vshrn.i64      d24, q12, #11                \n"
+                "vadd.i32       d24, d24, d16                \n"    /* output = Gain * y(n) + x(n) */
+                "vmov           d5, d4                       \n"    /* x(n-2) = x(n-1) */
+                "vmov           d4, d16                      \n"    /* x(n-1) = x(n) */
+                "vmov           d7, d6                       \n"    /* y(n-2) = y(n-1) */
+                "vmov           d6, d18                      \n"    /* y(n-1) = y(n) */
+                "vst1.32        {d24}, [%[out]]!             \n"
+                "bne            1b                           \n"    /* loop */
+                "vst1.32        {d4-d7}, [%[delays]]         \n"
+                : [in]      "+r" (pDataIn),
+                  [out]     "+r" (pDataOut),
+                  [n]       "+r" (n)
+                : [coefs]   "r" (pBiquadState->coefs),
+                  [delays]  "r" (pBiquadState->pDelays)
+                : "cc", "memory",
+                  "q0", "q2", "q3", "q8", "q9", "q10", "q11", "q12"
+            );
+            return;
+        }
+#endif
+
          for (ii = NrSamples; ii != 0; ii--)
          {
 
@@ -705,6 +705,31 @@ int LvmBundle_init(EffectContext *pContext){
 //
 //----------------------------------------------------------------------------
 
+//----------------------------------------------------------------------------
+// LvmBundle_getWorkBuffer()
+//----------------------------------------------------------------------------
+// Purpose:
+// Return the stereo 16 bit work buffer of the bundle, reallocated if needed
+// to hold frameCount frames
+//
+// Inputs:
+//  frameCount: Frames to process
+//  pContext:   effect engine context
+//
+//----------------------------------------------------------------------------
+
+LVM_INT16 *LvmBundle_getWorkBuffer(int frameCount, EffectContext *pContext){
+    if (pContext->pBundledContext->frameCount != frameCount) {
+        if (pContext->pBundledContext->workBuffer != NULL) {
+            free(pContext->pBundledContext->workBuffer);
+        }
+        pContext->pBundledContext->workBuffer =
+                (LVM_INT16 *)malloc(frameCount * sizeof(LVM_INT16) * 2);
+        pContext->pBundledContext->frameCount = frameCount;
+    }
+    return pContext->pBundledContext->workBuffer;
+}
+
 int LvmBundle_process(LVM_INT16        *pIn,
                       LVM_INT16        *pOut,
                       int              frameCount,
@@ -717,15 +742,7 @@ int LvmBundle_process(LVM_INT16        *pIn,
     if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_WRITE){
         pOutTmp = pOut;
     }else if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE){
-        if (pContext->pBundledContext->frameCount != frameCount) {
-            if (pContext->pBundledContext->workBuffer != NULL) {
-                free(pContext->pBundledContext->workBuffer);
-            }
-            pContext->pBundledContext->workBuffer =
-                    (LVM_INT16 *)malloc(frameCount * sizeof(LVM_INT16) * 2);
-            pContext->pBundledContext->frameCount = frameCount;
-        }
-        pOutTmp = pContext->pBundledContext->workBuffer;
+        pOutTmp = LvmBundle_getWorkBuffer(frameCount, pContext);
     }else{
         ALOGV("LVM_ERROR : LvmBundle_process invalid access mode");
         return -EINVAL;
@@ -761,6 +778,66 @@ int LvmBundle_process(LVM_INT16        *pIn,
     return 0;
 }    /* end LvmBundle_process */
 
+//----------------------------------------------------------------------------
+// LvmBundle_process32()
+//----------------------------------------------------------------------------
+// Purpose:
+// Apply LVM Bundle effects to AUDIO_FORMAT_PCM_8_24_BIT data
+//
+// The LVM bundle processes 16 bit samples, so the input is converted once into
+// the work buffer, processed in place, and converted back while writing or
+// accumulating into the output, which keeps the headroom of the 32 bit mix.
+//
+// Inputs:
+//  pIn:        pointer to stereo Q8.23 input data
+//  pOut:       pointer to stereo Q8.23 output data
+//  frameCount: Frames to process
+//  pContext:   effect engine context
+//
+//  Outputs:
+//  pOut:       pointer to updated stereo Q8.23 output data
+//
+//----------------------------------------------------------------------------
+
+int LvmBundle_process32(LVM_INT32        *pIn,
+                        LVM_INT32        *pOut,
+                        int              frameCount,
+                        EffectContext    *pContext){
+
+    LVM_ReturnStatus_en     LvmStatus = LVM_SUCCESS;                /* Function call status */
+    LVM_INT16               *pWork = LvmBundle_getWorkBuffer(frameCount, pContext);
+
+    if (pWork == NULL){
+        ALOGV("LVM_ERROR : LvmBundle_process32 failed to allocate the work buffer");
+        return -EINVAL;
+    }
+
+    for (int i=0; i<frameCount*2; i++){
+        pWork[i] = clamp16(pIn[i] >> 8);
+    }
+
+    /* Process the samples */
+    LvmStatus = LVM_Process(pContext->pBundledContext->hInstance, /* Instance handle */
+                            pWork,                                /* Input buffer */
+                            pWork,                                /* Output buffer */
+                            (LVM_UINT16)frameCount,               /* Number of samples to read */
+                            0);                                   /* Audo Time */
+
+    LVM_ERROR_CHECK(LvmStatus, "LVM_Process", "LvmBundle_process32")
+    if(LvmStatus != LVM_SUCCESS) return -EINVAL;
+
+    if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE){
+        for (int i=0; i<frameCount*2; i++){
+            pOut[i] += (LVM_INT32)pWork[i] << 8;
+        }
+    }else{
+        for (int i=0; i<frameCount*2; i++){
+            pOut[i] = (LVM_INT32)pWork[i] << 8;
+        }
+    }
+    return 0;
+}    /* end LvmBundle_process32 */
+
 //----------------------------------------------------------------------------
 // LvmEffect_enable()
 //----------------------------------------------------------------------------
@@ -932,7 +1009,8 @@ int Effect_setConfig(EffectContext *pContext, effect_config_t *pConfig){
     CHECK_ARG(pConfig->inputCfg.channels == AUDIO_CHANNEL_OUT_STEREO);
     CHECK_ARG(pConfig->outputCfg.accessMode == EFFECT_BUFFER_ACCESS_WRITE
               || pConfig->outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE);
-    CHECK_ARG(pConfig->inputCfg.format == AUDIO_FORMAT_PCM_16_BIT);
+    CHECK_ARG(pConfig->inputCfg.format == AUDIO_FORMAT_PCM_16_BIT
+              || pConfig->inputCfg.format == AUDIO_FORMAT_PCM_8_24_BIT);
 
     pContext->config = *pConfig;
 
@@ -2684,10 +2762,17 @@ int Effect_process(effect_handle_t     self,
         pContext->pBundledContext->NumberEffectsCalled = 0;
         /* Process all the available frames, block processing is
            handled internalLY by the LVM bundle */
-        lvmStatus = android::LvmBundle_process(    (LVM_INT16 *)inBuffer->raw,
-                                                (LVM_INT16 *)outBuffer->raw,
-                                                outBuffer->frameCount,
-                                                pContext);
+        if (pContext->config.inputCfg.format == AUDIO_FORMAT_PCM_8_24_BIT) {
+            lvmStatus = android::LvmBundle_process32((LVM_INT32 *)inBuffer->raw,
+                                                     (LVM_INT32 *)outBuffer->raw,
+                                                     outBuffer->frameCount,
+                                                     pContext);
+        } else {
+            lvmStatus = android::LvmBundle_process(    (LVM_INT16 *)inBuffer->raw,
+                                                    (LVM_INT16 *)outBuffer->raw,
+                                                    outBuffer->frameCount,
+                                                    pContext);
+        }
         if(lvmStatus != LVM_SUCCESS){
             ALOGV("\tLVM_ERROR : LvmBundle_process returned error %d", lvmStatus);
             return lvmStatus;
@@ -2697,7 +2782,17 @@ int Effect_process(effect_handle_t     self,
         //pContext->pBundledContext->NumberEffectsEnabled,
         //pContext->pBundledContext->NumberEffectsCalled, pContext->EffectType);
         // 2 is for stereo input
-        if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
+        if (pContext->config.inputCfg.format == AUDIO_FORMAT_PCM_8_24_BIT) {
+            if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
+                LVM_INT32 *in32  = (LVM_INT32 *)inBuffer->raw;
+                LVM_INT32 *out32 = (LVM_INT32 *)outBuffer->raw;
+                for (size_t i=0; i < outBuffer->frameCount*2; i++){
+                    out32[i] += in32[i];
+                }
+            } else if (outBuffer->raw != inBuffer->raw) {
+                memcpy(outBuffer->raw, inBuffer->raw, outBuffer->frameCount*sizeof(LVM_INT32)*2);
+            }
+        } else if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
             for (size_t i=0; i < outBuffer->frameCount*2; i++){
                 outBuffer->s16[i] =
                         clamp16((LVM_INT32)outBuffer->s16[i] + (LVM_INT32)inBuffer->s16[i]);
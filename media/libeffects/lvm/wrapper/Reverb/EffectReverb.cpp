@@ -390,6 +390,84 @@ static inline int16_t clamp16(int32_t sample)
     return sample;
 }
 
+//----------------------------------------------------------------------------
+// process32Output()
+//----------------------------------------------------------------------------
+// Purpose:
+// Mix, apply the volume to and write the output of LVREV for the Q8.23 format,
+// with the same volume ramps as the 16 bit path of process()
+//
+// Inputs:
+//  pIn:        pointer to stereo/mono Q8.23 input data, the dry signal for insert reverb
+//  pOut:       pointer to stereo Q8.23 output data
+//  frameCount: Frames to process
+//  pContext:   effect engine context, with the reverb output in OutFrames32
+//
+//  Outputs:
+//  pOut:       pointer to updated stereo Q8.23 output data
+//
+//----------------------------------------------------------------------------
+
+int process32Output( LVM_INT32     *pIn,
+                     LVM_INT32     *pOut,
+                     int           frameCount,
+                     ReverbContext *pContext){
+
+    LVM_INT32 *OutFrames32 = pContext->OutFrames32;
+
+    if (!pContext->auxiliary) {
+        for (int i=0; i < frameCount*2; i++) { //always stereo here
+            OutFrames32[i] += pIn[i];
+        }
+
+        // apply volume with ramp if needed
+        if ((pContext->leftVolume != pContext->prevLeftVolume ||
+                pContext->rightVolume != pContext->prevRightVolume) &&
+                pContext->volumeMode == REVERB_VOLUME_RAMP) {
+            LVM_INT32 vl = (LVM_INT32)pContext->prevLeftVolume << 16;
+            LVM_INT32 incl = (((LVM_INT32)pContext->leftVolume << 16) - vl) / frameCount;
+            LVM_INT32 vr = (LVM_INT32)pContext->prevRightVolume << 16;
+            LVM_INT32 incr = (((LVM_INT32)pContext->rightVolume << 16) - vr) / frameCount;
+
+            for (int i = 0; i < frameCount; i++) {
+                OutFrames32[2*i] = (LVM_INT32)(((int64_t)(vl >> 16) * OutFrames32[2*i]) >> 12);
+                OutFrames32[2*i+1] =
+                        (LVM_INT32)(((int64_t)(vr >> 16) * OutFrames32[2*i+1]) >> 12);
+
+                vl += incl;
+                vr += incr;
+            }
+
+            pContext->prevLeftVolume = pContext->leftVolume;
+            pContext->prevRightVolume = pContext->rightVolume;
+        } else if (pContext->volumeMode != REVERB_VOLUME_OFF) {
+            if (pContext->leftVolume != REVERB_UNIT_VOLUME ||
+                pContext->rightVolume != REVERB_UNIT_VOLUME) {
+                for (int i = 0; i < frameCount; i++) {
+                    OutFrames32[2*i] = (LVM_INT32)
+                            (((int64_t)pContext->leftVolume * OutFrames32[2*i]) >> 12);
+                    OutFrames32[2*i+1] = (LVM_INT32)
+                            (((int64_t)pContext->rightVolume * OutFrames32[2*i+1]) >> 12);
+                }
+            }
+            pContext->prevLeftVolume = pContext->leftVolume;
+            pContext->prevRightVolume = pContext->rightVolume;
+            pContext->volumeMode = REVERB_VOLUME_RAMP;
+        }
+    }
+
+    // Accumulate if required
+    if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE){
+        for (int i=0; i<frameCount*2; i++){ //always stereo here
+            pOut[i] += OutFrames32[i];
+        }
+    }else{
+        memcpy(pOut, OutFrames32, frameCount*sizeof(LVM_INT32)*2);
+    }
+
+    return 0;
+}    /* end process32Output */
+
 //----------------------------------------------------------------------------
 // process()
 //----------------------------------------------------------------------------
@@ -406,16 +484,25 @@ static inline int16_t clamp16(int32_t sample)
 //  Outputs:
 //  pOut:       pointer to updated stereo 16 bit output data
 //
+// The input and output are Q8.23 in 32 bit instead when the configured format is
+// AUDIO_FORMAT_PCM_8_24_BIT.  This is the scale LVREV works at, so the auxiliary
+// input is passed to LVREV as is, and the output is not converted nor clamped.
+//
 //----------------------------------------------------------------------------
 
-int process( LVM_INT16     *pIn,
-             LVM_INT16     *pOut,
+int process( void          *pIn,
+             void          *pOut,
              int           frameCount,
              ReverbContext *pContext){
 
     LVM_INT16               samplesPerFrame = 1;
     LVREV_ReturnStatus_en   LvmStatus = LVREV_SUCCESS;              /* Function call status */
     LVM_INT16 *OutFrames16;
+    LVM_INT16 *pIn16 = (LVM_INT16 *)pIn;
+    LVM_INT16 *pOut16 = (LVM_INT16 *)pOut;
+    LVM_INT32 *pIn32 = (LVM_INT32 *)pIn;
+    LVM_INT32 *pRevIn = pContext->InFrames32;
+    bool      q8_23 = (pContext->config.inputCfg.format == AUDIO_FORMAT_PCM_8_24_BIT);
 
 
     // Check that the input is either mono or stereo
@@ -435,7 +522,7 @@ int process( LVM_INT16     *pIn,
     }
 
     #ifdef LVM_PCM
-    fwrite(pIn, frameCount*sizeof(LVM_INT16)*samplesPerFrame, 1, pContext->PcmInPtr);
+    fwrite(pIn16, frameCount*sizeof(LVM_INT16)*samplesPerFrame, 1, pContext->PcmInPtr);
     fflush(pContext->PcmInPtr);
     #endif
 
@@ -446,15 +533,24 @@ int process( LVM_INT16     *pIn,
 
 
     // Convert to Input 32 bits
-    if (pContext->auxiliary) {
+    if (q8_23) {
+        if (pContext->auxiliary) {
+            pRevIn = pIn32;
+        } else {
+            for (int i = 0; i < frameCount*2; i++) {
+                pContext->InFrames32[i] =
+                        (LVM_INT32)(((int64_t)pIn32[i] * REVERB_SEND_LEVEL) >> 12);
+            }
+        }
+    } else if (pContext->auxiliary) {
         for(int i=0; i<frameCount*samplesPerFrame; i++){
-            pContext->InFrames32[i] = (LVM_INT32)pIn[i]<<8;
+            pContext->InFrames32[i] = (LVM_INT32)pIn16[i]<<8;
         }
     } else {
         // insert reverb input is always stereo
         for (int i = 0; i < frameCount; i++) {
-            pContext->InFrames32[2*i] = (pIn[2*i] * REVERB_SEND_LEVEL) >> 4; // <<8 + >>12
-            pContext->InFrames32[2*i+1] = (pIn[2*i+1] * REVERB_SEND_LEVEL) >> 4; // <<8 + >>12
+            pContext->InFrames32[2*i] = (pIn16[2*i] * REVERB_SEND_LEVEL) >> 4; // <<8 + >>12
+            pContext->InFrames32[2*i+1] = (pIn16[2*i+1] * REVERB_SEND_LEVEL) >> 4; // <<8 + >>12
         }
     }
 
@@ -463,12 +559,13 @@ int process( LVM_INT16     *pIn,
     } else {
         if(pContext->bEnabled == LVM_FALSE && pContext->SamplesToExitCount > 0) {
             memset(pContext->InFrames32,0,frameCount * sizeof(LVM_INT32) * samplesPerFrame);
+            pRevIn = pContext->InFrames32;
             ALOGV("\tZeroing %d samples per frame at the end of call", samplesPerFrame);
         }
 
         /* Process the samples, producing a stereo output */
         LvmStatus = LVREV_Process(pContext->hInstance,      /* Instance handle */
-                                  pContext->InFrames32,     /* Input buffer */
+                                  pRevIn,                   /* Input buffer */
                                   pContext->OutFrames32,    /* Output buffer */
                                   frameCount);              /* Number of samples to read */
     }
@@ -476,6 +573,10 @@ int process( LVM_INT16     *pIn,
     LVM_ERROR_CHECK(LvmStatus, "LVREV_Process", "process")
     if(LvmStatus != LVREV_SUCCESS) return -EINVAL;
 
+    if (q8_23) {
+        return process32Output(pIn32, (LVM_INT32 *)pOut, frameCount, pContext);
+    }
+
     // Convert to 16 bits
     if (pContext->auxiliary) {
         for (int i=0; i < frameCount*2; i++) { //always stereo here
@@ -483,7 +584,7 @@ int process( LVM_INT16     *pIn,
         }
     } else {
         for (int i=0; i < frameCount*2; i++) { //always stereo here
-            OutFrames16[i] = clamp16((pContext->OutFrames32[i]>>8) + (LVM_INT32)pIn[i]);
+            OutFrames16[i] = clamp16((pContext->OutFrames32[i]>>8) + (LVM_INT32)pIn16[i]);
         }
 
         // apply volume with ramp if needed
@@ -532,11 +633,11 @@ int process( LVM_INT16     *pIn,
     if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE){
         //ALOGV("\tBuffer access is ACCUMULATE");
         for (int i=0; i<frameCount*2; i++){ //always stereo here
-            pOut[i] = clamp16((int32_t)pOut[i] + (int32_t)OutFrames16[i]);
+            pOut16[i] = clamp16((int32_t)pOut16[i] + (int32_t)OutFrames16[i]);
         }
     }else{
         //ALOGV("\tBuffer access is WRITE");
-        memcpy(pOut, OutFrames16, frameCount*sizeof(LVM_INT16)*2);
+        memcpy(pOut16, OutFrames16, frameCount*sizeof(LVM_INT16)*2);
     }
 
     return 0;
@@ -614,7 +715,8 @@ int Reverb_setConfig(ReverbContext *pContext, effect_config_t *pConfig){
     CHECK_ARG(pConfig->outputCfg.channels == AUDIO_CHANNEL_OUT_STEREO);
     CHECK_ARG(pConfig->outputCfg.accessMode == EFFECT_BUFFER_ACCESS_WRITE
               || pConfig->outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE);
-    CHECK_ARG(pConfig->inputCfg.format == AUDIO_FORMAT_PCM_16_BIT);
+    CHECK_ARG(pConfig->inputCfg.format == AUDIO_FORMAT_PCM_16_BIT
+              || pConfig->inputCfg.format == AUDIO_FORMAT_PCM_8_24_BIT);
 
     //ALOGV("\tReverb_setConfig calling memcpy");
     pContext->config = *pConfig;
@@ -1871,8 +1973,8 @@ int Reverb_process(effect_handle_t   self,
     }
     //ALOGV("\tReverb_process() Calling process with %d frames", outBuffer->frameCount);
     /* Process all the available frames, block processing is handled internalLY by the LVM bundle */
-    status = process(    (LVM_INT16 *)inBuffer->raw,
-                         (LVM_INT16 *)outBuffer->raw,
+    status = process(    inBuffer->raw,
+                         outBuffer->raw,
                                       outBuffer->frameCount,
                                       pContext);
 
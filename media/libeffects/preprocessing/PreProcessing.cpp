@@ -1158,6 +1158,67 @@ extern "C" {
 // Effect Control Interface Implementation
 //------------------------------------------------------------------------------
 
+// Processes as many whole APM frames as both buffers hold, copying straight between the caller's
+// buffers and the APM audio frame. Only possible when no resampling is needed and nothing is
+// pending in the staging buffers, which is always the case when the caller delivers multiples
+// of 10 ms. Returns the number of frames processed, 0 if the caller must use the staging path.
+size_t Session_ProcessDirect(preproc_session_t *session,
+                             audio_buffer_t *inBuffer,
+                             audio_buffer_t *outBuffer)
+{
+    if (session->inResampler != NULL || session->framesIn != 0 || session->framesOut != 0) {
+        return 0;
+    }
+    size_t frames = inBuffer->frameCount;
+    if (outBuffer->frameCount < frames) {
+        frames = outBuffer->frameCount;
+    }
+    frames -= frames % session->apmFrameCount;
+
+    for (size_t fr = 0; fr < frames; fr += session->apmFrameCount) {
+        memcpy(session->procFrame->_payloadData,
+               inBuffer->s16 + fr * session->inChannelCount,
+               session->apmFrameCount * session->inChannelCount * sizeof(int16_t));
+#ifdef DUAL_MIC_TEST
+        pthread_mutex_lock(&gPcmDumpLock);
+        if (gPcmDumpFh != NULL) {
+            fwrite(session->procFrame->_payloadData,
+                   session->apmFrameCount * session->inChannelCount * sizeof(int16_t), 1,
+                   gPcmDumpFh);
+        }
+        pthread_mutex_unlock(&gPcmDumpLock);
+#endif
+        session->procFrame->_payloadDataLengthInSamples =
+                session->apmFrameCount * session->inChannelCount;
+
+        session->apm->ProcessStream(session->procFrame);
+
+        memcpy(outBuffer->s16 + fr * session->outChannelCount,
+               session->procFrame->_payloadData,
+               session->apmFrameCount * session->outChannelCount * sizeof(int16_t));
+    }
+    return frames;
+}
+
+// Same as Session_ProcessDirect() for the reverse stream.
+size_t Session_ProcessReverseDirect(preproc_session_t *session, audio_buffer_t *inBuffer)
+{
+    if (session->revResampler != NULL || session->framesRev != 0) {
+        return 0;
+    }
+    size_t frames = inBuffer->frameCount - inBuffer->frameCount % session->apmFrameCount;
+
+    for (size_t fr = 0; fr < frames; fr += session->apmFrameCount) {
+        memcpy(session->revFrame->_payloadData,
+               inBuffer->s16 + fr * session->inChannelCount,
+               session->apmFrameCount * session->inChannelCount * sizeof(int16_t));
+        session->revFrame->_payloadDataLengthInSamples =
+                session->apmFrameCount * session->inChannelCount;
+        session->apm->AnalyzeReverseStream(session->revFrame);
+    }
+    return frames;
+}
+
 int PreProcessingFx_Process(effect_handle_t     self,
                             audio_buffer_t    *inBuffer,
                             audio_buffer_t    *outBuffer)
@@ -1184,6 +1245,12 @@ int PreProcessingFx_Process(effect_handle_t     self,
 
     if ((session->processedMsk & session->enabledMsk) == session->enabledMsk) {
         effect->session->processedMsk = 0;
+        size_t framesDirect = Session_ProcessDirect(session, inBuffer, outBuffer);
+        if (framesDirect != 0) {
+            inBuffer->frameCount = framesDirect;
+            outBuffer->frameCount = framesDirect;
+            return 0;
+        }
         size_t framesRq = outBuffer->frameCount;
         size_t framesWr = 0;
         if (session->framesOut) {
@@ -1735,6 +1802,11 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
 
     if ((session->revProcessedMsk & session->revEnabledMsk) == session->revEnabledMsk) {
         effect->session->revProcessedMsk = 0;
+        size_t framesDirect = Session_ProcessReverseDirect(session, inBuffer);
+        if (framesDirect != 0) {
+            inBuffer->frameCount = framesDirect;
+            return 0;
+        }
         if (session->revResampler != NULL) {
             size_t fr = session->frameCount - session->framesRev;
             if (inBuffer->frameCount < fr) {
@@ -220,14 +220,27 @@ int Effect_command(effect_handle_t  self,
         }
         effect_offload_param_t* offloadParam = (effect_offload_param_t*)pCmdData;
         // Assign the effect context index based on isOffload field of the structure
-        pContext->index = offloadParam->isOffload ? SUB_FX_OFFLOAD : SUB_FX_HOST;
+        int newIndex = offloadParam->isOffload ? SUB_FX_OFFLOAD : SUB_FX_HOST;
         // if the index is HW and the HW effect is unavailable, return error
         // and reset the index to SW
-        if (pContext->eHandle[pContext->index] == NULL) {
+        if (pContext->eHandle[newIndex] == NULL) {
             ALOGV("Effect_command()CMD_OFFLOAD sub effect unavailable");
+            pContext->index = SUB_FX_HOST;
             *(int*)pReplyData = FAILED_TRANSACTION;
             return FAILED_TRANSACTION;
         }
+        // Both sub effects receive every configuration, parameter and enable command,
+        // so the one taking over already has the same settings and needs no replay.
+        // The host effect however has not processed any audio while the DSP was active:
+        // clear its delay lines and ramps before it runs again so that the stale history
+        // from before the session moved is not heard as a click on the way back.
+        if (newIndex != pContext->index && newIndex == SUB_FX_HOST &&
+                pContext->eHandle[SUB_FX_HOST] != NULL) {
+            ALOGV("Effect_command()CMD_OFFLOAD resetting host sub effect");
+            (*pContext->eHandle[SUB_FX_HOST])->command(pContext->eHandle[SUB_FX_HOST],
+                             EFFECT_CMD_RESET, 0, NULL, NULL, NULL);
+        }
+        pContext->index = newIndex;
         pContext->ioId = offloadParam->ioHandle;
         ALOGV("Effect_command()CMD_OFFLOAD index:%d io %d", pContext->index, pContext->ioId);
         // Update the DSP wrapper with the new ioHandle.
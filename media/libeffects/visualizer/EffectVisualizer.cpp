@@ -17,6 +17,7 @@
 #define LOG_TAG "EffectVisualizer"
 //#define LOG_NDEBUG 0
 #include <cutils/log.h>
+#include <cutils/properties.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,6 +25,14 @@
 #include <time.h>
 #include <math.h>
 #include <audio_effects/effect_visualizer.h>
+#include <audio_utils/fixedfft.h>
+#include <media/EffectVisualizerApi.h>
+
+#if defined(__arm__) && !defined(__thumb__) && defined(__ARM_NEON__)
+#define USE_NEON (true)
+#else
+#define USE_NEON (false)
+#endif
 
 
 extern "C" {
@@ -84,6 +93,13 @@ struct VisualizerContext {
     uint8_t mMeasurementWindowSizeInBuffers;
     uint8_t mMeasurementBufferIdx;
     BufferStats mPastMeasurements[MEASUREMENT_WINDOW_MAX_SIZE_IN_BUFFERS];
+    // for the server side FFT shared by all clients, see VISUALIZER_CMD_CAPTURE_FFT
+    uint32_t mFftPeriodMs;
+    bool mFftValid;
+    uint32_t mFftSize;          // capture size of the cached FFT
+    struct timespec mFftTime;
+    uint8_t mFftWaveform[VISUALIZER_CAPTURE_SIZE_MAX];
+    uint8_t mFft[VISUALIZER_CAPTURE_SIZE_MAX];
 };
 
 //
@@ -114,6 +130,105 @@ void Visualizer_reset(VisualizerContext *pContext)
     pContext->mBufferUpdateTime.tv_sec = 0;
     pContext->mLatency = 0;
     memset(pContext->mCaptureBuf, 0x80, CAPTURE_BUF_SIZE);
+    pContext->mFftValid = false;
+}
+
+// Copy the current capture, compensated for latency, into buf which must hold mCaptureSize bytes
+void Visualizer_capture(VisualizerContext *pContext, uint8_t *buf)
+{
+    if (pContext->mState == VISUALIZER_STATE_ACTIVE) {
+        int32_t latencyMs = pContext->mLatency;
+        const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
+        latencyMs -= deltaMs;
+        if (latencyMs < 0) {
+            latencyMs = 0;
+        }
+        const uint32_t deltaSmpl = pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
+
+        int32_t capturePoint = pContext->mCaptureIdx - pContext->mCaptureSize - deltaSmpl;
+        int32_t captureSize = pContext->mCaptureSize;
+        uint8_t *dst = buf;
+        if (capturePoint < 0) {
+            int32_t size = -capturePoint;
+            if (size > captureSize) {
+                size = captureSize;
+            }
+            memcpy(dst,
+                   pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
+                   size);
+            dst += size;
+            captureSize -= size;
+            capturePoint = 0;
+        }
+        memcpy(dst,
+               pContext->mCaptureBuf + capturePoint,
+               captureSize);
+
+
+        // if audio framework has stopped playing audio although the effect is still
+        // active we must clear the capture buffer to return silence
+        if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
+                (pContext->mBufferUpdateTime.tv_sec != 0)) {
+            if (deltaMs > MAX_STALL_TIME_MS) {
+                ALOGV("capture going to idle");
+                pContext->mBufferUpdateTime.tv_sec = 0;
+                memset(buf, 0x80, pContext->mCaptureSize);
+            }
+        }
+        pContext->mLastCaptureIdx = pContext->mCaptureIdx;
+    } else {
+        memset(buf, 0x80, pContext->mCaptureSize);
+    }
+}
+
+// Update the cached waveform and FFT returned by VISUALIZER_CMD_CAPTURE_FFT, unless the cache
+// was computed less than mFftPeriodMs ago for the same capture size. The FFT is the same as
+// the one historically done by each Visualizer client on its own capture.
+void Visualizer_fft(VisualizerContext *pContext)
+{
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) < 0) {
+        now.tv_sec = 0;
+    }
+    if (pContext->mFftValid && pContext->mFftSize == pContext->mCaptureSize &&
+            pContext->mState == VISUALIZER_STATE_ACTIVE && now.tv_sec != 0) {
+        int64_t elapsedMs = (now.tv_sec - pContext->mFftTime.tv_sec) * 1000LL +
+                (now.tv_nsec - pContext->mFftTime.tv_nsec) / 1000000;
+        if (elapsedMs >= 0 && elapsedMs < pContext->mFftPeriodMs) {
+            return;
+        }
+    }
+
+    const uint32_t size = pContext->mCaptureSize;
+    uint8_t *waveform = pContext->mFftWaveform;
+    uint8_t *fft = pContext->mFft;
+    Visualizer_capture(pContext, waveform);
+
+    int32_t workspace[VISUALIZER_CAPTURE_SIZE_MAX >> 1];
+    int32_t nonzero = 0;
+    for (uint32_t i = 0; i < size; i += 2) {
+        workspace[i >> 1] =
+                ((waveform[i] ^ 0x80) << 24) | ((waveform[i + 1] ^ 0x80) << 8);
+        nonzero |= workspace[i >> 1];
+    }
+
+    if (nonzero) {
+        fixed_fft_real(size >> 1, workspace);
+    }
+
+    for (uint32_t i = 0; i < size; i += 2) {
+        short tmp = workspace[i >> 1] >> 21;
+        while (tmp > 127 || tmp < -128) tmp >>= 1;
+        fft[i] = tmp;
+        tmp = workspace[i >> 1];
+        tmp >>= 5;
+        while (tmp > 127 || tmp < -128) tmp >>= 1;
+        fft[i + 1] = tmp;
+    }
+
+    pContext->mFftValid = true;
+    pContext->mFftSize = size;
+    pContext->mFftTime = now;
 }
 
 //----------------------------------------------------------------------------
@@ -216,6 +331,15 @@ int Visualizer_init(VisualizerContext *pContext)
         pContext->mPastMeasurements[i].mRmsSquared = 0;
     }
 
+    // server side FFT initialization
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get(VISUALIZER_FFT_PERIOD_PROPERTY, value, NULL) > 0) {
+        pContext->mFftPeriodMs = atoi(value);
+    } else {
+        pContext->mFftPeriodMs = VISUALIZER_FFT_PERIOD_MS_DEFAULT;
+    }
+    pContext->mFftValid = false;
+
     Visualizer_setConfig(pContext, &pContext->mConfig);
 
     return 0;
@@ -302,6 +426,75 @@ static inline int16_t clamp16(int32_t sample)
     return sample;
 }
 
+// Scan count 16 bit samples in a single pass and return:
+//  - maxMag: the largest magnitude as used by the normalized scaling mode, that is x for x >= 0
+//    and -x - 1 for x < 0 so that the max negative value stays in range,
+//  - peak: the largest absolute value, saturated to 32767,
+//  - sumSquares: the sum of the squares of the samples, if not NULL.
+// The NEON loop consumes 8 samples per iteration and leaves the remainder to the scalar loop.
+static void Visualizer_scanSamples(const int16_t *in, size_t count,
+        uint16_t *maxMag, uint16_t *peak, uint64_t *sumSquares)
+{
+    uint16_t mag = 0;
+    uint16_t abs = 0;
+    uint64_t sum = 0;
+#if USE_NEON
+    size_t neonCount = count & ~7;
+    if (neonCount != 0) {
+        uint16_t mags[8];
+        uint16_t abss[8];
+        uint64_t sums[2];
+        count -= neonCount;
+        asm (
+            "vmov.i16       q10, #0                  \n"    // q10 = max magnitudes
+            "vmov.i16       q11, #0                  \n"    // q11 = max absolute values
+            "vmov.i64       q12, #0                  \n"    // q12 = 2 64-bits sums of squares
+            "1:                                      \n"
+            "vld1.16        {d0, d1}, [%[in]]!       \n"    // load 8 16-bits samples
+            "subs           %[count], %[count], #8   \n"    // update loop counter
+            "vshr.s16       q1, q0, #15              \n"    // sign masks
+            "veor           q1, q1, q0               \n"    // x or -x - 1
+            "vmax.u16       q10, q10, q1             \n"
+            "vqabs.s16      q2, q0                   \n"    // saturated |x|
+            "vmax.u16       q11, q11, q2             \n"
+            "vmull.s16      q8, d0, d0               \n"    // squares of samples 0 to 3
+            "vmull.s16      q9, d1, d1               \n"    // squares of samples 4 to 7
+            "vpadal.u32     q12, q8                  \n"    // accumulate into 64 bits
+            "vpadal.u32     q12, q9                  \n"
+            "bne            1b                       \n"    // loop
+            "vst1.16        {d20, d21}, [%[mags]]    \n"
+            "vst1.16        {d22, d23}, [%[abss]]    \n"
+            "vst1.64        {d24, d25}, [%[sums]]    \n"
+            : [in]      "+r" (in),
+              [count]   "+r" (neonCount)
+            : [mags]    "r" (mags),
+              [abss]    "r" (abss),
+              [sums]    "r" (sums)
+            : "cc", "memory",
+              "q0", "q1", "q2", "q8", "q9", "q10", "q11", "q12"
+        );
+        for (int i = 0; i < 8; i++) {
+            if (mags[i] > mag) mag = mags[i];
+            if (abss[i] > abs) abs = abss[i];
+        }
+        sum = sums[0] + sums[1];
+    }
+#endif
+    for (size_t i = 0; i < count; i++) {
+        int32_t smp = in[i];
+        uint16_t m = (uint16_t)(smp ^ (smp >> 15));
+        if (m > mag) mag = m;
+        uint16_t a = smp < 0 ? (smp == -32768 ? 32767 : -smp) : smp;
+        if (a > abs) abs = a;
+        sum += (uint32_t)(smp * smp);
+    }
+    *maxMag = mag;
+    *peak = abs;
+    if (sumSquares != NULL) {
+        *sumSquares = sum;
+    }
+}
+
 int Visualizer_process(
         effect_handle_t self,audio_buffer_t *inBuffer, audio_buffer_t *outBuffer)
 {
@@ -318,24 +511,20 @@ int Visualizer_process(
         return -EINVAL;
     }
 
+    const uint32_t sampleCount = inBuffer->frameCount * pContext->mChannelCount;
+    const bool measure = (pContext->mMeasurementMode & MEASUREMENT_MODE_PEAK_RMS) != 0;
+    uint16_t maxMag;
+    uint16_t peak;
+    uint64_t sumSquares;
+    Visualizer_scanSamples(inBuffer->s16, sampleCount, &maxMag, &peak,
+            measure ? &sumSquares : NULL);
+
     // perform measurements if needed
-    if (pContext->mMeasurementMode & MEASUREMENT_MODE_PEAK_RMS) {
-        // find the peak and RMS squared for the new buffer
-        uint32_t inIdx;
-        int16_t maxSample = 0;
-        float rmsSqAcc = 0;
-        for (inIdx = 0 ; inIdx < inBuffer->frameCount * pContext->mChannelCount ; inIdx++) {
-            if (inBuffer->s16[inIdx] > maxSample) {
-                maxSample = inBuffer->s16[inIdx];
-            } else if (-inBuffer->s16[inIdx] > maxSample) {
-                maxSample = -inBuffer->s16[inIdx];
-            }
-            rmsSqAcc += (inBuffer->s16[inIdx] * inBuffer->s16[inIdx]);
-        }
-        // store the measurement
-        pContext->mPastMeasurements[pContext->mMeasurementBufferIdx].mPeakU16 = (uint16_t)maxSample;
+    if (measure) {
+        // store the peak and RMS squared for the new buffer
+        pContext->mPastMeasurements[pContext->mMeasurementBufferIdx].mPeakU16 = peak;
         pContext->mPastMeasurements[pContext->mMeasurementBufferIdx].mRmsSquared =
-                rmsSqAcc / (inBuffer->frameCount * pContext->mChannelCount);
+                (float)sumSquares / sampleCount;
         pContext->mPastMeasurements[pContext->mMeasurementBufferIdx].mIsValid = true;
         if (++pContext->mMeasurementBufferIdx >= pContext->mMeasurementWindowSizeInBuffers) {
             pContext->mMeasurementBufferIdx = 0;
@@ -348,14 +537,7 @@ int Visualizer_process(
     if (pContext->mScalingMode == VISUALIZER_SCALING_MODE_NORMALIZED) {
         // derive capture scaling factor from peak value in current buffer
         // this gives more interesting captures for display.
-        shift = 32;
-        int len = inBuffer->frameCount * 2;
-        for (int i = 0; i < len; i++) {
-            int32_t smp = inBuffer->s16[i];
-            if (smp < 0) smp = -smp - 1; // take care to keep the max negative in range
-            int32_t clz = __builtin_clz(smp);
-            if (shift > clz) shift = clz;
-        }
+        shift = maxMag == 0 ? 32 : __builtin_clz(maxMag);
         // A maximum amplitude signal will have 17 leading zeros, which we want to
         // translate to a shift of 8 (for converting 16 bit to 8 bit)
         shift = 25 - shift;
@@ -550,49 +732,25 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
                     *replySize, pContext->mCaptureSize);
             return -EINVAL;
         }
-        if (pContext->mState == VISUALIZER_STATE_ACTIVE) {
-            int32_t latencyMs = pContext->mLatency;
-            const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
-            latencyMs -= deltaMs;
-            if (latencyMs < 0) {
-                latencyMs = 0;
-            }
-            const uint32_t deltaSmpl = pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
-
-            int32_t capturePoint = pContext->mCaptureIdx - pContext->mCaptureSize - deltaSmpl;
-            int32_t captureSize = pContext->mCaptureSize;
-            if (capturePoint < 0) {
-                int32_t size = -capturePoint;
-                if (size > captureSize) {
-                    size = captureSize;
-                }
-                memcpy(pReplyData,
-                       pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
-                       size);
-                pReplyData = (char *)pReplyData + size;
-                captureSize -= size;
-                capturePoint = 0;
-            }
-            memcpy(pReplyData,
-                   pContext->mCaptureBuf + capturePoint,
-                   captureSize);
-
-
-            // if audio framework has stopped playing audio although the effect is still
-            // active we must clear the capture buffer to return silence
-            if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
-                    (pContext->mBufferUpdateTime.tv_sec != 0)) {
-                if (deltaMs > MAX_STALL_TIME_MS) {
-                    ALOGV("capture going to idle");
-                    pContext->mBufferUpdateTime.tv_sec = 0;
-                    memset(pReplyData, 0x80, pContext->mCaptureSize);
-                }
-            }
-            pContext->mLastCaptureIdx = pContext->mCaptureIdx;
+        Visualizer_capture(pContext, (uint8_t *)pReplyData);
+        break;
+
+    case VISUALIZER_CMD_CAPTURE_FFT:
+        if (pReplyData == NULL || pContext->mCaptureSize > VISUALIZER_CAPTURE_SIZE_MAX ||
+                (*replySize != pContext->mCaptureSize &&
+                *replySize != 2 * pContext->mCaptureSize)) {
+            ALOGV("VISUALIZER_CMD_CAPTURE_FFT() error *replySize %d pContext->mCaptureSize %d",
+                    *replySize, pContext->mCaptureSize);
+            return -EINVAL;
+        }
+        Visualizer_fft(pContext);
+        if (*replySize == pContext->mCaptureSize) {
+            memcpy(pReplyData, pContext->mFft, pContext->mCaptureSize);
         } else {
-            memset(pReplyData, 0x80, pContext->mCaptureSize);
+            memcpy(pReplyData, pContext->mFftWaveform, pContext->mCaptureSize);
+            memcpy((uint8_t *)pReplyData + pContext->mCaptureSize, pContext->mFft,
+                    pContext->mCaptureSize);
         }
-
         break;
 
     case VISUALIZER_CMD_MEASURE: {
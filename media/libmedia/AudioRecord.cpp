@@ -556,32 +556,57 @@ status_t AudioRecord::obtainBuffer(Buffer* audioBuffer, int32_t waitCount)
         return INVALID_OPERATION;
     }
 
-    const struct timespec *requested;
+    struct timespec timeout;
+    return obtainBuffer(audioBuffer, waitCountToTimeout(waitCount, &timeout));
+}
+
+status_t AudioRecord::obtainBuffers(Buffer buffers[2], int32_t waitCount)
+{
+    if (buffers == NULL) {
+        return BAD_VALUE;
+    }
+    if (mTransfer != TRANSFER_OBTAIN) {
+        for (size_t i = 0; i < 2; i++) {
+            buffers[i].frameCount = 0;
+            buffers[i].size = 0;
+            buffers[i].raw = NULL;
+        }
+        return INVALID_OPERATION;
+    }
+
+    struct timespec timeout;
+    return obtainBuffer(&buffers[0], waitCountToTimeout(waitCount, &timeout), NULL, NULL,
+            &buffers[1]);
+}
+
+const struct timespec *AudioRecord::waitCountToTimeout(int32_t waitCount,
+        struct timespec *timeout)
+{
     if (waitCount == -1) {
-        requested = &ClientProxy::kForever;
+        return &ClientProxy::kForever;
     } else if (waitCount == 0) {
-        requested = &ClientProxy::kNonBlocking;
+        return &ClientProxy::kNonBlocking;
     } else if (waitCount > 0) {
         long long ms = WAIT_PERIOD_MS * (long long) waitCount;
-        struct timespec timeout;
-        timeout.tv_sec = ms / 1000;
-        timeout.tv_nsec = (int) (ms % 1000) * 1000000;
-        requested = &timeout;
-    } else {
-        ALOGE("%s invalid waitCount %d", __func__, waitCount);
-        requested = NULL;
+        timeout->tv_sec = ms / 1000;
+        timeout->tv_nsec = (int) (ms % 1000) * 1000000;
+        return timeout;
     }
-    return obtainBuffer(audioBuffer, requested);
+    ALOGE("%s invalid waitCount %d", __func__, waitCount);
+    return NULL;
 }
 
 status_t AudioRecord::obtainBuffer(Buffer* audioBuffer, const struct timespec *requested,
-        struct timespec *elapsed, size_t *nonContig)
+        struct timespec *elapsed, size_t *nonContig, Buffer* wrapBuffer)
 {
     // previous and new IAudioRecord sequence numbers are used to detect track re-creation
     uint32_t oldSequence = 0;
     uint32_t newSequence;
 
-    Proxy::Buffer buffer;
+    Proxy::Buffer buffers[2];
+    Proxy::Buffer& buffer = buffers[0];
+    buffers[1].mFrameCount = 0;
+    buffers[1].mRaw = NULL;
     status_t status = NO_ERROR;
 
     static const int32_t kMaxTries = 5;
@@ -622,14 +647,25 @@ status_t AudioRecord::obtainBuffer(Buffer* audioBuffer, const struct timespec *r
 
         buffer.mFrameCount = audioBuffer->frameCount;
         // FIXME starts the requested timeout and elapsed over from scratch
-        status = proxy->obtainBuffer(&buffer, requested, elapsed);
+        if (wrapBuffer != NULL) {
+            status = proxy->obtainBuffers(buffers, requested, elapsed);
+        } else {
+            status = proxy->obtainBuffer(&buffer, requested, elapsed);
+        }
 
     } while ((status == DEAD_OBJECT) && (tryCounter-- > 0));
 
     audioBuffer->frameCount = buffer.mFrameCount;
     audioBuffer->size = buffer.mFrameCount * mFrameSize;
     audioBuffer->raw = buffer.mRaw;
-    if (nonContig != NULL) {
+    if (wrapBuffer != NULL) {
+        wrapBuffer->frameCount = buffers[1].mFrameCount;
+        wrapBuffer->size = buffers[1].mFrameCount * mFrameSize;
+        wrapBuffer->raw = buffers[1].mRaw;
+        if (nonContig != NULL) {
+            *nonContig = buffers[1].mFrameCount > 0 ? buffers[1].mNonContig : buffer.mNonContig;
+        }
+    } else if (nonContig != NULL) {
         *nonContig = buffer.mNonContig;
     }
     return status;
@@ -677,12 +713,15 @@ ssize_t AudioRecord::read(void* buffer, size_t userSize)
     }
 
     ssize_t read = 0;
-    Buffer audioBuffer;
+    // the second buffer receives the frames after the end of the record buffer, so that a read
+    // which wraps around costs one obtain and one release instead of two of each
+    Buffer audioBuffer[2];
 
     while (userSize >= mFrameSize) {
-        audioBuffer.frameCount = userSize / mFrameSize;
+        audioBuffer[0].frameCount = userSize / mFrameSize;
 
-        status_t err = obtainBuffer(&audioBuffer, &ClientProxy::kForever);
+        status_t err = obtainBuffer(&audioBuffer[0], &ClientProxy::kForever, NULL, NULL,
+                &audioBuffer[1]);
         if (err < 0) {
             if (read > 0) {
                 break;
@@ -690,13 +729,17 @@ ssize_t AudioRecord::read(void* buffer, size_t userSize)
             return ssize_t(err);
         }
 
-        size_t bytesRead = audioBuffer.size;
-        memcpy(buffer, audioBuffer.i8, bytesRead);
-        buffer = ((char *) buffer) + bytesRead;
-        userSize -= bytesRead;
-        read += bytesRead;
+        for (size_t i = 0; i < 2 && audioBuffer[i].frameCount > 0; i++) {
+            size_t bytesRead = audioBuffer[i].size;
+            memcpy(buffer, audioBuffer[i].i8, bytesRead);
+            buffer = ((char *) buffer) + bytesRead;
+            userSize -= bytesRead;
+            read += bytesRead;
+        }
 
-        releaseBuffer(&audioBuffer);
+        audioBuffer[0].frameCount += audioBuffer[1].frameCount;
+        audioBuffer[0].size += audioBuffer[1].size;
+        releaseBuffer(&audioBuffer[0]);
     }
 
     return read;
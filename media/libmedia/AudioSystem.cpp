@@ -777,6 +777,14 @@ status_t AudioSystem::setLowRamDevice(bool isLowRamDevice)
     return af->setLowRamDevice(isLowRamDevice);
 }
 
+status_t AudioSystem::applyUpdates(const Vector<IAudioFlinger::Update>& updates,
+        Vector<status_t> *statuses)
+{
+    const sp<IAudioFlinger>& af = AudioSystem::get_audio_flinger();
+    if (af == 0) return PERMISSION_DENIED;
+    return af->applyUpdates(updates, statuses);
+}
+
 void AudioSystem::clearAudioConfigCache()
 {
     Mutex::Autolock _l(gLock);
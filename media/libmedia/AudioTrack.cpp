@@ -350,6 +350,7 @@ status_t AudioTrack::set(
     mReqFrameCount = frameCount;
     mNotificationFramesReq = notificationFrames;
     mNotificationFramesAct = 0;
+    mWatermarkFrames = 0;
     mSessionId = sessionId;
     mAuxEffectId = 0;
     mFlags = flags;
@@ -780,6 +781,29 @@ status_t AudioTrack::setPositionUpdatePeriod(uint32_t updatePeriod)
     return NO_ERROR;
 }
 
+status_t AudioTrack::setRefillWatermark(uint32_t watermarkFrames)
+{
+    if (mTransfer != TRANSFER_CALLBACK || isOffloaded()) {
+        return INVALID_OPERATION;
+    }
+
+    AutoMutex lock(mLock);
+    if (watermarkFrames >= mFrameCount) {
+        return BAD_VALUE;
+    }
+    mWatermarkFrames = watermarkFrames;
+    if (watermarkFrames != 0) {
+        mProxy->setWatermark(mFrameCount - watermarkFrames);
+    } else {
+        mProxy->setWatermark(0);
+        mProxy->setMinimum(mNotificationFramesAct);
+    }
+    mRefreshRemaining = true;
+    // make the callback thread re-evaluate the refill size if it is blocked in obtainBuffer()
+    mProxy->interrupt();
+    return NO_ERROR;
+}
+
 status_t AudioTrack::getPositionUpdatePeriod(uint32_t *updatePeriod) const
 {
     if (isOffloaded()) {
@@ -1176,7 +1200,16 @@ status_t AudioTrack::createTrack_l(
     mProxy->setSendLevel(mSendLevel);
     mProxy->setSampleRate(mSampleRate);
     mProxy->setEpoch(epoch);
-    mProxy->setMinimum(mNotificationFramesAct);
+    if (mWatermarkFrames >= mFrameCount) {
+        ALOGW("refill watermark %u too large for re-created track of %u frames, disabled",
+                mWatermarkFrames, mFrameCount);
+        mWatermarkFrames = 0;
+    }
+    if (mWatermarkFrames != 0) {
+        mProxy->setWatermark(mFrameCount - mWatermarkFrames);
+    } else {
+        mProxy->setMinimum(mNotificationFramesAct);
+    }
 
     mDeathNotifier = new DeathNotifier(this);
     mAudioTrack->asBinder()->linkToDeath(mDeathNotifier, this);
@@ -1215,13 +1248,16 @@ status_t AudioTrack::obtainBuffer(Buffer* audioBuffer, int32_t waitCount)
 }
 
 status_t AudioTrack::obtainBuffer(Buffer* audioBuffer, const struct timespec *requested,
-        struct timespec *elapsed, size_t *nonContig)
+        struct timespec *elapsed, size_t *nonContig, Buffer* wrapBuffer)
 {
     // previous and new IAudioTrack sequence numbers are used to detect track re-creation
     uint32_t oldSequence = 0;
     uint32_t newSequence;
 
-    Proxy::Buffer buffer;
+    Proxy::Buffer buffers[2];
+    Proxy::Buffer& buffer = buffers[0];
+    buffers[1].mFrameCount = 0;
+    buffers[1].mRaw = NULL;
     status_t status = NO_ERROR;
 
     static const int32_t kMaxTries = 5;
@@ -1273,14 +1309,25 @@ status_t AudioTrack::obtainBuffer(Buffer* audioBuffer, const struct timespec *re
 
         buffer.mFrameCount = audioBuffer->frameCount;
         // FIXME starts the requested timeout and elapsed over from scratch
-        status = proxy->obtainBuffer(&buffer, requested, elapsed);
+        if (wrapBuffer != NULL) {
+            status = proxy->obtainBuffers(buffers, requested, elapsed);
+        } else {
+            status = proxy->obtainBuffer(&buffer, requested, elapsed);
+        }
 
     } while ((status == DEAD_OBJECT) && (tryCounter-- > 0));
 
     audioBuffer->frameCount = buffer.mFrameCount;
     audioBuffer->size = buffer.mFrameCount * mFrameSizeAF;
     audioBuffer->raw = buffer.mRaw;
-    if (nonContig != NULL) {
+    if (wrapBuffer != NULL) {
+        wrapBuffer->frameCount = buffers[1].mFrameCount;
+        wrapBuffer->size = buffers[1].mFrameCount * mFrameSizeAF;
+        wrapBuffer->raw = buffers[1].mRaw;
+        if (nonContig != NULL) {
+            *nonContig = buffers[1].mFrameCount > 0 ? buffers[1].mNonContig : buffer.mNonContig;
+        }
+    } else if (nonContig != NULL) {
         *nonContig = buffer.mNonContig;
     }
     return status;
@@ -1339,12 +1386,15 @@ ssize_t AudioTrack::write(const void* buffer, size_t userSize)
     }
 
     size_t written = 0;
-    Buffer audioBuffer;
+    // the second buffer receives the frames after the end of the track buffer, so that a write
+    // which wraps around costs one obtain and one release instead of two of each
+    Buffer audioBuffer[2];
 
     while (userSize >= mFrameSize) {
-        audioBuffer.frameCount = userSize / mFrameSize;
+        audioBuffer[0].frameCount = userSize / mFrameSize;
 
-        status_t err = obtainBuffer(&audioBuffer, &ClientProxy::kForever);
+        status_t err = obtainBuffer(&audioBuffer[0], &ClientProxy::kForever, NULL, NULL,
+                &audioBuffer[1]);
         if (err < 0) {
             if (written > 0) {
                 break;
@@ -1352,20 +1402,24 @@ ssize_t AudioTrack::write(const void* buffer, size_t userSize)
             return ssize_t(err);
         }
 
-        size_t toWrite;
-        if (mFormat == AUDIO_FORMAT_PCM_8_BIT && !(mFlags & AUDIO_OUTPUT_FLAG_DIRECT)) {
-            // Divide capacity by 2 to take expansion into account
-            toWrite = audioBuffer.size >> 1;
-            memcpy_to_i16_from_u8(audioBuffer.i16, (const uint8_t *) buffer, toWrite);
-        } else {
-            toWrite = audioBuffer.size;
-            memcpy(audioBuffer.i8, buffer, toWrite);
+        for (size_t i = 0; i < 2 && audioBuffer[i].frameCount > 0; i++) {
+            size_t toWrite;
+            if (mFormat == AUDIO_FORMAT_PCM_8_BIT && !(mFlags & AUDIO_OUTPUT_FLAG_DIRECT)) {
+                // Divide capacity by 2 to take expansion into account
+                toWrite = audioBuffer[i].size >> 1;
+                memcpy_to_i16_from_u8(audioBuffer[i].i16, (const uint8_t *) buffer, toWrite);
+            } else {
+                toWrite = audioBuffer[i].size;
+                memcpy(audioBuffer[i].i8, buffer, toWrite);
+            }
+            buffer = ((const char *) buffer) + toWrite;
+            userSize -= toWrite;
+            written += toWrite;
         }
-        buffer = ((const char *) buffer) + toWrite;
-        userSize -= toWrite;
-        written += toWrite;
 
-        releaseBuffer(&audioBuffer);
+        audioBuffer[0].frameCount += audioBuffer[1].frameCount;
+        audioBuffer[0].size += audioBuffer[1].size;
+        releaseBuffer(&audioBuffer[0]);
     }
 
     return written;
@@ -1533,7 +1587,9 @@ nsecs_t AudioTrack::processAudioBuffer(const sp<AudioTrackThread>& thread)
     // Cache other fields that will be needed soon
     uint32_t loopPeriod = mLoopPeriod;
     uint32_t sampleRate = mSampleRate;
-    size_t notificationFrames = mNotificationFramesAct;
+    // in pull mode, each wakeup refills the buffer from the watermark in a single batch
+    const bool pull = mWatermarkFrames != 0;
+    size_t notificationFrames = pull ? mFrameCount - mWatermarkFrames : mNotificationFramesAct;
     if (mRefreshRemaining) {
         mRefreshRemaining = false;
         mRemainingFrames = notificationFrames;
@@ -1678,7 +1734,8 @@ nsecs_t AudioTrack::processAudioBuffer(const sp<AudioTrackThread>& thread)
             return NS_NEVER;
         }
 
-        if (mRetryOnPartialBuffer && !isOffloaded()) {
+        // not needed in pull mode, as the blocking obtainBuffer() waited for the whole refill
+        if (mRetryOnPartialBuffer && !isOffloaded() && !pull) {
             mRetryOnPartialBuffer = false;
             if (avail < mRemainingFrames) {
                 int64_t myns = ((mRemainingFrames - avail) * 1100000000LL) / sampleRate;
@@ -1851,7 +1908,12 @@ status_t AudioTrack::getTimestamp(AudioTimestamp& timestamp)
     if (mState != STATE_ACTIVE && mState != STATE_PAUSED) {
         return INVALID_OPERATION;
     }
-    status_t status = mAudioTrack->getTimestamp(timestamp);
+    // the timestamp published by the server in shared memory avoids a binder call,
+    // which matters to clients polling at video frame rate
+    status_t status = mProxy->getTimestamp(timestamp);
+    if (status != NO_ERROR) {
+        status = mAudioTrack->getTimestamp(timestamp);
+    }
     if (status == NO_ERROR) {
         timestamp.mPosition += mProxy->getEpoch();
     }
@@ -1883,6 +1945,9 @@ status_t AudioTrack::dump(int fd, const Vector<String16>& args) const
     result.append(buffer);
     snprintf(buffer, 255, "  sample rate(%u), status(%d)\n", mSampleRate, mStatus);
     result.append(buffer);
+    snprintf(buffer, 255, "  notification frames(%u), refill watermark(%u)\n",
+            mNotificationFramesAct, mWatermarkFrames);
+    result.append(buffer);
     uint32_t afLatency = 0;
     AudioSystem::getLatency(mOutput, mStreamType, &afLatency);
     snprintf(buffer, 255, "  state(%d), latency (%d)\n", mState, afLatency + (1000*mCblk->frameCount_) / mSampleRate);
@@ -17,6 +17,7 @@
 #define LOG_TAG "AudioTrackShared"
 //#define LOG_NDEBUG 0
 
+#include <sched.h>
 #include <private/media/AudioTrackShared.h>
 #include <utils/Log.h>
 extern "C" {
@@ -30,6 +31,7 @@ audio_track_cblk_t::audio_track_cblk_t()
     mVolumeLR(0x10001000), mSampleRate(0), mSendLevel(0), mFlags(0)
 {
     memset(&u, 0, sizeof(u));
+    memset(&mTimestamp, 0, sizeof(mTimestamp));
 }
 
 // ---------------------------------------------------------------------------
@@ -46,7 +48,8 @@ Proxy::Proxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount, size_t
 
 ClientProxy::ClientProxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount,
         size_t frameSize, bool isOut, bool clientInServer)
-    : Proxy(cblk, buffers, frameCount, frameSize, isOut, clientInServer), mEpoch(0)
+    : Proxy(cblk, buffers, frameCount, frameSize, isOut, clientInServer), mEpoch(0),
+      mWatermark(0)
 {
 }
 
@@ -141,7 +144,8 @@ status_t ClientProxy::obtainBuffer(Buffer* buffer, const struct timespec *reques
         }
         // don't allow filling pipe beyond the nominal size
         size_t avail = mIsOut ? mFrameCount - filled : filled;
-        if (avail > 0) {
+        // in watermark mode a blocking call waits until the whole refill is available
+        if (avail > 0 && (avail >= mWatermark || timeout == TIMEOUT_ZERO)) {
             // 'avail' may be non-contiguous, so return only the first contiguous chunk
             size_t part1;
             if (mIsOut) {
@@ -266,6 +270,40 @@ end:
     return status;
 }
 
+status_t ClientProxy::obtainBuffers(Buffer buffers[2], const struct timespec *requested,
+        struct timespec *elapsed)
+{
+    size_t desired = buffers[0].mFrameCount;
+    status_t status = obtainBuffer(&buffers[0], requested, elapsed);
+    size_t part2 = 0;
+    size_t nonContig = 0;
+    if (status == NO_ERROR) {
+        // the non-contiguous frames always continue at the start of the buffer
+        nonContig = buffers[0].mNonContig;
+        part2 = desired - buffers[0].mFrameCount;
+        if (part2 > nonContig) {
+            part2 = nonContig;
+        }
+        mUnreleased += part2;
+    }
+    buffers[1].mFrameCount = part2;
+    buffers[1].mRaw = part2 > 0 ? mBuffers : NULL;
+    buffers[1].mNonContig = nonContig - part2;
+    return status;
+}
+
+void ClientProxy::setWatermark(size_t refill)
+{
+    LOG_ALWAYS_FATAL_IF(!mIsOut || refill > mFrameCount);
+    mWatermark = refill;
+    if (refill > 0) {
+        mCblk->mMinimum = refill;
+        android_atomic_or(CBLK_WATERMARK, &mCblk->mFlags);
+    } else {
+        android_atomic_and(~CBLK_WATERMARK, &mCblk->mFlags);
+    }
+}
+
 void ClientProxy::releaseBuffer(Buffer* buffer)
 {
     LOG_ALWAYS_FATAL_IF(buffer == NULL);
@@ -352,6 +390,37 @@ bool AudioTrackClientProxy::getStreamEndDone() const {
     return (mCblk->mFlags & CBLK_STREAM_END_DONE) != 0;
 }
 
+status_t AudioTrackClientProxy::getTimestamp(AudioTimestamp& timestamp) const
+{
+    const AudioTrackSharedTimestamp *shared = &mCblk->mTimestamp;
+    // the server's update is only a few stores, so a reader rarely has to retry;
+    // bound the retries in case the server was preempted in the middle of one
+    for (int tries = 0; tries < 3; tries++) {
+        int32_t sequence = android_atomic_acquire_load(&shared->mSequence);
+        if (sequence == 0) {
+            return WOULD_BLOCK;
+        }
+        if (sequence & 1) {
+            sched_yield();
+            continue;
+        }
+        uint32_t position = shared->mPosition;
+        struct timespec time = shared->mTime;
+        // the loads above must complete before mSequence is re-read
+        android_memory_barrier();
+        if (shared->mSequence == sequence) {
+            if (time.tv_sec == 0 && time.tv_nsec == 0) {
+                // withdrawn by the server
+                return WOULD_BLOCK;
+            }
+            timestamp.mPosition = position;
+            timestamp.mTime = time;
+            return NO_ERROR;
+        }
+    }
+    return WOULD_BLOCK;
+}
+
 status_t AudioTrackClientProxy::waitStreamEndDone(const struct timespec *requested)
 {
     struct timespec total;          // total elapsed time spent waiting
@@ -625,6 +694,11 @@ void ServerProxy::releaseBuffer(Buffer* buffer)
     size_t minimum = cblk->mMinimum;
     if (minimum == 0) {
         minimum = mIsOut ? half : 1;
+    } else if (cblk->mFlags & CBLK_WATERMARK) {
+        // client wants a single wakeup per refill, possibly of more than half the buffer
+        if (minimum > mFrameCount) {
+            minimum = mFrameCount;
+        }
     } else if (minimum > half) {
         minimum = half;
     }
@@ -691,6 +765,34 @@ void AudioTrackServerProxy::tallyUnderrunFrames(uint32_t frameCount)
     (void) android_atomic_or(CBLK_UNDERRUN, &mCblk->mFlags);
 }
 
+void AudioTrackServerProxy::setTimestamp(const AudioTimestamp& timestamp)
+{
+    writeTimestamp(mCblk->mTimestamp.mSequence, timestamp);
+}
+
+void AudioTrackServerProxy::clearTimestamp()
+{
+    AudioTrackSharedTimestamp *shared = &mCblk->mTimestamp;
+    if (shared->mSequence != 0) {
+        // a zero time means withdrawn; mSequence keeps counting so that a reader can't be fooled
+        AudioTimestamp none;
+        writeTimestamp(shared->mSequence, none);
+    }
+}
+
+void AudioTrackServerProxy::writeTimestamp(int32_t sequence, const AudioTimestamp& timestamp)
+{
+    AudioTrackSharedTimestamp *shared = &mCblk->mTimestamp;
+    // odd while the fields are inconsistent
+    android_atomic_release_store(sequence + 1, &shared->mSequence);
+    android_memory_barrier();
+    shared->mPosition = timestamp.mPosition;
+    shared->mTime = timestamp.mTime;
+    // skip 0 on wraparound, it means that no timestamp has ever been published
+    int32_t next = sequence + 2;
+    android_atomic_release_store(next != 0 ? next : 2, &shared->mSequence);
+}
+
 // ---------------------------------------------------------------------------
 
 StaticAudioTrackServerProxy::StaticAudioTrackServerProxy(audio_track_cblk_t* cblk, void *buffers,
@@ -76,6 +76,7 @@ enum {
     GET_PRIMARY_OUTPUT_FRAME_COUNT,
     SET_LOW_RAM_DEVICE,
     CREATE_DIRECT_TRACK,
+    APPLY_UPDATES,
 };
 
 class BpAudioFlinger : public BpInterface<IAudioFlinger>
@@ -779,6 +780,47 @@ public:
         return reply.readInt32();
     }
 
+    virtual status_t applyUpdates(const Vector<Update>& updates, Vector<status_t> *statuses)
+    {
+        if (updates.size() > kMaxUpdates) {
+            return BAD_VALUE;
+        }
+        Parcel data, reply;
+        data.writeInterfaceToken(IAudioFlinger::getInterfaceDescriptor());
+        data.writeInt32(updates.size());
+        for (size_t i = 0; i < updates.size(); i++) {
+            const Update& update = updates[i];
+            data.writeInt32((int32_t) update.mType);
+            switch (update.mType) {
+            case Update::STREAM_VOLUME:
+                data.writeInt32((int32_t) update.mStream);
+                data.writeFloat(update.mValue);
+                data.writeInt32((int32_t) update.mIoHandle);
+                break;
+            case Update::PARAMETERS:
+                data.writeInt32((int32_t) update.mIoHandle);
+                data.writeString8(update.mKeyValuePairs);
+                break;
+            case Update::VOICE_VOLUME:
+                data.writeFloat(update.mValue);
+                break;
+            }
+        }
+        status_t lStatus = remote()->transact(APPLY_UPDATES, data, &reply);
+        if (lStatus != NO_ERROR) {
+            return lStatus;
+        }
+        status_t status = reply.readInt32();
+        size_t count = reply.readInt32();
+        if (statuses != NULL) {
+            statuses->clear();
+            for (size_t i = 0; i < count && i < updates.size(); i++) {
+                statuses->add((status_t) reply.readInt32());
+            }
+        }
+        return status;
+    }
+
 };
 
 IMPLEMENT_META_INTERFACE(AudioFlinger, "android.media.IAudioFlinger");
@@ -1186,6 +1228,49 @@ status_t BnAudioFlinger::onTransact(
             reply->writeInt32(setLowRamDevice(isLowRamDevice));
             return NO_ERROR;
         } break;
+        case APPLY_UPDATES: {
+            CHECK_INTERFACE(IAudioFlinger, data, reply);
+            size_t count = data.readInt32();
+            if (count > kMaxUpdates) {
+                reply->writeInt32(BAD_VALUE);
+                reply->writeInt32(0);
+                return NO_ERROR;
+            }
+            Vector<Update> updates;
+            for (size_t i = 0; i < count; i++) {
+                Update update;
+                update.mType = (Update::Type) data.readInt32();
+                update.mStream = AUDIO_STREAM_DEFAULT;
+                update.mValue = 0.0f;
+                update.mIoHandle = 0;
+                switch (update.mType) {
+                case Update::STREAM_VOLUME:
+                    update.mStream = (audio_stream_type_t) data.readInt32();
+                    update.mValue = data.readFloat();
+                    update.mIoHandle = (audio_io_handle_t) data.readInt32();
+                    break;
+                case Update::PARAMETERS:
+                    update.mIoHandle = (audio_io_handle_t) data.readInt32();
+                    update.mKeyValuePairs = data.readString8();
+                    break;
+                case Update::VOICE_VOLUME:
+                    update.mValue = data.readFloat();
+                    break;
+                default:
+                    reply->writeInt32(BAD_VALUE);
+                    reply->writeInt32(0);
+                    return NO_ERROR;
+                }
+                updates.add(update);
+            }
+            Vector<status_t> statuses;
+            reply->writeInt32(applyUpdates(updates, &statuses));
+            reply->writeInt32(statuses.size());
+            for (size_t i = 0; i < statuses.size(); i++) {
+                reply->writeInt32(statuses[i]);
+            }
+            return NO_ERROR;
+        } break;
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
@@ -235,10 +235,24 @@ status_t BnCrypto::onTransact(
             data.read(iv, sizeof(iv));
 
             size_t totalSize = data.readInt32();
+            if (totalSize > data.dataAvail()) {
+                reply->writeInt32(BAD_VALUE);
+                return OK;
+            }
             void *srcData = malloc(totalSize);
+            if (srcData == NULL) {
+                reply->writeInt32(NO_MEMORY);
+                return OK;
+            }
             data.read(srcData, totalSize);
 
             int32_t numSubSamples = data.readInt32();
+            if (numSubSamples < 0 || (size_t)numSubSamples
+                    > data.dataAvail() / sizeof(CryptoPlugin::SubSample)) {
+                free(srcData);
+                reply->writeInt32(BAD_VALUE);
+                return OK;
+            }
 
             CryptoPlugin::SubSample *subSamples =
                 new CryptoPlugin::SubSample[numSubSamples];
@@ -247,6 +261,31 @@ status_t BnCrypto::onTransact(
                     subSamples,
                     sizeof(CryptoPlugin::SubSample) * numSubSamples);
 
+            // the plugin writes every subsample to dstPtr, which only
+            // holds totalSize bytes
+            size_t sumSubSampleSizes = 0;
+            bool overflow = false;
+            for (int32_t i = 0; i < numSubSamples; ++i) {
+                size_t clear = subSamples[i].mNumBytesOfClearData;
+                size_t encrypted = subSamples[i].mNumBytesOfEncryptedData;
+                if (clear > totalSize - sumSubSampleSizes) {
+                    overflow = true;
+                    break;
+                }
+                sumSubSampleSizes += clear;
+                if (encrypted > totalSize - sumSubSampleSizes) {
+                    overflow = true;
+                    break;
+                }
+                sumSubSampleSizes += encrypted;
+            }
+            if (overflow || sumSubSampleSizes != totalSize) {
+                delete[] subSamples;
+                free(srcData);
+                reply->writeInt32(BAD_VALUE);
+                return OK;
+            }
+
             void *dstPtr;
             if (secure) {
                 dstPtr = (void *)data.readIntPtr();
@@ -49,6 +49,7 @@ enum {
     PULL_BATTERY_DATA,
     LISTEN_FOR_REMOTE_DISPLAY,
     UPDATE_PROXY_CONFIG,
+    DECODE_FD_SHARED,
 };
 
 class BpMediaPlayerService: public BpInterface<IMediaPlayerService>
@@ -130,6 +131,28 @@ public:
         return status;
     }
 
+    virtual sp<IMemory> decodeShared(int fd, int64_t offset, int64_t length,
+                               uint32_t *pSampleRate, int* pNumChannels, audio_format_t* pFormat)
+    {
+        Parcel data, reply;
+        data.writeInterfaceToken(IMediaPlayerService::getInterfaceDescriptor());
+        data.writeFileDescriptor(fd);
+        data.writeInt64(offset);
+        data.writeInt64(length);
+        sp<IMemory> memory;
+        status_t status = remote()->transact(DECODE_FD_SHARED, data, &reply);
+        if (status == NO_ERROR) {
+            status = (status_t)reply.readInt32();
+            if (status == NO_ERROR) {
+                *pSampleRate = uint32_t(reply.readInt32());
+                *pNumChannels = reply.readInt32();
+                *pFormat = (audio_format_t)reply.readInt32();
+                memory = interface_cast<IMemory>(reply.readStrongBinder());
+            }
+        }
+        return memory;
+    }
+
     virtual sp<IOMX> getOMX() {
         Parcel data, reply;
         data.writeInterfaceToken(IMediaPlayerService::getInterfaceDescriptor());
@@ -259,6 +282,25 @@ status_t BnMediaPlayerService::onTransact(
             }
             return NO_ERROR;
         } break;
+        case DECODE_FD_SHARED: {
+            CHECK_INTERFACE(IMediaPlayerService, data, reply);
+            int fd = dup(data.readFileDescriptor());
+            int64_t offset = data.readInt64();
+            int64_t length = data.readInt64();
+            uint32_t sampleRate;
+            int numChannels;
+            audio_format_t format;
+            sp<IMemory> memory = decodeShared(fd, offset, length, &sampleRate, &numChannels,
+                                              &format);
+            reply->writeInt32(memory != 0 ? NO_ERROR : UNKNOWN_ERROR);
+            if (memory != 0) {
+                reply->writeInt32(sampleRate);
+                reply->writeInt32(numChannels);
+                reply->writeInt32((int32_t)format);
+                reply->writeStrongBinder(memory->asBinder());
+            }
+            return NO_ERROR;
+        } break;
         case CREATE_MEDIA_RECORDER: {
             CHECK_INTERFACE(IMediaPlayerService, data, reply);
             sp<IMediaRecorder> recorder = createMediaRecorder();
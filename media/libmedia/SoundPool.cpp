@@ -57,6 +57,9 @@ SoundPool::SoundPool(int maxChannels, audio_stream_type_t streamType, int srcQua
     mAllocated = 0;
     mNextSampleID = 0;
     mNextChannelID = 0;
+    mMemoryBudget = 0;
+    mUseCount = 0;
+    mReloading = 0;
 
     mCallback = 0;
     mUserData = 0;
@@ -79,6 +82,11 @@ SoundPool::~SoundPool()
 
     Mutex::Autolock lock(&mLock);
 
+    // play() may be decoding an evicted sample with mLock released
+    while (mReloading > 0) {
+        mReloadCondition.wait(mLock);
+    }
+
     mChannels.clear();
     if (mChannelPool)
         delete [] mChannelPool;
@@ -203,6 +211,7 @@ int SoundPool::load(const char* path, int priority)
 {
     ALOGV("load: path=%s, priority=%d", path, priority);
     Mutex::Autolock lock(&mLock);
+    evict_l(NULL);
     sp<Sample> sample = new Sample(++mNextSampleID, path);
     mSamples.add(sample->sampleID(), sample);
     doLoad(sample);
@@ -214,7 +223,9 @@ int SoundPool::load(int fd, int64_t offset, int64_t length, int priority)
     ALOGV("load: fd=%d, offset=%lld, length=%lld, priority=%d",
             fd, offset, length, priority);
     Mutex::Autolock lock(&mLock);
+    evict_l(NULL);
     sp<Sample> sample = new Sample(++mNextSampleID, fd, offset, length);
+    sample->setKeepCompressed(mMemoryBudget > 0);
     mSamples.add(sample->sampleID(), sample);
     doLoad(sample);
     return sample->sampleID();
@@ -223,6 +234,7 @@ int SoundPool::load(int fd, int64_t offset, int64_t length, int priority)
 void SoundPool::doLoad(sp<Sample>& sample)
 {
     ALOGV("doLoad: loading sample sampleID=%d", sample->sampleID());
+    sample->setLastUsed(++mUseCount);
     sample->startLoad();
     mDecodeThread->loadSample(sample->sampleID());
 }
@@ -248,13 +260,36 @@ int SoundPool::play(int sampleID, float leftVolume, float rightVolume,
     if (mQuit) {
         return 0;
     }
-    // is sample ready?
+    // decode evicted samples again on this thread, without blocking the other calls;
+    // the destructor waits for mReloading to drop to 0 before tearing down
     sample = findSample(sampleID);
+    if ((sample != 0) && (sample->state() == Sample::EVICTED)) {
+        ALOGV("  reloading evicted sample %d", sampleID);
+        sample->startLoad();
+        mReloading++;
+        mLock.unlock();
+        status_t status = sample->doLoad();
+        mLock.lock();
+        if (--mReloading == 0) {
+            mReloadCondition.broadcast();
+        }
+        if (status != NO_ERROR) {
+            sample->evict();
+        }
+        if (mQuit) {
+            return 0;
+        }
+    }
+
+    // is sample ready?
     if ((sample == 0) || (sample->state() != Sample::READY)) {
         ALOGW("  sample %d not READY", sampleID);
         return 0;
     }
 
+    sample->setLastUsed(++mUseCount);
+    evict_l(sample);
+
     dump();
 
     // allocate a channel
@@ -301,6 +336,61 @@ SoundChannel* SoundPool::allocateChannel_l(int priority)
     return channel;
 }
 
+void SoundPool::setMemoryBudget(size_t bytes)
+{
+    ALOGV("setMemoryBudget(%u)", bytes);
+    Mutex::Autolock lock(&mLock);
+    mMemoryBudget = bytes;
+    evict_l(NULL);
+}
+
+bool SoundPool::isPlaying_l(const sp<Sample>& sample)
+{
+    for (int i = 0; i < mMaxChannels; ++i) {
+        if ((mChannelPool[i].sample() == sample) || (mChannelPool[i].nextSample() == sample)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// evict the least recently used samples until the decoded ones fit the budget,
+// call with lock held
+void SoundPool::evict_l(const sp<Sample>& keep)
+{
+    if (mMemoryBudget == 0) {
+        return;
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < mSamples.size(); ++i) {
+        sp<Sample> sample = mSamples.valueAt(i);
+        if (sample->state() == Sample::READY) {
+            total += sample->size();
+        }
+    }
+
+    while (total > mMemoryBudget) {
+        sp<Sample> victim;
+        for (size_t i = 0; i < mSamples.size(); ++i) {
+            sp<Sample> sample = mSamples.valueAt(i);
+            if ((sample == keep) || (sample->state() != Sample::READY) ||
+                    !sample->canReload() || isPlaying_l(sample)) {
+                continue;
+            }
+            if ((victim == 0) || (sample->lastUsed() < victim->lastUsed())) {
+                victim = sample;
+            }
+        }
+        if (victim == 0) {
+            ALOGV("evict_l: %u bytes decoded, nothing left to evict", total);
+            break;
+        }
+        total -= victim->size();
+        victim->evict();
+    }
+}
+
 // move a channel from its current position to the front of the list
 void SoundPool::moveToFront_l(SoundChannel* channel)
 {
@@ -474,6 +564,8 @@ void Sample::init()
     mOffset = 0;
     mLength = 0;
     mUrl = 0;
+    mKeepCompressed = false;
+    mLastUsed = 0;
 }
 
 Sample::~Sample()
@@ -492,6 +584,31 @@ status_t Sample::doLoad()
     int numChannels;
     audio_format_t format;
     status_t status;
+
+    if (mKeepCompressed && (mCompressed == 0) && (mFd >= 0)) {
+        // not fatal, the sample just can't be evicted
+        copyCompressed();
+    }
+
+    // Prefer the media server's shared copy, so that a sample loaded by several clients,
+    // or several times, is decoded once and held in memory once
+    if (!mUrl) {
+        sp<IMemory> data = MediaPlayer::decodeShared(mFd, mOffset, mLength, &sampleRate,
+                &numChannels, &format);
+        if (data != 0 && sampleRate <= kMaxSampleRate && numChannels >= 1 && numChannels <= 2) {
+            ALOGV("shared sample pointer = %p, size = %u, sampleRate = %u, numChannels = %d",
+                    data->pointer(), data->size(), sampleRate, numChannels);
+            closeSource();
+            mData = data;
+            mSize = data->size();
+            mSampleRate = sampleRate;
+            mNumChannels = numChannels;
+            mFormat = format;
+            mState = READY;
+            return NO_ERROR;
+        }
+    }
+
     mHeap = new MemoryHeapBase(kDefaultHeapSize);
 
     ALOGV("Start decode");
@@ -500,9 +617,7 @@ status_t Sample::doLoad()
     } else {
         status = MediaPlayer::decode(mFd, mOffset, mLength, &sampleRate, &numChannels, &format,
                                      mHeap, &mSize);
-        ALOGV("close(%d)", mFd);
-        ::close(mFd);
-        mFd = -1;
+        closeSource();
     }
     if (status != NO_ERROR) {
         ALOGE("Unable to load sample: %s", mUrl);
@@ -535,6 +650,56 @@ error:
     return status;
 }
 
+// copy the compressed sample into ashmem, and decode from there from now on
+status_t Sample::copyCompressed()
+{
+    if (mLength <= 0) {
+        return BAD_VALUE;
+    }
+
+    sp<MemoryHeapBase> heap = new MemoryHeapBase(mLength, 0, "SoundPool compressed");
+    if (heap->getHeapID() < 0) {
+        ALOGW("Unable to allocate %lld bytes for compressed sample %d", mLength, mSampleID);
+        return NO_MEMORY;
+    }
+
+    if (pread64(mFd, heap->getBase(), mLength, mOffset) != mLength) {
+        ALOGW("Unable to read compressed sample %d", mSampleID);
+        return UNKNOWN_ERROR;
+    }
+
+    int fd = dup(heap->getHeapID());
+    if (fd < 0) {
+        return UNKNOWN_ERROR;
+    }
+
+    ALOGV("close(%d)", mFd);
+    ::close(mFd);
+    mFd = fd;
+    mOffset = 0;
+    mCompressed = heap;
+    return NO_ERROR;
+}
+
+// the source is closed after decoding, unless it is needed to decode again
+void Sample::closeSource()
+{
+    if (mCompressed != 0) {
+        return;
+    }
+    ALOGV("close(%d)", mFd);
+    ::close(mFd);
+    mFd = -1;
+}
+
+void Sample::evict()
+{
+    ALOGV("evict sampleID=%d, size=%u", mSampleID, mSize);
+    mData.clear();
+    mHeap.clear();
+    mState = EVICTED;
+}
+
 
 void SoundChannel::init(SoundPool* soundPool)
 {
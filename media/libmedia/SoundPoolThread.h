@@ -48,6 +48,7 @@ public:
 
 private:
     static const size_t maxMessages = 5;
+    static const long maxThreads = 4;
 
     static int beginThread(void* arg);
     int run();
@@ -59,6 +60,7 @@ private:
     Vector<SoundPoolMsg>    mMsgQueue;
     SoundPool*              mSoundPool;
     bool                    mRunning;
+    int                     mNumThreads;
 };
 
 } // end namespace android
@@ -20,11 +20,15 @@
 #include <math.h>
 #include <utils/Log.h>
 #include <cutils/properties.h>
+#include <binder/MemoryDealer.h>
 #include "media/ToneGenerator.h"
 
 
 namespace android {
 
+Mutex ToneGenerator::sStaticLock;
+Vector< sp<ToneGenerator::StaticTone> > ToneGenerator::sStaticTones;
+
 
 // Descriptors for all available tones (See ToneGenerator::ToneDescriptor class declaration for details)
 const ToneGenerator::ToneDescriptor ToneGenerator::sToneDescriptors[] = {
@@ -799,6 +803,7 @@ ToneGenerator::ToneGenerator(audio_stream_type_t streamType, float volume, bool
     ALOGV("ToneGenerator constructor: streamType=%d, volume=%f", streamType, volume);
 
     mState = TONE_IDLE;
+    mStaticMode = false;
 
     if (AudioSystem::getOutputSamplingRate(&mSamplingRate, streamType) != NO_ERROR) {
         ALOGE("Unable to marshal AudioFlinger");
@@ -812,6 +817,10 @@ ToneGenerator::ToneGenerator(audio_stream_type_t streamType, float volume, bool
     // Generate tone by chunks of 20 ms to keep cadencing precision
     mProcessSize = (mSamplingRate * 20) / 1000;
 
+    char staticMode[PROPERTY_VALUE_MAX];
+    property_get("media.tonegen.static", staticMode, "0");
+    mStaticMode = atoi(staticMode) != 0;
+
     char value[PROPERTY_VALUE_MAX];
     property_get("gsm.operator.iso-country", value, "");
     if (strcmp(value,"us") == 0 ||
@@ -823,7 +832,10 @@ ToneGenerator::ToneGenerator(audio_stream_type_t streamType, float volume, bool
         mRegion = CEPT;
     }
 
-    if (initAudioTrack()) {
+    if (mStaticMode) {
+        // the AudioTrack and its callback thread are only needed for streamed tones
+        ALOGV("ToneGenerator INIT OK in static mode");
+    } else if (initAudioTrack()) {
         ALOGV("ToneGenerator INIT OK, time: %d", (unsigned int)(systemTime()/1000000));
     } else {
         ALOGV("!!!ToneGenerator INIT FAILED!!!");
@@ -850,6 +862,7 @@ ToneGenerator::ToneGenerator(audio_stream_type_t streamType, float volume, bool
 ToneGenerator::~ToneGenerator() {
     ALOGV("ToneGenerator destructor");
 
+    stopStaticTone();
     if (mpAudioTrack != 0) {
         stopTone();
         ALOGV("Delete Track: %p", mpAudioTrack.get());
@@ -885,6 +898,25 @@ bool ToneGenerator::startTone(tone_type toneType, int durationMs) {
         return true;
     }
 
+    stopStaticTone();
+    if (mStaticMode) {
+        sp<StaticTone> staticTone = getStaticTone(toneType, durationMs);
+        if (staticTone != 0) {
+            // stop any streamed tone before playing the static one
+            stopTone();
+            sp<AudioTrack>& track = staticTone->mTrack;
+            track->stop();
+            track->reload();
+            track->setVolume(mVolume);
+            if (track->start() == NO_ERROR) {
+                mpStaticTone = staticTone;
+                ALOGV("Static tone started, time %d", (unsigned int)(systemTime()/1000000));
+                return true;
+            }
+            ALOGW("Static tone start failed, streaming it instead");
+        }
+    }
+
     if (mState == TONE_IDLE) {
         ALOGV("startTone: try to re-init AudioTrack");
         if (!initAudioTrack()) {
@@ -974,6 +1006,7 @@ bool ToneGenerator::startTone(tone_type toneType, int durationMs) {
 void ToneGenerator::stopTone() {
     ALOGV("stopTone");
 
+    stopStaticTone();
     mLock.lock();
     if (mState != TONE_IDLE && mState != TONE_INIT) {
         if (mState == TONE_PLAYING || mState == TONE_STARTING || mState == TONE_RESTARTING) {
@@ -1024,6 +1057,206 @@ void ToneGenerator::stopTone() {
 
 //---------------------------------- private methods ---------------------------
 
+////////////////////////////////////////////////////////////////////////////////
+//
+//    Method:        ToneGenerator::getStaticTone()
+//
+//    Description:    Returns the cached static tone for the given tone and duration,
+//      rendering it and creating its static AudioTrack if needed.
+//
+//    Input:
+//        toneType:        Type of tone, already mapped to the current region
+//        durationMs:      The maximum tone duration in milliseconds, or -1
+//
+//    Output:
+//        returned value:   the static tone, or 0 if the tone is too long or can't be
+//          played from a static buffer
+//
+////////////////////////////////////////////////////////////////////////////////
+sp<ToneGenerator::StaticTone> ToneGenerator::getStaticTone(tone_type toneType, int durationMs) {
+    const ToneDescriptor *toneDesc = &sToneDescriptors[toneType];
+    bool limited = durationMs >= 0 && (unsigned int)durationMs <= TONEGEN_MAX_STATIC_MS;
+    unsigned int maxSmp = ((limited ? durationMs : TONEGEN_MAX_STATIC_MS) * mSamplingRate) / 1000;
+
+    Mutex::Autolock _l(sStaticLock);
+    for (size_t i = 0; i < sStaticTones.size(); i++) {
+        sp<StaticTone> tone = sStaticTones[i];
+        if (tone->mStreamType == mStreamType && tone->mToneType == toneType &&
+                tone->mDurationMs == durationMs && tone->mSamplingRate == mSamplingRate) {
+            // move to the most recently used end
+            sStaticTones.removeAt(i);
+            sStaticTones.add(tone);
+            return tone;
+        }
+    }
+
+    // first pass only measures the length
+    bool complete;
+    size_t frameCount = renderTone(toneDesc, mSamplingRate, maxSmp, NULL, &complete);
+    if (frameCount == 0 || !(complete || limited)) {
+        return 0;
+    }
+
+    sp<StaticTone> tone = new StaticTone(mStreamType, toneType, durationMs, mSamplingRate);
+    size_t size = frameCount * sizeof(short);
+    sp<MemoryDealer> memoryDealer = new MemoryDealer(size, "ToneGenerator");
+    tone->mBuffer = memoryDealer->allocate(size);
+    if (tone->mBuffer == 0 || tone->mBuffer->pointer() == NULL) {
+        ALOGE("Unable to allocate %u bytes for static tone %d", size, toneType);
+        return 0;
+    }
+    short *pcm = (short *)tone->mBuffer->pointer();
+    memset(pcm, 0, size);
+    renderTone(toneDesc, mSamplingRate, maxSmp, pcm, &complete);
+
+    tone->mTrack = new AudioTrack();
+    tone->mTrack->set(mStreamType,
+                      mSamplingRate,
+                      AUDIO_FORMAT_PCM_16_BIT,
+                      AUDIO_CHANNEL_OUT_MONO,
+                      0,    // frameCount
+                      AUDIO_OUTPUT_FLAG_NONE,   // don't hold a fast track slot while cached
+                      NULL, // callback
+                      NULL, // user
+                      0,    // notificationFrames
+                      tone->mBuffer,
+                      false,    // threadCanCallJava
+                      0,    // sessionId
+                      AudioTrack::TRANSFER_SHARED);
+    if (tone->mTrack->initCheck() != NO_ERROR) {
+        ALOGE("Static tone AudioTrack->initCheck failed");
+        return 0;
+    }
+
+    if (sStaticTones.size() >= TONEGEN_MAX_STATIC_TONES) {
+        // evict the least recently used; it stays alive while an instance is still playing it
+        sStaticTones.removeAt(0);
+    }
+    sStaticTones.add(tone);
+    ALOGV("Rendered static tone %d, %u frames", toneType, frameCount);
+    return tone;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//    Method:        ToneGenerator::stopStaticTone()
+//
+//    Description:    Stops the static tone started by this instance, if any.
+//
+//    Input:
+//        none
+//
+//    Output:
+//        none
+//
+////////////////////////////////////////////////////////////////////////////////
+void ToneGenerator::stopStaticTone() {
+    if (mpStaticTone != 0) {
+        mpStaticTone->mTrack->stop();
+        mpStaticTone.clear();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//    Method:        ToneGenerator::renderTone()
+//
+//    Description:    Renders a complete tone sequence offline, following the same segment,
+//      loop and repeat rules as audioCallback(). Each ON segment starts from phase 0 and
+//      ramps down over its last block, as audioCallback() does on an ON -> OFF transition.
+//
+//    Input:
+//        toneDesc:        tone descriptor
+//        samplingRate:    output sampling rate
+//        maxSmp:          maximum number of samples to render
+//        out:             zeroed buffer of at least maxSmp samples, or NULL to only measure
+//
+//    Output:
+//        complete:         true if the sequence ended within maxSmp samples
+//        returned value:   number of samples rendered
+//
+////////////////////////////////////////////////////////////////////////////////
+size_t ToneGenerator::renderTone(const ToneDescriptor *toneDesc, uint32_t samplingRate,
+        unsigned int maxSmp, short *out, bool *complete) {
+    KeyedVector<unsigned short, WaveGenerator *> waveGens;
+    unsigned int processSize = (samplingRate * 20) / 1000;
+    if (out != NULL) {
+        // same gains as prepareWave()
+        for (unsigned int segmentIdx = 0; toneDesc->segments[segmentIdx].duration;
+                segmentIdx++) {
+            const ToneSegment& segment = toneDesc->segments[segmentIdx];
+            unsigned int lNumWaves = 1;
+            while (segment.waveFreq[lNumWaves - 1]) {
+                lNumWaves++;
+            }
+            for (unsigned int freqIdx = 0; segment.waveFreq[freqIdx]; freqIdx++) {
+                unsigned short frequency = segment.waveFreq[freqIdx];
+                if (waveGens.indexOfKey(frequency) == NAME_NOT_FOUND) {
+                    waveGens.add(frequency, new WaveGenerator((unsigned short)samplingRate,
+                            frequency, TONEGEN_GAIN/lNumWaves));
+                }
+            }
+        }
+    }
+
+    size_t total = 0;
+    unsigned int curSegment = 0;
+    unsigned long curCount = 0;
+    unsigned short loopCounter = 0;
+    *complete = false;
+    for (;;) {
+        const ToneSegment& segment = toneDesc->segments[curSegment];
+        if (segment.duration == 0) {
+            *complete = true;
+            break;
+        }
+        unsigned int count = maxSmp - total;
+        if (segment.duration != TONEGEN_INF &&
+                (segment.duration * samplingRate) / 1000 < count) {
+            count = (segment.duration * samplingRate) / 1000;
+        }
+        if (out != NULL && segment.waveFreq[0] != 0 && count > 0) {
+            unsigned int ramp = count / 2 < processSize ? count / 2 : processSize;
+            for (unsigned int freqIdx = 0; segment.waveFreq[freqIdx]; freqIdx++) {
+                WaveGenerator *lpWaveGen = waveGens.valueFor(segment.waveFreq[freqIdx]);
+                lpWaveGen->getSamples(&out[total], count - ramp, WaveGenerator::WAVEGEN_START);
+                lpWaveGen->getSamples(&out[total + count - ramp], ramp,
+                        WaveGenerator::WAVEGEN_STOP);
+            }
+        }
+        total += count;
+        if (total >= maxSmp) {
+            break;
+        }
+
+        // same sequencing as audioCallback()
+        if (segment.loopCnt) {
+            if (loopCounter < segment.loopCnt) {
+                curSegment = segment.loopIndx;
+                ++loopCounter;
+            } else {
+                loopCounter = 0;
+                curSegment++;
+            }
+        } else {
+            curSegment++;
+        }
+        if (toneDesc->segments[curSegment].duration == 0) {
+            if (++curCount <= toneDesc->repeatCnt) {
+                curSegment = toneDesc->repeatSegment;
+            } else {
+                *complete = true;
+                break;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < waveGens.size(); i++) {
+        delete waveGens.valueAt(i);
+    }
+    return total;
+}
+
 
 
 
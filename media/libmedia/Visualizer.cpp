@@ -27,6 +27,7 @@
 #include <cutils/bitops.h>
 
 #include <media/Visualizer.h>
+#include <media/EffectVisualizerApi.h>
 #include <audio_utils/fixedfft.h>
 #include <utils/Thread.h>
 
@@ -45,7 +46,8 @@ Visualizer::Visualizer (int32_t priority,
         mScalingMode(VISUALIZER_SCALING_MODE_NORMALIZED),
         mMeasurementMode(MEASUREMENT_MODE_NONE),
         mCaptureCallBack(NULL),
-        mCaptureCbkUser(NULL)
+        mCaptureCbkUser(NULL),
+        mServerFft(true)
 {
     initCaptureSize();
 }
@@ -289,6 +291,12 @@ status_t Visualizer::getFft(uint8_t *fft)
 
     status_t status = NO_ERROR;
     if (mEnabled) {
+        if (mServerFft) {
+            status = getServerFft(fft, NULL);
+            if (status != BAD_VALUE) {
+                return status;
+            }
+        }
         uint8_t buf[mCaptureSize];
         status = getWaveForm(buf);
         if (status == NO_ERROR) {
@@ -300,6 +308,34 @@ status_t Visualizer::getFft(uint8_t *fft)
     return status;
 }
 
+status_t Visualizer::getServerFft(uint8_t *fft, uint8_t *waveform)
+{
+    uint32_t size = waveform != NULL ? 2 * mCaptureSize : mCaptureSize;
+    uint8_t buf[size];
+    uint32_t replySize = size;
+    status_t status = command(VISUALIZER_CMD_CAPTURE_FFT, 0, NULL, &replySize, buf);
+    ALOGV("getServerFft() command returned %d", status);
+    if (status == BAD_VALUE) {
+        // effect library without server side FFT: fall back to doing it here from now on
+        ALOGV("getServerFft() not supported by effect, using local FFT");
+        mServerFft = false;
+        return status;
+    }
+    if (status != NO_ERROR) {
+        return status;
+    }
+    if (replySize != size) {
+        return NOT_ENOUGH_DATA;
+    }
+    if (waveform != NULL) {
+        memcpy(waveform, buf, mCaptureSize);
+        memcpy(fft, buf + mCaptureSize, mCaptureSize);
+    } else {
+        memcpy(fft, buf, mCaptureSize);
+    }
+    return NO_ERROR;
+}
+
 status_t Visualizer::doFft(uint8_t *fft, uint8_t *waveform)
 {
     int32_t workspace[mCaptureSize >> 1];
@@ -337,13 +373,19 @@ void Visualizer::periodicCapture()
         (mCaptureFlags & (CAPTURE_WAVEFORM|CAPTURE_FFT)) &&
         mCaptureSize != 0) {
         uint8_t waveform[mCaptureSize];
-        status_t status = getWaveForm(waveform);
-        if (status != NO_ERROR) {
-            return;
-        }
         uint8_t fft[mCaptureSize];
-        if (mCaptureFlags & CAPTURE_FFT) {
-            status = doFft(fft, waveform);
+        status_t status = BAD_VALUE;
+        if ((mCaptureFlags & CAPTURE_FFT) && mServerFft && mEnabled) {
+            status = getServerFft(fft, waveform);
+        }
+        if (status == BAD_VALUE) {
+            status = getWaveForm(waveform);
+            if (status != NO_ERROR) {
+                return;
+            }
+            if (mCaptureFlags & CAPTURE_FFT) {
+                status = doFft(fft, waveform);
+            }
         }
         if (status != NO_ERROR) {
             return;
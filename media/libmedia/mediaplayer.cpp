@@ -820,6 +820,19 @@ void MediaPlayer::died()
 
 }
 
+/*static*/ sp<IMemory> MediaPlayer::decodeShared(int fd, int64_t offset, int64_t length,
+                                        uint32_t *pSampleRate, int* pNumChannels,
+                                        audio_format_t* pFormat)
+{
+    ALOGV("decodeShared(%d, %lld, %lld)", fd, offset, length);
+    const sp<IMediaPlayerService>& service = getMediaPlayerService();
+    if (service == 0) {
+        ALOGE("Unable to locate media service");
+        return 0;
+    }
+    return service->decodeShared(fd, offset, length, pSampleRate, pNumChannels, pFormat);
+}
+
 status_t MediaPlayer::setNextMediaPlayer(const sp<MediaPlayer>& next) {
     if (mPlayer == NULL) {
         return NO_INIT;
@@ -58,6 +58,9 @@
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/AudioPlayer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
 
 #include <system/audio.h>
 
@@ -204,6 +207,35 @@ static bool checkPermission(const char* permissionString) {
 // TODO: Find real cause of Audio/Video delay in PV framework and remove this workaround
 /* static */ int MediaPlayerService::AudioOutput::mMinBufferCount = 4;
 /* static */ bool MediaPlayerService::AudioOutput::mIsOnEmulator = false;
+/* static */ Mutex MediaPlayerService::AudioOutput::sTrackPoolLock;
+/* static */ Vector<MediaPlayerService::AudioOutput::PooledTrack>
+        MediaPlayerService::AudioOutput::sTrackPool;
+
+static const size_t kMaxPooledTracks = 2;
+static const int64_t kPooledTrackTimeoutUs = 5000000ll;
+
+struct MediaPlayerService::AudioOutput::TrackPoolPurger : public AHandler {
+    TrackPoolPurger() {}
+
+    enum {
+        kWhatPurge = 'prge',
+    };
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        CHECK_EQ(msg->what(), (uint32_t)kWhatPurge);
+
+        Mutex::Autolock autoLock(sTrackPoolLock);
+        purgeTrackPool_l(ALooper::GetNowUs());
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(TrackPoolPurger);
+};
+
+/* static */ sp<ALooper> MediaPlayerService::AudioOutput::sTrackPoolLooper;
+/* static */ sp<MediaPlayerService::AudioOutput::TrackPoolPurger>
+        MediaPlayerService::AudioOutput::sTrackPoolPurger;
 
 void MediaPlayerService::instantiate() {
     defaultServiceManager()->addService(
@@ -413,6 +445,12 @@ status_t MediaPlayerService::dump(int fd, const Vector<String16>& args)
             }
         }
 
+        AString looperStats;
+        ALooper::DumpStats(&looperStats);
+        result.append(" Message loopers:\n");
+        result.append(looperStats.c_str());
+        result.append("\n");
+
         result.append(" Files opened and/or mapped:\n");
         snprintf(buffer, SIZE, "/proc/%d/maps", gettid());
         FILE *f = fopen(buffer, "r");
@@ -1297,6 +1335,57 @@ Exit:
     return status;
 }
 
+sp<IMemory> MediaPlayerService::decodeShared(int fd, int64_t offset, int64_t length,
+                                             uint32_t *pSampleRate, int* pNumChannels,
+                                             audio_format_t* pFormat)
+{
+    // same as the heap SoundPool allocates for a sample
+    static const size_t kMaxDecodedSize = 1024 * 1024;
+
+    ALOGV("decodeShared(%d, %lld, %lld)", fd, offset, length);
+    SampleCache::Key key;
+    SampleCache::Format format;
+    bool cacheable = SampleCache::makeKey(fd, offset, length, &key);
+    if (cacheable) {
+        sp<IMemory> memory = mSampleCache.lookup(key, &format);
+        if (memory != 0) {
+            ::close(fd);
+            *pSampleRate = format.mSampleRate;
+            *pNumChannels = format.mNumChannels;
+            *pFormat = format.mFormat;
+            return memory;
+        }
+    }
+
+    sp<MemoryHeapBase> heap = new MemoryHeapBase(kMaxDecodedSize, 0, "decodeShared");
+    if (heap->getHeapID() < 0) {
+        ::close(fd);
+        return 0;
+    }
+    size_t size;
+    // closes fd
+    if (decode(fd, offset, length, &format.mSampleRate, &format.mNumChannels, &format.mFormat,
+            heap, &size) != NO_ERROR) {
+        return 0;
+    }
+
+    // copy to a heap of the exact size, which clients map read-only
+    sp<MemoryHeapBase> sharedHeap = new MemoryHeapBase(size, MemoryHeapBase::READ_ONLY,
+            "SampleCache");
+    if (sharedHeap->getHeapID() < 0) {
+        return 0;
+    }
+    memcpy(sharedHeap->getBase(), heap->getBase(), size);
+    sp<IMemory> memory = new MemoryBase(sharedHeap, 0, size);
+    if (cacheable) {
+        memory = mSampleCache.add(key, memory, format);
+    }
+    *pSampleRate = format.mSampleRate;
+    *pNumChannels = format.mNumChannels;
+    *pFormat = format.mFormat;
+    return memory;
+}
+
 
 #undef LOG_TAG
 #define LOG_TAG "AudioSink"
@@ -1306,7 +1395,9 @@ MediaPlayerService::AudioOutput::AudioOutput(int sessionId)
       mCallbackData(NULL),
       mBytesWritten(0),
       mSessionId(sessionId),
-      mFlags(AUDIO_OUTPUT_FLAG_NONE) {
+      mFlags(AUDIO_OUTPUT_FLAG_NONE),
+      mChannelMask(AUDIO_CHANNEL_NONE),
+      mRequestedFrameCount(0) {
     ALOGV("AudioOutput(%d)", sessionId);
     mStreamType = AUDIO_STREAM_MUSIC;
     mLeftVolume = 1.0;
@@ -1615,17 +1706,22 @@ status_t MediaPlayerService::AudioOutput::open(
                     AudioTrack::TRANSFER_CALLBACK,
                     offloadInfo);
         } else {
-            t = new AudioTrack(
-                    mStreamType,
-                    sampleRate,
-                    format,
-                    channelMask,
-                    frameCount,
-                    flags,
-                    NULL,
-                    NULL,
-                    0,
-                    mSessionId);
+            t = takePooledTrack(
+                    sampleRate, channelMask, format, frameCount, flags);
+
+            if (t == NULL) {
+                t = new AudioTrack(
+                        mStreamType,
+                        sampleRate,
+                        format,
+                        channelMask,
+                        frameCount,
+                        flags,
+                        NULL,
+                        NULL,
+                        0,
+                        mSessionId);
+            }
         }
 
         if ((t == 0) || (t->initCheck() != NO_ERROR)) {
@@ -1651,6 +1747,7 @@ status_t MediaPlayerService::AudioOutput::open(
             close();
             mTrack = mRecycledTrack;
             mRecycledTrack.clear();
+            mRequestedFrameCount = 0;
             if (mCallbackData != NULL) {
                 mCallbackData->setOutput(this);
             }
@@ -1673,6 +1770,8 @@ status_t MediaPlayerService::AudioOutput::open(
 
     mSampleRateHz = sampleRate;
     mFlags = flags;
+    mChannelMask = channelMask;
+    mRequestedFrameCount = frameCount;
     mMsecsPerFrame = mPlaybackRatePermille / (float) sampleRate;
     uint32_t pos;
     if (t->getPosition(&pos) == OK) {
@@ -1762,7 +1861,99 @@ void MediaPlayerService::AudioOutput::pause()
 void MediaPlayerService::AudioOutput::close()
 {
     ALOGV("close");
-    if (mTrack != 0) mTrack.clear();
+    if (mTrack != 0) {
+        if (mCallbackData == NULL && mRequestedFrameCount > 0
+                && (mFlags & (AUDIO_OUTPUT_FLAG_COMPRESS_OFFLOAD
+                        | AUDIO_OUTPUT_FLAG_LPA
+                        | AUDIO_OUTPUT_FLAG_TUNNEL)) == 0) {
+            parkTrack();
+        }
+        mTrack.clear();
+    }
+    mRequestedFrameCount = 0;
+}
+
+void MediaPlayerService::AudioOutput::parkTrack()
+{
+    mTrack->stop();
+    mTrack->flush();
+
+    PooledTrack entry;
+    entry.mTrack = mTrack;
+    entry.mStreamType = mStreamType;
+    entry.mSampleRate = mSampleRateHz;
+    entry.mChannelMask = mChannelMask;
+    entry.mFrameCount = mRequestedFrameCount;
+    entry.mFlags = mFlags;
+    entry.mParkedUs = ALooper::GetNowUs();
+
+    Mutex::Autolock autoLock(sTrackPoolLock);
+
+    purgeTrackPool_l(entry.mParkedUs);
+
+    if (sTrackPool.size() >= kMaxPooledTracks) {
+        sTrackPool.removeAt(0);
+    }
+    sTrackPool.push(entry);
+    schedulePurge_l();
+
+    ALOGV("parked track, %d in pool", sTrackPool.size());
+}
+
+sp<AudioTrack> MediaPlayerService::AudioOutput::takePooledTrack(
+        uint32_t sampleRate, audio_channel_mask_t channelMask,
+        audio_format_t format, uint32_t frameCount,
+        audio_output_flags_t flags)
+{
+    Mutex::Autolock autoLock(sTrackPoolLock);
+
+    purgeTrackPool_l(ALooper::GetNowUs());
+
+    for (size_t i = sTrackPool.size(); i-- > 0;) {
+        const PooledTrack &entry = sTrackPool.itemAt(i);
+
+        if (entry.mStreamType == mStreamType
+                && entry.mTrack->getSessionId() == mSessionId
+                && entry.mSampleRate == sampleRate
+                && entry.mChannelMask == channelMask
+                && entry.mTrack->format() == format
+                && entry.mFrameCount == frameCount
+                && entry.mFlags == flags) {
+            sp<AudioTrack> track = entry.mTrack;
+            sTrackPool.removeAt(i);
+
+            ALOGV("reusing pooled track");
+            return track;
+        }
+    }
+
+    return NULL;
+}
+
+// static
+void MediaPlayerService::AudioOutput::purgeTrackPool_l(int64_t nowUs)
+{
+    while (!sTrackPool.isEmpty()
+            && nowUs - sTrackPool.itemAt(0).mParkedUs >= kPooledTrackTimeoutUs) {
+        sTrackPool.removeAt(0);
+    }
+}
+
+// static
+void MediaPlayerService::AudioOutput::schedulePurge_l()
+{
+    if (sTrackPoolLooper == NULL) {
+        sTrackPoolLooper = new ALooper;
+        sTrackPoolLooper->setName("AudioOutputTrackPool");
+        sTrackPoolLooper->start();
+
+        sTrackPoolPurger = new TrackPoolPurger;
+        sTrackPoolLooper->registerHandler(sTrackPoolPurger);
+    }
+
+    // each parked track gets its own purge, when it expires
+    (new AMessage(TrackPoolPurger::kWhatPurge, sTrackPoolPurger->id()))
+            ->post(kPooledTrackTimeoutUs);
 }
 
 void MediaPlayerService::AudioOutput::setVolume(float left, float right)
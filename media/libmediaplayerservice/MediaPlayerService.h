@@ -35,8 +35,11 @@
 
 #include <system/audio.h>
 
+#include "SampleCache.h"
+
 namespace android {
 
+struct ALooper;
 class AudioTrack;
 class IMediaRecorder;
 class IMediaMetadataRetriever;
@@ -129,6 +132,36 @@ class MediaPlayerService : public BnMediaPlayerService
                 int event, void *me, void *info);
                void             deleteRecycledTrack();
 
+        // Stopped write mode PCM tracks are parked here for a few seconds
+        // on close(), so that a player that is reset and set up again for
+        // the same format (feeds, playlists) doesn't create a new one.
+        struct PooledTrack {
+            sp<AudioTrack>          mTrack;
+            audio_stream_type_t     mStreamType;
+            uint32_t                mSampleRate;
+            audio_channel_mask_t    mChannelMask;
+            uint32_t                mFrameCount; // as requested in open()
+            audio_output_flags_t    mFlags;
+            int64_t                 mParkedUs;
+        };
+
+               void             parkTrack();
+               sp<AudioTrack>   takePooledTrack(
+                       uint32_t sampleRate, audio_channel_mask_t channelMask,
+                       audio_format_t format, uint32_t frameCount,
+                       audio_output_flags_t flags);
+        static void             purgeTrackPool_l(int64_t nowUs);
+        static void             schedulePurge_l();
+
+        // purges the pool when parked tracks expire, even if no track is
+        // parked or taken afterwards
+        struct TrackPoolPurger;
+
+        static Mutex            sTrackPoolLock;
+        static Vector<PooledTrack> sTrackPool;
+        static sp<ALooper>      sTrackPoolLooper;   // created on first park
+        static sp<TrackPoolPurger> sTrackPoolPurger;
+
         sp<AudioTrack>          mTrack;
         sp<AudioTrack>          mRecycledTrack;
         sp<AudioOutput>         mNextOutput;
@@ -148,6 +181,8 @@ class MediaPlayerService : public BnMediaPlayerService
         static bool             mIsOnEmulator;
         static int              mMinBufferCount;  // 12 for emulator; otherwise 4
         audio_output_flags_t    mFlags;
+        audio_channel_mask_t    mChannelMask;
+        uint32_t                mRequestedFrameCount; // 0 if mTrack can't be pooled
 
         // CallbackData is what is passed to the AudioTrack as the "user" data.
         // We need to be able to target this to a different Output on the fly,
@@ -262,6 +297,9 @@ public:
                                        uint32_t *pSampleRate, int* pNumChannels,
                                        audio_format_t* pFormat,
                                        const sp<IMemoryHeap>& heap, size_t *pSize);
+    virtual sp<IMemory>         decodeShared(int fd, int64_t offset, int64_t length,
+                                       uint32_t *pSampleRate, int* pNumChannels,
+                                       audio_format_t* pFormat);
     virtual sp<IOMX>            getOMX();
     virtual sp<ICrypto>         makeCrypto();
     virtual sp<IDrm>            makeDrm();
@@ -447,6 +485,7 @@ private:
                 int32_t                     mNextConnId;
                 sp<IOMX>                    mOMX;
                 sp<ICrypto>                 mCrypto;
+                SampleCache                 mSampleCache;
 };
 
 // ----------------------------------------------------------------------------
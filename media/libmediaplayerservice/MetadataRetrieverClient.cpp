@@ -20,6 +20,7 @@
 #include <utils/Log.h>
 
 #include <sys/types.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <unistd.h>
@@ -105,6 +106,79 @@ static sp<MediaMetadataRetrieverBase> createRetriever(player_type playerType)
     return p;
 }
 
+// Decoding a frame is by far the most expensive retrieval operation. Only a few
+// run at a time across all clients, and waiting callers are admitted in order of
+// their thread priority, which binder inherits from the calling app thread, so
+// that thumbnails the user is waiting for don't queue behind background prefetches.
+class FrameCaptureSlot
+{
+public:
+    FrameCaptureSlot();
+    ~FrameCaptureSlot();
+
+private:
+    struct Waiter {
+        int      mPriority;
+        uint32_t mTicket;
+    };
+
+    static int maxActive();
+
+    static Mutex            sLock;
+    static Condition        sCondition;
+    static Vector<Waiter>   sWaiters;   // most urgent first, then in arrival order
+    static int              sActive;
+    static uint32_t         sNextTicket;
+};
+
+Mutex FrameCaptureSlot::sLock;
+Condition FrameCaptureSlot::sCondition;
+Vector<FrameCaptureSlot::Waiter> FrameCaptureSlot::sWaiters;
+int FrameCaptureSlot::sActive = 0;
+uint32_t FrameCaptureSlot::sNextTicket = 0;
+
+int FrameCaptureSlot::maxActive()
+{
+    static int max = 0;
+    if (max == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_CONF);
+        max = (cpus < 2) ? 2 : (cpus > 4) ? 4 : cpus;
+    }
+    return max;
+}
+
+FrameCaptureSlot::FrameCaptureSlot()
+{
+    Waiter waiter;
+    waiter.mPriority = getpriority(PRIO_PROCESS, gettid());
+
+    Mutex::Autolock lock(sLock);
+    waiter.mTicket = sNextTicket++;
+
+    size_t i = 0;
+    while (i < sWaiters.size() && sWaiters[i].mPriority <= waiter.mPriority) {
+        ++i;
+    }
+    sWaiters.insertAt(waiter, i);
+
+    while (sActive >= maxActive() || sWaiters[0].mTicket != waiter.mTicket) {
+        ALOGV("waiting for a frame capture slot, priority %d", waiter.mPriority);
+        sCondition.wait(sLock);
+    }
+    sWaiters.removeAt(0);
+    ++sActive;
+
+    // the next waiter may be able to go ahead as well
+    sCondition.broadcast();
+}
+
+FrameCaptureSlot::~FrameCaptureSlot()
+{
+    Mutex::Autolock lock(sLock);
+    --sActive;
+    sCondition.broadcast();
+}
+
 status_t MetadataRetrieverClient::setDataSource(
         const char *url, const KeyedVector<String8, String8> *headers)
 {
@@ -184,7 +258,11 @@ sp<IMemory> MetadataRetrieverClient::getFrameAtTime(int64_t timeUs, int option)
         ALOGE("retriever is not initialized");
         return NULL;
     }
-    VideoFrame *frame = mRetriever->getFrameAtTime(timeUs, option);
+    VideoFrame *frame;
+    {
+        FrameCaptureSlot slot;
+        frame = mRetriever->getFrameAtTime(timeUs, option);
+    }
     if (frame == NULL) {
         ALOGE("failed to capture a video frame");
         return NULL;
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SampleCache"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "SampleCache.h"
+
+namespace android {
+
+/*static*/ bool SampleCache::makeKey(int fd, int64_t offset, int64_t length, Key* key)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || offset < 0 || offset >= st.st_size) {
+        return false;
+    }
+    // callers may pass a length extending past the end of file, meaning "up to the end"
+    if (length > st.st_size - offset) {
+        length = st.st_size - offset;
+    }
+    if (length <= 0 || length > kMaxSourceSize) {
+        return false;
+    }
+    uint8_t *data = (uint8_t *) malloc(length);
+    if (data == NULL) {
+        return false;
+    }
+    ssize_t actual = pread(fd, data, length, offset);
+    if (actual != length) {
+        ALOGV("makeKey() read %d of %lld bytes", actual, length);
+        free(data);
+        return false;
+    }
+    SHA256(data, length, key->mDigest);
+    free(data);
+    key->mLength = length;
+    return true;
+}
+
+sp<IMemory> SampleCache::lookup(const Key& key, Format* format)
+{
+    Mutex::Autolock _l(mLock);
+    ssize_t index = mEntries.indexOfKey(key);
+    if (index < 0) {
+        return 0;
+    }
+    const Entry& entry = mEntries.valueAt(index);
+    sp<IMemory> memory = entry.mMemory.promote();
+    if (memory == 0) {
+        mEntries.removeItemsAt(index);
+        return 0;
+    }
+    *format = entry.mFormat;
+    ALOGV("lookup() hit for %lld bytes, %u bytes of PCM", key.mLength, memory->size());
+    return memory;
+}
+
+sp<IMemory> SampleCache::add(const Key& key, const sp<IMemory>& memory, const Format& format)
+{
+    Mutex::Autolock _l(mLock);
+    ssize_t index = mEntries.indexOfKey(key);
+    if (index >= 0) {
+        sp<IMemory> existing = mEntries.valueAt(index).mMemory.promote();
+        if (existing != 0) {
+            // decoded concurrently by another client, drop ours
+            return existing;
+        }
+    }
+    // the entries of samples no longer used by anyone are removed here, rather than
+    // when they are released, so that the cache needs no callback from the memory
+    for (size_t i = mEntries.size(); i > 0; ) {
+        i--;
+        if (mEntries.valueAt(i).mMemory.promote() == 0) {
+            mEntries.removeItemsAt(i);
+        }
+    }
+    Entry entry;
+    entry.mMemory = memory;
+    entry.mFormat = format;
+    mEntries.add(key, entry);
+    return memory;
+}
+
+}   // namespace android
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SAMPLE_CACHE_H
+#define ANDROID_SAMPLE_CACHE_H
+
+#include <string.h>
+
+#include <binder/IMemory.h>
+#include <openssl/sha.h>
+#include <system/audio.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
+
+namespace android {
+
+// Decoded PCM of short sounds, shared read-only by all clients that decode the same compressed
+// content, typically the sound effects loaded by every SoundPool of a game or of the UI.
+// The cache holds weak references only: an entry goes away with the last client using it.
+class SampleCache {
+public:
+    // Identifies compressed content, independently of the file or process it comes from.
+    // The cache is shared by all apps, so the digest must be collision resistant.
+    struct Key {
+        int64_t     mLength;
+        uint8_t     mDigest[SHA256_DIGEST_LENGTH];
+
+        bool operator<(const Key& other) const {
+            return mLength < other.mLength ||
+                    (mLength == other.mLength &&
+                            memcmp(mDigest, other.mDigest, sizeof(mDigest)) < 0);
+        }
+    };
+
+    struct Format {
+        uint32_t        mSampleRate;
+        int             mNumChannels;
+        audio_format_t  mFormat;
+    };
+
+    // Sources larger than this are decoded without being cached
+    static const int64_t kMaxSourceSize = 1024 * 1024;
+
+    // Compute the key of the content at [offset, offset + length) in fd,
+    // without changing the file offset.  Returns false if the content can't be cached.
+    static bool makeKey(int fd, int64_t offset, int64_t length, Key* key);
+
+    // Return the decoded PCM for key if it is still used by some client, else 0
+    sp<IMemory> lookup(const Key& key, Format* format);
+
+    // Add the decoded PCM for key, and return what the caller should use:
+    // the memory given, or an equivalent one added concurrently by another client
+    sp<IMemory> add(const Key& key, const sp<IMemory>& memory, const Format& format);
+
+private:
+    struct Entry {
+        wp<IMemory> mMemory;
+        Format      mFormat;
+    };
+
+    Mutex                       mLock;
+    KeyedVector<Key, Entry>     mEntries;
+};
+
+}   // namespace android
+
+#endif  // ANDROID_SAMPLE_CACHE_H
@@ -77,7 +77,8 @@ StagefrightRecorder::StagefrightRecorder()
       mOutputFd(-1),
       mAudioSource(AUDIO_SOURCE_CNT),
       mVideoSource(VIDEO_SOURCE_LIST_END),
-      mStarted(false), mSurfaceMediaSource(NULL),
+      mStarted(false), mWriterPrepared(false), mPreparedTotalBitRate(0),
+      mSurfaceMediaSource(NULL),
       mCaptureTimeLapse(false) {
 
     ALOGV("Constructor");
@@ -489,6 +490,19 @@ status_t StagefrightRecorder::setParam64BitFileOffset(bool use64Bit) {
     return OK;
 }
 
+// If timeDurationUs > 0, MPEG-4 output is written as a fragmented file
+// whose movie fragments are about timeDurationUs long
+status_t StagefrightRecorder::setParamFragmentDuration(int64_t timeDurationUs) {
+    ALOGV("setParamFragmentDuration: %lld us", timeDurationUs);
+    if (timeDurationUs < 0) {
+        ALOGE("Fragment duration (%lld us) must be positive, or 0 to disable",
+            timeDurationUs);
+        return BAD_VALUE;
+    }
+    mFragmentDurationUs = timeDurationUs;
+    return OK;
+}
+
 status_t StagefrightRecorder::setParamVideoCameraId(int32_t cameraId) {
     ALOGV("setParamVideoCameraId: %d", cameraId);
     if (cameraId < 0) {
@@ -638,6 +652,11 @@ status_t StagefrightRecorder::setParameter(
         if (safe_strtoi32(value.string(), &use64BitOffset)) {
             return setParam64BitFileOffset(use64BitOffset != 0);
         }
+    } else if (key == "param-fragment-duration-ms") {
+        int64_t durationMs;
+        if (safe_strtoi64(value.string(), &durationMs)) {
+            return setParamFragmentDuration(1000LL * durationMs);
+        }
     } else if (key == "param-geotag-longitude") {
         int64_t longitudex10000;
         if (safe_strtoi64(value.string(), &longitudex10000)) {
@@ -783,8 +802,32 @@ status_t StagefrightRecorder::prepare() {
     ALOGV("File is huge so setting 64 bit file offsets");
     setParam64BitFileOffset(true);
   }
+
+  // Set up the sources, encoders and writer now rather than when recording
+  // starts, so that start() only has to start the writer.
+  status_t err = OK;
+  switch (mOutputFormat) {
+      case OUTPUT_FORMAT_DEFAULT:
+      case OUTPUT_FORMAT_THREE_GPP:
+      case OUTPUT_FORMAT_MPEG_4:
+          if (mOutputFd >= 0 && mWriter == NULL) {
+              err = setupMPEG4Recording(
+                      mOutputFd, mVideoWidth, mVideoHeight,
+                      mVideoBitRate, &mPreparedTotalBitRate, &mWriter);
+              if (err != OK) {
+                  mWriter.clear();
+              } else {
+                  mWriterPrepared = true;
+              }
+          }
+          break;
+
+      default:
+          break;
+  }
+
   ALOGV(" %s X", __func__ );
-  return OK;
+  return err;
 }
 
 status_t StagefrightRecorder::start() {
@@ -792,7 +835,7 @@ status_t StagefrightRecorder::start() {
 
     // Get UID here for permission checking
     mClientUid = IPCThreadState::self()->getCallingUid();
-    if (mWriter != NULL) {
+    if (mWriter != NULL && !mWriterPrepared) {
         ALOGE("File writer is not avaialble");
         return UNKNOWN_ERROR;
     }
@@ -1713,6 +1756,9 @@ void StagefrightRecorder::setupMPEG4MetaData(int64_t startTimeUs, int32_t totalB
     (*meta)->setInt32(kKeyFileType, mOutputFormat);
     (*meta)->setInt32(kKeyBitRate, totalBitRate);
     (*meta)->setInt32(kKey64BitFileOffset, mUse64BitFileOffset);
+    if (mFragmentDurationUs > 0) {
+        (*meta)->setInt64(kKeyFragmentDurationUs, mFragmentDurationUs);
+    }
     if (mMovieTimeScale > 0) {
         (*meta)->setInt32(kKeyTimeScale, mMovieTimeScale);
     }
@@ -1726,11 +1772,17 @@ void StagefrightRecorder::setupMPEG4MetaData(int64_t startTimeUs, int32_t totalB
 
 status_t StagefrightRecorder::startMPEG4Recording() {
     int32_t totalBitRate;
-    status_t err = setupMPEG4Recording(
-            mOutputFd, mVideoWidth, mVideoHeight,
-            mVideoBitRate, &totalBitRate, &mWriter);
-    if (err != OK) {
-        return err;
+    status_t err;
+    if (mWriterPrepared) {
+        totalBitRate = mPreparedTotalBitRate;
+        mWriterPrepared = false;
+    } else {
+        err = setupMPEG4Recording(
+                mOutputFd, mVideoWidth, mVideoHeight,
+                mVideoBitRate, &totalBitRate, &mWriter);
+        if (err != OK) {
+            return err;
+        }
     }
 
     int64_t startTimeUs = systemTime() / 1000;
@@ -1747,7 +1799,7 @@ status_t StagefrightRecorder::startMPEG4Recording() {
 
 status_t StagefrightRecorder::pause() {
     ALOGV("pause");
-    if (mWriter == NULL) {
+    if (mWriter == NULL || mWriterPrepared) {
         return UNKNOWN_ERROR;
     }
     mWriter->pause();
@@ -1783,6 +1835,7 @@ status_t StagefrightRecorder::stop() {
         err = mWriter->stop();
         mWriter.clear();
     }
+    mWriterPrepared = false;
 
     if (mOutputFd >= 0) {
         ::close(mOutputFd);
@@ -1841,6 +1894,7 @@ status_t StagefrightRecorder::reset() {
     mIFramesIntervalSec = 1;
     mAudioSourceNode = 0;
     mUse64BitFileOffset = false;
+    mFragmentDurationUs = 0;
     mMovieTimeScale  = -1;
     mAudioTimeScale  = -1;
     mVideoTimeScale  = -1;
@@ -1905,6 +1959,8 @@ status_t StagefrightRecorder::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     File offset length (bits): %d\n", mUse64BitFileOffset? 64: 32);
     result.append(buffer);
+    snprintf(buffer, SIZE, "     Fragment duration (us): %lld\n", mFragmentDurationUs);
+    result.append(buffer);
     snprintf(buffer, SIZE, "     Interleave duration (us): %d\n", mInterleaveDurationUs);
     result.append(buffer);
     snprintf(buffer, SIZE, "     Progress notification: %lld us\n", mTrackEveryTimeDurationUs);
@@ -85,6 +85,7 @@ private:
     audio_encoder mAudioEncoder;
     video_encoder mVideoEncoder;
     bool mUse64BitFileOffset;
+    int64_t mFragmentDurationUs;
     int32_t mVideoWidth, mVideoHeight;
     int32_t mFrameRate;
     int32_t mVideoBitRate;
@@ -118,6 +119,10 @@ private:
     MediaProfiles *mEncoderProfiles;
 
     bool mStarted;
+    // Whether mWriter was set up by prepare() and not started yet, and the
+    // bit rate it was set up with
+    bool mWriterPrepared;
+    int32_t mPreparedTotalBitRate;
     // Needed when GLFrames are encoded.
     // An <IGraphicBufferProducer> pointer
     // will be sent to the client side using which the
@@ -174,6 +179,7 @@ private:
     status_t setParamTrackTimeStatus(int64_t timeDurationUs);
     status_t setParamInterleaveDuration(int32_t durationUs);
     status_t setParam64BitFileOffset(bool use64BitFileOffset);
+    status_t setParamFragmentDuration(int64_t timeDurationUs);
     status_t setParamMaxFileDurationUs(int64_t timeUs);
     status_t setParamMaxFileSizeBytes(int64_t bytes);
     status_t setParamMovieTimeScale(int32_t timeScale);
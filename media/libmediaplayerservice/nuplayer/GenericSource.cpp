@@ -17,14 +17,18 @@
 #include "GenericSource.h"
 
 #include "AnotherPacketSource.h"
+#include "HTTPBase.h"
+#include "NuCachedSource2.h"
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MediaExtractor.h>
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MetaData.h>
@@ -38,35 +42,50 @@ NuPlayer::GenericSource::GenericSource(
         bool uidValid,
         uid_t uid)
     : Source(notify),
+      mURI(url),
+      mDisconnected(false),
+      mPrepareThreadStarted(false),
       mDurationUs(0ll),
       mAudioIsVorbis(false) {
-    DataSource::RegisterDefaultSniffers();
-
-    sp<DataSource> dataSource =
-        DataSource::CreateFromURI(url, headers);
-    CHECK(dataSource != NULL);
-
-    initFromDataSource(dataSource);
+    if (headers) {
+        mURIHeaders = *headers;
+    }
 }
 
 NuPlayer::GenericSource::GenericSource(
         const sp<AMessage> &notify,
         int fd, int64_t offset, int64_t length)
     : Source(notify),
+      mDataSource(new FileSource(dup(fd), offset, length)),
+      mDisconnected(false),
+      mPrepareThreadStarted(false),
       mDurationUs(0ll),
       mAudioIsVorbis(false) {
+}
+
+status_t NuPlayer::GenericSource::initFromDataSource() {
     DataSource::RegisterDefaultSniffers();
 
-    sp<DataSource> dataSource = new FileSource(dup(fd), offset, length);
+    if (mDataSource == NULL) {
+        if (!strncasecmp("http://", mURI.c_str(), 7)
+                || !strncasecmp("https://", mURI.c_str(), 8)) {
+            mDataSource = createHTTPDataSource();
+        } else {
+            mDataSource = DataSource::CreateFromURI(
+                    mURI.c_str(), mURIHeaders.isEmpty() ? NULL : &mURIHeaders);
+        }
 
-    initFromDataSource(dataSource);
-}
+        if (mDataSource == NULL) {
+            ALOGE("unable to create data source for '%s'", mURI.c_str());
+            return ERROR_UNSUPPORTED;
+        }
+    }
 
-void NuPlayer::GenericSource::initFromDataSource(
-        const sp<DataSource> &dataSource) {
-    sp<MediaExtractor> extractor = MediaExtractor::Create(dataSource);
+    sp<MediaExtractor> extractor = MediaExtractor::Create(mDataSource);
 
-    CHECK(extractor != NULL);
+    if (extractor == NULL) {
+        return ERROR_UNSUPPORTED;
+    }
 
     for (size_t i = 0; i < extractor->countTracks(); ++i) {
         sp<MetaData> meta = extractor->getTrackMetaData(i);
@@ -101,12 +120,141 @@ void NuPlayer::GenericSource::initFromDataSource(
             }
         }
     }
+
+    if (mAudioTrack.mSource == NULL && mVideoTrack.mSource == NULL) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    return OK;
+}
+
+// Same as DataSource::CreateFromURI(), but keeps the HTTP connection around
+// so that it can be interrupted.
+sp<DataSource> NuPlayer::GenericSource::createHTTPDataSource() {
+    sp<HTTPBase> httpSource = HTTPBase::Create();
+
+    {
+        Mutex::Autolock autoLock(mDisconnectLock);
+        if (mDisconnected) {
+            return NULL;
+        }
+        mHttpSource = httpSource;
+    }
+
+    String8 cacheConfig;
+    bool disconnectAtHighwatermark;
+    KeyedVector<String8, String8> headers = mURIHeaders;
+    NuCachedSource2::RemoveCacheSpecificHeaders(
+            &headers, &cacheConfig, &disconnectAtHighwatermark);
+
+    if (httpSource->connect(mURI.c_str(), &headers) != OK) {
+        return NULL;
+    }
+
+    return new NuCachedSource2(
+            httpSource,
+            cacheConfig.isEmpty() ? NULL : cacheConfig.string(),
+            disconnectAtHighwatermark);
 }
 
 NuPlayer::GenericSource::~GenericSource() {
+    {
+        Mutex::Autolock autoLock(mDisconnectLock);
+        mDisconnected = true;
+        if (mHttpSource != NULL) {
+            mHttpSource->disconnect();
+        }
+    }
+
+    if (mPrepareThreadStarted) {
+        void *dummy;
+        pthread_join(mPrepareThread, &dummy);
+    }
 }
 
 void NuPlayer::GenericSource::prepareAsync() {
+    CHECK(!mPrepareThreadStarted);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    pthread_create(&mPrepareThread, &attr, PrepareThreadWrapper, this);
+    pthread_attr_destroy(&attr);
+
+    mPrepareThreadStarted = true;
+}
+
+// static
+void *NuPlayer::GenericSource::PrepareThreadWrapper(void *me) {
+    static_cast<GenericSource *>(me)->prepareThreadEntry();
+    return NULL;
+}
+
+// static
+void *NuPlayer::GenericSource::PrefetchVideoThreadWrapper(void *me) {
+    status_t err =
+        static_cast<GenericSource *>(me)->startTrack(false /* audio */);
+
+    return (void *)(intptr_t)err;
+}
+
+void NuPlayer::GenericSource::prepareThreadEntry() {
+    int64_t startUs = ALooper::GetNowUs();
+
+    status_t err = initFromDataSource();
+
+    if (err != OK) {
+        ALOGE("failed to probe '%s' (%d)", mURI.c_str(), err);
+        notifyPrepared(err);
+        return;
+    }
+
+    int64_t probedUs = ALooper::GetNowUs();
+
+    pthread_t videoThread;
+    bool videoThreadStarted = false;
+
+    if (mVideoTrack.mSource != NULL) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+        videoThreadStarted = pthread_create(
+                &videoThread, &attr, PrefetchVideoThreadWrapper, this) == 0;
+
+        pthread_attr_destroy(&attr);
+
+        if (!videoThreadStarted) {
+            err = startTrack(false /* audio */);
+        }
+    }
+
+    if (mAudioTrack.mSource != NULL) {
+        status_t audioErr = startTrack(true /* audio */);
+
+        if (err == OK) {
+            err = audioErr;
+        }
+    }
+
+    if (videoThreadStarted) {
+        void *videoErr;
+        pthread_join(videoThread, &videoErr);
+
+        if (err == OK) {
+            err = (status_t)(intptr_t)videoErr;
+        }
+    }
+
+    ALOGV("prepared in %lld us, probing took %lld us",
+          ALooper::GetNowUs() - startUs, probedUs - startUs);
+
+    if (err != OK) {
+        notifyPrepared(err);
+        return;
+    }
+
     if (mVideoTrack.mSource != NULL) {
         sp<MetaData> meta = mVideoTrack.mSource->getFormat();
 
@@ -126,26 +274,27 @@ void NuPlayer::GenericSource::prepareAsync() {
     notifyPrepared();
 }
 
-void NuPlayer::GenericSource::start() {
-    ALOGI("start");
-
-    if (mAudioTrack.mSource != NULL) {
-        CHECK_EQ(mAudioTrack.mSource->start(), (status_t)OK);
+// Starts the track and reads its first access unit, so that the decoder
+// has something to chew on as soon as the player starts.
+status_t NuPlayer::GenericSource::startTrack(bool audio) {
+    Track *track = audio ? &mAudioTrack : &mVideoTrack;
 
-        mAudioTrack.mPackets =
-            new AnotherPacketSource(mAudioTrack.mSource->getFormat());
+    status_t err = track->mSource->start();
 
-        readBuffer(true /* audio */);
+    if (err != OK) {
+        ALOGE("failed to start %s track (%d)", audio ? "audio" : "video", err);
+        return err;
     }
 
-    if (mVideoTrack.mSource != NULL) {
-        CHECK_EQ(mVideoTrack.mSource->start(), (status_t)OK);
+    track->mPackets = new AnotherPacketSource(track->mSource->getFormat());
 
-        mVideoTrack.mPackets =
-            new AnotherPacketSource(mVideoTrack.mSource->getFormat());
+    readBuffer(audio);
 
-        readBuffer(false /* audio */);
-    }
+    return OK;
+}
+
+void NuPlayer::GenericSource::start() {
+    ALOGI("start");
 }
 
 status_t NuPlayer::GenericSource::feedMoreTSData() {
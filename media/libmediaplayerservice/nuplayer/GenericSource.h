@@ -23,11 +23,19 @@
 
 #include "ATSParser.h"
 
+#include <media/stagefright/foundation/AString.h>
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
+
+#include <pthread.h>
+
 namespace android {
 
 struct AnotherPacketSource;
 struct ARTSPController;
 struct DataSource;
+struct HTTPBase;
 struct MediaSource;
 
 struct NuPlayer::GenericSource : public NuPlayer::Source {
@@ -64,13 +72,35 @@ private:
         sp<AnotherPacketSource> mPackets;
     };
 
+    // The data source is opened and probed, and the first access unit of
+    // each track read, on mPrepareThread, the video track on a thread of
+    // its own so that it overlaps with the audio track.
+    AString mURI;
+    KeyedVector<String8, String8> mURIHeaders;
+    sp<DataSource> mDataSource;
+
+    // The HTTP connection under mDataSource, if any, which the destructor
+    // disconnects so that a prepare blocked on the network returns.
+    Mutex mDisconnectLock;
+    sp<HTTPBase> mHttpSource;
+    bool mDisconnected;
+
+    pthread_t mPrepareThread;
+    bool mPrepareThreadStarted;
+
     Track mAudioTrack;
     Track mVideoTrack;
 
     int64_t mDurationUs;
     bool mAudioIsVorbis;
 
-    void initFromDataSource(const sp<DataSource> &dataSource);
+    static void *PrepareThreadWrapper(void *me);
+    void prepareThreadEntry();
+    static void *PrefetchVideoThreadWrapper(void *me);
+
+    status_t initFromDataSource();
+    sp<DataSource> createHTTPDataSource();
+    status_t startTrack(bool audio);
 
     void readBuffer(
             bool audio,
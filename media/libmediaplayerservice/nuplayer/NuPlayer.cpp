@@ -68,6 +68,10 @@ struct NuPlayer::SeekAction : public Action {
         player->performSeek(mSeekTimeUs);
     }
 
+    void setSeekTimeUs(int64_t seekTimeUs) {
+        mSeekTimeUs = seekTimeUs;
+    }
+
 private:
     int64_t mSeekTimeUs;
 
@@ -626,19 +630,23 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
                         channelMask = CHANNEL_MASK_USE_CHANNEL_ORDER;
                     }
 
+                    bool deepBuffer = (flags == AUDIO_OUTPUT_FLAG_DEEP_BUFFER);
+
+                    // On the deep buffer output the sink holds about half a
+                    // second, so that the renderer rarely needs to wake up.
                     CHECK_EQ(mAudioSink->open(
                                 sampleRate,
                                 numChannels,
                                 (audio_channel_mask_t)channelMask,
                                 AUDIO_FORMAT_PCM_16_BIT,
-                                8 /* bufferCount */,
+                                deepBuffer ? 32 : 8 /* bufferCount */,
                                 NULL,
                                 NULL,
                                 flags),
                              (status_t)OK);
                     mAudioSink->start();
 
-                    mRenderer->signalAudioSinkChanged();
+                    mRenderer->signalAudioSinkChanged(deepBuffer);
                 } else {
                     // video
 
@@ -805,10 +813,29 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
 
             ALOGV("kWhatSeek seekTimeUs=%lld us", seekTimeUs);
 
+            if (mQueuedSeekAction != NULL) {
+                // The previous seek is still waiting for a flush to
+                // complete, while scrubbing only the latest position
+                // matters. Retarget it instead of flushing and seeking
+                // once more, completing the superseded request now.
+                ALOGV("superseding queued seek");
+
+                mQueuedSeekAction->setSeekTimeUs(seekTimeUs);
+
+                if (mDriver != NULL) {
+                    sp<NuPlayerDriver> driver = mDriver.promote();
+                    if (driver != NULL) {
+                        driver->notifySeekComplete();
+                    }
+                }
+                break;
+            }
+
             mDeferredActions.push_back(
                     new SimpleAction(&NuPlayer::performDecoderFlush));
 
-            mDeferredActions.push_back(new SeekAction(seekTimeUs));
+            mQueuedSeekAction = new SeekAction(seekTimeUs);
+            mDeferredActions.push_back(mQueuedSeekAction);
 
             processDeferredActions();
             break;
@@ -1233,6 +1260,10 @@ void NuPlayer::processDeferredActions() {
         sp<Action> action = *mDeferredActions.begin();
         mDeferredActions.erase(mDeferredActions.begin());
 
+        if (action == mQueuedSeekAction) {
+            mQueuedSeekAction.clear();
+        }
+
         action->execute(this);
     }
 }
@@ -121,6 +121,9 @@ private:
 
     List<sp<Action> > mDeferredActions;
 
+    // The most recent seek queued in mDeferredActions, while it's queued.
+    sp<SeekAction> mQueuedSeekAction;
+
     bool mAudioEOS;
     bool mVideoEOS;
 
@@ -25,6 +25,7 @@
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/ACodec.h>
 #include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/ExtendedCodec.h>
 
 namespace android {
@@ -33,7 +34,12 @@ NuPlayer::Decoder::Decoder(
         const sp<AMessage> &notify,
         const sp<NativeWindowWrapper> &nativeWindow)
     : mNotify(notify),
-      mNativeWindow(nativeWindow) {
+      mNativeWindow(nativeWindow),
+      mPassThrough(false),
+      mPassThroughEOS(false),
+      mPassThroughGeneration(0),
+      mPassThroughPendingInputs(0),
+      mPassThroughFlushPending(false) {
 }
 
 NuPlayer::Decoder::~Decoder() {
@@ -45,6 +51,11 @@ void NuPlayer::Decoder::configure(const sp<AMessage> &format) {
     AString mime;
     CHECK(format->findString("mime", &mime));
 
+    if (!strcasecmp(mime.c_str(), MEDIA_MIMETYPE_AUDIO_RAW)) {
+        configurePassThrough(format);
+        return;
+    }
+
     sp<AMessage> notifyMsg =
         new AMessage(kWhatCodecNotify, id());
 
@@ -94,6 +105,94 @@ void NuPlayer::Decoder::configure(const sp<AMessage> &format) {
     mCodec->initiateSetup(format);
 }
 
+void NuPlayer::Decoder::configurePassThrough(const sp<AMessage> &format) {
+    int32_t numChannels, sampleRate;
+    CHECK(format->findInt32("channel-count", &numChannels));
+    CHECK(format->findInt32("sample-rate", &sampleRate));
+
+    ALOGV("passing through raw audio, %d Hz, %d channels",
+          sampleRate, numChannels);
+
+    mPassThrough = true;
+    mPassThroughEOS = false;
+
+    sp<AMessage> codecRequest = new AMessage;
+    codecRequest->setInt32("what", ACodec::kWhatOutputFormatChanged);
+    codecRequest->setString("mime", MEDIA_MIMETYPE_AUDIO_RAW);
+    codecRequest->setInt32("channel-count", numChannels);
+    codecRequest->setInt32("sample-rate", sampleRate);
+
+    int32_t channelMask;
+    if (format->findInt32("channel-mask", &channelMask)) {
+        codecRequest->setInt32("channel-mask", channelMask);
+    }
+
+    postCodecRequest(codecRequest);
+
+    for (size_t i = 0; i < kNumPassThroughBuffers; ++i) {
+        requestPassThroughInput();
+    }
+}
+
+void NuPlayer::Decoder::postCodecRequest(const sp<AMessage> &codecRequest) {
+    sp<AMessage> notify = mNotify->dup();
+    notify->setMessage("codec-request", codecRequest);
+    notify->post();
+}
+
+void NuPlayer::Decoder::requestPassThroughInput() {
+    sp<AMessage> reply = new AMessage(kWhatInputBufferFilled, id());
+    reply->setInt32("generation", mPassThroughGeneration);
+
+    sp<AMessage> codecRequest = new AMessage;
+    codecRequest->setInt32("what", ACodec::kWhatFillThisBuffer);
+    codecRequest->setMessage("reply", reply);
+
+    ++mPassThroughPendingInputs;
+    postCodecRequest(codecRequest);
+}
+
+void NuPlayer::Decoder::completePassThroughFlush() {
+    mPassThroughFlushPending = false;
+
+    sp<AMessage> codecRequest = new AMessage;
+    codecRequest->setInt32("what", ACodec::kWhatFlushCompleted);
+    postCodecRequest(codecRequest);
+}
+
+void NuPlayer::Decoder::onPassThroughInputFilled(const sp<AMessage> &msg) {
+    sp<ABuffer> buffer;
+    if (!msg->findBuffer("buffer", &buffer)) {
+        int32_t err;
+        CHECK(msg->findInt32("err", &err));
+
+        if (err == INFO_DISCONTINUITY) {
+            // We're about to be flushed, signalResume() will ask for more.
+            return;
+        }
+
+        if (!mPassThroughEOS) {
+            mPassThroughEOS = true;
+
+            sp<AMessage> codecRequest = new AMessage;
+            codecRequest->setInt32("what", ACodec::kWhatEOS);
+            codecRequest->setInt32("err", err);
+            postCodecRequest(codecRequest);
+        }
+        return;
+    }
+
+    sp<AMessage> reply = new AMessage(kWhatOutputBufferDrained, id());
+    reply->setInt32("generation", mPassThroughGeneration);
+
+    sp<AMessage> codecRequest = new AMessage;
+    codecRequest->setInt32("what", ACodec::kWhatDrainThisBuffer);
+    codecRequest->setBuffer("buffer", buffer);
+    codecRequest->setMessage("reply", reply);
+
+    postCodecRequest(codecRequest);
+}
+
 void NuPlayer::Decoder::onMessageReceived(const sp<AMessage> &msg) {
     switch (msg->what()) {
         case kWhatCodecNotify:
@@ -111,6 +210,33 @@ void NuPlayer::Decoder::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatInputBufferFilled:
+        case kWhatOutputBufferDrained:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+
+            if (msg->what() == kWhatInputBufferFilled) {
+                CHECK_GT(mPassThroughPendingInputs, 0u);
+                if (--mPassThroughPendingInputs == 0
+                        && mPassThroughFlushPending) {
+                    completePassThroughFlush();
+                }
+            }
+
+            if (generation != mPassThroughGeneration) {
+                // Stale buffer from before a flush or shutdown.
+                break;
+            }
+
+            if (msg->what() == kWhatInputBufferFilled) {
+                onPassThroughInputFilled(msg);
+            } else if (!mPassThroughEOS) {
+                requestPassThroughInput();
+            }
+            break;
+        }
+
         default:
             TRESPASS();
             break;
@@ -143,19 +269,42 @@ void NuPlayer::Decoder::onFillThisBuffer(const sp<AMessage> &msg) {
 }
 
 void NuPlayer::Decoder::signalFlush() {
-    if (mCodec != NULL) {
+    if (mPassThrough) {
+        // Buffers still out there are dropped once they come back. Until
+        // NuPlayer sees the flush complete it answers the outstanding fill
+        // requests with a discontinuity, so wait for those.
+        ++mPassThroughGeneration;
+        mPassThroughEOS = false;
+
+        if (mPassThroughPendingInputs == 0) {
+            completePassThroughFlush();
+        } else {
+            mPassThroughFlushPending = true;
+        }
+    } else if (mCodec != NULL) {
         mCodec->signalFlush();
     }
 }
 
 void NuPlayer::Decoder::signalResume() {
-    if (mCodec != NULL) {
+    if (mPassThrough) {
+        for (size_t i = 0; i < kNumPassThroughBuffers; ++i) {
+            requestPassThroughInput();
+        }
+    } else if (mCodec != NULL) {
         mCodec->signalResume();
     }
 }
 
 void NuPlayer::Decoder::initiateShutdown() {
-    if (mCodec != NULL) {
+    if (mPassThrough) {
+        ++mPassThroughGeneration;
+        mPassThroughFlushPending = false;
+
+        sp<AMessage> codecRequest = new AMessage;
+        codecRequest->setInt32("what", ACodec::kWhatShutdownCompleted);
+        postCodecRequest(codecRequest);
+    } else if (mCodec != NULL) {
         mCodec->initiateShutdown();
     }
 }
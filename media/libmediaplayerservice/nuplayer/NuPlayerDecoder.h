@@ -43,7 +43,13 @@ protected:
 
 private:
     enum {
-        kWhatCodecNotify        = 'cdcN',
+        kWhatCodecNotify         = 'cdcN',
+        kWhatInputBufferFilled   = 'inpF',
+        kWhatOutputBufferDrained = 'outD',
+    };
+
+    enum {
+        kNumPassThroughBuffers = 4,
     };
 
     sp<AMessage> mNotify;
@@ -55,10 +61,28 @@ private:
     Vector<sp<ABuffer> > mCSD;
     size_t mCSDIndex;
 
+    // Raw PCM needs no decoding, it is handed from the source to the
+    // renderer directly, emulating the notifications ACodec would send.
+    bool mPassThrough;
+    bool mPassThroughEOS;
+    int32_t mPassThroughGeneration;
+    // Fill requests NuPlayer hasn't answered yet, it may hold on to them
+    // while the source has no data. A flush only completes once all of them
+    // are back, otherwise they would dequeue post-flush data on behalf of
+    // the old generation, which is then dropped.
+    size_t mPassThroughPendingInputs;
+    bool mPassThroughFlushPending;
+
     sp<AMessage> makeFormat(const sp<MetaData> &meta);
 
     void onFillThisBuffer(const sp<AMessage> &msg);
 
+    void postCodecRequest(const sp<AMessage> &codecRequest);
+    void configurePassThrough(const sp<AMessage> &format);
+    void requestPassThroughInput();
+    void onPassThroughInputFilled(const sp<AMessage> &msg);
+    void completePassThroughFlush();
+
     DISALLOW_EVIL_CONSTRUCTORS(Decoder);
 };
 
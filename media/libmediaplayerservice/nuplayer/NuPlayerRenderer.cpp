@@ -24,6 +24,10 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 
+#include <gui/ISurfaceComposer.h>
+#include <gui/SurfaceComposerClient.h>
+#include <ui/DisplayInfo.h>
+
 namespace android {
 
 // static
@@ -53,7 +57,10 @@ NuPlayer::Renderer::Renderer(
       mVideoRenderingStartGeneration(0),
       mAudioRenderingStartGeneration(0),
       mLastPositionUpdateUs(-1ll),
-      mVideoLateByUs(0ll) {
+      mVideoLateByUs(0ll),
+      mAudioDeepBuffer(false),
+      mVsyncPeriodUs(GetVsyncPeriodUs()),
+      mNumVideoFramesDropped(0) {
 }
 
 NuPlayer::Renderer::~Renderer() {
@@ -125,18 +132,9 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             mDrainAudioQueuePending = false;
 
             if (onDrainAudioQueue()) {
-                uint32_t numFramesPlayed;
-                CHECK_EQ(mAudioSink->getPosition(&numFramesPlayed),
-                         (status_t)OK);
-
-                uint32_t numFramesPendingPlayout =
-                    mNumFramesWritten - numFramesPlayed;
-
                 // This is how long the audio sink will have data to
                 // play back.
-                int64_t delayUs =
-                    mAudioSink->msecsPerFrame()
-                        * numFramesPendingPlayout * 1000ll;
+                int64_t delayUs = getAudioPendingPlayoutUs();
 
                 // Let's give it more data after about half that time
                 // has elapsed.
@@ -181,7 +179,7 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
 
         case kWhatAudioSinkChanged:
         {
-            onAudioSinkChanged();
+            onAudioSinkChanged(msg);
             break;
         }
 
@@ -218,8 +216,19 @@ void NuPlayer::Renderer::postDrainAudioQueue(int64_t delayUs) {
     msg->post(delayUs);
 }
 
-void NuPlayer::Renderer::signalAudioSinkChanged() {
-    (new AMessage(kWhatAudioSinkChanged, id()))->post();
+void NuPlayer::Renderer::signalAudioSinkChanged(bool deepBuffer) {
+    sp<AMessage> msg = new AMessage(kWhatAudioSinkChanged, id());
+    msg->setInt32("deep-buffer", deepBuffer);
+    msg->post();
+}
+
+int64_t NuPlayer::Renderer::getAudioPendingPlayoutUs() {
+    uint32_t numFramesPlayed;
+    CHECK_EQ(mAudioSink->getPosition(&numFramesPlayed), (status_t)OK);
+
+    uint32_t numFramesPendingPlayout = mNumFramesWritten - numFramesPlayed;
+
+    return mAudioSink->msecsPerFrame() * numFramesPendingPlayout * 1000ll;
 }
 
 void NuPlayer::Renderer::prepareForMediaRenderingStart() {
@@ -342,31 +351,25 @@ void NuPlayer::Renderer::postDrainVideoQueue() {
     msg->setInt32("generation", mVideoQueueGeneration);
 
     int64_t delayUs;
+    int64_t realTimeUs;
 
     if (entry.mBuffer == NULL) {
         // EOS doesn't carry a timestamp.
         delayUs = 0;
-    } else if (mFlags & FLAG_REAL_TIME) {
-        int64_t mediaTimeUs;
-        CHECK(entry.mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
-
-        delayUs = mediaTimeUs - ALooper::GetNowUs();
+    } else if (getVideoRealTimeUs(entry.mBuffer, &realTimeUs)) {
+        // The buffer is handed over ahead of time, with its due time, and
+        // the compositor shows it on the first vsync at or after that. Two
+        // vsyncs leave room for the decoder's and the compositor's latency.
+        delayUs = realTimeUs - ALooper::GetNowUs() - 2 * mVsyncPeriodUs;
     } else {
-        int64_t mediaTimeUs;
-        CHECK(entry.mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
-
-        if (mAnchorTimeMediaUs < 0) {
-            delayUs = 0;
+        delayUs = 0;
 
-            if (!mHasAudio) {
-                mAnchorTimeMediaUs = mediaTimeUs;
-                mAnchorTimeRealUs = ALooper::GetNowUs();
-            }
-        } else {
-            int64_t realTimeUs =
-                (mediaTimeUs - mAnchorTimeMediaUs) + mAnchorTimeRealUs;
+        if (!mHasAudio) {
+            int64_t mediaTimeUs;
+            CHECK(entry.mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
 
-            delayUs = realTimeUs - ALooper::GetNowUs();
+            mAnchorTimeMediaUs = mediaTimeUs;
+            mAnchorTimeRealUs = ALooper::GetNowUs();
         }
     }
 
@@ -396,27 +399,41 @@ void NuPlayer::Renderer::onDrainVideoQueue() {
         return;
     }
 
-    int64_t realTimeUs;
-    if (mFlags & FLAG_REAL_TIME) {
-        CHECK(entry->mBuffer->meta()->findInt64("timeUs", &realTimeUs));
-    } else {
-        int64_t mediaTimeUs;
-        CHECK(entry->mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
+    int64_t nowUs = ALooper::GetNowUs();
 
-        realTimeUs = mediaTimeUs - mAnchorTimeMediaUs + mAnchorTimeRealUs;
+    int64_t realTimeUs;
+    bool haveRealTime = getVideoRealTimeUs(entry->mBuffer, &realTimeUs);
+    if (!haveRealTime) {
+        realTimeUs = nowUs;
     }
 
-    mVideoLateByUs = ALooper::GetNowUs() - realTimeUs;
+    mVideoLateByUs = nowUs - realTimeUs;
     bool tooLate = (mVideoLateByUs > 40000);
 
+    // If the decoder has fallen behind to the point where the next frame is
+    // due by the next vsync as well, this one would be replaced before it
+    // is ever shown.
+    List<QueueEntry>::iterator next = mVideoQueue.begin();
+    int64_t nextRealTimeUs;
+    if (!tooLate && haveRealTime && ++next != mVideoQueue.end()
+            && (*next).mBuffer != NULL
+            && getVideoRealTimeUs((*next).mBuffer, &nextRealTimeUs)
+            && nextRealTimeUs <= nowUs + mVsyncPeriodUs) {
+        tooLate = true;
+    }
+
     if (tooLate) {
-        ALOGV("video late by %lld us (%.2f secs)",
-             mVideoLateByUs, mVideoLateByUs / 1E6);
+        ++mNumVideoFramesDropped;
+        ALOGV("dropping video frame late by %lld us (%u dropped)",
+             mVideoLateByUs, mNumVideoFramesDropped);
     } else {
-        ALOGV("rendering video at media time %.2f secs", mediaTimeUs / 1E6);
+        ALOGV("rendering video due in %lld us", -mVideoLateByUs);
     }
 
     entry->mNotifyConsumed->setInt32("render", !tooLate);
+    if (!tooLate && haveRealTime) {
+        entry->mNotifyConsumed->setInt64("timestampNs", realTimeUs * 1000ll);
+    }
     entry->mNotifyConsumed->post();
     mVideoQueue.erase(mVideoQueue.begin());
     entry = NULL;
@@ -431,6 +448,41 @@ void NuPlayer::Renderer::onDrainVideoQueue() {
     notifyPosition();
 }
 
+bool NuPlayer::Renderer::getVideoRealTimeUs(
+        const sp<ABuffer> &buffer, int64_t *realTimeUs) const {
+    int64_t mediaTimeUs;
+    CHECK(buffer->meta()->findInt64("timeUs", &mediaTimeUs));
+
+    if (mFlags & FLAG_REAL_TIME) {
+        *realTimeUs = mediaTimeUs;
+        return true;
+    }
+
+    if (mAnchorTimeMediaUs < 0) {
+        return false;
+    }
+
+    *realTimeUs = (mediaTimeUs - mAnchorTimeMediaUs) + mAnchorTimeRealUs;
+    return true;
+}
+
+// static
+int64_t NuPlayer::Renderer::GetVsyncPeriodUs() {
+    static const int64_t kDefaultVsyncPeriodUs = 16667ll;  // 60 Hz
+
+    sp<IBinder> display = SurfaceComposerClient::getBuiltInDisplay(
+            ISurfaceComposer::eDisplayIdMain);
+
+    DisplayInfo info;
+    if (display == NULL
+            || SurfaceComposerClient::getDisplayInfo(display, &info) != OK
+            || info.fps <= 0.0f) {
+        return kDefaultVsyncPeriodUs;
+    }
+
+    return (int64_t)(1E6 / info.fps);
+}
+
 void NuPlayer::Renderer::notifyVideoRenderingStart() {
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", kWhatVideoRenderingStart);
@@ -473,7 +525,23 @@ void NuPlayer::Renderer::onQueueBuffer(const sp<AMessage> &msg) {
 
     if (audio) {
         mAudioQueue.push_back(entry);
-        postDrainAudioQueue();
+
+        int64_t delayUs = 0;
+        if (mAudioDeepBuffer && !mDrainAudioQueuePending
+                && !mSyncQueues && !mPaused) {
+            // Collect what the decoder produces and top the sink up once
+            // half of it has played out, instead of waking up for every
+            // buffer. A sink that is running low is fed right away.
+            int64_t sinkSizeUs =
+                mAudioSink->msecsPerFrame() * mAudioSink->frameCount()
+                    * 1000ll;
+
+            delayUs = getAudioPendingPlayoutUs() - sinkSizeUs / 2;
+            if (delayUs < 0) {
+                delayUs = 0;
+            }
+        }
+        postDrainAudioQueue(delayUs);
     } else {
         mVideoQueue.push_back(entry);
         postDrainVideoQueue();
@@ -646,8 +714,13 @@ bool NuPlayer::Renderer::dropBufferWhileFlushing(
     return true;
 }
 
-void NuPlayer::Renderer::onAudioSinkChanged() {
+void NuPlayer::Renderer::onAudioSinkChanged(const sp<AMessage> &msg) {
     CHECK(!mDrainAudioQueuePending);
+
+    int32_t deepBuffer;
+    CHECK(msg->findInt32("deep-buffer", &deepBuffer));
+    mAudioDeepBuffer = deepBuffer;
+
     mNumFramesWritten = 0;
     uint32_t written;
     if (mAudioSink->getFramesWritten(&written) == OK) {
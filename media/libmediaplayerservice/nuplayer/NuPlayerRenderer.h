@@ -43,7 +43,10 @@ struct NuPlayer::Renderer : public AHandler {
 
     void signalTimeDiscontinuity();
 
-    void signalAudioSinkChanged();
+    // "deepBuffer" if the sink was opened on the deep buffer output, the
+    // audio queue is then drained in large batches as the sink runs low
+    // instead of whenever there is data and room for it.
+    void signalAudioSinkChanged(bool deepBuffer = false);
 
     void pause();
     void resume();
@@ -113,19 +116,33 @@ private:
     int64_t mLastPositionUpdateUs;
     int64_t mVideoLateByUs;
 
+    bool mAudioDeepBuffer;
+
+    // Refresh period of the main display.
+    int64_t mVsyncPeriodUs;
+    uint32_t mNumVideoFramesDropped;
+
     bool onDrainAudioQueue();
     void postDrainAudioQueue(int64_t delayUs = 0);
 
     void onDrainVideoQueue();
     void postDrainVideoQueue();
 
+    // The system time at which the video buffer is due, false if there is
+    // no anchor to map its media time with yet.
+    bool getVideoRealTimeUs(
+            const sp<ABuffer> &buffer, int64_t *realTimeUs) const;
+
+    static int64_t GetVsyncPeriodUs();
+
     void prepareForMediaRenderingStart();
     void notifyIfMediaRenderingStarted();
 
     void onQueueBuffer(const sp<AMessage> &msg);
     void onQueueEOS(const sp<AMessage> &msg);
     void onFlush(const sp<AMessage> &msg);
-    void onAudioSinkChanged();
+    void onAudioSinkChanged(const sp<AMessage> &msg);
+    int64_t getAudioPendingPlayoutUs();
     void onPause();
     void onResume();
 
@@ -25,7 +25,9 @@ namespace android {
 
 MonoPipeReader::MonoPipeReader(MonoPipe* pipe) :
         NBAIO_Source(pipe->mFormat),
-        mPipe(pipe)
+        mPipe(pipe),
+        mTimestampValid(false)
+        // mTimestamp
 {
 }
 
@@ -88,7 +90,21 @@ ssize_t MonoPipeReader::read(void *buffer, size_t count, int64_t readPTS)
 
 void MonoPipeReader::onTimestamp(const AudioTimestamp& timestamp)
 {
+    // The consumer's frame positions are in the units of frames read from this pipe.
+    // Keep a copy for getTimestamp() on this side, and forward to the writer's side,
+    // where MonoPipe::getTimestamp() lets the writer compare with its framesWritten().
+    mTimestamp = timestamp;
+    mTimestampValid = true;
     mPipe->mTimestampMutator.push(timestamp);
 }
 
+status_t MonoPipeReader::getTimestamp(AudioTimestamp& timestamp)
+{
+    if (!mTimestampValid) {
+        return INVALID_OPERATION;
+    }
+    timestamp = mTimestamp;
+    return NO_ERROR;
+}
+
 }   // namespace android
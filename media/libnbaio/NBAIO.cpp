@@ -138,6 +138,16 @@ NBAIO_Format Format_from_SR_C(unsigned sampleRate, unsigned channelCount)
 }
 
 // This is a default implementation; it is expected that subclasses will optimize this.
+status_t NBAIO_Sink::getStats(NBAIO_Stats& stats)
+{
+    stats.mFrames = framesWritten();
+    stats.mFramesLost = framesUnderrun();
+    stats.mLosses = underruns();
+    stats.mLag = 0;
+    stats.mMaxLag = 0;
+    return NO_ERROR;
+}
+
 ssize_t NBAIO_Sink::writeVia(writeVia_t via, size_t total, void *user, size_t block)
 {
     if (!mNegotiated) {
@@ -174,6 +184,16 @@ ssize_t NBAIO_Sink::writeVia(writeVia_t via, size_t total, void *user, size_t bl
 }
 
 // This is a default implementation; it is expected that subclasses will optimize this.
+status_t NBAIO_Source::getStats(NBAIO_Stats& stats)
+{
+    stats.mFrames = framesRead();
+    stats.mFramesLost = framesOverrun();
+    stats.mLosses = overruns();
+    stats.mLag = 0;
+    stats.mMaxLag = 0;
+    return NO_ERROR;
+}
+
 ssize_t NBAIO_Source::readVia(readVia_t via, size_t total, void *user,
                               int64_t readPTS, size_t block)
 {
@@ -29,19 +29,199 @@
 
 namespace android {
 
-int NBLog::Entry::readAt(size_t offset) const
+// Type of the argument consumed by one printf conversion, as stored in an EVENT_FORMAT
+enum ArgType {
+    ARG_NONE,           // "%%", consumes no argument
+    ARG_INT,            // int or anything promoted to int, stored as 4 bytes
+    ARG_LONG,           // long or ptrdiff_t, stored sign-extended as 8 bytes
+    ARG_ULONG,          // unsigned long or size_t, stored zero-extended as 8 bytes
+    ARG_INT64,          // long long or intmax_t, stored as 8 bytes
+    ARG_DOUBLE,         // double or float promoted to double, stored as 8 bytes
+    ARG_POINTER,        // void *, stored as 8 bytes
+    ARG_STRING,         // const char *, stored as length byte and characters
+    ARG_UNSUPPORTED,    // can't be logged in binary
+};
+
+// Scan from p to the next printf conversion.  Returns NULL if there are no more conversions,
+// otherwise sets *start to the '%', *type to the argument type, and returns a pointer past the
+// conversion.  If spec is non-NULL, it receives a NUL-terminated copy of the conversion
+// with the length modifier normalized to match the stored size of the argument.
+static const char *scanConversion(const char *p, const char **start, ArgType *type,
+        char *spec = NULL, size_t specSize = 0)
 {
-    // FIXME This is too slow, despite the name it is used during writing
-    if (offset == 0)
-        return mEvent;
-    else if (offset == 1)
-        return mLength;
-    else if (offset < (size_t) (mLength + 2))
-        return ((char *) mData)[offset - 2];
-    else if (offset == (size_t) (mLength + 2))
-        return mLength;
-    else
-        return 0;
+    while (*p != '%') {
+        if (*p == '\0') {
+            return NULL;
+        }
+        ++p;
+    }
+    *start = p++;
+    if (*p == '%') {
+        *type = ARG_NONE;
+        return p + 1;
+    }
+    const char *flags = p;
+    while (*p != '\0' && strchr("-+ #0", *p) != NULL) {
+        ++p;
+    }
+    while (*p >= '0' && *p <= '9') {
+        ++p;
+    }
+    if (*p == '.') {
+        ++p;
+        while (*p >= '0' && *p <= '9') {
+            ++p;
+        }
+    }
+    const char *flagsEnd = p;
+    unsigned longs = 0;
+    bool longDouble = false;
+    for (;; ++p) {
+        switch (*p) {
+        case 'h':
+            continue;
+        case 'l':
+            ++longs;
+            continue;
+        case 'z':
+        case 't':
+            if (longs < 1) {
+                longs = 1;
+            }
+            continue;
+        case 'L':
+            longDouble = true;
+            // fall through
+        case 'j':
+        case 'q':
+            longs = 2;
+            continue;
+        default:
+            break;
+        }
+        break;
+    }
+    switch (*p) {
+    case 'd': case 'i':
+        *type = longs == 0 ? ARG_INT : longs == 1 ? ARG_LONG : ARG_INT64;
+        break;
+    case 'o': case 'u': case 'x': case 'X':
+        *type = longs == 0 ? ARG_INT : longs == 1 ? ARG_ULONG : ARG_INT64;
+        break;
+    case 'c':
+        *type = longs > 0 ? ARG_UNSUPPORTED : ARG_INT;
+        break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        *type = longDouble ? ARG_UNSUPPORTED : ARG_DOUBLE;
+        break;
+    case 's':
+        *type = longs > 0 ? ARG_UNSUPPORTED : ARG_STRING;
+        break;
+    case 'p':
+        *type = ARG_POINTER;
+        break;
+    default:
+        // includes %n, '*' width or precision, and the terminating NUL
+        *type = ARG_UNSUPPORTED;
+        return *p != '\0' ? p + 1 : p;
+    }
+    if (spec != NULL) {
+        // '%' + flags, width, and precision + optional "ll" + conversion + NUL
+        size_t flagsLength = flagsEnd - flags;
+        if (flagsLength + 5 > specSize) {
+            *type = ARG_UNSUPPORTED;
+            return p + 1;
+        }
+        char *q = spec;
+        *q++ = '%';
+        memcpy(q, flags, flagsLength);
+        q += flagsLength;
+        if (*type == ARG_LONG || *type == ARG_ULONG || *type == ARG_INT64) {
+            *q++ = 'l';
+            *q++ = 'l';
+        }
+        *q++ = *p;
+        *q = '\0';
+    }
+    return p + 1;
+}
+
+// Format the arguments of an EVENT_FORMAT according to fmt, appending to result.
+// Returns false if the arguments are inconsistent with the format.
+static bool decodeFormat(const char *fmt, const uint8_t *args, size_t length, String8& result)
+{
+    size_t offset = 0;
+    const char *p = fmt;
+    for (;;) {
+        const char *start;
+        ArgType type;
+        char spec[16];
+        const char *next = scanConversion(p, &start, &type, spec, sizeof(spec));
+        if (next == NULL) {
+            result.append(p);
+            break;
+        }
+        result.append(p, start - p);
+        p = next;
+        switch (type) {
+        case ARG_NONE:
+            result.append("%");
+            break;
+        case ARG_INT: {
+            int32_t i;
+            if (offset + sizeof(i) > length) {
+                return false;
+            }
+            memcpy(&i, &args[offset], sizeof(i));
+            offset += sizeof(i);
+            result.appendFormat(spec, i);
+            } break;
+        case ARG_LONG:
+        case ARG_ULONG:
+        case ARG_INT64: {
+            int64_t ll;
+            if (offset + sizeof(ll) > length) {
+                return false;
+            }
+            memcpy(&ll, &args[offset], sizeof(ll));
+            offset += sizeof(ll);
+            result.appendFormat(spec, (long long) ll);
+            } break;
+        case ARG_DOUBLE: {
+            double d;
+            if (offset + sizeof(d) > length) {
+                return false;
+            }
+            memcpy(&d, &args[offset], sizeof(d));
+            offset += sizeof(d);
+            result.appendFormat(spec, d);
+            } break;
+        case ARG_POINTER: {
+            uint64_t ptr;
+            if (offset + sizeof(ptr) > length) {
+                return false;
+            }
+            memcpy(&ptr, &args[offset], sizeof(ptr));
+            offset += sizeof(ptr);
+            result.appendFormat(spec, (void *) (uintptr_t) ptr);
+            } break;
+        case ARG_STRING: {
+            if (offset + 1 > length || offset + 1 + args[offset] > length) {
+                return false;
+            }
+            char string[256];
+            size_t stringLength = args[offset++];
+            memcpy(string, &args[offset], stringLength);
+            string[stringLength] = '\0';
+            offset += stringLength;
+            result.appendFormat(spec, string);
+            } break;
+        case ARG_UNSUPPORTED:
+        default:
+            return false;
+        }
+    }
+    return offset == length;
 }
 
 // ---------------------------------------------------------------------------
@@ -72,21 +252,27 @@ size_t NBLog::Timeline::sharedSize(size_t size)
 // ---------------------------------------------------------------------------
 
 NBLog::Writer::Writer()
-    : mSize(0), mShared(NULL), mRear(0), mEnabled(false)
+    : mSize(0), mShared(NULL), mRear(0), mEnabled(false), mFormats(NULL)
 {
 }
 
 NBLog::Writer::Writer(size_t size, void *shared)
-    : mSize(roundup(size)), mShared((Shared *) shared), mRear(0), mEnabled(mShared != NULL)
+    : mSize(roundup(size)), mShared((Shared *) shared), mRear(0), mEnabled(mShared != NULL),
+      mFormats(NULL)
 {
 }
 
 NBLog::Writer::Writer(size_t size, const sp<IMemory>& iMemory)
     : mSize(roundup(size)), mShared(iMemory != 0 ? (Shared *) iMemory->pointer() : NULL),
-      mIMemory(iMemory), mRear(0), mEnabled(mShared != NULL)
+      mIMemory(iMemory), mRear(0), mEnabled(mShared != NULL), mFormats(NULL)
 {
 }
 
+NBLog::Writer::~Writer()
+{
+    delete[] mFormats;
+}
+
 void NBLog::Writer::log(const char *string)
 {
     if (!mEnabled) {
@@ -115,6 +301,16 @@ void NBLog::Writer::logvf(const char *fmt, va_list ap)
     if (!mEnabled) {
         return;
     }
+    if (mFormats != NULL) {
+        // logBinary() may consume some of the arguments before giving up
+        va_list apCopy;
+        va_copy(apCopy, ap);
+        bool logged = logBinary(fmt, apCopy);
+        va_end(apCopy);
+        if (logged) {
+            return;
+        }
+    }
     char buffer[256];
     int length = vsnprintf(buffer, sizeof(buffer), fmt, ap);
     if (length >= (int) sizeof(buffer)) {
@@ -127,6 +323,129 @@ void NBLog::Writer::logvf(const char *fmt, va_list ap)
     }
 }
 
+bool NBLog::Writer::logBinary(const char *fmt, va_list ap)
+{
+    // find the format by address, adding it if it has not been seen before
+    size_t id = ((uintptr_t) fmt >> 2) & (kMaxFormats - 1);
+    Format *format;
+    for (size_t probe = 0; ; ++probe) {
+        if (probe == kMaxFormats) {
+            // table is full
+            return false;
+        }
+        format = &mFormats[id];
+        if (format->mFmt == fmt) {
+            break;
+        }
+        if (format->mFmt == NULL) {
+            format->mFmt = fmt;
+            format->mDefined = false;
+            format->mBinary = strlen(fmt) <= kMaxLength - sizeof(uint16_t);
+            format->mNumArgs = 0;
+            const char *p = fmt;
+            const char *start;
+            ArgType type;
+            while (format->mBinary && (p = scanConversion(p, &start, &type)) != NULL) {
+                if (type == ARG_NONE) {
+                    continue;
+                }
+                if (type == ARG_UNSUPPORTED || format->mNumArgs >= kMaxArgs) {
+                    format->mBinary = false;
+                    break;
+                }
+                format->mArgTypes[format->mNumArgs++] = type;
+            }
+            break;
+        }
+        id = (id + 1) & (kMaxFormats - 1);
+    }
+    if (!format->mBinary) {
+        return false;
+    }
+
+    uint8_t data[kMaxLength];
+    uint16_t id16 = id;
+    memcpy(data, &id16, sizeof(id16));
+    size_t length = sizeof(id16);
+    for (size_t i = 0; i < format->mNumArgs; ++i) {
+        switch (format->mArgTypes[i]) {
+        case ARG_INT: {
+            int32_t i32 = va_arg(ap, int);
+            if (length + sizeof(i32) > kMaxLength) {
+                return false;
+            }
+            memcpy(&data[length], &i32, sizeof(i32));
+            length += sizeof(i32);
+            } break;
+        case ARG_LONG:
+        case ARG_ULONG:
+        case ARG_INT64: {
+            // widened so that the "ll" used by the decoder is correct for any writer ABI
+            int64_t i64;
+            switch (format->mArgTypes[i]) {
+            case ARG_LONG:
+                i64 = va_arg(ap, long);
+                break;
+            case ARG_ULONG:
+                i64 = va_arg(ap, unsigned long);
+                break;
+            default:
+                i64 = va_arg(ap, long long);
+                break;
+            }
+            if (length + sizeof(i64) > kMaxLength) {
+                return false;
+            }
+            memcpy(&data[length], &i64, sizeof(i64));
+            length += sizeof(i64);
+            } break;
+        case ARG_DOUBLE: {
+            double d = va_arg(ap, double);
+            if (length + sizeof(d) > kMaxLength) {
+                return false;
+            }
+            memcpy(&data[length], &d, sizeof(d));
+            length += sizeof(d);
+            } break;
+        case ARG_POINTER: {
+            uint64_t ptr = (uintptr_t) va_arg(ap, void *);
+            if (length + sizeof(ptr) > kMaxLength) {
+                return false;
+            }
+            memcpy(&data[length], &ptr, sizeof(ptr));
+            length += sizeof(ptr);
+            } break;
+        case ARG_STRING: {
+            const char *string = va_arg(ap, const char *);
+            if (string == NULL) {
+                string = "(null)";
+            }
+            size_t stringLength = strnlen(string, kMaxLength);
+            if (length + 1 + stringLength > kMaxLength) {
+                return false;
+            }
+            data[length++] = stringLength;
+            memcpy(&data[length], string, stringLength);
+            length += stringLength;
+            } break;
+        }
+    }
+
+    // Log the definition before its first use, and again once it is half a buffer old,
+    // so that a Reader which dumps only occasionally still sees it before it is overwritten.
+    if (!format->mDefined || (size_t) (mRear - format->mDefRear) > (mSize >> 1)) {
+        uint8_t def[kMaxLength];
+        size_t fmtLength = strlen(fmt);
+        memcpy(def, &id16, sizeof(id16));
+        memcpy(&def[sizeof(id16)], fmt, fmtLength);
+        format->mDefRear = mRear;
+        format->mDefined = true;
+        log(EVENT_FORMAT_DEF, def, sizeof(id16) + fmtLength);
+    }
+    log(EVENT_FORMAT, data, length);
+    return true;
+}
+
 void NBLog::Writer::logTimestamp()
 {
     if (!mEnabled) {
@@ -157,6 +476,8 @@ void NBLog::Writer::log(Event event, const void *data, size_t length)
     switch (event) {
     case EVENT_STRING:
     case EVENT_TIMESTAMP:
+    case EVENT_FORMAT_DEF:
+    case EVENT_FORMAT:
         break;
     case EVENT_RESERVED:
     default:
@@ -175,26 +496,28 @@ void NBLog::Writer::log(const NBLog::Entry *entry, bool trusted)
         log(entry->mEvent, entry->mData, entry->mLength);
         return;
     }
-    size_t rear = mRear & (mSize - 1);
-    size_t written = mSize - rear;      // written = number of bytes that have been written so far
-    size_t need = entry->mLength + 3;   // mEvent, mLength, data[length], mLength
-                                        // need = number of bytes remaining to write
-    if (written > need) {
-        written = need;
-    }
-    size_t i;
-    // FIXME optimize this using memcpy for the data part of the Entry.
-    // The Entry could have a method copyTo(ptr, offset, size) to optimize the copy.
-    for (i = 0; i < written; ++i) {
-        mShared->mBuffer[rear + i] = entry->readAt(i);
-    }
-    if (rear + written == mSize && (need -= written) > 0)  {
-        for (i = 0; i < need; ++i) {
-            mShared->mBuffer[i] = entry->readAt(written + i);
-        }
-        written += need;
+    uint8_t header[2];                  // mEvent, mLength
+    header[0] = entry->mEvent;
+    header[1] = entry->mLength;
+    size_t rear = copyIn(mRear, header, sizeof(header));
+    rear = copyIn(rear, entry->mData, entry->mLength);
+    // duplicate copy of mLength to permit reverse scan
+    rear = copyIn(rear, &header[1], 1);
+    android_atomic_release_store(mRear = rear, &mShared->mRear);
+}
+
+size_t NBLog::Writer::copyIn(size_t rear, const void *data, size_t length)
+{
+    size_t offset = rear & (mSize - 1);
+    size_t part1 = mSize - offset;      // part1 = number of bytes until the wraparound point
+    if (part1 > length) {
+        part1 = length;
     }
-    android_atomic_release_store(mRear += written, &mShared->mRear);
+    memcpy(&mShared->mBuffer[offset], data, part1);
+    if (part1 < length) {
+        memcpy(mShared->mBuffer, (const uint8_t *) data + part1, length - part1);
+    }
+    return rear + length;
 }
 
 bool NBLog::Writer::isEnabled() const
@@ -209,6 +532,19 @@ bool NBLog::Writer::setEnabled(bool enabled)
     return old;
 }
 
+bool NBLog::Writer::setBinary(bool binary)
+{
+    bool old = mFormats != NULL;
+    if (binary && mFormats == NULL) {
+        mFormats = new Format[kMaxFormats];
+        memset(mFormats, 0, kMaxFormats * sizeof(Format));
+    } else if (!binary && mFormats != NULL) {
+        delete[] mFormats;
+        mFormats = NULL;
+    }
+    return old;
+}
+
 // ---------------------------------------------------------------------------
 
 NBLog::LockedWriter::LockedWriter()
@@ -269,16 +605,22 @@ bool NBLog::LockedWriter::setEnabled(bool enabled)
     return Writer::setEnabled(enabled);
 }
 
+bool NBLog::LockedWriter::setBinary(bool binary)
+{
+    Mutex::Autolock _l(mLock);
+    return Writer::setBinary(binary);
+}
+
 // ---------------------------------------------------------------------------
 
 NBLog::Reader::Reader(size_t size, const void *shared)
-    : mSize(roundup(size)), mShared((const Shared *) shared), mFront(0)
+    : mSize(roundup(size)), mShared((const Shared *) shared), mFront(0), mDrainFront(0)
 {
 }
 
 NBLog::Reader::Reader(size_t size, const sp<IMemory>& iMemory)
     : mSize(roundup(size)), mShared(iMemory != 0 ? (const Shared *) iMemory->pointer() : NULL),
-      mIMemory(iMemory), mFront(0)
+      mIMemory(iMemory), mFront(0), mDrainFront(0)
 {
 }
 
@@ -424,6 +766,36 @@ void NBLog::Reader::dump(int fd, size_t indent)
                         (int) (ts.tv_nsec / 1000000));
             }
             } break;
+        case EVENT_FORMAT_DEF: {
+            uint16_t id;
+            if (length < sizeof(id)) {
+                break;
+            }
+            memcpy(&id, data, sizeof(id));
+            mFormats.replaceValueFor(id, String8((const char *) data + sizeof(id),
+                    length - sizeof(id)));
+            } break;
+        case EVENT_FORMAT: {
+            uint16_t id = 0;
+            if (length >= sizeof(id)) {
+                memcpy(&id, data, sizeof(id));
+            }
+            String8 string;
+            ssize_t index = mFormats.indexOfKey(id);
+            if (length < sizeof(id) || index < 0 || !decodeFormat(mFormats.valueAt(index).string(),
+                    (const uint8_t *) data + sizeof(id), length - sizeof(id), string)) {
+                // leave the raw arguments for an offline decoder
+                string = String8::format("format %u:", id);
+                for (size_t k = sizeof(id); k < length; ++k) {
+                    string.appendFormat(" %02x", ((const uint8_t *) data)[k]);
+                }
+            }
+            if (fd >= 0) {
+                fdprintf(fd, "%*s%s%s\n", indent, "", prefix, string.string());
+            } else {
+                ALOGI("%*s%s%s", indent, "", prefix, string.string());
+            }
+            } break;
         case EVENT_RESERVED:
         default:
             if (fd >= 0) {
@@ -439,6 +811,48 @@ void NBLog::Reader::dump(int fd, size_t indent)
     delete[] copy;
 }
 
+size_t NBLog::Reader::drain(void *buffer, size_t size, uint32_t *position, size_t *lost)
+{
+    int32_t rear = android_atomic_acquire_load(&mShared->mRear);
+    size_t avail = rear - mDrainFront;
+    *lost = 0;
+    if (avail > mSize) {
+        *lost = avail - mSize;
+        mDrainFront += *lost;
+        avail = mSize;
+    }
+    if (avail > size) {
+        // the rest will be drained next time
+        avail = size;
+    }
+    size_t front = mDrainFront & (mSize - 1);
+    size_t part1 = mSize - front;
+    if (part1 > avail) {
+        part1 = avail;
+    }
+    memcpy(buffer, &mShared->mBuffer[front], part1);
+    if (part1 < avail) {
+        memcpy((uint8_t *) buffer + part1, mShared->mBuffer, avail - part1);
+    }
+    // Unlike dump(), check whether the writer overwrote the beginning of the copy while it
+    // was being made, because a drained stream is meant to be trusted offline.
+    rear = android_atomic_acquire_load(&mShared->mRear);
+    size_t overwritten = rear - mDrainFront;
+    if (overwritten > mSize) {
+        overwritten -= mSize;
+        if (overwritten > avail) {
+            overwritten = avail;
+        }
+        memmove(buffer, (uint8_t *) buffer + overwritten, avail - overwritten);
+        *lost += overwritten;
+        mDrainFront += overwritten;
+        avail -= overwritten;
+    }
+    *position = mDrainFront;
+    mDrainFront += avail;
+    return avail;
+}
+
 bool NBLog::Reader::isIMemory(const sp<IMemory>& iMemory) const
 {
     return iMemory.get() == mIMemory.get();
@@ -30,7 +30,10 @@ Pipe::Pipe(size_t maxFrames, NBAIO_Format format) :
         mMaxFrames(roundup(maxFrames)),
         mBuffer(malloc(mMaxFrames * Format_frameSize(format))),
         mRear(0),
-        mReaders(0)
+        mReaders(0),
+        mReaderFramesOverrun(0),
+        mReaderOverruns(0),
+        mReaderMaxLag(0)
 {
 }
 
@@ -67,4 +70,14 @@ ssize_t Pipe::write(const void *buffer, size_t count)
     return written;
 }
 
+status_t Pipe::getStats(NBAIO_Stats& stats)
+{
+    stats.mFrames = mFramesWritten;
+    stats.mFramesLost = (size_t) android_atomic_acquire_load(&mReaderFramesOverrun);
+    stats.mLosses = (size_t) android_atomic_acquire_load(&mReaderOverruns);
+    stats.mLag = 0;
+    stats.mMaxLag = (size_t) android_atomic_acquire_load(&mReaderMaxLag);
+    return NO_ERROR;
+}
+
 }   // namespace android
@@ -17,6 +17,8 @@
 #define LOG_TAG "PipeReader"
 //#define LOG_NDEBUG 0
 
+#include <time.h>
+#include <cutils/atomic.h>
 #include <cutils/compiler.h>
 #include <utils/Log.h>
 #include <media/nbaio/PipeReader.h>
@@ -29,7 +31,9 @@ PipeReader::PipeReader(Pipe& pipe) :
         // any data already in the pipe is not visible to this PipeReader
         mFront(android_atomic_acquire_load(&pipe.mRear)),
         mFramesOverrun(0),
-        mOverruns(0)
+        mOverruns(0),
+        mLag(0),
+        mMaxLag(0)
 {
     android_atomic_inc(&pipe.mReaders);
 }
@@ -54,11 +58,61 @@ ssize_t PipeReader::availableToRead()
         mFront = rear - mPipe.mMaxFrames + (mPipe.mMaxFrames >> 4);
         mFramesOverrun += (size_t) (mFront - oldFront);
         ++mOverruns;
+        // so that whoever monitors the Pipe sees the overrun, not only this reader
+        android_atomic_add(mFront - oldFront, &mPipe.mReaderFramesOverrun);
+        android_atomic_inc(&mPipe.mReaderOverruns);
+        updateLag(avail);
         return OVERRUN;
     }
+    updateLag(avail);
     return avail;
 }
 
+void PipeReader::updateLag(size_t lag)
+{
+    mLag = lag;
+    if (CC_UNLIKELY(lag > mMaxLag)) {
+        mMaxLag = lag;
+        int32_t pipeMaxLag;
+        do {
+            pipeMaxLag = android_atomic_acquire_load(&mPipe.mReaderMaxLag);
+        } while ((int32_t) lag > pipeMaxLag &&
+                android_atomic_cmpxchg(pipeMaxLag, (int32_t) lag, &mPipe.mReaderMaxLag) != 0);
+    }
+}
+
+status_t PipeReader::getStats(NBAIO_Stats& stats)
+{
+    stats.mFrames = mFramesRead;
+    stats.mFramesLost = mFramesOverrun;
+    stats.mLosses = mOverruns;
+    stats.mLag = mLag;
+    stats.mMaxLag = mMaxLag;
+    return NO_ERROR;
+}
+
+ssize_t PipeReader::readBlocking(void *buffer, size_t count, int64_t readPTS, int64_t timeoutNs)
+{
+    uint32_t sampleRate = Format_sampleRate(mFormat);
+    for (;;) {
+        ssize_t avail = availableToRead();
+        if (avail < 0 || (size_t) avail >= count || timeoutNs <= 0 || sampleRate == 0) {
+            break;
+        }
+        // time for the writer to provide the missing frames at the nominal rate
+        int64_t sleepNs = ((int64_t) (count - avail) * 1000000000LL) / sampleRate;
+        if (sleepNs > timeoutNs) {
+            sleepNs = timeoutNs;
+        }
+        timeoutNs -= sleepNs;
+        struct timespec req;
+        req.tv_sec = sleepNs / 1000000000LL;
+        req.tv_nsec = sleepNs % 1000000000LL;
+        nanosleep(&req, NULL);
+    }
+    return read(buffer, count, readPTS);
+}
+
 ssize_t PipeReader::read(void *buffer, size_t count, int64_t readPTS)
 {
     ssize_t avail = availableToRead();
@@ -89,6 +143,7 @@ ssize_t PipeReader::read(void *buffer, size_t count, int64_t readPTS)
     }
     mFront += red;
     mFramesRead += red;
+    mLag = avail - red;
     return red;
 }
 
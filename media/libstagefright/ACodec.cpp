@@ -361,6 +361,7 @@ private:
 ACodec::ACodec()
     : mQuirks(0),
       mNode(NULL),
+      mOMXLivesLocally(false),
       mSentFormat(false),
       mIsEncoder(false),
       mUseMetadataOnEncoderOutput(false),
@@ -373,6 +374,7 @@ ACodec::ACodec()
       mStoreMetaDataInOutputBuffers(false),
       mMetaDataBuffersToSubmit(0),
       mRepeatFrameDelayUs(-1ll),
+      mMaxFps(-1),
       mInSmoothStreamingMode(false) {
     mUninitializedState = new UninitializedState(this);
     mLoadedState = new LoadedState(this);
@@ -510,6 +512,22 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
                             (4 + sizeof(buffer_handle_t)) : def.nBufferSize;
 
                     info.mData = new ABuffer(ptr, bufSize);
+                } else if ((mQuirks & requiresAllocateBufferBit)
+                        && mOMXLivesLocally
+                        && !(portIndex == kPortIndexOutput
+                            && (mQuirks
+                                & OMXCodec::kDefersOutputBufferAllocation))) {
+                    // The component's own buffers are addressable from
+                    // this process, use them directly instead of copying
+                    // every buffer to and from a backup in shared memory.
+                    mem.clear();
+
+                    void *ptr;
+                    err = mOMX->allocateBuffer(
+                            mNode, portIndex, def.nBufferSize, &info.mBufferID,
+                            &ptr);
+
+                    info.mData = new ABuffer(ptr, def.nBufferSize);
                 } else if (mQuirks & requiresAllocateBufferBit) {
                     err = mOMX->allocateBufferWithBackup(
                             mNode, portIndex, mem, &info.mBufferID);
@@ -1103,6 +1121,10 @@ status_t ACodec::configureCodec(
                     &mRepeatFrameDelayUs)) {
             mRepeatFrameDelayUs = -1ll;
         }
+
+        if (!msg->findFloat("max-fps-to-encoder", &mMaxFps)) {
+            mMaxFps = -1;
+        }
     }
 
     // Always try to enable dynamic output buffers on native surface
@@ -1307,6 +1329,20 @@ status_t ACodec::configureCodec(
         err = setMinBufferSize(kPortIndexInput, 8192);  // XXX
     }
 
+    if (err != OK) {
+        return err;
+    }
+
+    // Clients with deep buffering can ask for larger output buffers, which
+    // the software audio decoders then fill with several frames.
+    int32_t maxOutputSize;
+    if (!encoder && !video && msg->findInt32("max-output-size", &maxOutputSize)) {
+        if (setMinBufferSize(kPortIndexOutput, (size_t)maxOutputSize) != OK) {
+            ALOGW("[%s] does not accept %d byte output buffers",
+                  mComponentName.c_str(), maxOutputSize);
+        }
+    }
+
     return err;
 }
 
@@ -2233,7 +2269,13 @@ status_t ACodec::setupAVCEncoderParameters(const sp<AMessage> &msg) {
     }
 
     if (h264type.eProfile == OMX_VIDEO_AVCProfileBaseline) {
-        h264type.nSliceHeaderSpacing = 0;
+        // In macroblocks, 0 for one slice per frame.
+        int32_t sliceHeaderSpacing;
+        if (!msg->findInt32("slice-header-spacing", &sliceHeaderSpacing)
+                || sliceHeaderSpacing < 0) {
+            sliceHeaderSpacing = 0;
+        }
+        h264type.nSliceHeaderSpacing = sliceHeaderSpacing;
         h264type.bUseHadamard = OMX_TRUE;
         h264type.nRefFrames = 1;
         h264type.nBFrames = 0;
@@ -3457,6 +3499,15 @@ void ACodec::BaseState::onOutputBufferDrained(const sp<AMessage> &msg) {
             && (info->mData == NULL || info->mData->size() != 0)) {
         // The client wants this buffer to be rendered.
 
+        // At the time it asks for if any, the compositor then latches the
+        // buffer on the first vsync at or after it.
+        int64_t timestampNs;
+        if (!msg->findInt64("timestampNs", &timestampNs)) {
+            timestampNs = NATIVE_WINDOW_TIMESTAMP_AUTO;
+        }
+        native_window_set_buffers_timestamp(
+                mCodec->mNativeWindow.get(), timestampNs);
+
         status_t err;
         if ((err = mCodec->mNativeWindow->queueBuffer(
                     mCodec->mNativeWindow.get(),
@@ -3700,6 +3751,7 @@ bool ACodec::UninitializedState::onAllocateComponent(const sp<AMessage> &msg) {
     mCodec->mQuirks = quirks;
     mCodec->mOMX = omx;
     mCodec->mNode = node;
+    mCodec->mOMXLivesLocally = omx->livesLocally(node, getpid());
 
     {
         sp<AMessage> notify = mCodec->mNotify->dup();
@@ -3730,6 +3782,7 @@ void ACodec::LoadedState::stateEntered() {
     mCodec->mDequeueCounter = 0;
     mCodec->mMetaDataBuffersToSubmit = 0;
     mCodec->mRepeatFrameDelayUs = -1ll;
+    mCodec->mMaxFps = -1;
 
     if (mCodec->mShutdownInProgress) {
         bool keepComponentAllocated = mCodec->mKeepComponentAllocated;
@@ -3827,16 +3880,22 @@ bool ACodec::LoadedState::onConfigureComponent(
     }
 
     sp<RefBase> obj;
-    if (msg->findObject("native-window", &obj)
-            && strncmp("OMX.google.", mCodec->mComponentName.c_str(), 11)) {
+    if (msg->findObject("native-window", &obj)) {
         sp<NativeWindowWrapper> nativeWindow(
                 static_cast<NativeWindowWrapper *>(obj.get()));
         CHECK(nativeWindow != NULL);
         mCodec->mNativeWindow = nativeWindow->getNativeWindow();
 
-        native_window_set_scaling_mode(
-                mCodec->mNativeWindow.get(),
-                NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW);
+        // Software components only decode into the window if they support
+        // native buffers, otherwise MediaCodec renders their output.
+        if (!strncmp("OMX.google.", mCodec->mComponentName.c_str(), 11)
+                && mCodec->initNativeWindow() != OK) {
+            mCodec->mNativeWindow.clear();
+        } else {
+            native_window_set_scaling_mode(
+                    mCodec->mNativeWindow.get(),
+                    NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW);
+        }
     }
     CHECK_EQ((status_t)OK, mCodec->initNativeWindow());
 
@@ -3878,6 +3937,21 @@ void ACodec::LoadedState::onCreateInputSurface(
         }
     }
 
+    if (err == OK && mCodec->mMaxFps > 0) {
+        err = mCodec->mOMX->setInternalOption(
+                mCodec->mNode,
+                kPortIndexInput,
+                IOMX::INTERNAL_OPTION_MAX_FPS,
+                &mCodec->mMaxFps,
+                sizeof(mCodec->mMaxFps));
+
+        if (err != OK) {
+            ALOGE("[%s] Unable to configure max fps (err %d)",
+                    mCodec->mComponentName.c_str(),
+                    err);
+        }
+    }
+
     if (err == OK) {
         notify->setObject("input-surface",
                 new BufferProducerWrapper(bufferProducer));
@@ -4272,6 +4346,22 @@ status_t ACodec::setParameters(const sp<AMessage> &params) {
         }
     }
 
+    float maxFps;
+    if (params->findFloat("max-fps-to-encoder", &maxFps)) {
+        status_t err =
+            mOMX->setInternalOption(
+                     mNode,
+                     kPortIndexInput,
+                     IOMX::INTERNAL_OPTION_MAX_FPS,
+                     &maxFps,
+                     sizeof(maxFps));
+
+        if (err != OK) {
+            ALOGE("Failed to set parameter 'max-fps-to-encoder' (err %d)", err);
+            return err;
+        }
+    }
+
     int32_t dummy;
     if (params->findInt32("request-sync", &dummy)) {
         status_t err = requestIDRFrame();
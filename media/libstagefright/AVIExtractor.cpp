@@ -185,6 +185,13 @@ status_t AVIExtractor::AVISource::read(
         MediaBuffer *out;
         CHECK_EQ(mBufferGroup->acquire_buffer(&out), (status_t)OK);
 
+        if (size > out->size()) {
+            // mMaxSampleSize only covers the index entries that were loaded
+            // when the file was opened.
+            out->release();
+            out = new MediaBuffer(size);
+        }
+
         ssize_t n = mExtractor->mDataSource->readAt(offset, out->data(), size);
 
         if (n < (ssize_t)size) {
@@ -412,11 +419,34 @@ status_t AVIExtractor::parseHeaders() {
         return (status_t)res;
     }
 
+    if (hasSuperIndexes()) {
+        mFoundIndex = true;
+    }
+
     if (mMovieOffset == 0ll || !mFoundIndex) {
         return ERROR_MALFORMED;
     }
 
-    return OK;
+    return finishIndex();
+}
+
+bool AVIExtractor::hasSuperIndexes() const {
+    bool found = false;
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        const Track &track = mTracks.itemAt(i);
+
+        if (track.mKind == Track::OTHER) {
+            continue;
+        }
+
+        if (!track.mHasSuperIndex) {
+            return false;
+        }
+
+        found = true;
+    }
+
+    return found;
 }
 
 ssize_t AVIExtractor::parseChunk(off64_t offset, off64_t size, int depth) {
@@ -509,8 +539,21 @@ ssize_t AVIExtractor::parseChunk(off64_t offset, off64_t size, int depth) {
                 break;
             }
 
+            case FOURCC('i', 'n', 'd', 'x'):
+            {
+                err = parseSuperIndex(offset + 8, chunkSize);
+                break;
+            }
+
             case FOURCC('i', 'd', 'x', '1'):
             {
+                if (hasSuperIndexes()) {
+                    // The OpenDML indexes also cover the AVIX extensions,
+                    // idx1 only covers the first RIFF chunk.
+                    ALOGV("%s ignoring idx1, using OpenDML indexes", prefix);
+                    break;
+                }
+
                 err = parseIndex(offset + 8, chunkSize);
                 break;
             }
@@ -613,6 +656,7 @@ status_t AVIExtractor::parseStreamHeader(off64_t offset, size_t size) {
     uint32_t rate = U32LE_AT(&data[20]);
     uint32_t scale = U32LE_AT(&data[24]);
 
+    uint32_t suggestedBufferSize = U32LE_AT(&data[36]);
     uint32_t sampleSize = U32LE_AT(&data[44]);
 
     const char *mime = NULL;
@@ -652,11 +696,13 @@ status_t AVIExtractor::parseStreamHeader(off64_t offset, size_t size) {
     Track *track = &mTracks.editItemAt(mTracks.size() - 1);
 
     track->mMeta = meta;
+    track->mNumSamples = 0;
+    track->mHasSuperIndex = false;
+    track->mSuggestedBufferSize = suggestedBufferSize;
     track->mRate = rate;
     track->mScale = scale;
     track->mBytesPerSample = sampleSize;
     track->mKind = kind;
-    track->mNumSyncSamples = 0;
     track->mThumbnailSampleSize = 0;
     track->mThumbnailSampleIndex = -1;
     track->mMaxSampleSize = 0;
@@ -764,6 +810,94 @@ bool AVIExtractor::IsCorrectChunkType(
     return true;
 }
 
+status_t AVIExtractor::parseSuperIndex(off64_t offset, size_t size) {
+    if (mTracks.isEmpty()) {
+        return ERROR_MALFORMED;
+    }
+
+    size_t trackIndex = mTracks.size() - 1;
+    Track *track = &mTracks.editItemAt(trackIndex);
+
+    if (track->mKind == Track::OTHER) {
+        return OK;
+    }
+
+    if (size < 24) {
+        return ERROR_MALFORMED;
+    }
+
+    sp<ABuffer> buffer = new ABuffer(size);
+    ssize_t n = mDataSource->readAt(offset, buffer->data(), buffer->size());
+
+    if (n < (ssize_t)size) {
+        return n < 0 ? (status_t)n : ERROR_MALFORMED;
+    }
+
+    const uint8_t *data = buffer->data();
+
+    uint16_t longsPerEntry = U16LE_AT(data);
+    uint8_t indexSubType = data[2];
+    uint8_t indexType = data[3];
+    uint32_t numEntries = U32LE_AT(&data[4]);
+    uint32_t chunkType = U32_AT(&data[8]);
+
+    if (indexType != 0x00 /* AVI_INDEX_OF_INDEXES */
+            || indexSubType != 0 || longsPerEntry != 4) {
+        // Field indexes and standard indexes stored directly in the
+        // header are not supported, fall back to idx1.
+        ALOGW("Unsupported OpenDML index type %d/%d", indexType, indexSubType);
+        return OK;
+    }
+
+    if (numEntries > (size - 24) / 16
+            || !IsCorrectChunkType(trackIndex, track->mKind, chunkType)) {
+        return ERROR_MALFORMED;
+    }
+
+    // Only the header of each standard index is read now, its entries are
+    // loaded by loadIndexSegment() when needed.
+    for (uint32_t i = 0; i < numEntries; ++i) {
+        const uint8_t *entry = &data[24 + 16 * i];
+        off64_t indexOffset = U64LE_AT(entry);
+
+        uint8_t header[32];
+        n = mDataSource->readAt(indexOffset, header, sizeof(header));
+
+        if (n < (ssize_t)sizeof(header)) {
+            return n < 0 ? (status_t)n : ERROR_MALFORMED;
+        }
+
+        uint32_t indexSize = U32LE_AT(&header[4]);
+        uint32_t numSamples = U32LE_AT(&header[12]);
+
+        if (U16LE_AT(&header[8]) != 2 || header[10] != 0
+                || header[11] != 0x01 /* AVI_INDEX_OF_CHUNKS */
+                || U32_AT(&header[16]) != chunkType
+                || indexSize < 24 || numSamples > (indexSize - 24) / 8) {
+            ALOGW("Malformed OpenDML standard index, falling back to idx1");
+            track->mSegments.clear();
+            track->mNumSamples = 0;
+            return OK;
+        }
+
+        track->mSegments.push();
+        IndexSegment *segment =
+            &track->mSegments.editItemAt(track->mSegments.size() - 1);
+
+        segment->mBaseOffset = U64LE_AT(&header[20]);
+        segment->mIndexOffset = indexOffset + sizeof(header);
+        segment->mFirstSample = track->mNumSamples;
+        segment->mNumSamples = numSamples;
+        segment->mLoaded = false;
+
+        track->mNumSamples += numSamples;
+    }
+
+    track->mHasSuperIndex = true;
+
+    return OK;
+}
+
 status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
     if ((size % 16) != 0) {
         return ERROR_MALFORMED;
@@ -776,6 +910,24 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
         return n < 0 ? (status_t)n : ERROR_MALFORMED;
     }
 
+    // idx1 describes every track with a single, fully loaded segment.
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        Track *track = &mTracks.editItemAt(i);
+
+        track->mSegments.clear();
+        track->mSegments.push();
+        track->mNumSamples = 0;
+        track->mHasSuperIndex = false;
+
+        IndexSegment *segment = &track->mSegments.editItemAt(0);
+        segment->mBaseOffset = 0;
+        segment->mIndexOffset = 0;
+        segment->mFirstSample = 0;
+        segment->mNumSamples = 0;
+        segment->mLoaded = true;
+        segment->mEntries.setCapacity(size / 16 / mTracks.size());
+    }
+
     const uint8_t *data = buffer->data();
 
     while (size > 0) {
@@ -810,67 +962,159 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
         uint32_t offset = U32LE_AT(&data[8]);
         uint32_t chunkSize = U32LE_AT(&data[12]);
 
+        if (chunkSize & kNotSyncSample) {
+            return ERROR_MALFORMED;
+        }
+
         if (chunkSize > track->mMaxSampleSize) {
             track->mMaxSampleSize = chunkSize;
         }
 
-        track->mSamples.push();
+        SampleEntry entry;
+        entry.mOffset = offset;
+        entry.mSize = chunkSize | ((flags & 0x10) ? 0 : kNotSyncSample);
 
-        SampleInfo *info =
-            &track->mSamples.editItemAt(track->mSamples.size() - 1);
+        track->mSegments.editItemAt(0).mEntries.push(entry);
+        ++track->mNumSamples;
 
-        info->mOffset = offset;
-        info->mIsKey = (flags & 0x10) != 0;
+        data += 16;
+        size -= 16;
+    }
 
-        if (info->mIsKey) {
-            static const size_t kMaxNumSyncSamplesToScan = 20;
+    // idx1 offsets point at the chunk header and are either absolute or
+    // relative to the 'movi' list, find out which using the first sample.
+    ssize_t firstTrack = -1;
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        Track *track = &mTracks.editItemAt(i);
+        track->mSegments.editItemAt(0).mNumSamples = track->mNumSamples;
 
-            if (track->mNumSyncSamples < kMaxNumSyncSamplesToScan) {
-                if (chunkSize > track->mThumbnailSampleSize) {
-                    track->mThumbnailSampleSize = chunkSize;
+        if (firstTrack < 0 && track->mNumSamples > 0) {
+            firstTrack = i;
+        }
+    }
 
-                    track->mThumbnailSampleIndex =
-                        track->mSamples.size() - 1;
-                }
-            }
+    if (firstTrack >= 0) {
+        uint32_t firstOffset =
+            mTracks.itemAt(firstTrack).mSegments.itemAt(0).mEntries.itemAt(0).mOffset;
 
-            ++track->mNumSyncSamples;
+        if (isChunkAt(firstTrack, mMovieOffset + 8 + firstOffset)) {
+            mOffsetsAreAbsolute = false;
+        } else if (isChunkAt(firstTrack, firstOffset)) {
+            mOffsetsAreAbsolute = true;
+        } else {
+            return ERROR_MALFORMED;
         }
 
-        data += 16;
-        size -= 16;
+        ALOGV("Chunk offsets are %s",
+             mOffsetsAreAbsolute ? "absolute" : "movie-chunk relative");
     }
 
-    if (!mTracks.isEmpty()) {
-        off64_t offset;
-        size_t size;
-        bool isKey;
-        int64_t timeUs;
-        status_t err = getSampleInfo(0, 0, &offset, &size, &isKey, &timeUs);
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        mTracks.editItemAt(i).mSegments.editItemAt(0).mBaseOffset =
+            (mOffsetsAreAbsolute ? 0 : mMovieOffset + 8) + 8;
+    }
 
-        if (err != OK) {
-            mOffsetsAreAbsolute = !mOffsetsAreAbsolute;
-            err = getSampleInfo(0, 0, &offset, &size, &isKey, &timeUs);
+    mFoundIndex = true;
 
-            if (err != OK) {
-                return err;
-            }
+    return OK;
+}
+
+bool AVIExtractor::isChunkAt(size_t trackIndex, off64_t offset) {
+    const Track &track = mTracks.itemAt(trackIndex);
+
+    uint8_t tmp[8];
+    if (mDataSource->readAt(offset, tmp, 8) < 8) {
+        return false;
+    }
+
+    return IsCorrectChunkType(trackIndex, track.mKind, U32_AT(tmp));
+}
+
+status_t AVIExtractor::loadIndexSegment(Track *track, size_t segmentIndex) {
+    IndexSegment *segment = &track->mSegments.editItemAt(segmentIndex);
+
+    size_t size = segment->mNumSamples * 8;
+    sp<ABuffer> buffer = new ABuffer(size);
+    ssize_t n = mDataSource->readAt(
+            segment->mIndexOffset, buffer->data(), buffer->size());
+
+    if (n < (ssize_t)size) {
+        return n < 0 ? (status_t)n : ERROR_MALFORMED;
+    }
+
+    const uint8_t *data = buffer->data();
+
+    segment->mEntries.clear();
+    segment->mEntries.setCapacity(segment->mNumSamples);
+
+    for (size_t i = 0; i < segment->mNumSamples; ++i) {
+        SampleEntry entry;
+        entry.mOffset = U32LE_AT(&data[8 * i]);
+        entry.mSize = U32LE_AT(&data[8 * i + 4]);
+
+        size_t sampleSize = entry.mSize & ~kNotSyncSample;
+        if (sampleSize > track->mMaxSampleSize) {
+            track->mMaxSampleSize = sampleSize;
         }
 
-        ALOGV("Chunk offsets are %s",
-             mOffsetsAreAbsolute ? "absolute" : "movie-chunk relative");
+        segment->mEntries.push(entry);
     }
 
+    segment->mLoaded = true;
+
+    ALOGV("loaded index segment %d, %d samples",
+         segmentIndex, segment->mNumSamples);
+
+    return OK;
+}
+
+status_t AVIExtractor::finishIndex() {
     for (size_t i = 0; i < mTracks.size(); ++i) {
         Track *track = &mTracks.editItemAt(i);
 
+        if (track->mNumSamples == 0) {
+            continue;
+        }
+
+        if (track->mKind == Track::VIDEO) {
+            // Pick the largest of the first few sync samples as thumbnail.
+            static const size_t kMaxNumSyncSamplesToScan = 20;
+
+            size_t numSyncSamples = 0;
+            for (size_t j = 0; j < track->mNumSamples
+                    && numSyncSamples < kMaxNumSyncSamplesToScan; ++j) {
+                off64_t offset;
+                size_t size;
+                bool isKey;
+                int64_t dummy;
+
+                status_t err = getSampleInfo(
+                        i, j, &offset, &size, &isKey, &dummy);
+
+                if (err != OK) {
+                    return err;
+                }
+
+                if (!isKey) {
+                    continue;
+                }
+
+                if (size > track->mThumbnailSampleSize) {
+                    track->mThumbnailSampleSize = size;
+                    track->mThumbnailSampleIndex = j;
+                }
+
+                ++numSyncSamples;
+            }
+        }
+
         if (track->mBytesPerSample > 0) {
             // Assume all chunks are roughly the same size for now.
 
             // Compute the avg. size of the first 128 chunks (if there are
             // that many), but exclude the size of the first one, since
             // it may be an outlier.
-            size_t numSamplesToAverage = track->mSamples.size();
+            size_t numSamplesToAverage = track->mNumSamples;
             if (numSamplesToAverage > 256) {
                 numSamplesToAverage = 256;
             }
@@ -905,9 +1149,15 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
             track->mAvgChunkSize = avgChunkSize;
         }
 
+        // Standard indexes that are not loaded yet may hold larger samples,
+        // so also honour the size the muxer suggested.
+        if (track->mSuggestedBufferSize > track->mMaxSampleSize) {
+            track->mMaxSampleSize = track->mSuggestedBufferSize;
+        }
+
         int64_t durationUs;
         CHECK_EQ((status_t)OK,
-                 getSampleTime(i, track->mSamples.size() - 1, &durationUs));
+                 getSampleTime(i, track->mNumSamples - 1, &durationUs));
 
         ALOGV("track %d duration = %.2f secs", i, durationUs / 1E6);
 
@@ -943,8 +1193,6 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
         }
     }
 
-    mFoundIndex = true;
-
     return OK;
 }
 
@@ -1101,47 +1349,79 @@ status_t AVIExtractor::addH264CodecSpecificData(size_t trackIndex) {
     return OK;
 }
 
-status_t AVIExtractor::getSampleInfo(
+status_t AVIExtractor::getSampleEntry_l(
         size_t trackIndex, size_t sampleIndex,
-        off64_t *offset, size_t *size, bool *isKey,
-        int64_t *sampleTimeUs) {
-    if (trackIndex >= mTracks.size()) {
+        off64_t *offset, size_t *size, bool *isKey) {
+    Track *track = &mTracks.editItemAt(trackIndex);
+
+    if (sampleIndex >= track->mNumSamples) {
         return -ERANGE;
     }
 
-    const Track &track = mTracks.itemAt(trackIndex);
+    // Find the last segment starting at or before the sample.
+    size_t lo = 0;
+    size_t hi = track->mSegments.size();
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (track->mSegments.itemAt(mid).mFirstSample <= sampleIndex) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
 
-    if (sampleIndex >= track.mSamples.size()) {
-        return -ERANGE;
+    if (!track->mSegments.itemAt(lo).mLoaded) {
+        status_t err = loadIndexSegment(track, lo);
+
+        if (err != OK) {
+            return err;
+        }
     }
 
-    const SampleInfo &info = track.mSamples.itemAt(sampleIndex);
+    const IndexSegment &segment = track->mSegments.itemAt(lo);
+    const SampleEntry &entry =
+        segment.mEntries.itemAt(sampleIndex - segment.mFirstSample);
 
-    if (!mOffsetsAreAbsolute) {
-        *offset = info.mOffset + mMovieOffset + 8;
-    } else {
-        *offset = info.mOffset;
+    *offset = segment.mBaseOffset + entry.mOffset;
+    *size = entry.mSize & ~kNotSyncSample;
+    *isKey = (entry.mSize & kNotSyncSample) == 0;
+
+    return OK;
+}
+
+status_t AVIExtractor::getSampleInfo(
+        size_t trackIndex, size_t sampleIndex,
+        off64_t *offset, size_t *size, bool *isKey,
+        int64_t *sampleTimeUs) {
+    if (trackIndex >= mTracks.size()) {
+        return -ERANGE;
     }
 
-    *size = 0;
+    {
+        Mutex::Autolock autoLock(mIndexLock);
 
-    uint8_t tmp[8];
-    ssize_t n = mDataSource->readAt(*offset, tmp, 8);
+        status_t err =
+            getSampleEntry_l(trackIndex, sampleIndex, offset, size, isKey);
 
-    if (n < 8) {
-        return n < 0 ? (status_t)n : (status_t)ERROR_MALFORMED;
+        if (err != OK) {
+            return err;
+        }
     }
 
-    uint32_t chunkType = U32_AT(tmp);
+    return getSampleTime(trackIndex, sampleIndex, sampleTimeUs);
+}
 
-    if (!IsCorrectChunkType(trackIndex, track.mKind, chunkType)) {
-        return ERROR_MALFORMED;
+status_t AVIExtractor::getSampleTime(
+        size_t trackIndex, size_t sampleIndex, int64_t *sampleTimeUs) {
+    if (trackIndex >= mTracks.size()) {
+        return -ERANGE;
     }
 
-    *offset += 8;
-    *size = U32LE_AT(&tmp[4]);
+    const Track &track = mTracks.itemAt(trackIndex);
 
-    *isKey = info.mIsKey;
+    if (sampleIndex >= track.mNumSamples) {
+        return -ERANGE;
+    }
 
     if (track.mBytesPerSample > 0) {
         size_t sampleStartInBytes;
@@ -1160,19 +1440,10 @@ status_t AVIExtractor::getSampleInfo(
     return OK;
 }
 
-status_t AVIExtractor::getSampleTime(
-        size_t trackIndex, size_t sampleIndex, int64_t *sampleTimeUs) {
-    off64_t offset;
-    size_t size;
-    bool isKey;
-    return getSampleInfo(
-            trackIndex, sampleIndex, &offset, &size, &isKey, sampleTimeUs);
-}
-
 status_t AVIExtractor::getSampleIndexAtTime(
         size_t trackIndex,
         int64_t timeUs, MediaSource::ReadOptions::SeekMode mode,
-        size_t *sampleIndex) const {
+        size_t *sampleIndex) {
     if (trackIndex >= mTracks.size()) {
         return -ERANGE;
     }
@@ -1198,7 +1469,11 @@ status_t AVIExtractor::getSampleIndexAtTime(
         closestSampleIndex = timeUs / track.mRate * track.mScale / 1000000ll;
     }
 
-    ssize_t numSamples = track.mSamples.size();
+    ssize_t numSamples = track.mNumSamples;
+
+    if (numSamples == 0) {
+        return -ERANGE;
+    }
 
     if (closestSampleIndex < 0) {
         closestSampleIndex = 0;
@@ -1212,12 +1487,22 @@ status_t AVIExtractor::getSampleIndexAtTime(
         return OK;
     }
 
+    Mutex::Autolock autoLock(mIndexLock);
+
+    off64_t offset;
+    size_t size;
+    bool isKey;
+
     ssize_t prevSyncSampleIndex = closestSampleIndex;
     while (prevSyncSampleIndex >= 0) {
-        const SampleInfo &info =
-            track.mSamples.itemAt(prevSyncSampleIndex);
+        status_t err = getSampleEntry_l(
+                trackIndex, prevSyncSampleIndex, &offset, &size, &isKey);
+
+        if (err != OK) {
+            return err;
+        }
 
-        if (info.mIsKey) {
+        if (isKey) {
             break;
         }
 
@@ -1226,10 +1511,14 @@ status_t AVIExtractor::getSampleIndexAtTime(
 
     ssize_t nextSyncSampleIndex = closestSampleIndex;
     while (nextSyncSampleIndex < numSamples) {
-        const SampleInfo &info =
-            track.mSamples.itemAt(nextSyncSampleIndex);
+        status_t err = getSampleEntry_l(
+                trackIndex, nextSyncSampleIndex, &offset, &size, &isKey);
 
-        if (info.mIsKey) {
+        if (err != OK) {
+            return err;
+        }
+
+        if (isKey) {
             break;
         }
 
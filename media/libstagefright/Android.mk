@@ -21,6 +21,7 @@ LOCAL_SRC_FILES:=                         \
         AudioPlayer.cpp                   \
         AudioSource.cpp                   \
         AwesomePlayer.cpp                 \
+        BlockCachedSource.cpp             \
         CameraSource.cpp                  \
         CameraSourceTimeLapse.cpp         \
         DataSource.cpp                    \
@@ -32,6 +33,7 @@ LOCAL_SRC_FILES:=                         \
         JPEGSource.cpp                    \
         LPAPlayerALSA.cpp                 \
         MP3Extractor.cpp                  \
+        MP3FrameIndex.cpp                 \
         MPEG2TSWriter.cpp                 \
         MPEG4Extractor.cpp                \
         MPEG4Writer.cpp                   \
@@ -39,6 +41,7 @@ LOCAL_SRC_FILES:=                         \
         MediaBuffer.cpp                   \
         MediaBufferGroup.cpp              \
         MediaCodec.cpp                    \
+        MediaCodecDecodingSource.cpp      \
         MediaCodecList.cpp                \
         MediaDefs.cpp                     \
         MediaExtractor.cpp                \
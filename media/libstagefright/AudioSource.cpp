@@ -209,6 +209,29 @@ void AudioSource::releaseQueuedFrames_l() {
         (*it)->release();
         mBuffersReceived.erase(it);
     }
+    while (!mFreeBuffers.empty()) {
+        it = mFreeBuffers.begin();
+        (*it)->release();
+        mFreeBuffers.erase(it);
+    }
+}
+
+MediaBuffer *AudioSource::getFreeBuffer_l(size_t size) {
+    if (!mFreeBuffers.empty()) {
+        MediaBuffer *buffer = *mFreeBuffers.begin();
+        mFreeBuffers.erase(mFreeBuffers.begin());
+        if (buffer->size() >= size) {
+            buffer->meta_data()->clear();
+            return buffer;
+        }
+        buffer->release();
+    }
+
+    // Size new buffers for the largest callback, so they can all be reused
+    if (size < (size_t)mMaxBufferSize) {
+        size = mMaxBufferSize;
+    }
+    return new MediaBuffer(size);
 }
 
 void AudioSource::waitOutstandingEncodingFrames_l() {
@@ -341,7 +364,9 @@ void AudioSource::signalBufferReturned(MediaBuffer *buffer) {
     Mutex::Autolock autoLock(mLock);
     --mNumClientOwnedBuffers;
     buffer->setObserver(0);
-    buffer->release();
+    // Keep the buffer for a later callback instead of freeing it; the
+    // queued and free buffers are all released on reset.
+    mFreeBuffers.push_back(buffer);
     mFrameEncodingCompletionCondition.signal();
     return;
 }
@@ -400,7 +425,7 @@ status_t AudioSource::dataCallback(const AudioRecord::Buffer& audioBuffer) {
         } else {
             numLostBytes = 0;
         }
-        MediaBuffer *lostAudioBuffer = new MediaBuffer(bufferSize);
+        MediaBuffer *lostAudioBuffer = getFreeBuffer_l(bufferSize);
         memset(lostAudioBuffer->data(), 0, bufferSize);
         lostAudioBuffer->set_range(0, bufferSize);
         queueInputBuffer_l(lostAudioBuffer, timeUs);
@@ -412,7 +437,7 @@ status_t AudioSource::dataCallback(const AudioRecord::Buffer& audioBuffer) {
     }
 
     const size_t bufferSize = audioBuffer.size;
-    MediaBuffer *buffer = new MediaBuffer(bufferSize);
+    MediaBuffer *buffer = getFreeBuffer_l(bufferSize);
     memcpy((uint8_t *) buffer->data(),
             audioBuffer.i16, audioBuffer.size);
     buffer->set_range(0, bufferSize);
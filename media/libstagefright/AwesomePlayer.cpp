@@ -27,6 +27,7 @@
 #include <dlfcn.h>
 
 #include "include/AwesomePlayer.h"
+#include "include/BlockCachedSource.h"
 #include "include/DRMExtractor.h"
 #include "include/SoftwareRenderer.h"
 #include "include/NuCachedSource2.h"
@@ -77,6 +78,12 @@ static const size_t kHighWaterMarkBytes = 200000;
 static const int64_t kInitFrameDurationUs = 16000;
 static const int64_t kScheduleLagGapUs = 1000;
 static const int64_t kDefaultEventDelayUs = 10000;
+// frames are rendered once they are no more than this early
+static const int64_t kEarlyRenderWindowUs = 10000;
+// bound on the wait for an early frame, so clock changes are picked up
+static const int64_t kMaxEarlyEventDelayUs = 100000;
+// audio returned by the decoder in each buffer when the sink is deep buffered
+static const int64_t kDeepBufferDecodeDurationUs = 200000;
 int AwesomePlayer::mTunnelAliveAP = 0;
 
 // maximum time in paused state when offloading audio decompression. When elapsed, the AudioPlayer
@@ -402,7 +409,8 @@ status_t AwesomePlayer::setDataSource(
     if(fd)
         printFileName(fd);
 
-    sp<DataSource> dataSource = new FileSource(fd, offset, length);
+    sp<DataSource> dataSource =
+        BlockCachedSource::Wrap(new FileSource(fd, offset, length));
 
     status_t err = dataSource->initCheck();
 
@@ -1198,7 +1206,8 @@ void AwesomePlayer::createAudioPlayer_l()
             minDurationForLPA = LPA_MIN_DURATION_USEC_DEFAULT;
         }
     }
-    if((strcmp("true",lpaDecode) == 0) && (mAudioPlayer == NULL) &&
+    // LPA is only a fallback for outputs without compressed offload, see checkTunnelExceptions()
+    if(!mOffloadAudio && (strcmp("true",lpaDecode) == 0) && (mAudioPlayer == NULL) &&
 #ifdef USE_TUNNEL_MODE
        (tunnelObjectsAlive < TunnelPlayer::getTunnelObjectsAliveMax()) &&
 #endif
@@ -1784,7 +1793,8 @@ status_t AwesomePlayer::initAudioDecoder() {
                 mDurationUs = durationUs;
             }
         }
-        if ( mDurationUs > minDurationForLPA
+        // with offload the decoder is only used as fallback, so it is never set up for LPA
+        if ( !mOffloadAudio && mDurationUs > minDurationForLPA
              && (!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_MPEG) || !strcasecmp(mime,MEDIA_MIMETYPE_AUDIO_AAC))
              && LPAPlayer::mObjectsAlive == 0 && mVideoSource == NULL && (strcmp("true",lpaDecode) == 0)
              && (nchannels && (nchannels <= 2)) ) {
@@ -1806,8 +1816,23 @@ status_t AwesomePlayer::initAudioDecoder() {
             }
             flags |= OMXCodec::kSoftwareCodecsOnly;
         }
+        // Audio only clips long enough to get a deep buffer sink (see
+        // createAudioPlayer_l) can take several decoded frames at a time,
+        // which saves decoder round trips.
+        sp<MetaData> format = mAudioTrack->getFormat();
+        int32_t sampleRate;
+        if (!mOffloadAudio && mVideoSource == NULL
+                && mDurationUs > AUDIO_SINK_MIN_DEEP_BUFFER_DURATION_US
+                && format->findInt32(kKeySampleRate, &sampleRate)
+                && nchannels > 0) {
+            format = new MetaData(*format);
+            format->setInt32(kKeyMaxOutputSize,
+                    (sampleRate * kDeepBufferDecodeDurationUs / 1000000ll)
+                        * nchannels * sizeof(int16_t));
+        }
+
         mAudioSource = OMXCodec::Create(
-                mClient.interface(), mAudioTrack->getFormat(),
+                mClient.interface(), format,
                 false, // createEncoder
                 mAudioTrack, matchComponentName, flags,NULL);
 
@@ -2270,14 +2295,19 @@ void AwesomePlayer::onVideoEvent() {
             }
         }
 
-        if (latenessUs < -10000) {
-            // We're more than 10ms early.
+        if (latenessUs < -kEarlyRenderWindowUs) {
+            // We're more than 10ms early. Rather than polling every 10ms,
+            // come back when the frame enters the render window.
             logOnTime(timeUs,nowUs,latenessUs);
             {
                 Mutex::Autolock autoLock(mStatsLock);
                 mStats.mConsecutiveFramesDropped = 0;
             }
-            postVideoEvent_l(10000);
+            int64_t delayUs = -latenessUs - kEarlyRenderWindowUs + earlyGapUs;
+            if (delayUs > kMaxEarlyEventDelayUs) {
+                delayUs = kMaxEarlyEventDelayUs;
+            }
+            postVideoEvent_l(delayUs);
             return;
         }
     }
@@ -3295,6 +3325,16 @@ bool AwesomePlayer::inSupportedTunnelFormats(const char * mime) {
 
 void AwesomePlayer::checkTunnelExceptions()
 {
+    /* exception 0: the stream can use compressed offload through AudioPlayer, which goes
+     * through the AudioTrack offload flag and the OffloadThread in AudioFlinger.  This is the
+     * one DSP playback path with a common buffering, timing and pause/teardown policy,
+     * so the tunnel and LPA players are only kept for outputs without offload support */
+    if (mOffloadAudio) {
+        ALOGV("Offload available, force disable tunnel mode playback");
+        mIsTunnelAudio = false;
+        return;
+    }
+
     /* exception 1: No streaming */
     if (isStreamingHTTP()) {
         ALOGV("Streaming, force disable tunnel mode playback");
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "BlockCachedSource"
+#include <utils/Log.h>
+
+#include "include/BlockCachedSource.h"
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+static const int kDefaultBlockSizeKb = 16;
+static const int kDefaultNumBlocks = 32;
+
+BlockCachedSource::BlockCachedSource(
+        const sp<DataSource> &source, size_t blockSize, size_t numBlocks)
+    : mSource(source),
+      mBlockSize(blockSize),
+      mUseCounter(0),
+      mBypass(false) {
+    CHECK(mBlockSize > 0);
+    CHECK(numBlocks > 0);
+
+    // the blocks are allocated when first used, short files or metadata retrieval
+    // often only need a few of them
+    Block block;
+    block.mOffset = -1;
+    block.mSize = 0;
+    block.mLastUse = 0;
+    block.mData = NULL;
+    mBlocks.insertAt(block, 0, numBlocks);
+}
+
+BlockCachedSource::~BlockCachedSource() {
+    for (size_t i = 0; i < mBlocks.size(); ++i) {
+        delete[] mBlocks[i].mData;
+    }
+}
+
+// static
+sp<DataSource> BlockCachedSource::Wrap(const sp<DataSource> &source) {
+    // network sources are already behind NuCachedSource2, which also prefetches
+    if (source == NULL
+            || (source->flags()
+                & (kWantsPrefetching | kIsCachingDataSource))) {
+        return source;
+    }
+
+    int blockSizeKb = kDefaultBlockSizeKb;
+    int numBlocks = kDefaultNumBlocks;
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.block-cache", value, NULL)) {
+        int kb, blocks;
+        if (sscanf(value, "%d/%d", &kb, &blocks) != 2 || kb <= 0 || blocks < 0) {
+            ALOGE("Failed to parse block cache parameters from '%s'.", value);
+        } else {
+            blockSizeKb = kb;
+            numBlocks = blocks;
+        }
+    }
+
+    if (numBlocks == 0) {
+        return source;
+    }
+
+    ALOGV("caching %d blocks of %d KB", numBlocks, blockSizeKb);
+
+    return new BlockCachedSource(source, blockSizeKb * 1024, numBlocks);
+}
+
+ssize_t BlockCachedSource::readAt(off64_t offset, void *data, size_t size) {
+    if (size < mBlockSize && offset >= 0) {
+        Mutex::Autolock autoLock(mLock);
+        if (!mBypass) {
+            return readFromBlocks_l(offset, data, size);
+        }
+    }
+
+    // sample data and other large reads would only evict the headers, and decrypted
+    // sources must not be served from blocks cached before DRM was set up
+    return mSource->readAt(offset, data, size);
+}
+
+ssize_t BlockCachedSource::readFromBlocks_l(off64_t offset, void *data, size_t size) {
+    size_t copied = 0;
+    while (copied < size) {
+        off64_t position = offset + copied;
+
+        status_t err;
+        Block *block = getBlock_l(position - position % mBlockSize, &err);
+        if (block == NULL) {
+            return copied > 0 ? (ssize_t)copied : err;
+        }
+
+        size_t inBlock = position - block->mOffset;
+        if (inBlock >= block->mSize) {
+            break;  // read beyond EOF.
+        }
+
+        size_t n = block->mSize - inBlock;
+        if (n > size - copied) {
+            n = size - copied;
+        }
+        memcpy((uint8_t *)data + copied, block->mData + inBlock, n);
+        copied += n;
+
+        if (block->mSize < mBlockSize) {
+            break;  // last block of the source
+        }
+    }
+
+    return copied;
+}
+
+sp<DecryptHandle> BlockCachedSource::DrmInitialization(const char *mime) {
+    sp<DecryptHandle> handle = mSource->DrmInitialization(mime);
+    if (handle != NULL) {
+        Mutex::Autolock autoLock(mLock);
+        for (size_t i = 0; i < mBlocks.size(); ++i) {
+            delete[] mBlocks[i].mData;
+        }
+        mBlocks.clear();
+        mBypass = true;
+    }
+    return handle;
+}
+
+// Returns the block starting at offset, reading it from the source in place of the least
+// recently used one if it is not cached.
+BlockCachedSource::Block *BlockCachedSource::getBlock_l(off64_t offset, status_t *err) {
+    Block *victim = NULL;
+    for (size_t i = 0; i < mBlocks.size(); ++i) {
+        Block *block = &mBlocks.editItemAt(i);
+        if (block->mOffset == offset) {
+            block->mLastUse = ++mUseCounter;
+            return block;
+        }
+        if (victim == NULL || block->mLastUse < victim->mLastUse) {
+            victim = block;
+        }
+    }
+
+    if (victim->mData == NULL) {
+        victim->mData = new uint8_t[mBlockSize];
+    }
+
+    ssize_t n = mSource->readAt(offset, victim->mData, mBlockSize);
+    if (n < 0) {
+        victim->mOffset = -1;
+        victim->mLastUse = 0;
+        *err = n;
+        return NULL;
+    }
+
+    victim->mOffset = offset;
+    victim->mSize = n;
+    victim->mLastUse = ++mUseCounter;
+
+    return victim;
+}
+
+}  // namespace android
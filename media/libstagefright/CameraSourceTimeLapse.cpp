@@ -72,7 +72,10 @@ CameraSourceTimeLapse::CameraSourceTimeLapse(
                 videoSize, videoFrameRate, surface, true),
       mTimeBetweenTimeLapseVideoFramesUs(1E6/videoFrameRate),
       mLastTimeLapseFrameRealTimestampUs(0),
-      mSkipCurrentFrame(false) {
+      mSkipCurrentFrame(false),
+      mPreviewFpsRangeChanged(false),
+      mOriginalMinPreviewFps(0),
+      mOriginalMaxPreviewFps(0) {
 
     mTimeBetweenFrameCaptureUs = timeBetweenFrameCaptureUs;
     ALOGD("starting time lapse mode: %lld us",
@@ -83,6 +86,8 @@ CameraSourceTimeLapse::CameraSourceTimeLapse(
 
     if (!trySettingVideoSize(videoSize.width, videoSize.height)) {
         mInitCheck = NO_INIT;
+    } else {
+        trySettingPreviewFpsRange(timeBetweenFrameCaptureUs);
     }
 
     // Initialize quick stop variables.
@@ -97,6 +102,14 @@ CameraSourceTimeLapse::~CameraSourceTimeLapse() {
         mLastReadBufferCopy->release();
         mLastReadBufferCopy = NULL;
     }
+
+    // ~CameraSource() releases the camera, which may be the app's
+    restorePreviewFpsRange();
+}
+
+status_t CameraSourceTimeLapse::stop() {
+    restorePreviewFpsRange();
+    return CameraSource::stop();
 }
 
 void CameraSourceTimeLapse::startQuickReadReturns() {
@@ -159,6 +172,79 @@ bool CameraSourceTimeLapse::trySettingVideoSize(
     return isSuccessful;
 }
 
+void CameraSourceTimeLapse::trySettingPreviewFpsRange(
+        int64_t timeBetweenFrameCaptureUs) {
+
+    ALOGV("trySettingPreviewFpsRange");
+    if (timeBetweenFrameCaptureUs <= 0) {
+        return;
+    }
+
+    int64_t token = IPCThreadState::self()->clearCallingIdentity();
+    String8 s = mCamera->getParameters();
+
+    CameraParameters params(s);
+    const char *supportedRanges =
+            params.get(CameraParameters::KEY_SUPPORTED_PREVIEW_FPS_RANGE);
+    int minFps, maxFps;
+    params.getPreviewFpsRange(&minFps, &maxFps);
+
+    // The ranges are in frames per 1000 seconds
+    int64_t captureFps = (1000000000LL + timeBetweenFrameCaptureUs - 1)
+            / timeBetweenFrameCaptureUs;
+
+    int bestMin = minFps;
+    int bestMax = maxFps;
+    const char *range = supportedRanges;
+    while (range != NULL && (range = strchr(range, '(')) != NULL) {
+        int rangeMin, rangeMax;
+        if (sscanf(range, "(%d,%d)", &rangeMin, &rangeMax) == 2 &&
+                rangeMax >= captureFps &&
+                (rangeMax < bestMax ||
+                 (rangeMax == bestMax && rangeMin < bestMin))) {
+            bestMin = rangeMin;
+            bestMax = rangeMax;
+        }
+        range++;
+    }
+
+    if (bestMin != minFps || bestMax != maxFps) {
+        ALOGD("Lowering preview fps range from (%d,%d) to (%d,%d)",
+                minFps, maxFps, bestMin, bestMax);
+        params.set(CameraParameters::KEY_PREVIEW_FPS_RANGE,
+                String8::format("%d,%d", bestMin, bestMax).string());
+        if (mCamera->setParameters(params.flatten()) != OK) {
+            ALOGW("Failed to set preview fps range to (%d,%d)",
+                    bestMin, bestMax);
+        } else {
+            mPreviewFpsRangeChanged = true;
+            mOriginalMinPreviewFps = minFps;
+            mOriginalMaxPreviewFps = maxFps;
+        }
+    }
+
+    IPCThreadState::self()->restoreCallingIdentity(token);
+}
+
+void CameraSourceTimeLapse::restorePreviewFpsRange() {
+    if (!mPreviewFpsRangeChanged || mCamera == 0) {
+        return;
+    }
+    mPreviewFpsRangeChanged = false;
+
+    ALOGV("restorePreviewFpsRange");
+    int64_t token = IPCThreadState::self()->clearCallingIdentity();
+    CameraParameters params(mCamera->getParameters());
+    params.set(CameraParameters::KEY_PREVIEW_FPS_RANGE,
+            String8::format("%d,%d",
+                    mOriginalMinPreviewFps, mOriginalMaxPreviewFps).string());
+    if (mCamera->setParameters(params.flatten()) != OK) {
+        ALOGW("Failed to restore preview fps range to (%d,%d)",
+                mOriginalMinPreviewFps, mOriginalMaxPreviewFps);
+    }
+    IPCThreadState::self()->restoreCallingIdentity(token);
+}
+
 void CameraSourceTimeLapse::signalBufferReturned(MediaBuffer* buffer) {
     ALOGV("signalBufferReturned");
     Mutex::Autolock autoLock(mQuickStopLock);
@@ -14,6 +14,10 @@
  * limitations under the License.
  */
 
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DataSource"
+#include <utils/Log.h>
+
 #include "include/AMRExtractor.h"
 
 #if CHROMIUM_AVAILABLE
@@ -21,6 +25,7 @@
 #endif
 
 #include "include/AACExtractor.h"
+#include "include/BlockCachedSource.h"
 #include "include/DRMExtractor.h"
 #include "include/FLACExtractor.h"
 #include "include/HTTPBase.h"
@@ -106,6 +111,114 @@ status_t DataSource::getSize(off64_t *size) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// The sniffers share a copy of the first kMaxSniffPrefixSize bytes of the source, read in
+// kSniffChunkSize steps as they need more of it.
+static const size_t kMaxSniffPrefixSize = 64 * 1024;
+static const size_t kSniffChunkSize = 4 * 1024;
+
+// Sniffers claiming a type with at least this confidence stop the sniffing, unless
+// media.stagefright.sniff-threshold says otherwise. The built-in sniffers report 0.6 at most
+// for a regular match, and 10 for the WVM and DRM types which have to override it; a vendor
+// sniffer is free to report anything in between, so nothing below 1 is safe by default.
+static const float kDefaultSniffThreshold = 1.0f;
+
+// Serves the reads of the sniffers from the shared prefix when they fall in it, so that
+// running all the registered sniffers costs a few reads of the source instead of several
+// reads per sniffer, each of which may be a network round trip for an HTTP source.
+// Only used with gSnifferMutex held.
+struct SniffSource : public DataSource {
+    SniffSource(const sp<DataSource> &source)
+        : mSource(source),
+          mData(NULL),
+          mSize(0),
+          mReachedEOS(false) {
+    }
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size);
+
+    virtual status_t getSize(off64_t *size) {
+        return mSource->getSize(size);
+    }
+
+    virtual uint32_t flags() {
+        return mSource->flags();
+    }
+
+    virtual sp<DecryptHandle> DrmInitialization(const char *mime = NULL) {
+        return mSource->DrmInitialization(mime);
+    }
+
+    virtual void getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client) {
+        mSource->getDrmInfo(handle, client);
+    }
+
+    virtual String8 getUri() {
+        return mSource->getUri();
+    }
+
+    virtual String8 getMIMEType() const {
+        return mSource->getMIMEType();
+    }
+
+protected:
+    virtual ~SniffSource() {
+        delete[] mData;
+        mData = NULL;
+    }
+
+private:
+    sp<DataSource> mSource;
+    uint8_t *mData;
+    size_t mSize;
+    bool mReachedEOS;
+
+    SniffSource(const SniffSource &);
+    SniffSource &operator=(const SniffSource &);
+};
+
+ssize_t SniffSource::readAt(off64_t offset, void *data, size_t size) {
+    if (offset < 0 || offset + size > kMaxSniffPrefixSize) {
+        return mSource->readAt(offset, data, size);
+    }
+
+    size_t end = offset + size;
+    if (end > mSize && !mReachedEOS) {
+        if (mData == NULL) {
+            mData = new uint8_t[kMaxSniffPrefixSize];
+        }
+
+        // only read what is needed, rounded up: for live streams, waiting for the whole
+        // prefix to be available could take several seconds
+        size_t newSize = (end + kSniffChunkSize - 1) / kSniffChunkSize * kSniffChunkSize;
+        if (newSize > kMaxSniffPrefixSize) {
+            newSize = kMaxSniffPrefixSize;
+        }
+
+        ssize_t n = mSource->readAt(mSize, mData + mSize, newSize - mSize);
+        if (n < 0) {
+            return n;
+        }
+        if ((size_t)n < newSize - mSize) {
+            mReachedEOS = true;
+        }
+        mSize += n;
+    }
+
+    if (offset >= mSize) {
+        return 0;
+    }
+    if (end > mSize) {
+        size = mSize - offset;
+    }
+    memcpy(data, mData + offset, size);
+
+    return size;
+}
+
 Mutex DataSource::gSnifferMutex;
 List<DataSource::SnifferFunc> DataSource::gSniffers;
 
@@ -115,19 +228,34 @@ bool DataSource::sniff(
     *confidence = 0.0f;
     meta->clear();
 
+    float threshold = kDefaultSniffThreshold;
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.sniff-threshold", value, NULL)) {
+        threshold = atof(value);
+    }
+
     Mutex::Autolock autoLock(gSnifferMutex);
+
+    sp<DataSource> source = new SniffSource(this);
+
     for (List<SnifferFunc>::iterator it = gSniffers.begin();
          it != gSniffers.end(); ++it) {
         String8 newMimeType;
         float newConfidence;
         sp<AMessage> newMeta;
-        if ((*it)(this, &newMimeType, &newConfidence, &newMeta)) {
+        if ((*it)(source, &newMimeType, &newConfidence, &newMeta)) {
             if (newConfidence > *confidence) {
                 *mimeType = newMimeType;
                 *confidence = newConfidence;
                 *meta = newMeta;
             }
         }
+
+        if (threshold > 0.0f && *confidence >= threshold) {
+            ALOGV("'%s' sniffed with confidence %.2f, skipping the remaining sniffers",
+                    mimeType->string(), *confidence);
+            break;
+        }
     }
 
     return *confidence > 0.0;
@@ -176,7 +304,7 @@ sp<DataSource> DataSource::CreateFromURI(
 
     sp<DataSource> source;
     if (!strncasecmp("file://", uri, 7)) {
-        source = new FileSource(uri + 7);
+        source = BlockCachedSource::Wrap(new FileSource(uri + 7));
     } else if (!strncasecmp("http://", uri, 7)
             || !strncasecmp("https://", uri, 8)
             || isWidevine) {
@@ -218,7 +346,7 @@ sp<DataSource> DataSource::CreateFromURI(
 #endif
     } else {
         // Assume it's a filename.
-        source = new FileSource(uri);
+        source = BlockCachedSource::Wrap(new FileSource(uri));
     }
 
     if (source == NULL || source->initCheck() != OK) {
@@ -16,14 +16,26 @@
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/FileSource.h>
+#include <cutils/properties.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 
 namespace android {
 
+// Files are only mapped up to this size, larger ones would use too much of the address space
+// of a 32 bit process and are read with pread() instead.
+static const int64_t kMaxMapSize = 128 * 1024 * 1024;
+
+// Number of back to back reads after which the access is considered sequential.
+static const int32_t kSequentialReadsThreshold = 4;
+
+// Amount of data the page cache is asked to read ahead of a sequential reader.
+static const int64_t kReadAheadSize = 1024 * 1024;
+
 FileSource::FileSource(const char *filename)
     : mFd(-1),
       mOffset(0),
@@ -32,12 +44,20 @@ FileSource::FileSource(const char *filename)
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
       mDrmBufSize(0),
-      mDrmBuf(NULL){
+      mDrmBuf(NULL),
+      mMapBase(NULL),
+      mMapSize(0),
+      mMapData(NULL),
+      mMapDataSize(0),
+      mNextSequentialOffset(-1),
+      mSequentialReads(0),
+      mReadAheadOffset(0) {
 
     mFd = open(filename, O_LARGEFILE | O_RDONLY);
 
     if (mFd >= 0) {
         mLength = lseek64(mFd, 0, SEEK_END);
+        mapFile();
     } else {
         ALOGE("Failed to open file '%s'. (%s)", filename, strerror(errno));
     }
@@ -51,12 +71,26 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
       mDrmBufSize(0),
-      mDrmBuf(NULL){
+      mDrmBuf(NULL),
+      mMapBase(NULL),
+      mMapSize(0),
+      mMapData(NULL),
+      mMapDataSize(0),
+      mNextSequentialOffset(-1),
+      mSequentialReads(0),
+      mReadAheadOffset(0) {
     CHECK(offset >= 0);
     CHECK(length >= 0);
+
+    mapFile();
 }
 
 FileSource::~FileSource() {
+    if (mMapBase != NULL) {
+        munmap(mMapBase, mMapSize);
+        mMapBase = NULL;
+    }
+
     if (mFd >= 0) {
         close(mFd);
         mFd = -1;
@@ -84,13 +118,96 @@ status_t FileSource::initCheck() const {
     return mFd >= 0 ? OK : NO_INIT;
 }
 
+// Maps the file if enabled by the media.stagefright.fs-mmap property. Off by default: a mapped
+// file truncated by another process while it is being played raises SIGBUS on the next read
+// of a page past the new end, instead of the read error the pread() path gets.
+void FileSource::mapFile() {
+    char value[PROPERTY_VALUE_MAX];
+    if (!property_get("media.stagefright.fs-mmap", value, NULL)
+            || (strcmp(value, "1") && strcasecmp(value, "true"))) {
+        return;
+    }
+
+    struct stat st;
+    if (fstat(mFd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return;
+    }
+
+    // the length given with a file descriptor is often larger than the file
+    int64_t dataSize = st.st_size - mOffset;
+    if (mLength >= 0 && mLength < dataSize) {
+        dataSize = mLength;
+    }
+    if (dataSize <= 0 || dataSize > kMaxMapSize) {
+        return;
+    }
+
+    int64_t pageSize = sysconf(_SC_PAGESIZE);
+    int64_t mapOffset = mOffset & ~(pageSize - 1);
+    if ((off_t)mapOffset != mapOffset) {
+        return;
+    }
+    size_t mapSize = (size_t)(mOffset - mapOffset + dataSize);
+
+    void *base = mmap(NULL, mapSize, PROT_READ, MAP_SHARED, mFd, (off_t)mapOffset);
+    if (base == MAP_FAILED) {
+        ALOGW("Failed to map %lld bytes, reading the file instead. (%s)",
+                dataSize, strerror(errno));
+        return;
+    }
+
+    mMapBase = base;
+    mMapSize = mapSize;
+    mMapData = (const uint8_t *)base + (mOffset - mapOffset);
+    mMapDataSize = dataSize;
+}
+
+// Gives the page cache hints based on the offsets read so far: once a few reads have followed
+// each other, the file is marked as sequential and the data ahead of the reader is requested
+// in kReadAheadSize chunks. A seek elsewhere reverts to the default policy until the reads
+// are sequential again. The hints are issued after mHintLock is released.
+void FileSource::updateAccessHints(off64_t offset, size_t size) {
+    int advice = -1;
+    int64_t willNeedOffset = -1;
+
+    {
+        Mutex::Autolock autoLock(mHintLock);
+
+        if (offset == mNextSequentialOffset) {
+            if (mSequentialReads < kSequentialReadsThreshold
+                    && ++mSequentialReads == kSequentialReadsThreshold) {
+                advice = POSIX_FADV_SEQUENTIAL;
+                mReadAheadOffset = offset;
+            }
+        } else {
+            if (mSequentialReads == kSequentialReadsThreshold) {
+                advice = POSIX_FADV_NORMAL;
+            }
+            mSequentialReads = 0;
+        }
+        mNextSequentialOffset = offset + size;
+
+        if (mSequentialReads == kSequentialReadsThreshold
+                && mNextSequentialOffset + kReadAheadSize / 2 > mReadAheadOffset) {
+            willNeedOffset = mReadAheadOffset > mNextSequentialOffset
+                    ? mReadAheadOffset : mNextSequentialOffset;
+            mReadAheadOffset = willNeedOffset + kReadAheadSize;
+        }
+    }
+
+    if (advice >= 0) {
+        posix_fadvise(mFd, mOffset, mLength >= 0 ? mLength : 0, advice);
+    }
+    if (willNeedOffset >= 0) {
+        posix_fadvise(mFd, mOffset + willNeedOffset, kReadAheadSize, POSIX_FADV_WILLNEED);
+    }
+}
+
 ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
     if (mFd < 0) {
         return NO_INIT;
     }
 
-    Mutex::Autolock autoLock(mLock);
-
     if (mLength >= 0) {
         if (offset >= mLength) {
             return 0;  // read beyond EOF.
@@ -103,16 +220,24 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
 
     if (mDecryptHandle != NULL && DecryptApiType::CONTAINER_BASED
             == mDecryptHandle->decryptApiType) {
+        Mutex::Autolock autoLock(mLock);
         return readAtDRM(offset, data, size);
-   } else {
-        off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
-        if (result == -1) {
-            ALOGE("seek to %lld failed", offset + mOffset);
-            return UNKNOWN_ERROR;
-        }
+    }
 
-        return ::read(mFd, data, size);
+    if (mMapData != NULL) {
+        if (offset >= mMapDataSize) {
+            return 0;  // read beyond EOF.
+        }
+        if ((int64_t)size > mMapDataSize - offset) {
+            size = mMapDataSize - offset;
+        }
+        memcpy(data, mMapData + offset, size);
+        return size;
     }
+
+    // pread() does not use the file position, so concurrent readers need no lock
+    updateAccessHints(offset, size);
+    return pread64(mFd, data, size, offset + mOffset);
 }
 
 status_t FileSource::getSize(off64_t *size) {
@@ -156,7 +281,9 @@ void FileSource::getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client
 }
 
 ssize_t FileSource::readAtDRM(off64_t offset, void *data, size_t size) {
-    size_t DRM_CACHE_SIZE = 1024;
+    // Every refill is a binder round trip to drmserver, and extractors read
+    // a few bytes at a time, so read well ahead of them.
+    size_t DRM_CACHE_SIZE = 64 * 1024;
     if (mDrmBuf == NULL) {
         mDrmBuf = new unsigned char[DRM_CACHE_SIZE];
     }
@@ -22,6 +22,7 @@
 
 #include "include/avc_utils.h"
 #include "include/ID3.h"
+#include "include/MP3FrameIndex.h"
 #include "include/VBRISeeker.h"
 #include "include/XINGSeeker.h"
 
@@ -214,7 +215,8 @@ public:
     MP3Source(
             const sp<MetaData> &meta, const sp<DataSource> &source,
             off64_t first_frame_pos, uint32_t fixed_header,
-            const sp<MP3Seeker> &seeker);
+            const sp<MP3Seeker> &seeker,
+            const sp<MP3FrameIndex> &frameIndex);
 
     virtual status_t start(MetaData *params = NULL);
     virtual status_t stop();
@@ -242,6 +244,13 @@ private:
     int64_t mBasisTimeUs;
     int64_t mSamplesRead;
 
+    // Set while mCurrentTimeUs is counted from a known frame rather than
+    // estimated from the bitrate, frames may then be added to mFrameIndex.
+    sp<MP3FrameIndex> mFrameIndex;
+    bool mTimeIsExact;
+
+    bool seekWithFrameIndex(int64_t seekTimeUs);
+
     MP3Source(const MP3Source &);
     MP3Source &operator=(const MP3Source &);
 };
@@ -331,6 +340,8 @@ MP3Extractor::MP3Extractor(
         // result in an extra 1152 samples being output. The real first frame to
         // decode is after the XING/VBRI frame, so skip there.
         mFirstFramePos += frame_size;
+    } else {
+        mFrameIndex = MP3FrameIndex::Get(mDataSource, mFirstFramePos);
     }
 
     int64_t durationUs;
@@ -395,7 +406,7 @@ sp<MediaSource> MP3Extractor::getTrack(size_t index) {
 
     return new MP3Source(
             mMeta, mDataSource, mFirstFramePos, mFixedHeader,
-            mSeeker);
+            mSeeker, mFrameIndex);
 }
 
 sp<MetaData> MP3Extractor::getTrackMetaData(size_t index, uint32_t flags) {
@@ -418,7 +429,8 @@ const size_t MP3Source::kMaxFrameSize = (1 << 12); /* 4096 bytes */
 MP3Source::MP3Source(
         const sp<MetaData> &meta, const sp<DataSource> &source,
         off64_t first_frame_pos, uint32_t fixed_header,
-        const sp<MP3Seeker> &seeker)
+        const sp<MP3Seeker> &seeker,
+        const sp<MP3FrameIndex> &frameIndex)
     : mMeta(meta),
       mDataSource(source),
       mFirstFramePos(first_frame_pos),
@@ -429,7 +441,9 @@ MP3Source::MP3Source(
       mSeeker(seeker),
       mGroup(NULL),
       mBasisTimeUs(0),
-      mSamplesRead(0) {
+      mSamplesRead(0),
+      mFrameIndex(frameIndex),
+      mTimeIsExact(false) {
 }
 
 MP3Source::~MP3Source() {
@@ -450,6 +464,7 @@ status_t MP3Source::start(MetaData *) {
 
     mBasisTimeUs = mCurrentTimeUs;
     mSamplesRead = 0;
+    mTimeIsExact = true;
 
     mStarted = true;
 
@@ -481,7 +496,10 @@ status_t MP3Source::read(
 
     if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
         int64_t actualSeekTimeUs = seekTimeUs;
-        if (mSeeker == NULL
+        if (mSeeker == NULL && mFrameIndex != NULL
+                && seekWithFrameIndex(seekTimeUs)) {
+            // mCurrentPos and mCurrentTimeUs were set from the index.
+        } else if (mSeeker == NULL
                 || !mSeeker->getOffsetForTime(&actualSeekTimeUs, &mCurrentPos)) {
             int32_t bitrate;
             if (!mMeta->findInt32(kKeyBitRate, &bitrate)) {
@@ -494,6 +512,7 @@ status_t MP3Source::read(
             mCurrentTimeUs = seekTimeUs;
             mCurrentPos = mFirstFramePos + seekTimeUs * bitrate / 8000000;
             seekCBR = true;
+            mTimeIsExact = false;
         } else {
             mCurrentTimeUs = actualSeekTimeUs;
         }
@@ -534,6 +553,10 @@ status_t MP3Source::read(
                 mBasisTimeUs = mCurrentTimeUs;
             }
 
+            if (mTimeIsExact && mFrameIndex != NULL) {
+                mFrameIndex->addFrame(mCurrentTimeUs, mCurrentPos);
+            }
+
             break;
         }
 
@@ -580,6 +603,73 @@ status_t MP3Source::read(
     return OK;
 }
 
+// Positions at the last frame starting at or before "seekTimeUs", going from
+// the closest indexed frame and walking the frame headers after it. The walk
+// is limited to a few seconds on caching (network) sources, where it would
+// otherwise download the file up to the requested time.
+bool MP3Source::seekWithFrameIndex(int64_t seekTimeUs) {
+    static const int64_t kMaxNetworkScanUs = 3000000ll;
+
+    int64_t timeUs = seekTimeUs;
+    off64_t pos;
+    if (!mFrameIndex->getOffsetForTime(&timeUs, &pos)) {
+        return false;
+    }
+
+    if (seekTimeUs - timeUs > kMaxNetworkScanUs
+            && (mDataSource->flags() & DataSource::kIsCachingDataSource)) {
+        return false;
+    }
+
+    int64_t frameTimeUs = timeUs;
+    int64_t numSamples = 0;
+    for (;;) {
+        uint8_t data[4];
+        if (mDataSource->readAt(pos, data, 4) < 4) {
+            break;
+        }
+
+        uint32_t header = U32_AT(data);
+
+        size_t frame_size;
+        int sample_rate;
+        int bitrate;
+        int num_samples;
+        if ((header & kMask) != (mFixedHeader & kMask)
+                || !GetMPEGAudioFrameSize(
+                    header, &frame_size, &sample_rate, NULL,
+                    &bitrate, &num_samples)) {
+            off64_t syncPos = pos;
+            if (!Resync(mDataSource, mFixedHeader, &syncPos, NULL, NULL)) {
+                break;
+            }
+            pos = syncPos;
+            continue;
+        }
+
+        int64_t nextTimeUs =
+            timeUs + ((numSamples + num_samples) * 1000000) / sample_rate;
+        if (nextTimeUs > seekTimeUs) {
+            break;
+        }
+
+        mFrameIndex->addFrame(frameTimeUs, pos);
+
+        numSamples += num_samples;
+        pos += frame_size;
+        frameTimeUs = nextTimeUs;
+    }
+
+    ALOGV("frame index seek to %lld: %lld us at %lld",
+          seekTimeUs, frameTimeUs, pos);
+
+    mCurrentPos = pos;
+    mCurrentTimeUs = frameTimeUs;
+    mTimeIsExact = true;
+
+    return true;
+}
+
 sp<MetaData> MP3Extractor::getMetaData() {
     sp<MetaData> meta = new MetaData;
 
@@ -636,6 +726,16 @@ sp<MetaData> MP3Extractor::getMetaData() {
 
     size_t dataSize;
     String8 mime;
+    off64_t dataOffset;
+    if (id3.getAlbumArtRange(&dataOffset, &dataSize, &mime)) {
+        // Don't read what most users of the metadata never look at.
+        meta->setInt64(kKeyAlbumArtOffset, dataOffset);
+        meta->setInt32(kKeyAlbumArtSize, dataSize);
+        meta->setCString(kKeyAlbumArtMIME, mime.string());
+
+        return meta;
+    }
+
     const void *data = id3.getAlbumArt(&dataSize, &mime);
 
     if (data) {
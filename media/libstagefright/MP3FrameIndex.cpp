@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MP3FrameIndex"
+#include <utils/Log.h>
+
+#include "include/MP3FrameIndex.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/DataSource.h>
+
+namespace android {
+
+Mutex MP3FrameIndex::gCacheLock;
+Vector<sp<MP3FrameIndex> > MP3FrameIndex::gCache;
+
+// static
+sp<MP3FrameIndex> MP3FrameIndex::Get(
+        const sp<DataSource> &source, off64_t firstFramePos) {
+    Key key;
+    if (source->getSize(&key.mFileSize) != OK) {
+        // Streams of unknown length can neither be identified nor scanned.
+        return NULL;
+    }
+    key.mFirstFramePos = firstFramePos;
+
+    uint8_t data[kIdentityBytes];
+    ssize_t n = source->readAt(firstFramePos, data, sizeof(data));
+    if (n <= 0) {
+        return NULL;
+    }
+
+    // FNV-1a
+    key.mHash = 2166136261u;
+    for (ssize_t i = 0; i < n; ++i) {
+        key.mHash = (key.mHash ^ data[i]) * 16777619u;
+    }
+
+    Mutex::Autolock autoLock(gCacheLock);
+
+    for (size_t i = 0; i < gCache.size(); ++i) {
+        sp<MP3FrameIndex> index = gCache.itemAt(i);
+        const Key &other = index->mKey;
+        if (other.mFileSize == key.mFileSize
+                && other.mFirstFramePos == key.mFirstFramePos
+                && other.mHash == key.mHash) {
+            ALOGV("reusing index of %d entries", index->mEntries.size());
+            gCache.removeAt(i);
+            gCache.push(index);
+            return index;
+        }
+    }
+
+    if (gCache.size() >= kMaxNumCachedIndices) {
+        gCache.removeAt(0);
+    }
+
+    sp<MP3FrameIndex> index = new MP3FrameIndex(key);
+    index->addFrame(0, firstFramePos);
+    gCache.push(index);
+
+    return index;
+}
+
+MP3FrameIndex::MP3FrameIndex(const Key &key)
+    : mKey(key) {
+}
+
+MP3FrameIndex::~MP3FrameIndex() {
+}
+
+void MP3FrameIndex::addFrame(int64_t timeUs, off64_t pos) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mEntries.isEmpty()) {
+        const Entry &last = mEntries.top();
+        if (timeUs < last.mTimeUs + kIndexIntervalUs || pos <= last.mPos) {
+            return;
+        }
+    } else if (timeUs != 0) {
+        // The index must start at the first frame to have no gaps.
+        return;
+    }
+
+    if (mEntries.size() >= kMaxNumEntries) {
+        return;
+    }
+
+    Entry entry;
+    entry.mTimeUs = timeUs;
+    entry.mPos = pos;
+    mEntries.push(entry);
+}
+
+bool MP3FrameIndex::getOffsetForTime(int64_t *timeUs, off64_t *pos) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mEntries.isEmpty()) {
+        return false;
+    }
+
+    size_t lo = 0;
+    size_t hi = mEntries.size();
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mEntries.itemAt(mid).mTimeUs <= *timeUs) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    *timeUs = mEntries.itemAt(lo).mTimeUs;
+    *pos = mEntries.itemAt(lo).mPos;
+
+    return true;
+}
+
+int64_t MP3FrameIndex::indexedDurationUs() {
+    Mutex::Autolock autoLock(mLock);
+
+    return mEntries.isEmpty() ? 0 : mEntries.top().mTimeUs + kIndexIntervalUs;
+}
+
+}  // namespace android
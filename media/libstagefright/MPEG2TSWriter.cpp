@@ -513,6 +513,9 @@ void MPEG2TSWriter::init() {
 
     initCrcTable();
 
+    mTSPackets = new ABuffer(kTSPacketsPerBatch * kTSPacketSize);
+    mTSPackets->setRange(0, 0);
+
     mLooper = new ALooper;
     mLooper->setName("MPEG2TSWriter");
 
@@ -563,6 +566,10 @@ status_t MPEG2TSWriter::start(MetaData *param) {
     mNumTSPacketsWritten = 0;
     mNumTSPacketsBeforeMeta = 0;
 
+    // The sources are fixed by now, so the PSI tables can be built once.
+    mProgramAssociationTable = buildProgramAssociationTable();
+    mProgramMap = buildProgramMap();
+
     for (size_t i = 0; i < mSources.size(); ++i) {
         sp<AMessage> notify =
             new AMessage(kWhatSourceNotify, mReflector->id());
@@ -702,7 +709,7 @@ void MPEG2TSWriter::onMessageReceived(const sp<AMessage> &msg) {
     }
 }
 
-void MPEG2TSWriter::writeProgramAssociationTable() {
+sp<ABuffer> MPEG2TSWriter::buildProgramAssociationTable() {
     // 0x47
     // transport_error_indicator = b0
     // payload_unit_start_indicator = b1
@@ -739,22 +746,19 @@ void MPEG2TSWriter::writeProgramAssociationTable() {
         0x00, 0x00, 0x00, 0x00   // b???? ???? ???? ???? ???? ???? ???? ????
     };
 
-    sp<ABuffer> buffer = new ABuffer(188);
+    sp<ABuffer> buffer = new ABuffer(kTSPacketSize);
     memset(buffer->data(), 0xff, buffer->size());
     memcpy(buffer->data(), kData, sizeof(kData));
 
-    if (++mPATContinuityCounter == 16) {
-        mPATContinuityCounter = 0;
-    }
-    buffer->data()[3] |= mPATContinuityCounter;
-
+    // The CRC only covers the section, not the continuity counter, so it
+    // is computed once here and the counter is patched in on every write.
     uint32_t crc = htonl(crc32(&buffer->data()[5], 12));
     memcpy(&buffer->data()[17], &crc, sizeof(crc));
 
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
+    return buffer;
 }
 
-void MPEG2TSWriter::writeProgramMap() {
+sp<ABuffer> MPEG2TSWriter::buildProgramMap() {
     // 0x47
     // transport_error_indicator = b0
     // payload_unit_start_indicator = b1
@@ -796,15 +800,10 @@ void MPEG2TSWriter::writeProgramMap() {
         0xe0, 0x00, 0xf0, 0x00   // b111? ???? ???? ???? 1111 0000 0000 0000
     };
 
-    sp<ABuffer> buffer = new ABuffer(188);
+    sp<ABuffer> buffer = new ABuffer(kTSPacketSize);
     memset(buffer->data(), 0xff, buffer->size());
     memcpy(buffer->data(), kData, sizeof(kData));
 
-    if (++mPMTContinuityCounter == 16) {
-        mPMTContinuityCounter = 0;
-    }
-    buffer->data()[3] |= mPMTContinuityCounter;
-
     size_t section_length = 5 * mSources.size() + 4 + 9;
     buffer->data()[6] |= section_length >> 8;
     buffer->data()[7] = section_length & 0xff;
@@ -827,7 +826,27 @@ void MPEG2TSWriter::writeProgramMap() {
     uint32_t crc = htonl(crc32(&buffer->data()[5], 12+mSources.size()*5));
     memcpy(&buffer->data()[17+mSources.size()*5], &crc, sizeof(crc));
 
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
+    return buffer;
+}
+
+void MPEG2TSWriter::writeProgramAssociationTable() {
+    uint8_t *packet = appendTSPacket();
+    memcpy(packet, mProgramAssociationTable->data(), kTSPacketSize);
+
+    if (++mPATContinuityCounter == 16) {
+        mPATContinuityCounter = 0;
+    }
+    packet[3] |= mPATContinuityCounter;
+}
+
+void MPEG2TSWriter::writeProgramMap() {
+    uint8_t *packet = appendTSPacket();
+    memcpy(packet, mProgramMap->data(), kTSPacketSize);
+
+    if (++mPMTContinuityCounter == 16) {
+        mPMTContinuityCounter = 0;
+    }
+    packet[3] |= mPMTContinuityCounter;
 }
 
 void MPEG2TSWriter::writeAccessUnit(
@@ -867,9 +886,6 @@ void MPEG2TSWriter::writeAccessUnit(
     // reserved = b1
     // the first fragment of "buffer" follows
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0xff, buffer->size());
-
     const unsigned PID = 0x1e0 + sourceIndex + 1;
 
     const unsigned continuity_counter =
@@ -896,7 +912,8 @@ void MPEG2TSWriter::writeAccessUnit(
         PES_packet_length = 0;
     }
 
-    uint8_t *ptr = buffer->data();
+    uint8_t *packet = appendTSPacket();
+    uint8_t *ptr = packet;
     *ptr++ = 0x47;
     *ptr++ = 0x40 | (PID >> 8);
     *ptr++ = PID & 0xff;
@@ -924,7 +941,7 @@ void MPEG2TSWriter::writeAccessUnit(
     *ptr++ = (PTS >> 7) & 0xff;
     *ptr++ = ((PTS & 0x7f) << 1) | 1;
 
-    size_t sizeLeft = buffer->data() + buffer->size() - ptr;
+    size_t sizeLeft = packet + kTSPacketSize - ptr;
     size_t copy = accessUnit->size();
     if (copy > sizeLeft) {
         copy = sizeLeft;
@@ -932,8 +949,6 @@ void MPEG2TSWriter::writeAccessUnit(
 
     memcpy(ptr, accessUnit->data(), copy);
 
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
-
     size_t offset = copy;
     while (offset < accessUnit->size()) {
         bool lastAccessUnit = ((accessUnit->size() - offset) < 184);
@@ -948,12 +963,11 @@ void MPEG2TSWriter::writeAccessUnit(
         // continuity_counter = b????
         // the fragment of "buffer" follows.
 
-        memset(buffer->data(), 0xff, buffer->size());
-
         const unsigned continuity_counter =
             mSources.editItemAt(sourceIndex)->incrementContinuityCounter();
 
-        ptr = buffer->data();
+        packet = appendTSPacket();
+        ptr = packet;
         *ptr++ = 0x47;
         *ptr++ = 0x00 | (PID >> 8);
         *ptr++ = PID & 0xff;
@@ -970,18 +984,19 @@ void MPEG2TSWriter::writeAccessUnit(
             }
         }
 
-        size_t sizeLeft = buffer->data() + buffer->size() - ptr;
+        size_t sizeLeft = packet + kTSPacketSize - ptr;
         size_t copy = accessUnit->size() - offset;
         if (copy > sizeLeft) {
             copy = sizeLeft;
         }
 
         memcpy(ptr, accessUnit->data() + offset, copy);
-        CHECK_EQ(internalWrite(buffer->data(), buffer->size()),
-                 buffer->size());
 
         offset += copy;
     }
+
+    // Any PSI packets written just before are in the same batch.
+    flushTSPackets();
 }
 
 void MPEG2TSWriter::writeTS() {
@@ -1020,9 +1035,44 @@ uint32_t MPEG2TSWriter::crc32(const uint8_t *p_start, size_t length) {
     return crc;
 }
 
+uint8_t *MPEG2TSWriter::appendTSPacket() {
+    size_t offset = mTSPackets->size();
+    if (offset + kTSPacketSize > mTSPackets->capacity()) {
+        // Doubled and kept, so once the largest access units have been
+        // seen packetizing doesn't allocate anymore.
+        sp<ABuffer> buffer = new ABuffer(2 * mTSPackets->capacity());
+        memcpy(buffer->data(), mTSPackets->data(), offset);
+        mTSPackets = buffer;
+    }
+
+    mTSPackets->setRange(0, offset + kTSPacketSize);
+    ++mNumTSPacketsWritten;
+
+    uint8_t *packet = mTSPackets->data() + offset;
+    memset(packet, 0xff, kTSPacketSize);
+
+    return packet;
+}
+
+void MPEG2TSWriter::flushTSPackets() {
+    const uint8_t *data = mTSPackets->data();
+    size_t size = mTSPackets->size();
+
+    // Sockets and pipes may take less than all of it.
+    while (size > 0) {
+        ssize_t n = internalWrite(data, size);
+        CHECK_GT(n, 0);
+
+        data += n;
+        size -= n;
+    }
+
+    mTSPackets->setRange(0, 0);
+}
+
 ssize_t MPEG2TSWriter::internalWrite(const void *data, size_t size) {
     if (mFile != NULL) {
-        return fwrite(data, 1, size, mFile);
+        return (ssize_t)fwrite(data, 1, size, mFile);
     }
 
     return (*mWriteFunc)(mWriteCookie, data, size);
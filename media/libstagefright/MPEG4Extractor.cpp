@@ -1869,6 +1869,12 @@ status_t MPEG4Extractor::parseSegmentIndex(off64_t offset, size_t size) {
         return ERROR_MALFORMED;
     }
     ALOGV("sidx refid/timescale: %d/%d", referenceId, timeScale);
+    if (timeScale == 0) {
+        return ERROR_MALFORMED;
+    }
+
+    // Segment offsets are relative to the first byte following the sidx box.
+    off64_t anchorOffset = offset + size;
 
     uint64_t earliestPresentationTime;
     uint64_t firstOffset;
@@ -1922,7 +1928,15 @@ status_t MPEG4Extractor::parseSegmentIndex(off64_t offset, size_t size) {
         return -EINVAL;
     }
 
+    if (mSidxEntries.size() != 0) {
+        // The segments of all tracks are interleaved in the same moofs, a
+        // second sidx only indexes them again for another track.
+        ALOGW("ignoring additional sidx box for reference %d", referenceId);
+        return OK;
+    }
+
     uint64_t total_duration = 0;
+    off64_t segmentOffset = anchorOffset + firstOffset;
     for (unsigned int i = 0; i < referenceCount; i++) {
         uint32_t d1, d2, d3;
 
@@ -1940,13 +1954,16 @@ status_t MPEG4Extractor::parseSegmentIndex(off64_t offset, size_t size) {
         if (!sap || saptype > 2) {
             ALOGW("not a stream access point, or unsupported type");
         }
-        total_duration += d2;
         offset += 12;
         ALOGV(" item %d, %08x %08x %08x", i, d1, d2, d3);
         SidxEntry se;
         se.mSize = d1 & 0x7fffffff;
         se.mDurationUs = 1000000LL * d2 / timeScale;
+        se.mStartTimeUs = total_duration * 1000000 / timeScale;
+        se.mOffset = segmentOffset;
         mSidxEntries.add(se);
+        total_duration += d2;
+        segmentOffset += se.mSize;
     }
 
     mSidxDuration = total_duration * 1000000 / timeScale;
@@ -2435,6 +2452,7 @@ MPEG4Source::MPEG4Source(
       mSegments(sidx),
       mFirstMoofOffset(firstMoofOffset),
       mCurrentMoofOffset(firstMoofOffset),
+      mNextMoofOffset(firstMoofOffset),
       mCurrentTime(0),
       mCurrentSampleInfoAllocSize(0),
       mCurrentSampleInfoSizes(NULL),
@@ -3394,32 +3412,39 @@ status_t MPEG4Source::fragmentedRead(
     ReadOptions::SeekMode mode;
     if (options && options->getSeekTo(&seekTimeUs, &mode)) {
 
-        int numSidxEntries = mSegments.size();
+        size_t numSidxEntries = mSegments.size();
         if (numSidxEntries != 0) {
-            int64_t totalTime = 0;
-            off64_t totalOffset = mFirstMoofOffset;
-            for (int i = 0; i < numSidxEntries; i++) {
-                const SidxEntry *se = &mSegments[i];
-                if (totalTime + se->mDurationUs > seekTimeUs) {
-                    // The requested time is somewhere in this segment
-                    if ((mode == ReadOptions::SEEK_NEXT_SYNC) ||
-                        (mode == ReadOptions::SEEK_CLOSEST_SYNC &&
-                        (seekTimeUs - totalTime) > (totalTime + se->mDurationUs - seekTimeUs))) {
-                        // requested next sync, or closest sync and it was closer to the end of
-                        // this segment
-                        totalTime += se->mDurationUs;
-                        totalOffset += se->mSize;
-                    }
-                    break;
+            // Find the last segment starting at or before the requested time.
+            size_t lo = 0;
+            size_t hi = numSidxEntries;
+            while (hi - lo > 1) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (mSegments[mid].mStartTimeUs <= seekTimeUs) {
+                    lo = mid;
+                } else {
+                    hi = mid;
                 }
-                totalTime += se->mDurationUs;
+            }
+
+            const SidxEntry *se = &mSegments[lo];
+            int64_t totalTime = se->mStartTimeUs;
+            off64_t totalOffset = se->mOffset;
+            int64_t segmentEndUs = totalTime + se->mDurationUs;
+            if (seekTimeUs >= segmentEndUs
+                    || mode == ReadOptions::SEEK_NEXT_SYNC
+                    || (mode == ReadOptions::SEEK_CLOSEST_SYNC
+                        && (seekTimeUs - totalTime) > (segmentEndUs - seekTimeUs))) {
+                // past the end of the index, requested next sync, or closest
+                // sync and it was closer to the end of this segment
+                totalTime = segmentEndUs;
                 totalOffset += se->mSize;
             }
-        mCurrentMoofOffset = totalOffset;
-        mCurrentSamples.clear();
-        mCurrentSampleIndex = 0;
-        parseChunk(&totalOffset);
-        mCurrentTime = totalTime * mTimescale / 1000000ll;
+
+            mCurrentMoofOffset = totalOffset;
+            mCurrentSamples.clear();
+            mCurrentSampleIndex = 0;
+            parseChunk(&totalOffset);
+            mCurrentTime = totalTime * mTimescale / 1000000ll;
         }
 
         if (mBuffer != NULL) {
@@ -3438,17 +3463,19 @@ status_t MPEG4Source::fragmentedRead(
     if (mBuffer == NULL) {
         newBuffer = true;
 
-        if (mCurrentSampleIndex >= mCurrentSamples.size()) {
-            // move to next fragment
-            Sample lastSample = mCurrentSamples[mCurrentSamples.size() - 1];
-            off64_t nextMoof = mNextMoofOffset; // lastSample.offset + lastSample.size;
+        // move to the next fragment, skipping those without samples for
+        // this track
+        while (mCurrentSampleIndex >= mCurrentSamples.size()) {
+            off64_t nextMoof = mNextMoofOffset;
+            if (nextMoof <= mCurrentMoofOffset) {
+                return ERROR_END_OF_STREAM;
+            }
             mCurrentMoofOffset = nextMoof;
             mCurrentSamples.clear();
             mCurrentSampleIndex = 0;
-            parseChunk(&nextMoof);
-                if (mCurrentSampleIndex >= mCurrentSamples.size()) {
-                    return ERROR_END_OF_STREAM;
-                }
+            if (parseChunk(&nextMoof) != OK) {
+                return ERROR_END_OF_STREAM;
+            }
         }
 
         const Sample *smpl = &mCurrentSamples[mCurrentSampleIndex];
@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include <arpa/inet.h>
+#include <errno.h>
 
 #include <pthread.h>
 #include <sys/prctl.h>
@@ -37,6 +38,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 #include "include/ESDS.h"
 
@@ -50,6 +52,10 @@ static const int64_t kMax64BitFileSize = 0x00ffffffffLL; //fat32 max size limite
 static const uint8_t kNalUnitTypeSeqParamSet = 0x07;
 static const uint8_t kNalUnitTypePicParamSet = 0x08;
 static const int64_t kInitialDelayTimeUs     = 700000LL;
+static const size_t  kMaxWriteIovecs         = 64;
+static const size_t  kDefaultWriteBatchBytes = 512 * 1024;
+static const size_t  kDefaultChunkQueueBytes = 32 * 1024 * 1024;
+static const int64_t kChunkQueueWaitTimeNs   = 100000000LL;  // 100 ms
 
 class MPEG4Writer::Track {
 public:
@@ -71,6 +77,8 @@ public:
     bool isMPEG4() const { return mIsMPEG4; }
     void addChunkOffset(off64_t offset);
     int32_t getTrackId() const { return mTrackId; }
+    bool isDone() const { return mDone; }
+    void writeMoofBox(const Chunk &chunk, uint32_t sequenceNumber);
     status_t dump(int fd, const Vector<String16>& args) const;
 
 private:
@@ -224,6 +232,14 @@ private:
 
     List<MediaBuffer *> mChunkSamples;
 
+    uint32_t            mNumSamples;
+    bool                mHasSyncSample;
+
+    // Fragmented file: the samples of the current fragment are kept in
+    // mChunkSamples, and described here instead of in the tables below.
+    Vector<FragmentSample> mFragmentSamples;
+    int64_t             mFragmentStartTimeUs;  // Decoding time of the 1st sample
+
     bool                mSamplesHaveSameSize;
     ListTableEntries<uint32_t> *mStszTableEntries;
 
@@ -295,6 +311,10 @@ private:
     int32_t mRotation;
 
     void updateTrackSizeEstimate();
+    void addFragmentSample(
+            MediaBuffer *buffer, size_t sampleSize, int64_t decodingTimeUs,
+            int64_t previousDurationTicks, int64_t cttsOffsetTicks, bool isSync);
+    void bufferFragment();
     void addOneStscTableEntry(size_t chunkId, size_t sampleId);
     void addOneStssTableEntry(size_t sampleId);
 
@@ -351,7 +371,12 @@ MPEG4Writer::MPEG4Writer(const char *filename)
       mLatitudex10000(0),
       mLongitudex10000(0),
       mAreGeoTagsAvailable(false),
-      mStartTimeOffsetMs(-1) {
+      mStartTimeOffsetMs(-1),
+      mFragmentDurationUs(0),
+      mFragmentSequenceNumber(0),
+      mFragmentedMoovOffset(0),
+      mFragmentedMoovSize(0),
+      mWriteBatchBytes(kDefaultWriteBatchBytes) {
 
     mFd = open(filename, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
     if (mFd >= 0) {
@@ -376,7 +401,12 @@ MPEG4Writer::MPEG4Writer(int fd)
       mLatitudex10000(0),
       mLongitudex10000(0),
       mAreGeoTagsAvailable(false),
-      mStartTimeOffsetMs(-1) {
+      mStartTimeOffsetMs(-1),
+      mFragmentDurationUs(0),
+      mFragmentSequenceNumber(0),
+      mFragmentedMoovOffset(0),
+      mFragmentedMoovSize(0),
+      mWriteBatchBytes(kDefaultWriteBatchBytes) {
 }
 
 MPEG4Writer::~MPEG4Writer() {
@@ -400,6 +430,22 @@ status_t MPEG4Writer::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     mStarted: %s\n", mStarted? "true": "false");
     result.append(buffer);
+    {
+        Mutex::Autolock autoLock(mLock);
+        size_t queuedChunks = 0;
+        for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+             it != mChunkInfos.end(); ++it) {
+            queuedChunks += it->mChunks.size();
+        }
+        snprintf(buffer, SIZE, "     chunk queue: %d chunks, %d bytes"
+                " (peak %d, budget %d)\n",
+                queuedChunks, mQueuedChunkBytes, mPeakQueuedChunkBytes,
+                mChunkQueueBudgetBytes);
+        result.append(buffer);
+        snprintf(buffer, SIZE, "     back-pressure: %d waits, %lld ms\n",
+                mNumChunkQueueWaits, mChunkQueueWaitTimeUs / 1000);
+        result.append(buffer);
+    }
     ::write(fd, result.string(), result.size());
     for (List<Track *>::iterator it = mTracks.begin();
          it != mTracks.end(); ++it) {
@@ -418,7 +464,7 @@ status_t MPEG4Writer::Track::dump(
     snprintf(buffer, SIZE, "       reached EOS: %s\n",
             mReachedEOS? "true": "false");
     result.append(buffer);
-    snprintf(buffer, SIZE, "       frames encoded : %d\n", mStszTableEntries->count());
+    snprintf(buffer, SIZE, "       frames encoded : %d\n", mNumSamples);
     result.append(buffer);
     snprintf(buffer, SIZE, "       duration encoded : %lld us\n", mTrackDurationUs);
     result.append(buffer);
@@ -604,6 +650,22 @@ status_t MPEG4Writer::start(MetaData *param) {
         mUse4ByteNalLength = false;
     }
 
+    int64_t fragmentDurationUs;
+    if (param &&
+        param->findInt64(kKeyFragmentDurationUs, &fragmentDurationUs) &&
+        fragmentDurationUs > 0 && !mStarted) {
+        mFragmentDurationUs = fragmentDurationUs;
+    }
+
+    mWriteBatchBytes = kDefaultWriteBatchBytes;
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.mp4-write-kb", value, NULL)) {
+        int writeBatchKBytes = atoi(value);
+        if (writeBatchKBytes > 0) {
+            mWriteBatchBytes = writeBatchKBytes * 1024;
+        }
+    }
+
     int32_t isRealTimeRecording;
     if (param && param->findInt32(kKeyRealTimeRecording, &isRealTimeRecording)) {
         mIsRealTimeRecording = isRealTimeRecording;
@@ -636,6 +698,14 @@ status_t MPEG4Writer::start(MetaData *param) {
         (mMaxFileSizeLimitBytes != 0 &&
          mMaxFileSizeLimitBytes >= kMinStreamableFileSizeInBytes);
 
+    /*
+     * A fragmented file has its moov box right after the ftyp box already,
+     * and needs no space reserved for it.
+     */
+    if (isFragmented()) {
+        mStreamableFile = false;
+    }
+
     /*
      * mWriteMoovBoxToMemory is true if the amount of data in moov box is
      * smaller than the reserved free space at the beginning of a file, AND
@@ -688,7 +758,15 @@ status_t MPEG4Writer::start(MetaData *param) {
         mEstimatedMoovBoxSize = estimateMoovBoxSize(bitRate);
     }
     CHECK_GE(mEstimatedMoovBoxSize, 8);
-    if (mStreamableFile) {
+    if (isFragmented()) {
+        // The moov box is written with the first fragment, once the codec
+        // specific data of all the tracks is known, and there is no single
+        // mdat box.
+        mFragmentedMoovOffset = mOffset;
+        mFragmentedMoovSize = 0;
+        mFragmentSequenceNumber = 0;
+        mMdatOffset = mOffset;
+    } else if (mStreamableFile) {
         // Reserve a 'free' box only for streamable file
         lseek64(mFd, mFreeBoxOffset, SEEK_SET);
         writeInt32(mEstimatedMoovBoxSize);
@@ -700,7 +778,9 @@ status_t MPEG4Writer::start(MetaData *param) {
 
     mOffset = mMdatOffset;
     lseek64(mFd, mMdatOffset, SEEK_SET);
-    if (mUse32BitOffset) {
+    if (isFragmented()) {
+        // Nothing to write before the first fragment
+    } else if (mUse32BitOffset) {
         write("????mdat", 8);
     } else {
         write("\x00\x00\x00\x01mdat????????", 16);
@@ -864,6 +944,26 @@ status_t MPEG4Writer::reset() {
         return err;
     }
 
+    if (isFragmented()) {
+        // All the samples are in the fragments already. Write the moov box
+        // again in place with the final durations, nothing else in it
+        // changes and so neither does its size.
+        if (mFragmentedMoovSize > 0) {
+            off64_t endOffset = mOffset;
+            mOffset = mFragmentedMoovOffset;
+            lseek64(mFd, mOffset, SEEK_SET);
+            writeMoovBox(maxDurationUs);
+            CHECK_EQ(mOffset - mFragmentedMoovOffset, mFragmentedMoovSize);
+            mOffset = endOffset;
+            lseek64(mFd, mOffset, SEEK_SET);
+        }
+
+        CHECK(mBoxes.empty());
+
+        release();
+        return err;
+    }
+
     // Fix up the size of the 'mdat' chunk.
     if (mUse32BitOffset) {
         lseek64(mFd, mMdatOffset, SEEK_SET);
@@ -969,9 +1069,35 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
         it != mTracks.end(); ++it, ++id) {
         (*it)->writeTrackHeader(mUse32BitOffset);
     }
+    if (isFragmented()) {
+        writeMvexBox(durationUs);
+    }
     endBox();  // moov
 }
 
+void MPEG4Writer::writeMvexBox(int64_t durationUs) {
+    beginBox("mvex");
+    beginBox("mehd");
+    writeInt32(0);             // version=0, flags=0
+    int32_t duration = (durationUs * mTimeScale + 5E5) / 1E6;
+    writeInt32(duration);      // fragment duration, in mvhd timescale
+    endBox();  // mehd
+    for (List<Track *>::iterator it = mTracks.begin();
+        it != mTracks.end(); ++it) {
+        // Every sample is fully described in the track fragment runs,
+        // the defaults are not used.
+        beginBox("trex");
+        writeInt32(0);         // version=0, flags=0
+        writeInt32((*it)->getTrackId());
+        writeInt32(1);         // default sample description index
+        writeInt32(0);         // default sample duration
+        writeInt32(0);         // default sample size
+        writeInt32(0);         // default sample flags
+        endBox();  // trex
+    }
+    endBox();  // mvex
+}
+
 void MPEG4Writer::writeFtypBox(MetaData *param) {
     beginBox("ftyp");
 
@@ -1032,6 +1158,30 @@ void MPEG4Writer::unlock() {
     mLock.unlock();
 }
 
+// Writes all of the given buffers, retrying after partial writes.
+static void writevFully(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("writev failed: %s", strerror(errno));
+            return;
+        }
+
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
 off64_t MPEG4Writer::addSample_l(MediaBuffer *buffer) {
     off64_t old_offset = mOffset;
 
@@ -1044,6 +1194,70 @@ off64_t MPEG4Writer::addSample_l(MediaBuffer *buffer) {
     return old_offset;
 }
 
+off64_t MPEG4Writer::addSamples_l(bool isAvc, List<MediaBuffer *> *samples) {
+    off64_t old_offset = mOffset;
+
+    // The samples are gathered into writev() calls of up to
+    // mWriteBatchBytes, instead of one or more write() calls per sample,
+    // so that the writer thread does not stall on many small writes.
+    struct iovec iov[kMaxWriteIovecs];
+    MediaBuffer *buffers[kMaxWriteIovecs];
+    uint8_t prefixes[kMaxWriteIovecs][4];
+    size_t numIovecs = 0;
+    size_t numBuffers = 0;
+    size_t batchBytes = 0;
+
+    while (!samples->empty()) {
+        List<MediaBuffer *>::iterator it = samples->begin();
+        MediaBuffer *buffer = *it;
+        samples->erase(it);
+
+        size_t length = buffer->range_length();
+        if (isAvc) {
+            uint8_t *prefix = prefixes[numBuffers];
+            if (mUse4ByteNalLength) {
+                prefix[0] = length >> 24;
+                prefix[1] = (length >> 16) & 0xff;
+                prefix[2] = (length >> 8) & 0xff;
+                prefix[3] = length & 0xff;
+                iov[numIovecs].iov_len = 4;
+            } else {
+                CHECK_LT(length, 65536);
+
+                prefix[0] = length >> 8;
+                prefix[1] = length & 0xff;
+                iov[numIovecs].iov_len = 2;
+            }
+            iov[numIovecs].iov_base = prefix;
+            batchBytes += iov[numIovecs].iov_len;
+            ++numIovecs;
+        }
+
+        iov[numIovecs].iov_base =
+            (uint8_t *)buffer->data() + buffer->range_offset();
+        iov[numIovecs].iov_len = length;
+        ++numIovecs;
+        batchBytes += length;
+        buffers[numBuffers++] = buffer;
+
+        if (numIovecs + 2 > kMaxWriteIovecs
+                || batchBytes >= mWriteBatchBytes || samples->empty()) {
+            writevFully(mFd, iov, numIovecs);
+            mOffset += batchBytes;
+
+            for (size_t i = 0; i < numBuffers; ++i) {
+                buffers[i]->release();
+                buffers[i] = NULL;
+            }
+            numIovecs = 0;
+            numBuffers = 0;
+            batchBytes = 0;
+        }
+    }
+
+    return old_offset;
+}
+
 static void StripStartcode(MediaBuffer *buffer) {
     if (buffer->range_length() < 4) {
         return;
@@ -1063,32 +1277,29 @@ off64_t MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
 
     size_t length = buffer->range_length();
 
+    uint8_t prefix[4];
+    struct iovec iov[2];
+    iov[0].iov_base = prefix;
+    iov[1].iov_base = (uint8_t *)buffer->data() + buffer->range_offset();
+    iov[1].iov_len = length;
+
     if (mUse4ByteNalLength) {
-        uint8_t x = length >> 24;
-        ::write(mFd, &x, 1);
-        x = (length >> 16) & 0xff;
-        ::write(mFd, &x, 1);
-        x = (length >> 8) & 0xff;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-
-        ::write(mFd,
-              (const uint8_t *)buffer->data() + buffer->range_offset(),
-              length);
-
-        mOffset += length + 4;
+        prefix[0] = length >> 24;
+        prefix[1] = (length >> 16) & 0xff;
+        prefix[2] = (length >> 8) & 0xff;
+        prefix[3] = length & 0xff;
+        iov[0].iov_len = 4;
     } else {
         CHECK_LT(length, 65536);
 
-        uint8_t x = length >> 8;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-        ::write(mFd, (const uint8_t *)buffer->data() + buffer->range_offset(), length);
-        mOffset += length + 2;
+        prefix[0] = length >> 8;
+        prefix[1] = length & 0xff;
+        iov[0].iov_len = 2;
     }
 
+    writevFully(mFd, iov, 2);
+    mOffset += iov[0].iov_len + length;
+
     return old_offset;
 }
 
@@ -1349,6 +1560,9 @@ MPEG4Writer::Track::Track(
       mTrackId(trackId),
       mTrackDurationUs(0),
       mEstimatedTrackSizeBytes(0),
+      mNumSamples(0),
+      mHasSyncSample(false),
+      mFragmentStartTimeUs(0),
       mSamplesHaveSameSize(true),
       mStszTableEntries(new ListTableEntries<uint32_t>(1000, 1)),
       mStcoTableEntries(new ListTableEntries<uint32_t>(1000, 1)),
@@ -1539,14 +1753,49 @@ void *MPEG4Writer::ThreadWrapper(void *me) {
 
 void MPEG4Writer::bufferChunk(const Chunk& chunk) {
     ALOGV("bufferChunk: %p", chunk.mTrack);
+
+    size_t sizeBytes = 0;
+    for (List<MediaBuffer *>::const_iterator it = chunk.mSamples.begin();
+         it != chunk.mSamples.end(); ++it) {
+        sizeBytes += (*it)->range_length();
+    }
+
     Mutex::Autolock autolock(mLock);
     CHECK_EQ(mDone, false);
 
+    // Hold the track thread back while the chunks waiting for the writer
+    // thread take more memory than allowed, instead of letting them grow
+    // while the storage is slow. A single chunk is always accepted, and
+    // the wait ends when the track is being stopped.
+    if (mChunkQueueBudgetBytes > 0
+            && mQueuedChunkBytes > 0
+            && mQueuedChunkBytes + sizeBytes > mChunkQueueBudgetBytes
+            && !chunk.mTrack->isDone()) {
+        int64_t startTimeUs = systemTime() / 1000;
+        ++mNumChunkQueueWaits;
+        while (mQueuedChunkBytes > 0
+                && mQueuedChunkBytes + sizeBytes > mChunkQueueBudgetBytes
+                && !chunk.mTrack->isDone() && !mDone) {
+            mChunkWrittenCondition.waitRelative(mLock, kChunkQueueWaitTimeNs);
+        }
+        int64_t waitTimeUs = systemTime() / 1000 - startTimeUs;
+        mChunkQueueWaitTimeUs += waitTimeUs;
+        ALOGW("%s track waited %lld us for the writer thread",
+                chunk.mTrack->isAudio()? "Audio": "Video", waitTimeUs);
+    }
+
+    mQueuedChunkBytes += sizeBytes;
+    if (mQueuedChunkBytes > mPeakQueuedChunkBytes) {
+        mPeakQueuedChunkBytes = mQueuedChunkBytes;
+    }
+
     for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
          it != mChunkInfos.end(); ++it) {
 
         if (chunk.mTrack == it->mTrack) {  // Found owner
             it->mChunks.push_back(chunk);
+            List<Chunk>::iterator last = --it->mChunks.end();
+            last->mSizeBytes = sizeBytes;
             mChunkReadyCondition.signal();
             return;
         }
@@ -1559,26 +1808,32 @@ void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
     ALOGV("writeChunkToFile: %lld from %s track",
         chunk->mTimeStampUs, chunk->mTrack->isAudio()? "audio": "video");
 
-    int32_t isFirstSample = true;
-    while (!chunk->mSamples.empty()) {
-        List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
-
-        off64_t offset = chunk->mTrack->isAvc()
-                                ? addLengthPrefixedSample_l(*it)
-                                : addSample_l(*it);
-
-        if (isFirstSample) {
-            chunk->mTrack->addChunkOffset(offset);
-            isFirstSample = false;
-        }
+    if (isFragmented()) {
+        writeFragmentToFile(chunk);
+        return;
+    }
 
-        (*it)->release();
-        (*it) = NULL;
-        chunk->mSamples.erase(it);
+    if (!chunk->mSamples.empty()) {
+        off64_t offset = addSamples_l(chunk->mTrack->isAvc(), &chunk->mSamples);
+        chunk->mTrack->addChunkOffset(offset);
     }
     chunk->mSamples.clear();
 }
 
+void MPEG4Writer::writeFragmentToFile(Chunk* chunk) {
+    if (mFragmentedMoovSize == 0) {
+        CHECK_EQ(mOffset, mFragmentedMoovOffset);
+        writeMoovBox(0);
+        mFragmentedMoovSize = mOffset - mFragmentedMoovOffset;
+    }
+
+    chunk->mTrack->writeMoofBox(*chunk, ++mFragmentSequenceNumber);
+
+    beginBox("mdat");
+    addSamples_l(chunk->mTrack->isAvc(), &chunk->mSamples);
+    endBox();  // mdat
+}
+
 void MPEG4Writer::writeAllChunks() {
     ALOGV("writeAllChunks");
     size_t outstandingChunks = 0;
@@ -1597,6 +1852,18 @@ void MPEG4Writer::writeAllChunks() {
 bool MPEG4Writer::findChunkToWrite(Chunk *chunk) {
     ALOGV("findChunkToWrite");
 
+    if (isFragmented() && mFragmentedMoovSize == 0 && !mDone) {
+        // The moov box is written with the first fragment and needs the
+        // codec specific data of every track, hold the fragments back
+        // until all the tracks have produced one or stopped.
+        for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+             it != mChunkInfos.end(); ++it) {
+            if (it->mChunks.empty() && !it->mTrack->reachedEOS()) {
+                return false;
+            }
+        }
+    }
+
     int64_t minTimestampUs = 0x7FFFFFFFFFFFFFFFLL;
     Track *track = NULL;
     for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
@@ -1665,6 +1932,9 @@ void MPEG4Writer::threadFunc() {
             if (mIsRealTimeRecording) {
                 mLock.lock();
             }
+
+            mQueuedChunkBytes -= chunk.mSizeBytes;
+            mChunkWrittenCondition.broadcast();
         }
     }
 
@@ -1677,6 +1947,17 @@ status_t MPEG4Writer::startWriterThread() {
     mDone = false;
     mIsFirstChunk = true;
     mDriftTimeUs = 0;
+    mQueuedChunkBytes = 0;
+    mPeakQueuedChunkBytes = 0;
+    mNumChunkQueueWaits = 0;
+    mChunkQueueWaitTimeUs = 0;
+
+    mChunkQueueBudgetBytes = kDefaultChunkQueueBytes;
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.mp4-queue-kb", value, NULL)) {
+        // 0 disables the limit
+        mChunkQueueBudgetBytes = atoi(value) * 1024;
+    }
     for (List<Track *>::iterator it = mTracks.begin();
          it != mTracks.end(); ++it) {
         ChunkInfo info;
@@ -2073,6 +2354,7 @@ status_t MPEG4Writer::Track::threadEntry() {
     int32_t count = 0;
     const int64_t interleaveDurationUs = mOwner->interleaveDuration();
     const bool hasMultipleTracks = (mOwner->numTracks() > 1);
+    const bool isFragmented = mOwner->isFragmented();
     int64_t chunkTimestampUs = 0;
     int32_t nChunks = 0;
     int32_t nZeroLengthFrames = 0;
@@ -2194,7 +2476,7 @@ status_t MPEG4Writer::Track::threadEntry() {
         }
 
 ////////////////////////////////////////////////////////////////////////////////
-        if (mStszTableEntries->count() == 0) {
+        if (mNumSamples == 0) {
             mFirstSampleTimeRealUs = systemTime() / 1000;
             mStartTimestampUs = timestampUs;
             mOwner->setStartTimestampUs(mStartTimestampUs);
@@ -2234,7 +2516,9 @@ status_t MPEG4Writer::Track::threadEntry() {
             currCttsOffsetTimeTicks =
                     (cttsOffsetTimeUs * mTimeScale + 500000LL) / 1000000LL;
             CHECK_LE(currCttsOffsetTimeTicks, 0x0FFFFFFFFLL);
-            if (mStszTableEntries->count() == 0) {
+            if (isFragmented) {
+                // The offset of each sample goes in its fragment run
+            } else if (mNumSamples == 0) {
                 // Force the first ctts table entry to have one single entry
                 // so that we can do adjustment for the initial track start
                 // time offset easily in writeCttsBox().
@@ -2252,7 +2536,7 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
 
             // Update ctts time offset range
-            if (mStszTableEntries->count() == 0) {
+            if (mNumSamples == 0) {
                 mMinCttsOffsetTimeUs = currCttsOffsetTimeTicks;
                 mMaxCttsOffsetTimeUs = currCttsOffsetTimeTicks;
             } else {
@@ -2292,7 +2576,30 @@ status_t MPEG4Writer::Track::threadEntry() {
             return UNKNOWN_ERROR;
         }
 
+        if (isSync != 0) {
+            mHasSyncSample = true;
+        }
+
+        if (isFragmented) {
+            addFragmentSample(copy, sampleSize, timestampUs,
+                    currDurationTicks, currCttsOffsetTimeTicks, isSync != 0);
+            ++mNumSamples;
+
+            lastDurationUs = timestampUs - lastTimestampUs;
+            lastDurationTicks = currDurationTicks;
+            lastTimestampUs = timestampUs;
+
+            if (mTrackingProgressStatus) {
+                if (mPreviousTrackTimeUs <= 0) {
+                    mPreviousTrackTimeUs = mStartTimestampUs;
+                }
+                trackProgressStatus(timestampUs);
+            }
+            continue;
+        }
+
         mStszTableEntries->add(htonl(sampleSize));
+        ++mNumSamples;
         if (mStszTableEntries->count() > 2) {
 
             // Force the first sample to have its own stts entry so that
@@ -2376,6 +2683,31 @@ status_t MPEG4Writer::Track::threadEntry() {
 
     mOwner->trackProgressStatus(mTrackId, -1, err);
 
+    if (isFragmented) {
+        // We don't know how long the last frame lasts either, repeat the
+        // previous frame's duration.
+        if (mNumSamples == 1) {
+            lastDurationUs = 0;
+            lastDurationTicks = 0;
+        }
+        if (!mFragmentSamples.isEmpty()) {
+            mFragmentSamples.editTop().mDurationTicks = lastDurationTicks;
+            bufferFragment();
+        }
+
+        mTrackDurationUs += lastDurationUs;
+        mReachedEOS = true;
+
+        ALOGI("Received total/0-length (%d/%d) buffers and encoded %d frames "
+                "in fragments. - %s",
+                count, nZeroLengthFrames, mNumSamples, mIsAudio? "audio": "video");
+
+        if (err == ERROR_END_OF_STREAM) {
+            return OK;
+        }
+        return err;
+    }
+
     // Last chunk
     if (!hasMultipleTracks) {
         addOneStscTableEntry(1, mStszTableEntries->count());
@@ -2429,12 +2761,12 @@ status_t MPEG4Writer::Track::threadEntry() {
 }
 
 bool MPEG4Writer::Track::isTrackMalFormed() const {
-    if (mStszTableEntries->count() == 0) {                      // no samples written
+    if (mNumSamples == 0) {                      // no samples written
         ALOGE("The number of recorded samples is 0");
         return true;
     }
 
-    if (!mIsAudio && mStssTableEntries->count() == 0) {  // no sync frames for video
+    if (!mIsAudio && !mHasSyncSample) {  // no sync frames for video
         ALOGE("There are no sync frames for video track");
         return true;
     }
@@ -2567,6 +2899,126 @@ void MPEG4Writer::Track::bufferChunk(int64_t timestampUs) {
     mChunkSamples.clear();
 }
 
+void MPEG4Writer::Track::addFragmentSample(
+        MediaBuffer *buffer, size_t sampleSize, int64_t decodingTimeUs,
+        int64_t previousDurationTicks, int64_t cttsOffsetTicks, bool isSync) {
+    if (!mFragmentSamples.isEmpty()) {
+        // The duration of a sample is only known with the next one.
+        mFragmentSamples.editTop().mDurationTicks = previousDurationTicks;
+
+        // Video fragments must start with a sync sample so that each of
+        // them can be decoded on its own.
+        if (decodingTimeUs - mFragmentStartTimeUs >= mOwner->fragmentDurationUs()
+                && (mIsAudio || isSync)) {
+            bufferFragment();
+        }
+    }
+
+    if (mFragmentSamples.isEmpty()) {
+        mFragmentStartTimeUs = decodingTimeUs;
+    }
+
+    if (cttsOffsetTicks < 0) {
+        // Only version 0 fragment runs are supported by the extractor, whose
+        // composition time offsets are unsigned.
+        ALOGW("Negative composition time offset %lld clamped to 0", cttsOffsetTicks);
+        cttsOffsetTicks = 0;
+    }
+
+    FragmentSample sample;
+    sample.mSize = sampleSize;
+    sample.mDurationTicks = 0;
+    sample.mCttsOffsetTicks = cttsOffsetTicks;
+    sample.mIsSync = isSync;
+    mFragmentSamples.push(sample);
+    mChunkSamples.push_back(buffer);
+}
+
+void MPEG4Writer::Track::bufferFragment() {
+    ALOGV("bufferFragment");
+
+    Chunk chunk(this, mFragmentStartTimeUs, mChunkSamples);
+    chunk.mFragmentSamples = mFragmentSamples;
+    chunk.mDecodingTimeTicks =
+        (mFragmentStartTimeUs * mTimeScale + 500000LL) / 1000000LL;
+    mOwner->bufferChunk(chunk);
+    mChunkSamples.clear();
+    mFragmentSamples.clear();
+}
+
+void MPEG4Writer::Track::writeMoofBox(
+        const Chunk &chunk, uint32_t sequenceNumber) {
+    enum {
+        kTfhdDefaultBaseIsMoof           = 0x020000,
+        kTrunDataOffsetPresent           = 0x01,
+        kTrunSampleDurationPresent       = 0x100,
+        kTrunSampleSizePresent           = 0x200,
+        kTrunSampleFlagsPresent          = 0x400,
+        kTrunSampleCompositionTimeOffset = 0x800,
+    };
+
+    // sample_depends_on = 2 for sync samples, 1 and
+    // sample_is_difference_sample for the others
+    static const uint32_t kSyncSampleFlags    = 0x02000000;
+    static const uint32_t kNonSyncSampleFlags = 0x01010000;
+
+    const size_t numSamples = chunk.mFragmentSamples.size();
+    const size_t numValues = mIsAudio ? 3 : 4;
+
+    uint32_t trunFlags = kTrunDataOffsetPresent
+        | kTrunSampleDurationPresent | kTrunSampleSizePresent
+        | kTrunSampleFlagsPresent;
+    if (!mIsAudio) {
+        trunFlags |= kTrunSampleCompositionTimeOffset;
+    }
+
+    // The data offset in the trun box is relative to the start of the
+    // moof box and points past the header of the mdat box following it.
+    size_t trunSize = 20 + numSamples * numValues * 4;
+    size_t trafSize = 8 + 16 /* tfhd */ + 20 /* tfdt */ + trunSize;
+    size_t moofSize = 8 + 16 /* mfhd */ + trafSize;
+
+    uint32_t *values = new uint32_t[numSamples * numValues];
+    for (size_t i = 0; i < numSamples; ++i) {
+        const FragmentSample &sample = chunk.mFragmentSamples.itemAt(i);
+        uint32_t *entry = &values[i * numValues];
+        entry[0] = htonl(sample.mDurationTicks);
+        entry[1] = htonl(sample.mSize);
+        entry[2] = htonl(mIsAudio || sample.mIsSync
+                ? kSyncSampleFlags : kNonSyncSampleFlags);
+        if (!mIsAudio) {
+            entry[3] = htonl(sample.mCttsOffsetTicks);
+        }
+    }
+
+    mOwner->beginBox("moof");
+        mOwner->beginBox("mfhd");
+        mOwner->writeInt32(0);             // version=0, flags=0
+        mOwner->writeInt32(sequenceNumber);
+        mOwner->endBox();  // mfhd
+        mOwner->beginBox("traf");
+            mOwner->beginBox("tfhd");
+            mOwner->writeInt32(kTfhdDefaultBaseIsMoof);  // version=0
+            mOwner->writeInt32(mTrackId);
+            mOwner->endBox();  // tfhd
+            mOwner->beginBox("tfdt");
+            mOwner->writeInt32(0x01000000);  // version=1, flags=0
+            mOwner->writeInt64(
+                    chunk.mDecodingTimeTicks + getStartTimeOffsetScaledTime());
+            mOwner->endBox();  // tfdt
+            mOwner->beginBox("trun");
+            mOwner->writeInt32(trunFlags);   // version=0
+            mOwner->writeInt32(numSamples);
+            mOwner->writeInt32(moofSize + 8);
+            mOwner->write(values, sizeof(uint32_t) * numValues, numSamples);
+            mOwner->endBox();  // trun
+        mOwner->endBox();  // traf
+    mOwner->endBox();  // moof
+
+    delete[] values;
+    values = NULL;
+}
+
 int64_t MPEG4Writer::Track::getDurationUs() const {
     return mTrackDurationUs;
 }
@@ -2631,6 +3083,22 @@ void MPEG4Writer::Track::writeStblBox(bool use32BitOffset) {
         writeVideoFourCCBox();
     }
     mOwner->endBox();  // stsd
+    if (mOwner->isFragmented()) {
+        // The samples are all in the movie fragments, leave the tables
+        // empty.
+        static const char *kTables[] = { "stts", "stsc", "stsz", "stco" };
+        for (size_t i = 0; i < sizeof(kTables) / sizeof(kTables[0]); ++i) {
+            mOwner->beginBox(kTables[i]);
+            mOwner->writeInt32(0);  // version=0, flags=0
+            if (!strcmp(kTables[i], "stsz")) {
+                mOwner->writeInt32(0);  // sample size
+            }
+            mOwner->writeInt32(0);  // entry count
+            mOwner->endBox();
+        }
+        mOwner->endBox();  // stbl
+        return;
+    }
     writeSttsBox();
     writeCttsBox();
     if (!mIsAudio) {
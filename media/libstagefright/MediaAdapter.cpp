@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaAdapter.h>
 #include <media/stagefright/MediaBuffer.h>
 
@@ -34,6 +35,7 @@ MediaAdapter::~MediaAdapter() {
     Mutex::Autolock autoLock(mAdapterLock);
     mOutputFormat.clear();
     CHECK(mCurrentMediaBuffer == NULL);
+    CHECK(mQueuedBuffers.empty());
 }
 
 status_t MediaAdapter::start(MetaData *params) {
@@ -47,15 +49,29 @@ status_t MediaAdapter::start(MetaData *params) {
 status_t MediaAdapter::stop() {
     Mutex::Autolock autoLock(mAdapterLock);
     if (mStarted) {
+        // Let the reader drain the buffers queued by pushBufferAsync(), as
+        // long as it makes progress.
+        while (!mQueuedBuffers.empty()) {
+            size_t numQueued = mQueuedBuffers.size();
+            mBufferReturnedCond.waitRelative(mAdapterLock, kDrainTimeOutNs);
+            if (mQueuedBuffers.size() == numQueued) {
+                ALOGW("%d queued buffers dropped at stop", numQueued);
+                break;
+            }
+        }
+
         mStarted = false;
         // If stop() happens immediately after a pushBuffer(), we should
-        // clean up the mCurrentMediaBuffer
-        if (mCurrentMediaBuffer != NULL) {
-            mCurrentMediaBuffer->release();
-            mCurrentMediaBuffer = NULL;
+        // clean up the buffers that were not read
+        while (!mQueuedBuffers.empty()) {
+            MediaBuffer *buffer = *mQueuedBuffers.begin();
+            mQueuedBuffers.erase(mQueuedBuffers.begin());
+            releaseBuffer_l(buffer);
         }
+        mCurrentMediaBuffer = NULL;
         // While read() is still waiting, we should signal it to finish.
         mBufferReadCond.signal();
+        mBufferReturnedCond.broadcast();
     }
     return OK;
 }
@@ -65,13 +81,32 @@ sp<MetaData> MediaAdapter::getFormat() {
     return mOutputFormat;
 }
 
+void MediaAdapter::releaseBuffer_l(MediaBuffer *buffer) {
+    ssize_t index = mReleaseNotifications.indexOfKey(buffer);
+    sp<AMessage> notify;
+    if (index >= 0) {
+        notify = mReleaseNotifications.valueAt(index);
+        mReleaseNotifications.removeItemsAt(index);
+    }
+
+    if (buffer == mCurrentMediaBuffer) {
+        mCurrentMediaBuffer = NULL;
+    }
+
+    buffer->release();
+
+    if (notify != NULL) {
+        notify->post();
+    }
+}
+
 void MediaAdapter::signalBufferReturned(MediaBuffer *buffer) {
     Mutex::Autolock autoLock(mAdapterLock);
     CHECK(buffer != NULL);
     buffer->setObserver(0);
-    buffer->release();
+    releaseBuffer_l(buffer);
     ALOGV("buffer returned %p", buffer);
-    mBufferReturnedCond.signal();
+    mBufferReturnedCond.broadcast();
 }
 
 status_t MediaAdapter::read(
@@ -82,22 +117,26 @@ status_t MediaAdapter::read(
         return ERROR_END_OF_STREAM;
     }
 
-    while (mCurrentMediaBuffer == NULL && mStarted) {
+    while (mQueuedBuffers.empty() && mStarted) {
         ALOGV("waiting @ read()");
         mBufferReadCond.wait(mAdapterLock);
     }
 
     if (!mStarted) {
         ALOGV("read interrupted after stop");
-        CHECK(mCurrentMediaBuffer == NULL);
+        CHECK(mQueuedBuffers.empty());
         return ERROR_END_OF_STREAM;
     }
 
-    CHECK(mCurrentMediaBuffer != NULL);
+    CHECK(!mQueuedBuffers.empty());
 
-    *buffer = mCurrentMediaBuffer;
-    mCurrentMediaBuffer = NULL;
+    *buffer = *mQueuedBuffers.begin();
+    mQueuedBuffers.erase(mQueuedBuffers.begin());
     (*buffer)->setObserver(this);
+    (*buffer)->add_ref();  // Released in signalBufferReturned().
+
+    // Room for pushBufferAsync(), and progress for stop().
+    mBufferReturnedCond.broadcast();
 
     return OK;
 }
@@ -114,10 +153,39 @@ status_t MediaAdapter::pushBuffer(MediaBuffer *buffer) {
         return INVALID_OPERATION;
     }
     mCurrentMediaBuffer = buffer;
+    mQueuedBuffers.push_back(buffer);
     mBufferReadCond.signal();
 
     ALOGV("wait for the buffer returned @ pushBuffer! %p", buffer);
-    mBufferReturnedCond.wait(mAdapterLock);
+    while (mCurrentMediaBuffer == buffer) {
+        mBufferReturnedCond.wait(mAdapterLock);
+    }
+
+    return OK;
+}
+
+status_t MediaAdapter::pushBufferAsync(
+        MediaBuffer *buffer, const sp<AMessage> &notify) {
+    if (buffer == NULL) {
+        ALOGE("pushBufferAsync get an NULL buffer");
+        return -EINVAL;
+    }
+
+    Mutex::Autolock autoLock(mAdapterLock);
+    while (mStarted && mQueuedBuffers.size() >= kMaxQueuedBuffers) {
+        mBufferReturnedCond.wait(mAdapterLock);
+    }
+
+    if (!mStarted) {
+        ALOGE("pushBufferAsync called before start or after stop");
+        return INVALID_OPERATION;
+    }
+
+    if (notify != NULL) {
+        mReleaseNotifications.add(buffer, notify);
+    }
+    mQueuedBuffers.push_back(buffer);
+    mBufferReadCond.signal();
 
     return OK;
 }
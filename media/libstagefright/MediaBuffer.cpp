@@ -111,6 +111,10 @@ void MediaBuffer::claim() {
     mRefCount = 0;
 }
 
+bool MediaBuffer::tryAcquire() {
+    return __atomic_cmpxchg(0, 1, &mRefCount) == 0;
+}
+
 void MediaBuffer::add_ref() {
     (void) __atomic_inc(&mRefCount);
 }
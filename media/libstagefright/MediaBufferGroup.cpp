@@ -17,6 +17,9 @@
 #define LOG_TAG "MediaBufferGroup"
 #include <utils/Log.h>
 
+#include <cutils/atomic.h>
+#include <sys/atomics.h>
+
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaBufferGroup.h>
@@ -24,7 +27,8 @@
 namespace android {
 
 MediaBufferGroup::MediaBufferGroup()
-    : mFirstBuffer(NULL),
+    : mNumWaiters(0),
+      mFirstBuffer(NULL),
       mLastBuffer(NULL) {
 }
 
@@ -46,6 +50,9 @@ void MediaBufferGroup::add_buffer(MediaBuffer *buffer) {
 
     buffer->setObserver(this);
 
+    // the list is walked without the lock, the buffer must be complete before it is linked
+    android_memory_barrier();
+
     if (mLastBuffer) {
         mLastBuffer->setNextBuffer(buffer);
     } else {
@@ -55,32 +62,51 @@ void MediaBufferGroup::add_buffer(MediaBuffer *buffer) {
     mLastBuffer = buffer;
 }
 
-status_t MediaBufferGroup::acquire_buffer(MediaBuffer **out) {
-    Mutex::Autolock autoLock(mLock);
+// Returns a free buffer with a reference count of 1, or NULL if they are all in use.
+MediaBuffer *MediaBufferGroup::tryAcquire() {
+    for (MediaBuffer *buffer = mFirstBuffer;
+         buffer != NULL; buffer = buffer->nextBuffer()) {
+        if (buffer->refcount() == 0 && buffer->tryAcquire()) {
+            buffer->reset();
+            return buffer;
+        }
+    }
+
+    return NULL;
+}
 
-    for (;;) {
-        for (MediaBuffer *buffer = mFirstBuffer;
-             buffer != NULL; buffer = buffer->nextBuffer()) {
-            if (buffer->refcount() == 0) {
-                buffer->add_ref();
-                buffer->reset();
+status_t MediaBufferGroup::acquire_buffer(MediaBuffer **out, bool nonBlocking) {
+    MediaBuffer *buffer = tryAcquire();
 
-                *out = buffer;
-                goto exit;
-            }
+    if (buffer == NULL) {
+        if (nonBlocking) {
+            return WOULD_BLOCK;
         }
 
-        // All buffers are in use. Block until one of them is returned to us.
-        mCondition.wait(mLock);
+        Mutex::Autolock autoLock(mLock);
+
+        // Registering as a waiter before looking again pairs with the buffer
+        // release in signalBufferReturned(): either this thread sees the
+        // returned buffer, or the releasing thread sees the waiter and signals
+        // mCondition, which it can only do once this thread waits.
+        __atomic_inc(&mNumWaiters);
+        while ((buffer = tryAcquire()) == NULL) {
+            // All buffers are in use. Block until one of them is returned to us.
+            mCondition.wait(mLock);
+        }
+        __atomic_dec(&mNumWaiters);
     }
 
-exit:
+    *out = buffer;
+
     return OK;
 }
 
 void MediaBufferGroup::signalBufferReturned(MediaBuffer *) {
-    Mutex::Autolock autoLock(mLock);
-    mCondition.signal();
+    if (mNumWaiters > 0) {
+        Mutex::Autolock autoLock(mLock);
+        mCondition.signal();
+    }
 }
 
 }  // namespace android
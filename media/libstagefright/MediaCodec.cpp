@@ -70,6 +70,7 @@ MediaCodec::MediaCodec(const sp<ALooper> &looper)
       mCodec(new ACodec),
       mReplyID(0),
       mFlags(0),
+      mStickyError(OK),
       mSoftRenderer(NULL),
       mDequeueInputTimeoutGeneration(0),
       mDequeueInputReplyID(0),
@@ -404,6 +405,14 @@ void MediaCodec::requestActivityNotification(const sp<AMessage> &notify) {
     msg->post();
 }
 
+status_t MediaCodec::setCallback(const sp<AMessage> &callback) {
+    sp<AMessage> msg = new AMessage(kWhatSetCallback, id());
+    msg->setMessage("callback", callback);
+
+    sp<AMessage> response;
+    return PostAndAwaitResponse(msg, &response);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void MediaCodec::cancelPendingDequeueOperations() {
@@ -475,38 +484,42 @@ bool MediaCodec::handleDequeueOutputBuffer(uint32_t replyID, bool newRequest) {
             return false;
         }
 
-        const sp<ABuffer> &buffer =
-            mPortBuffers[kPortIndexOutput].itemAt(index).mData;
+        setOutputBufferInfo(response, index);
+    }
 
-        response->setSize("index", index);
-        response->setSize("offset", buffer->offset());
-        response->setSize("size", buffer->size());
+    response->postReply(replyID);
 
-        int64_t timeUs;
-        CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
+    return true;
+}
 
-        response->setInt64("timeUs", timeUs);
+void MediaCodec::setOutputBufferInfo(const sp<AMessage> &msg, size_t index) {
+    const sp<ABuffer> &buffer =
+        mPortBuffers[kPortIndexOutput].itemAt(index).mData;
 
-        int32_t omxFlags;
-        CHECK(buffer->meta()->findInt32("omxFlags", &omxFlags));
+    msg->setSize("index", index);
+    msg->setSize("offset", buffer->offset());
+    msg->setSize("size", buffer->size());
 
-        uint32_t flags = 0;
-        if (omxFlags & OMX_BUFFERFLAG_SYNCFRAME) {
-            flags |= BUFFER_FLAG_SYNCFRAME;
-        }
-        if (omxFlags & OMX_BUFFERFLAG_CODECCONFIG) {
-            flags |= BUFFER_FLAG_CODECCONFIG;
-        }
-        if (omxFlags & OMX_BUFFERFLAG_EOS) {
-            flags |= BUFFER_FLAG_EOS;
-        }
+    int64_t timeUs;
+    CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
 
-        response->setInt32("flags", flags);
-    }
+    msg->setInt64("timeUs", timeUs);
 
-    response->postReply(replyID);
+    int32_t omxFlags;
+    CHECK(buffer->meta()->findInt32("omxFlags", &omxFlags));
 
-    return true;
+    uint32_t flags = 0;
+    if (omxFlags & OMX_BUFFERFLAG_SYNCFRAME) {
+        flags |= BUFFER_FLAG_SYNCFRAME;
+    }
+    if (omxFlags & OMX_BUFFERFLAG_CODECCONFIG) {
+        flags |= BUFFER_FLAG_CODECCONFIG;
+    }
+    if (omxFlags & OMX_BUFFERFLAG_EOS) {
+        flags |= BUFFER_FLAG_EOS;
+    }
+
+    msg->setInt32("flags", flags);
 }
 
 void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
@@ -587,6 +600,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                             sendErrorReponse = false;
 
                             mFlags |= kFlagStickyError;
+                            mStickyError = internalError;
                             postActivityNotificationIfPossible();
 
                             cancelPendingDequeueOperations();
@@ -598,6 +612,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                             sendErrorReponse = false;
 
                             mFlags |= kFlagStickyError;
+                            mStickyError = internalError;
                             postActivityNotificationIfPossible();
                             break;
                         }
@@ -734,8 +749,16 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                 {
                     ALOGV("codec output format changed");
 
+                    // Output in graphic buffers is queued to the window by
+                    // the codec itself.
+                    bool outputToNativeWindow =
+                        !mPortBuffers[kPortIndexOutput].isEmpty()
+                            && mPortBuffers[kPortIndexOutput][0].mData->base()
+                                    == NULL;
+
                     if ((mFlags & kFlagIsSoftwareCodec)
-                            && mNativeWindow != NULL) {
+                            && mNativeWindow != NULL
+                            && !outputToNativeWindow) {
                         AString mime;
                         CHECK(msg->findString("mime", &mime));
 
@@ -803,6 +826,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                                   err);
 
                             mFlags |= kFlagStickyError;
+                            mStickyError = err;
                             postActivityNotificationIfPossible();
 
                             cancelPendingDequeueOperations();
@@ -1101,8 +1125,9 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             uint32_t replyID;
             CHECK(msg->senderAwaitsResponse(&replyID));
 
-            if (mHaveInputSurface) {
-                ALOGE("dequeueInputBuffer can't be used with input surface");
+            if (mHaveInputSurface || mCallback != NULL) {
+                ALOGE("dequeueInputBuffer can't be used with input surface "
+                      "or in asynchronous mode");
                 sp<AMessage> response = new AMessage;
                 response->setInt32("err", INVALID_OPERATION);
                 response->postReply(replyID);
@@ -1183,6 +1208,14 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             uint32_t replyID;
             CHECK(msg->senderAwaitsResponse(&replyID));
 
+            if (mCallback != NULL) {
+                ALOGE("dequeueOutputBuffer can't be used in asynchronous mode");
+                sp<AMessage> response = new AMessage;
+                response->setInt32("err", INVALID_OPERATION);
+                response->postReply(replyID);
+                break;
+            }
+
             if (handleDequeueOutputBuffer(replyID, true /* new request */)) {
                 break;
             }
@@ -1361,6 +1394,28 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSetCallback:
+        {
+            uint32_t replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            if (mState != INITIALIZED && mState != CONFIGURED) {
+                sp<AMessage> response = new AMessage;
+                response->setInt32("err", INVALID_OPERATION);
+
+                response->postReply(replyID);
+                break;
+            }
+
+            sp<AMessage> callback;
+            CHECK(msg->findMessage("callback", &callback));
+
+            mCallback = callback;
+
+            (new AMessage)->postReply(replyID);
+            break;
+        }
+
         case kWhatGetName:
         {
             uint32_t replyID;
@@ -1475,6 +1530,8 @@ void MediaCodec::setState(State newState) {
         mFlags &= ~kFlagOutputFormatChanged;
         mFlags &= ~kFlagOutputBuffersChanged;
         mFlags &= ~kFlagStickyError;
+        mFlags &= ~kFlagErrorCallbackPosted;
+        mStickyError = OK;
         mFlags &= ~kFlagIsEncoder;
         mFlags &= ~kFlagGatherCodecSpecificData;
 
@@ -1483,6 +1540,7 @@ void MediaCodec::setState(State newState) {
 
     if (newState == UNINITIALIZED) {
         mComponentName.clear();
+        mCallback.clear();
 
         // The component is gone, mediaserver's probably back up already
         // but should definitely be back up should we try to instantiate
@@ -1756,6 +1814,11 @@ status_t MediaCodec::setNativeWindow(
 }
 
 void MediaCodec::postActivityNotificationIfPossible() {
+    if (mCallback != NULL) {
+        postPendingCallbacks();
+        return;
+    }
+
     if (mActivityNotify == NULL) {
         return;
     }
@@ -1770,6 +1833,60 @@ void MediaCodec::postActivityNotificationIfPossible() {
     }
 }
 
+void MediaCodec::postPendingCallbacks() {
+    if (mFlags & kFlagStickyError) {
+        if (!(mFlags & kFlagErrorCallbackPosted)) {
+            sp<AMessage> msg = mCallback->dup();
+            msg->setInt32("callbackID", CB_ERROR);
+            msg->setInt32("err", mStickyError);
+            msg->post();
+
+            mFlags |= kFlagErrorCallbackPosted;
+        }
+        return;
+    }
+
+    if (mState != STARTED) {
+        return;
+    }
+
+    // Same order in which dequeueOutputBuffer would report these.
+    if (mFlags & kFlagOutputBuffersChanged) {
+        sp<AMessage> msg = mCallback->dup();
+        msg->setInt32("callbackID", CB_OUTPUT_BUFFERS_CHANGED);
+        msg->post();
+
+        mFlags &= ~kFlagOutputBuffersChanged;
+    }
+
+    if (mFlags & kFlagOutputFormatChanged) {
+        sp<AMessage> msg = mCallback->dup();
+        msg->setInt32("callbackID", CB_OUTPUT_FORMAT_CHANGED);
+        msg->setMessage("format", mOutputFormat);
+        msg->post();
+
+        mFlags &= ~kFlagOutputFormatChanged;
+    }
+
+    // Buffers are handed to the client as soon as the codec returns them,
+    // the client gives them back through queueInputBuffer and
+    // (render)releaseOutputBuffer as before.
+    ssize_t index;
+    while ((index = dequeuePortBuffer(kPortIndexInput)) >= 0) {
+        sp<AMessage> msg = mCallback->dup();
+        msg->setInt32("callbackID", CB_INPUT_AVAILABLE);
+        msg->setSize("index", index);
+        msg->post();
+    }
+
+    while ((index = dequeuePortBuffer(kPortIndexOutput)) >= 0) {
+        sp<AMessage> msg = mCallback->dup();
+        msg->setInt32("callbackID", CB_OUTPUT_AVAILABLE);
+        setOutputBufferInfo(msg, index);
+        msg->post();
+    }
+}
+
 status_t MediaCodec::setParameters(const sp<AMessage> &params) {
     sp<AMessage> msg = new AMessage(kWhatSetParameters, id());
     msg->setMessage("params", params);
@@ -0,0 +1,548 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaCodecDecodingSource"
+#include <utils/Log.h>
+
+#include "include/MediaCodecDecodingSource.h"
+
+#include <gui/Surface.h>
+#include <media/ICrypto.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/Utils.h>
+
+namespace android {
+
+// static
+sp<MediaSource> MediaCodecDecodingSource::Create(
+        const sp<MetaData> &meta,
+        const sp<MediaSource> &source,
+        const Vector<OMXCodec::CodecNameAndQuirks> &matchingCodecs) {
+    sp<AMessage> format;
+    if (convertMetaDataToMessage(meta, &format) != OK) {
+        return NULL;
+    }
+
+    sp<ALooper> codecLooper = new ALooper;
+    codecLooper->setName("MediaCodecDecodingSource codec");
+    codecLooper->start();
+
+    for (size_t i = 0; i < matchingCodecs.size(); ++i) {
+        const char *componentName = matchingCodecs[i].mName.string();
+
+        sp<MediaCodec> codec =
+            MediaCodec::CreateByComponentName(codecLooper, componentName);
+
+        if (codec == NULL) {
+            continue;
+        }
+
+        status_t err = codec->configure(
+                format, NULL /* nativeWindow */, NULL /* crypto */,
+                0 /* flags */);
+
+        if (err == OK) {
+            ALOGV("decoding through MediaCodec '%s'", componentName);
+
+            return new MediaCodecDecodingSource(
+                    meta, source, codecLooper, codec, componentName);
+        }
+
+        ALOGV("failed to configure '%s' (err %d)", componentName, err);
+        codec->release();
+    }
+
+    return NULL;
+}
+
+MediaCodecDecodingSource::MediaCodecDecodingSource(
+        const sp<MetaData> &meta,
+        const sp<MediaSource> &source,
+        const sp<ALooper> &codecLooper,
+        const sp<MediaCodec> &codec,
+        const char *componentName)
+    : mSource(source),
+      mCodecLooper(codecLooper),
+      mCodec(codec),
+      mComponentName(componentName),
+      mDurationUs(-1ll),
+      mLooper(new ALooper),
+      mReflector(new AHandlerReflector<MediaCodecDecodingSource>(this)),
+      mStarted(false),
+      mInputEOS(false),
+      mCodecError(false),
+      mOutputGeneration(0),
+      mInputResult(OK),
+      mOutputResult(OK) {
+    meta->findInt64(kKeyDuration, &mDurationUs);
+
+    // The actual output format is only known once the codec has produced
+    // some output, until then describe it the way OMXCodec would.
+    const char *mime;
+    CHECK(meta->findCString(kKeyMIMEType, &mime));
+
+    mFormat = new MetaData;
+
+    if (!strncasecmp("audio/", mime, 6)) {
+        mFormat->setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_RAW);
+
+        int32_t numChannels, sampleRate;
+        if (meta->findInt32(kKeyChannelCount, &numChannels)) {
+            mFormat->setInt32(kKeyChannelCount, numChannels);
+        }
+        if (meta->findInt32(kKeySampleRate, &sampleRate)) {
+            mFormat->setInt32(kKeySampleRate, sampleRate);
+        }
+    } else {
+        mFormat->setCString(kKeyMIMEType, MEDIA_MIMETYPE_VIDEO_RAW);
+
+        int32_t width, height;
+        if (meta->findInt32(kKeyWidth, &width)
+                && meta->findInt32(kKeyHeight, &height)) {
+            mFormat->setInt32(kKeyWidth, width);
+            mFormat->setInt32(kKeyHeight, height);
+        }
+    }
+
+    mFormat->setCString(kKeyDecoderComponent, mComponentName.c_str());
+    if (mDurationUs >= 0ll) {
+        mFormat->setInt64(kKeyDuration, mDurationUs);
+    }
+
+    mLooper->setName("MediaCodecDecodingSource");
+    mLooper->registerHandler(mReflector);
+    mLooper->start();
+}
+
+MediaCodecDecodingSource::~MediaCodecDecodingSource() {
+    // Our handler can't be reached through the looper anymore since it only
+    // holds a weak reference to us, shut it down and stop directly.
+    mLooper->unregisterHandler(mReflector->id());
+    mLooper->stop();
+
+    onStop();
+
+    mCodec->release();
+    mCodec.clear();
+
+    mCodecLooper->stop();
+}
+
+status_t MediaCodecDecodingSource::start(MetaData *params) {
+    CHECK(!mStarted);
+
+    status_t err = mSource->start(params);
+
+    if (err != OK) {
+        return err;
+    }
+
+    err = mCodec->start();
+
+    if (err != OK) {
+        ALOGE("[%s] failed to start (err %d)", mComponentName.c_str(), err);
+        mSource->stop();
+        return err;
+    }
+
+    CHECK_EQ(mCodec->getInputBuffers(&mInputBuffers), (status_t)OK);
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        CHECK_EQ(mCodec->getOutputBuffers(&mOutputBuffers), (status_t)OK);
+    }
+
+    mStarted = true;
+
+    (new AMessage(kWhatCodecNotify, mReflector->id()))->post();
+
+    return OK;
+}
+
+status_t MediaCodecDecodingSource::stop() {
+    sp<AMessage> response;
+    return (new AMessage(kWhatStop, mReflector->id()))->postAndAwaitResponse(
+            &response);
+}
+
+sp<MetaData> MediaCodecDecodingSource::getFormat() {
+    Mutex::Autolock autoLock(mLock);
+    return mFormat;
+}
+
+status_t MediaCodecDecodingSource::read(
+        MediaBuffer **buffer, const ReadOptions *options) {
+    *buffer = NULL;
+
+    int64_t seekTimeUs;
+    ReadOptions::SeekMode mode;
+    if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
+        sp<AMessage> msg = new AMessage(kWhatSeek, mReflector->id());
+        msg->setInt64("timeUs", seekTimeUs);
+        msg->setInt32("mode", mode);
+
+        sp<AMessage> response;
+        msg->postAndAwaitResponse(&response);
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    for (;;) {
+        while (mOutputQueue.empty() && mOutputResult == OK) {
+            mOutputAvailable.wait(mLock);
+        }
+
+        if (mOutputQueue.empty()) {
+            return mOutputResult;
+        }
+
+        OutputItem item = *mOutputQueue.begin();
+        mOutputQueue.erase(mOutputQueue.begin());
+
+        if (item.mIndex < 0) {
+            mFormat = convertOutputFormat(item.mFormat);
+            return INFO_FORMAT_CHANGED;
+        }
+
+        if (item.mFlags & MediaCodec::BUFFER_FLAG_EOS) {
+            mOutputResult =
+                (mInputResult != OK) ? mInputResult : ERROR_END_OF_STREAM;
+        }
+
+        if (item.mSize == 0) {
+            mCodec->releaseOutputBuffer(item.mIndex);
+            continue;
+        }
+
+        const sp<ABuffer> &data = mOutputBuffers.itemAt(item.mIndex);
+
+        MediaBuffer *out =
+            new MediaBuffer(data->base() + item.mOffset, item.mSize);
+
+        out->meta_data()->setInt64(kKeyTime, item.mTimeUs);
+        out->setObserver(this);
+        out->add_ref();
+
+        ClientBuffer clientBuffer;
+        clientBuffer.mIndex = item.mIndex;
+        clientBuffer.mGeneration = mOutputGeneration;
+        mClientBuffers.add(out, clientBuffer);
+
+        *buffer = out;
+
+        return OK;
+    }
+}
+
+void MediaCodecDecodingSource::signalBufferReturned(MediaBuffer *buffer) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mClientBuffers.indexOfKey(buffer);
+    CHECK_GE(index, 0);
+
+    // Buffers handed out before the last flush already went back to the
+    // codec, and their index may have been reused since.
+    const ClientBuffer &clientBuffer = mClientBuffers.valueAt(index);
+    if (clientBuffer.mGeneration == mOutputGeneration) {
+        mCodec->releaseOutputBuffer(clientBuffer.mIndex);
+    }
+
+    mClientBuffers.removeItemsAt(index);
+
+    buffer->setObserver(NULL);
+    buffer->release();
+}
+
+void MediaCodecDecodingSource::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatCodecNotify:
+        {
+            onDrainCodec();
+            break;
+        }
+
+        case kWhatSeek:
+        {
+            uint32_t replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            int64_t seekTimeUs;
+            CHECK(msg->findInt64("timeUs", &seekTimeUs));
+
+            int32_t mode;
+            CHECK(msg->findInt32("mode", &mode));
+
+            onSeek(seekTimeUs, (ReadOptions::SeekMode)mode);
+
+            (new AMessage)->postReply(replyID);
+
+            // Refill the codec from the new position, the client is already
+            // waiting for the first buffer.
+            onDrainCodec();
+            break;
+        }
+
+        case kWhatStop:
+        {
+            uint32_t replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            onStop();
+
+            (new AMessage)->postReply(replyID);
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+void MediaCodecDecodingSource::onDrainCodec() {
+    if (!mStarted || mCodecError) {
+        return;
+    }
+
+    drainOutputBuffers();
+    feedInputBuffers();
+
+    if (mCodecError) {
+        // The error is sticky, the codec would notify us right away again.
+        return;
+    }
+
+    mCodec->requestActivityNotification(
+            new AMessage(kWhatCodecNotify, mReflector->id()));
+}
+
+void MediaCodecDecodingSource::feedInputBuffers() {
+    for (;;) {
+        size_t index;
+        status_t err = mCodec->dequeueInputBuffer(&index);
+
+        if (err == -EAGAIN) {
+            break;
+        } else if (err != OK) {
+            signalCodecError(err);
+            return;
+        }
+
+        if (mInputEOS) {
+            // Keep the buffer, otherwise the codec would keep reporting it
+            // as available. Flushing returns it to the codec.
+            continue;
+        }
+
+        MediaBuffer *in;
+        do {
+            err = mSource->read(&in, &mReadOptions);
+            mReadOptions.clearSeekTo();
+        } while (err == INFO_FORMAT_CHANGED);
+
+        size_t size = 0;
+        int64_t timeUs = 0ll;
+        uint32_t flags = 0;
+
+        if (err == OK) {
+            const sp<ABuffer> &dst = mInputBuffers.itemAt(index);
+
+            size = in->range_length();
+
+            if (size > dst->capacity()) {
+                ALOGE("[%s] input buffer too small (%d > %d)",
+                      mComponentName.c_str(), size, dst->capacity());
+
+                err = ERROR_BUFFER_TOO_SMALL;
+                size = 0;
+            } else {
+                memcpy(dst->base(),
+                       (const uint8_t *)in->data() + in->range_offset(),
+                       size);
+
+                CHECK(in->meta_data()->findInt64(kKeyTime, &timeUs));
+
+                int32_t isCodecConfig;
+                if (in->meta_data()->findInt32(
+                            kKeyIsCodecConfig, &isCodecConfig)
+                        && isCodecConfig) {
+                    flags |= MediaCodec::BUFFER_FLAG_CODECCONFIG;
+                }
+            }
+
+            in->release();
+            in = NULL;
+        }
+
+        if (err != OK) {
+            ALOGV("[%s] input ended (err %d)", mComponentName.c_str(), err);
+
+            flags = MediaCodec::BUFFER_FLAG_EOS;
+            mInputEOS = true;
+
+            Mutex::Autolock autoLock(mLock);
+            mInputResult = err;
+        }
+
+        err = mCodec->queueInputBuffer(index, 0, size, timeUs, flags);
+
+        if (err != OK) {
+            signalCodecError(err);
+            return;
+        }
+
+        // Hand out whatever the codec produced meanwhile rather than only
+        // once all input buffers have been refilled.
+        drainOutputBuffers();
+
+        if (mCodecError) {
+            return;
+        }
+    }
+}
+
+void MediaCodecDecodingSource::drainOutputBuffers() {
+    for (;;) {
+        OutputItem item;
+        size_t index;
+        status_t err = mCodec->dequeueOutputBuffer(
+                &index, &item.mOffset, &item.mSize, &item.mTimeUs,
+                &item.mFlags);
+
+        if (err == -EAGAIN) {
+            break;
+        } else if (err == INFO_OUTPUT_BUFFERS_CHANGED) {
+            Mutex::Autolock autoLock(mLock);
+            CHECK_EQ(mCodec->getOutputBuffers(&mOutputBuffers), (status_t)OK);
+            continue;
+        } else if (err == INFO_FORMAT_CHANGED) {
+            item.mIndex = -1;
+            CHECK_EQ(mCodec->getOutputFormat(&item.mFormat), (status_t)OK);
+        } else if (err != OK) {
+            signalCodecError(err);
+            return;
+        } else {
+            item.mIndex = index;
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        mOutputQueue.push_back(item);
+        mOutputAvailable.signal();
+    }
+}
+
+void MediaCodecDecodingSource::onSeek(
+        int64_t seekTimeUs, ReadOptions::SeekMode mode) {
+    if (!mStarted) {
+        return;
+    }
+
+    ALOGV("[%s] seeking to %lld us", mComponentName.c_str(), seekTimeUs);
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        status_t err = mCodec->flush();
+
+        mOutputQueue.clear();
+        ++mOutputGeneration;
+
+        mInputResult = OK;
+        mOutputResult = err;
+        mCodecError = (err != OK);
+    }
+
+    mInputEOS = false;
+    mReadOptions.setSeekTo(seekTimeUs, mode);
+}
+
+void MediaCodecDecodingSource::onStop() {
+    if (!mStarted) {
+        return;
+    }
+
+    mStarted = false;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        ALOGW_IF(!mClientBuffers.isEmpty(),
+                 "[%s] stopping with %d buffers still held by the client",
+                 mComponentName.c_str(), mClientBuffers.size());
+
+        mCodec->stop();
+
+        mOutputQueue.clear();
+        ++mOutputGeneration;
+
+        mOutputResult = ERROR_END_OF_STREAM;
+        mOutputAvailable.broadcast();
+    }
+
+    mSource->stop();
+}
+
+void MediaCodecDecodingSource::signalCodecError(status_t err) {
+    ALOGE("[%s] codec error %d", mComponentName.c_str(), err);
+
+    mCodecError = true;
+
+    Mutex::Autolock autoLock(mLock);
+    mOutputResult = err;
+    mOutputAvailable.signal();
+}
+
+sp<MetaData> MediaCodecDecodingSource::convertOutputFormat(
+        const sp<AMessage> &format) const {
+    sp<MetaData> meta = new MetaData;
+    convertMessageToMetaData(format, meta);
+
+    AString mime;
+    if (format->findString("mime", &mime)
+            && !strncasecmp("video/", mime.c_str(), 6)) {
+        int32_t colorFormat, stride, sliceHeight;
+        if (format->findInt32("color-format", &colorFormat)) {
+            meta->setInt32(kKeyColorFormat, colorFormat);
+        }
+        if (format->findInt32("stride", &stride)) {
+            meta->setInt32(kKeyStride, stride);
+        }
+        if (format->findInt32("slice-height", &sliceHeight)) {
+            meta->setInt32(kKeySliceHeight, sliceHeight);
+        }
+
+        int32_t left, top, right, bottom;
+        if (format->findRect("crop", &left, &top, &right, &bottom)) {
+            meta->setRect(kKeyCropRect, left, top, right, bottom);
+        }
+    }
+
+    meta->setCString(kKeyDecoderComponent, mComponentName.c_str());
+    if (mDurationUs >= 0ll) {
+        meta->setInt64(kKeyDuration, mDurationUs);
+    }
+
+    return meta;
+}
+
+}  // namespace android
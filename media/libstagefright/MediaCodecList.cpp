@@ -27,6 +27,7 @@
 #include <utils/threads.h>
 
 #include <libexpat/expat.h>
+#include <sys/stat.h>
 #include "include/ExtendedUtils.h"
 
 namespace android {
@@ -72,6 +73,8 @@ MediaCodecList::MediaCodecList()
         QcomAACQuirks.push(AString("requires-allocate-on-output-ports"));
         ExtendedUtils::helper_addMediaCodec(mCodecInfos, mTypes, false, "OMX.qcom.audio.decoder.multiaac",
             "audio/mp4a-latm", ExtendedUtils::helper_getCodecSpecificQuirks(mCodecQuirks, QcomAACQuirks));
+
+        buildLookupTables();
     }
 
 #if 0
@@ -116,7 +119,14 @@ void MediaCodecList::parseXMLFile(FILE *file) {
     ::XML_SetElementHandler(
             parser, StartElementHandlerWrapper, EndElementHandlerWrapper);
 
-    const int BUFF_SIZE = 512;
+    // Hand the whole file to the parser at once if we can tell its size.
+    int BUFF_SIZE = 512;
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0 && st.st_size > 0
+            && st.st_size < 1024 * 1024) {
+        BUFF_SIZE = st.st_size;
+    }
+
     while (mInitCheck == OK) {
         void *buff = ::XML_GetBuffer(parser, BUFF_SIZE);
         if (buff == NULL) {
@@ -418,6 +428,37 @@ void MediaCodecList::addType(const char *name) {
     info->mTypes |= 1ul << bit;
 }
 
+void MediaCodecList::buildLookupTables() {
+    mCodecIndicesByName.clear();
+    mCodecIndicesByType.clear();
+
+    for (size_t i = 0; i < mCodecInfos.size(); ++i) {
+        const CodecInfo &info = mCodecInfos.itemAt(i);
+
+        // The first codec of a given name wins, as it did in the
+        // linear search.
+        if (mCodecIndicesByName.indexOfKey(info.mName) < 0) {
+            mCodecIndicesByName.add(info.mName, i);
+        }
+
+        for (size_t j = 0; j < mTypes.size(); ++j) {
+            uint32_t bit = mTypes.valueAt(j);
+
+            if (!(info.mTypes & (1ul << bit))) {
+                continue;
+            }
+
+            uint32_t key = (bit << 1) | (info.mIsEncoder ? 1 : 0);
+
+            ssize_t index = mCodecIndicesByType.indexOfKey(key);
+            if (index < 0) {
+                index = mCodecIndicesByType.add(key, Vector<size_t>());
+            }
+            mCodecIndicesByType.editValueAt(index).push(i);
+        }
+    }
+}
+
 ssize_t MediaCodecList::findCodecByType(
         const char *type, bool encoder, size_t startIndex) const {
     ssize_t typeIndex = mTypes.indexOfKey(type);
@@ -426,31 +467,43 @@ ssize_t MediaCodecList::findCodecByType(
         return -ENOENT;
     }
 
-    uint32_t typeMask = 1ul << mTypes.valueAt(typeIndex);
+    uint32_t key = (mTypes.valueAt(typeIndex) << 1) | (encoder ? 1 : 0);
+
+    ssize_t index = mCodecIndicesByType.indexOfKey(key);
+    if (index < 0) {
+        return -ENOENT;
+    }
+
+    const Vector<size_t> &indices = mCodecIndicesByType.valueAt(index);
 
-    while (startIndex < mCodecInfos.size()) {
-        const CodecInfo &info = mCodecInfos.itemAt(startIndex);
+    // Find the first codec at or after startIndex.
+    size_t lo = 0;
+    size_t hi = indices.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
 
-        if (info.mIsEncoder == encoder && (info.mTypes & typeMask)) {
-            return startIndex;
+        if (indices.itemAt(mid) < startIndex) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
+    }
 
-        ++startIndex;
+    if (lo == indices.size()) {
+        return -ENOENT;
     }
 
-    return -ENOENT;
+    return indices.itemAt(lo);
 }
 
 ssize_t MediaCodecList::findCodecByName(const char *name) const {
-    for (size_t i = 0; i < mCodecInfos.size(); ++i) {
-        const CodecInfo &info = mCodecInfos.itemAt(i);
+    ssize_t index = mCodecIndicesByName.indexOfKey(AString(name));
 
-        if (info.mName == name) {
-            return i;
-        }
+    if (index < 0) {
+        return -ENOENT;
     }
 
-    return -ENOENT;
+    return mCodecIndicesByName.valueAt(index);
 }
 
 size_t MediaCodecList::countCodecs() const {
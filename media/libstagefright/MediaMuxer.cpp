@@ -161,9 +161,60 @@ status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackInde
         return -EINVAL;
     }
 
-    MediaBuffer* mediaBuffer = new MediaBuffer(buffer);
+    MediaBuffer* mediaBuffer = wrapSampleData(buffer, timeUs, flags);
+
+    sp<MediaAdapter> currentTrack = mTrackList[trackIndex];
+    // This pushBuffer will wait until the mediaBuffer is consumed.
+    return currentTrack->pushBuffer(mediaBuffer);
+}
+
+status_t MediaMuxer::writeSampleDataAsync(const sp<ABuffer> &buffer,
+        size_t trackIndex, int64_t timeUs, uint32_t flags,
+        const sp<AMessage> &notify) {
+    sp<MediaAdapter> currentTrack;
+    {
+        Mutex::Autolock autoLock(mMuxerLock);
+
+        if (buffer.get() == NULL) {
+            ALOGE("WriteSampleDataAsync() get an NULL buffer.");
+            return -EINVAL;
+        }
+
+        if (mState != STARTED) {
+            ALOGE("WriteSampleDataAsync() is called in invalid state %d", mState);
+            return INVALID_OPERATION;
+        }
+
+        if (trackIndex >= mTrackList.size()) {
+            ALOGE("WriteSampleDataAsync() get an invalid index %d", trackIndex);
+            return -EINVAL;
+        }
 
-    mediaBuffer->add_ref(); // Released in MediaAdapter::signalBufferReturned().
+        currentTrack = mTrackList[trackIndex];
+    }
+
+    // Without the muxer lock, so that a full queue on one track does not
+    // hold the others back.
+    MediaBuffer* mediaBuffer = wrapSampleData(buffer, timeUs, flags);
+
+    sp<AMessage> releaseNotify;
+    if (notify != NULL) {
+        releaseNotify = notify->dup();
+        releaseNotify->setBuffer("buffer", buffer);
+    }
+
+    status_t err = currentTrack->pushBufferAsync(mediaBuffer, releaseNotify);
+    if (err != OK) {
+        mediaBuffer->release();
+    }
+    return err;
+}
+
+MediaBuffer *MediaMuxer::wrapSampleData(const sp<ABuffer> &buffer,
+        int64_t timeUs, uint32_t flags) {
+    // The reference for the reader is taken by MediaAdapter::read(), a
+    // buffer that was never read can be released right away.
+    MediaBuffer* mediaBuffer = new MediaBuffer(buffer);
     mediaBuffer->set_range(buffer->offset(), buffer->size());
 
     sp<MetaData> sampleMetaData = mediaBuffer->meta_data();
@@ -175,9 +226,7 @@ status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackInde
         sampleMetaData->setInt32(kKeyIsSyncFrame, true);
     }
 
-    sp<MediaAdapter> currentTrack = mTrackList[trackIndex];
-    // This pushBuffer will wait until the mediaBuffer is consumed.
-    return currentTrack->pushBuffer(mediaBuffer);
+    return mediaBuffer;
 }
 
 }  // namespace android
@@ -40,14 +40,20 @@ MetaData::~MetaData() {
     clear();
 }
 
+// Empties the items but keeps their keys, so that a MediaBuffer meta data cleared for every
+// frame and filled with the same few keys does not reallocate its vector each time.
 void MetaData::clear() {
-    mItems.clear();
+    for (size_t i = 0; i < mItems.size(); ++i) {
+        if (!mItems.valueAt(i).isEmpty()) {
+            mItems.editValueAt(i).clear();
+        }
+    }
 }
 
 bool MetaData::remove(uint32_t key) {
     ssize_t i = mItems.indexOfKey(key);
 
-    if (i < 0) {
+    if (i < 0 || mItems.valueAt(i).isEmpty()) {
         return false;
     }
 
@@ -193,6 +199,8 @@ bool MetaData::setData(
         typed_data item;
         i = mItems.add(key, item);
 
+        overwrote_existing = false;
+    } else if (mItems.valueAt(i).isEmpty()) {
         overwrote_existing = false;
     }
 
@@ -213,6 +221,10 @@ bool MetaData::findData(uint32_t key, uint32_t *type,
 
     const typed_data &item = mItems.valueAt(i);
 
+    if (item.isEmpty()) {
+        return false;
+    }
+
     item.getData(type, data, size);
 
     return true;
@@ -346,6 +358,9 @@ void MetaData::dumpToLog() const {
         char cc[5];
         MakeFourCCString(key, cc);
         const typed_data &item = mItems.valueAt(i);
+        if (item.isEmpty()) {
+            continue;
+        }
         ALOGI("%s: %s", cc, item.asString().string());
     }
 }
@@ -42,6 +42,7 @@ struct PageCache {
 
     void appendPage(Page *page);
     size_t releaseFromStart(size_t maxBytes);
+    void truncate(size_t maxBytes);
 
     size_t totalSize() const {
         return mTotalSize;
@@ -134,6 +135,26 @@ size_t PageCache::releaseFromStart(size_t maxBytes) {
     return bytesReleased;
 }
 
+// Frees whole pages from the end until at most maxBytes remain cached, along
+// with all free pages: a truncated cache is retained, not appended to.
+void PageCache::truncate(size_t maxBytes) {
+    while (mTotalSize > maxBytes && !mActivePages.empty()) {
+        List<Page *>::iterator it = --mActivePages.end();
+
+        Page *page = *it;
+        mActivePages.erase(it);
+
+        mTotalSize -= page->mSize;
+
+        free(page->mData);
+        delete page;
+        page = NULL;
+    }
+
+    freePages(&mFreePages);
+    mFreePages.clear();
+}
+
 void PageCache::copy(size_t from, void *data, size_t size) {
     ALOGV("copy from %d size %d", from, size);
 
@@ -193,6 +214,12 @@ NuCachedSource2::NuCachedSource2(
       mNumRetriesLeft(kMaxNumRetries),
       mHighwaterThresholdBytes(kDefaultHighWaterThreshold),
       mLowwaterThresholdBytes(kDefaultLowWaterThreshold),
+      mAdaptiveWatermarks(true),
+      mBaseLowwaterThresholdBytes(kDefaultLowWaterThreshold),
+      mRateSampleTimeUs(-1),
+      mRateSampleAccessPos(0),
+      mConsumedBytesPerSec(0),
+      mFetchedBytesPerSec(0),
       mKeepAliveIntervalUs(kDefaultKeepAliveIntervalUs),
       mDisconnectAtHighwatermark(disconnectAtHighwatermark) {
     // We are NOT going to support disconnect-at-highwatermark indefinitely
@@ -206,6 +233,8 @@ NuCachedSource2::NuCachedSource2(
         updateCacheParamsFromString(cacheConfig);
     }
 
+    mBaseLowwaterThresholdBytes = mLowwaterThresholdBytes;
+
     if (mDisconnectAtHighwatermark) {
         // Makes no sense to disconnect and do keep-alives...
         mKeepAliveIntervalUs = 0;
@@ -225,6 +254,12 @@ NuCachedSource2::~NuCachedSource2() {
 
     delete mCache;
     mCache = NULL;
+
+    for (List<CacheSegment>::iterator it = mRetainedSegments.begin();
+            it != mRetainedSegments.end(); ++it) {
+        delete (*it).mCache;
+    }
+    mRetainedSegments.clear();
 }
 
 status_t NuCachedSource2::getEstimatedBandwidthKbps(int32_t *kbps) {
@@ -313,11 +348,22 @@ void NuCachedSource2::fetchInternal() {
 
     PageCache::Page *page = mCache->acquirePage();
 
+    int64_t startTimeUs = ALooper::GetNowUs();
+
     ssize_t n = mSource->readAt(
             mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
 
+    int64_t elapsedUs = ALooper::GetNowUs() - startTimeUs;
+
     Mutex::Autolock autoLock(mLock);
 
+    if (n > 0 && elapsedUs > 0) {
+        // Exponential moving average, weighting the new sample by 1/8.
+        int64_t bytesPerSec = n * 1000000ll / elapsedUs;
+        mFetchedBytesPerSec = (mFetchedBytesPerSec == 0)
+            ? bytesPerSec : (7 * mFetchedBytesPerSec + bytesPerSec) / 8;
+    }
+
     if (n < 0) {
         mFinalStatus = n;
         if (n == ERROR_UNSUPPORTED || n == -EPIPE) {
@@ -350,6 +396,11 @@ void NuCachedSource2::fetchInternal() {
 void NuCachedSource2::onFetch() {
     ALOGV("onFetch");
 
+    {
+        Mutex::Autolock autoLock(mLock);
+        updateWatermarks_l();
+    }
+
     if (mFinalStatus != OK && mNumRetriesLeft == 0) {
         ALOGV("EOS reached, done prefetching for now");
         mFetching = false;
@@ -543,8 +594,9 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
                 true); // force
     }
 
-    if (offset < mCacheOffset
-            || offset >= (off64_t)(mCacheOffset + mCache->totalSize())) {
+    if ((offset < mCacheOffset
+            || offset >= (off64_t)(mCacheOffset + mCache->totalSize()))
+            && !restoreRetainedSegment_l(offset)) {
         static const off64_t kPadding = 256 * 1024;
 
         // In the presence of multiple decoded streams, once of them will
@@ -595,6 +647,8 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
 
     ALOGI("new range: offset= %lld", offset);
 
+    retainActiveSegment_l();
+
     mCacheOffset = offset;
 
     size_t totalSize = mCache->totalSize();
@@ -606,6 +660,125 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
     return OK;
 }
 
+// Moves the start of the active range into a retained segment, the active
+// cache is left empty.
+void NuCachedSource2::retainActiveSegment_l() {
+    if (mCache->totalSize() == 0) {
+        return;
+    }
+
+    PageCache *cache;
+    if (mRetainedSegments.size() >= kMaxNumRetainedSegments) {
+        // Recycle the least recently used segment's pages.
+        List<CacheSegment>::iterator it = --mRetainedSegments.end();
+        cache = (*it).mCache;
+        mRetainedSegments.erase(it);
+
+        size_t totalSize = cache->totalSize();
+        CHECK_EQ(cache->releaseFromStart(totalSize), totalSize);
+    } else {
+        cache = new PageCache(kPageSize);
+    }
+
+    CacheSegment segment;
+    segment.mOffset = mCacheOffset;
+    segment.mCache = mCache;
+    segment.mCache->truncate(kMaxRetainedSegmentSize);
+    mRetainedSegments.push_front(segment);
+
+    ALOGV("retained %d bytes at offset %lld",
+          segment.mCache->totalSize(), segment.mOffset);
+
+    mCache = cache;
+}
+
+// If a retained segment holds "offset", swaps it with the active range and
+// resumes fetching from its end.
+bool NuCachedSource2::restoreRetainedSegment_l(off64_t offset) {
+    for (List<CacheSegment>::iterator it = mRetainedSegments.begin();
+            it != mRetainedSegments.end(); ++it) {
+        const CacheSegment &segment = *it;
+        if (offset < segment.mOffset
+                || offset >= segment.mOffset
+                    + (off64_t)segment.mCache->totalSize()) {
+            continue;
+        }
+
+        PageCache *cache = segment.mCache;
+        off64_t cacheOffset = segment.mOffset;
+        mRetainedSegments.erase(it);
+
+        ALOGI("restoring cached range: offset= %lld, size= %d",
+              cacheOffset, cache->totalSize());
+
+        retainActiveSegment_l();
+
+        delete mCache;
+        mCache = cache;
+        mCacheOffset = cacheOffset;
+        mLastAccessPos = offset;
+
+        mNumRetriesLeft = kMaxNumRetries;
+        mFetching = true;
+
+        return true;
+    }
+
+    return false;
+}
+
+// Raises the low watermark so that the prefetcher restarts early enough for
+// the measured bandwidth to keep up with the measured consumption.
+void NuCachedSource2::updateWatermarks_l() {
+    int64_t nowUs = ALooper::GetNowUs();
+
+    if (mRateSampleTimeUs < 0) {
+        mRateSampleTimeUs = nowUs;
+        mRateSampleAccessPos = mLastAccessPos;
+        return;
+    }
+
+    int64_t elapsedUs = nowUs - mRateSampleTimeUs;
+    if (elapsedUs < kRateSampleIntervalUs) {
+        return;
+    }
+
+    off64_t consumed = mLastAccessPos - mRateSampleAccessPos;
+    mRateSampleTimeUs = nowUs;
+    mRateSampleAccessPos = mLastAccessPos;
+
+    if (consumed <= 0 || consumed > (off64_t)mHighwaterThresholdBytes) {
+        // Paused or seeking, not a playback rate.
+        return;
+    }
+
+    int64_t bytesPerSec = consumed * 1000000ll / elapsedUs;
+    mConsumedBytesPerSec = (mConsumedBytesPerSec == 0)
+        ? bytesPerSec : (7 * mConsumedBytesPerSec + bytesPerSec) / 8;
+
+    if (!mAdaptiveWatermarks) {
+        return;
+    }
+
+    int64_t durationUs = kLowWaterDurationUs;
+    if (mFetchedBytesPerSec < 2 * mConsumedBytesPerSec) {
+        durationUs *= 2;
+    }
+
+    int64_t lowwater = mConsumedBytesPerSec * durationUs / 1000000ll;
+    if (lowwater < (int64_t)mBaseLowwaterThresholdBytes) {
+        lowwater = mBaseLowwaterThresholdBytes;
+    } else if (lowwater > (int64_t)mHighwaterThresholdBytes / 2) {
+        lowwater = mHighwaterThresholdBytes / 2;
+    }
+
+    if ((size_t)lowwater != mLowwaterThresholdBytes) {
+        ALOGV("lowwater = %lld bytes (consuming %lld, fetching %lld bytes/sec)",
+              lowwater, mConsumedBytesPerSec, mFetchedBytesPerSec);
+        mLowwaterThresholdBytes = lowwater;
+    }
+}
+
 void NuCachedSource2::resumeFetchingIfNecessary() {
     Mutex::Autolock autoLock(mLock);
 
@@ -647,6 +820,8 @@ void NuCachedSource2::updateCacheParamsFromString(const char *s) {
         return;
     }
 
+    mAdaptiveWatermarks = false;
+
     if (lowwaterMarkKb >= 0) {
         mLowwaterThresholdBytes = lowwaterMarkKb * 1024;
     } else {
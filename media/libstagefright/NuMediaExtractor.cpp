@@ -39,6 +39,27 @@
 
 namespace android {
 
+// An ABuffer referencing the payload of a MediaBuffer, which is released
+// along with it.
+struct MediaBufferHolder : public ABuffer {
+    MediaBufferHolder(MediaBuffer *mediaBuffer)
+        : ABuffer((uint8_t *)mediaBuffer->data() + mediaBuffer->range_offset(),
+                  mediaBuffer->range_length()),
+          mMediaBuffer(mediaBuffer) {
+    }
+
+protected:
+    virtual ~MediaBufferHolder() {
+        mMediaBuffer->release();
+        mMediaBuffer = NULL;
+    }
+
+private:
+    MediaBuffer *mMediaBuffer;
+
+    DISALLOW_EVIL_CONSTRUCTORS(MediaBufferHolder);
+};
+
 NuMediaExtractor::NuMediaExtractor()
     : mIsWidevineExtractor(false),
       mTotalBitrate(-1ll),
@@ -451,6 +472,51 @@ status_t NuMediaExtractor::readSampleData(const sp<ABuffer> &buffer) {
 
     TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
 
+    size_t sampleSize = getSampleSize(info);
+
+    if (buffer->capacity() < sampleSize) {
+        return -ENOMEM;
+    }
+
+    copySample(info, (uint8_t *)buffer->data());
+
+    buffer->setRange(0, sampleSize);
+
+    return OK;
+}
+
+status_t NuMediaExtractor::readSampleBuffer(sp<ABuffer> *buffer) {
+    Mutex::Autolock autoLock(mLock);
+
+    buffer->clear();
+
+    ssize_t minIndex = fetchTrackSamples();
+
+    if (minIndex < 0) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
+
+    if (info->mTrackFlags & kIsVorbis) {
+        // The page sample count has to be appended, which needs a copy.
+        *buffer = ABuffer::CreatePooled(getSampleSize(info));
+        copySample(info, (*buffer)->data());
+
+        info->mSample->release();
+    } else {
+        *buffer = new MediaBufferHolder(info->mSample);
+    }
+
+    (*buffer)->meta()->setInt64("timeUs", info->mSampleTimeUs);
+
+    info->mSample = NULL;
+    info->mSampleTimeUs = -1ll;
+
+    return OK;
+}
+
+size_t NuMediaExtractor::getSampleSize(const TrackInfo *info) const {
     size_t sampleSize = info->mSample->range_length();
 
     if (info->mTrackFlags & kIsVorbis) {
@@ -459,15 +525,15 @@ status_t NuMediaExtractor::readSampleData(const sp<ABuffer> &buffer) {
         sampleSize += sizeof(int32_t);
     }
 
-    if (buffer->capacity() < sampleSize) {
-        return -ENOMEM;
-    }
+    return sampleSize;
+}
 
+void NuMediaExtractor::copySample(const TrackInfo *info, uint8_t *dst) const {
     const uint8_t *src =
         (const uint8_t *)info->mSample->data()
             + info->mSample->range_offset();
 
-    memcpy((uint8_t *)buffer->data(), src, info->mSample->range_length());
+    memcpy(dst, src, info->mSample->range_length());
 
     if (info->mTrackFlags & kIsVorbis) {
         int32_t numPageSamples;
@@ -476,14 +542,10 @@ status_t NuMediaExtractor::readSampleData(const sp<ABuffer> &buffer) {
             numPageSamples = -1;
         }
 
-        memcpy((uint8_t *)buffer->data() + info->mSample->range_length(),
+        memcpy(dst + info->mSample->range_length(),
                &numPageSamples,
                sizeof(numPageSamples));
     }
-
-    buffer->setRange(0, sampleSize);
-
-    return OK;
 }
 
 status_t NuMediaExtractor::getSampleTrackIndex(size_t *trackIndex) {
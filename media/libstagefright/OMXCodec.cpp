@@ -25,10 +25,12 @@
 #include "include/MP3Decoder.h"
 
 #include "include/ESDS.h"
+#include "include/MediaCodecDecodingSource.h"
 
 #include <binder/IServiceManager.h>
 #include <binder/MemoryDealer.h>
 #include <binder/ProcessState.h>
+#include <cutils/properties.h>
 #include <HardwareAPI.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/IMediaPlayerService.h>
@@ -352,6 +354,14 @@ bool OMXCodec::findCodecQuirks(const char *componentName, uint32_t *quirks) {
     return true;
 }
 
+// Lets the OMXCodec clients decode through MediaCodec and ACodec without
+// being changed, for those cases where that path applies.
+static bool UseMediaCodecForDecoding() {
+    char value[PROPERTY_VALUE_MAX];
+    return property_get("media.stagefright.omxcodec.mediacodec", value, NULL)
+        && (!strcmp(value, "1") || !strcasecmp(value, "true"));
+}
+
 // static
 sp<MediaSource> OMXCodec::Create(
         const sp<IOMX> &omx,
@@ -390,6 +400,23 @@ sp<MediaSource> OMXCodec::Create(
         return NULL;
     }
 
+    if (!createEncoder
+            && nativeWindow == NULL
+            && !(flags & (kUseSecureInputBuffers
+                          | kClientNeedsFramebuffer
+                          | kStoreMetaDataInVideoBuffers))
+            && ((flags & kUseMediaCodec) || UseMediaCodecForDecoding())) {
+        sp<MediaSource> decoder =
+            MediaCodecDecodingSource::Create(meta, source, matchingCodecs);
+
+        if (decoder != NULL) {
+            return decoder;
+        }
+
+        ALOGW("Unable to decode %s through MediaCodec, "
+              "falling back to OMXCodec", mime);
+    }
+
     sp<OMXCodecObserver> observer = new OMXCodecObserver;
     IOMX::node_id node = 0;
 
@@ -712,6 +739,16 @@ status_t OMXCodec::configureCodec(const sp<MetaData> &meta) {
         setMinBufferSize(kPortIndexInput, (OMX_U32)maxInputSize);
     }
 
+    // Larger output buffers make the software audio decoders pack several
+    // frames into each of them. Other components are left alone, they may
+    // not accept a different output buffer size.
+    int32_t maxOutputSize;
+    if (!mIsEncoder && !mIsVideo
+            && !strncmp(mComponentName, "OMX.google.", 11)
+            && meta->findInt32(kKeyMaxOutputSize, &maxOutputSize)) {
+        setMinBufferSize(kPortIndexOutput, (OMX_U32)maxOutputSize);
+    }
+
     initOutputFormat(meta);
 
     if ((mFlags & kClientNeedsFramebuffer)
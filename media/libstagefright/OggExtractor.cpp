@@ -94,6 +94,7 @@ private:
     struct TOCEntry {
         off64_t mPageOffset;
         int64_t mTimeUs;
+        uint64_t mPrevGranulePosition;
     };
 
     sp<DataSource> mSource;
@@ -115,8 +116,19 @@ private:
 
     Vector<TOCEntry> mTableOfContents;
 
+    // If there is no table of contents, i.e. the source is too expensive
+    // to scan upfront, the pages we come across during playback are
+    // remembered here, at most one per mSeekIndexIntervalUs.
+    Vector<TOCEntry> mSeekIndex;
+    int64_t mSeekIndexIntervalUs;
+
     ssize_t readPage(off64_t offset, Page *page);
     status_t findNextPage(off64_t startOffset, off64_t *pageOffset);
+    status_t seekToPage(off64_t pageOffset, uint64_t prevGranulePosition);
+    status_t seekUsingSeekIndex(int64_t timeUs);
+    void addToSeekIndex(
+            off64_t pageOffset, uint64_t prevGranulePosition,
+            uint64_t granulePosition);
 
     status_t verifyHeader(
             MediaBuffer *buffer, uint8_t type);
@@ -134,6 +146,20 @@ private:
 static void extractAlbumArt(
         const sp<MetaData> &fileMeta, const void *data, size_t size);
 
+// Granule position of pages on which no packet ends.
+static const uint64_t kNoGranulePosition = 0xffffffffffffffffull;
+
+// Pages are searched for this many bytes at a time.
+static const size_t kPageScanSize = 1024;
+
+// Initial spacing and maximum size of the seek index built during playback.
+static const int64_t kSeekIndexIntervalUs = 1000000ll;
+static const size_t kMaxSeekIndexSize = 32768;
+
+// Don't scan forward through more than this many bytes of pages to reach
+// the target of a seek from the closest seek index entry.
+static const off64_t kMaxSeekIndexScanBytes = 256 * 1024;
+
 ////////////////////////////////////////////////////////////////////////////////
 
 OggSource::OggSource(const sp<OggExtractor> &extractor)
@@ -212,7 +238,8 @@ MyVorbisExtractor::MyVorbisExtractor(const sp<DataSource> &source)
       mFirstPacketInPage(true),
       mCurrentPageSamples(0),
       mNextLaceIndex(0),
-      mFirstDataOffset(-1) {
+      mFirstDataOffset(-1),
+      mSeekIndexIntervalUs(kSeekIndexIntervalUs) {
     mCurrentPage.mNumSegments = 0;
 
     vorbis_info_init(&mVi);
@@ -232,9 +259,11 @@ status_t MyVorbisExtractor::findNextPage(
         off64_t startOffset, off64_t *pageOffset) {
     *pageOffset = startOffset;
 
+    // Read a block at a time rather than probing every offset, each read
+    // may well cost a round-trip on a network source.
+    uint8_t buffer[kPageScanSize];
     for (;;) {
-        char signature[4];
-        ssize_t n = mSource->readAt(*pageOffset, &signature, 4);
+        ssize_t n = mSource->readAt(*pageOffset, buffer, sizeof(buffer));
 
         if (n < 4) {
             *pageOffset = 0;
@@ -242,16 +271,21 @@ status_t MyVorbisExtractor::findNextPage(
             return (n < 0) ? n : (status_t)ERROR_END_OF_STREAM;
         }
 
-        if (!memcmp(signature, "OggS", 4)) {
-            if (*pageOffset > startOffset) {
-                ALOGV("skipped %lld bytes of junk to reach next frame",
-                     *pageOffset - startOffset);
-            }
+        for (ssize_t i = 0; i + 4 <= n; ++i) {
+            if (!memcmp(&buffer[i], "OggS", 4)) {
+                *pageOffset += i;
 
-            return OK;
+                if (*pageOffset > startOffset) {
+                    ALOGV("skipped %lld bytes of junk to reach next frame",
+                         *pageOffset - startOffset);
+                }
+
+                return OK;
+            }
         }
 
-        ++*pageOffset;
+        // The signature may straddle the end of this block.
+        *pageOffset += n - 3;
     }
 }
 
@@ -311,6 +345,10 @@ status_t MyVorbisExtractor::findPrevGranulePosition(
 
 status_t MyVorbisExtractor::seekToTime(int64_t timeUs) {
     if (mTableOfContents.isEmpty()) {
+        if (seekUsingSeekIndex(timeUs) == OK) {
+            return OK;
+        }
+
         // Perform approximate seeking based on avg. bitrate.
 
         off64_t pos = timeUs * approxBitrate() / 8000000ll;
@@ -336,12 +374,115 @@ status_t MyVorbisExtractor::seekToTime(int64_t timeUs) {
         }
     }
 
+    if (left == mTableOfContents.size()) {
+        left = mTableOfContents.size() - 1;
+    }
+
     const TOCEntry &entry = mTableOfContents.itemAt(left);
 
     ALOGV("seeking to entry %d / %d at offset %lld",
          left, mTableOfContents.size(), entry.mPageOffset);
 
-    return seekToOffset(entry.mPageOffset);
+    return seekToPage(entry.mPageOffset, entry.mPrevGranulePosition);
+}
+
+status_t MyVorbisExtractor::seekUsingSeekIndex(int64_t timeUs) {
+    // Find the last entry at or before the target time. Its successor must
+    // be past the target, otherwise we don't know how far to scan.
+    size_t left = 0;
+    size_t right = mSeekIndex.size();
+    while (left < right) {
+        size_t center = left + (right - left) / 2;
+
+        if (mSeekIndex.itemAt(center).mTimeUs <= timeUs) {
+            left = center + 1;
+        } else {
+            right = center;
+        }
+    }
+
+    if (left == 0 || left == mSeekIndex.size()) {
+        return ERROR_OUT_OF_RANGE;
+    }
+
+    const TOCEntry &start = mSeekIndex.itemAt(left - 1);
+    const TOCEntry &end = mSeekIndex.itemAt(left);
+
+    if (end.mPageOffset - start.mPageOffset > kMaxSeekIndexScanBytes) {
+        return ERROR_OUT_OF_RANGE;
+    }
+
+    // Walk the page headers forward to the page that contains the target.
+    off64_t offset = start.mPageOffset;
+    uint64_t prevGranulePosition = start.mPrevGranulePosition;
+    while (offset < end.mPageOffset) {
+        Page page;
+        ssize_t n = readPage(offset, &page);
+
+        if (n <= 0) {
+            return n < 0 ? (status_t)n : (status_t)ERROR_END_OF_STREAM;
+        }
+
+        if (page.mGranulePosition != kNoGranulePosition
+                && (int64_t)(page.mGranulePosition * 1000000ll / mVi.rate)
+                        >= timeUs) {
+            break;
+        }
+
+        prevGranulePosition = page.mGranulePosition;
+        offset += n;
+    }
+
+    ALOGV("seeking to offset %lld using the seek index", offset);
+
+    return seekToPage(offset, prevGranulePosition);
+}
+
+void MyVorbisExtractor::addToSeekIndex(
+        off64_t pageOffset, uint64_t prevGranulePosition,
+        uint64_t granulePosition) {
+    if (!mTableOfContents.isEmpty() || mVi.rate == 0
+            || mFirstDataOffset < 0 || pageOffset < mFirstDataOffset
+            || granulePosition == kNoGranulePosition) {
+        return;
+    }
+
+    int64_t timeUs = granulePosition * 1000000ll / mVi.rate;
+
+    // Entries are kept sorted by offset, and therefore by time.
+    size_t left = 0;
+    size_t right = mSeekIndex.size();
+    while (left < right) {
+        size_t center = left + (right - left) / 2;
+
+        if (mSeekIndex.itemAt(center).mPageOffset < pageOffset) {
+            left = center + 1;
+        } else {
+            right = center;
+        }
+    }
+
+    if ((left > 0 && timeUs - mSeekIndex.itemAt(left - 1).mTimeUs
+                < mSeekIndexIntervalUs)
+            || (left < mSeekIndex.size()
+                && mSeekIndex.itemAt(left).mTimeUs - timeUs
+                    < mSeekIndexIntervalUs)) {
+        return;
+    }
+
+    TOCEntry entry;
+    entry.mPageOffset = pageOffset;
+    entry.mTimeUs = timeUs;
+    entry.mPrevGranulePosition = prevGranulePosition;
+    mSeekIndex.insertAt(entry, left);
+
+    if (mSeekIndex.size() * sizeof(TOCEntry) > kMaxSeekIndexSize) {
+        // Drop every other entry and space new ones out further.
+        for (ssize_t i = mSeekIndex.size() - 1; i > 0; i -= 2) {
+            mSeekIndex.removeAt(i);
+        }
+        mSeekIndexIntervalUs *= 2;
+    }
 }
 
 status_t MyVorbisExtractor::seekToOffset(off64_t offset) {
@@ -361,7 +502,15 @@ status_t MyVorbisExtractor::seekToOffset(off64_t offset) {
     // We found the page we wanted to seek to, but we'll also need
     // the page preceding it to determine how many valid samples are on
     // this page.
-    findPrevGranulePosition(pageOffset, &mPrevGranulePosition);
+    uint64_t prevGranulePosition;
+    findPrevGranulePosition(pageOffset, &prevGranulePosition);
+
+    return seekToPage(pageOffset, prevGranulePosition);
+}
+
+status_t MyVorbisExtractor::seekToPage(
+        off64_t pageOffset, uint64_t prevGranulePosition) {
+    mPrevGranulePosition = prevGranulePosition;
 
     mOffset = pageOffset;
 
@@ -377,12 +526,12 @@ status_t MyVorbisExtractor::seekToOffset(off64_t offset) {
 }
 
 ssize_t MyVorbisExtractor::readPage(off64_t offset, Page *page) {
-    uint8_t header[27];
+    // Read the header and the largest possible lacing table at once.
+    uint8_t header[27 + 255];
     ssize_t n;
-    if ((n = mSource->readAt(offset, header, sizeof(header)))
-            < (ssize_t)sizeof(header)) {
-        ALOGV("failed to read %d bytes at offset 0x%016llx, got %ld bytes",
-             sizeof(header), offset, n);
+    if ((n = mSource->readAt(offset, header, sizeof(header))) < 27) {
+        ALOGV("failed to read 27 bytes at offset 0x%016llx, got %ld bytes",
+             offset, n);
 
         if (n < 0) {
             return n;
@@ -421,11 +570,10 @@ ssize_t MyVorbisExtractor::readPage(off64_t offset, Page *page) {
     page->mPageNo = U32LE_AT(&header[18]);
 
     page->mNumSegments = header[26];
-    if (mSource->readAt(
-                offset + sizeof(header), page->mLace, page->mNumSegments)
-            < (ssize_t)page->mNumSegments) {
+    if (n < 27 + page->mNumSegments) {
         return ERROR_IO;
     }
+    memcpy(page->mLace, &header[27], page->mNumSegments);
 
     size_t totalSize = 0;;
     for (size_t i = 0; i < page->mNumSegments; ++i) {
@@ -444,7 +592,7 @@ ssize_t MyVorbisExtractor::readPage(off64_t offset, Page *page) {
     ALOGV("%c %s", page->mFlags & 1 ? '+' : ' ', tmp.string());
 #endif
 
-    return sizeof(header) + page->mNumSegments + totalSize;
+    return 27 + page->mNumSegments + totalSize;
 }
 
 status_t MyVorbisExtractor::readNextPacket(MediaBuffer **out) {
@@ -551,6 +699,9 @@ status_t MyVorbisExtractor::readNextPacket(MediaBuffer **out) {
             return n < 0 ? n : (status_t)ERROR_END_OF_STREAM;
         }
 
+        addToSeekIndex(
+                mOffset, mPrevGranulePosition, mCurrentPage.mGranulePosition);
+
         mCurrentPageSamples =
             mCurrentPage.mGranulePosition - mPrevGranulePosition;
         mFirstPacketInPage = true;
@@ -645,6 +796,7 @@ status_t MyVorbisExtractor::init() {
 
 void MyVorbisExtractor::buildTableOfContents() {
     off64_t offset = mFirstDataOffset;
+    uint64_t prevGranulePosition = 0;
     Page page;
     ssize_t pageSize;
     while ((pageSize = readPage(offset, &page)) > 0) {
@@ -655,7 +807,9 @@ void MyVorbisExtractor::buildTableOfContents() {
 
         entry.mPageOffset = offset;
         entry.mTimeUs = page.mGranulePosition * 1000000ll / mVi.rate;
+        entry.mPrevGranulePosition = prevGranulePosition;
 
+        prevGranulePosition = page.mGranulePosition;
         offset += (size_t)pageSize;
     }
 
@@ -148,6 +148,29 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
 status_t SampleIterator::findChunkRange(uint32_t sampleIndex) {
     CHECK(sampleIndex >= mFirstChunkSampleIndex);
 
+    if (mTable->mSampleToChunkIndexed
+            && mSampleToChunkIndex < mTable->mNumSampleToChunkOffsets) {
+        // Skip straight to the last entry starting at or before sampleIndex instead of
+        // walking all the entries in between, which matters for seeks in long files.
+        uint32_t left = mSampleToChunkIndex;
+        uint32_t right = mTable->mNumSampleToChunkOffsets;
+        while (right - left > 1) {
+            uint32_t center = left + (right - left) / 2;
+            if (sampleIndex
+                    < mTable->mSampleToChunkEntries[center].firstSampleIndex) {
+                right = center;
+            } else {
+                left = center;
+            }
+        }
+
+        if (left > mSampleToChunkIndex) {
+            mSampleToChunkIndex = left;
+            mStopChunkSampleIndex =
+                mTable->mSampleToChunkEntries[left].firstSampleIndex;
+        }
+    }
+
     while (sampleIndex >= mStopChunkSampleIndex) {
         if (mSampleToChunkIndex == mTable->mNumSampleToChunkOffsets) {
             return ERROR_OUT_OF_RANGE;
@@ -291,6 +314,19 @@ status_t SampleIterator::findSampleTime(
         return ERROR_OUT_OF_RANGE;
     }
 
+    if (sampleIndex >= mTTSSampleIndex + mTTSCount
+            && mTimeToSampleIndex < mTable->mTimeToSampleCount) {
+        uint32_t i = mTable->findTimeToSampleEntry(sampleIndex);
+
+        if (i > mTimeToSampleIndex) {
+            mTimeToSampleIndex = i;
+            mTTSSampleIndex = mTable->mTimeToSampleStarts[i].mSampleIndex;
+            mTTSSampleTime = mTable->mTimeToSampleStarts[i].mSampleTime;
+            mTTSCount = 0;
+            mTTSDuration = 0;
+        }
+    }
+
     while (sampleIndex >= mTTSSampleIndex + mTTSCount) {
         if (mTimeToSampleIndex == mTable->mTimeToSampleCount) {
             return ERROR_OUT_OF_RANGE;
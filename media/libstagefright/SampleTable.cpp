@@ -118,6 +118,7 @@ SampleTable::SampleTable(const sp<DataSource> &source)
       mNumSampleSizes(0),
       mTimeToSampleCount(0),
       mTimeToSample(NULL),
+      mTimeToSampleStarts(NULL),
       mSampleTimeEntries(NULL),
       mCompositionTimeDeltaEntries(NULL),
       mNumCompositionTimeDeltaEntries(0),
@@ -126,7 +127,8 @@ SampleTable::SampleTable(const sp<DataSource> &source)
       mNumSyncSamples(0),
       mSyncSamples(NULL),
       mLastSyncSampleIndex(0),
-      mSampleToChunkEntries(NULL) {
+      mSampleToChunkEntries(NULL),
+      mSampleToChunkIndexed(false) {
     mSampleIterator = new SampleIterator(this);
 }
 
@@ -146,6 +148,9 @@ SampleTable::~SampleTable() {
     delete[] mSampleTimeEntries;
     mSampleTimeEntries = NULL;
 
+    delete[] mTimeToSampleStarts;
+    mTimeToSampleStarts = NULL;
+
     delete[] mTimeToSample;
     mTimeToSample = NULL;
 
@@ -249,6 +254,26 @@ status_t SampleTable::setSampleToChunkParams(
         mSampleToChunkEntries[i].chunkDesc = U32_AT(&buffer[8]);
     }
 
+    mSampleToChunkIndexed = true;
+    uint64_t firstSampleIndex = 0;
+    for (uint32_t i = 0; i < mNumSampleToChunkOffsets; ++i) {
+        SampleToChunkEntry *entry = &mSampleToChunkEntries[i];
+        entry->firstSampleIndex = firstSampleIndex;
+
+        if (i + 1 < mNumSampleToChunkOffsets) {
+            if (entry[1].startChunk < entry->startChunk) {
+                mSampleToChunkIndexed = false;
+                continue;
+            }
+            firstSampleIndex +=
+                (uint64_t)(entry[1].startChunk - entry->startChunk)
+                    * entry->samplesPerChunk;
+            if (firstSampleIndex > 0xffffffff) {
+                mSampleToChunkIndexed = false;
+            }
+        }
+    }
+
     return OK;
 }
 
@@ -342,6 +367,24 @@ status_t SampleTable::setTimeToSampleParams(
         mTimeToSample[i] = ntohl(mTimeToSample[i]);
     }
 
+    mTimeToSampleStarts = new TimeToSampleStart[mTimeToSampleCount];
+
+    uint32_t sampleIndex = 0;
+    uint32_t sampleTime = 0;
+    for (uint32_t i = 0; i < mTimeToSampleCount; ++i) {
+        mTimeToSampleStarts[i].mSampleIndex = sampleIndex;
+        mTimeToSampleStarts[i].mSampleTime = sampleTime;
+
+        uint32_t n = mTimeToSample[2 * i];
+        if (n > 0xffffffff - sampleIndex) {
+            // more samples than the sample indices can count, ignore the entries left
+            mTimeToSampleCount = i + 1;
+            break;
+        }
+        sampleIndex += n;
+        sampleTime += n * mTimeToSample[2 * i + 1];
+    }
+
     return OK;
 }
 
@@ -418,17 +461,32 @@ status_t SampleTable::setSyncSampleParams(off64_t data_offset, size_t data_size)
         ALOGV("Table of sync samples is empty or has only a single entry!");
     }
 
-    mSyncSamples = new uint32_t[mNumSyncSamples];
+    if (data_size < 8 + (uint64_t)mNumSyncSamples * sizeof(uint32_t)) {
+        return ERROR_MALFORMED;
+    }
+
+    return OK;
+}
+
+status_t SampleTable::loadSyncSamples_l() {
+    if (mSyncSamples != NULL || mNumSyncSamples == 0) {
+        return OK;
+    }
+
+    uint32_t *syncSamples = new uint32_t[mNumSyncSamples];
     size_t size = mNumSyncSamples * sizeof(uint32_t);
-    if (mDataSource->readAt(mSyncSampleOffset + 8, mSyncSamples, size)
+    if (mDataSource->readAt(mSyncSampleOffset + 8, syncSamples, size)
             != (ssize_t)size) {
+        delete[] syncSamples;
         return ERROR_IO;
     }
 
     for (size_t i = 0; i < mNumSyncSamples; ++i) {
-        mSyncSamples[i] = ntohl(mSyncSamples[i]) - 1;
+        syncSamples[i] = ntohl(syncSamples[i]) - 1;
     }
 
+    mSyncSamples = syncSamples;
+
     return OK;
 }
 
@@ -445,20 +503,91 @@ status_t SampleTable::getMaxSampleSize(size_t *max_size) {
 
     *max_size = 0;
 
-    for (uint32_t i = 0; i < mNumSampleSizes; ++i) {
-        size_t sample_size;
-        status_t err = getSampleSize_l(i, &sample_size);
+    if (mNumSampleSizes == 0) {
+        return OK;
+    }
 
-        if (err != OK) {
-            return err;
+    if (mDefaultSampleSize > 0) {
+        *max_size = mDefaultSampleSize;
+        return OK;
+    }
+
+    // This runs while the moov is parsed, read the sample sizes in large blocks rather
+    // than with one readAt() per sample.
+    static const size_t kBlockSize = 16384;
+    uint8_t *block = new uint8_t[kBlockSize];
+
+    uint64_t tableSize =
+        ((uint64_t)mNumSampleSizes * mSampleSizeFieldSize + 7) / 8;
+    status_t err = OK;
+
+    for (uint64_t pos = 0; pos < tableSize; pos += kBlockSize) {
+        size_t n = kBlockSize;
+        if (n > tableSize - pos) {
+            n = tableSize - pos;
         }
 
-        if (sample_size > *max_size) {
-            *max_size = sample_size;
+        if (mDataSource->readAt(mSampleSizeOffset + 12 + pos, block, n)
+                < (ssize_t)n) {
+            err = ERROR_IO;
+            break;
+        }
+
+        size_t sample_size;
+        switch (mSampleSizeFieldSize) {
+            case 32:
+                for (size_t i = 0; i + 4 <= n; i += 4) {
+                    sample_size = U32_AT(&block[i]);
+                    if (sample_size > *max_size) {
+                        *max_size = sample_size;
+                    }
+                }
+                break;
+
+            case 16:
+                for (size_t i = 0; i + 2 <= n; i += 2) {
+                    sample_size = U16_AT(&block[i]);
+                    if (sample_size > *max_size) {
+                        *max_size = sample_size;
+                    }
+                }
+                break;
+
+            case 8:
+                for (size_t i = 0; i < n; ++i) {
+                    if (block[i] > *max_size) {
+                        *max_size = block[i];
+                    }
+                }
+                break;
+
+            default:
+            {
+                CHECK_EQ(mSampleSizeFieldSize, 4);
+
+                // The low nibble of the last byte is padding if the count is odd.
+                for (size_t i = 0; i < n; ++i) {
+                    uint8_t x = block[i];
+                    if (pos + i + 1 == tableSize && (mNumSampleSizes & 1)) {
+                        x &= 0xf0;
+                    }
+
+                    if ((size_t)(x >> 4) > *max_size) {
+                        *max_size = x >> 4;
+                    }
+                    if ((size_t)(x & 0x0f) > *max_size) {
+                        *max_size = x & 0x0f;
+                    }
+                }
+                break;
+            }
         }
     }
 
-    return OK;
+    delete[] block;
+    block = NULL;
+
+    return err;
 }
 
 uint32_t abs_difference(uint32_t time1, uint32_t time2) {
@@ -520,8 +649,122 @@ void SampleTable::buildSampleEntriesTable() {
           CompareIncreasingTime);
 }
 
+// Returns the index of the time to sample entry covering sampleIndex, or the last one if
+// sampleIndex is past the samples they cover.
+uint32_t SampleTable::findTimeToSampleEntry(uint32_t sampleIndex) const {
+    uint32_t left = 0;
+    uint32_t right = mTimeToSampleCount;
+    while (right - left > 1) {
+        uint32_t center = left + (right - left) / 2;
+        if (sampleIndex < mTimeToSampleStarts[center].mSampleIndex) {
+            right = center;
+        } else {
+            left = center;
+        }
+    }
+
+    return left;
+}
+
+uint32_t SampleTable::getDecodingTime(uint32_t sampleIndex) const {
+    uint32_t i = findTimeToSampleEntry(sampleIndex);
+
+    return mTimeToSampleStarts[i].mSampleTime
+        + mTimeToSample[2 * i + 1]
+            * (sampleIndex - mTimeToSampleStarts[i].mSampleIndex);
+}
+
+// Same as findSampleAtTime() for tracks without composition time offsets, whose sample
+// times increase with the sample index. The time of a sample is then computed from the time
+// to sample entries, which avoids building a table of all the samples and sorting it.
+status_t SampleTable::findSampleAtDecodingTime(
+        uint32_t req_time, uint32_t *sample_index, uint32_t flags) {
+    uint32_t numSamples = mNumSampleSizes;
+    if (mTimeToSampleCount > 0) {
+        const TimeToSampleStart *last = &mTimeToSampleStarts[mTimeToSampleCount - 1];
+        uint64_t numTimedSamples =
+            (uint64_t)last->mSampleIndex + mTimeToSample[2 * mTimeToSampleCount - 2];
+        if (numTimedSamples < numSamples) {
+            numSamples = numTimedSamples;
+        }
+    } else {
+        numSamples = 0;
+    }
+
+    if (numSamples == 0) {
+        return ERROR_OUT_OF_RANGE;
+    }
+
+    // first sample at or after req_time
+    uint32_t left = 0;
+    uint32_t right = numSamples;
+    while (left < right) {
+        uint32_t center = left + (right - left) / 2;
+
+        if (getDecodingTime(center) < req_time) {
+            left = center + 1;
+        } else {
+            right = center;
+        }
+    }
+
+    if (left == numSamples) {
+        if (flags == kFlagAfter) {
+            return ERROR_OUT_OF_RANGE;
+        }
+
+        --left;
+    }
+
+    uint32_t closestIndex = left;
+
+    switch (flags) {
+        case kFlagBefore:
+        {
+            while (closestIndex > 0
+                    && getDecodingTime(closestIndex) > req_time) {
+                --closestIndex;
+            }
+            break;
+        }
+
+        case kFlagAfter:
+        {
+            break;
+        }
+
+        default:
+        {
+            CHECK(flags == kFlagClosest);
+
+            if (closestIndex > 0) {
+                // Check left neighbour and pick closest.
+                uint32_t absdiff1 =
+                    abs_difference(getDecodingTime(closestIndex), req_time);
+
+                uint32_t absdiff2 =
+                    abs_difference(getDecodingTime(closestIndex - 1), req_time);
+
+                if (absdiff1 > absdiff2) {
+                    closestIndex = closestIndex - 1;
+                }
+            }
+
+            break;
+        }
+    }
+
+    *sample_index = closestIndex;
+
+    return OK;
+}
+
 status_t SampleTable::findSampleAtTime(
         uint32_t req_time, uint32_t *sample_index, uint32_t flags) {
+    if (mCompositionTimeDeltaEntries == NULL) {
+        return findSampleAtDecodingTime(req_time, sample_index, flags);
+    }
+
     buildSampleEntriesTable();
 
     uint32_t left = 0;
@@ -618,6 +861,11 @@ status_t SampleTable::findSyncSampleNear(
         return OK;
     }
 
+    status_t err = loadSyncSamples_l();
+    if (err != OK) {
+        return err;
+    }
+
     uint32_t left = 0;
     uint32_t right = mNumSyncSamples;
     while (left < right) {
@@ -652,7 +900,7 @@ status_t SampleTable::findSyncSampleNear(
 
         // our sample lies between sync samples x and y.
 
-        status_t err = mSampleIterator->seekTo(start_sample_index);
+        err = mSampleIterator->seekTo(start_sample_index);
         if (err != OK) {
             return err;
         }
@@ -734,6 +982,11 @@ status_t SampleTable::findThumbnailSample(uint32_t *sample_index) {
         return OK;
     }
 
+    status_t err = loadSyncSamples_l();
+    if (err != OK) {
+        return err;
+    }
+
     uint32_t bestSampleIndex = 0;
     size_t maxSampleSize = 0;
 
@@ -752,7 +1005,7 @@ status_t SampleTable::findThumbnailSample(uint32_t *sample_index) {
 
         // Now x is a sample index.
         size_t sampleSize;
-        status_t err = getSampleSize_l(x, &sampleSize);
+        err = getSampleSize_l(x, &sampleSize);
         if (err != OK) {
             return err;
         }
@@ -805,6 +1058,10 @@ status_t SampleTable::getMetaDataForSample(
             // Every sample is a sync sample.
             *isSyncSample = true;
         } else {
+            if ((err = loadSyncSamples_l()) != OK) {
+                return err;
+            }
+
             size_t i = (mLastSyncSampleIndex < mNumSyncSamples)
                     && (mSyncSamples[mLastSyncSampleIndex] <= sampleIndex)
                 ? mLastSyncSampleIndex : 0;
@@ -144,6 +144,8 @@ MediaScanResult StagefrightMediaScanner::processFileInternal(
         return HandleMIDI(path, &client);
     }
 
+    // The extractors run in the media server, a file that trips one of
+    // their CHECKs must not take the scanner down with it.
     sp<MediaMetadataRetriever> mRetriever(new MediaMetadataRetriever);
 
     int fd = open(path, O_RDONLY | O_LARGEFILE);
@@ -18,6 +18,7 @@
 #define LOG_TAG "StagefrightMetadataRetriever"
 #include <utils/Log.h>
 
+#include "include/BlockCachedSource.h"
 #include "include/StagefrightMetadataRetriever.h"
 
 #include <media/stagefright/foundation/ADebug.h>
@@ -32,12 +33,14 @@
 namespace android {
 
 StagefrightMetadataRetriever::StagefrightMetadataRetriever()
-    : mParsedMetaData(false),
-      mAlbumArt(NULL) {
+    : mClientConnected(false),
+      mParsedMetaData(false),
+      mAlbumArt(NULL),
+      mAlbumArtOffset(0),
+      mAlbumArtSize(0) {
     ALOGV("StagefrightMetadataRetriever()");
 
     DataSource::RegisterDefaultSniffers();
-    CHECK_EQ(mClient.connect(), (status_t)OK);
 }
 
 StagefrightMetadataRetriever::~StagefrightMetadataRetriever() {
@@ -46,7 +49,30 @@ StagefrightMetadataRetriever::~StagefrightMetadataRetriever() {
     delete mAlbumArt;
     mAlbumArt = NULL;
 
-    mClient.disconnect();
+    clearThumbnailDecoder();
+
+    if (mClientConnected) {
+        mClient.disconnect();
+    }
+}
+
+status_t StagefrightMetadataRetriever::connectClient() {
+    if (!mClientConnected) {
+        status_t err = mClient.connect();
+        if (err != OK) {
+            ALOGE("unable to connect to OMX (%d)", err);
+            return err;
+        }
+        mClientConnected = true;
+    }
+    return OK;
+}
+
+void StagefrightMetadataRetriever::clearThumbnailDecoder() {
+    if (mThumbnailDecoder != NULL) {
+        mThumbnailDecoder->stop();
+        mThumbnailDecoder.clear();
+    }
 }
 
 status_t StagefrightMetadataRetriever::setDataSource(
@@ -57,6 +83,8 @@ status_t StagefrightMetadataRetriever::setDataSource(
     mMetaData.clear();
     delete mAlbumArt;
     mAlbumArt = NULL;
+    mAlbumArtSize = 0;
+    clearThumbnailDecoder();
 
     mSource = DataSource::CreateFromURI(uri, headers);
 
@@ -89,8 +117,10 @@ status_t StagefrightMetadataRetriever::setDataSource(
     mMetaData.clear();
     delete mAlbumArt;
     mAlbumArt = NULL;
+    mAlbumArtSize = 0;
+    clearThumbnailDecoder();
 
-    mSource = new FileSource(fd, offset, length);
+    mSource = BlockCachedSource::Wrap(new FileSource(fd, offset, length));
 
     status_t err;
     if ((err = mSource->initCheck()) != OK) {
@@ -135,14 +165,11 @@ static bool isYUV420PlanarSupported(
     return false;
 }
 
-static VideoFrame *extractVideoFrameWithCodecFlags(
+static sp<MediaSource> createVideoDecoder(
         OMXClient *client,
         const sp<MetaData> &trackMeta,
         const sp<MediaSource> &source,
-        uint32_t flags,
-        int64_t frameTimeUs,
-        int seekMode) {
-
+        uint32_t flags) {
     sp<MetaData> format = source->getFormat();
 
     // XXX:
@@ -172,6 +199,48 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
         return NULL;
     }
 
+    return decoder;
+}
+
+// Longer side of the frames returned for FRAME_OPTION_THUMBNAIL.
+static const int32_t kThumbnailMaxSize = 512;
+
+// Keeps the decoder in *pooledDecoder if asked to and there is somewhere to
+// keep it, stops it otherwise.
+static void releaseDecoder(
+        const sp<MediaSource> &decoder, sp<MediaSource> *pooledDecoder,
+        bool keep) {
+    if (pooledDecoder != NULL) {
+        if (keep) {
+            *pooledDecoder = decoder;
+            return;
+        }
+        pooledDecoder->clear();
+    }
+    decoder->stop();
+}
+
+// If pooledDecoder is not NULL, a decoder in it is used instead of creating
+// one from source, and the decoder is left started in it on success.
+static VideoFrame *extractVideoFrameWithCodecFlags(
+        OMXClient *client,
+        const sp<MetaData> &trackMeta,
+        const sp<MediaSource> &source,
+        uint32_t flags,
+        int64_t frameTimeUs,
+        int seekMode,
+        bool thumbnail,
+        sp<MediaSource> *pooledDecoder) {
+    sp<MediaSource> decoder;
+    if (pooledDecoder != NULL && *pooledDecoder != NULL) {
+        decoder = *pooledDecoder;
+    } else {
+        decoder = createVideoDecoder(client, trackMeta, source, flags);
+        if (decoder == NULL) {
+            return NULL;
+        }
+    }
+
     // Read one output buffer, ignore format change notifications
     // and spurious empty buffers.
 
@@ -180,12 +249,18 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
         seekMode > MediaSource::ReadOptions::SEEK_CLOSEST) {
 
         ALOGE("Unknown seek mode: %d", seekMode);
+        releaseDecoder(decoder, pooledDecoder, false);
         return NULL;
     }
 
     MediaSource::ReadOptions::SeekMode mode =
             static_cast<MediaSource::ReadOptions::SeekMode>(seekMode);
 
+    if (thumbnail && mode == MediaSource::ReadOptions::SEEK_CLOSEST) {
+        // Decoding up to the exact frame isn't worth it for a thumbnail.
+        mode = MediaSource::ReadOptions::SEEK_CLOSEST_SYNC;
+    }
+
     int64_t thumbNailTime;
     if (frameTimeUs < 0) {
         if (!trackMeta->findInt64(kKeyThumbnailTime, &thumbNailTime)
@@ -213,7 +288,7 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
         CHECK(buffer == NULL);
 
         ALOGV("decoding frame failed.");
-        decoder->stop();
+        releaseDecoder(decoder, pooledDecoder, false);
 
         return NULL;
     }
@@ -229,7 +304,7 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
         buffer->release();
         buffer = NULL;
 
-        decoder->stop();
+        releaseDecoder(decoder, pooledDecoder, false);
 
         return NULL;
     }
@@ -266,23 +341,43 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
         rotationAngle = 0;  // By default, no rotation
     }
 
-    VideoFrame *frame = new VideoFrame;
-    frame->mWidth = crop_right - crop_left + 1;
-    frame->mHeight = crop_bottom - crop_top + 1;
-    frame->mDisplayWidth = frame->mWidth;
-    frame->mDisplayHeight = frame->mHeight;
-    frame->mSize = frame->mWidth * frame->mHeight * 2;
-    frame->mData = new uint8_t[frame->mSize];
-    frame->mRotationAngle = rotationAngle;
+    int32_t frameWidth = crop_right - crop_left + 1;
+    int32_t frameHeight = crop_bottom - crop_top + 1;
 
     int32_t displayWidth, displayHeight;
-    if (meta->findInt32(kKeyDisplayWidth, &displayWidth)) {
-        frame->mDisplayWidth = displayWidth;
+    if (!meta->findInt32(kKeyDisplayWidth, &displayWidth)) {
+        displayWidth = frameWidth;
+    }
+    if (!meta->findInt32(kKeyDisplayHeight, &displayHeight)) {
+        displayHeight = frameHeight;
     }
-    if (meta->findInt32(kKeyDisplayHeight, &displayHeight)) {
-        frame->mDisplayHeight = displayHeight;
+
+    int32_t longerSide = frameWidth > frameHeight ? frameWidth : frameHeight;
+    if (thumbnail && longerSide > kThumbnailMaxSize) {
+        // ColorConverter scales while it converts, so only the rows and
+        // columns that are kept get converted.
+        frameWidth = (frameWidth * kThumbnailMaxSize + longerSide / 2) / longerSide;
+        frameHeight = (frameHeight * kThumbnailMaxSize + longerSide / 2) / longerSide;
+        displayWidth = (displayWidth * kThumbnailMaxSize + longerSide / 2) / longerSide;
+        displayHeight = (displayHeight * kThumbnailMaxSize + longerSide / 2) / longerSide;
+
+        if (frameWidth < 1) {
+            frameWidth = 1;
+        }
+        if (frameHeight < 1) {
+            frameHeight = 1;
+        }
     }
 
+    VideoFrame *frame = new VideoFrame;
+    frame->mWidth = frameWidth;
+    frame->mHeight = frameHeight;
+    frame->mDisplayWidth = displayWidth;
+    frame->mDisplayHeight = displayHeight;
+    frame->mSize = frame->mWidth * frame->mHeight * 2;
+    frame->mData = new uint8_t[frame->mSize];
+    frame->mRotationAngle = rotationAngle;
+
     int32_t srcFormat;
     CHECK(meta->findInt32(kKeyColorFormat, &srcFormat));
 
@@ -309,7 +404,7 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
     buffer->release();
     buffer = NULL;
 
-    decoder->stop();
+    releaseDecoder(decoder, pooledDecoder, err == OK);
 
     if (err != OK) {
         ALOGE("Colorconverter failed to convert frame.");
@@ -326,6 +421,13 @@ VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
 
     ALOGV("getFrameAtTime: %lld us option: %d", timeUs, option);
 
+    bool thumbnail = (option & FRAME_OPTION_THUMBNAIL) != 0;
+    option &= ~FRAME_OPTION_THUMBNAIL;
+
+    if (!thumbnail) {
+        clearThumbnailDecoder();
+    }
+
     if (mExtractor.get() == NULL) {
         ALOGV("no extractor.");
         return NULL;
@@ -362,9 +464,23 @@ VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
         return NULL;
     }
 
+    if (connectClient() != OK) {
+        return NULL;
+    }
+
     sp<MetaData> trackMeta = mExtractor->getTrackMetaData(
             i, MediaExtractor::kIncludeExtensiveMetaData);
 
+    if (mThumbnailDecoder != NULL) {
+        VideoFrame *frame = extractVideoFrameWithCodecFlags(
+                &mClient, trackMeta, NULL, 0, timeUs, option,
+                true /* thumbnail */, &mThumbnailDecoder);
+
+        if (frame != NULL) {
+            return frame;
+        }
+    }
+
     sp<MediaSource> source = mExtractor->getTrack(i);
 
     if (source.get() == NULL) {
@@ -383,17 +499,19 @@ VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
         memcpy(mAlbumArt->mData, data, dataSize);
     }
 
+    sp<MediaSource> *pooledDecoder = thumbnail ? &mThumbnailDecoder : NULL;
+
     VideoFrame *frame =
         extractVideoFrameWithCodecFlags(
                 &mClient, trackMeta, source, OMXCodec::kSoftwareCodecsOnly,
-                timeUs, option);
+                timeUs, option, thumbnail, pooledDecoder);
 
     if (frame == NULL) {
         ALOGV("Software decoder failed to extract thumbnail, "
              "trying hardware decoder.");
 
         frame = extractVideoFrameWithCodecFlags(&mClient, trackMeta, source, 0,
-                        timeUs, option);
+                        timeUs, option, thumbnail, pooledDecoder);
     }
 
     return frame;
@@ -416,6 +534,20 @@ MediaAlbumArt *StagefrightMetadataRetriever::extractAlbumArt() {
         return new MediaAlbumArt(*mAlbumArt);
     }
 
+    if (mAlbumArtSize > 0) {
+        // Read straight into the copy that is handed out.
+        MediaAlbumArt *art = new MediaAlbumArt;
+        art->mData = new uint8_t[mAlbumArtSize];
+        art->mSize = mAlbumArtSize;
+
+        if (mSource->readAt(mAlbumArtOffset, art->mData, mAlbumArtSize)
+                == (ssize_t)mAlbumArtSize) {
+            return art;
+        }
+
+        delete art;
+    }
+
     return NULL;
 }
 
@@ -488,6 +620,15 @@ void StagefrightMetadataRetriever::parseMetaData() {
         memcpy(mAlbumArt->mData, data, dataSize);
     }
 
+    int64_t albumArtOffset;
+    int32_t albumArtSize;
+    if (meta->findInt64(kKeyAlbumArtOffset, &albumArtOffset)
+            && meta->findInt32(kKeyAlbumArtSize, &albumArtSize)
+            && albumArtSize > 0) {
+        mAlbumArtOffset = albumArtOffset;
+        mAlbumArtSize = albumArtSize;
+    }
+
     size_t numTracks = mExtractor->countTracks();
 
     char tmp[32];
@@ -164,6 +164,11 @@ status_t convertMetaDataToMessage(
         msg->setInt32("max-input-size", maxInputSize);
     }
 
+    int32_t maxOutputSize;
+    if (meta->findInt32(kKeyMaxOutputSize, &maxOutputSize)) {
+        msg->setInt32("max-output-size", maxOutputSize);
+    }
+
     uint32_t type;
     const void *data;
     size_t size;
@@ -464,6 +469,11 @@ void convertMessageToMetaData(const sp<AMessage> &msg, sp<MetaData> &meta) {
         meta->setInt32(kKeyMaxInputSize, maxInputSize);
     }
 
+    int32_t maxOutputSize;
+    if (msg->findInt32("max-output-size", &maxOutputSize)) {
+        meta->setInt32(kKeyMaxOutputSize, maxOutputSize);
+    }
+
     // reassemble the csd data into its original form
     sp<ABuffer> csd0;
     if (msg->findBuffer("csd-0", &csd0)) {
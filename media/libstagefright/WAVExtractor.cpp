@@ -441,9 +441,10 @@ status_t WAVSource::read(
 
     if (mWaveFormat == WAVE_FORMAT_MSGSM) {
         // Microsoft packs 2 frames into 65 bytes, rather than using separate 33-byte frames,
-        // so read multiples of 65, and use smaller buffers to account for ~10:1 expansion ratio
-        if (maxBytesToRead > 1024) {
-            maxBytesToRead = 1024;
+        // so read multiples of 65, and use smaller buffers to account for ~10:1 expansion ratio.
+        // 50 pairs decode to 16000 samples, which still fit the decoder's output buffer.
+        if (maxBytesToRead > 50 * 65) {
+            maxBytesToRead = 50 * 65;
         }
         maxBytesToRead = (maxBytesToRead / 65) * 65;
     }
@@ -36,6 +36,7 @@ ChromiumHTTPDataSource::ChromiumHTTPDataSource(uint32_t flags)
       mCurrentOffset(0),
       mIOResult(OK),
       mContentSize(-1),
+      mConnectDelayUs(0),
       mDecryptHandle(NULL),
       mDrmManagerClient(NULL) {
     mDelegate->setOwner(this);
@@ -99,13 +100,23 @@ status_t ChromiumHTTPDataSource::connect_l(
     mContentSize = -1;
     mCurrentOffset = offset;
 
+    int64_t startTimeUs = ALooper::GetNowUs();
+
     mDelegate->initiateConnection(mURI.c_str(), &mHeaders, offset);
 
     while (mState == CONNECTING || mState == DISCONNECTING) {
         mCondition.wait(mLock);
     }
 
-    return mState == CONNECTED ? OK : mIOResult;
+    if (mState != CONNECTED) {
+        return mIOResult;
+    }
+
+    int64_t delayUs = ALooper::GetNowUs() - startTimeUs;
+    mConnectDelayUs = (mConnectDelayUs == 0)
+        ? delayUs : (3 * mConnectDelayUs + delayUs) / 4;
+
+    return OK;
 }
 
 void ChromiumHTTPDataSource::onConnectionEstablished(
@@ -179,7 +190,11 @@ ssize_t ChromiumHTTPDataSource::readAt(off64_t offset, void *data, size_t size)
     }
 #endif
 
-    if (offset != mCurrentOffset) {
+    if (offset > mCurrentOffset && skipTo_l(offset) == OK) {
+        CHECK_EQ(offset, mCurrentOffset);
+    }
+
+    if (mState != CONNECTED || offset != mCurrentOffset) {
         AString tmp = mURI;
         KeyedVector<String8, String8> tmpHeaders = mHeaders;
 
@@ -192,6 +207,10 @@ ssize_t ChromiumHTTPDataSource::readAt(off64_t offset, void *data, size_t size)
         }
     }
 
+    return read_l(data, size);
+}
+
+ssize_t ChromiumHTTPDataSource::read_l(void *data, size_t size) {
     mState = READING;
 
     int64_t startTimeUs = ALooper::GetNowUs();
@@ -220,6 +239,54 @@ ssize_t ChromiumHTTPDataSource::readAt(off64_t offset, void *data, size_t size)
     return ERROR_IO;
 }
 
+// A new range request costs at least a round trip and, without a reusable
+// keep-alive connection, TCP and TLS setup. If the target is close enough
+// that the data can be received in less time than that, read and drop it
+// on the current connection instead.
+status_t ChromiumHTTPDataSource::skipTo_l(off64_t offset) {
+    off64_t maxSkipBytes = kMinSkipBytes;
+
+    int32_t bandwidthBps;
+    if (mConnectDelayUs > 0 && estimateBandwidth(&bandwidthBps)) {
+        maxSkipBytes = (off64_t)bandwidthBps / 8 * mConnectDelayUs / 1000000ll;
+
+        if (maxSkipBytes < kMinSkipBytes) {
+            maxSkipBytes = kMinSkipBytes;
+        } else if (maxSkipBytes > kMaxSkipBytes) {
+            maxSkipBytes = kMaxSkipBytes;
+        }
+    }
+
+    if (offset - mCurrentOffset > maxSkipBytes) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    ALOGV("skipping %lld bytes instead of reconnecting",
+          offset - mCurrentOffset);
+
+    static const size_t kScratchSize = 16 * 1024;
+    uint8_t *scratch = new uint8_t[kScratchSize];
+
+    status_t err = OK;
+    while (mCurrentOffset < offset) {
+        size_t size = offset - mCurrentOffset;
+        if (size > kScratchSize) {
+            size = kScratchSize;
+        }
+
+        ssize_t n = read_l(scratch, size);
+        if (n <= 0) {
+            err = (n < 0) ? n : ERROR_END_OF_STREAM;
+            break;
+        }
+    }
+
+    delete[] scratch;
+    scratch = NULL;
+
+    return err;
+}
+
 void ChromiumHTTPDataSource::onReadCompleted(ssize_t size) {
     Mutex::Autolock autoLock(mLock);
 
@@ -31,6 +31,9 @@
 #define DRC_DEFAULT_MOBILE_DRC_CUT   127 /* maximum compression of dynamic range for mobile conf */
 #define DRC_DEFAULT_MOBILE_DRC_BOOST 127 /* maximum compression of dynamic range for mobile conf */
 #define MAX_CHANNEL_COUNT            6  /* maximum number of audio channels that can be decoded */
+#define OUTPUT_BUFFER_SIZE           (4096 * MAX_CHANNEL_COUNT) /* default output buffer size */
+#define MAX_FRAME_SAMPLES            2048 /* samples per channel in an HE-AAC frame */
+#define MAX_BATCH_GAP_US             5000
 // names of properties that can be used to override the default DRC settings
 #define PROP_DRC_OVERRIDE_REF_LEVEL  "aac_drc_reference_level"
 #define PROP_DRC_OVERRIDE_CUT        "aac_drc_cut"
@@ -58,6 +61,7 @@ SoftAAC2::SoftAAC2(
       mIsADTS(false),
       mInputBufferCount(0),
       mSignalledError(false),
+      mNumBatchedFrames(0),
       mAnchorTimeUs(0),
       mNumSamplesOutput(0),
       mOutputPortSettingsChange(NONE) {
@@ -95,7 +99,7 @@ void SoftAAC2::initPorts() {
     def.eDir = OMX_DirOutput;
     def.nBufferCountMin = kNumOutputBuffers;
     def.nBufferCountActual = def.nBufferCountMin;
-    def.nBufferSize = 4096 * MAX_CHANNEL_COUNT;
+    def.nBufferSize = OUTPUT_BUFFER_SIZE;
     def.bEnabled = OMX_TRUE;
     def.bPopulated = OMX_FALSE;
     def.eDomain = OMX_PortDomainAudio;
@@ -357,6 +361,23 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
         BufferInfo *outInfo = *outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
+        if (mNumBatchedFrames > 0) {
+            // Return the frames batched so far before the end of stream or
+            // a timestamp discontinuity.
+            int64_t nextTimeUs = outHeader->nTimeStamp
+                + (outHeader->nFilledLen
+                        / (mStreamInfo->numChannels * sizeof(int16_t)) * 1000000ll)
+                    / mStreamInfo->sampleRate;
+
+            if ((inHeader->nFlags & OMX_BUFFERFLAG_EOS)
+                    || (inHeader->nOffset == 0
+                        && (inHeader->nTimeStamp > nextTimeUs + MAX_BATCH_GAP_US
+                            || inHeader->nTimeStamp < nextTimeUs - MAX_BATCH_GAP_US))) {
+                sendOutputBatch();
+                continue;
+            }
+        }
+
         if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
             inQueue.erase(inQueue.begin());
             inInfo->mOwnedByUs = false;
@@ -465,9 +486,15 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
             inBufferLength[0] = inHeader->nFilledLen;
         }
 
-        // Fill and decode
+        // Fill and decode, the frame goes after those already in the output
+        // buffer
+        size_t outOffset = outHeader->nOffset;
+        if (mNumBatchedFrames > 0) {
+            outOffset += outHeader->nFilledLen;
+        }
+
         INT_PCM *outBuffer = reinterpret_cast<INT_PCM *>(
-                outHeader->pBuffer + outHeader->nOffset);
+                outHeader->pBuffer + outOffset);
 
         bytesValid[0] = inBufferLength[0];
 
@@ -484,7 +511,7 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
 
             decoderErr = aacDecoder_DecodeFrame(mAACDecoder,
                                                 outBuffer,
-                                                outHeader->nAllocLen,
+                                                outHeader->nAllocLen - outOffset,
                                                 0 /* flags */);
 
             if (decoderErr == AAC_DEC_NOT_ENOUGH_BITS) {
@@ -503,7 +530,7 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
             ALOGW("AAC decoder returned error %d, substituting silence",
                   decoderErr);
 
-            memset(outHeader->pBuffer + outHeader->nOffset, 0, numOutBytes);
+            memset(outHeader->pBuffer + outOffset, 0, numOutBytes);
 
             // Discard input buffer.
             inHeader->nFilledLen = 0;
@@ -543,6 +570,11 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
                       prevSampleRate, mStreamInfo->sampleRate,
                       prevNumChannels, mStreamInfo->numChannels);
 
+                // the frames batched so far are in the old format
+                if (mNumBatchedFrames > 0) {
+                    sendOutputBatch();
+                }
+
                 notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
                 mOutputPortSettingsChange = AWAITING_DISABLED;
                 return;
@@ -558,20 +590,30 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
             // We'll only output data if we successfully decoded it or
             // we've previously decoded valid data, in the latter case
             // (decode failed) we'll output a silent frame.
-            outHeader->nFilledLen = numOutBytes;
-            outHeader->nFlags = 0;
+            if (mNumBatchedFrames > 0) {
+                outHeader->nFilledLen += numOutBytes;
+            } else {
+                outHeader->nFilledLen = numOutBytes;
+                outHeader->nFlags = 0;
 
-            outHeader->nTimeStamp =
-                mAnchorTimeUs
-                    + (mNumSamplesOutput * 1000000ll) / mStreamInfo->sampleRate;
+                outHeader->nTimeStamp =
+                    mAnchorTimeUs
+                        + (mNumSamplesOutput * 1000000ll) / mStreamInfo->sampleRate;
+            }
+            ++mNumBatchedFrames;
 
             mNumSamplesOutput += mStreamInfo->frameSize;
 
-            outInfo->mOwnedByUs = false;
-            outQueue.erase(outQueue.begin());
-            outInfo = NULL;
-            notifyFillBufferDone(outHeader);
-            outHeader = NULL;
+            // Output buffers are only larger than the default if the client
+            // asked for it, in which case they take as many frames as fit.
+            size_t maxFrameBytes =
+                MAX_FRAME_SAMPLES * sizeof(int16_t) * mStreamInfo->numChannels;
+
+            if (outHeader->nAllocLen <= OUTPUT_BUFFER_SIZE
+                    || outHeader->nAllocLen - outHeader->nOffset
+                        - outHeader->nFilledLen < maxFrameBytes) {
+                sendOutputBatch();
+            }
         }
 
         if (decoderErr == AAC_DEC_OK) {
@@ -580,7 +622,23 @@ void SoftAAC2::onQueueFilled(OMX_U32 portIndex) {
     }
 }
 
+void SoftAAC2::sendOutputBatch() {
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+
+    BufferInfo *outInfo = *outQueue.begin();
+    outInfo->mOwnedByUs = false;
+    outQueue.erase(outQueue.begin());
+    notifyFillBufferDone(outInfo->mHeader);
+
+    mNumBatchedFrames = 0;
+}
+
 void SoftAAC2::onPortFlushCompleted(OMX_U32 portIndex) {
+    if (portIndex == 1) {
+        // the partly filled output buffer went back with the others
+        mNumBatchedFrames = 0;
+    }
+
     if (portIndex == 0) {
         // Make sure that the next buffer output does not still
         // depend on fragments from the last one decoded.
@@ -610,6 +668,7 @@ void SoftAAC2::onReset() {
     mStreamInfo->sampleRate = 0;
 
     mSignalledError = false;
+    mNumBatchedFrames = 0;
     mOutputPortSettingsChange = NONE;
 }
 
@@ -618,6 +677,10 @@ void SoftAAC2::onPortEnableCompleted(OMX_U32 portIndex, bool enabled) {
         return;
     }
 
+    if (!enabled) {
+        mNumBatchedFrames = 0;
+    }
+
     switch (mOutputPortSettingsChange) {
         case NONE:
             break;
@@ -58,6 +58,10 @@ private:
     int64_t mAnchorTimeUs;
     int64_t mNumSamplesOutput;
 
+    // frames decoded into the output buffer at the head of the queue; the
+    // buffer is returned once it has no room for another frame
+    size_t mNumBatchedFrames;
+
     enum {
         NONE,
         AWAITING_DISABLED,
@@ -69,6 +73,7 @@ private:
     bool isConfigured() const;
     void maybeConfigureDownmix() const;
     void drainDecoder();
+    void sendOutputBatch();
 
     DISALLOW_EVIL_CONSTRUCTORS(SoftAAC2);
 };
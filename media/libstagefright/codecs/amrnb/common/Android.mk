@@ -50,7 +50,6 @@ LOCAL_SRC_FILES := \
  	src/q_plsf_5_tbl.cpp \
  	src/qua_gain_tbl.cpp \
  	src/reorder.cpp \
- 	src/residu.cpp \
  	src/round.cpp \
  	src/set_zero.cpp \
  	src/shr.cpp \
@@ -63,6 +62,13 @@ LOCAL_SRC_FILES := \
  	src/weight_a.cpp \
  	src/window_tab.cpp
 
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_ARM_NEON := true
+    LOCAL_SRC_FILES += src/residu_neon.cpp
+else
+    LOCAL_SRC_FILES += src/residu.cpp
+endif
+
 LOCAL_C_INCLUDES := \
         $(LOCAL_PATH)/include
 
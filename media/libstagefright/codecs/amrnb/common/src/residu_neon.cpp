@@ -0,0 +1,68 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "residu.h"
+#include "typedef.h"
+#include "cnst.h"
+
+#include <arm_neon.h>
+
+/* NEON version of Residu() in residu.cpp, built instead of it. 8 residual
+   samples are computed at a time, one lane each, and like the C version
+   input_len must be a multiple of 4. The sums wrap in 32 bits like the C
+   sums, so the output is identical. */
+
+void Residu(
+    Word16 coef_ptr[],      /* (i)     : prediction coefficients*/
+    Word16 input_ptr[],     /* (i)     : speech signal          */
+    Word16 residual_ptr[],  /* (o)     : residual signal        */
+    Word16 input_len        /* (i)     : size of filtering      */
+)
+{
+    register Word16 i, j;
+
+    for (i = 0; i + 8 <= input_len; i += 8)
+    {
+        int32x4_t s_lo = vdupq_n_s32(0x0000800L);
+        int32x4_t s_hi = vdupq_n_s32(0x0000800L);
+
+        for (j = 0; j <= M; j++)
+        {
+            int16x8_t x = vld1q_s16(&input_ptr[i - j]);
+
+            s_lo = vmlal_n_s16(s_lo, vget_low_s16(x), coef_ptr[j]);
+            s_hi = vmlal_n_s16(s_hi, vget_high_s16(x), coef_ptr[j]);
+        }
+
+        vst1_s16(&residual_ptr[i], vshrn_n_s32(s_lo, 12));
+        vst1_s16(&residual_ptr[i + 4], vshrn_n_s32(s_hi, 12));
+    }
+
+    if (i < input_len)
+    {
+        int32x4_t s = vdupq_n_s32(0x0000800L);
+
+        for (j = 0; j <= M; j++)
+        {
+            s = vmlal_n_s16(s, vld1_s16(&input_ptr[i - j]), coef_ptr[j]);
+        }
+
+        vst1_s16(&residual_ptr[i], vshrn_n_s32(s, 12));
+    }
+
+    return;
+}
@@ -3,7 +3,6 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
 	src/amrencode.cpp \
- 	src/autocorr.cpp \
  	src/c1035pf.cpp \
  	src/c2_11pf.cpp \
  	src/c2_9pf.cpp \
@@ -15,9 +14,7 @@ LOCAL_SRC_FILES := \
  	src/cbsearch.cpp \
  	src/cl_ltp.cpp \
  	src/cod_amr.cpp \
- 	src/convolve.cpp \
  	src/cor_h.cpp \
- 	src/cor_h_x.cpp \
  	src/cor_h_x2.cpp \
  	src/corrwght_tab.cpp \
  	src/dtx_enc.cpp \
@@ -60,6 +57,19 @@ LOCAL_SRC_FILES := \
  	src/spstproc.cpp \
  	src/ton_stab.cpp
 
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_ARM_NEON := true
+    LOCAL_SRC_FILES += \
+        src/autocorr_neon.cpp \
+        src/convolve_neon.cpp \
+        src/cor_h_x_neon.cpp
+else
+    LOCAL_SRC_FILES += \
+        src/autocorr.cpp \
+        src/convolve.cpp \
+        src/cor_h_x.cpp
+endif
+
 LOCAL_C_INCLUDES := \
         frameworks/av/media/libstagefright/include \
         $(LOCAL_PATH)/src \
@@ -0,0 +1,146 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "autocorr.h"
+#include "typedef.h"
+#include "basic_op.h"
+#include "oper_32b.h"
+#include "cnst.h"
+
+#include <arm_neon.h>
+
+/* NEON version of Autocorr() in autocorr.cpp, built instead of it. The
+   windowing is 8 samples at a time; the windows are all positive, so
+   vqrdmulh rounds exactly like (x * wind + 0x4000) >> 15. The energy is
+   summed in 64 bits to find the same overflow as the C version, and the
+   correlations wrap in 32 bits like the C sums do, so the output is
+   identical. */
+
+static inline Word32 sum_lanes(int32x4_t v)
+{
+    int32x2_t s = vpadd_s32(vget_low_s32(v), vget_high_s32(v));
+
+    return vget_lane_s32(vpadd_s32(s, s), 0);
+}
+
+Word16 Autocorr(
+    Word16 x[],            /* (i)    : Input signal (L_WINDOW)            */
+    Word16 m,              /* (i)    : LPC order                          */
+    Word16 r_h[],          /* (o)    : Autocorrelations  (msb)            */
+    Word16 r_l[],          /* (o)    : Autocorrelations  (lsb)            */
+    const Word16 wind[],   /* (i)    : window for LPC analysis (L_WINDOW) */
+    Flag  *pOverflow       /* (o)    : indicates overflow                 */
+)
+{
+    register Word16 i;
+    register Word16 j;
+    register Word16 norm;
+    Word16 y[L_WINDOW];
+    Word32 sum;
+    Word16 overfl_shft;
+    Word16 temp;
+    Word16 *p_y;
+    int64x2_t energy = vdupq_n_s64(0);
+    int64_t total;
+
+    OSCL_UNUSED_ARG(pOverflow);
+
+    /*
+     *  Windowing of the signal and its energy
+     */
+    for (i = 0; i < L_WINDOW; i += 8)
+    {
+        int16x8_t v = vqrdmulhq_s16(vld1q_s16(&x[i]), vld1q_s16(&wind[i]));
+
+        vst1q_s16(&y[i], v);
+        energy = vpadalq_s32(energy, vmull_s16(vget_low_s16(v), vget_low_s16(v)));
+        energy = vpadalq_s32(energy, vmull_s16(vget_high_s16(v), vget_high_s16(v)));
+    }
+
+    total = (vgetq_lane_s64(energy, 0) + vgetq_lane_s64(energy, 1)) << 1;
+
+    /*
+     *  Compute r[0] and test for overflow
+     */
+    overfl_shft = 0;
+    sum = (Word32) total;
+    j = (total > MAX_32);
+
+    /*
+     * scale down by 1/4 only when needed
+     */
+    while (j == 1)
+    {
+        overfl_shft += 4;
+        p_y   = &y[0];
+        sum = 0L;
+
+        for (i = (L_WINDOW >> 1); i != 0 ; i--)
+        {
+            temp = *p_y >> 2;
+            *(p_y++) = temp;
+            sum += ((Word32)temp * temp) << 1;
+            temp = *p_y >> 2;
+            *(p_y++) = temp;
+            sum += ((Word32)temp * temp) << 1;
+        }
+        if (sum > 0)
+        {
+            j = 0;
+        }
+    }
+
+    sum += 1L;              /* Avoid the case of all zeros */
+
+    /* Normalization of r[0] */
+    norm = norm_l(sum);
+    sum <<= norm;
+
+    /* Put in DPF format (see oper_32b) */
+    r_h[0] = (Word16)(sum >> 16);
+    r_l[0] = (Word16)((sum >> 1) - ((Word32)(r_h[0]) << 15));
+
+    /* r[1] to r[m] */
+    for (i = 1; i <= m; i++)
+    {
+        int32x4_t acc = vdupq_n_s32(0);
+        Word16 n = L_WINDOW - i;
+
+        for (j = 0; j + 8 <= n; j += 8)
+        {
+            int16x8_t a = vld1q_s16(&y[j]);
+            int16x8_t b = vld1q_s16(&y[j + i]);
+
+            acc = vmlal_s16(acc, vget_low_s16(a), vget_low_s16(b));
+            acc = vmlal_s16(acc, vget_high_s16(a), vget_high_s16(b));
+        }
+
+        sum = sum_lanes(acc);
+        for (; j < n; j++)
+        {
+            sum += (Word32) y[j] * y[j + i];
+        }
+
+        sum  <<= (norm + 1);
+        r_h[i] = (Word16)(sum >> 16);
+        r_l[i] = (Word16)((sum >> 1) - ((Word32) r_h[i] << 15));
+    }
+
+    norm -= overfl_shft;
+
+    return (norm);
+}
@@ -0,0 +1,83 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "typedef.h"
+#include "convolve.h"
+#include "basic_op.h"
+#include "cnst.h"
+
+#include <arm_neon.h>
+
+/* NEON version of Convolve() in convolve.cpp, built instead of it, for
+   L <= L_SUBFR. Each x[i] is multiplied into all the outputs it reaches,
+   4 outputs per vector, with h[] padded with zeros on both sides so that
+   the vectors that straddle n = i read zeros. The sums wrap in 32 bits
+   like the C version, so the output is identical. */
+
+void Convolve(
+    Word16 x[],        /* (i)     : input vector                           */
+    Word16 h[],        /* (i)     : impulse response                       */
+    Word16 y[],        /* (o)     : output vector                          */
+    Word16 L           /* (i)     : vector size                            */
+)
+{
+    Word16 h_pad[4 + L_SUBFR + 4];
+    Word16 *hp = &h_pad[4];
+    int32x4_t acc[L_SUBFR / 4];
+    register Word16 i, n;
+    Word16 blocks = (L + 3) >> 2;
+
+    for (i = 0; i < (Word16)(sizeof(h_pad) / sizeof(h_pad[0])); i++)
+    {
+        h_pad[i] = 0;
+    }
+    for (i = 0; i < L; i++)
+    {
+        hp[i] = h[i];
+    }
+
+    for (n = 0; n < blocks; n++)
+    {
+        acc[n] = vdupq_n_s32(0);
+    }
+
+    /* y[n] += x[i] * h[n - i] for all n >= i */
+    for (i = 0; i < L; i++)
+    {
+        for (n = i >> 2; n < blocks; n++)
+        {
+            acc[n] = vmlal_n_s16(acc[n], vld1_s16(&hp[(n << 2) - i]), x[i]);
+        }
+    }
+
+    for (n = 0; n < (L >> 2); n++)
+    {
+        vst1_s16(&y[n << 2], vshrn_n_s32(acc[n], 12));
+    }
+    if (L & 3)
+    {
+        Word32 tail[4];
+
+        vst1q_s32(tail, acc[L >> 2]);
+        for (n = 0; n < (L & 3); n++)
+        {
+            y[(L & ~3) + n] = (Word16)(tail[n] >> 12);
+        }
+    }
+
+    return;
+}
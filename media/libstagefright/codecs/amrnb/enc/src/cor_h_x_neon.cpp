@@ -0,0 +1,107 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "typedef.h"
+#include "cnst.h"
+#include "cor_h_x.h"
+#include "basic_op.h"
+
+#include <arm_neon.h>
+
+/* NEON version of cor_h_x() in cor_h_x.cpp, built instead of it. The
+   correlations are dot products of 8 lanes; they wrap in 32 bits like
+   the C sums, so the output is identical. The per-track maximum and the
+   scaling are the C code. */
+
+void cor_h_x(
+    Word16 h[],       /* (i): impulse response of weighted synthesis filter */
+    Word16 x[],       /* (i): target                                        */
+    Word16 dn[],      /* (o): correlation between target and h[]            */
+    Word16 sf,        /* (i): scaling factor: 2 for 12.2, 1 for others      */
+    Flag   *pOverflow /* (o): pointer to overflow flag                      */
+)
+{
+    register Word16 i;
+    register Word16 j;
+    register Word16 k;
+    Word32 s;
+    Word32 y32[L_CODE];
+    Word32 max;
+    Word32 tot;
+    Word16 *p_ptr;
+    Word32 *p_y32;
+
+    /* y32[i] = 2 * sum(x[i + j] * h[j]) */
+    for (i = 0; i < L_CODE; i++)
+    {
+        int32x4_t acc = vdupq_n_s32(0);
+        int32x2_t acc2;
+        Word16 n = L_CODE - i;
+
+        for (j = 0; j + 8 <= n; j += 8)
+        {
+            int16x8_t a = vld1q_s16(&x[i + j]);
+            int16x8_t b = vld1q_s16(&h[j]);
+
+            acc = vmlal_s16(acc, vget_low_s16(a), vget_low_s16(b));
+            acc = vmlal_s16(acc, vget_high_s16(a), vget_high_s16(b));
+        }
+
+        acc2 = vpadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+        s = vget_lane_s32(vpadd_s32(acc2, acc2), 0);
+        for (; j < n; j++)
+        {
+            s += (Word32) x[i + j] * h[j];
+        }
+
+        y32[i] = s << 1;
+    }
+
+    tot = 5;
+    for (k = 0; k < NB_TRACK; k++)              /* NB_TRACK = 5 */
+    {
+        max = 0;
+        for (i = k; i < L_CODE; i += STEP)      /* L_CODE = 40; STEP = 5 */
+        {
+            s = y32[i];
+            if (s < 0)
+            {
+                s = -s;
+            }
+            if (s > max)
+            {
+                max = s;
+            }
+        }
+        tot += (max >> 1);
+    }
+
+    j = norm_l(tot) - sf;
+
+    p_ptr = dn;
+    p_y32 = y32;
+
+    for (i = L_CODE >> 1; i != 0; i--)
+    {
+        s = L_shl(*(p_y32++), j, pOverflow);
+        *(p_ptr++) = (s + 0x00008000) >> 16;
+        s = L_shl(*(p_y32++), j, pOverflow);
+        *(p_ptr++) = (s + 0x00008000) >> 16;
+    }
+
+    return;
+}
@@ -5,7 +5,6 @@ include frameworks/av/media/libstagefright/codecs/common/Config.mk
 
 
 LOCAL_SRC_FILES := \
-	src/autocorr.c \
 	src/az_isp.c \
 	src/bits.c \
 	src/c2t64fx.c \
@@ -54,6 +53,13 @@ LOCAL_SRC_FILES := \
 	src/mem_align.c
 
 
+ifeq ($(VOTT), v7)
+LOCAL_SRC_FILES += src/autocorr_neon.c
+LOCAL_ARM_NEON := true
+else
+LOCAL_SRC_FILES += src/autocorr.c
+endif
+
 ifeq ($(VOTT), v5)
 LOCAL_SRC_FILES += \
 	src/asm/ARMV5E/convolve_opt.s \
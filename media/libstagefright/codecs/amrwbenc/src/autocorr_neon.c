@@ -0,0 +1,121 @@
+/*
+ ** Copyright 2014, The Android Open Source Project
+ **
+ ** Licensed under the Apache License, Version 2.0 (the "License");
+ ** you may not use this file except in compliance with the License.
+ ** You may obtain a copy of the License at
+ **
+ **     http://www.apache.org/licenses/LICENSE-2.0
+ **
+ ** Unless required by applicable law or agreed to in writing, software
+ ** distributed under the License is distributed on an "AS IS" BASIS,
+ ** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ ** See the License for the specific language governing permissions and
+ ** limitations under the License.
+ */
+
+
+/***********************************************************************
+*       File: autocorr_neon.c                                          *
+*                                                                      *
+*       Description: NEON version of autocorr.c, built instead of it   *
+*                    for v7. The window is positive, so vqrdmulh      *
+*                    rounds like vo_mult_r(); all the sums wrap in    *
+*                    32 bits like the C sums, so the output is        *
+*                    identical.                                       *
+*                                                                      *
+************************************************************************/
+
+#include "typedef.h"
+#include "basic_op.h"
+#include "oper_32b.h"
+#include "acelp.h"
+#include "ham_wind.tab"
+
+#include <arm_neon.h>
+
+static __inline Word32 sum_lanes(int32x4_t v)
+{
+	int32x2_t s = vpadd_s32(vget_low_s32(v), vget_high_s32(v));
+	return vget_lane_s32(vpadd_s32(s, s), 0);
+}
+
+void Autocorr(
+		Word16 x[],                           /* (i)    : Input signal                      */
+		Word16 m,                             /* (i)    : LPC order                         */
+		Word16 r_h[],                         /* (o) Q15: Autocorrelations  (msb)           */
+		Word16 r_l[]                          /* (o)    : Autocorrelations  (lsb)           */
+	     )
+{
+	Word32 i, j, norm, shift;
+	Word16 y[L_WINDOW];
+	Word32 L_sum;
+	int32x4_t acc;
+
+	/* Windowing of signal, and its energy */
+	acc = vdupq_n_s32(0);
+	for (i = 0; i < L_WINDOW; i += 8)
+	{
+		int16x8_t v = vqrdmulhq_s16(vld1q_s16(&x[i]), vld1q_s16(&vo_window[i]));
+		vst1q_s16(&y[i], v);
+		/* (2 * y * y) >> 8 */
+		acc = vsraq_n_s32(acc, vmull_s16(vget_low_s16(v), vget_low_s16(v)), 7);
+		acc = vsraq_n_s32(acc, vmull_s16(vget_high_s16(v), vget_high_s16(v)), 7);
+	}
+	L_sum = vo_L_deposit_h(16) + sum_lanes(acc);   /* sqrt(256), avoid overflow after rounding */
+
+	/* scale signal to avoid overflow in autocorrelation */
+	norm = norm_l(L_sum);
+	shift = 4 - (norm >> 1);
+	if(shift > 0)
+	{
+		int16x8_t sh = vdupq_n_s16(-shift);
+		for (i = 0; i < L_WINDOW; i += 8)
+		{
+			vst1q_s16(&y[i], vrshlq_s16(vld1q_s16(&y[i]), sh));
+		}
+	}
+
+	/* Compute and normalize r[0] */
+	acc = vdupq_n_s32(0);
+	for (i = 0; i < L_WINDOW; i += 8)
+	{
+		int16x8_t v = vld1q_s16(&y[i]);
+		acc = vmlal_s16(acc, vget_low_s16(v), vget_low_s16(v));
+		acc = vmlal_s16(acc, vget_high_s16(v), vget_high_s16(v));
+	}
+	L_sum = 1 + (sum_lanes(acc) << 1);
+
+	norm = norm_l(L_sum);
+	L_sum = (L_sum << norm);
+
+	r_h[0] = L_sum >> 16;
+	r_l[0] = (L_sum & 0xffff)>>1;
+
+	/* Compute r[1] to r[m] */
+	for (i = 1; i <= m; i++)
+	{
+		Word32 n = L_WINDOW - i;
+
+		acc = vdupq_n_s32(0);
+		for (j = 0; j + 8 <= n; j += 8)
+		{
+			int16x8_t a = vld1q_s16(&y[j]);
+			int16x8_t b = vld1q_s16(&y[j + i]);
+			acc = vmlal_s16(acc, vget_low_s16(a), vget_low_s16(b));
+			acc = vmlal_s16(acc, vget_high_s16(a), vget_high_s16(b));
+		}
+
+		L_sum = sum_lanes(acc);
+		for (; j < n; j++)
+		{
+			L_sum += y[j] * y[j + i];
+		}
+
+		L_sum = L_sum << norm;
+
+		r_h[i] = L_sum >> 15;
+		r_l[i] = L_sum & 0x00007fff;
+	}
+	return;
+}
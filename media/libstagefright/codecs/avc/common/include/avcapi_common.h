@@ -230,6 +230,21 @@ typedef void (*FunctionType_Free)(void *userData, void *mem);
 */
 typedef void (*FunctionType_DebugLog)(uint32 *userData, AVCLogType type, char *string1, int val1, int val2);
 
+/** One of the independent jobs given to FunctionType_RunJobs.
+\param "jobData" "The same value of jobData given to FunctionType_RunJobs."
+\param "index" "Index of the job, from 0 to numJobs-1."
+*/
+typedef void (*FunctionType_Job)(void *jobData, int index);
+
+/** Function pointer to run jobs in parallel. It may run the jobs in any order and on any
+    thread, but it must return only after all of them have completed.
+\param "job" "Function to be called once for each job."
+\param "jobData" "Opaque value to be passed to each job."
+\param "numJobs" "Number of jobs."
+\return "void"
+*/
+typedef void (*FunctionType_RunJobs)(void *userData, FunctionType_Job job, void *jobData, int numJobs);
+
 /**
 This structure has to be allocated and maintained by the user of the library.
 This structure is used as a handle to the library object.
@@ -258,6 +273,9 @@ typedef struct tagAVCHandle
 
     FunctionType_DebugLog CBAVC_DebugLog;
 
+    /** Optional, the library runs everything on the calling thread if this is NULL. */
+    FunctionType_RunJobs CBAVC_RunJobs;
+
     /** Flag to enable debugging */
     uint32  debugEnable;
 
@@ -30,6 +30,14 @@ LOCAL_C_INCLUDES := \
 LOCAL_CFLAGS := \
     -DOSCL_IMPORT_REF= -DOSCL_UNUSED_ARG= -DOSCL_EXPORT_REF=
 
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_ARM_NEON := true
+    LOCAL_SRC_FILES += \
+        src/findhalfpel_neon.cpp \
+        src/sad_neon.cpp
+    LOCAL_CFLAGS += -DAVCENC_NEON
+endif
+
 include $(BUILD_STATIC_LIBRARY)
 
 ################################################################################
@@ -33,6 +33,7 @@
 #include <ui/GraphicBufferMapper.h>
 
 #include "SoftAVCEncoder.h"
+#include "SoftOMXWorkerPool.h"
 
 namespace android {
 
@@ -167,6 +168,24 @@ static void UnbindFrameWrapper(void *userData, int32_t index) {
     return encoder->unbindOutputBuffer(index);
 }
 
+struct EncoderJobs {
+    FunctionType_Job mJob;
+    void *mJobData;
+};
+
+static void RunEncoderJob(void *cookie, size_t index) {
+    EncoderJobs *jobs = static_cast<EncoderJobs *>(cookie);
+    (*jobs->mJob)(jobs->mJobData, index);
+}
+
+static void RunJobsWrapper(
+        void *userData, FunctionType_Job job, void *jobData, int numJobs) {
+    EncoderJobs jobs;
+    jobs.mJob = job;
+    jobs.mJobData = jobData;
+    SoftOMXWorkerPool::Get()->run(RunEncoderJob, &jobs, numJobs);
+}
+
 SoftAVCEncoder::SoftAVCEncoder(
             const char *name,
             const OMX_CALLBACKTYPE *callbacks,
@@ -182,6 +201,7 @@ SoftAVCEncoder::SoftAVCEncoder(
       mIDRFrameRefreshIntervalInSec(1),
       mAVCEncProfile(AVC_BASELINE),
       mAVCEncLevel(AVC_LEVEL2),
+      mNumThreads(0),
       mNumInputFrames(-1),
       mPrevTimestampUs(-1),
       mStarted(false),
@@ -215,6 +235,7 @@ OMX_ERRORTYPE SoftAVCEncoder::initEncParams() {
     mHandle->CBAVC_FrameUnbind = UnbindFrameWrapper;
     mHandle->CBAVC_Malloc = MallocWrapper;
     mHandle->CBAVC_Free = FreeWrapper;
+    mHandle->CBAVC_RunJobs = RunJobsWrapper;
 
     CHECK(mEncParams != NULL);
     memset(mEncParams, 0, sizeof(mEncParams));
@@ -275,6 +296,16 @@ OMX_ERRORTYPE SoftAVCEncoder::initEncParams() {
     mEncParams->frame_rate = 1000 * mVideoFrameRate;  // In frames/ms!
     mEncParams->CPB_size = (uint32_t) (mVideoBitRate >> 1);
 
+    // 720p and up is mostly screen recording and video calls where keeping
+    // up with the frame rate matters more than the last bit of quality.
+    mEncParams->me_speed = (mVideoWidth * mVideoHeight >= 1280 * 720)
+            ? AVCENC_ME_FAST : AVCENC_ME_BALANCED;
+
+    // Search bands of MB rows in parallel, the encoder limits this to the
+    // number of MB rows. The bitstream itself is still a single slice.
+    mEncParams->num_threads = (mNumThreads > 0)
+            ? mNumThreads : SoftOMXWorkerPool::Get()->parallelism();
+
     int32_t nMacroBlocks = ((((mVideoWidth + 15) >> 4) << 4) *
             (((mVideoHeight + 15) >> 4) << 4)) >> 8;
     CHECK(mSliceGroup == NULL);
@@ -427,7 +458,9 @@ void SoftAVCEncoder::initPorts() {
 
 OMX_ERRORTYPE SoftAVCEncoder::internalGetParameter(
         OMX_INDEXTYPE index, OMX_PTR params) {
-    switch (index) {
+    int32_t indexFull = index;
+
+    switch (indexFull) {
         case OMX_IndexParamVideoErrorCorrection:
         {
             return OMX_ErrorNotImplemented;
@@ -532,6 +565,19 @@ OMX_ERRORTYPE SoftAVCEncoder::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kEncoderThreadsExtensionIndex:
+        {
+            OMX_PARAM_U32TYPE *threadsParams = (OMX_PARAM_U32TYPE *)params;
+
+            if (threadsParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            threadsParams->nU32 = mNumThreads;
+
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalGetParameter(index, params);
     }
@@ -706,6 +752,22 @@ OMX_ERRORTYPE SoftAVCEncoder::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kEncoderThreadsExtensionIndex:
+        {
+            const OMX_PARAM_U32TYPE *threadsParams =
+                    (const OMX_PARAM_U32TYPE *)params;
+
+            if (threadsParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            // 0 picks as many threads as the worker pool provides.
+            mNumThreads = threadsParams->nU32;
+            ALOGV("encoder threads set to %d", mNumThreads);
+
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalSetParameter(index, params);
     }
@@ -955,6 +1017,9 @@ OMX_ERRORTYPE SoftAVCEncoder::getExtensionIndex(
     if (!strcmp(name, "OMX.google.android.index.storeMetaDataInBuffers")) {
         *(int32_t*)index = kStoreMetaDataExtensionIndex;
         return OMX_ErrorNone;
+    } else if (!strcmp(name, "OMX.google.android.index.setEncoderThreads")) {
+        *(int32_t*)index = kEncoderThreadsExtensionIndex;
+        return OMX_ErrorNone;
     }
     return OMX_ErrorUndefined;
 }
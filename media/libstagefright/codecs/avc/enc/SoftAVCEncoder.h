@@ -68,7 +68,8 @@ private:
     };
 
     enum {
-        kStoreMetaDataExtensionIndex = OMX_IndexVendorStartUnused + 1
+        kStoreMetaDataExtensionIndex = OMX_IndexVendorStartUnused + 1,
+        kEncoderThreadsExtensionIndex,
     };
 
     // OMX input buffer's timestamp and flags
@@ -86,6 +87,7 @@ private:
     int32_t  mIDRFrameRefreshIntervalInSec;
     AVCProfile mAVCEncProfile;
     AVCLevel   mAVCEncLevel;
+    int32_t  mNumThreads;   // 0 for as many as the worker pool provides
 
     int64_t  mNumInputFrames;
     int64_t  mPrevTimestampUs;
@@ -217,11 +217,23 @@ OSCL_EXPORT_REF AVCEnc_Status PVAVCEncInitialize(AVCHandle *avcHandle, AVCEncPar
     {
         return AVCENC_MEMORY_FAIL;
     }
+#ifdef AVCENC_NEON
+    encvid->functionPointer->SAD_Macroblock = &AVCSAD_Macroblock_NEON;
+    encvid->functionPointer->SAD_MB_HalfPel[0] = NULL;
+    encvid->functionPointer->SAD_MB_HalfPel[1] = &AVCSAD_MB_HalfPel_NEONxh;
+    encvid->functionPointer->SAD_MB_HalfPel[2] = &AVCSAD_MB_HalfPel_NEONyh;
+    encvid->functionPointer->SAD_MB_HalfPel[3] = &AVCSAD_MB_HalfPel_NEONxhyh;
+    encvid->functionPointer->GenerateHalfPelPred = &GenerateHalfPelPred_NEON;
+    encvid->functionPointer->GenerateQuartPelPred = &GenerateQuartPelPred_NEON;
+#else
     encvid->functionPointer->SAD_Macroblock = &AVCSAD_Macroblock_C;
     encvid->functionPointer->SAD_MB_HalfPel[0] = NULL;
     encvid->functionPointer->SAD_MB_HalfPel[1] = &AVCSAD_MB_HalfPel_Cxh;
     encvid->functionPointer->SAD_MB_HalfPel[2] = &AVCSAD_MB_HalfPel_Cyh;
     encvid->functionPointer->SAD_MB_HalfPel[3] = &AVCSAD_MB_HalfPel_Cxhyh;
+    encvid->functionPointer->GenerateHalfPelPred = &GenerateHalfPelPred;
+    encvid->functionPointer->GenerateQuartPelPred = &GenerateQuartPelPred;
+#endif
 
     /* initialize timing control */
     encvid->modTimeRef = 0;     /* ALWAYS ASSUME THAT TIMESTAMP START FROM 0 !!!*/
@@ -85,6 +85,16 @@ typedef enum
 
 } AVCEnc_Status;
 
+/**
+Motion search speed presets, from the most accurate to the fastest.
+*/
+typedef enum
+{
+    AVCENC_ME_QUALITY = 0,  /* refine up to half the search range */
+    AVCENC_ME_BALANCED = 1, /* shorter refinement, stop early on good matches */
+    AVCENC_ME_FAST = 2      /* a few refinement steps, no quarter-pel search */
+} AVCEnc_MESpeed;
+
 #define MAX_NUM_SLICE_GROUP  8      /* maximum for all the profiles */
 
 /**
@@ -138,6 +148,8 @@ typedef struct tagAVCEncParam
 
     AVCFlag fullsearch; /* enable full-pel full-search mode */
     int search_range;   /* search range for motion vector in (-search_range,+search_range) pixels */
+    AVCEnc_MESpeed me_speed;    /* motion search speed preset */
+    int num_threads;    /* number of MB row bands searched in parallel, 0 or 1 for none */
     AVCFlag sub_pel;    /* enable sub pel prediction */
     AVCFlag submb_pred; /* enable sub MB partition mode */
     AVCFlag rdopt_mode; /* RD optimal mode selection */
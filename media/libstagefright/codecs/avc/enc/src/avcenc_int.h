@@ -336,6 +336,8 @@ typedef struct tagAVCEncFuncPtr
 
     int (*SAD_MB_HalfPel[4])(uint8*, uint8*, int, void *);
     int (*SAD_Macroblock)(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
+    void (*GenerateHalfPelPred)(uint8 *subpel_pred, uint8 *ncand, int lx);
+    void (*GenerateQuartPelPred)(uint8 **bilin_base, uint8 *qpel_pred, int hpel_pos);
 
 } AVCEncFuncPtr;
 
@@ -440,6 +442,13 @@ typedef struct tagEncObject
 
     /* encoding complexity control */
     uint fullsearch_enable; /* flag to enable full-pel full-search */
+    int me_max_step;        /* maximum number of local refinement steps */
+    int me_early_exit_sad;  /* stop refining once the cost falls below this */
+    bool me_qpel_enable;    /* search quarter-pel around the best half-pel */
+
+    /* parallel motion estimation, NULL if it runs on the calling thread */
+    struct tagAVCMEBand *meBand;    /* one band of MB rows per job */
+    int numMEBands;
 
     /* misc.*/
     bool outOfBandParamSet; /* flag to enable out-of-band param set */
@@ -466,6 +475,23 @@ typedef struct tagEncObject
 
 } AVCEncObject;
 
+/**
+This structure contains a private copy of the encoder state used by the motion
+estimation of one band of MB rows, so that the bands can be searched in parallel.
+*/
+typedef struct tagAVCMEBand
+{
+    AVCEncObject encvid;    /* copy of the object, its common points to video below */
+    AVCCommonObj video;     /* copy of the common object for mbNum and currMB */
+    AVCMV *mot16x16;        /* MVs of the band and the rows right above and below it */
+
+    int firstRow;           /* MB rows [firstRow, endRow) of this band */
+    int endRow;
+
+    int numIntraSearch;     /* results of the band */
+    int totalSAD;
+} AVCMEBand;
+
 
 #endif /*AVCENC_INT_H_INCLUDED*/
 
@@ -805,6 +805,20 @@ extern "C"
     int AVCSAD_MB_HalfPel_Cxh(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
     int AVCSAD_Macroblock_C(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
 
+#ifdef AVCENC_NEON
+    /*------------- sad_neon.c ----------------------*/
+
+    int AVCSAD_MB_HalfPel_NEONxhyh(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
+    int AVCSAD_MB_HalfPel_NEONyh(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
+    int AVCSAD_MB_HalfPel_NEONxh(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
+    int AVCSAD_Macroblock_NEON(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
+
+    /*------------- findhalfpel_neon.c --------------*/
+
+    void GenerateHalfPelPred_NEON(uint8 *subpel_pred, uint8 *ncand, int lx);
+    void GenerateQuartPelPred_NEON(uint8 **bilin_base, uint8 *qpel_pred, int hpel_pos);
+#endif
+
 #ifdef HTFM /*  3/2/1, Hypothesis Testing Fast Matching */
     int AVCSAD_MB_HP_HTFM_Collectxhyh(uint8 *ref, uint8 *blk, int dmin_x, void *extra_info);
     int AVCSAD_MB_HP_HTFM_Collectyh(uint8 *ref, uint8 *blk, int dmin_x, void *extra_info);
@@ -75,7 +75,7 @@ int AVCFindHalfPelMB(AVCEncObject *encvid, uint8 *cur, AVCMV *mot, uint8 *ncand,
     OSCL_UNUSED_ARG(ypos);
     OSCL_UNUSED_ARG(hp_guess);
 
-    GenerateHalfPelPred(subpel_pred, ncand, lx);
+    (*encvid->functionPointer->GenerateHalfPelPred)(subpel_pred, ncand, lx);
 
     cur = encvid->currYMB; // pre-load current original MB
 
@@ -108,11 +108,16 @@ int AVCFindHalfPelMB(AVCEncObject *encvid, uint8 *cur, AVCMV *mot, uint8 *ncand,
     mot->y += yh[hmin];
     encvid->best_hpel_pos = hmin;
 
-    /*** search for quarter-pel ****/
-    GenerateQuartPelPred(encvid->bilin_base[hmin], &(encvid->qpel_cand[0][0]), hmin);
-
     encvid->best_qpel_pos = qmin = -1;
 
+    if (!encvid->me_qpel_enable)
+    {
+        return satd_min;
+    }
+
+    /*** search for quarter-pel ****/
+    (*encvid->functionPointer->GenerateQuartPelPred)(encvid->bilin_base[hmin], &(encvid->qpel_cand[0][0]), hmin);
+
     for (q = 0; q < 8; q++)
     {
         d = SATD_MB(encvid->qpel_cand[q], cur, dmin);
@@ -611,7 +616,11 @@ int SATD_MB(uint8 *cand, uint8 *cur, int dmin)
 
 
     dmin = (dmin << 16) | 24;
+#ifdef AVCENC_NEON
+    cost = AVCSAD_Macroblock_NEON(cand, cur, dmin, NULL);
+#else
     cost = AVCSAD_Macroblock_C(cand, cur, dmin, NULL);
+#endif
 
     return cost;
 }
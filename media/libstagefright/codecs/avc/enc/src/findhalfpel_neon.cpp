@@ -0,0 +1,261 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "avcenc_lib.h"
+
+#include <arm_neon.h>
+
+/* NEON versions of GenerateHalfPelPred() and GenerateQuartPelPred(). The
+   sub-pel arrays have the same layout as in findhalfpel.cpp, a pitch of 24
+   and 17 or 18 lines. 16 columns are filtered at a time and the remaining
+   one or two columns of each line are done in C. */
+
+#define CLIP_RESULT(x)      if((uint)x > 0xFF){ \
+                 x = 0xFF & (~(x>>31));}
+
+#define SIX_TAP(a, b, c, d, e, f)   ((a) + (f) - 5 * ((b) + (e)) + 20 * ((c) + (d)))
+
+/* a + f - 5 * (b + e) + 20 * (c + d) of 8 pixels, fits in 16 bits */
+static inline int16x8_t six_tap_u8(uint8x8_t a, uint8x8_t b, uint8x8_t c,
+                                   uint8x8_t d, uint8x8_t e, uint8x8_t f)
+{
+    int16x8_t sum = vreinterpretq_s16_u16(vaddl_u8(a, f));
+    int16x8_t be = vreinterpretq_s16_u16(vaddl_u8(b, e));
+    int16x8_t cd = vreinterpretq_s16_u16(vaddl_u8(c, d));
+
+    sum = vmlaq_n_s16(sum, cd, 20);
+    sum = vmlsq_n_s16(sum, be, 5);
+
+    return sum;
+}
+
+/* the same filter on 8 intermediate values, rounded and clipped to 8 bits */
+static inline uint8x8_t six_tap_s16(int16x8_t a, int16x8_t b, int16x8_t c,
+                                    int16x8_t d, int16x8_t e, int16x8_t f)
+{
+    int32x4_t lo = vaddl_s16(vget_low_s16(a), vget_low_s16(f));
+    int32x4_t hi = vaddl_s16(vget_high_s16(a), vget_high_s16(f));
+
+    lo = vmlaq_n_s32(lo, vaddl_s16(vget_low_s16(c), vget_low_s16(d)), 20);
+    hi = vmlaq_n_s32(hi, vaddl_s16(vget_high_s16(c), vget_high_s16(d)), 20);
+    lo = vmlsq_n_s32(lo, vaddl_s16(vget_low_s16(b), vget_low_s16(e)), 5);
+    hi = vmlsq_n_s32(hi, vaddl_s16(vget_high_s16(b), vget_high_s16(e)), 5);
+
+    /* (x + 512) >> 10 */
+    return vqmovn_u16(vcombine_u16(vqrshrun_n_s32(lo, 10), vqrshrun_n_s32(hi, 10)));
+}
+
+/* horizontal filter of one line of the full-pel array into 17 intermediate
+   values, and into 17 pixels if dst is not NULL */
+static void HorzInterpLine(uint8 *ref, int16 *dst_16, uint8 *dst)
+{
+    uint8x16_t s0 = vld1q_u8(ref);
+    uint8x16_t s1 = vld1q_u8(ref + 1);
+    uint8x16_t s2 = vld1q_u8(ref + 2);
+    uint8x16_t s3 = vld1q_u8(ref + 3);
+    uint8x16_t s4 = vld1q_u8(ref + 4);
+    uint8x16_t s5 = vld1q_u8(ref + 5);
+    int16x8_t lo, hi;
+    int32 tmp32;
+
+    lo = six_tap_u8(vget_low_u8(s0), vget_low_u8(s1), vget_low_u8(s2),
+                    vget_low_u8(s3), vget_low_u8(s4), vget_low_u8(s5));
+    hi = six_tap_u8(vget_high_u8(s0), vget_high_u8(s1), vget_high_u8(s2),
+                    vget_high_u8(s3), vget_high_u8(s4), vget_high_u8(s5));
+
+    vst1q_s16(dst_16, lo);
+    vst1q_s16(dst_16 + 8, hi);
+
+    /* do the 17th column here */
+    tmp32 = SIX_TAP(ref[16], ref[17], ref[18], ref[19], ref[20], ref[21]);
+    dst_16[16] = tmp32;
+
+    if (dst)
+    {
+        /* (x + 16) >> 5 */
+        vst1q_u8(dst, vcombine_u8(vqrshrun_n_s16(lo, 5), vqrshrun_n_s16(hi, 5)));
+
+        tmp32 = (tmp32 + 16) >> 5;
+        CLIP_RESULT(tmp32)
+        dst[16] = tmp32;
+    }
+}
+
+void GenerateHalfPelPred_NEON(uint8* subpel_pred, uint8 *ncand, int lx)
+{
+    uint8 *ref;
+    uint8 *dst;
+    int16 tmp_horz[18*22];
+    int16 *src_16;
+    int32 tmp32;
+    int i, j;
+
+    /* first copy full-pel to the first array, 24x22 */
+    ref = ncand - 3 - lx - (lx << 1); /* move back (-3,-3) */
+    dst = subpel_pred;
+
+    for (j = 0; j < 22; j++)
+    {
+        vst1q_u8(dst, vld1q_u8(ref));
+        vst1_u8(dst + 16, vld1_u8(ref + 16));
+        dst += 24;
+        ref += lx;
+    }
+
+    /* from the first array, we do horizontal interp, 17x22 intermediate values
+       and the 14th array 17x18 from the lines 2 to 19 */
+    ref = subpel_pred;
+    dst = subpel_pred + V0Q_H2Q * SUBPEL_PRED_BLK_SIZE;
+
+    for (j = 0; j < 22; j++)
+    {
+        HorzInterpLine(ref, tmp_horz + j * 18, (j >= 2 && j < 20) ? dst : NULL);
+
+        if (j >= 2 && j < 20)
+        {
+            dst += 24;
+        }
+        ref += 24;
+    }
+
+    /* Do middle point filtering, 12th array 17x17 */
+    src_16 = tmp_horz;
+    dst = subpel_pred + V2Q_H2Q * SUBPEL_PRED_BLK_SIZE;
+
+    for (j = 0; j < 17; j++)
+    {
+        for (i = 0; i < 16; i += 8)
+        {
+            vst1_u8(dst + i, six_tap_s16(vld1q_s16(src_16 + i),
+                                         vld1q_s16(src_16 + i + 18),
+                                         vld1q_s16(src_16 + i + 36),
+                                         vld1q_s16(src_16 + i + 54),
+                                         vld1q_s16(src_16 + i + 72),
+                                         vld1q_s16(src_16 + i + 90)));
+        }
+
+        /* do the 17th column here */
+        tmp32 = SIX_TAP(src_16[16], src_16[34], src_16[52], src_16[70], src_16[88], src_16[106]);
+        tmp32 = (tmp32 + 512) >> 10;
+        CLIP_RESULT(tmp32)
+        dst[16] = tmp32;
+
+        src_16 += 18;
+        dst += 24;
+    }
+
+    /* do vertical interpolation, 10th array 18x17 from the columns 2 to 19 */
+    ref = subpel_pred + 2;
+    dst = subpel_pred + V2Q_H0Q * SUBPEL_PRED_BLK_SIZE;
+
+    for (j = 0; j < 17; j++)
+    {
+        uint8x16_t s0 = vld1q_u8(ref);
+        uint8x16_t s1 = vld1q_u8(ref + 24);
+        uint8x16_t s2 = vld1q_u8(ref + 48);
+        uint8x16_t s3 = vld1q_u8(ref + 72);
+        uint8x16_t s4 = vld1q_u8(ref + 96);
+        uint8x16_t s5 = vld1q_u8(ref + 120);
+        int16x8_t lo, hi;
+
+        lo = six_tap_u8(vget_low_u8(s0), vget_low_u8(s1), vget_low_u8(s2),
+                        vget_low_u8(s3), vget_low_u8(s4), vget_low_u8(s5));
+        hi = six_tap_u8(vget_high_u8(s0), vget_high_u8(s1), vget_high_u8(s2),
+                        vget_high_u8(s3), vget_high_u8(s4), vget_high_u8(s5));
+
+        vst1q_u8(dst, vcombine_u8(vqrshrun_n_s16(lo, 5), vqrshrun_n_s16(hi, 5)));
+
+        /* do the 17th and 18th columns here */
+        for (i = 16; i < 18; i++)
+        {
+            tmp32 = SIX_TAP(ref[i], ref[i + 24], ref[i + 48], ref[i + 72], ref[i + 96], ref[i + 120]);
+            tmp32 = (tmp32 + 16) >> 5;
+            CLIP_RESULT(tmp32)
+            dst[i] = tmp32;
+        }
+
+        ref += 24;
+        dst += 24;
+    }
+
+    return ;
+}
+
+void GenerateQuartPelPred_NEON(uint8 **bilin_base, uint8 *qpel_cand, int hpel_pos)
+{
+    // for even value of hpel_pos, start with pattern 1, otherwise, start with pattern 2
+    int j;
+
+    uint8 *c1 = qpel_cand;
+    uint8 *tl = bilin_base[0];
+    uint8 *tr = bilin_base[1];
+    uint8 *bl = bilin_base[2];
+    uint8 *br = bilin_base[3];
+    uint8x16_t a, b, c, d, e;
+
+    if (!(hpel_pos&1)) // diamond pattern
+    {
+        for (j = 0; j < 16; j++)
+        {
+            a = vld1q_u8(tr);
+            d = vld1q_u8(tr + 24);
+            b = vld1q_u8(bl + 1);
+            c = vld1q_u8(br);
+            e = vld1q_u8(bl);
+
+            vst1q_u8(c1, vrhaddq_u8(c, a));
+            vst1q_u8(c1 + 384, vrhaddq_u8(b, a));       /* c2 */
+            vst1q_u8(c1 + 384 * 2, vrhaddq_u8(b, c));   /* c3 */
+            vst1q_u8(c1 + 384 * 3, vrhaddq_u8(b, d));   /* c4 */
+            vst1q_u8(c1 + 384 * 4, vrhaddq_u8(c, d));   /* c5 */
+            vst1q_u8(c1 + 384 * 5, vrhaddq_u8(e, d));   /* c6 */
+            vst1q_u8(c1 + 384 * 6, vrhaddq_u8(e, c));   /* c7 */
+            vst1q_u8(c1 + 384 * 7, vrhaddq_u8(e, a));   /* c8 */
+
+            // advance to the next line, pitch is 24
+            tr += 24;
+            bl += 24;
+            br += 24;
+            c1 += 24;
+        }
+    }
+    else // star pattern
+    {
+        for (j = 0; j < 16; j++)
+        {
+            a = vld1q_u8(br);
+
+            vst1q_u8(c1, vrhaddq_u8(a, vld1q_u8(tr)));
+            vst1q_u8(c1 + 384, vrhaddq_u8(a, vld1q_u8(tl + 1)));        /* c2 */
+            vst1q_u8(c1 + 384 * 2, vrhaddq_u8(a, vld1q_u8(bl + 1)));    /* c3 */
+            vst1q_u8(c1 + 384 * 3, vrhaddq_u8(a, vld1q_u8(tl + 25)));   /* c4 */
+            vst1q_u8(c1 + 384 * 4, vrhaddq_u8(a, vld1q_u8(tr + 24)));   /* c5 */
+            vst1q_u8(c1 + 384 * 5, vrhaddq_u8(a, vld1q_u8(tl + 24)));   /* c6 */
+            vst1q_u8(c1 + 384 * 6, vrhaddq_u8(a, vld1q_u8(bl)));        /* c7 */
+            vst1q_u8(c1 + 384 * 7, vrhaddq_u8(a, vld1q_u8(tl)));        /* c8 */
+
+            // advance to the next line, pitch is 24
+            tl += 24;
+            tr += 24;
+            bl += 24;
+            br += 24;
+            c1 += 24;
+        }
+    }
+
+    return ;
+}
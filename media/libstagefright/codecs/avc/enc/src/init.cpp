@@ -21,6 +21,9 @@
 #define LOG2_MAX_FRAME_NUM_MINUS4   12   /* 12 default */
 #define SLICE_GROUP_CHANGE_CYCLE    1    /* default */
 
+#define ME_EARLY_EXIT_BALANCED      256  /* average difference of 1 per pixel */
+#define ME_EARLY_EXIT_FAST          768
+
 /* initialized variables to be used in SPS*/
 AVCEnc_Status  SetEncodeParam(AVCHandle* avcHandle, AVCEncParams* encParam,
                               void* extSPS, void* extPPS)
@@ -508,6 +511,32 @@ AVCEnc_Status  SetEncodeParam(AVCHandle* avcHandle, AVCEncParams* encParam,
     rateCtrl->subPelEnable = (encParam->sub_pel == AVC_ON) ? TRUE : FALSE;
     rateCtrl->mvRange = encParam->search_range;
 
+    /* motion search complexity, the early exit thresholds are MB costs
+       (SAD + MV cost) below which the match is considered good enough */
+    switch (encParam->me_speed)
+    {
+        case AVCENC_ME_QUALITY:
+            encvid->me_max_step = encParam->search_range >> 1;
+            encvid->me_early_exit_sad = 0;
+            encvid->me_qpel_enable = TRUE;
+            break;
+        case AVCENC_ME_BALANCED:
+            encvid->me_max_step = encParam->search_range >> 2;
+            encvid->me_early_exit_sad = ME_EARLY_EXIT_BALANCED;
+            encvid->me_qpel_enable = TRUE;
+            break;
+        case AVCENC_ME_FAST:
+            encvid->me_max_step = 2;
+            encvid->me_early_exit_sad = ME_EARLY_EXIT_FAST;
+            encvid->me_qpel_enable = FALSE;
+            break;
+        default:
+            return AVCENC_NOT_SUPPORTED;
+    }
+
+    /* only used if the application provides CBAVC_RunJobs */
+    encvid->numMEBands = (encParam->num_threads > 1) ? encParam->num_threads : 1;
+
     rateCtrl->subMBEnable = (encParam->submb_pred == AVC_ON) ? TRUE : FALSE;
     rateCtrl->rdOptEnable = (encParam->rdopt_mode == AVC_ON) ? TRUE : FALSE;
     rateCtrl->bidirPred = (encParam->bidir_pred == AVC_ON) ? TRUE : FALSE;
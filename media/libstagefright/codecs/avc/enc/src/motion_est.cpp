@@ -64,48 +64,11 @@ uint32 num_cand = 0;
 #define FIXED_SUBMB_MODE    AVC_4x4
 /*************************************************************************/
 
-/* Initialize arrays necessary for motion search */
-AVCEnc_Status InitMotionSearchModule(AVCHandle *avcHandle)
+/* Initialize the pointers to the sub-pel candidates, in subpel_pred of encvid */
+static void AVCInitSubPelCand(AVCEncObject *encvid)
 {
-    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
-    AVCRateControl *rateCtrl = encvid->rateCtrl;
-    int search_range = rateCtrl->mvRange;
-    int number_of_subpel_positions = 4 * (2 * search_range + 3);
-    int max_mv_bits, max_mvd;
-    int temp_bits = 0;
-    uint8 *mvbits;
-    int bits, imax, imin, i;
     uint8* subpel_pred = (uint8*) encvid->subpel_pred; // all 16 sub-pel positions
 
-
-    while (number_of_subpel_positions > 0)
-    {
-        temp_bits++;
-        number_of_subpel_positions >>= 1;
-    }
-
-    max_mv_bits = 3 + 2 * temp_bits;
-    max_mvd  = (1 << (max_mv_bits >> 1)) - 1;
-
-    encvid->mvbits_array = (uint8*) avcHandle->CBAVC_Malloc(encvid->avcHandle->userData,
-                           sizeof(uint8) * (2 * max_mvd + 1), DEFAULT_ATTR);
-
-    if (encvid->mvbits_array == NULL)
-    {
-        return AVCENC_MEMORY_FAIL;
-    }
-
-    mvbits = encvid->mvbits  = encvid->mvbits_array + max_mvd;
-
-    mvbits[0] = 1;
-    for (bits = 3; bits <= max_mv_bits; bits += 2)
-    {
-        imax = 1    << (bits >> 1);
-        imin = imax >> 1;
-
-        for (i = imin; i < imax; i++)   mvbits[-i] = mvbits[i] = bits;
-    }
-
     /* initialize half-pel search */
     encvid->hpel_cand[0] = subpel_pred + REF_CENTER;
     encvid->hpel_cand[1] = subpel_pred + V2Q_H0Q * SUBPEL_PRED_BLK_SIZE + 1 ;
@@ -165,6 +128,89 @@ AVCEnc_Status InitMotionSearchModule(AVCHandle *avcHandle)
     encvid->bilin_base[8][2] = subpel_pred + V2Q_H0Q * SUBPEL_PRED_BLK_SIZE;
     encvid->bilin_base[8][3] = subpel_pred + V2Q_H2Q * SUBPEL_PRED_BLK_SIZE;
 
+    return ;
+}
+
+/* Initialize arrays necessary for motion search */
+AVCEnc_Status InitMotionSearchModule(AVCHandle *avcHandle)
+{
+    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
+    AVCCommonObj *video = encvid->common;
+    AVCRateControl *rateCtrl = encvid->rateCtrl;
+    AVCMEBand *band;
+    int search_range = rateCtrl->mvRange;
+    int number_of_subpel_positions = 4 * (2 * search_range + 3);
+    int max_mv_bits, max_mvd;
+    int temp_bits = 0;
+    uint8 *mvbits;
+    int bits, imax, imin, i;
+
+
+    while (number_of_subpel_positions > 0)
+    {
+        temp_bits++;
+        number_of_subpel_positions >>= 1;
+    }
+
+    max_mv_bits = 3 + 2 * temp_bits;
+    max_mvd  = (1 << (max_mv_bits >> 1)) - 1;
+
+    encvid->mvbits_array = (uint8*) avcHandle->CBAVC_Malloc(encvid->avcHandle->userData,
+                           sizeof(uint8) * (2 * max_mvd + 1), DEFAULT_ATTR);
+
+    if (encvid->mvbits_array == NULL)
+    {
+        return AVCENC_MEMORY_FAIL;
+    }
+
+    mvbits = encvid->mvbits  = encvid->mvbits_array + max_mvd;
+
+    mvbits[0] = 1;
+    for (bits = 3; bits <= max_mv_bits; bits += 2)
+    {
+        imax = 1    << (bits >> 1);
+        imin = imax >> 1;
+
+        for (i = imin; i < imax; i++)   mvbits[-i] = mvbits[i] = bits;
+    }
+
+    AVCInitSubPelCand(encvid);
+
+    /* one private copy of the search state per band for parallel motion estimation */
+    encvid->meBand = NULL;
+    if (encvid->numMEBands > (int)video->PicHeightInMbs)
+    {
+        encvid->numMEBands = video->PicHeightInMbs;
+    }
+    if (encvid->numMEBands > 1 && avcHandle->CBAVC_RunJobs != NULL)
+    {
+        encvid->meBand = (AVCMEBand*) avcHandle->CBAVC_Malloc(encvid->avcHandle->userData,
+                         sizeof(AVCMEBand) * encvid->numMEBands, DEFAULT_ATTR);
+
+        if (encvid->meBand == NULL)
+        {
+            return AVCENC_MEMORY_FAIL;
+        }
+
+        for (i = 0; i < encvid->numMEBands; i++)
+        {
+            band = encvid->meBand + i;
+            band->mot16x16 = (AVCMV*) avcHandle->CBAVC_Malloc(encvid->avcHandle->userData,
+                             sizeof(AVCMV) * video->PicSizeInMbs, DEFAULT_ATTR);
+
+            if (band->mot16x16 == NULL)
+            {
+                return AVCENC_MEMORY_FAIL;
+            }
+
+            band->firstRow = i * video->PicHeightInMbs / encvid->numMEBands;
+            band->endRow = (i + 1) * video->PicHeightInMbs / encvid->numMEBands;
+        }
+    }
+    else
+    {
+        encvid->numMEBands = 0;
+    }
 
     return AVCENC_SUCCESS;
 }
@@ -173,6 +219,7 @@ AVCEnc_Status InitMotionSearchModule(AVCHandle *avcHandle)
 void CleanMotionSearchModule(AVCHandle *avcHandle)
 {
     AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
+    int i;
 
     if (encvid->mvbits_array)
     {
@@ -180,6 +227,19 @@ void CleanMotionSearchModule(AVCHandle *avcHandle)
         encvid->mvbits = NULL;
     }
 
+    if (encvid->meBand)
+    {
+        for (i = 0; i < encvid->numMEBands; i++)
+        {
+            if (encvid->meBand[i].mot16x16)
+            {
+                avcHandle->CBAVC_Free(avcHandle->userData, encvid->meBand[i].mot16x16);
+            }
+        }
+        avcHandle->CBAVC_Free(avcHandle->userData, encvid->meBand);
+        encvid->meBand = NULL;
+    }
+
     return ;
 }
 
@@ -232,45 +292,226 @@ bool IntraDecisionABE(int *min_cost, uint8 *cur, int pitch, bool ave)
     return intra;
 }
 
-/******* main function for macroblock prediction for the entire frame ***/
-/* if turns out to be IDR frame, set video->nal_unit_type to AVC_NALTYPE_IDR */
-void AVCMotionEstimation(AVCEncObject *encvid)
+/* Motion search of the MB rows [firstRow, endRow) for one pass. Adds the number of MBs
+   to be intra searched and their SAD for rate control to *numIntraSearch and *totalSAD. */
+static void AVCMotionSearchRows(AVCEncObject *encvid, int firstRow, int endRow, int start_i,
+                                int incr_i, int type_pred, int *numIntraSearch, int *totalSAD)
 {
     AVCCommonObj *video = encvid->common;
-    int slice_type = video->slice_type;
     AVCFrameIO *currInput = encvid->currInput;
-    AVCPictureData *refPic = video->RefPicList0[0];
     int i, j, k;
     int mbwidth = video->PicWidthInMbs;
     int mbheight = video->PicHeightInMbs;
-    int totalMB = video->PicSizeInMbs;
     int pitch = currInput->pitch;
     AVCMacroblock *currMB, *mblock = video->mblock;
     AVCMV *mot_mb_16x16, *mot16x16 = encvid->mot16x16;
-    // AVCMV *mot_mb_16x8, *mot_mb_8x16, *mot_mb_8x8, etc;
     AVCRateControl *rateCtrl = encvid->rateCtrl;
     uint8 *intraSearch = encvid->intraSearch;
     uint FS_en = encvid->fullsearch_enable;
 
-    int NumIntraSearch, start_i, numLoop, incr_i;
     int mbnum, offset;
     uint8 *cur, *best_cand[5];
+    int abe_cost;
+    int hp_guess = 0;
+    uint32 mv_uint32;
+
+    for (j = firstRow; j < endRow; j++)
+    {
+        i = start_i;
+        if (incr_i > 1)
+            i = (start_i + j + 1) & 1; /* toggle 0 and 1 from row to row */
+
+        offset = pitch * (j << 4) + (i << 4);
+
+        mbnum = j * mbwidth + i;
+
+        for (; i < mbwidth; i += incr_i)
+        {
+            video->mbNum = mbnum;
+            video->currMB = currMB = mblock + mbnum;
+            mot_mb_16x16 = mot16x16 + mbnum;
+
+            cur = currInput->YCbCr[0] + offset;
+
+            if (currMB->mb_intra == 0) /* for INTER mode */
+            {
+#if defined(HTFM)
+                HTFMPrepareCurMB_AVC(encvid, &(encvid->htfm_stat), cur, pitch);
+#else
+                AVCPrepareCurMB(encvid, cur, pitch);
+#endif
+                /************************************************************/
+                /******** full-pel 1MV search **********************/
+
+                AVCMBMotionSearch(encvid, cur, best_cand, i << 4, j << 4, type_pred,
+                                  FS_en, &hp_guess);
+
+                abe_cost = encvid->min_cost[mbnum] = mot_mb_16x16->sad;
+
+                /* set mbMode and MVs */
+                currMB->mbMode = AVC_P16;
+                currMB->MBPartPredMode[0][0] = AVC_Pred_L0;
+                mv_uint32 = ((mot_mb_16x16->y) << 16) | ((mot_mb_16x16->x) & 0xffff);
+                for (k = 0; k < 32; k += 2)
+                {
+                    currMB->mvL0[k>>1] = mv_uint32;
+                }
+
+                /* make a decision whether it should be tested for intra or not */
+                if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
+                {
+                    if (false == IntraDecisionABE(&abe_cost, cur, pitch, true))
+                    {
+                        intraSearch[mbnum] = 0;
+                    }
+                    else
+                    {
+                        (*numIntraSearch)++;
+                        rateCtrl->MADofMB[mbnum] = abe_cost;
+                    }
+                }
+                else // boundary MBs, always do intra search
+                {
+                    (*numIntraSearch)++;
+                }
+
+                *totalSAD += (int) rateCtrl->MADofMB[mbnum];//mot_mb_16x16->sad;
+            }
+            else    /* INTRA update, use for prediction */
+            {
+                mot_mb_16x16[0].x = mot_mb_16x16[0].y = 0;
+
+                /* reset all other MVs to zero */
+                /* mot_mb_16x8, mot_mb_8x16, mot_mb_8x8, etc. */
+                abe_cost = encvid->min_cost[mbnum] = 0x7FFFFFFF;  /* max value for int */
+
+                if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
+                {
+                    IntraDecisionABE(&abe_cost, cur, pitch, false);
+
+                    rateCtrl->MADofMB[mbnum] = abe_cost;
+                    *totalSAD += abe_cost;
+                }
+
+                (*numIntraSearch)++;
+                /* cannot do I16 prediction here because it needs full decoding. */
+                // intraSearch[mbnum] = 1;
+
+            }
+
+            mbnum += incr_i;
+            offset += (incr_i << 4);
+
+        } /* for i */
+    } /* for j */
+
+    return ;
+}
+
+/* Arguments of one pass of AVCMotionSearchBands(), shared by all of its jobs */
+typedef struct tagAVCMEPass
+{
+    AVCEncObject *encvid;
+    int start_i;
+    int incr_i;
+    int type_pred;
+} AVCMEPass;
+
+static void AVCMotionSearchBandJob(void *jobData, int index)
+{
+    AVCMEPass *pass = (AVCMEPass*) jobData;
+    AVCMEBand *band = pass->encvid->meBand + index;
+
+    band->numIntraSearch = 0;
+    band->totalSAD = 0;
+
+    AVCMotionSearchRows(&(band->encvid), band->firstRow, band->endRow, pass->start_i,
+                        pass->incr_i, pass->type_pred, &(band->numIntraSearch), &(band->totalSAD));
+
+    return ;
+}
+
+/* Same as AVCMotionSearchRows() over the whole frame, with the bands searched in parallel.
+   Each band searches with a copy of the MVs, so the rows of the neighboring bands are
+   always seen as they were before the pass and the result does not depend on the timing
+   of the other jobs. The MB and rate control arrays are written per MB and are shared. */
+static void AVCMotionSearchBands(AVCEncObject *encvid, int start_i, int incr_i, int type_pred,
+                                 int *numIntraSearch, int *totalSAD)
+{
+    AVCHandle *avcHandle = encvid->avcHandle;
+    AVCCommonObj *video = encvid->common;
+    int mbwidth = video->PicWidthInMbs;
+    int mbheight = video->PicHeightInMbs;
+    AVCMEBand *band;
+    AVCMEPass pass;
+    int i, top, bottom;
+
+    for (i = 0; i < encvid->numMEBands; i++)
+    {
+        band = encvid->meBand + i;
+
+        band->encvid = *encvid;
+        band->video = *video;
+        band->encvid.common = &(band->video);
+        band->encvid.mot16x16 = band->mot16x16;
+        band->encvid.meBand = NULL;
+        band->encvid.numMEBands = 0;
+        AVCInitSubPelCand(&(band->encvid));
+
+        /* the band and the rows right above and below it */
+        top = (band->firstRow > 0) ? band->firstRow - 1 : 0;
+        bottom = (band->endRow < mbheight) ? band->endRow + 1 : mbheight;
+        memcpy(band->mot16x16 + top * mbwidth, encvid->mot16x16 + top * mbwidth,
+               sizeof(AVCMV) * (bottom - top) * mbwidth);
+    }
+
+    pass.encvid = encvid;
+    pass.start_i = start_i;
+    pass.incr_i = incr_i;
+    pass.type_pred = type_pred;
+
+    (*avcHandle->CBAVC_RunJobs)(avcHandle->userData, &AVCMotionSearchBandJob, &pass,
+                                encvid->numMEBands);
+
+    for (i = 0; i < encvid->numMEBands; i++)
+    {
+        band = encvid->meBand + i;
+
+        memcpy(encvid->mot16x16 + band->firstRow * mbwidth, band->mot16x16 + band->firstRow * mbwidth,
+               sizeof(AVCMV) * (band->endRow - band->firstRow) * mbwidth);
+
+        *numIntraSearch += band->numIntraSearch;
+        *totalSAD += band->totalSAD;
+    }
+
+    return ;
+}
+
+/******* main function for macroblock prediction for the entire frame ***/
+/* if turns out to be IDR frame, set video->nal_unit_type to AVC_NALTYPE_IDR */
+void AVCMotionEstimation(AVCEncObject *encvid)
+{
+    AVCCommonObj *video = encvid->common;
+    int slice_type = video->slice_type;
+    AVCPictureData *refPic = video->RefPicList0[0];
+    int i;
+    int mbheight = video->PicHeightInMbs;
+    int totalMB = video->PicSizeInMbs;
+    AVCMacroblock *mblock = video->mblock;
+    AVCRateControl *rateCtrl = encvid->rateCtrl;
+    uint8 *intraSearch = encvid->intraSearch;
+
+    int NumIntraSearch, start_i, numLoop, incr_i;
     int totalSAD = 0;   /* average SAD for rate control */
     int type_pred;
-    int abe_cost;
 
 #ifdef HTFM
     /***** HYPOTHESIS TESTING ********/  /* 2/28/01 */
     int collect = 0;
-    HTFM_Stat htfm_stat;
     double newvar[16];
     double exp_lamda[15];
     /*********************************/
 #endif
-    int hp_guess = 0;
-    uint32 mv_uint32;
-
-    offset = 0;
 
     if (slice_type == AVC_I_SLICE)
     {
@@ -309,7 +550,7 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     encvid->sad_extra_info = NULL;
 #ifdef HTFM
     /***** HYPOTHESIS TESTING ********/
-    InitHTFM(video, &htfm_stat, newvar, &collect);
+    InitHTFM(video, &(encvid->htfm_stat), newvar, &collect);
     /*********************************/
 #endif
 
@@ -336,94 +577,15 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     NumIntraSearch = 0; // to be intra searched in the encoding loop.
     while (numLoop--)
     {
-        for (j = 0; j < mbheight; j++)
+        if (encvid->meBand)
         {
-            if (incr_i > 1)
-                start_i = (start_i == 0 ? 1 : 0) ; /* toggle 0 and 1 */
-
-            offset = pitch * (j << 4) + (start_i << 4);
-
-            mbnum = j * mbwidth + start_i;
-
-            for (i = start_i; i < mbwidth; i += incr_i)
-            {
-                video->mbNum = mbnum;
-                video->currMB = currMB = mblock + mbnum;
-                mot_mb_16x16 = mot16x16 + mbnum;
-
-                cur = currInput->YCbCr[0] + offset;
-
-                if (currMB->mb_intra == 0) /* for INTER mode */
-                {
-#if defined(HTFM)
-                    HTFMPrepareCurMB_AVC(encvid, &htfm_stat, cur, pitch);
-#else
-                    AVCPrepareCurMB(encvid, cur, pitch);
-#endif
-                    /************************************************************/
-                    /******** full-pel 1MV search **********************/
-
-                    AVCMBMotionSearch(encvid, cur, best_cand, i << 4, j << 4, type_pred,
-                                      FS_en, &hp_guess);
-
-                    abe_cost = encvid->min_cost[mbnum] = mot_mb_16x16->sad;
-
-                    /* set mbMode and MVs */
-                    currMB->mbMode = AVC_P16;
-                    currMB->MBPartPredMode[0][0] = AVC_Pred_L0;
-                    mv_uint32 = ((mot_mb_16x16->y) << 16) | ((mot_mb_16x16->x) & 0xffff);
-                    for (k = 0; k < 32; k += 2)
-                    {
-                        currMB->mvL0[k>>1] = mv_uint32;
-                    }
-
-                    /* make a decision whether it should be tested for intra or not */
-                    if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
-                    {
-                        if (false == IntraDecisionABE(&abe_cost, cur, pitch, true))
-                        {
-                            intraSearch[mbnum] = 0;
-                        }
-                        else
-                        {
-                            NumIntraSearch++;
-                            rateCtrl->MADofMB[mbnum] = abe_cost;
-                        }
-                    }
-                    else // boundary MBs, always do intra search
-                    {
-                        NumIntraSearch++;
-                    }
-
-                    totalSAD += (int) rateCtrl->MADofMB[mbnum];//mot_mb_16x16->sad;
-                }
-                else    /* INTRA update, use for prediction */
-                {
-                    mot_mb_16x16[0].x = mot_mb_16x16[0].y = 0;
-
-                    /* reset all other MVs to zero */
-                    /* mot_mb_16x8, mot_mb_8x16, mot_mb_8x8, etc. */
-                    abe_cost = encvid->min_cost[mbnum] = 0x7FFFFFFF;  /* max value for int */
-
-                    if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
-                    {
-                        IntraDecisionABE(&abe_cost, cur, pitch, false);
-
-                        rateCtrl->MADofMB[mbnum] = abe_cost;
-                        totalSAD += abe_cost;
-                    }
-
-                    NumIntraSearch++ ;
-                    /* cannot do I16 prediction here because it needs full decoding. */
-                    // intraSearch[mbnum] = 1;
-
-                }
-
-                mbnum += incr_i;
-                offset += (incr_i << 4);
-
-            } /* for i */
-        } /* for j */
+            AVCMotionSearchBands(encvid, start_i, incr_i, type_pred, &NumIntraSearch, &totalSAD);
+        }
+        else
+        {
+            AVCMotionSearchRows(encvid, 0, mbheight, start_i, incr_i, type_pred,
+                                &NumIntraSearch, &totalSAD);
+        }
 
         /* since we cannot do intra/inter decision here, the SCD has to be
         based on other criteria such as motion vectors coherency or the SAD */
@@ -464,7 +626,7 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     if (collect)
     {
         collect = 0;
-        UpdateHTFM(encvid, newvar, exp_lamda, &htfm_stat);
+        UpdateHTFM(encvid, newvar, exp_lamda, &(encvid->htfm_stat));
     }
     /*********************************/
 #endif
@@ -977,7 +1139,7 @@ void AVCMBMotionSearch(AVCEncObject *encvid, uint8 *cur, uint8 *best_cand[],
     int mvx[5], mvy[5];
     int num_can, center_again;
     int last_loc, new_loc = 0;
-    int step, max_step = range >> 1;
+    int step, max_step = AVC_MIN(range >> 1, encvid->me_max_step);
     int next;
 
     int cmvx, cmvy; /* estimated predicted MV */
@@ -1137,7 +1299,7 @@ void AVCMBMotionSearch(AVCEncObject *encvid, uint8 *cur, uint8 *best_cand[],
             //          ncand = ref + jmin*lx + imin;  /* center of the search */
             step = 0;
             dn[0] = dmin;
-            while (!center_again && step <= max_step)
+            while (!center_again && step <= max_step && dmin >= encvid->me_early_exit_sad)
             {
 
                 AVCMoveNeighborSAD(dn, last_loc);
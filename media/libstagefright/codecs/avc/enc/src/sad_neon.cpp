@@ -0,0 +1,176 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "avcenc_lib.h"
+
+#include <arm_neon.h>
+
+/* NEON versions of the 16x16 SAD functions in sad.cpp and sad_halfpel.cpp.
+   blk is always the current MB with a pitch of 16. The partial SAD is only
+   compared against dmin every 4 lines, the callers just check the result
+   against dmin so stopping a few lines later than the C version does not
+   change the search. */
+
+static inline int sad_sum(uint16x8_t acc)
+{
+    uint32x4_t sum4 = vpaddlq_u16(acc);
+    uint64x2_t sum2 = vpaddlq_u32(sum4);
+
+    return (int)(vgetq_lane_u64(sum2, 0) + vgetq_lane_u64(sum2, 1));
+}
+
+static inline uint16x8_t sad_16pixel(uint16x8_t acc, uint8x16_t pred, const uint8 *blk)
+{
+    uint8x16_t org = vld1q_u8(blk);
+
+    acc = vabal_u8(acc, vget_low_u8(pred), vget_low_u8(org));
+    acc = vabal_u8(acc, vget_high_u8(pred), vget_high_u8(org));
+
+    return acc;
+}
+
+int AVCSAD_Macroblock_NEON(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info)
+{
+    (void)(extra_info);
+
+    int i, j;
+    int sad = 0;
+    int dmin = (uint32)dmin_lx >> 16;
+    int lx = dmin_lx & 0xFFFF;
+    uint16x8_t acc = vdupq_n_u16(0);
+
+    for (i = 0; i < 4; i++)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            acc = sad_16pixel(acc, vld1q_u8(ref), blk);
+            ref += lx;
+            blk += 16;
+        }
+
+        sad = sad_sum(acc);
+        if (sad > dmin)
+            return sad;
+    }
+
+    return sad;
+}
+
+int AVCSAD_MB_HalfPel_NEONxhyh(uint8 *ref, uint8 *blk, int dmin_rx, void *extra_info)
+{
+    (void)(extra_info);
+
+    int i, j;
+    int sad = 0;
+    int dmin = (uint32)dmin_rx >> 16;
+    int rx = dmin_rx & 0xFFFF;
+    uint16x8_t acc = vdupq_n_u16(0);
+    uint8x16_t p1 = vld1q_u8(ref);
+    uint8x16_t p2 = vld1q_u8(ref + 1);
+    uint8x16_t p3, p4;
+    uint16x8_t lo, hi;
+
+    for (i = 0; i < 4; i++)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            ref += rx;
+            p3 = vld1q_u8(ref);
+            p4 = vld1q_u8(ref + 1);
+
+            lo = vaddq_u16(vaddl_u8(vget_low_u8(p1), vget_low_u8(p2)),
+                           vaddl_u8(vget_low_u8(p3), vget_low_u8(p4)));
+            hi = vaddq_u16(vaddl_u8(vget_high_u8(p1), vget_high_u8(p2)),
+                           vaddl_u8(vget_high_u8(p3), vget_high_u8(p4)));
+
+            /* (p1 + p2 + p3 + p4 + 2) >> 2 */
+            acc = sad_16pixel(acc, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)), blk);
+            blk += 16;
+
+            p1 = p3;
+            p2 = p4;
+        }
+
+        sad = sad_sum(acc);
+        if (sad > dmin)
+            return sad;
+    }
+
+    return sad;
+}
+
+int AVCSAD_MB_HalfPel_NEONyh(uint8 *ref, uint8 *blk, int dmin_rx, void *extra_info)
+{
+    (void)(extra_info);
+
+    int i, j;
+    int sad = 0;
+    int dmin = (uint32)dmin_rx >> 16;
+    int rx = dmin_rx & 0xFFFF;
+    uint16x8_t acc = vdupq_n_u16(0);
+    uint8x16_t p1 = vld1q_u8(ref);
+    uint8x16_t p2;
+
+    for (i = 0; i < 4; i++)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            ref += rx;
+            p2 = vld1q_u8(ref);
+
+            /* (p1 + p2 + 1) >> 1 */
+            acc = sad_16pixel(acc, vrhaddq_u8(p1, p2), blk);
+            blk += 16;
+
+            p1 = p2;
+        }
+
+        sad = sad_sum(acc);
+        if (sad > dmin)
+            return sad;
+    }
+
+    return sad;
+}
+
+int AVCSAD_MB_HalfPel_NEONxh(uint8 *ref, uint8 *blk, int dmin_rx, void *extra_info)
+{
+    (void)(extra_info);
+
+    int i, j;
+    int sad = 0;
+    int dmin = (uint32)dmin_rx >> 16;
+    int rx = dmin_rx & 0xFFFF;
+    uint16x8_t acc = vdupq_n_u16(0);
+
+    for (i = 0; i < 4; i++)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            /* (p1[j] + p1[j+1] + 1) >> 1 */
+            acc = sad_16pixel(acc, vrhaddq_u8(vld1q_u8(ref), vld1q_u8(ref + 1)), blk);
+            ref += rx;
+            blk += 16;
+        }
+
+        sad = sad_sum(acc);
+        if (sad > dmin)
+            return sad;
+    }
+
+    return sad;
+}
@@ -19,9 +19,12 @@
 #include <utils/Log.h>
 
 #include "SoftFlacEncoder.h"
+#include "SoftOMXWorkerPool.h"
 
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaDefs.h>
+#include <utils/KeyedVector.h>
 
 #define FLAC_COMPRESSION_LEVEL_MIN     0
 #define FLAC_COMPRESSION_LEVEL_DEFAULT 5
@@ -51,6 +54,16 @@ SoftFlacEncoder::SoftFlacEncoder(
       mEncoderWriteData(false),
       mEncoderReturnedEncodedData(false),
       mEncoderReturnedNbBytes(0),
+      mNumThreads(0),
+      mWorkersChecked(false),
+      mBlockSize(0),
+      mBatchPcm32(NULL),
+      mBatchFrames(0),
+      mBatchIsLast(false),
+      mInputFramesConsumed(0),
+      mStartTimeValid(false),
+      mStartTimeUs(0),
+      mSawInputEOS(false),
       mInputBufferPcm32(NULL)
 #ifdef WRITE_FLAC_HEADER_IN_FIRST_BUFFER
       , mHeaderOffset(0)
@@ -77,6 +90,7 @@ SoftFlacEncoder::SoftFlacEncoder(
 
 SoftFlacEncoder::~SoftFlacEncoder() {
     ALOGV("SoftFlacEncoder::~SoftFlacEncoder()");
+    releaseWorkers();
     if (mFlacStreamEncoder != NULL) {
         FLAC__stream_encoder_delete(mFlacStreamEncoder);
         mFlacStreamEncoder = NULL;
@@ -147,7 +161,9 @@ OMX_ERRORTYPE SoftFlacEncoder::internalGetParameter(
         OMX_INDEXTYPE index, OMX_PTR params) {
     ALOGV("SoftFlacEncoder::internalGetParameter(index=0x%x)", index);
 
-    switch (index) {
+    int32_t indexFull = index;
+
+    switch (indexFull) {
         case OMX_IndexParamAudioPcm:
         {
             OMX_AUDIO_PARAM_PCMMODETYPE *pcmParams =
@@ -180,6 +196,19 @@ OMX_ERRORTYPE SoftFlacEncoder::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kEncoderThreadsExtensionIndex:
+        {
+            OMX_PARAM_U32TYPE *threadsParams = (OMX_PARAM_U32TYPE *)params;
+
+            if (threadsParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            threadsParams->nU32 = mNumThreads;
+
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalGetParameter(index, params);
     }
@@ -187,7 +216,9 @@ OMX_ERRORTYPE SoftFlacEncoder::internalGetParameter(
 
 OMX_ERRORTYPE SoftFlacEncoder::internalSetParameter(
         OMX_INDEXTYPE index, const OMX_PTR params) {
-    switch (index) {
+    int32_t indexFull = index;
+
+    switch (indexFull) {
         case OMX_IndexParamAudioPcm:
         {
             ALOGV("SoftFlacEncoder::internalSetParameter(OMX_IndexParamAudioPcm)");
@@ -234,6 +265,23 @@ OMX_ERRORTYPE SoftFlacEncoder::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kEncoderThreadsExtensionIndex:
+        {
+            const OMX_PARAM_U32TYPE *threadsParams =
+                    (const OMX_PARAM_U32TYPE *)params;
+
+            if (threadsParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            // 0 picks as many threads as the worker pool provides, for
+            // sample rates above kMinAutoParallelSampleRate.
+            mNumThreads = threadsParams->nU32;
+            ALOGV("encoder threads set to %ld", mNumThreads);
+
+            return OMX_ErrorNone;
+        }
+
         case OMX_IndexParamPortDefinition:
         {
             OMX_PARAM_PORTDEFINITIONTYPE *defParams =
@@ -264,6 +312,16 @@ void SoftFlacEncoder::onQueueFilled(OMX_U32 portIndex) {
         return;
     }
 
+    if (!mWorkersChecked) {
+        mWorkersChecked = true;
+        setUpWorkers();
+    }
+
+    if (!mWorkers.isEmpty()) {
+        onQueueFilledParallel();
+        return;
+    }
+
     List<BufferInfo *> &inQueue = getPortQueue(0);
     List<BufferInfo *> &outQueue = getPortQueue(1);
 
@@ -413,32 +471,34 @@ OMX_ERRORTYPE SoftFlacEncoder::configureEncoder() {
         return OMX_ErrorInvalidState;
     }
 
+    if (setUpFlacEncoder(mFlacStreamEncoder, flacEncoderWriteCallback, this)) {
+        ALOGV("encoder successfully configured");
+        return OMX_ErrorNone;
+    } else {
+        ALOGE("unknown error when configuring encoder");
+        return OMX_ErrorUndefined;
+    }
+}
+
+bool SoftFlacEncoder::setUpFlacEncoder(FLAC__StreamEncoder *encoder,
+        FLAC__StreamEncoderWriteCallback writeCallback, void *clientData) {
     FLAC__bool ok = true;
-    FLAC__StreamEncoderInitStatus initStatus = FLAC__STREAM_ENCODER_INIT_STATUS_OK;
-    ok = ok && FLAC__stream_encoder_set_channels(mFlacStreamEncoder, mNumChannels);
-    ok = ok && FLAC__stream_encoder_set_sample_rate(mFlacStreamEncoder, mSampleRate);
-    ok = ok && FLAC__stream_encoder_set_bits_per_sample(mFlacStreamEncoder, 16);
-    ok = ok && FLAC__stream_encoder_set_compression_level(mFlacStreamEncoder,
+    ok = ok && FLAC__stream_encoder_set_channels(encoder, mNumChannels);
+    ok = ok && FLAC__stream_encoder_set_sample_rate(encoder, mSampleRate);
+    ok = ok && FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+    ok = ok && FLAC__stream_encoder_set_compression_level(encoder,
             (unsigned)mCompressionLevel);
-    ok = ok && FLAC__stream_encoder_set_verify(mFlacStreamEncoder, false);
-    if (!ok) { goto return_result; }
+    ok = ok && FLAC__stream_encoder_set_verify(encoder, false);
 
-    ok &= FLAC__STREAM_ENCODER_INIT_STATUS_OK ==
-            FLAC__stream_encoder_init_stream(mFlacStreamEncoder,
-                    flacEncoderWriteCallback    /*write_callback*/,
+    ok = ok && FLAC__STREAM_ENCODER_INIT_STATUS_OK ==
+            FLAC__stream_encoder_init_stream(encoder,
+                    writeCallback               /*write_callback*/,
                     NULL /*seek_callback*/,
                     NULL /*tell_callback*/,
                     NULL /*metadata_callback*/,
-                    (void *) this /*client_data*/);
+                    clientData                  /*client_data*/);
 
-return_result:
-    if (ok) {
-        ALOGV("encoder successfully configured");
-        return OMX_ErrorNone;
-    } else {
-        ALOGE("unknown error when configuring encoder");
-        return OMX_ErrorUndefined;
-    }
+    return ok;
 }
 
 
@@ -450,6 +510,427 @@ FLAC__StreamEncoderWriteStatus SoftFlacEncoder::flacEncoderWriteCallback(
             buffer, bytes, samples, current_frame);
 }
 
+OMX_ERRORTYPE SoftFlacEncoder::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, "OMX.google.android.index.setEncoderThreads")) {
+        *(int32_t*)index = kEncoderThreadsExtensionIndex;
+        return OMX_ErrorNone;
+    }
+    return OMX_ErrorUndefined;
+}
+
+void SoftFlacEncoder::onPortFlushCompleted(OMX_U32 portIndex) {
+    if (!mWorkers.isEmpty()) {
+        resetWorkers();
+    }
+}
+
+void SoftFlacEncoder::onReset() {
+    // the stream parameters may change before the next run
+    releaseWorkers();
+    mWorkersChecked = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Frame-parallel mode
+//
+// FLAC frames do not depend on each other, so N stream encoders encode N
+// consecutive blocks at a time on the SoftOMXWorkerPool. Since libFLAC only
+// encodes a block once it has seen the first sample of the next one, the
+// frame of each block comes out with the next batch, or when the encoders
+// are finished at EOS. Every frame header is rewritten with the frame
+// number of the frame in the whole stream, and the frames are sent out in
+// stream order.
+
+void SoftFlacEncoder::setUpWorkers() {
+    size_t numWorkers = mNumThreads;
+    if (numWorkers == 0) {
+        numWorkers = (mSampleRate > kMinAutoParallelSampleRate)
+                ? SoftOMXWorkerPool::Get()->parallelism() : 1;
+    }
+    if (numWorkers <= 1) {
+        return;
+    }
+
+    // CRC-16 of the frame footer, polynomial x^16 + x^15 + x^2 + 1
+    for (unsigned i = 0; i < 256; ++i) {
+        unsigned crc = i << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x8005 : (crc << 1);
+        }
+        mCrc16Table[i] = crc & 0xffff;
+    }
+
+    for (size_t i = 0; i < numWorkers; ++i) {
+        FlacWorker *worker = new FlacWorker;
+        worker->mOwner = this;
+        worker->mIndex = i;
+        worker->mEncoder = FLAC__stream_encoder_new();
+        worker->mOk = true;
+        mWorkers.push(worker);
+
+        if (worker->mEncoder == NULL
+                || !setUpFlacEncoder(worker->mEncoder, flacWorkerWriteCallback, worker)) {
+            ALOGW("could not set up %zu encoders, encoding on a single thread",
+                    numWorkers);
+            releaseWorkers();
+            return;
+        }
+    }
+
+    mBlockSize = FLAC__stream_encoder_get_blocksize(mWorkers[0]->mEncoder);
+    mBatchPcm32 = (FLAC__int32 *) malloc(
+            sizeof(FLAC__int32) * mNumChannels * mBlockSize * numWorkers);
+    if (mBatchPcm32 == NULL) {
+        ALOGW("could not allocate the input of %zu encoders, encoding on a single thread",
+                numWorkers);
+        releaseWorkers();
+        return;
+    }
+
+    mBatchFrames = 0;
+    mInputFramesConsumed = 0;
+    mStartTimeValid = false;
+    mSawInputEOS = false;
+
+    ALOGV("encoding frames of %u samples on %zu threads", mBlockSize, numWorkers);
+}
+
+void SoftFlacEncoder::releaseWorkers() {
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        FlacWorker *worker = mWorkers[i];
+        if (worker->mEncoder != NULL) {
+            FLAC__stream_encoder_delete(worker->mEncoder);
+        }
+        delete worker;
+    }
+    mWorkers.clear();
+
+    free(mBatchPcm32);
+    mBatchPcm32 = NULL;
+    mEncodedFrames.clear();
+}
+
+void SoftFlacEncoder::resetWorkers() {
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        FlacWorker *worker = mWorkers[i];
+        // drops the blocks held back by the encoder
+        FLAC__stream_encoder_finish(worker->mEncoder);
+        worker->mFrames.clear();
+
+        if (!setUpFlacEncoder(worker->mEncoder, flacWorkerWriteCallback, worker)) {
+            ALOGE("could not restart encoder %zu", i);
+            mSignalledError = true;
+            notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+        }
+    }
+
+    mBatchFrames = 0;
+    mInputFramesConsumed = 0;
+    mStartTimeValid = false;
+    mSawInputEOS = false;
+    mEncodedFrames.clear();
+}
+
+void SoftFlacEncoder::onQueueFilledParallel() {
+    List<BufferInfo *> &inQueue = getPortQueue(0);
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+
+    for (;;) {
+        // hand out the encoded frames in stream order, as many per buffer as fit
+        while (!mEncodedFrames.empty() && !outQueue.empty()) {
+            BufferInfo *outInfo = *outQueue.begin();
+            OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
+            int64_t timeUs;
+            CHECK((*mEncodedFrames.begin())->meta()->findInt64("timeUs", &timeUs));
+            outHeader->nTimeStamp = timeUs;
+            outHeader->nOffset = 0;
+            outHeader->nFilledLen = 0;
+            outHeader->nFlags = 0;
+
+            while (!mEncodedFrames.empty()) {
+                const sp<ABuffer> &frame = *mEncodedFrames.begin();
+                if (frame->size() > outHeader->nAllocLen - outHeader->nFilledLen) {
+                    if (outHeader->nFilledLen > 0) {
+                        break;
+                    }
+                    ALOGE(" not enough space left to write encoded data, dropping %zu bytes",
+                            frame->size());
+                } else {
+                    memcpy(outHeader->pBuffer + outHeader->nFilledLen,
+                            frame->data(), frame->size());
+                    outHeader->nFilledLen += frame->size();
+                }
+                mEncodedFrames.erase(mEncodedFrames.begin());
+            }
+
+            if (outHeader->nFilledLen == 0) {
+                continue;
+            }
+
+            outInfo->mOwnedByUs = false;
+            outQueue.erase(outQueue.begin());
+            notifyFillBufferDone(outHeader);
+        }
+
+        if (!mEncodedFrames.empty()) {
+            // wait for output buffers before encoding more
+            return;
+        }
+
+        if (mSawInputEOS) {
+            if (outQueue.empty()) {
+                return;
+            }
+
+            BufferInfo *outInfo = *outQueue.begin();
+            OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+            outHeader->nFilledLen = 0;
+            outHeader->nFlags = OMX_BUFFERFLAG_EOS;
+
+            outQueue.erase(outQueue.begin());
+            outInfo->mOwnedByUs = false;
+            notifyFillBufferDone(outHeader);
+
+            mSawInputEOS = false;
+            return;
+        }
+
+        if (inQueue.empty()) {
+            return;
+        }
+
+        BufferInfo *inInfo = *inQueue.begin();
+        OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
+
+        if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
+            inQueue.erase(inQueue.begin());
+            inInfo->mOwnedByUs = false;
+            notifyEmptyBufferDone(inHeader);
+
+            // flush the blocks the encoders still hold, and the last one
+            encodeBatch(true /* last */);
+            if (mSignalledError) {
+                return;
+            }
+            mSawInputEOS = true;
+            continue;
+        }
+
+        if (inHeader->nFilledLen > kMaxInputBufferSize) {
+            ALOGE("input buffer too large (%ld).", inHeader->nFilledLen);
+            mSignalledError = true;
+            notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+            return;
+        }
+
+        const size_t nbInputFrames = inHeader->nFilledLen / (2 * mNumChannels);
+        const size_t batchCapacity = mWorkers.size() * mBlockSize;
+
+        if (!mStartTimeValid) {
+            mStartTimeUs = inHeader->nTimeStamp
+                    + (OMX_TICKS)mInputFramesConsumed * 1000000ll / mSampleRate;
+            mStartTimeValid = true;
+        }
+
+        size_t n = nbInputFrames - mInputFramesConsumed;
+        if (n > batchCapacity - mBatchFrames) {
+            n = batchCapacity - mBatchFrames;
+        }
+
+        const OMX_S16 * const pcm16 =
+                reinterpret_cast<OMX_S16 *>(inHeader->pBuffer + inHeader->nOffset)
+                + mInputFramesConsumed * mNumChannels;
+        FLAC__int32 *pcm32 = mBatchPcm32 + mBatchFrames * mNumChannels;
+        for (size_t i = 0; i < n * mNumChannels; i++) {
+            pcm32[i] = (FLAC__int32) pcm16[i];
+        }
+        mBatchFrames += n;
+        mInputFramesConsumed += n;
+
+        if (mInputFramesConsumed == nbInputFrames) {
+            mInputFramesConsumed = 0;
+
+            inInfo->mOwnedByUs = false;
+            inQueue.erase(inQueue.begin());
+            notifyEmptyBufferDone(inHeader);
+        }
+
+        if (mBatchFrames == batchCapacity) {
+            encodeBatch(false /* last */);
+            if (mSignalledError) {
+                return;
+            }
+        }
+    }
+}
+
+void SoftFlacEncoder::encodeBatch(bool last) {
+    ALOGV("encoding a batch of %zu samples per channel%s",
+            mBatchFrames, last ? " (last)" : "");
+
+    mBatchIsLast = last;
+    SoftOMXWorkerPool::Get()->run(EncodeWorkerBlock, this, mWorkers.size());
+
+    // each encoder returns its frames in order, sort them across encoders
+    KeyedVector<int32_t, sp<ABuffer> > frames;
+    bool ok = true;
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        FlacWorker *worker = mWorkers[i];
+        ok = ok && worker->mOk;
+        for (size_t j = 0; j < worker->mFrames.size(); ++j) {
+            int32_t number;
+            CHECK(worker->mFrames[j]->meta()->findInt32("frame", &number));
+            frames.add(number, worker->mFrames[j]);
+        }
+        worker->mFrames.clear();
+    }
+
+    for (size_t i = 0; i < frames.size(); ++i) {
+        const sp<ABuffer> &frame = frames.valueAt(i);
+        frame->meta()->setInt64("timeUs", mStartTimeUs
+                + (int64_t)frames.keyAt(i) * mBlockSize * 1000000ll / mSampleRate);
+        mEncodedFrames.push_back(frame);
+    }
+
+    mBatchFrames = 0;
+
+    if (last) {
+        // finish() left the encoders uninitialized, start a new stream
+        for (size_t i = 0; ok && i < mWorkers.size(); ++i) {
+            ok = setUpFlacEncoder(mWorkers[i]->mEncoder, flacWorkerWriteCallback, mWorkers[i]);
+        }
+        mStartTimeValid = false;
+    }
+
+    if (!ok) {
+        ALOGE(" error encountered during encoding");
+        mSignalledError = true;
+        notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+    }
+}
+
+// static
+void SoftFlacEncoder::EncodeWorkerBlock(void *cookie, size_t index) {
+    static_cast<SoftFlacEncoder *>(cookie)->encodeWorkerBlock(index);
+}
+
+void SoftFlacEncoder::encodeWorkerBlock(size_t index) {
+    FlacWorker *worker = mWorkers[index];
+    size_t first = index * mBlockSize;
+
+    worker->mOk = true;
+    if (first < mBatchFrames) {
+        size_t n = mBatchFrames - first;
+        if (n > mBlockSize) {
+            n = mBlockSize;
+        }
+        worker->mOk = FLAC__stream_encoder_process_interleaved(
+                worker->mEncoder, mBatchPcm32 + first * mNumChannels, n);
+    }
+
+    if (mBatchIsLast) {
+        worker->mOk = FLAC__stream_encoder_finish(worker->mEncoder) && worker->mOk;
+    }
+}
+
+// static
+FLAC__StreamEncoderWriteStatus SoftFlacEncoder::flacWorkerWriteCallback(
+            const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[],
+            size_t bytes, unsigned samples, unsigned current_frame, void *client_data) {
+    FlacWorker *worker = (FlacWorker *) client_data;
+
+    if (samples == 0) {
+        // stream header, which this component does not write
+        return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+    }
+
+    sp<ABuffer> frame = worker->mOwner->renumberFrame(buffer, bytes,
+            current_frame * worker->mOwner->mWorkers.size() + worker->mIndex);
+    if (frame == NULL) {
+        ALOGE("unexpected frame header from encoder %zu", worker->mIndex);
+        return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+    }
+
+    worker->mFrames.push(frame);
+    return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+sp<ABuffer> SoftFlacEncoder::renumberFrame(
+        const FLAC__byte *frame, size_t size, uint32_t number) const {
+    // sync code with fixed block size, then the block size, sample rate,
+    // channel assignment and sample size codes
+    if (size < 7 || frame[0] != 0xff || frame[1] != 0xf8) {
+        return NULL;
+    }
+
+    // the frame number is UTF-8 coded
+    size_t oldLength = 1;
+    if (frame[4] & 0x80) {
+        for (oldLength = 0; oldLength < 8 && (frame[4] & (0x80 >> oldLength)); ++oldLength) {
+        }
+        if (oldLength < 2 || oldLength > 6) {
+            return NULL;
+        }
+    }
+
+    // followed by the block size and sample rate when they have no code
+    unsigned blockSizeCode = frame[2] >> 4;
+    unsigned sampleRateCode = frame[2] & 0x0f;
+    size_t extraLength = (blockSizeCode == 6) ? 1 : (blockSizeCode == 7) ? 2 : 0;
+    extraLength += (sampleRateCode == 12) ? 1
+            : (sampleRateCode == 13 || sampleRateCode == 14) ? 2 : 0;
+
+    // and by the CRC-8 of the header, the CRC-16 of the frame ends it
+    if (4 + oldLength + extraLength + 1 + 2 > size) {
+        return NULL;
+    }
+
+    uint8_t coded[6];
+    size_t newLength = 1;
+    if (number < 0x80) {
+        coded[0] = number;
+    } else {
+        uint32_t value = number;
+        newLength = (value < 0x800) ? 2 : (value < 0x10000) ? 3
+                : (value < 0x200000) ? 4 : (value < 0x4000000) ? 5 : 6;
+        for (size_t i = newLength - 1; i > 0; --i) {
+            coded[i] = 0x80 | (value & 0x3f);
+            value >>= 6;
+        }
+        coded[0] = ((0xff00 >> newLength) & 0xff) | value;
+    }
+
+    size_t newSize = size - oldLength + newLength;
+    sp<ABuffer> out = new ABuffer(newSize);
+    uint8_t *dst = out->data();
+
+    memcpy(dst, frame, 4);
+    memcpy(dst + 4, coded, newLength);
+    memcpy(dst + 4 + newLength, frame + 4 + oldLength, size - 4 - oldLength - 2);
+
+    size_t headerLength = 4 + newLength + extraLength;
+    uint8_t crc8 = 0;
+    for (size_t i = 0; i < headerLength; ++i) {
+        crc8 ^= dst[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc8 = (crc8 & 0x80) ? (crc8 << 1) ^ 0x07 : (crc8 << 1);
+        }
+    }
+    dst[headerLength] = crc8;
+
+    uint16_t crc16 = 0;
+    for (size_t i = 0; i < newSize - 2; ++i) {
+        crc16 = (crc16 << 8) ^ mCrc16Table[(crc16 >> 8) ^ dst[i]];
+    }
+    dst[newSize - 2] = crc16 >> 8;
+    dst[newSize - 1] = crc16 & 0xff;
+
+    out->meta()->setInt32("frame", number);
+    return out;
+}
+
 }  // namespace android
 
 
@@ -20,6 +20,10 @@
 
 #include "SimpleSoftOMXComponent.h"
 
+#include <media/stagefright/foundation/ABuffer.h>
+#include <utils/List.h>
+#include <utils/Vector.h>
+
 #include "FLAC/stream_encoder.h"
 
 // use this symbol to have the first output buffer start with FLAC frame header so a dump of
@@ -46,6 +50,11 @@ protected:
             OMX_INDEXTYPE index, const OMX_PTR params);
 
     virtual void onQueueFilled(OMX_U32 portIndex);
+    virtual void onPortFlushCompleted(OMX_U32 portIndex);
+    virtual void onReset();
+
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
 
 private:
 
@@ -54,6 +63,22 @@ private:
         kMaxNumSamplesPerFrame = 1152,
         kMaxInputBufferSize = kMaxNumSamplesPerFrame * sizeof(int16_t) * 2,
         kMaxOutputBufferSize = 65536,    //TODO check if this can be reduced
+        // above this rate, automatic threading encodes frames in parallel
+        kMinAutoParallelSampleRate = 48000,
+    };
+
+    enum {
+        kEncoderThreadsExtensionIndex = OMX_IndexVendorStartUnused + 1,
+    };
+
+    // One of the stream encoders of the frame-parallel mode. Worker k
+    // encodes blocks k, k + N, k + 2N... of the stream.
+    struct FlacWorker {
+        SoftFlacEncoder *mOwner;
+        size_t mIndex;
+        FLAC__StreamEncoder *mEncoder;
+        Vector<sp<ABuffer> > mFrames;   // emitted during the current batch
+        bool mOk;
     };
 
     bool mSignalledError;
@@ -70,9 +95,42 @@ private:
 
     FLAC__StreamEncoder* mFlacStreamEncoder;
 
+    // frame-parallel mode, used when mWorkers is not empty
+    OMX_U32 mNumThreads;    // 0 (default) for automatic, 1 for the single encoder
+    bool mWorkersChecked;
+    Vector<FlacWorker *> mWorkers;
+    unsigned mBlockSize;
+    FLAC__int32 *mBatchPcm32;   // mWorkers.size() blocks of input
+    size_t mBatchFrames;
+    bool mBatchIsLast;
+    size_t mInputFramesConsumed;    // of the buffer at the head of the input queue
+    bool mStartTimeValid;
+    OMX_TICKS mStartTimeUs;
+    bool mSawInputEOS;
+    List<sp<ABuffer> > mEncodedFrames;  // in stream order, waiting for output buffers
+    uint16_t mCrc16Table[256];
+
     void initPorts();
 
     OMX_ERRORTYPE configureEncoder();
+    bool setUpFlacEncoder(FLAC__StreamEncoder *encoder,
+            FLAC__StreamEncoderWriteCallback writeCallback, void *clientData);
+
+    void setUpWorkers();
+    void releaseWorkers();
+    void resetWorkers();
+    void onQueueFilledParallel();
+    void encodeBatch(bool last);
+    void encodeWorkerBlock(size_t index);
+    static void EncodeWorkerBlock(void *cookie, size_t index);
+
+    static FLAC__StreamEncoderWriteStatus flacWorkerWriteCallback(
+            const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[],
+            size_t bytes, unsigned samples, unsigned current_frame, void *client_data);
+
+    // copy of a frame with its header rewritten for frame "number"
+    sp<ABuffer> renumberFrame(
+            const FLAC__byte *frame, size_t size, uint32_t number) const;
 
     // FLAC encoder callbacks
     // maps to encoderEncodeFlac()
@@ -49,6 +49,19 @@ SoftG711::SoftG711(
         CHECK(!strcmp(name, "OMX.google.g711.mlaw.decoder"));
     }
 
+    // Every input byte value maps to one sample, so decode all 256 of them
+    // once and expand the stream with table lookups.
+    uint8_t codes[256];
+    for (size_t i = 0; i < 256; ++i) {
+        codes[i] = i;
+    }
+
+    if (mIsMLaw) {
+        DecodeMLaw(mTable, codes, 256);
+    } else {
+        DecodeALaw(mTable, codes, 256);
+    }
+
     initPorts();
 }
 
@@ -220,15 +233,9 @@ void SoftG711::onQueueFilled(OMX_U32 portIndex) {
 
         const uint8_t *inputptr = inHeader->pBuffer + inHeader->nOffset;
 
-        if (mIsMLaw) {
-            DecodeMLaw(
-                    reinterpret_cast<int16_t *>(outHeader->pBuffer),
-                    inputptr, inHeader->nFilledLen);
-        } else {
-            DecodeALaw(
-                    reinterpret_cast<int16_t *>(outHeader->pBuffer),
-                    inputptr, inHeader->nFilledLen);
-        }
+        Expand(mTable,
+                reinterpret_cast<int16_t *>(outHeader->pBuffer),
+                inputptr, inHeader->nFilledLen);
 
         outHeader->nTimeStamp = inHeader->nTimeStamp;
         outHeader->nOffset = 0;
@@ -249,6 +256,31 @@ void SoftG711::onQueueFilled(OMX_U32 portIndex) {
     }
 }
 
+// static
+void SoftG711::Expand(
+        const int16_t *table, int16_t *out, const uint8_t *in, size_t inSize) {
+    // 4 independent lookups per iteration keep the loads in flight.
+    while (inSize >= 4) {
+        int16_t s0 = table[in[0]];
+        int16_t s1 = table[in[1]];
+        int16_t s2 = table[in[2]];
+        int16_t s3 = table[in[3]];
+
+        out[0] = s0;
+        out[1] = s1;
+        out[2] = s2;
+        out[3] = s3;
+
+        in += 4;
+        out += 4;
+        inSize -= 4;
+    }
+
+    while (inSize-- > 0) {
+        *out++ = table[*in++];
+    }
+}
+
 // static
 void SoftG711::DecodeALaw(
         int16_t *out, const uint8_t *in, size_t inSize) {
@@ -48,9 +48,13 @@ private:
     bool mIsMLaw;
     OMX_U32 mNumChannels;
     bool mSignalledError;
+    int16_t mTable[256];  // sample for each A-law or mu-law code
 
     void initPorts();
 
+    static void Expand(
+            const int16_t *table, int16_t *out, const uint8_t *in, size_t inSize);
+
     static void DecodeALaw(int16_t *out, const uint8_t *in, size_t inSize);
     static void DecodeMLaw(int16_t *out, const uint8_t *in, size_t inSize);
 
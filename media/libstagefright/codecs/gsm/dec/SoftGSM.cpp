@@ -201,7 +201,8 @@ void SoftGSM::onQueueFilled(OMX_U32 portIndex) {
             return;
         }
 
-        if (inHeader->nFilledLen > kMaxNumSamplesPerFrame) {
+        // every 65 bytes hold 2 frames that decode to 320 samples
+        if ((inHeader->nFilledLen / 65) * 320 > kMaxNumSamplesPerFrame) {
             ALOGE("input buffer too large (%ld).", inHeader->nFilledLen);
             notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
             mSignalledError = true;
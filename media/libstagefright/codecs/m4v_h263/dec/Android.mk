@@ -46,6 +46,14 @@ LOCAL_C_INCLUDES := \
 
 LOCAL_CFLAGS := -DOSCL_EXPORT_REF= -DOSCL_IMPORT_REF=
 
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_ARM_NEON := true
+    LOCAL_SRC_FILES += \
+        src/block_idct_neon.cpp \
+        src/get_pred_adv_b_add_neon.cpp
+    LOCAL_CFLAGS += -DM4VDEC_NEON
+endif
+
 include $(BUILD_STATIC_LIBRARY)
 
 ################################################################################
@@ -256,10 +256,13 @@ void BlockIDCT_intra(
     int16 *coeff_in = mblock->block[comp];
 #ifdef INTEGER_IDCT
 #ifdef FAST_IDCT  /* VCA IDCT using nzcoefs and bitmaps*/
-    int i, bmapr;
+    int bmapr;
     int nz_coefs = mblock->no_coeff[comp];
+#ifndef M4VDEC_NEON
+    int i;
     uint8 *bitmapcol = mblock->bitmapcol[comp];
     uint8 bitmaprow = mblock->bitmaprow[comp];
+#endif
 
     /*----------------------------------------------------------------------------
     ; Function body here
@@ -275,6 +278,13 @@ void BlockIDCT_intra(
 
         (*idctrowVCA_intra[nz_coefs-1])(coeff_in, c_comp, width);
     }
+#ifdef M4VDEC_NEON
+    else
+    {
+        /* the whole block at once is faster than the column by column code */
+        idct_8x8_intra_NEON(coeff_in, c_comp, width);
+    }
+#else
     else
     {
         i = 8;
@@ -303,6 +313,7 @@ void BlockIDCT_intra(
             idctrow_intra(coeff_in, c_comp, width);
         }
     }
+#endif
 #else
     void idct_intra(int *block, uint8 *comp, int width);
     idct_intra(coeff_in, c_comp, width);
@@ -357,7 +368,10 @@ void BlockIDCT(
 {
 #ifdef INTEGER_IDCT
 #ifdef FAST_IDCT  /* VCA IDCT using nzcoefs and bitmaps*/
-    int i, bmapr;
+    int bmapr;
+#ifndef M4VDEC_NEON
+    int i;
+#endif
     /*----------------------------------------------------------------------------
     ; Function body here
     ----------------------------------------------------------------------------*/
@@ -372,6 +386,14 @@ void BlockIDCT(
         (*idctrowVCA[nz_coefs-1])(coeff_in, pred, dst, width);
         return ;
     }
+#ifdef M4VDEC_NEON
+    else
+    {
+        /* the whole block at once is faster than the column by column code */
+        idct_8x8_NEON(coeff_in, pred, dst, width);
+        return ;
+    }
+#else
     else
     {
         i = 8;
@@ -401,6 +423,7 @@ void BlockIDCT(
         }
         return ;
     }
+#endif
 #else // FAST_IDCT
     void idct(int *block, uint8 *pred, uint8 *dst, int width);
     idct(coeff_in, pred, dst, width);
@@ -0,0 +1,205 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "mp4def.h"
+#include "idct.h"
+
+#include <arm_neon.h>
+
+/* NEON versions of the full 8x8 IDCT of block_idct.cpp, idctcol() on the
+   8 columns then idctrow() or idctrow_intra() on the 8 rows. They are used
+   for the blocks with more than 10 coefficients, with the same 32-bit
+   arithmetic so that the output is identical. Like the C version, the
+   coefficients are cleared on return. */
+
+typedef struct
+{
+    int16x8_t val[8];
+} int16x8x8_t;
+
+static inline void transpose_8x8(int16x8x8_t *m)
+{
+    int16x8x2_t t0 = vtrnq_s16(m->val[0], m->val[1]);
+    int16x8x2_t t1 = vtrnq_s16(m->val[2], m->val[3]);
+    int16x8x2_t t2 = vtrnq_s16(m->val[4], m->val[5]);
+    int16x8x2_t t3 = vtrnq_s16(m->val[6], m->val[7]);
+
+    int32x4x2_t u0 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[0]), vreinterpretq_s32_s16(t1.val[0]));
+    int32x4x2_t u1 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[1]), vreinterpretq_s32_s16(t1.val[1]));
+    int32x4x2_t u2 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[0]), vreinterpretq_s32_s16(t3.val[0]));
+    int32x4x2_t u3 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[1]), vreinterpretq_s32_s16(t3.val[1]));
+
+    m->val[0] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[0]), vget_low_s32(u2.val[0])));
+    m->val[1] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[0]), vget_low_s32(u3.val[0])));
+    m->val[2] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[1]), vget_low_s32(u2.val[1])));
+    m->val[3] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[1]), vget_low_s32(u3.val[1])));
+    m->val[4] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[0]), vget_high_s32(u2.val[0])));
+    m->val[5] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[0]), vget_high_s32(u3.val[0])));
+    m->val[6] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[1]), vget_high_s32(u2.val[1])));
+    m->val[7] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[1]), vget_high_s32(u3.val[1])));
+}
+
+/* one 8-point IDCT on 4 lanes, x[] in input order on entry and in output
+   order on return. The column version (row == 0) is idctcol(), the row
+   version rounds after the first and second stages like idctrow(). */
+static inline void idct_1d(int32x4_t *x, int row)
+{
+    int32x4_t x0, x1, x2, x3, x4, x5, x6, x7, x8;
+    int32x4_t round = vdupq_n_s32(row ? 4 : 0);
+
+    if (row)
+    {
+        x0 = vaddq_s32(vshlq_n_s32(x[0], 8), vdupq_n_s32(8192));
+        x1 = vshlq_n_s32(x[4], 8);
+    }
+    else
+    {
+        x0 = vaddq_s32(vshlq_n_s32(x[0], 11), vdupq_n_s32(128));
+        x1 = vshlq_n_s32(x[4], 11);
+    }
+    x2 = x[6];
+    x3 = x[2];
+    x4 = x[1];
+    x5 = x[7];
+    x6 = x[5];
+    x7 = x[3];
+
+    /* first stage */
+    x8 = vmlaq_n_s32(round, vaddq_s32(x4, x5), W7);
+    x4 = vmlaq_n_s32(x8, x4, W1 - W7);
+    x5 = vmlsq_n_s32(x8, x5, W1 + W7);
+    x8 = vmlaq_n_s32(round, vaddq_s32(x6, x7), W3);
+    x6 = vmlsq_n_s32(x8, x6, W3 - W5);
+    x7 = vmlsq_n_s32(x8, x7, W3 + W5);
+    if (row)
+    {
+        x4 = vshrq_n_s32(x4, 3);
+        x5 = vshrq_n_s32(x5, 3);
+        x6 = vshrq_n_s32(x6, 3);
+        x7 = vshrq_n_s32(x7, 3);
+    }
+
+    /* second stage */
+    x8 = vaddq_s32(x0, x1);
+    x0 = vsubq_s32(x0, x1);
+    x1 = vmlaq_n_s32(round, vaddq_s32(x3, x2), W6);
+    x2 = vmlsq_n_s32(x1, x2, W2 + W6);
+    x3 = vmlaq_n_s32(x1, x3, W2 - W6);
+    if (row)
+    {
+        x2 = vshrq_n_s32(x2, 3);
+        x3 = vshrq_n_s32(x3, 3);
+    }
+    x1 = vaddq_s32(x4, x6);
+    x4 = vsubq_s32(x4, x6);
+    x6 = vaddq_s32(x5, x7);
+    x5 = vsubq_s32(x5, x7);
+
+    /* third stage */
+    x7 = vaddq_s32(x8, x3);
+    x8 = vsubq_s32(x8, x3);
+    x3 = vaddq_s32(x0, x2);
+    x0 = vsubq_s32(x0, x2);
+    x2 = vshrq_n_s32(vmlaq_n_s32(vdupq_n_s32(128), vaddq_s32(x4, x5), 181), 8);
+    x4 = vshrq_n_s32(vmlaq_n_s32(vdupq_n_s32(128), vsubq_s32(x4, x5), 181), 8);
+
+    /* fourth stage, without the final shift */
+    x[0] = vaddq_s32(x7, x1);
+    x[1] = vaddq_s32(x3, x2);
+    x[2] = vaddq_s32(x0, x4);
+    x[3] = vaddq_s32(x8, x6);
+    x[4] = vsubq_s32(x8, x6);
+    x[5] = vsubq_s32(x0, x4);
+    x[6] = vsubq_s32(x3, x2);
+    x[7] = vsubq_s32(x7, x1);
+}
+
+/* 2-D IDCT of blk into m, one row of 16-bit results per vector, then clear
+   blk. The row results are (x >> 14) saturated to 16 bits, which clips to
+   the same pixel values. */
+static inline void idct_8x8(int16 *blk, int16x8x8_t *m)
+{
+    int32x4_t lo[8], hi[8];
+    int i;
+
+    /* columns, one vector per row of coefficients */
+    for (i = 0; i < 8; i++)
+    {
+        int16x8_t c = vld1q_s16(blk + (i << 3));
+        lo[i] = vmovl_s16(vget_low_s16(c));
+        hi[i] = vmovl_s16(vget_high_s16(c));
+        vst1q_s16(blk + (i << 3), vdupq_n_s16(0));
+    }
+
+    idct_1d(lo, 0);
+    idct_1d(hi, 0);
+
+    for (i = 0; i < 8; i++)
+    {
+        m->val[i] = vcombine_s16(vmovn_s32(vshrq_n_s32(lo[i], 8)),
+                                 vmovn_s32(vshrq_n_s32(hi[i], 8)));
+    }
+
+    /* rows */
+    transpose_8x8(m);
+
+    for (i = 0; i < 8; i++)
+    {
+        lo[i] = vmovl_s16(vget_low_s16(m->val[i]));
+        hi[i] = vmovl_s16(vget_high_s16(m->val[i]));
+    }
+
+    idct_1d(lo, 1);
+    idct_1d(hi, 1);
+
+    for (i = 0; i < 8; i++)
+    {
+        m->val[i] = vcombine_s16(vqshrn_n_s32(lo[i], 14), vqshrn_n_s32(hi[i], 14));
+    }
+
+    transpose_8x8(m);
+}
+
+void idct_8x8_NEON(int16 *blk, uint8 *pred, uint8 *dst, int width)
+{
+    int16x8x8_t m;
+    int i;
+
+    idct_8x8(blk, &m);
+
+    for (i = 0; i < 8; i++)
+    {
+        int16x8_t sum = vqaddq_s16(m.val[i], vreinterpretq_s16_u16(vmovl_u8(vld1_u8(pred))));
+        vst1_u8(dst, vqmovun_s16(sum));
+        pred += 16;
+        dst += width;
+    }
+}
+
+void idct_8x8_intra_NEON(int16 *blk, PIXEL *comp, int width)
+{
+    int16x8x8_t m;
+    int i;
+
+    idct_8x8(blk, &m);
+
+    for (i = 0; i < 8; i++)
+    {
+        vst1_u8(comp, vqmovun_s16(m.val[i]));
+        comp += width;
+    }
+}
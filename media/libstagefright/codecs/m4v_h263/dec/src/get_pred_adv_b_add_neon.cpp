@@ -0,0 +1,148 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "mp4dec_lib.h"
+#include "motion_comp.h"
+
+#include <arm_neon.h>
+
+/* NEON versions of the GetPredAdvancedBy*() functions in
+   get_pred_adv_b_add.cpp. pred_width_rnd is the pitch of pred_block times
+   2 plus rnd1, which is 1 to round the half-pel averages up and 0 to round
+   them down. No alignment is needed so there is a single code path for all
+   positions of prev, and no more than the 9x9 pixels used are read. */
+
+int GetPredAdvancedBy0x0_NEON(
+    uint8 *prev,        /* i */
+    uint8 *pred_block,      /* i */
+    int width,      /* i */
+    int pred_width_rnd /* i */
+)
+{
+    int i;
+    int pred_width = pred_width_rnd >> 1;
+
+    for (i = 0; i < B_SIZE; i++)
+    {
+        vst1_u8(pred_block, vld1_u8(prev));
+        prev += width;
+        pred_block += pred_width;
+    }
+
+    return 1;
+}
+
+int GetPredAdvancedBy0x1_NEON(
+    uint8 *prev,        /* i */
+    uint8 *pred_block,      /* i */
+    int width,      /* i */
+    int pred_width_rnd /* i */
+)
+{
+    int i;
+    int pred_width = pred_width_rnd >> 1;
+
+    if (pred_width_rnd & 1)
+    {
+        for (i = 0; i < B_SIZE; i++)
+        {
+            vst1_u8(pred_block, vrhadd_u8(vld1_u8(prev), vld1_u8(prev + 1)));
+            prev += width;
+            pred_block += pred_width;
+        }
+    }
+    else
+    {
+        for (i = 0; i < B_SIZE; i++)
+        {
+            vst1_u8(pred_block, vhadd_u8(vld1_u8(prev), vld1_u8(prev + 1)));
+            prev += width;
+            pred_block += pred_width;
+        }
+    }
+
+    return 1;
+}
+
+int GetPredAdvancedBy1x0_NEON(
+    uint8 *prev,        /* i */
+    uint8 *pred_block,      /* i */
+    int width,      /* i */
+    int pred_width_rnd /* i */
+)
+{
+    int i;
+    int pred_width = pred_width_rnd >> 1;
+    uint8x8_t top, bottom;
+
+    top = vld1_u8(prev);
+
+    if (pred_width_rnd & 1)
+    {
+        for (i = 0; i < B_SIZE; i++)
+        {
+            prev += width;
+            bottom = vld1_u8(prev);
+            vst1_u8(pred_block, vrhadd_u8(top, bottom));
+            top = bottom;
+            pred_block += pred_width;
+        }
+    }
+    else
+    {
+        for (i = 0; i < B_SIZE; i++)
+        {
+            prev += width;
+            bottom = vld1_u8(prev);
+            vst1_u8(pred_block, vhadd_u8(top, bottom));
+            top = bottom;
+            pred_block += pred_width;
+        }
+    }
+
+    return 1;
+}
+
+int GetPredAdvancedBy1x1_NEON(
+    uint8 *prev,        /* i */
+    uint8 *pred_block,      /* i */
+    int width,      /* i */
+    int pred_width_rnd /* i */
+)
+{
+    int i;
+    int pred_width = pred_width_rnd >> 1;
+    uint16x8_t top, bottom;
+    uint16x8_t rnd2 = vdupq_n_u16((pred_width_rnd & 1) + 1);
+
+    /* sum of each pixel and its right neighbor */
+    top = vaddl_u8(vld1_u8(prev), vld1_u8(prev + 1));
+
+    for (i = 0; i < B_SIZE; i++)
+    {
+        prev += width;
+        bottom = vaddl_u8(vld1_u8(prev), vld1_u8(prev + 1));
+
+        /* (a + b + c + d + rnd1 + 1) >> 2 */
+        vst1_u8(pred_block, vshrn_n_u16(vaddq_u16(vaddq_u16(top, bottom), rnd2), 2));
+
+        top = bottom;
+        pred_block += pred_width;
+    }
+
+    return 1;
+}
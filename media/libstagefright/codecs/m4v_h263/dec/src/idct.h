@@ -61,6 +61,11 @@ extern "C"
     void idctrow2_intra(int16 *blk, PIXEL *comp, int width);
     void idctrow3_intra(int16 *blk, PIXEL *comp, int width);
     void idctrow4_intra(int16 *blk, PIXEL *comp, int width);
+#ifdef M4VDEC_NEON
+    /* defined in block_idct_neon.cpp */
+    void idct_8x8_NEON(int16 *blk, uint8 *pred, uint8 *dst, int width);
+    void idct_8x8_intra_NEON(int16 *blk, PIXEL *comp, int width);
+#endif
 #ifdef __cplusplus
 }
 #endif
@@ -242,6 +242,14 @@ extern "C"
         int pred_width_rnd /* i */
     );
 
+#ifdef M4VDEC_NEON
+    /* defined in get_pred_adv_b_add_neon.cpp */
+    int GetPredAdvancedBy0x0_NEON(uint8 *c_prev, uint8 *pred_block, int width, int pred_width_rnd);
+    int GetPredAdvancedBy0x1_NEON(uint8 *c_prev, uint8 *pred_block, int width, int pred_width_rnd);
+    int GetPredAdvancedBy1x0_NEON(uint8 *c_prev, uint8 *pred_block, int width, int pred_width_rnd);
+    int GetPredAdvancedBy1x1_NEON(uint8 *c_prev, uint8 *pred_block, int width, int pred_width_rnd);
+#endif
+
     /*--------------------------------------------------------------------------*/
     /* defined in get_pred_outside.c */
     int GetPredOutside(
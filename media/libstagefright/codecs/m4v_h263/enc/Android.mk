@@ -27,6 +27,14 @@ LOCAL_CFLAGS := \
     -DBX_RC \
     -DOSCL_IMPORT_REF= -DOSCL_UNUSED_ARG= -DOSCL_EXPORT_REF=
 
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_ARM_NEON := true
+    LOCAL_SRC_FILES += \
+        src/dct_neon.cpp \
+        src/motion_comp_neon.cpp
+    LOCAL_CFLAGS += -DM4VENC_NEON
+endif
+
 LOCAL_C_INCLUDES := \
     $(LOCAL_PATH)/src \
     $(LOCAL_PATH)/include \
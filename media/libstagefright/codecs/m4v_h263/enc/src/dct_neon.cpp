@@ -0,0 +1,226 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "mp4enc_lib.h"
+#include "mp4lib_int.h"
+
+#include <arm_neon.h>
+
+/* NEON versions of BlockDCT_AANwSub() and BlockDCT_AANIntra() in dct.cpp.
+   The 8 rows (then the 8 columns) are transformed at the same time, one
+   vector per input position, with the same 32-bit arithmetic as the C
+   code so that the output is identical, including the deadzone marking
+   of the columns below ColTh. */
+
+#define FDCT_SHIFT 10
+
+typedef struct
+{
+    int16x8_t val[8];
+} int16x8x8_t;
+
+static inline void transpose_8x8(int16x8x8_t *m)
+{
+    int16x8x2_t t0 = vtrnq_s16(m->val[0], m->val[1]);
+    int16x8x2_t t1 = vtrnq_s16(m->val[2], m->val[3]);
+    int16x8x2_t t2 = vtrnq_s16(m->val[4], m->val[5]);
+    int16x8x2_t t3 = vtrnq_s16(m->val[6], m->val[7]);
+
+    int32x4x2_t u0 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[0]), vreinterpretq_s32_s16(t1.val[0]));
+    int32x4x2_t u1 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[1]), vreinterpretq_s32_s16(t1.val[1]));
+    int32x4x2_t u2 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[0]), vreinterpretq_s32_s16(t3.val[0]));
+    int32x4x2_t u3 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[1]), vreinterpretq_s32_s16(t3.val[1]));
+
+    m->val[0] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[0]), vget_low_s32(u2.val[0])));
+    m->val[1] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[0]), vget_low_s32(u3.val[0])));
+    m->val[2] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[1]), vget_low_s32(u2.val[1])));
+    m->val[3] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[1]), vget_low_s32(u3.val[1])));
+    m->val[4] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[0]), vget_high_s32(u2.val[0])));
+    m->val[5] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[0]), vget_high_s32(u3.val[0])));
+    m->val[6] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[1]), vget_high_s32(u2.val[1])));
+    m->val[7] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[1]), vget_high_s32(u3.val[1])));
+}
+
+/* one pass of the scaled AAN DCT on 4 lanes, k[] in input order on entry
+   and in output order on return, same steps as the C version */
+static inline void fdct_1d(int32x4_t *k)
+{
+    int32x4_t round = vdupq_n_s32(1 << (FDCT_SHIFT - 1));
+    int32x4_t k0, k1, k2, k3, k4, k5, k6, k7;
+
+    /* fdct_1 */
+    k0 = vaddq_s32(k[0], k[7]);
+    k7 = vsubq_s32(k[0], k[7]);
+    k1 = vaddq_s32(k[1], k[6]);
+    k6 = vsubq_s32(k[1], k[6]);
+    k2 = vaddq_s32(k[2], k[5]);
+    k5 = vsubq_s32(k[2], k[5]);
+    k3 = vaddq_s32(k[3], k[4]);
+    k4 = vsubq_s32(k[3], k[4]);
+
+    k[3] = k3;
+    k3 = vsubq_s32(k0, k3);
+    k0 = vaddq_s32(k0, k[3]);
+    k[2] = k2;
+    k2 = vsubq_s32(k1, k2);
+    k1 = vaddq_s32(k1, k[2]);
+
+    k[0] = vaddq_s32(k0, k1);
+    k[4] = vsubq_s32(k0, k1);
+
+    /* fdct_2 */
+    k4 = vaddq_s32(k4, k5);
+    k5 = vaddq_s32(k5, k6);
+    k6 = vaddq_s32(k6, k7);
+    k2 = vaddq_s32(k2, k3);
+
+    k5 = vshrq_n_s32(vmlaq_n_s32(round, k5, 724), FDCT_SHIFT);
+    k2 = vshrq_n_s32(vmlaq_n_s32(round, k2, 724), FDCT_SHIFT);
+
+    k2 = vaddq_s32(k2, k3);
+    k3 = vsubq_s32(vshlq_n_s32(k3, 1), k2);
+    k[2] = k2;
+    k[6] = vshlq_n_s32(k3, 1);
+
+    /* fdct_3 */
+    k1 = vmlaq_n_s32(round, vsubq_s32(k4, k6), 392);
+    k0 = vmlaq_n_s32(k1, k4, 554);
+    k1 = vmlaq_n_s32(k1, k6, 1338);
+
+    k4 = vshrq_n_s32(k0, FDCT_SHIFT);
+    k6 = vshrq_n_s32(k1, FDCT_SHIFT);
+
+    k5 = vaddq_s32(k5, k7);
+    k7 = vsubq_s32(vshlq_n_s32(k7, 1), k5);
+    k4 = vaddq_s32(k4, k7);
+    k7 = vsubq_s32(vshlq_n_s32(k7, 1), k4);
+    k5 = vaddq_s32(k5, k6);
+    k6 = vsubq_s32(k5, vshlq_n_s32(k6, 1));
+
+    k[5] = vshlq_n_s32(k4, 1);
+    k[1] = k5;
+    k[7] = vshlq_n_s32(k6, 2);
+    k[3] = k7;
+}
+
+/* 8-point DCT of the 8 vectors, stored as 16 bits like the C version */
+static inline void fdct_8x8_pass(int16x8x8_t *m)
+{
+    int32x4_t lo[8], hi[8];
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        lo[i] = vmovl_s16(vget_low_s16(m->val[i]));
+        hi[i] = vmovl_s16(vget_high_s16(m->val[i]));
+    }
+
+    fdct_1d(lo);
+    fdct_1d(hi);
+
+    for (i = 0; i < 8; i++)
+    {
+        m->val[i] = vcombine_s16(vmovn_s32(lo[i]), vmovn_s32(hi[i]));
+    }
+}
+
+/* the column pass on the transposed row pass output, the columns whose sum
+   of absolute values (see sum_abs() in dct_inline.h) is below ColTh are left
+   as they are with a 0x7fff marker in the first row */
+static void fdct_8x8_columns(Short *out, int16x8x8_t *m, Int ColTh)
+{
+    int16x8x8_t res = *m;
+    int32x4_t sum_lo, sum_hi;
+    int16x8_t sign;
+    uint16x8_t skip;
+    int i;
+
+    /* the first term is not exactly the absolute value in sum_abs() */
+    sign = vshrq_n_s16(m->val[0], 15);
+    sign = veorq_s16(m->val[0], sign);
+    sum_lo = vmovl_s16(vget_low_s16(sign));
+    sum_hi = vmovl_s16(vget_high_s16(sign));
+
+    for (i = 1; i < 8; i++)
+    {
+        int16x8_t a = m->val[i];
+        sum_lo = vaddq_s32(sum_lo, vabsq_s32(vmovl_s16(vget_low_s16(a))));
+        sum_hi = vaddq_s32(sum_hi, vabsq_s32(vmovl_s16(vget_high_s16(a))));
+    }
+
+    skip = vcombine_u16(vmovn_u32(vcltq_s32(sum_lo, vdupq_n_s32(ColTh))),
+                        vmovn_u32(vcltq_s32(sum_hi, vdupq_n_s32(ColTh))));
+
+    fdct_8x8_pass(&res);
+
+    vst1q_s16(out, vbslq_s16(skip, vdupq_n_s16(0x7fff), res.val[0]));
+    for (i = 1; i < 8; i++)
+    {
+        vst1q_s16(out + (i << 3), vbslq_s16(skip, m->val[i], res.val[i]));
+    }
+}
+
+Void BlockDCT_AANwSub_NEON(Short *out, UChar *cur, UChar *pred, Int width)
+{
+    int16x8x8_t m;
+    Int ColTh = out[64];
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        /* (cur << 1) - (pred << 1) */
+        int16x8_t diff = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(cur), vld1_u8(pred)));
+        m.val[i] = vshlq_n_s16(diff, 1);
+        cur += width;
+        pred += 16;
+    }
+
+    /* rows */
+    transpose_8x8(&m);
+    fdct_8x8_pass(&m);
+
+    /* columns */
+    transpose_8x8(&m);
+    fdct_8x8_columns(out + 64, &m, ColTh);
+
+    return ;
+}
+
+Void BlockDCT_AANIntra_NEON(Short *out, UChar *cur, UChar *dummy2, Int width)
+{
+    int16x8x8_t m;
+    Int ColTh = out[64];
+    int i;
+
+    OSCL_UNUSED_ARG(dummy2);
+
+    for (i = 0; i < 8; i++)
+    {
+        m.val[i] = vreinterpretq_s16_u16(vshll_n_u8(vld1_u8(cur), 1));
+        cur += width;
+    }
+
+    /* rows */
+    transpose_8x8(&m);
+    fdct_8x8_pass(&m);
+
+    /* columns */
+    transpose_8x8(&m);
+    fdct_8x8_columns(out + 64, &m, ColTh);
+
+    return ;
+}
@@ -99,7 +99,11 @@ PV_STATUS CodeMB_H263(VideoEncData *video, approxDCT *function, Int QP, Int ncoe
         BlockDCT1x1 = &Block1x1DCTIntra;
         BlockDCT2x2 = &Block2x2DCT_AANIntra;
         BlockDCT4x4 = &Block4x4DCT_AANIntra;
+#ifdef M4VENC_NEON
+        BlockDCT8x8 = &BlockDCT_AANIntra_NEON;
+#else
         BlockDCT8x8 = &BlockDCT_AANIntra;
+#endif
         BlockQuantDequantH263 = &BlockQuantDequantH263Intra;
         BlockQuantDequantH263DC = &BlockQuantDequantH263DCIntra;
         if (shortHeader)
@@ -118,9 +122,15 @@ PV_STATUS CodeMB_H263(VideoEncData *video, approxDCT *function, Int QP, Int ncoe
         BlockDCT1x1 = &Block1x1DCTwSub;
         BlockDCT2x2 = &Block2x2DCT_AANwSub;
         BlockDCT4x4 = &Block4x4DCT_AANwSub;
+#ifdef M4VENC_NEON
+        BlockDCT8x8 = &BlockDCT_AANwSub_NEON;
+
+        BlockQuantDequantH263 = &BlockQuantDequantH263Inter_NEON;
+#else
         BlockDCT8x8 = &BlockDCT_AANwSub;
 
         BlockQuantDequantH263 = &BlockQuantDequantH263Inter;
+#endif
         BlockQuantDequantH263DC = &BlockQuantDequantH263DCInter;
         ColTh = ColThInter[QP];
         DctTh1 = (Int)(16 * QP);  //9*QP;
@@ -324,7 +334,11 @@ PV_STATUS CodeMB_MPEG(VideoEncData *video, approxDCT *function, Int QP, Int ncoe
         BlockDCT1x1 = &Block1x1DCTIntra;
         BlockDCT2x2 = &Block2x2DCT_AANIntra;
         BlockDCT4x4 = &Block4x4DCT_AANIntra;
+#ifdef M4VENC_NEON
+        BlockDCT8x8 = &BlockDCT_AANIntra_NEON;
+#else
         BlockDCT8x8 = &BlockDCT_AANIntra;
+#endif
 
         BlockQuantDequantMPEG = &BlockQuantDequantMPEGIntra;
         BlockQuantDequantMPEGDC = &BlockQuantDequantMPEGDCIntra;
@@ -341,7 +355,11 @@ PV_STATUS CodeMB_MPEG(VideoEncData *video, approxDCT *function, Int QP, Int ncoe
         BlockDCT1x1 = &Block1x1DCTwSub;
         BlockDCT2x2 = &Block2x2DCT_AANwSub;
         BlockDCT4x4 = &Block4x4DCT_AANwSub;
+#ifdef M4VENC_NEON
+        BlockDCT8x8 = &BlockDCT_AANwSub_NEON;
+#else
         BlockDCT8x8 = &BlockDCT_AANwSub;
+#endif
 
         BlockQuantDequantMPEG = &BlockQuantDequantMPEGInter;
         BlockQuantDequantMPEGDC = &BlockQuantDequantMPEGDCInter;
@@ -18,6 +18,10 @@
 #include "mp4enc_lib.h"
 #include "fastquant_inline.h"
 
+#ifdef M4VENC_NEON
+#include <arm_neon.h>
+#endif
+
 #define siz 63
 #define LSL 18
 
@@ -266,6 +270,143 @@ NONZERO1:
         return 0;
 }
 
+#ifdef M4VENC_NEON
+/* NEON version of BlockQuantDequantH263Inter(), with the same output. The
+   coefficients of a row are quantized at once (one lane per column) and
+   only the non-zero results are scattered to qcoeff and the bitmaps.
+   The C version tests whether a coefficient quantizes to zero in two
+   slightly different ways depending on the previous coefficient of the
+   column, they only differ for -QPx2plus, so such blocks are left to it. */
+Int BlockQuantDequantH263Inter_NEON(Short *rcoeff, Short *qcoeff, struct QPstruct *QuantParam,
+                                    UChar bitmapcol[ ], UChar *bitmaprow, UInt *bitmapzz,
+                                    Int dctMode, Int comp, Int dummy, UChar shortHeader)
+{
+    static const UChar lane_bit[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    Int i, j, zz;
+    Int QPdiv2 = QuantParam->QPdiv2;
+    Int QPx2 = QuantParam->QPx2;
+    Int Addition = QuantParam->Addition;
+    Int QPx2plus = (QuantParam->QPx2plus << 4) - 8;
+    Int q_scale = scaleArrayV[QuantParam->QP];
+    Int shift = 15 + (QPx2 >> 4);
+    Int ac_clip = shortHeader ? 126 : 2047;
+    Short *coeff = rcoeff + 64; /* actual data is 64 item ahead */
+    Short q_value[8], dq_value[8];
+    UInt nonzero;
+    Int tmp;
+
+    uint8x8_t bits = vld1_u8(lane_bit), lanes;
+    uint16x8_t valid, nz;
+    int16x8_t c, thr_lo, thr_hi;
+    int32x4_t round = vdupq_n_s32(1 << 15);
+    int32x4_t qp_div2 = vdupq_n_s32(QPdiv2);
+    int32x4_t qp_plus = vdupq_n_s32(QPdiv2 << 1);
+    int32x4_t q_shift = vdupq_n_s32(-shift);
+    int32x4_t clip_max = vdupq_n_s32(ac_clip);
+    int32x4_t clip_min = vdupq_n_s32(-ac_clip - 1);
+    int32x4_t addition = vdupq_n_s32(Addition);
+    int32x4_t t[2], q[2], dq[2];
+    int16x4_t half[2];
+    int k;
+
+    /* the columns to do, dctMode columns whose first row is not 0x7fff */
+    c = vld1q_s16(coeff);
+    valid = vcltq_u16(vmovl_u8(bits), vdupq_n_u16(1 << dctMode));
+    valid = vandq_u16(valid, vmvnq_u16(vceqq_s16(c, vdupq_n_s16(0x7fff))));
+
+    thr_lo = vdupq_n_s16(-QPx2plus);
+    thr_hi = vdupq_n_s16(QPx2plus);
+
+    for (i = 0; i < dctMode; i++)
+    {
+        nz = vandq_u16(valid, vceqq_s16(vld1q_s16(coeff + (i << 3)), thr_lo));
+        if (vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(nz)), 0))
+        {
+            return BlockQuantDequantH263Inter(rcoeff, qcoeff, QuantParam, bitmapcol, bitmaprow,
+                                              bitmapzz, dctMode, comp, dummy, shortHeader);
+        }
+    }
+
+    /* reset all bitmap to zero */
+    ((Int*)bitmapcol)[0] = ((Int*)bitmapcol)[1] = 0;
+    bitmapzz[0] = bitmapzz[1] = 0;
+    *bitmaprow = 0;
+
+    for (i = 0; i < dctMode; i++)
+    {
+        c = vld1q_s16(coeff + (i << 3));
+
+        /* outside of (-QPx2plus, QPx2plus) */
+        nz = vandq_u16(valid, vorrq_u16(vcleq_s16(c, thr_lo), vcgeq_s16(c, thr_hi)));
+        if (vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(nz)), 0) == 0)
+        {
+            continue;
+        }
+
+        half[0] = vget_low_s16(c);
+        half[1] = vget_high_s16(c);
+
+        for (k = 0; k < 2; k++)
+        {
+            /* aan_scale() */
+            t[k] = vmlal_s16(round, half[k], vld1_s16(AANScale + (i << 3) + (k << 2)));
+            t[k] = vshrq_n_s32(t[k], 16);
+            t[k] = vaddq_s32(vsubq_s32(t[k], qp_div2), vandq_s32(vshrq_n_s32(t[k], 31), qp_plus));
+
+            /* coeff_quant() */
+            q[k] = vshlq_s32(vmulq_n_s32(t[k], q_scale), q_shift);
+            q[k] = vsubq_s32(q[k], vshrq_n_s32(q[k], 31));
+
+            /* coeff_clip() */
+            q[k] = vmaxq_s32(vminq_s32(q[k], clip_max), clip_min);
+
+            /* coeff_dequant() */
+            dq[k] = vshrq_n_s32(q[k], 31);
+            dq[k] = vmlaq_n_s32(vsubq_s32(veorq_s32(addition, dq[k]), dq[k]), q[k], QPx2);
+            dq[k] = vmaxq_s32(vminq_s32(dq[k], vdupq_n_s32(2047)), vdupq_n_s32(-2048));
+        }
+
+        vst1q_s16(q_value, vcombine_s16(vmovn_s32(q[0]), vmovn_s32(q[1])));
+        vst1q_s16(dq_value, vcombine_s16(vmovn_s32(dq[0]), vmovn_s32(dq[1])));
+
+        nz = vandq_u16(nz, vmvnq_u16(vceqq_s16(vld1q_s16(q_value), vdupq_n_s16(0))));
+        /* one bit per column */
+        lanes = vand_u8(vmovn_u16(nz), bits);
+        lanes = vpadd_u8(lanes, lanes);
+        lanes = vpadd_u8(lanes, lanes);
+        lanes = vpadd_u8(lanes, lanes);
+        nonzero = vget_lane_u8(lanes, 0);
+
+        for (j = 0; nonzero; j++, nonzero >>= 1)
+        {
+            if (nonzero & 1)
+            {
+                zz = ZZTab[(i << 3) + j] >> 1;  /* zigzag order */
+                qcoeff[zz] = q_value[j];
+                rcoeff[(i << 3) + j] = dq_value[j];
+
+                bitmapcol[j] |= imask[i];
+                if (zz > 31) bitmapzz[1] |= (1 << (63 - zz));
+                else        bitmapzz[0] |= (1 << (31 - zz));
+            }
+        }
+    }
+
+    i = dctMode;
+    tmp = 1 << (8 - i);
+    while (i--)
+    {
+        if (bitmapcol[i])(*bitmaprow) |= tmp;
+        tmp <<= 1;
+    }
+
+    if (*bitmaprow)
+        return 1;
+    else
+        return 0;
+}
+#endif
+
 Int BlockQuantDequantH263Intra(Short *rcoeff, Short *qcoeff, struct QPstruct *QuantParam,
                                UChar bitmapcol[ ], UChar *bitmaprow, UInt *bitmapzz,
                                Int dctMode, Int comp, Int dc_scaler, UChar shortHeader)
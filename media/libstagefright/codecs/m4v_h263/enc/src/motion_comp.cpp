@@ -74,8 +74,13 @@ extern "C"
 
     static Int(*const GetPredAdvBTable[2][2])(UChar*, UChar*, Int, Int) =
     {
+#ifdef M4VENC_NEON
+        {&GetPredAdvBy0x0_NEON, &GetPredAdvBy0x1_NEON},
+        {&GetPredAdvBy1x0_NEON, &GetPredAdvBy1x1_NEON}
+#else
         {&GetPredAdvBy0x0, &GetPredAdvBy0x1},
         {&GetPredAdvBy1x0, &GetPredAdvBy1x1}
+#endif
     };
 
 
@@ -0,0 +1,106 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "mp4enc_lib.h"
+#include "mp4lib_int.h"
+
+#include <arm_neon.h>
+
+/* NEON versions of the GetPredAdvBy*() functions in motion_comp.cpp. They
+   predict one 8x8 block into rec, which has a pitch of 16. rnd1 is 1 to
+   round the half-pel averages up, 0 to round them down. No alignment is
+   needed so there is a single code path for all positions of prev, and
+   no more than the 9x9 pixels used are read. */
+
+Int GetPredAdvBy0x0_NEON(UChar *prev, UChar *rec, Int lx, Int rnd1)
+{
+    Int i;
+
+    OSCL_UNUSED_ARG(rnd1);
+
+    for (i = 0; i < B_SIZE; i++)
+    {
+        vst1_u8(rec, vld1_u8(prev));
+        prev += lx;
+        rec += 16;
+    }
+
+    return 1;
+}
+
+Int GetPredAdvBy0x1_NEON(UChar *prev, UChar *rec, Int lx, Int rnd1)
+{
+    Int i;
+
+    for (i = 0; i < B_SIZE; i++)
+    {
+        if (rnd1)
+            vst1_u8(rec, vrhadd_u8(vld1_u8(prev), vld1_u8(prev + 1)));
+        else
+            vst1_u8(rec, vhadd_u8(vld1_u8(prev), vld1_u8(prev + 1)));
+        prev += lx;
+        rec += 16;
+    }
+
+    return 1;
+}
+
+Int GetPredAdvBy1x0_NEON(UChar *prev, UChar *rec, Int lx, Int rnd1)
+{
+    Int i;
+    uint8x8_t top, bottom;
+
+    top = vld1_u8(prev);
+
+    for (i = 0; i < B_SIZE; i++)
+    {
+        prev += lx;
+        bottom = vld1_u8(prev);
+        if (rnd1)
+            vst1_u8(rec, vrhadd_u8(top, bottom));
+        else
+            vst1_u8(rec, vhadd_u8(top, bottom));
+        top = bottom;
+        rec += 16;
+    }
+
+    return 1;
+}
+
+Int GetPredAdvBy1x1_NEON(UChar *prev, UChar *rec, Int lx, Int rnd1)
+{
+    Int i;
+    uint16x8_t top, bottom;
+    uint16x8_t rnd2 = vdupq_n_u16(rnd1 + 1);
+
+    /* sum of each pixel and its right neighbor */
+    top = vaddl_u8(vld1_u8(prev), vld1_u8(prev + 1));
+
+    for (i = 0; i < B_SIZE; i++)
+    {
+        prev += lx;
+        bottom = vaddl_u8(vld1_u8(prev), vld1_u8(prev + 1));
+
+        /* (a + b + c + d + rnd1 + 1) >> 2 */
+        vst1_u8(rec, vshrn_n_u16(vaddq_u16(vaddq_u16(top, bottom), rnd2), 2));
+
+        top = bottom;
+        rec += 16;
+    }
+
+    return 1;
+}
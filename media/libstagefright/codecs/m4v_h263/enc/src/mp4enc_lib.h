@@ -59,6 +59,11 @@ extern "C"
     void  blockIdct(Short *block);
     void blockIdct_SSE(Short *input);
     void BlockDCTEnc(Short *blockData, Short *blockCoeff);
+#ifdef M4VENC_NEON
+    /* defined in dct_neon.cpp */
+    Void BlockDCT_AANwSub_NEON(Short *out, UChar *cur, UChar *pred, Int width);
+    Void BlockDCT_AANIntra_NEON(Short *out, UChar *cur, UChar *dummy2, Int width);
+#endif
 
     /*---- FastQuant.c -----*/
     Int cal_dc_scalerENC(Int QP, Int type) ;
@@ -66,6 +71,12 @@ extern "C"
                                    UChar bitmapcol[ ], UChar *bitmaprow, UInt *bitmapzz,
                                    Int dctMode, Int comp, Int dummy, UChar shortHeader);
 
+#ifdef M4VENC_NEON
+    Int BlockQuantDequantH263Inter_NEON(Short *rcoeff, Short *qcoeff, struct QPstruct *QuantParam,
+                                        UChar bitmapcol[ ], UChar *bitmaprow, UInt *bitmapzz,
+                                        Int dctMode, Int comp, Int dummy, UChar shortHeader);
+#endif
+
     Int BlockQuantDequantH263Intra(Short *rcoeff, Short *qcoeff, struct QPstruct *QuantParam,
                                    UChar bitmapcol[ ], UChar *bitmaprow, UInt *bitmapzz,
                                    Int dctMode, Int comp, Int dc_scaler, UChar shortHeader);
@@ -113,6 +124,14 @@ extern "C"
 
     void PutSkippedBlock(UChar *rec, UChar *prev, Int lx);
 
+#ifdef M4VENC_NEON
+    /* defined in motion_comp_neon.cpp */
+    Int GetPredAdvBy0x0_NEON(UChar *prev, UChar *rec, Int lx, Int rnd1);
+    Int GetPredAdvBy0x1_NEON(UChar *prev, UChar *rec, Int lx, Int rnd1);
+    Int GetPredAdvBy1x0_NEON(UChar *prev, UChar *rec, Int lx, Int rnd1);
+    Int GetPredAdvBy1x1_NEON(UChar *prev, UChar *rec, Int lx, Int rnd1);
+#endif
+
     /* defined in motion_est.c */
     void MotionEstimation(VideoEncData *video);
 #ifdef HTFM
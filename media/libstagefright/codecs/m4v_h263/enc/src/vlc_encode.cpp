@@ -139,10 +139,10 @@ extern "C"
 {
 #endif
 
-    Int PutCoeff_Inter(Int run, Int level, BitstreamEncVideo *bitstream);
-    Int PutCoeff_Inter_Last(Int run, Int level, BitstreamEncVideo *bitstream);
-    Int PutCoeff_Intra(Int run, Int level, BitstreamEncVideo *bitstream);
-    Int PutCoeff_Intra_Last(Int run, Int level, BitstreamEncVideo *bitstream);
+    Int PutCoeff_Inter(Int run, Int level, Int sign, BitstreamEncVideo *bitstream);
+    Int PutCoeff_Inter_Last(Int run, Int level, Int sign, BitstreamEncVideo *bitstream);
+    Int PutCoeff_Intra(Int run, Int level, Int sign, BitstreamEncVideo *bitstream);
+    Int PutCoeff_Intra_Last(Int run, Int level, Int sign, BitstreamEncVideo *bitstream);
     Int PutCBPY(Int cbpy, Char intra, BitstreamEncVideo *bitstream);
     Int PutMCBPC_Inter(Int cbpc, Int mode, BitstreamEncVideo *bitstream);
     Int PutMCBPC_Intra(Int cbpc, Int mode, BitstreamEncVideo *bitstream);
@@ -288,7 +288,11 @@ PutCBPY(Int cbpy, Char intra, BitstreamEncVideo *bitstream)
     of code, they do a really good job compiling it to if( (UInt)(run-x) < y-x).
     No need to hand-code it!!!!!, 6/1/2001 */
 
-Int PutCoeff_Inter(Int run, Int level, BitstreamEncVideo *bitstream)
+/* The PutCoeff_*() functions put the sign bit along with the code in a single
+   BitstreamPutBits(), the codes are at most 12 bits. They return the length
+   of the code without the sign bit, 0 if the escape code has to be used. */
+
+Int PutCoeff_Inter(Int run, Int level, Int sign, BitstreamEncVideo *bitstream)
 {
     Int length = 0;
 
@@ -296,19 +300,19 @@ Int PutCoeff_Inter(Int run, Int level, BitstreamEncVideo *bitstream)
     {
         length = coeff_tab0[run][level-1].len;
         if (length)
-            BitstreamPutBits(bitstream, length, (UInt)coeff_tab0[run][level-1].code);
+            BitstreamPutBits(bitstream, length + 1, ((UInt)coeff_tab0[run][level-1].code << 1) | sign);
     }
     else if (run > 1 && run < 27 && level < 5)
     {
         length = coeff_tab1[run-2][level-1].len;
         if (length)
-            BitstreamPutBits(bitstream, length, (UInt)coeff_tab1[run-2][level-1].code);
+            BitstreamPutBits(bitstream, length + 1, ((UInt)coeff_tab1[run-2][level-1].code << 1) | sign);
     }
 
     return length;
 }
 
-Int PutCoeff_Inter_Last(Int run, Int level, BitstreamEncVideo *bitstream)
+Int PutCoeff_Inter_Last(Int run, Int level, Int sign, BitstreamEncVideo *bitstream)
 {
     Int length = 0;
 
@@ -316,13 +320,13 @@ Int PutCoeff_Inter_Last(Int run, Int level, BitstreamEncVideo *bitstream)
     {
         length = coeff_tab2[run][level-1].len;
         if (length)
-            BitstreamPutBits(bitstream, length, (UInt)coeff_tab2[run][level-1].code);
+            BitstreamPutBits(bitstream, length + 1, ((UInt)coeff_tab2[run][level-1].code << 1) | sign);
     }
     else if (run > 1 && run < 42 && level == 1)
     {
         length = coeff_tab3[run-2].len;
         if (length)
-            BitstreamPutBits(bitstream, length, (UInt)coeff_tab3[run-2].code);
+            BitstreamPutBits(bitstream, length + 1, ((UInt)coeff_tab3[run-2].code << 1) | sign);
     }
 
     return length;
@@ -330,7 +334,7 @@ Int PutCoeff_Inter_Last(Int run, Int level, BitstreamEncVideo *bitstream)
 
 /* 5/16/01, break up function for last and not-last coefficient */
 
-Int PutCoeff_Intra(Int run, Int level, BitstreamEncVideo *bitstream)
+Int PutCoeff_Intra(Int run, Int level, Int sign, BitstreamEncVideo *bitstream)
 {
     Int length = 0;
 
@@ -338,31 +342,31 @@ Int PutCoeff_Intra(Int run, Int level, BitstreamEncVideo *bitstream)
     {
         length = coeff_tab4[level-1].len;
         if (length)
-            BitstreamPutBits(bitstream, length, (UInt)coeff_tab4[level-1].code);
+            BitstreamPutBits(bitstream, length + 1, ((UInt)coeff_tab4[level-1].code << 1) | sign);
     }
     else if (run == 1 && level < 11)
     {
         length = coeff_tab5[level-1].len;
         if (length)
-            BitstreamPutBits(bitstream, length, (UInt)coeff_tab5[level-1].code);
+            BitstreamPutBits(bitstream, length + 1, ((UInt)coeff_tab5[level-1].code << 1) | sign);
     }
     else if (run > 1 && run < 10 && level < 6)
     {
         length = coeff_tab6[run-2][level-1].len;
         if (length)
-            BitstreamPutBits(bitstream, length, (UInt)coeff_tab6[run-2][level-1].code);
+            BitstreamPutBits(bitstream, length + 1, ((UInt)coeff_tab6[run-2][level-1].code << 1) | sign);
     }
     else if (run > 9 && run < 15 && level == 1)
     {
         length = coeff_tab7[run-10].len;
         if (length)
-            BitstreamPutBits(bitstream, length, (UInt)coeff_tab7[run-10].code);
+            BitstreamPutBits(bitstream, length + 1, ((UInt)coeff_tab7[run-10].code << 1) | sign);
     }
 
     return length;
 }
 
-Int PutCoeff_Intra_Last(Int run, Int level, BitstreamEncVideo *bitstream)
+Int PutCoeff_Intra_Last(Int run, Int level, Int sign, BitstreamEncVideo *bitstream)
 {
     Int length = 0;
 
@@ -370,19 +374,19 @@ Int PutCoeff_Intra_Last(Int run, Int level, BitstreamEncVideo *bitstream)
     {
         length = coeff_tab8[level-1].len;
         if (length)
-            BitstreamPutBits(bitstream, length, (UInt)coeff_tab8[level-1].code);
+            BitstreamPutBits(bitstream, length + 1, ((UInt)coeff_tab8[level-1].code << 1) | sign);
     }
     else if (run > 0 && run < 7 && level < 4)
     {
         length = coeff_tab9[run-1][level-1].len;
         if (length)
-            BitstreamPutBits(bitstream, length, (UInt)coeff_tab9[run-1][level-1].code);
+            BitstreamPutBits(bitstream, length + 1, ((UInt)coeff_tab9[run-1][level-1].code << 1) | sign);
     }
     else if (run > 6 && run < 21 && level == 1)
     {
         length = coeff_tab10[run-7].len;
         if (length)
-            BitstreamPutBits(bitstream, length, (UInt)coeff_tab10[run-7].code);
+            BitstreamPutBits(bitstream, length + 1, ((UInt)coeff_tab10[run-7].code << 1) | sign);
     }
 
     return length;
@@ -1520,11 +1524,7 @@ Void BlockCodeCoeff_ShortHeader(RunLevelBlock *RLB, BitstreamEncVideo *bs, Int j
 //          break;
         /*ENCODE RUN LENGTH */
         if (level < 13)
-        {
-            length = PutCoeff_Inter(run, level, bs);
-            if (length != 0)
-                /*temp =*/ BitstreamPut1Bits(bs, RLB->s[i]); /* Sign Bit */
-        }
+            length = PutCoeff_Inter(run, level, RLB->s[i], bs); /* with Sign Bit */
         else
             length = 0;
         /* ESCAPE CODING */
@@ -1532,10 +1532,8 @@ Void BlockCodeCoeff_ShortHeader(RunLevelBlock *RLB, BitstreamEncVideo *bs, Int j
         {
             if (RLB->s[i])
                 level = -level;
-            BitstreamPutBits(bs, 7 + 1, 6); /* ESCAPE CODE + Not Last Coefficient */
-            //BitstreamPutBits(bs,1,0); /* Not Last Coefficient */
-            BitstreamPutBits(bs, 6, run); /* RUN */
-            BitstreamPutBits(bs, 8, level&0xFF); /* LEVEL, mask to make sure length 8 */
+            /* ESCAPE CODE + Not Last Coefficient (8), RUN (6), LEVEL (8), mask to make sure length 8 */
+            BitstreamPutGT16Bits(bs, 8 + 6 + 8, (6 << 14) | (run << 8) | (level & 0xFF));
         }
     }
     /* Last Coefficient!!! */
@@ -1544,11 +1542,7 @@ Void BlockCodeCoeff_ShortHeader(RunLevelBlock *RLB, BitstreamEncVideo *bs, Int j
 
     /*ENCODE RUN LENGTH */
     if (level < 13)
-    {
-        length = PutCoeff_Inter_Last(run, level, bs);
-        if (length != 0)
-            /*temp =*/ BitstreamPut1Bits(bs, RLB->s[i]); /* Sign Bit */
-    }
+        length = PutCoeff_Inter_Last(run, level, RLB->s[i], bs); /* with Sign Bit */
     else
         length = 0;
     /* ESCAPE CODING */
@@ -1556,10 +1550,8 @@ Void BlockCodeCoeff_ShortHeader(RunLevelBlock *RLB, BitstreamEncVideo *bs, Int j
     {
         if (RLB->s[i])
             level = -level;
-        BitstreamPutBits(bs, 7 + 1, 7); /* ESCAPE CODE + Last Coefficient */
-        //BitstreamPutBits(bs,1,1); /* Last Coefficient !!!*/
-        BitstreamPutBits(bs, 6, run); /* RUN */
-        BitstreamPutBits(bs, 8, level&0xFF); /* LEVEL, mask to make sure length 8  */
+        /* ESCAPE CODE + Last Coefficient (8), RUN (6), LEVEL (8), mask to make sure length 8 */
+        BitstreamPutGT16Bits(bs, 8 + 6 + 8, (7 << 14) | (run << 8) | (level & 0xFF));
     }
 
     return ;
@@ -1580,7 +1572,7 @@ Void BlockCodeCoeff_Normal(RunLevelBlock *RLB, BitstreamEncVideo *bs, Int j_star
     Int intra = (Mode == MODE_INTRA || Mode == MODE_INTRA_Q);
     Int level_minus_max;
     Int run_minus_max;
-    Int(*PutCoeff)(Int, Int, BitstreamEncVideo *); /* pointer to functions, 5/28/01 */
+    Int(*PutCoeff)(Int, Int, Int, BitstreamEncVideo *); /* pointer to functions, 5/28/01 */
 
     /* Not Last Coefficient!!! */
 
@@ -1597,7 +1589,9 @@ Void BlockCodeCoeff_Normal(RunLevelBlock *RLB, BitstreamEncVideo *bs, Int j_star
         /* Encode Run Length */
         if (level < 28)
         {
-            length = (*PutCoeff)(run, level, bs); /* 5/28/01 replaces above */
+            length = (*PutCoeff)(run, level, RLB->s[i], bs); /* 5/28/01 replaces above */
+            if (length != 0)
+                continue; /* Sign Bit already put */
         }
         else
         {
@@ -1655,15 +1649,10 @@ Void BlockCodeCoeff_Normal(RunLevelBlock *RLB, BitstreamEncVideo *bs, Int j_star
                     if (RLB->s[i])
                         level = -level;
                     /*temp =*/
-                    BitstreamPutBits(bs, 7 + 2 + 1, 30); /* ESCAPE CODE + Followed by 11 + Not Last Coefficient*/
-                    //temp = BitstreamPutBits(bs,2,3); /* Followed by 11 */
-                    //temp = BitstreamPutBits(bs, 1, 0); /* Not Last Coefficient*/
-                    /*temp =*/
-                    BitstreamPutBits(bs, 6 + 1, (run << 1) | 1); /* Encode Run + Marker Bit */
-                    //temp = BitstreamPutBits(bs,1,1); /* Marker Bit */
-                    /*temp =*/
-                    BitstreamPutGT8Bits(bs, 12 + 1, ((level << 1) | 1)&0x1FFF); /* Encode Level, mask to make sure length 12  */
-                    //temp = BitstreamPutBits(bs,1,1); /* Marker Bit */
+                    /* ESCAPE CODE + Followed by 11 + Not Last Coefficient (10), Run + Marker Bit (7),
+                       Level + Marker Bit (13), mask to make sure length 12 */
+                    BitstreamPutGT16Bits(bs, 10 + 7 + 13, ((ULong)30 << 20) | (((run << 1) | 1) << 13) |
+                                         (((level << 1) | 1) & 0x1FFF));
                 }
             }
         }
@@ -1682,16 +1671,18 @@ Void BlockCodeCoeff_Normal(RunLevelBlock *RLB, BitstreamEncVideo *bs, Int j_star
     {
         if (intra)
         {
-            length = PutCoeff_Intra_Last(run, level, bs);
+            length = PutCoeff_Intra_Last(run, level, RLB->s[i], bs);
         }
         else if (level < 4)
         {
-            length = PutCoeff_Inter_Last(run, level, bs);
+            length = PutCoeff_Inter_Last(run, level, RLB->s[i], bs);
         }
         else
         {
             length = 0;
         }
+        if (length != 0)
+            return ; /* Sign Bit already put */
     }
     else
     {
@@ -1747,15 +1738,10 @@ Void BlockCodeCoeff_Normal(RunLevelBlock *RLB, BitstreamEncVideo *bs, Int j_star
                 if (RLB->s[i])
                     level = -level;
                 /*temp =*/
-                BitstreamPutGT8Bits(bs, 7 + 2 + 1, 31); /* ESCAPE CODE + Followed by 11 + Last Coefficient*/
-                //temp = BitstreamPutBits(bs,2,3); /* Followed by 11 */
-                //temp = BitstreamPutBits(bs, 1, 1); /* Last Coefficient!!!*/
-                /*temp =*/
-                BitstreamPutBits(bs, 6 + 1, (run << 1) | 1); /* Encode Run + Marker Bit */
-                //temp = BitstreamPutBits(bs,1,1); /* Marker Bit */
-                /*temp =*/
-                BitstreamPutGT8Bits(bs, 12 + 1, ((level << 1) | 1)&0x1FFF); /* Encode Level, mask to make sure length 8 */
-                //temp = BitstreamPutBits(bs,1,1); /* Marker Bit */
+                /* ESCAPE CODE + Followed by 11 + Last Coefficient (10), Run + Marker Bit (7),
+                   Level + Marker Bit (13), mask to make sure length 12 */
+                BitstreamPutGT16Bits(bs, 10 + 7 + 13, ((ULong)31 << 20) | (((run << 1) | 1) << 13) |
+                                     (((level << 1) | 1) & 0x1FFF));
             }
         }
     }
@@ -31,10 +31,13 @@ LOCAL_SRC_FILES := \
 
 ifeq ($(TARGET_ARCH),arm)
 LOCAL_SRC_FILES += \
-	src/asm/pvmp3_polyphase_filter_window_gcc.s \
  	src/asm/pvmp3_mdct_18_gcc.s \
  	src/asm/pvmp3_dct_9_gcc.s \
 	src/asm/pvmp3_dct_16_gcc.s
+ifneq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_SRC_FILES += \
+	src/asm/pvmp3_polyphase_filter_window_gcc.s
+endif
 else
 LOCAL_SRC_FILES += \
  	src/pvmp3_polyphase_filter_window.cpp \
@@ -51,6 +54,15 @@ LOCAL_C_INCLUDES := \
 LOCAL_CFLAGS := \
         -DOSCL_UNUSED_ARG=
 
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_ARM_NEON := true
+    LOCAL_SRC_FILES += \
+        src/pvmp3_polyphase_filter_window_neon.cpp \
+        src/pvmp3_dct_16_neon.cpp \
+        src/pvmp3_mdct_18_neon.cpp
+    LOCAL_CFLAGS += -DMP3DEC_NEON
+endif
+
 LOCAL_MODULE := libstagefright_mp3dec
 
 LOCAL_ARM_MODE := arm
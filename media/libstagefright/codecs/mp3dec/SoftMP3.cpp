@@ -49,6 +49,7 @@ SoftMP3::SoftMP3(
       mNumChannels(2),
       mSamplingRate(44100),
       mSignalledError(false),
+      mNumBatchedFrames(0),
       mOutputPortSettingsChange(NONE) {
     initPorts();
     initDecoder();
@@ -201,6 +202,24 @@ void SoftMP3::onQueueFilled(OMX_U32 portIndex) {
         BufferInfo *outInfo = *outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
+        if (mNumBatchedFrames > 0) {
+            // Return the frames batched so far before the end of stream or
+            // a timestamp discontinuity. The next input is expected where the
+            // previous one's decoded frames end. That is taken from the input
+            // timeline rather than from the output buffer, whose first batch
+            // is shortened by the decoder delay.
+            int64_t nextTimeUs = mAnchorTimeUs
+                + (mNumFramesOutput * 1000000ll) / mSamplingRate;
+
+            if ((inHeader->nFlags & OMX_BUFFERFLAG_EOS)
+                    || (inHeader->nOffset == 0
+                        && (inHeader->nTimeStamp > nextTimeUs + kMaxBatchGapUs
+                            || inHeader->nTimeStamp < nextTimeUs - kMaxBatchGapUs))) {
+                sendOutputBatch();
+                continue;
+            }
+        }
+
         if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
             inQueue.erase(inQueue.begin());
             inInfo->mOwnedByUs = false;
@@ -232,6 +251,12 @@ void SoftMP3::onQueueFilled(OMX_U32 portIndex) {
             mNumFramesOutput = 0;
         }
 
+        // the next frame goes after those already in the output buffer
+        size_t outOffset = 0;
+        if (mNumBatchedFrames > 0) {
+            outOffset = outHeader->nOffset + outHeader->nFilledLen;
+        }
+
         mConfig->pInputBuffer =
             inHeader->pBuffer + inHeader->nOffset;
 
@@ -242,7 +267,7 @@ void SoftMP3::onQueueFilled(OMX_U32 portIndex) {
         mConfig->outputFrameSize = kOutputBufferSize / sizeof(int16_t);
 
         mConfig->pOutputBuffer =
-            reinterpret_cast<int16_t *>(outHeader->pBuffer);
+            reinterpret_cast<int16_t *>(outHeader->pBuffer + outOffset);
 
         ERROR_CODE decoderErr;
         if ((decoderErr = pvmp3_framedecoder(mConfig, mDecoderBuf))
@@ -264,13 +289,18 @@ void SoftMP3::onQueueFilled(OMX_U32 portIndex) {
 
             // This is recoverable, just ignore the current frame and
             // play silence instead.
-            memset(outHeader->pBuffer,
+            memset(outHeader->pBuffer + outOffset,
                    0,
                    mConfig->outputFrameSize * sizeof(int16_t));
 
             mConfig->inputBufferUsedLength = inHeader->nFilledLen;
         } else if (mConfig->samplingRate != mSamplingRate
                 || mConfig->num_channels != mNumChannels) {
+            // the frames batched so far are in the old format
+            if (mNumBatchedFrames > 0) {
+                sendOutputBatch();
+            }
+
             mSamplingRate = mConfig->samplingRate;
             mNumChannels = mConfig->num_channels;
 
@@ -279,26 +309,31 @@ void SoftMP3::onQueueFilled(OMX_U32 portIndex) {
             return;
         }
 
-        if (mIsFirst) {
-            mIsFirst = false;
-            // The decoder delay is 529 samples, so trim that many samples off
-            // the start of the first output buffer. This essentially makes this
-            // decoder have zero delay, which the rest of the pipeline assumes.
-            outHeader->nOffset =
-                kPVMP3DecoderDelay * mNumChannels * sizeof(int16_t);
-
-            outHeader->nFilledLen =
-                mConfig->outputFrameSize * sizeof(int16_t) - outHeader->nOffset;
+        if (mNumBatchedFrames > 0) {
+            outHeader->nFilledLen += mConfig->outputFrameSize * sizeof(int16_t);
         } else {
-            outHeader->nOffset = 0;
-            outHeader->nFilledLen = mConfig->outputFrameSize * sizeof(int16_t);
-        }
+            if (mIsFirst) {
+                mIsFirst = false;
+                // The decoder delay is 529 samples, so trim that many samples off
+                // the start of the first output buffer. This essentially makes this
+                // decoder have zero delay, which the rest of the pipeline assumes.
+                outHeader->nOffset =
+                    kPVMP3DecoderDelay * mNumChannels * sizeof(int16_t);
 
-        outHeader->nTimeStamp =
-            mAnchorTimeUs
-                + (mNumFramesOutput * 1000000ll) / mConfig->samplingRate;
+                outHeader->nFilledLen =
+                    mConfig->outputFrameSize * sizeof(int16_t) - outHeader->nOffset;
+            } else {
+                outHeader->nOffset = 0;
+                outHeader->nFilledLen = mConfig->outputFrameSize * sizeof(int16_t);
+            }
 
-        outHeader->nFlags = 0;
+            outHeader->nTimeStamp =
+                mAnchorTimeUs
+                    + (mNumFramesOutput * 1000000ll) / mConfig->samplingRate;
+
+            outHeader->nFlags = 0;
+        }
+        ++mNumBatchedFrames;
 
         CHECK_GE(inHeader->nFilledLen, mConfig->inputBufferUsedLength);
 
@@ -315,15 +350,32 @@ void SoftMP3::onQueueFilled(OMX_U32 portIndex) {
             inHeader = NULL;
         }
 
-        outInfo->mOwnedByUs = false;
-        outQueue.erase(outQueue.begin());
-        outInfo = NULL;
-        notifyFillBufferDone(outHeader);
-        outHeader = NULL;
+        // Output buffers are only larger than kOutputBufferSize if the client
+        // asked for it, in which case they take as many frames as they can.
+        if (outHeader->nAllocLen - (outHeader->nOffset + outHeader->nFilledLen)
+                < kOutputBufferSize) {
+            sendOutputBatch();
+        }
     }
 }
 
+void SoftMP3::sendOutputBatch() {
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+
+    BufferInfo *outInfo = *outQueue.begin();
+    outInfo->mOwnedByUs = false;
+    outQueue.erase(outQueue.begin());
+    notifyFillBufferDone(outInfo->mHeader);
+
+    mNumBatchedFrames = 0;
+}
+
 void SoftMP3::onPortFlushCompleted(OMX_U32 portIndex) {
+    if (portIndex == 1) {
+        // the partly filled output buffer went back with the others
+        mNumBatchedFrames = 0;
+    }
+
     if (portIndex == 0) {
         // Make sure that the next buffer output does not still
         // depend on fragments from the last one decoded.
@@ -337,6 +389,10 @@ void SoftMP3::onPortEnableCompleted(OMX_U32 portIndex, bool enabled) {
         return;
     }
 
+    if (!enabled) {
+        mNumBatchedFrames = 0;
+    }
+
     switch (mOutputPortSettingsChange) {
         case NONE:
             break;
@@ -362,6 +418,7 @@ void SoftMP3::onReset() {
     pvmp3_InitDecoder(mConfig, mDecoderBuf);
     mIsFirst = true;
     mSignalledError = false;
+    mNumBatchedFrames = 0;
     mOutputPortSettingsChange = NONE;
 }
 
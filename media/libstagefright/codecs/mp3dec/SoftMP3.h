@@ -48,7 +48,8 @@ private:
     enum {
         kNumBuffers = 4,
         kOutputBufferSize = 4608 * 2,
-        kPVMP3DecoderDelay = 529 // frames
+        kPVMP3DecoderDelay = 529, // frames
+        kMaxBatchGapUs = 5000,
     };
 
     tPVMP3DecoderExternal *mConfig;
@@ -62,6 +63,10 @@ private:
     bool mIsFirst;
     bool mSignalledError;
 
+    // frames decoded into the output buffer at the head of the queue; the
+    // buffer is returned once it has no room for another frame
+    size_t mNumBatchedFrames;
+
     enum {
         NONE,
         AWAITING_DISABLED,
@@ -70,6 +75,7 @@ private:
 
     void initPorts();
     void initDecoder();
+    void sendOutputBatch();
 
     DISALLOW_EVIL_CONSTRUCTORS(SoftMP3);
 };
@@ -84,6 +84,10 @@ extern "C"
 
     void pvmp3_split(int32 *vect);
 
+#ifdef MP3DEC_NEON
+    void pvmp3_dct_32_x4(int32 vec[]);
+#endif
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,313 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "pvmp3_dct_16.h"
+#include "pv_mp3dec_fxd_op.h"
+#include "pvmp3_dec_defs.h"
+
+#include <arm_neon.h>
+
+/* NEON version of the DCT-32 done by pvmp3_poly_phase_synthesis() for each
+   time slot, pvmp3_split(), pvmp3_dct_16() on both halves, then
+   pvmp3_merge_in_place_N32(). 4 time slots are transformed at the same
+   time, one lane per slot, with the steps and the 64-bit products of the
+   C versions in pvmp3_dct_16.cpp so that the output is identical. */
+
+#define Qfmt(a)   (int32)(a*((int32)1<<27))
+
+static const int32 CosTable_dct32[16] =
+{
+    Qfmt_31(0.50060299823520F) ,  Qfmt_31(0.50547095989754F) ,
+    Qfmt_31(0.51544730992262F) ,  Qfmt_31(0.53104259108978F) ,
+    Qfmt_31(0.55310389603444F) ,  Qfmt_31(0.58293496820613F) ,
+    Qfmt_31(0.62250412303566F) ,  Qfmt_31(0.67480834145501F) ,
+    Qfmt_31(0.74453627100230F) ,  Qfmt_31(0.83934964541553F) ,
+
+    Qfmt(0.97256823786196F) ,  Qfmt(1.16943993343288F) ,
+    Qfmt(1.48416461631417F) ,  Qfmt(2.05778100995341F) ,
+    Qfmt(3.40760841846872F) ,  Qfmt(10.19000812354803F)
+};
+
+/* fxp_mul32_Q32() */
+static inline int32x4_t mul_q32(int32x4_t a, int32 b)
+{
+    int64x2_t lo = vmull_n_s32(vget_low_s32(a), b);
+    int64x2_t hi = vmull_n_s32(vget_high_s32(a), b);
+
+    return vcombine_s32(vshrn_n_s64(lo, 32), vshrn_n_s64(hi, 32));
+}
+
+/* fxp_mul32_Q27() */
+static inline int32x4_t mul_q27(int32x4_t a, int32 b)
+{
+    int64x2_t lo = vmull_n_s32(vget_low_s32(a), b);
+    int64x2_t hi = vmull_n_s32(vget_high_s32(a), b);
+
+    return vcombine_s32(vshrn_n_s64(lo, 27), vshrn_n_s64(hi, 27));
+}
+
+/* 4x4 transpose, rows to lanes and back */
+static inline void transpose_4x4(int32x4_t *v)
+{
+    int32x4x2_t t0 = vtrnq_s32(v[0], v[1]);
+    int32x4x2_t t1 = vtrnq_s32(v[2], v[3]);
+
+    v[0] = vcombine_s32(vget_low_s32(t0.val[0]), vget_low_s32(t1.val[0]));
+    v[1] = vcombine_s32(vget_low_s32(t0.val[1]), vget_low_s32(t1.val[1]));
+    v[2] = vcombine_s32(vget_high_s32(t0.val[0]), vget_high_s32(t1.val[0]));
+    v[3] = vcombine_s32(vget_high_s32(t0.val[1]), vget_high_s32(t1.val[1]));
+}
+
+static inline void split_x4(int32x4_t *vect)
+{
+    int32 i;
+
+    for (i = 0; i < 16; i++)
+    {
+        int32x4_t tmp2 = vect[i];
+        int32x4_t tmp1 = vect[-1 - i];
+        int32 cosx = CosTable_dct32[15 - i];
+
+        vect[-1 - i] = vaddq_s32(tmp1, tmp2);
+        if (i < 6)
+        {
+            vect[i] = mul_q27(vsubq_s32(tmp1, tmp2), cosx);
+        }
+        else
+        {
+            vect[i] = mul_q32(vshlq_n_s32(vsubq_s32(tmp1, tmp2), 1), cosx);
+        }
+    }
+}
+
+static inline void dct_16_x4(int32x4_t *vec, int32 flag)
+{
+    int32x4_t tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+    int32x4_t tmp_o0, tmp_o1, tmp_o2, tmp_o3, tmp_o4, tmp_o5, tmp_o6, tmp_o7;
+    int32x4_t itmp_e0, itmp_e1, itmp_e2;
+
+    /*  split input vector */
+
+    tmp_o0 = mul_q32(vsubq_s32(vec[ 0], vec[15]), Qfmt_31(0.50241928618816F));
+    tmp0   = vaddq_s32(vec[ 0], vec[15]);
+
+    tmp_o7 = mul_q32(vshlq_n_s32(vsubq_s32(vec[ 7], vec[ 8]), 3), Qfmt_31(0.63764357733614F));
+    tmp7   = vaddq_s32(vec[ 7], vec[ 8]);
+
+    itmp_e0 = mul_q32(vsubq_s32(tmp0, tmp7), Qfmt_31(0.50979557910416F));
+    tmp7    = vaddq_s32(tmp0, tmp7);
+
+    tmp_o1 = mul_q32(vsubq_s32(vec[ 1], vec[14]), Qfmt_31(0.52249861493969F));
+    tmp1   = vaddq_s32(vec[ 1], vec[14]);
+
+    tmp_o6 = mul_q32(vshlq_n_s32(vsubq_s32(vec[ 6], vec[ 9]), 1), Qfmt_31(0.86122354911916F));
+    tmp6   = vaddq_s32(vec[ 6], vec[ 9]);
+
+    itmp_e1 = vaddq_s32(tmp1, tmp6);
+    tmp6    = mul_q32(vsubq_s32(tmp1, tmp6), Qfmt_31(0.60134488693505F));
+
+    tmp_o2 = mul_q32(vsubq_s32(vec[ 2], vec[13]), Qfmt_31(0.56694403481636F));
+    tmp2   = vaddq_s32(vec[ 2], vec[13]);
+    tmp_o5 = mul_q32(vshlq_n_s32(vsubq_s32(vec[ 5], vec[10]), 1), Qfmt_31(0.53033884299517F));
+    tmp5   = vaddq_s32(vec[ 5], vec[10]);
+
+    itmp_e2 = vaddq_s32(tmp2, tmp5);
+    tmp5    = mul_q32(vsubq_s32(tmp2, tmp5), Qfmt_31(0.89997622313642F));
+
+    tmp_o3 = mul_q32(vsubq_s32(vec[ 3], vec[12]), Qfmt_31(0.64682178335999F));
+    tmp3   = vaddq_s32(vec[ 3], vec[12]);
+    tmp_o4 = mul_q32(vsubq_s32(vec[ 4], vec[11]), Qfmt_31(0.78815462345125F));
+    tmp4   = vaddq_s32(vec[ 4], vec[11]);
+
+    tmp1   = vaddq_s32(tmp3, tmp4);
+    tmp4   = mul_q32(vshlq_n_s32(vsubq_s32(tmp3, tmp4), 2), Qfmt_31(0.64072886193538F));
+
+    /*  split even part of tmp_e */
+
+    tmp0 = vaddq_s32(tmp7, tmp1);
+    tmp1 = mul_q32(vsubq_s32(tmp7, tmp1), Qfmt_31(0.54119610014620F));
+
+    tmp3 = mul_q32(vshlq_n_s32(vsubq_s32(itmp_e1, itmp_e2), 1), Qfmt_31(0.65328148243819F));
+    tmp7 = vaddq_s32(itmp_e1, itmp_e2);
+
+    vec[ 0] = vshrq_n_s32(vaddq_s32(tmp0, tmp7), 1);
+    vec[ 8] = mul_q32(vsubq_s32(tmp0, tmp7), Qfmt_31(0.70710678118655F));
+    tmp0    = mul_q32(vshlq_n_s32(vsubq_s32(tmp1, tmp3), 1), Qfmt_31(0.70710678118655F));
+    vec[ 4] = vaddq_s32(vaddq_s32(tmp1, tmp3), tmp0);
+    vec[12] = tmp0;
+
+    /*  split odd part of tmp_e */
+
+    tmp1 = mul_q32(vshlq_n_s32(vsubq_s32(itmp_e0, tmp4), 1), Qfmt_31(0.54119610014620F));
+    tmp7 = vaddq_s32(itmp_e0, tmp4);
+
+    tmp3 = mul_q32(vshlq_n_s32(vsubq_s32(tmp6, tmp5), 2), Qfmt_31(0.65328148243819F));
+    tmp6 = vaddq_s32(tmp6, tmp5);
+
+    tmp4 = mul_q32(vshlq_n_s32(vsubq_s32(tmp7, tmp6), 1), Qfmt_31(0.70710678118655F));
+    tmp6 = vaddq_s32(tmp6, tmp7);
+    tmp7 = mul_q32(vshlq_n_s32(vsubq_s32(tmp1, tmp3), 1), Qfmt_31(0.70710678118655F));
+
+    tmp1    = vaddq_s32(tmp1, vaddq_s32(tmp3, tmp7));
+    vec[ 2] = vaddq_s32(tmp1, tmp6);
+    vec[ 6] = vaddq_s32(tmp1, tmp4);
+    vec[10] = vaddq_s32(tmp7, tmp4);
+    vec[14] = tmp7;
+
+
+    // dct8;
+
+    tmp1 = mul_q32(vshlq_n_s32(vsubq_s32(tmp_o0, tmp_o7), 1), Qfmt_31(0.50979557910416F));
+    tmp7 = vaddq_s32(tmp_o0, tmp_o7);
+
+    tmp6   = vaddq_s32(tmp_o1, tmp_o6);
+    tmp_o1 = mul_q32(vshlq_n_s32(vsubq_s32(tmp_o1, tmp_o6), 1), Qfmt_31(0.60134488693505F));
+
+    tmp5   = vaddq_s32(tmp_o2, tmp_o5);
+    tmp_o5 = mul_q32(vshlq_n_s32(vsubq_s32(tmp_o2, tmp_o5), 1), Qfmt_31(0.89997622313642F));
+
+    tmp0 = mul_q32(vshlq_n_s32(vsubq_s32(tmp_o3, tmp_o4), 3), Qfmt_31(0.6407288619354F));
+    tmp4 = vaddq_s32(tmp_o3, tmp_o4);
+
+    if (!flag)
+    {
+        tmp7   = vnegq_s32(tmp7);
+        tmp1   = vnegq_s32(tmp1);
+        tmp6   = vnegq_s32(tmp6);
+        tmp_o1 = vnegq_s32(tmp_o1);
+        tmp5   = vnegq_s32(tmp5);
+        tmp_o5 = vnegq_s32(tmp_o5);
+        tmp4   = vnegq_s32(tmp4);
+        tmp0   = vnegq_s32(tmp0);
+    }
+
+
+    tmp2   = mul_q32(vshlq_n_s32(vsubq_s32(tmp1, tmp0), 1), Qfmt_31(0.54119610014620F));
+    tmp0   = vaddq_s32(tmp0, tmp1);
+    tmp1   = mul_q32(vshlq_n_s32(vsubq_s32(tmp7, tmp4), 1), Qfmt_31(0.54119610014620F));
+    tmp7   = vaddq_s32(tmp7, tmp4);
+    tmp4   = mul_q32(vshlq_n_s32(vsubq_s32(tmp6, tmp5), 2), Qfmt_31(0.65328148243819F));
+    tmp6   = vaddq_s32(tmp6, tmp5);
+    tmp5   = mul_q32(vshlq_n_s32(vsubq_s32(tmp_o1, tmp_o5), 2), Qfmt_31(0.65328148243819F));
+    tmp_o1 = vaddq_s32(tmp_o1, tmp_o5);
+
+
+    vec[13] = mul_q32(vshlq_n_s32(vsubq_s32(tmp1, tmp4), 1), Qfmt_31(0.70710678118655F));
+    vec[ 5] = vaddq_s32(vaddq_s32(tmp1, tmp4), vec[13]);
+
+    vec[ 9] = mul_q32(vshlq_n_s32(vsubq_s32(tmp7, tmp6), 1), Qfmt_31(0.70710678118655F));
+    vec[ 1] = vaddq_s32(tmp7, tmp6);
+
+    tmp4 = mul_q32(vshlq_n_s32(vsubq_s32(tmp0, tmp_o1), 1), Qfmt_31(0.70710678118655F));
+    tmp0 = vaddq_s32(tmp0, tmp_o1);
+    tmp6 = mul_q32(vshlq_n_s32(vsubq_s32(tmp2, tmp5), 1), Qfmt_31(0.70710678118655F));
+    tmp2 = vaddq_s32(tmp2, vaddq_s32(tmp5, tmp6));
+    tmp0 = vaddq_s32(tmp0, tmp2);
+
+    vec[ 1] = vaddq_s32(vec[ 1], tmp0);
+    vec[ 3] = vaddq_s32(tmp0, vec[ 5]);
+    tmp2    = vaddq_s32(tmp2, tmp4);
+    vec[ 5] = vaddq_s32(tmp2, vec[ 5]);
+    vec[ 7] = vaddq_s32(tmp2, vec[ 9]);
+    tmp4    = vaddq_s32(tmp4, tmp6);
+    vec[ 9] = vaddq_s32(tmp4, vec[ 9]);
+    vec[11] = vaddq_s32(tmp4, vec[13]);
+    vec[13] = vaddq_s32(tmp6, vec[13]);
+    vec[15] = tmp6;
+}
+
+static inline void merge_in_place_N32_x4(int32x4_t *vec)
+{
+    int32x4_t temp0;
+    int32x4_t temp1;
+    int32x4_t temp2;
+    int32x4_t temp3;
+
+    temp0   = vec[14];
+    vec[14] = vec[ 7];
+    temp1   = vec[12];
+    vec[12] = vec[ 6];
+    temp2   = vec[10];
+    vec[10] = vec[ 5];
+    temp3   = vec[ 8];
+    vec[ 8] = vec[ 4];
+    vec[ 6] = vec[ 3];
+    vec[ 4] = vec[ 2];
+    vec[ 2] = vec[ 1];
+
+    vec[ 1] = vaddq_s32(vec[16], vec[17]);
+    vec[16] = temp3;
+    vec[ 3] = vaddq_s32(vec[18], vec[17]);
+    vec[ 5] = vaddq_s32(vec[19], vec[18]);
+    vec[18] = vec[9];
+
+    vec[ 7] = vaddq_s32(vec[20], vec[19]);
+    vec[ 9] = vaddq_s32(vec[21], vec[20]);
+    vec[20] = temp2;
+    temp2   = vec[13];
+    temp3   = vec[11];
+    vec[11] = vaddq_s32(vec[22], vec[21]);
+    vec[13] = vaddq_s32(vec[23], vec[22]);
+    vec[22] = temp3;
+    temp3   = vec[15];
+
+    vec[15] = vaddq_s32(vec[24], vec[23]);
+    vec[17] = vaddq_s32(vec[25], vec[24]);
+    vec[19] = vaddq_s32(vec[26], vec[25]);
+    vec[21] = vaddq_s32(vec[27], vec[26]);
+    vec[23] = vaddq_s32(vec[28], vec[27]);
+    vec[24] = temp1;
+    vec[25] = vaddq_s32(vec[29], vec[28]);
+    vec[26] = temp2;
+    vec[27] = vaddq_s32(vec[30], vec[29]);
+    vec[28] = temp0;
+    vec[29] = vaddq_s32(vec[30], vec[31]);
+    vec[30] = temp3;
+}
+
+void pvmp3_dct_32_x4(int32 vec[])
+{
+    int32x4_t v[SUBBANDS_NUMBER];
+    int32 i;
+    int32 j;
+
+    /* slot j is at vec - 32 * j, like the successive inData */
+    for (i = 0; i < SUBBANDS_NUMBER; i += 4)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            v[i + j] = vld1q_s32(&vec[i - SUBBANDS_NUMBER * j]);
+        }
+        transpose_4x4(&v[i]);
+    }
+
+    split_x4(&v[16]);
+
+    dct_16_x4(&v[16], 0);
+    dct_16_x4(v, 1);     // Even terms
+
+    merge_in_place_N32_x4(v);
+
+    for (i = 0; i < SUBBANDS_NUMBER; i += 4)
+    {
+        transpose_4x4(&v[i]);
+        for (j = 0; j < 4; j++)
+        {
+            vst1q_s32(&vec[i - SUBBANDS_NUMBER * j], v[i + j]);
+        }
+    }
+}
@@ -213,6 +213,24 @@ const int32 short_win[12] =
 ; FUNCTION CODE
 ----------------------------------------------------------------------------*/
 
+/*
+ *     every odd time sample of the subband is multiplied by -1
+ */
+
+static inline void invert_odd_slots(int32 *out)
+{
+    for (int32 slot = 1; slot < FILTERBANK_BANDS; slot += 6)
+    {
+        int32 temp1 = out[slot  ];
+        int32 temp2 = out[slot+2];
+        int32 temp3 = out[slot+4];
+        out[slot  ] = -temp1;
+        out[slot+2] = -temp2;
+        out[slot+4] = -temp3;
+    }
+}
+
+
 void pvmp3_imdct_synth(int32  in[SUBBANDS_NUMBER*FILTERBANK_BANDS],
                        int32  overlap[SUBBANDS_NUMBER*FILTERBANK_BANDS],
                        uint32 blk_type,
@@ -243,6 +261,33 @@ void pvmp3_imdct_synth(int32  in[SUBBANDS_NUMBER*FILTERBANK_BANDS],
         int32 * out     = in      + (band * FILTERBANK_BANDS);
         int32 * history = overlap + (band * FILTERBANK_BANDS);
 
+#ifdef MP3DEC_NEON
+        /*
+         *  4 bands with the same long window at a time
+         */
+
+        if ((current_blk_type != SHORT) &&
+                (band + 4 <= bands2process) &&
+                ((band >= mx_band) || (band + 4 <= mx_band)))
+        {
+            const int32 *window = (current_blk_type == START) ? start_win :
+                                  (current_blk_type == STOP)  ? stop_win  : normal_win;
+
+            pvmp3_mdct_18_x4(out, history, window);
+
+            for (int32 i = 0; i < 4; i++)
+            {
+                if ((band + i) & 1)
+                {
+                    invert_odd_slots(out + (i * FILTERBANK_BANDS));
+                }
+            }
+
+            band += 3;
+            continue;
+        }
+#endif
+
         switch (current_blk_type)
         {
             case LONG:
@@ -316,15 +361,7 @@ void pvmp3_imdct_synth(int32  in[SUBBANDS_NUMBER*FILTERBANK_BANDS],
 
         if (band & 1)
         {
-            for (int32 slot = 1; slot < FILTERBANK_BANDS; slot += 6)
-            {
-                int32 temp1 = out[slot  ];
-                int32 temp2 = out[slot+2];
-                int32 temp3 = out[slot+4];
-                out[slot  ] = -temp1;
-                out[slot+2] = -temp2;
-                out[slot+4] = -temp3;
-            }
+            invert_odd_slots(out);
         }
     }
 
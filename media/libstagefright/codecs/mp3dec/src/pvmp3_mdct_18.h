@@ -97,6 +97,10 @@ extern "C"
 
     void pvmp3_dct_6(int32 vec[]);
 
+#ifdef MP3DEC_NEON
+    void pvmp3_mdct_18_x4(int32 vec[], int32 *history, const int32 *window);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,341 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "pv_mp3dec_fxd_op.h"
+#include "pvmp3_mdct_18.h"
+
+#include <arm_neon.h>
+
+/* NEON version of pvmp3_mdct_18() and pvmp3_dct_9() for 4 consecutive
+   subbands using the same window, one lane per subband. The steps and the
+   64-bit products are those of pvmp3_mdct_18.cpp and pvmp3_dct_9.cpp, so
+   the output and the overlap are identical. */
+
+#define Qfmt31(a)   (int32)(a*(0x7FFFFFFF))
+
+#define cos_pi_9    Qfmt31( 0.93969262078591f)
+#define cos_2pi_9   Qfmt31( 0.76604444311898f)
+#define cos_4pi_9   Qfmt31( 0.17364817766693f)
+#define cos_5pi_9   Qfmt31(-0.17364817766693f)
+#define cos_7pi_9   Qfmt31(-0.76604444311898f)
+#define cos_8pi_9   Qfmt31(-0.93969262078591f)
+#define cos_pi_6    Qfmt31( 0.86602540378444f)
+#define cos_5pi_6   Qfmt31(-0.86602540378444f)
+#define cos_5pi_18  Qfmt31( 0.64278760968654f)
+#define cos_7pi_18  Qfmt31( 0.34202014332567f)
+#define cos_11pi_18 Qfmt31(-0.34202014332567f)
+#define cos_13pi_18 Qfmt31(-0.64278760968654f)
+#define cos_17pi_18 Qfmt31(-0.98480775301221f)
+
+#define BAND_SIZE 18
+
+static const int32 cosTerms_dct18[9] =
+{
+    Qfmt(0.50190991877167f),   Qfmt(0.51763809020504f),   Qfmt(0.55168895948125f),
+    Qfmt(0.61038729438073f),   Qfmt(0.70710678118655f),   Qfmt(0.87172339781055f),
+    Qfmt(1.18310079157625f),   Qfmt(1.93185165257814f),   Qfmt(5.73685662283493f)
+};
+
+static const int32 cosTerms_1_ov_cos_phi[18] =
+{
+
+    Qfmt1(0.50047634258166f),  Qfmt1(0.50431448029008f),  Qfmt1(0.51213975715725f),
+    Qfmt1(0.52426456257041f),  Qfmt1(0.54119610014620f),  Qfmt1(0.56369097343317f),
+    Qfmt1(0.59284452371708f),  Qfmt1(0.63023620700513f),  Qfmt1(0.67817085245463f),
+
+    Qfmt2(0.74009361646113f),  Qfmt2(0.82133981585229f),  Qfmt2(0.93057949835179f),
+    Qfmt2(1.08284028510010f),  Qfmt2(1.30656296487638f),  Qfmt2(1.66275476171152f),
+    Qfmt2(2.31011315767265f),  Qfmt2(3.83064878777019f),  Qfmt2(11.46279281302667f)
+};
+
+/* (int32)(a * b >> shift), the fxp_mul32_Qxx() of pv_mp3dec_fxd_op.h */
+static inline int32x4_t mul_q32(int32x4_t a, int32 b)
+{
+    int64x2_t lo = vmull_n_s32(vget_low_s32(a), b);
+    int64x2_t hi = vmull_n_s32(vget_high_s32(a), b);
+
+    return vcombine_s32(vshrn_n_s64(lo, 32), vshrn_n_s64(hi, 32));
+}
+
+static inline int32x4_t mul_q28(int32x4_t a, int32 b)
+{
+    int64x2_t lo = vmull_n_s32(vget_low_s32(a), b);
+    int64x2_t hi = vmull_n_s32(vget_high_s32(a), b);
+
+    return vcombine_s32(vshrn_n_s64(lo, 28), vshrn_n_s64(hi, 28));
+}
+
+static inline int32x4_t mul_q27(int32x4_t a, int32 b)
+{
+    int64x2_t lo = vmull_n_s32(vget_low_s32(a), b);
+    int64x2_t hi = vmull_n_s32(vget_high_s32(a), b);
+
+    return vcombine_s32(vshrn_n_s64(lo, 27), vshrn_n_s64(hi, 27));
+}
+
+/* fxp_mac32_Q32(acc, a << 1, b) */
+static inline int32x4_t mac_q32_x2(int32x4_t acc, int32x4_t a, int32 b)
+{
+    return vaddq_s32(acc, mul_q32(vshlq_n_s32(a, 1), b));
+}
+
+static inline void transpose_4x4(int32x4_t *v)
+{
+    int32x4x2_t t0 = vtrnq_s32(v[0], v[1]);
+    int32x4x2_t t1 = vtrnq_s32(v[2], v[3]);
+
+    v[0] = vcombine_s32(vget_low_s32(t0.val[0]), vget_low_s32(t1.val[0]));
+    v[1] = vcombine_s32(vget_low_s32(t0.val[1]), vget_low_s32(t1.val[1]));
+    v[2] = vcombine_s32(vget_high_s32(t0.val[0]), vget_high_s32(t1.val[0]));
+    v[3] = vcombine_s32(vget_high_s32(t0.val[1]), vget_high_s32(t1.val[1]));
+}
+
+/* the 18 values of the 4 subbands at p, one vector per index */
+static inline void load_4_bands(int32x4_t *v, const int32 *p)
+{
+    int32 i;
+    int32 j;
+
+    for (i = 0; i < 16; i += 4)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            v[i + j] = vld1q_s32(&p[i + BAND_SIZE * j]);
+        }
+        transpose_4x4(&v[i]);
+    }
+
+    for (i = 16; i < BAND_SIZE; i++)
+    {
+        v[i] = vld1q_lane_s32(&p[i], v[i], 0);
+        v[i] = vld1q_lane_s32(&p[i + BAND_SIZE], v[i], 1);
+        v[i] = vld1q_lane_s32(&p[i + BAND_SIZE * 2], v[i], 2);
+        v[i] = vld1q_lane_s32(&p[i + BAND_SIZE * 3], v[i], 3);
+    }
+}
+
+static inline void store_4_bands(int32 *p, int32x4_t *v)
+{
+    int32 i;
+    int32 j;
+
+    for (i = 0; i < 16; i += 4)
+    {
+        transpose_4x4(&v[i]);
+        for (j = 0; j < 4; j++)
+        {
+            vst1q_s32(&p[i + BAND_SIZE * j], v[i + j]);
+        }
+    }
+
+    for (i = 16; i < BAND_SIZE; i++)
+    {
+        vst1q_lane_s32(&p[i], v[i], 0);
+        vst1q_lane_s32(&p[i + BAND_SIZE], v[i], 1);
+        vst1q_lane_s32(&p[i + BAND_SIZE * 2], v[i], 2);
+        vst1q_lane_s32(&p[i + BAND_SIZE * 3], v[i], 3);
+    }
+}
+
+static inline void dct_9_x4(int32x4_t *vec)
+{
+    /*  split input vector */
+
+    int32x4_t tmp0 = vaddq_s32(vec[8], vec[0]);
+    int32x4_t tmp8 = vsubq_s32(vec[8], vec[0]);
+    int32x4_t tmp1 = vaddq_s32(vec[7], vec[1]);
+    int32x4_t tmp7 = vsubq_s32(vec[7], vec[1]);
+    int32x4_t tmp2 = vaddq_s32(vec[6], vec[2]);
+    int32x4_t tmp6 = vsubq_s32(vec[6], vec[2]);
+    int32x4_t tmp3 = vaddq_s32(vec[5], vec[3]);
+    int32x4_t tmp5 = vsubq_s32(vec[5], vec[3]);
+    int32x4_t tmp023 = vaddq_s32(vaddq_s32(tmp0, tmp2), tmp3);
+    int32x4_t tmp14  = vaddq_s32(tmp1, vec[4]);
+
+    vec[0] = vaddq_s32(tmp023, tmp14);
+    vec[6] = vsubq_s32(vshrq_n_s32(tmp023, 1), tmp14);
+    vec[2] = vsubq_s32(vshrq_n_s32(tmp1, 1), vec[4]);
+    vec[4] = vnegq_s32(vec[2]);
+    vec[8] = vnegq_s32(vec[2]);
+    vec[4] = mac_q32_x2(vec[4], tmp0, cos_2pi_9);
+    vec[8] = mac_q32_x2(vec[8], tmp0, cos_4pi_9);
+    vec[2] = mac_q32_x2(vec[2], tmp0, cos_pi_9);
+    vec[2] = mac_q32_x2(vec[2], tmp2, cos_5pi_9);
+    vec[4] = mac_q32_x2(vec[4], tmp2, cos_8pi_9);
+    vec[8] = mac_q32_x2(vec[8], tmp2, cos_2pi_9);
+    vec[8] = mac_q32_x2(vec[8], tmp3, cos_8pi_9);
+    vec[4] = mac_q32_x2(vec[4], tmp3, cos_4pi_9);
+    vec[2] = mac_q32_x2(vec[2], tmp3, cos_7pi_9);
+
+    vec[1] = mul_q32(vshlq_n_s32(tmp5, 1), cos_11pi_18);
+    vec[1] = mac_q32_x2(vec[1], tmp6, cos_13pi_18);
+    vec[1] = mac_q32_x2(vec[1], tmp7,   cos_5pi_6);
+    vec[1] = mac_q32_x2(vec[1], tmp8, cos_17pi_18);
+    vec[3] = mul_q32(vshlq_n_s32(vsubq_s32(vaddq_s32(tmp5, tmp6), tmp8), 1), cos_pi_6);
+    vec[5] = mul_q32(vshlq_n_s32(tmp5, 1), cos_17pi_18);
+    vec[5] = mac_q32_x2(vec[5], tmp6,  cos_7pi_18);
+    vec[5] = mac_q32_x2(vec[5], tmp7,    cos_pi_6);
+    vec[5] = mac_q32_x2(vec[5], tmp8, cos_13pi_18);
+    vec[7] = mul_q32(vshlq_n_s32(tmp5, 1), cos_5pi_18);
+    vec[7] = mac_q32_x2(vec[7], tmp6, cos_17pi_18);
+    vec[7] = mac_q32_x2(vec[7], tmp7,    cos_pi_6);
+    vec[7] = mac_q32_x2(vec[7], tmp8, cos_11pi_18);
+}
+
+void pvmp3_mdct_18_x4(int32 vec_in[], int32 *history_in, const int32 *window)
+{
+    int32x4_t vec[BAND_SIZE];
+    int32x4_t history[BAND_SIZE];
+    int32x4_t tmp;
+    int32x4_t tmp1;
+    int32x4_t tmp2;
+    int32x4_t tmp3;
+    int32x4_t tmp4;
+    int32 i;
+
+    load_4_bands(vec, vec_in);
+    load_4_bands(history, history_in);
+
+    for (i = 0; i < 9; i++)
+    {
+        tmp  = mul_q32(vshlq_n_s32(vec[i], 1), cosTerms_1_ov_cos_phi[i]);
+        tmp1 = mul_q27(vec[17 - i], cosTerms_1_ov_cos_phi[17 - i]);
+        vec[i]      = vaddq_s32(tmp, tmp1);
+        vec[17 - i] = mul_q28(vsubq_s32(tmp, tmp1), cosTerms_dct18[i]);
+    }
+
+
+    dct_9_x4(vec);         // Even terms
+    dct_9_x4(&vec[9]);     // Odd  terms
+
+
+    tmp3     = vec[16];
+    vec[16]  = vec[ 8];
+    tmp4     = vec[14];
+    vec[14]  = vec[ 7];
+    tmp      = vec[12];
+    vec[12]  = vec[ 6];
+    tmp2     = vec[10];
+    vec[10]  = vec[ 5];
+    vec[ 8]  = vec[ 4];
+    vec[ 6]  = vec[ 3];
+    vec[ 4]  = vec[ 2];
+    vec[ 2]  = vec[ 1];
+    vec[ 1]  = vsubq_s32(vec[ 9], tmp2);
+    vec[ 3]  = vsubq_s32(vec[11], tmp2);
+    vec[ 5]  = vsubq_s32(vec[11], tmp);
+    vec[ 7]  = vsubq_s32(vec[13], tmp);
+    vec[ 9]  = vsubq_s32(vec[13], tmp4);
+    vec[11]  = vsubq_s32(vec[15], tmp4);
+    vec[13]  = vsubq_s32(vec[15], tmp3);
+    vec[15]  = vsubq_s32(vec[17], tmp3);
+
+
+    /* overlap and add */
+
+    tmp2 = vec[0];
+    tmp3 = vec[9];
+
+    for (i = 0; i < 6; i++)
+    {
+        tmp  = history[ i];
+        tmp4 = vec[i+10];
+        vec[i+10] = vaddq_s32(tmp3, tmp4);
+        tmp1 = vec[i+1];
+        vec[ i] = vaddq_s32(tmp, mul_q32(vec[i+10], window[ i]));
+        tmp3 = tmp4;
+        history[i  ] = vnegq_s32(vaddq_s32(tmp2, tmp1));
+        tmp2 = tmp1;
+    }
+
+    tmp  = history[ 6];
+    tmp4 = vec[16];
+    vec[16] = vaddq_s32(tmp3, tmp4);
+    tmp1 = vec[7];
+    vec[ 6] = mac_q32_x2(tmp, vec[16], window[ 6]);
+    tmp  = history[ 7];
+    history[6] = vnegq_s32(vaddq_s32(tmp2, tmp1));
+    history[7] = vnegq_s32(vaddq_s32(tmp1, vec[8]));
+
+    tmp1    = history[ 8];
+    tmp4    = vaddq_s32(vec[17], tmp4);
+    vec[ 7] = mac_q32_x2(tmp, tmp4, window[ 7]);
+    history[8] = vnegq_s32(vaddq_s32(vec[8], vec[9]));
+    vec[ 8] = mac_q32_x2(tmp1, vec[17], window[ 8]);
+
+    tmp  = history[9];
+    tmp1 = history[17];
+    tmp2 = history[16];
+    vec[ 9] = mac_q32_x2(tmp,  vec[17], window[ 9]);
+
+    vec[17] = mac_q32_x2(tmp1, vec[10], window[17]);
+    vec[10] = vnegq_s32(vec[16]);
+    vec[16] = mac_q32_x2(tmp2, vec[11], window[16]);
+    tmp1 = history[15];
+    tmp2 = history[14];
+    vec[11] = vnegq_s32(vec[15]);
+    vec[15] = mac_q32_x2(tmp1, vec[12], window[15]);
+    vec[12] = vnegq_s32(vec[14]);
+    vec[14] = mac_q32_x2(tmp2, vec[13], window[14]);
+
+    tmp  = history[13];
+    tmp1 = history[12];
+    tmp2 = history[11];
+    tmp3 = history[10];
+    vec[13] = mac_q32_x2(tmp,  vec[12], window[13]);
+    vec[12] = mac_q32_x2(tmp1, vec[11], window[12]);
+    vec[11] = mac_q32_x2(tmp2, vec[10], window[11]);
+    vec[10] = mac_q32_x2(tmp3,    tmp4, window[10]);
+
+
+    /* next iteration overlap */
+
+    tmp1 = vshlq_n_s32(history[ 8], 1);
+    tmp3 = vshlq_n_s32(history[ 7], 1);
+    tmp2 = vshlq_n_s32(history[ 1], 1);
+    tmp  = vshlq_n_s32(history[ 0], 1);
+
+    history[ 0] = mul_q32(tmp1, window[18]);
+    history[17] = mul_q32(tmp1, window[35]);
+    history[ 1] = mul_q32(tmp3, window[19]);
+    history[16] = mul_q32(tmp3, window[34]);
+
+    history[ 7] = mul_q32(tmp2, window[25]);
+    history[10] = mul_q32(tmp2, window[28]);
+    history[ 8] = mul_q32(tmp,  window[26]);
+    history[ 9] = mul_q32(tmp,  window[27]);
+
+    tmp1 = vshlq_n_s32(history[ 6], 1);
+    tmp3 = vshlq_n_s32(history[ 5], 1);
+    tmp4 = vshlq_n_s32(history[ 4], 1);
+    tmp2 = vshlq_n_s32(history[ 3], 1);
+    tmp  = vshlq_n_s32(history[ 2], 1);
+
+    history[ 2] = mul_q32(tmp1, window[20]);
+    history[15] = mul_q32(tmp1, window[33]);
+    history[ 3] = mul_q32(tmp3, window[21]);
+    history[14] = mul_q32(tmp3, window[32]);
+    history[ 4] = mul_q32(tmp4, window[22]);
+    history[13] = mul_q32(tmp4, window[31]);
+    history[ 5] = mul_q32(tmp2, window[23]);
+    history[12] = mul_q32(tmp2, window[30]);
+    history[ 6] = mul_q32(tmp,  window[24]);
+    history[11] = mul_q32(tmp,  window[29]);
+
+    store_4_bands(vec_in, vec);
+    store_4_bands(history_in, history);
+}
@@ -134,6 +134,46 @@ void pvmp3_poly_phase_synthesis(tmp3dec_chan   *pChVars,
 
     int16 * ptr_out = outPcm;
 
+#ifdef MP3DEC_NEON
+
+    /*
+     *   The DCT 32 of a time slot only changes its own 32 values and the
+     *   window only reads those of the current and previous slots, so all
+     *   the DCTs are done first, 4 slots at a time
+     */
+
+    int32 *inData  = &pChVars->circ_buffer[544];
+    int32  band;
+
+    for (band = 0; band + 4 <= FILTERBANK_BANDS; band += 4)
+    {
+        pvmp3_dct_32_x4(inData);
+
+        inData  -= SUBBANDS_NUMBER << 2;
+    }
+
+    for (; band < FILTERBANK_BANDS; band++)
+    {
+        pvmp3_split(&inData[16]);
+
+        pvmp3_dct_16(&inData[16], 0);
+        pvmp3_dct_16(inData, 1);     // Even terms
+
+        pvmp3_merge_in_place_N32(inData);
+
+        inData  -= SUBBANDS_NUMBER;
+    }
+
+    for (band = 0; band < FILTERBANK_BANDS; band++)
+    {
+        pvmp3_polyphase_filter_window(&pChVars->circ_buffer[544 - (band<<5)],
+                                      ptr_out,
+                                      numChannels);
+
+        ptr_out += (numChannels << 5);
+    }
+
+#else
 
     for (int32  band = 0; band < FILTERBANK_BANDS; band += 2)
     {
@@ -177,6 +217,8 @@ void pvmp3_poly_phase_synthesis(tmp3dec_chan   *pChVars,
 
     }/* end band loop */
 
+#endif
+
     pv_memmove(&pChVars->circ_buffer[576],
                pChVars->circ_buffer,
                480*sizeof(*pChVars->circ_buffer));
@@ -0,0 +1,144 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "pvmp3_polyphase_filter_window.h"
+#include "pv_mp3dec_fxd_op.h"
+#include "pvmp3_dec_defs.h"
+#include "pvmp3_tables.h"
+
+#include <arm_neon.h>
+
+/* NEON version of pvmp3_polyphase_filter_window() in
+   pvmp3_polyphase_filter_window.cpp. The output samples j and 32 - j are
+   computed for 4 consecutive j at a time, one lane per j. Like
+   fxp_mac32_Q32(), each product is truncated to its upper 32 bits before
+   it is accumulated, and a sum of 32-bit terms does not depend on the
+   order of the additions, so the output is identical. */
+
+static inline int32x4_t mul_q32(int32x4_t a, int32x4_t b)
+{
+    int64x2_t lo = vmull_s32(vget_low_s32(a), vget_low_s32(b));
+    int64x2_t hi = vmull_s32(vget_high_s32(a), vget_high_s32(b));
+
+    return vcombine_s32(vshrn_n_s64(lo, 32), vshrn_n_s64(hi, 32));
+}
+
+/* p[3], p[2], p[1], p[0] */
+static inline int32x4_t load_reversed(const int32 *p)
+{
+    int32x4_t v = vrev64q_s32(vld1q_s32(p));
+
+    return vcombine_s32(vget_high_s32(v), vget_low_s32(v));
+}
+
+void pvmp3_polyphase_filter_window(int32 *synth_buffer,
+                                   int16 *outPcm,
+                                   int32 numChannels)
+{
+    /* j = 1..15 as 4 groups of 4, the last one overlaps the third at j = 12 */
+    static const int32 first_j[4] = { 1, 5, 9, 12 };
+    int32 sum1;
+    int32 sum2;
+    const int32 *winPtr;
+    int32 i;
+
+    for (int32 g = 0; g < 4; g++)
+    {
+        int32 j0 = first_j[g];
+        const int32 *win  = &pqmfSynthWin[(j0 - 1) << 4];
+        const int32 *pt_1 = &synth_buffer[(SUBBANDS_NUMBER >> 1) + j0];
+        const int32 *pt_2 = &synth_buffer[(SUBBANDS_NUMBER >> 1) - j0 - 3];
+        int32x4_t acc1 = vdupq_n_s32(0x00000020);
+        int32x4_t acc2 = vdupq_n_s32(0x00000020);
+        int16 out1[4];
+        int16 out2[4];
+
+        for (i = 0; i < 4; i++)
+        {
+            /* the 4 window coefficients of each j, transposed to one vector
+               per coefficient */
+            int32x4x2_t t0 = vtrnq_s32(vld1q_s32(win +  0), vld1q_s32(win + 16));
+            int32x4x2_t t1 = vtrnq_s32(vld1q_s32(win + 32), vld1q_s32(win + 48));
+            int32x4_t w0 = vcombine_s32(vget_low_s32(t0.val[0]), vget_low_s32(t1.val[0]));
+            int32x4_t w1 = vcombine_s32(vget_low_s32(t0.val[1]), vget_low_s32(t1.val[1]));
+            int32x4_t w2 = vcombine_s32(vget_high_s32(t0.val[0]), vget_high_s32(t1.val[0]));
+            int32x4_t w3 = vcombine_s32(vget_high_s32(t0.val[1]), vget_high_s32(t1.val[1]));
+
+            int32x4_t temp1 = vld1q_s32(&pt_1[SUBBANDS_NUMBER * (2 * i)]);
+            int32x4_t temp3 = load_reversed(&pt_2[SUBBANDS_NUMBER * (15 - 2 * i)]);
+            int32x4_t temp2 = load_reversed(&pt_2[SUBBANDS_NUMBER * (2 * i + 1)]);
+            int32x4_t temp4 = vld1q_s32(&pt_1[SUBBANDS_NUMBER * (14 - 2 * i)]);
+
+            acc1 = vaddq_s32(acc1, mul_q32(temp1, w0));
+            acc1 = vsubq_s32(acc1, mul_q32(temp3, w1));
+            acc1 = vaddq_s32(acc1, mul_q32(temp2, w2));
+            acc1 = vaddq_s32(acc1, mul_q32(temp4, w3));
+
+            acc2 = vaddq_s32(acc2, mul_q32(temp3, w0));
+            acc2 = vaddq_s32(acc2, mul_q32(temp1, w1));
+            acc2 = vsubq_s32(acc2, mul_q32(temp4, w2));
+            acc2 = vaddq_s32(acc2, mul_q32(temp2, w3));
+
+            win += 4;
+        }
+
+        /* saturate16(sum >> 6) */
+        vst1_s16(out1, vqshrn_n_s32(acc1, 6));
+        vst1_s16(out2, vqshrn_n_s32(acc2, 6));
+
+        for (i = 0; i < 4; i++)
+        {
+            int32 k = (j0 + i) << (numChannels - 1);
+            outPcm[k] = out1[i];
+            outPcm[(numChannels<<5) - k] = out2[i];
+        }
+    }
+
+
+
+    winPtr = &pqmfSynthWin[(SUBBANDS_NUMBER / 2 - 1) << 4];
+
+    sum1 = 0x00000020;
+    sum2 = 0x00000020;
+
+
+    for (i = 16; i < HAN_SIZE + 16; i += (SUBBANDS_NUMBER << 2))
+    {
+        int32 *pt_synth = &synth_buffer[i];
+        int32 temp1 = pt_synth[ 0                ];
+        int32 temp2 = pt_synth[ SUBBANDS_NUMBER  ];
+        int32 temp3 = pt_synth[ SUBBANDS_NUMBER/2];
+
+        sum1 = fxp_mac32_Q32(sum1, temp1, winPtr[0]) ;
+        sum1 = fxp_mac32_Q32(sum1, temp2, winPtr[1]) ;
+        sum2 = fxp_mac32_Q32(sum2, temp3, winPtr[2]) ;
+
+        temp1 = pt_synth[ SUBBANDS_NUMBER<<1 ];
+        temp2 = pt_synth[ 3*SUBBANDS_NUMBER  ];
+        temp3 = pt_synth[ SUBBANDS_NUMBER*5/2];
+
+        sum1 = fxp_mac32_Q32(sum1, temp1, winPtr[3]) ;
+        sum1 = fxp_mac32_Q32(sum1, temp2, winPtr[4]) ;
+        sum2 = fxp_mac32_Q32(sum2, temp3, winPtr[5]) ;
+
+        winPtr += 6;
+    }
+
+
+    outPcm[0] = saturate16(sum1 >> 6);
+    outPcm[(SUBBANDS_NUMBER/2)<<(numChannels-1)] = saturate16(sum2 >> 6);
+}
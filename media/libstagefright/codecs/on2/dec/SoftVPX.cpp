@@ -85,6 +85,10 @@ status_t SoftVPX::initDecoder() {
     return OK;
 }
 
+bool SoftVPX::supportsNativeBuffers() const {
+    return true;
+}
+
 void SoftVPX::onQueueFilled(OMX_U32 portIndex) {
     if (mOutputPortSettingsChange != NONE) {
         return;
@@ -139,45 +143,23 @@ void SoftVPX::onQueueFilled(OMX_U32 portIndex) {
             uint32_t width = img->d_w;
             uint32_t height = img->d_h;
 
-            if (width != mWidth || height != mHeight) {
-                mWidth = width;
-                mHeight = height;
-
-                updatePortDefinitions();
-
-                notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
-                mOutputPortSettingsChange = AWAITING_DISABLED;
+            if (handlePortSettingsChange(width, height)) {
                 return;
             }
 
             outHeader->nOffset = 0;
-            outHeader->nFilledLen = (width * height * 3) / 2;
             outHeader->nFlags = EOSseen ? OMX_BUFFERFLAG_EOS : 0;
             outHeader->nTimeStamp = inHeader->nTimeStamp;
 
-            const uint8_t *srcLine = (const uint8_t *)img->planes[PLANE_Y];
-            uint8_t *dst = outHeader->pBuffer;
-            for (size_t i = 0; i < img->d_h; ++i) {
-                memcpy(dst, srcLine, img->d_w);
-
-                srcLine += img->stride[PLANE_Y];
-                dst += img->d_w;
-            }
-
-            srcLine = (const uint8_t *)img->planes[PLANE_U];
-            for (size_t i = 0; i < img->d_h / 2; ++i) {
-                memcpy(dst, srcLine, img->d_w / 2);
-
-                srcLine += img->stride[PLANE_U];
-                dst += img->d_w / 2;
-            }
-
-            srcLine = (const uint8_t *)img->planes[PLANE_V];
-            for (size_t i = 0; i < img->d_h / 2; ++i) {
-                memcpy(dst, srcLine, img->d_w / 2);
-
-                srcLine += img->stride[PLANE_V];
-                dst += img->d_w / 2;
+            if (copyPictureToOutput(
+                        outInfo,
+                        (const uint8_t *)img->planes[PLANE_Y],
+                        img->stride[PLANE_Y],
+                        (const uint8_t *)img->planes[PLANE_U],
+                        (const uint8_t *)img->planes[PLANE_V],
+                        img->stride[PLANE_U]) != OK) {
+                notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+                return;
             }
 
             outInfo->mOwnedByUs = false;
@@ -34,6 +34,7 @@ protected:
     virtual ~SoftVPX();
 
     virtual void onQueueFilled(OMX_U32 portIndex);
+    virtual bool supportsNativeBuffers() const;
 
 private:
     enum {
@@ -217,12 +217,10 @@ void SoftAVC::onQueueFilled(OMX_U32 portIndex) {
 
 bool SoftAVC::handlePortSettingChangeEvent(const H264SwDecInfo *info) {
     if (mWidth != info->picWidth || mHeight != info->picHeight) {
-        mWidth  = info->picWidth;
-        mHeight = info->picHeight;
+        // In adaptive playback mode this only changes the crop rectangle,
+        // the first picture at the new size is held back the same way.
+        handlePortSettingsChange(info->picWidth, info->picHeight);
         mPictureSize = mWidth * mHeight * 3 / 2;
-        updatePortDefinitions();
-        notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
-        mOutputPortSettingsChange = AWAITING_DISABLED;
         return true;
     }
 
@@ -247,6 +245,10 @@ bool SoftAVC::handleCropRectEvent(const CropParams *crop) {
     return false;
 }
 
+bool SoftAVC::supportsNativeBuffers() const {
+    return true;
+}
+
 void SoftAVC::saveFirstOutputBuffer(int32_t picId, uint8_t *data) {
     CHECK(mFirstPicture == NULL);
     mFirstPictureId = picId;
@@ -263,9 +265,15 @@ void SoftAVC::drainOneOutputBuffer(int32_t picId, uint8_t* data) {
     OMX_BUFFERHEADERTYPE *header = mPicToHeaderMap.valueFor(picId);
     outHeader->nTimeStamp = header->nTimeStamp;
     outHeader->nFlags = header->nFlags;
-    outHeader->nFilledLen = mPictureSize;
-    memcpy(outHeader->pBuffer + outHeader->nOffset,
-            data, mPictureSize);
+
+    const uint8_t *srcU = data + mWidth * mHeight;
+    const uint8_t *srcV = srcU + (mWidth / 2) * (mHeight / 2);
+    if (copyPictureToOutput(
+                outInfo, data, mWidth, srcU, srcV, mWidth / 2) != OK) {
+        notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+        mSignalledError = true;
+    }
+
     mPicToHeaderMap.removeItem(picId);
     delete header;
     outInfo->mOwnedByUs = false;
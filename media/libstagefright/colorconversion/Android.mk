@@ -5,6 +5,11 @@ LOCAL_SRC_FILES:=                     \
         ColorConverter.cpp            \
         SoftwareRenderer.cpp
 
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_SRC_FILES += ColorConverterNEON.cpp.neon
+LOCAL_CFLAGS += -DCOLOR_CONVERTER_NEON
+endif
+
 LOCAL_C_INCLUDES := \
         $(TOP)/frameworks/native/include/media/openmax \
         $(TOP)/hardware/msm7k
@@ -24,6 +24,15 @@
 
 namespace android {
 
+#ifdef COLOR_CONVERTER_NEON
+// In ColorConverterNEON.cpp; converts a multiple of 16 pixels from the
+// start of the row and returns how many it did.
+size_t convertRowNEON(
+        const uint8_t *y, const uint8_t *u, const uint8_t *v,
+        size_t yStep, size_t chromaStep, bool swapRB, bool rgba,
+        void *dst, size_t width);
+#endif
+
 ColorConverter::ColorConverter(
         OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to)
     : mSrcFormat(from),
@@ -37,7 +46,10 @@ ColorConverter::~ColorConverter() {
 }
 
 bool ColorConverter::isValid() const {
-    if (mDstFormat != OMX_COLOR_Format16bitRGB565) {
+    // OMX_COLOR_Format32bitARGB8888 output is stored as R, G, B, A bytes,
+    // the RGBA_8888 layout of surfaces and Skia bitmaps.
+    if (mDstFormat != OMX_COLOR_Format16bitRGB565
+            && mDstFormat != OMX_COLOR_Format32bitARGB8888) {
         return false;
     }
 
@@ -85,7 +97,7 @@ status_t ColorConverter::convert(
         size_t dstWidth, size_t dstHeight,
         size_t dstCropLeft, size_t dstCropTop,
         size_t dstCropRight, size_t dstCropBottom) {
-    if (mDstFormat != OMX_COLOR_Format16bitRGB565) {
+    if (!isValid()) {
         return ERROR_UNSUPPORTED;
     }
 
@@ -99,411 +111,233 @@ status_t ColorConverter::convert(
             dstWidth, dstHeight,
             dstCropLeft, dstCropTop, dstCropRight, dstCropBottom);
 
-    status_t err;
-
-    switch (mSrcFormat) {
-        case OMX_COLOR_FormatYUV420Planar:
-            err = convertYUV420Planar(src, dst);
-            break;
-
-        case OMX_COLOR_FormatCbYCrY:
-            err = convertCbYCrY(src, dst);
-            break;
-
-        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
-            err = convertQCOMYUV420SemiPlanar(src, dst);
-            break;
-
-        case OMX_COLOR_FormatYUV420SemiPlanar:
-            err = convertYUV420SemiPlanar(src, dst);
-            break;
-
-        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
-            err = convertTIYUV420PackedSemiPlanar(src, dst);
-            break;
-
-        default:
-        {
-            CHECK(!"Should not be here. Unknown color conversion.");
-            break;
-        }
+    if ((src.mCropLeft & 1) != 0) {
+        return ERROR_UNSUPPORTED;
     }
 
-    return err;
-}
-
-status_t ColorConverter::convertCbYCrY(
-        const BitmapParams &src, const BitmapParams &dst) {
-    // XXX Untested
-
-    uint8_t *kAdjustedClip = initClip();
-
-    if (!((src.mCropLeft & 1) == 0
-        && src.cropWidth() == dst.cropWidth()
-        && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
+    if (src.cropWidth() != dst.cropWidth()
+            || src.cropHeight() != dst.cropHeight()) {
+        return convertScaled(src, dst);
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    size_t bpp = dstBytesPerPixel();
 
-    const uint8_t *src_ptr = (const uint8_t *)src.mBits
-        + (src.mCropTop * dst.mWidth + src.mCropLeft) * 2;
+    uint8_t *dst_ptr = (uint8_t *)dst.mBits
+        + (dst.mCropTop * dst.mWidth + dst.mCropLeft) * bpp;
 
+    YUVRow row;
     for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_ptr[2 * x + 1] - 16;
-            signed y2 = (signed)src_ptr[2 * x + 3] - 16;
-            signed u = (signed)src_ptr[2 * x] - 128;
-            signed v = (signed)src_ptr[2 * x + 2] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+        getRow(src, y, &row);
+        convertRow(row, src.cropWidth(), dst_ptr);
 
-        src_ptr += src.mWidth * 2;
-        dst_ptr += dst.mWidth;
+        dst_ptr += dst.mWidth * bpp;
     }
 
     return OK;
 }
 
-status_t ColorConverter::convertYUV420Planar(
+// Nearest neighbour scaling, converting only the source rows that are
+// sampled, each of them once, so there is no full size intermediate.
+status_t ColorConverter::convertScaled(
         const BitmapParams &src, const BitmapParams &dst) {
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
-    }
-
-    uint8_t *kAdjustedClip = initClip();
-
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
-
-    const uint8_t *src_y =
-        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+    size_t srcWidth = src.cropWidth();
+    size_t srcHeight = src.cropHeight();
+    size_t dstWidth = dst.cropWidth();
+    size_t dstHeight = dst.cropHeight();
+    size_t bpp = dstBytesPerPixel();
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * (src.mWidth / 2) + src.mCropLeft / 2;
+    uint8_t *line = new uint8_t[srcWidth * bpp];
+    size_t *srcX = new size_t[dstWidth];
 
-    const uint8_t *src_v =
-        src_u + (src.mWidth / 2) * (src.mHeight / 2);
+    for (size_t x = 0; x < dstWidth; ++x) {
+        srcX[x] = ((2 * x + 1) * srcWidth) / (2 * dstWidth);
+    }
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
-            // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
-            // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
-
-            // B = 298/256 * (Y - 16) + 517/256 * (U - 128)
-            // G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
-            // R = .................. + 409/256 * (V - 128)
-
-            // min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
-            // min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
-            // min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
-
-            // max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
-            // max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
-            // max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
-
-            // clip range -278 .. 535
-
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x / 2] - 128;
-            signed v = (signed)src_v[x / 2] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
+    uint8_t *dst_ptr = (uint8_t *)dst.mBits
+        + (dst.mCropTop * dst.mWidth + dst.mCropLeft) * bpp;
+
+    size_t lastSrcY = srcHeight;
+    YUVRow row;
+    for (size_t y = 0; y < dstHeight; ++y) {
+        size_t srcY = ((2 * y + 1) * srcHeight) / (2 * dstHeight);
+
+        if (srcY == lastSrcY) {
+            memcpy(dst_ptr, dst_ptr - dst.mWidth * bpp, dstWidth * bpp);
+        } else {
+            getRow(src, srcY, &row);
+            convertRow(row, srcWidth, line);
+
+            if (bpp == 2) {
+                const uint16_t *in = (const uint16_t *)line;
+                uint16_t *out = (uint16_t *)dst_ptr;
+                for (size_t x = 0; x < dstWidth; ++x) {
+                    out[x] = in[srcX[x]];
+                }
             } else {
-                dst_ptr[x] = rgb1;
+                const uint32_t *in = (const uint32_t *)line;
+                uint32_t *out = (uint32_t *)dst_ptr;
+                for (size_t x = 0; x < dstWidth; ++x) {
+                    out[x] = in[srcX[x]];
+                }
             }
-        }
-
-        src_y += src.mWidth;
 
-        if (y & 1) {
-            src_u += src.mWidth / 2;
-            src_v += src.mWidth / 2;
+            lastSrcY = srcY;
         }
 
-        dst_ptr += dst.mWidth;
+        dst_ptr += dst.mWidth * bpp;
     }
 
+    delete[] srcX;
+    delete[] line;
+
     return OK;
 }
 
-status_t ColorConverter::convertQCOMYUV420SemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
+size_t ColorConverter::dstBytesPerPixel() const {
+    return (mDstFormat == OMX_COLOR_Format16bitRGB565) ? 2 : 4;
+}
 
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
-    }
+void ColorConverter::getRow(
+        const BitmapParams &src, size_t y, YUVRow *row) const {
+    const uint8_t *bits = (const uint8_t *)src.mBits;
+    size_t lumaRow = src.mCropTop + y;
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    row->mYStep = 1;
+    row->mChromaStep = 1;
+    row->mSwapRB = false;
 
-    const uint8_t *src_y =
-        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+    switch (mSrcFormat) {
+        case OMX_COLOR_FormatYUV420Planar:
+        {
+            row->mY = bits + lumaRow * src.mWidth + src.mCropLeft;
+            row->mU = bits + src.mWidth * src.mHeight
+                + (lumaRow / 2) * (src.mWidth / 2) + src.mCropLeft / 2;
+            row->mV = row->mU + (src.mWidth / 2) * (src.mHeight / 2);
+            break;
+        }
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * src.mWidth + src.mCropLeft;
+        case OMX_COLOR_FormatCbYCrY:
+        {
+            row->mU = bits + (lumaRow * src.mWidth + src.mCropLeft) * 2;
+            row->mY = row->mU + 1;
+            row->mV = row->mU + 2;
+            row->mYStep = 2;
+            row->mChromaStep = 4;
+            break;
+        }
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+        {
+            const uint8_t *uv = bits + src.mWidth * src.mHeight
+                + (lumaRow / 2) * src.mWidth + src.mCropLeft;
+
+            // These have always been read with the QCOM one taking U first
+            // and the other V first, and both with R and B swapped.
+            row->mY = bits + lumaRow * src.mWidth + src.mCropLeft;
+            if (mSrcFormat == OMX_QCOM_COLOR_FormatYVU420SemiPlanar) {
+                row->mU = uv;
+                row->mV = uv + 1;
             } else {
-                dst_ptr[x] = rgb1;
+                row->mV = uv;
+                row->mU = uv + 1;
             }
+            row->mChromaStep = 2;
+            row->mSwapRB = true;
+            break;
         }
 
-        src_y += src.mWidth;
-
-        if (y & 1) {
-            src_u += src.mWidth;
+        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+        {
+            // The buffer starts at the top of the crop.
+            row->mY = bits + y * src.mWidth;
+            row->mU = bits + src.mWidth * (src.mHeight - src.mCropTop / 2)
+                + (y / 2) * src.mWidth;
+            row->mV = row->mU + 1;
+            row->mChromaStep = 2;
+            break;
         }
 
-        dst_ptr += dst.mWidth;
+        default:
+        {
+            CHECK(!"Should not be here. Unknown color conversion.");
+            break;
+        }
     }
-
-    return OK;
 }
 
-status_t ColorConverter::convertYUV420SemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    // XXX Untested
-
-    uint8_t *kAdjustedClip = initClip();
-
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
+static inline void putPixel(
+        const uint8_t *kAdjustedClip, signed tmp,
+        signed u_b, signed uv_g, signed v_r,
+        bool swapRB, bool rgba, void *dst, size_t x) {
+    uint8_t r = kAdjustedClip[(tmp + v_r) / 256];
+    uint8_t g = kAdjustedClip[(tmp + uv_g) / 256];
+    uint8_t b = kAdjustedClip[(tmp + u_b) / 256];
+
+    if (swapRB) {
+        uint8_t t = r;
+        r = b;
+        b = t;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
-
-    const uint8_t *src_y =
-        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
-
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * src.mWidth + src.mCropLeft;
-
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed v = (signed)src_u[x & ~1] - 128;
-            signed u = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
-
-        src_y += src.mWidth;
-
-        if (y & 1) {
-            src_u += src.mWidth;
-        }
-
-        dst_ptr += dst.mWidth;
+    if (rgba) {
+        uint8_t *out = (uint8_t *)dst + 4 * x;
+        out[0] = r;
+        out[1] = g;
+        out[2] = b;
+        out[3] = 0xff;
+    } else {
+        ((uint16_t *)dst)[x] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
     }
-
-    return OK;
 }
 
-status_t ColorConverter::convertTIYUV420PackedSemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
+void ColorConverter::convertRow(const YUVRow &row, size_t width, void *dst) {
     uint8_t *kAdjustedClip = initClip();
+    bool rgba = (mDstFormat == OMX_COLOR_Format32bitARGB8888);
+    size_t x = 0;
 
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
-    }
+#ifdef COLOR_CONVERTER_NEON
+    x = convertRowNEON(
+            row.mY, row.mU, row.mV, row.mYStep, row.mChromaStep,
+            row.mSwapRB, rgba, dst, width);
+#endif
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    for (; x < width; x += 2) {
+        // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
+        // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
+        // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
 
-    const uint8_t *src_y = (const uint8_t *)src.mBits;
+        // B = 298/256 * (Y - 16) + 517/256 * (U - 128)
+        // G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
+        // R = .................. + 409/256 * (V - 128)
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * (src.mHeight - src.mCropTop / 2);
+        // min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
+        // min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
+        // min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+        // max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
+        // max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
+        // max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
 
-        src_y += src.mWidth;
+        // clip range -278 .. 535
 
-        if (y & 1) {
-            src_u += src.mWidth;
-        }
+        signed u = (signed)row.mU[(x / 2) * row.mChromaStep] - 128;
+        signed v = (signed)row.mV[(x / 2) * row.mChromaStep] - 128;
 
-        dst_ptr += dst.mWidth;
-    }
+        signed u_b = u * 517;
+        signed uv_g = -u * 100 - v * 208;
+        signed v_r = v * 409;
 
-    return OK;
+        signed y1 = (signed)row.mY[x * row.mYStep] - 16;
+        putPixel(kAdjustedClip, y1 * 298, u_b, uv_g, v_r,
+                row.mSwapRB, rgba, dst, x);
+
+        if (x + 1 < width) {
+            signed y2 = (signed)row.mY[(x + 1) * row.mYStep] - 16;
+            putPixel(kAdjustedClip, y2 * 298, u_b, uv_g, v_r,
+                    row.mSwapRB, rgba, dst, x + 1);
+        }
+    }
 }
 
 uint8_t *ColorConverter::initClip() {
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <arm_neon.h>
+
+namespace android {
+
+// NEON version of the loop in ColorConverter::convertRow(), 16 pixels at a
+// time. The even and odd pixels of a pair share their chroma, so they are
+// converted as two vectors of 8 lanes. The sums are the same 32 bit sums;
+// the /256 of the C code rounds towards zero and the shift here rounds
+// down, which differs only for negative sums, and those clip to 0 either
+// way, so the output is identical.
+
+struct ChromaTerms {
+    int32x4_t mB[2], mG[2], mR[2];
+};
+
+static inline void getChromaTerms(uint8x8_t u8, uint8x8_t v8, ChromaTerms *c) {
+    int16x8_t u = vreinterpretq_s16_u16(vsubl_u8(u8, vdup_n_u8(128)));
+    int16x8_t v = vreinterpretq_s16_u16(vsubl_u8(v8, vdup_n_u8(128)));
+
+    c->mB[0] = vmull_n_s16(vget_low_s16(u), 517);
+    c->mB[1] = vmull_n_s16(vget_high_s16(u), 517);
+    c->mG[0] = vmlal_n_s16(
+            vmull_n_s16(vget_low_s16(u), -100), vget_low_s16(v), -208);
+    c->mG[1] = vmlal_n_s16(
+            vmull_n_s16(vget_high_s16(u), -100), vget_high_s16(v), -208);
+    c->mR[0] = vmull_n_s16(vget_low_s16(v), 409);
+    c->mR[1] = vmull_n_s16(vget_high_s16(v), 409);
+}
+
+static inline uint8x8_t clip(int32x4_t lo, int32x4_t hi) {
+    return vqmovun_s16(vcombine_s16(vshrn_n_s32(lo, 8), vshrn_n_s32(hi, 8)));
+}
+
+static inline void convert8(
+        uint8x8_t y8, const ChromaTerms &c, bool swapRB,
+        uint8x8_t *r, uint8x8_t *g, uint8x8_t *b) {
+    int16x8_t y = vreinterpretq_s16_u16(vsubl_u8(y8, vdup_n_u8(16)));
+    int32x4_t lo = vmull_n_s16(vget_low_s16(y), 298);
+    int32x4_t hi = vmull_n_s16(vget_high_s16(y), 298);
+
+    *r = clip(vaddq_s32(lo, c.mR[0]), vaddq_s32(hi, c.mR[1]));
+    *g = clip(vaddq_s32(lo, c.mG[0]), vaddq_s32(hi, c.mG[1]));
+    *b = clip(vaddq_s32(lo, c.mB[0]), vaddq_s32(hi, c.mB[1]));
+
+    if (swapRB) {
+        uint8x8_t t = *r;
+        *r = *b;
+        *b = t;
+    }
+}
+
+static inline uint16x8_t pack565(uint8x8_t r, uint8x8_t g, uint8x8_t b) {
+    uint16x8_t rgb = vshll_n_u8(r, 8);
+    rgb = vsriq_n_u16(rgb, vshll_n_u8(g, 8), 5);
+    return vsriq_n_u16(rgb, vshll_n_u8(b, 8), 11);
+}
+
+size_t convertRowNEON(
+        const uint8_t *y, const uint8_t *u, const uint8_t *v,
+        size_t yStep, size_t chromaStep, bool swapRB, bool rgba,
+        void *dst, size_t width) {
+    enum {
+        PLANAR,
+        UV_INTERLEAVED,
+        VU_INTERLEAVED,
+        CBYCRY,
+    } layout;
+
+    if (yStep == 1 && chromaStep == 1) {
+        layout = PLANAR;
+    } else if (yStep == 1 && chromaStep == 2 && v == u + 1) {
+        layout = UV_INTERLEAVED;
+    } else if (yStep == 1 && chromaStep == 2 && u == v + 1) {
+        layout = VU_INTERLEAVED;
+    } else if (yStep == 2 && chromaStep == 4 && y == u + 1 && v == u + 2) {
+        layout = CBYCRY;
+    } else {
+        return 0;
+    }
+
+    uint8x8_t alpha = vdup_n_u8(0xff);
+    size_t x;
+    for (x = 0; x + 16 <= width; x += 16) {
+        uint8x8_t yEven, yOdd, u8, v8;
+
+        switch (layout) {
+            case PLANAR:
+            {
+                uint8x8x2_t luma = vld2_u8(y + x);
+                yEven = luma.val[0];
+                yOdd = luma.val[1];
+                u8 = vld1_u8(u + x / 2);
+                v8 = vld1_u8(v + x / 2);
+                break;
+            }
+
+            case UV_INTERLEAVED:
+            case VU_INTERLEAVED:
+            {
+                uint8x8x2_t luma = vld2_u8(y + x);
+                yEven = luma.val[0];
+                yOdd = luma.val[1];
+                if (layout == UV_INTERLEAVED) {
+                    uint8x8x2_t chroma = vld2_u8(u + x);
+                    u8 = chroma.val[0];
+                    v8 = chroma.val[1];
+                } else {
+                    uint8x8x2_t chroma = vld2_u8(v + x);
+                    v8 = chroma.val[0];
+                    u8 = chroma.val[1];
+                }
+                break;
+            }
+
+            default:
+            {
+                uint8x8x4_t cbycry = vld4_u8(u + 2 * x);
+                u8 = cbycry.val[0];
+                yEven = cbycry.val[1];
+                v8 = cbycry.val[2];
+                yOdd = cbycry.val[3];
+                break;
+            }
+        }
+
+        ChromaTerms c;
+        getChromaTerms(u8, v8, &c);
+
+        uint8x8_t rEven, gEven, bEven, rOdd, gOdd, bOdd;
+        convert8(yEven, c, swapRB, &rEven, &gEven, &bEven);
+        convert8(yOdd, c, swapRB, &rOdd, &gOdd, &bOdd);
+
+        if (rgba) {
+            uint8x8x2_t r = vzip_u8(rEven, rOdd);
+            uint8x8x2_t g = vzip_u8(gEven, gOdd);
+            uint8x8x2_t b = vzip_u8(bEven, bOdd);
+            uint8_t *out = (uint8_t *)dst + 4 * x;
+
+            uint8x8x4_t rgba0 = { { r.val[0], g.val[0], b.val[0], alpha } };
+            uint8x8x4_t rgba1 = { { r.val[1], g.val[1], b.val[1], alpha } };
+            vst4_u8(out, rgba0);
+            vst4_u8(out + 32, rgba1);
+        } else {
+            uint16x8x2_t rgb = { {
+                pack565(rEven, gEven, bEven), pack565(rOdd, gOdd, bOdd) } };
+            vst2q_u16((uint16_t *)dst + x, rgb);
+        }
+    }
+
+    return x;
+}
+
+// NEON part of deinterleaveChroma() in SoftwareRenderer.cpp.
+size_t deinterleaveChromaNEON(
+        const uint8_t *src, uint8_t *dst0, uint8_t *dst1, size_t width) {
+    size_t x;
+    for (x = 0; x + 16 <= width; x += 16) {
+        uint8x16x2_t chroma = vld2q_u8(src + 2 * x);
+        vst1q_u8(dst0 + x, chroma.val[0]);
+        vst1q_u8(dst1 + x, chroma.val[1]);
+    }
+
+    return x;
+}
+
+}  // namespace android
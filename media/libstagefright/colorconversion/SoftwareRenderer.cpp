@@ -28,6 +28,13 @@
 
 namespace android {
 
+#ifdef COLOR_CONVERTER_NEON
+// In ColorConverterNEON.cpp; splits a multiple of 16 chroma pairs from the
+// start of the row and returns how many it did.
+size_t deinterleaveChromaNEON(
+        const uint8_t *src, uint8_t *dst0, uint8_t *dst1, size_t width);
+#endif
+
 static bool runningInEmulator() {
     char prop[PROPERTY_VALUE_MAX];
     return (property_get("ro.kernel.qemu", prop, NULL) > 0);
@@ -66,6 +73,7 @@ SoftwareRenderer::SoftwareRenderer(
 
     switch (mColorFormat) {
         case OMX_COLOR_FormatYUV420Planar:
+        case OMX_COLOR_FormatYUV420SemiPlanar:
         case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
         {
             if (!runningInEmulator()) {
@@ -79,14 +87,30 @@ SoftwareRenderer::SoftwareRenderer(
         }
 
         default:
-            halFormat = HAL_PIXEL_FORMAT_RGB_565;
+        {
+            // Convert straight into the window's own format if it is 32 bit,
+            // rather than have it composed from RGB565.
+            int windowFormat;
+            if (mNativeWindow->query(
+                        mNativeWindow.get(), NATIVE_WINDOW_FORMAT,
+                        &windowFormat) == 0
+                    && (windowFormat == HAL_PIXEL_FORMAT_RGBA_8888
+                        || windowFormat == HAL_PIXEL_FORMAT_RGBX_8888)) {
+                halFormat = windowFormat;
+            } else {
+                halFormat = HAL_PIXEL_FORMAT_RGB_565;
+            }
             bufWidth = mCropWidth;
             bufHeight = mCropHeight;
 
             mConverter = new ColorConverter(
-                    mColorFormat, OMX_COLOR_Format16bitRGB565);
+                    mColorFormat,
+                    halFormat == HAL_PIXEL_FORMAT_RGB_565
+                        ? OMX_COLOR_Format16bitRGB565
+                        : OMX_COLOR_Format32bitARGB8888);
             CHECK(mConverter->isValid());
             break;
+        }
     }
 
     CHECK(mNativeWindow != NULL);
@@ -137,6 +161,21 @@ static int ALIGN(int x, int y) {
     return (x + y - 1) & ~(y - 1);
 }
 
+// Splits "width" pairs of interleaved chroma samples into two planes.
+static void deinterleaveChroma(
+        const uint8_t *src, uint8_t *dst0, uint8_t *dst1, size_t width) {
+    size_t x = 0;
+
+#ifdef COLOR_CONVERTER_NEON
+    x = deinterleaveChromaNEON(src, dst0, dst1, width);
+#endif
+
+    for (; x < width; ++x) {
+        dst0[x] = src[2 * x];
+        dst1[x] = src[2 * x + 1];
+    }
+}
+
 void SoftwareRenderer::render(
         const void *data, size_t size, void *platformPrivate) {
     ANativeWindowBuffer *buf;
@@ -164,8 +203,10 @@ void SoftwareRenderer::render(
                 buf->stride, buf->height,
                 0, 0, mCropWidth - 1, mCropHeight - 1);
     } else if (mColorFormat == OMX_COLOR_FormatYUV420Planar) {
-        const uint8_t *src_y = (const uint8_t *)data;
-        const uint8_t *src_u = (const uint8_t *)data + mWidth * mHeight;
+        const uint8_t *src_y = (const uint8_t *)data
+            + mCropTop * mWidth + mCropLeft;
+        const uint8_t *src_u = (const uint8_t *)data + mWidth * mHeight
+            + (mCropTop / 2) * (mWidth / 2) + mCropLeft / 2;
         const uint8_t *src_v = src_u + (mWidth / 2 * mHeight / 2);
 
         uint8_t *dst_y = (uint8_t *)dst;
@@ -191,6 +232,33 @@ void SoftwareRenderer::render(
             dst_u += dst_c_stride;
             dst_v += dst_c_stride;
         }
+    } else if (mColorFormat == OMX_COLOR_FormatYUV420SemiPlanar) {
+        const uint8_t *src_y = (const uint8_t *)data
+            + mCropTop * mWidth + mCropLeft;
+        const uint8_t *src_uv = (const uint8_t *)data + mWidth * mHeight
+            + (mCropTop / 2) * mWidth + (mCropLeft & ~1);
+
+        uint8_t *dst_y = (uint8_t *)dst;
+        size_t dst_y_size = buf->stride * buf->height;
+        size_t dst_c_stride = ALIGN(buf->stride / 2, 16);
+        size_t dst_c_size = dst_c_stride * buf->height / 2;
+        uint8_t *dst_v = dst_y + dst_y_size;
+        uint8_t *dst_u = dst_v + dst_c_size;
+
+        for (int y = 0; y < mCropHeight; ++y) {
+            memcpy(dst_y, src_y, mCropWidth);
+
+            src_y += mWidth;
+            dst_y += buf->stride;
+        }
+
+        for (int y = 0; y < (mCropHeight + 1) / 2; ++y) {
+            deinterleaveChroma(src_uv, dst_u, dst_v, (mCropWidth + 1) / 2);
+
+            src_uv += mWidth;
+            dst_u += dst_c_stride;
+            dst_v += dst_c_stride;
+        }
     } else {
         CHECK_EQ(mColorFormat, OMX_TI_COLOR_FormatYUV420PackedSemiPlanar);
 
@@ -216,11 +284,7 @@ void SoftwareRenderer::render(
         }
 
         for (int y = 0; y < (mCropHeight + 1) / 2; ++y) {
-            size_t tmp = (mCropWidth + 1) / 2;
-            for (size_t x = 0; x < tmp; ++x) {
-                dst_u[x] = src_uv[2 * x];
-                dst_v[x] = src_uv[2 * x + 1];
-            }
+            deinterleaveChroma(src_uv, dst_u, dst_v, (mCropWidth + 1) / 2);
 
             src_uv += mWidth;
             dst_u += dst_c_stride;
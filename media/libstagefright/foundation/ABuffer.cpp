@@ -20,15 +20,90 @@
 #include "ALooper.h"
 #include "AMessage.h"
 
+#include <utils/threads.h>
+
 namespace android {
 
+// Size classes of the pool, class i holds payloads of kMinPoolBlockSize << i bytes. Larger
+// buffers are malloc'ed.
+static const size_t kMinPoolBlockSize = 256;
+static const size_t kNumPoolClasses = 10;  // up to 128 KB
+
+// Free payloads kept per size class, beyond which they are returned to malloc.
+static const size_t kMaxPoolBytesPerClass = 256 * 1024;
+static const size_t kMinPoolBlocksPerClass = 2;
+
+// Free payloads are linked through their first word, each size class has its own lock.
+struct ABufferPool {
+    void *allocate(size_t capacity, int32_t *poolClass);
+    void release(void *data, int32_t poolClass);
+
+private:
+    struct SizeClass {
+        SizeClass() : mFree(NULL), mNumFree(0) {}
+
+        Mutex mLock;
+        void *mFree;
+        size_t mNumFree;
+    };
+
+    SizeClass mClasses[kNumPoolClasses];
+};
+
+static ABufferPool gBufferPool;
+
+void *ABufferPool::allocate(size_t capacity, int32_t *poolClass) {
+    int32_t i = 0;
+    while ((kMinPoolBlockSize << i) < capacity) {
+        if (++i == (int32_t)kNumPoolClasses) {
+            return NULL;
+        }
+    }
+
+    *poolClass = i;
+
+    SizeClass *sizeClass = &mClasses[i];
+    {
+        Mutex::Autolock autoLock(sizeClass->mLock);
+        void *data = sizeClass->mFree;
+        if (data != NULL) {
+            sizeClass->mFree = *(void **)data;
+            --sizeClass->mNumFree;
+            return data;
+        }
+    }
+
+    return malloc(kMinPoolBlockSize << i);
+}
+
+void ABufferPool::release(void *data, int32_t poolClass) {
+    size_t maxNumFree = kMaxPoolBytesPerClass / (kMinPoolBlockSize << poolClass);
+    if (maxNumFree < kMinPoolBlocksPerClass) {
+        maxNumFree = kMinPoolBlocksPerClass;
+    }
+
+    SizeClass *sizeClass = &mClasses[poolClass];
+    {
+        Mutex::Autolock autoLock(sizeClass->mLock);
+        if (sizeClass->mNumFree < maxNumFree) {
+            *(void **)data = sizeClass->mFree;
+            sizeClass->mFree = data;
+            ++sizeClass->mNumFree;
+            return;
+        }
+    }
+
+    free(data);
+}
+
 ABuffer::ABuffer(size_t capacity)
     : mData(malloc(capacity)),
       mCapacity(capacity),
       mRangeOffset(0),
       mRangeLength(capacity),
       mInt32Data(0),
-      mOwnsData(true) {
+      mOwnsData(true),
+      mPoolClass(-1) {
 }
 
 ABuffer::ABuffer(void *data, size_t capacity)
@@ -37,13 +112,33 @@ ABuffer::ABuffer(void *data, size_t capacity)
       mRangeOffset(0),
       mRangeLength(capacity),
       mInt32Data(0),
-      mOwnsData(false) {
+      mOwnsData(false),
+      mPoolClass(-1) {
+}
+
+// static
+sp<ABuffer> ABuffer::CreatePooled(size_t capacity) {
+    int32_t poolClass;
+    void *data = gBufferPool.allocate(capacity, &poolClass);
+    if (data == NULL) {
+        return new ABuffer(capacity);
+    }
+
+    sp<ABuffer> buffer = new ABuffer(data, capacity);
+    buffer->mOwnsData = true;
+    buffer->mPoolClass = poolClass;
+
+    return buffer;
 }
 
 ABuffer::~ABuffer() {
     if (mOwnsData) {
         if (mData != NULL) {
-            free(mData);
+            if (mPoolClass >= 0) {
+                gBufferPool.release(mData, mPoolClass);
+            } else {
+                free(mData);
+            }
             mData = NULL;
         }
     }
@@ -67,7 +67,10 @@ int64_t ALooper::GetNowUs() {
 }
 
 ALooper::ALooper()
-    : mRunningLocally(false) {
+    : mNumDelivered(0),
+      mTotalLatencyUs(0),
+      mMaxLatencyUs(0),
+      mRunningLocally(false) {
 }
 
 ALooper::~ALooper() {
@@ -168,9 +171,17 @@ void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
         whenUs = GetNowUs();
     }
 
-    List<Event>::iterator it = mEventQueue.begin();
-    while (it != mEventQueue.end() && (*it).mWhenUs <= whenUs) {
-        ++it;
+    // Most messages are posted without a delay and go after everything already queued, so
+    // look for the insertion point from the end. Messages due at the same time stay in the
+    // order they were posted.
+    List<Event>::iterator it = mEventQueue.end();
+    while (it != mEventQueue.begin()) {
+        List<Event>::iterator prev = it;
+        --prev;
+        if ((*prev).mWhenUs <= whenUs) {
+            break;
+        }
+        it = prev;
     }
 
     Event event;
@@ -208,6 +219,13 @@ bool ALooper::loop() {
 
         event = *mEventQueue.begin();
         mEventQueue.erase(mEventQueue.begin());
+
+        int64_t latencyUs = nowUs - whenUs;
+        ++mNumDelivered;
+        mTotalLatencyUs += latencyUs;
+        if (latencyUs > mMaxLatencyUs) {
+            mMaxLatencyUs = latencyUs;
+        }
     }
 
     gLooperRoster.deliverMessage(event.mMessage);
@@ -220,4 +238,27 @@ bool ALooper::loop() {
     return true;
 }
 
+// static
+void ALooper::DumpStats(AString *s) {
+    gLooperRoster.dumpStats(s);
+}
+
+void ALooper::dumpStats(AString *s) {
+    Mutex::Autolock autoLock(mLock);
+
+    size_t queued = 0;
+    for (List<Event>::iterator it = mEventQueue.begin();
+         it != mEventQueue.end(); ++it) {
+        ++queued;
+    }
+
+    s->append(StringPrintf(
+                " ALooper(%s): %d queued, %u delivered, latency avg %lld us max %lld us\n",
+                mName.empty() ? "ALooper" : mName.c_str(),
+                (int)queued,
+                mNumDelivered,
+                mNumDelivered > 0 ? mTotalLatencyUs / mNumDelivered : 0ll,
+                mMaxLatencyUs));
+}
+
 }  // namespace android
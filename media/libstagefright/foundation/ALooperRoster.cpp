@@ -85,6 +85,34 @@ void ALooperRoster::unregisterStaleHandlers() {
     }
 }
 
+void ALooperRoster::dumpStats(AString *s) {
+    // the loopers are released after mLock, their destructor takes it
+    Vector<sp<ALooper> > loopers;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        for (size_t i = 0; i < mHandlers.size(); ++i) {
+            sp<ALooper> looper = mHandlers.valueAt(i).mLooper.promote();
+            if (looper == NULL) {
+                continue;
+            }
+
+            size_t j = 0;
+            while (j < loopers.size() && loopers[j] != looper) {
+                ++j;
+            }
+            if (j == loopers.size()) {
+                loopers.push(looper);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < loopers.size(); ++i) {
+        loopers[i]->dumpStats(s);
+    }
+}
+
 status_t ALooperRoster::postMessage(
         const sp<AMessage> &msg, int64_t delayUs) {
     Mutex::Autolock autoLock(mLock);
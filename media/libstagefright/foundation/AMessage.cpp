@@ -88,11 +88,12 @@ void AMessage::freeItem(Item *item) {
     }
 }
 
+// The names are looked up by comparing the strings, which for the few items of a message
+// costs less than AAtomizer::Atomize() and its global lock. Only the name of a new item is
+// atomized, to give it a storage that outlives the caller's string.
 AMessage::Item *AMessage::allocateItem(const char *name) {
-    name = AAtomizer::Atomize(name);
-
     size_t i = 0;
-    while (i < mNumItems && mItems[i].mName != name) {
+    while (i < mNumItems && strcmp(mItems[i].mName, name)) {
         ++i;
     }
 
@@ -106,7 +107,7 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
         i = mNumItems++;
         item = &mItems[i];
 
-        item->mName = name;
+        item->mName = AAtomizer::Atomize(name);
     }
 
     return item;
@@ -114,12 +115,10 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
 
 const AMessage::Item *AMessage::findItem(
         const char *name, Type type) const {
-    name = AAtomizer::Atomize(name);
-
     for (size_t i = 0; i < mNumItems; ++i) {
         const Item *item = &mItems[i];
 
-        if (item->mName == name) {
+        if (!strcmp(item->mName, name)) {
             return item->mType == type ? item : NULL;
         }
     }
@@ -27,8 +27,11 @@
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -52,17 +55,100 @@ static uint64_t U64_AT(const uint8_t *ptr) {
 static const size_t kMaxUDPSize = 1500;
 static const int32_t kMaxUDPRetries = 200;
 
+static const size_t kMaxEventsPerWait = 32;
+static const size_t kMaxDatagramsPerSend = 16;
+
+// How long a session whose datagrams failed to send waits for EPOLLOUT
+// before it retries anyway.
+static const int kSendRetryDelayMs = 10;
+
+static const int64_t kLatencyReportIntervalUs = 5000000ll;
+
+// Same layout as the kernel's struct mmsghdr, which not every libc
+// declares.
+struct DatagramHeader {
+    struct msghdr mHeader;
+    unsigned int mLength;
+};
+
+// Sends up to "count" datagrams on a connected socket, using sendmmsg
+// where the kernel has it and one sendmsg per datagram otherwise. Returns
+// the number sent, or -1 with errno set if none could be.
+static int writeDatagrams(int s, DatagramHeader *msgs, size_t count) {
+#ifdef __NR_sendmmsg
+    int res = syscall(__NR_sendmmsg, s, msgs, count, 0);
+    if (res >= 0 || errno != ENOSYS) {
+        return res;
+    }
+#endif
+
+    size_t n = 0;
+    while (n < count) {
+        ssize_t nbytes = sendmsg(s, &msgs[n].mHeader, 0);
+        if (nbytes < 0) {
+            return n > 0 ? (int)n : -1;
+        }
+
+        msgs[n++].mLength = nbytes;
+    }
+
+    return (int)n;
+}
+
+// One I/O thread, it waits on its own edge triggered epoll set for the
+// sessions assigned to it. Its lock protects those sessions.
 struct ANetworkSession::NetworkThread : public Thread {
     NetworkThread(ANetworkSession *session);
 
+    status_t init();
+
+    size_t numSessions();
+    void addSession(const sp<Session> &session);
+    void removeSession(int32_t sessionID);
+
+    status_t sendRequest(
+            const sp<Session> &session, const void *data, ssize_t size,
+            bool timeValid, int64_t timeUs);
+
+    status_t sendDatagrams(
+            const sp<Session> &session, const List<sp<ABuffer> > &datagrams,
+            bool timeValid, int64_t timeUs);
+
+    status_t switchToWebSocketMode(const sp<Session> &session);
+
+    void interrupt();
+
 protected:
     virtual ~NetworkThread();
 
 private:
+    struct ClientSocket {
+        int mSocket;
+        bool mIsRTSP;
+        sp<AMessage> mNotify;
+    };
+
     ANetworkSession *mSession;
 
+    Mutex mLock;
+    int mEpollFd;
+    int mPipeFd[2];
+    bool mInterruptPending;
+
+    KeyedVector<int32_t, sp<Session> > mSessions;
+
+    // Sessions that got data to send since their last write, a session
+    // that filled its socket is left to the next EPOLLOUT instead.
+    List<int32_t> mPendingWrites;
+
     virtual bool threadLoop();
 
+    void interruptLocked();
+    void acceptClients(
+            const sp<Session> &session, List<ClientSocket> *clients);
+    void writeMore(const sp<Session> &session);
+    void readMore(const sp<Session> &session);
+
     DISALLOW_EVIL_CONSTRUCTORS(NetworkThread);
 };
 
@@ -96,16 +182,25 @@ struct ANetworkSession::Session : public RefBase {
     bool wantsToRead();
     bool wantsToWrite();
 
+    // Whether the last write filled the socket.
+    bool writeBlocked() const;
+
     status_t readMore();
     status_t writeMore();
 
     status_t sendRequest(
             const void *data, ssize_t size, bool timeValid, int64_t timeUs);
 
+    status_t sendDatagrams(
+            const List<sp<ABuffer> > &datagrams, bool timeValid, int64_t timeUs);
+
     void setMode(Mode mode);
 
     status_t switchToWebSocketMode();
 
+    size_t networkThreadIndex() const;
+    void setNetworkThreadIndex(size_t index);
+
 protected:
     virtual ~Session();
 
@@ -125,6 +220,7 @@ private:
     int mSocket;
     sp<AMessage> mNotify;
     bool mSawReceiveFailure, mSawSendFailure;
+    bool mWriteBlocked;
     int32_t mUDPRetries;
 
     List<Fragment> mOutFragments;
@@ -133,24 +229,356 @@ private:
 
     int64_t mLastStallReportUs;
 
+    // Time from the timestamp of a timed fragment to its write.
+    size_t mNumTimedFragments;
+    int64_t mTotalLatencyUs;
+    int64_t mMaxLatencyUs;
+    int64_t mLastLatencyReportUs;
+
+    size_t mNetworkThreadIndex;
+
     void notifyError(bool send, status_t err, const char *detail);
     void notify(NotificationReason reason);
 
-    void dumpFragmentStats(const Fragment &frag);
+    void onTimedFragmentSent(const Fragment &frag);
+
+    // Reports the bytes still queued, at most every 100ms.
+    void notifyNetworkStall();
 
     DISALLOW_EVIL_CONSTRUCTORS(Session);
 };
 ////////////////////////////////////////////////////////////////////////////////
 
 ANetworkSession::NetworkThread::NetworkThread(ANetworkSession *session)
-    : mSession(session) {
+    : mSession(session),
+      mEpollFd(-1),
+      mInterruptPending(false) {
+    mPipeFd[0] = mPipeFd[1] = -1;
 }
 
 ANetworkSession::NetworkThread::~NetworkThread() {
+    if (mEpollFd >= 0) {
+        close(mEpollFd);
+        mEpollFd = -1;
+    }
+
+    if (mPipeFd[0] >= 0) {
+        close(mPipeFd[0]);
+        close(mPipeFd[1]);
+        mPipeFd[0] = mPipeFd[1] = -1;
+    }
+}
+
+status_t ANetworkSession::NetworkThread::init() {
+    if (pipe(mPipeFd) != 0) {
+        mPipeFd[0] = mPipeFd[1] = -1;
+        return -errno;
+    }
+
+    status_t err = MakeSocketNonBlocking(mPipeFd[0]);
+    if (err != OK) {
+        return err;
+    }
+
+    mEpollFd = epoll_create(kMaxEventsPerWait);
+    if (mEpollFd < 0) {
+        return -errno;
+    }
+
+    // The pipe is the only fd registered with data 0, session IDs
+    // start at 1.
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = 0;
+
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mPipeFd[0], &event) < 0) {
+        return -errno;
+    }
+
+    return OK;
+}
+
+size_t ANetworkSession::NetworkThread::numSessions() {
+    Mutex::Autolock autoLock(mLock);
+    return mSessions.size();
+}
+
+void ANetworkSession::NetworkThread::addSession(const sp<Session> &session) {
+    Mutex::Autolock autoLock(mLock);
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    event.data.u32 = session->sessionID();
+
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, session->socket(), &event) < 0) {
+        ALOGE("Unable to watch socket %d, failed w/ error %d (%s)",
+              session->socket(), errno, strerror(errno));
+        return;
+    }
+
+    mSessions.add(session->sessionID(), session);
+
+    // Data may have been queued before the session had a thread.
+    if (session->wantsToWrite()) {
+        mPendingWrites.push_back(session->sessionID());
+        interruptLocked();
+    }
+}
+
+void ANetworkSession::NetworkThread::removeSession(int32_t sessionID) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mSessions.indexOfKey(sessionID);
+    if (index < 0) {
+        return;
+    }
+
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL,
+              mSessions.valueAt(index)->socket(), NULL);
+
+    mSessions.removeItemsAt(index);
+}
+
+status_t ANetworkSession::NetworkThread::sendRequest(
+        const sp<Session> &session, const void *data, ssize_t size,
+        bool timeValid, int64_t timeUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    // With data already queued the session is either pending or waiting
+    // for EPOLLOUT.
+    bool idle = !session->wantsToWrite();
+
+    status_t err = session->sendRequest(data, size, timeValid, timeUs);
+
+    if (idle && session->wantsToWrite()) {
+        mPendingWrites.push_back(session->sessionID());
+        interruptLocked();
+    }
+
+    return err;
+}
+
+status_t ANetworkSession::NetworkThread::sendDatagrams(
+        const sp<Session> &session, const List<sp<ABuffer> > &datagrams,
+        bool timeValid, int64_t timeUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    bool idle = !session->wantsToWrite();
+
+    status_t err = session->sendDatagrams(datagrams, timeValid, timeUs);
+
+    if (idle && session->wantsToWrite()) {
+        mPendingWrites.push_back(session->sessionID());
+        interruptLocked();
+    }
+
+    return err;
+}
+
+status_t ANetworkSession::NetworkThread::switchToWebSocketMode(
+        const sp<Session> &session) {
+    Mutex::Autolock autoLock(mLock);
+    return session->switchToWebSocketMode();
+}
+
+void ANetworkSession::NetworkThread::interrupt() {
+    Mutex::Autolock autoLock(mLock);
+    interruptLocked();
+}
+
+void ANetworkSession::NetworkThread::interruptLocked() {
+    if (mInterruptPending) {
+        return;
+    }
+
+    static const char dummy = 0;
+
+    ssize_t n;
+    do {
+        n = write(mPipeFd[1], &dummy, 1);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        ALOGW("Error writing to pipe (%s)", strerror(errno));
+        return;
+    }
+
+    mInterruptPending = true;
+}
+
+void ANetworkSession::NetworkThread::acceptClients(
+        const sp<Session> &session, List<ClientSocket> *clients) {
+    // Edge triggered, so accept until there's nothing left.
+    for (;;) {
+        struct sockaddr_in remoteAddr;
+        socklen_t remoteAddrLen = sizeof(remoteAddr);
+
+        int clientSocket = accept(
+                session->socket(),
+                (struct sockaddr *)&remoteAddr, &remoteAddrLen);
+
+        if (clientSocket < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno != EAGAIN) {
+                ALOGE("accept returned error %d (%s)",
+                      errno, strerror(errno));
+            }
+            break;
+        }
+
+        status_t err = MakeSocketNonBlocking(clientSocket);
+
+        if (err != OK) {
+            ALOGE("Unable to make client socket non blocking, "
+                  "failed w/ error %d (%s)",
+                  err, strerror(-err));
+
+            close(clientSocket);
+            continue;
+        }
+
+        in_addr_t addr = ntohl(remoteAddr.sin_addr.s_addr);
+
+        ALOGI("incoming connection from %d.%d.%d.%d:%d "
+              "(socket %d)",
+              (addr >> 24),
+              (addr >> 16) & 0xff,
+              (addr >> 8) & 0xff,
+              addr & 0xff,
+              ntohs(remoteAddr.sin_port),
+              clientSocket);
+
+        ClientSocket client;
+        client.mSocket = clientSocket;
+        client.mIsRTSP = session->isRTSPServer();
+        client.mNotify = session->getNotificationMessage();
+        clients->push_back(client);
+    }
+}
+
+void ANetworkSession::NetworkThread::writeMore(const sp<Session> &session) {
+    status_t err = session->writeMore();
+    if (err != OK) {
+        ALOGE("writeMore on socket %d failed w/ error %d (%s)",
+              session->socket(), err, strerror(-err));
+    }
+}
+
+void ANetworkSession::NetworkThread::readMore(const sp<Session> &session) {
+    status_t err = session->readMore();
+    if (err != OK) {
+        ALOGE("readMore on socket %d failed w/ error %d (%s)",
+              session->socket(), err, strerror(-err));
+    }
 }
 
 bool ANetworkSession::NetworkThread::threadLoop() {
-    mSession->threadLoop();
+    int timeoutMs;
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        // Sessions queueing new data interrupt the wait, so only datagrams
+        // that failed to send are left here. They are retried on EPOLLOUT,
+        // or after a short delay if the socket never signals it.
+        timeoutMs = mPendingWrites.empty() ? -1 : kSendRetryDelayMs;
+    }
+
+    struct epoll_event events[kMaxEventsPerWait];
+    int res = epoll_wait(mEpollFd, events, kMaxEventsPerWait, timeoutMs);
+
+    if (res < 0) {
+        if (errno != EINTR) {
+            ALOGE("epoll_wait failed w/ error %d (%s)",
+                  errno, strerror(errno));
+        }
+        return true;
+    }
+
+    List<ClientSocket> clients;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        for (int i = 0; i < res; ++i) {
+            uint32_t sessionID = events[i].data.u32;
+
+            if (sessionID == 0) {
+                char tmp[64];
+                ssize_t n;
+                do {
+                    n = read(mPipeFd[0], tmp, sizeof(tmp));
+                } while (n > 0 || (n < 0 && errno == EINTR));
+
+                if (n < 0 && errno != EAGAIN) {
+                    ALOGW("Error reading from pipe (%s)", strerror(errno));
+                }
+
+                mInterruptPending = false;
+                continue;
+            }
+
+            ssize_t index = mSessions.indexOfKey(sessionID);
+            if (index < 0) {
+                // Destroyed since epoll_wait returned.
+                continue;
+            }
+
+            sp<Session> session = mSessions.valueAt(index);
+
+            if (session->isRTSPServer() || session->isTCPDatagramServer()) {
+                if (events[i].events & EPOLLIN) {
+                    acceptClients(session, &clients);
+                }
+                continue;
+            }
+
+            // Writing first completes a pending connect, after which the
+            // session wants to read.
+            if ((events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                    && session->wantsToWrite()) {
+                writeMore(session);
+            }
+
+            if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                    && session->wantsToRead()) {
+                readMore(session);
+            }
+        }
+
+        List<int32_t> pendingWrites = mPendingWrites;
+        mPendingWrites.clear();
+
+        for (List<int32_t>::iterator it = pendingWrites.begin();
+                it != pendingWrites.end(); ++it) {
+            ssize_t index = mSessions.indexOfKey(*it);
+            if (index < 0) {
+                continue;
+            }
+
+            sp<Session> session = mSessions.valueAt(index);
+            if (!session->wantsToWrite() || session->writeBlocked()) {
+                continue;
+            }
+
+            writeMore(session);
+
+            if (session->wantsToWrite() && !session->writeBlocked()) {
+                mPendingWrites.push_back(*it);
+            }
+        }
+    }
+
+    // Sessions are created with the ANetworkSession's lock held, which is
+    // taken before ours.
+    while (!clients.empty()) {
+        const ClientSocket &client = *clients.begin();
+        mSession->addClientSession(
+                client.mSocket, client.mIsRTSP, client.mNotify);
+        clients.erase(clients.begin());
+    }
 
     return true;
 }
@@ -169,8 +597,14 @@ ANetworkSession::Session::Session(
       mNotify(notify),
       mSawReceiveFailure(false),
       mSawSendFailure(false),
+      mWriteBlocked(false),
       mUDPRetries(kMaxUDPRetries),
-      mLastStallReportUs(-1ll) {
+      mLastStallReportUs(-1ll),
+      mNumTimedFragments(0),
+      mTotalLatencyUs(0ll),
+      mMaxLatencyUs(0ll),
+      mLastLatencyReportUs(-1ll),
+      mNetworkThreadIndex(0) {
     if (mState == CONNECTED) {
         struct sockaddr_in localAddr;
         socklen_t localAddrLen = sizeof(localAddr);
@@ -242,6 +676,14 @@ status_t ANetworkSession::Session::switchToWebSocketMode() {
     return OK;
 }
 
+size_t ANetworkSession::Session::networkThreadIndex() const {
+    return mNetworkThreadIndex;
+}
+
+void ANetworkSession::Session::setNetworkThreadIndex(size_t index) {
+    mNetworkThreadIndex = index;
+}
+
 sp<AMessage> ANetworkSession::Session::getNotificationMessage() const {
     return mNotify;
 }
@@ -265,13 +707,18 @@ bool ANetworkSession::Session::wantsToWrite() {
             || (mState == DATAGRAM && !mOutFragments.empty()));
 }
 
+bool ANetworkSession::Session::writeBlocked() const {
+    return mWriteBlocked;
+}
+
 status_t ANetworkSession::Session::readMore() {
     if (mState == DATAGRAM) {
         CHECK_EQ(mMode, MODE_DATAGRAM);
 
-        status_t err;
-        do {
-            sp<ABuffer> buf = new ABuffer(kMaxUDPSize);
+        // Edge triggered, so read until the socket is drained.
+        status_t err = OK;
+        for (;;) {
+            sp<ABuffer> buf = ABuffer::CreatePooled(kMaxUDPSize);
 
             struct sockaddr_in remoteAddr;
             socklen_t remoteAddrLen = sizeof(remoteAddr);
@@ -283,12 +730,26 @@ status_t ANetworkSession::Session::readMore() {
                         (struct sockaddr *)&remoteAddr, &remoteAddrLen);
             } while (n < 0 && errno == EINTR);
 
-            err = OK;
-            if (n < 0) {
-                err = -errno;
-            } else if (n == 0) {
-                err = -ECONNRESET;
+            if (n < 0 && errno == EAGAIN) {
+                break;
+            }
+
+            if (n <= 0) {
+                err = (n < 0) ? -errno : -ECONNRESET;
+
+                if (!mUDPRetries) {
+                    notifyError(false /* send */, err, "Recvfrom failed.");
+                    mSawReceiveFailure = true;
+                    break;
+                }
+
+                mUDPRetries--;
+                ALOGE("Recvfrom failed, %d/%d retries left",
+                        mUDPRetries, kMaxUDPRetries);
+                err = OK;
             } else {
+                mUDPRetries = kMaxUDPRetries;
+
                 buf->setRange(0, n);
 
                 int64_t nowUs = ALooper::GetNowUs();
@@ -313,47 +774,36 @@ status_t ANetworkSession::Session::readMore() {
                 notify->setBuffer("data", buf);
                 notify->post();
             }
-        } while (err == OK);
-
-        if (err == -EAGAIN) {
-            err = OK;
-        }
-
-        if (err != OK) {
-            if (!mUDPRetries) {
-                notifyError(false /* send */, err, "Recvfrom failed.");
-                mSawReceiveFailure = true;
-            } else {
-                mUDPRetries--;
-                ALOGE("Recvfrom failed, %d/%d retries left",
-                        mUDPRetries, kMaxUDPRetries);
-                err = OK;
-            }
-        } else {
-            mUDPRetries = kMaxUDPRetries;
         }
 
         return err;
     }
 
-    char tmp[512];
+    // Edge triggered, so read until the socket is drained.
+    char tmp[4096];
     ssize_t n;
-    do {
-        n = recv(mSocket, tmp, sizeof(tmp), 0);
-    } while (n < 0 && errno == EINTR);
+    for (;;) {
+        do {
+            n = recv(mSocket, tmp, sizeof(tmp), 0);
+        } while (n < 0 && errno == EINTR);
 
-    status_t err = OK;
+        if (n <= 0) {
+            break;
+        }
 
-    if (n > 0) {
         mInBuffer.append(tmp, n);
 
 #if 0
         ALOGI("in:");
         hexdump(tmp, n);
 #endif
-    } else if (n < 0) {
+    }
+
+    status_t err = OK;
+
+    if (n < 0 && errno != EAGAIN) {
         err = -errno;
-    } else {
+    } else if (n == 0) {
         err = -ECONNRESET;
     }
 
@@ -367,7 +817,7 @@ status_t ANetworkSession::Session::readMore() {
                 break;
             }
 
-            sp<ABuffer> packet = new ABuffer(packetSize);
+            sp<ABuffer> packet = ABuffer::CreatePooled(packetSize);
             memcpy(packet->data(), mInBuffer.c_str() + 2, packetSize);
 
             int64_t nowUs = ALooper::GetNowUs();
@@ -401,7 +851,7 @@ status_t ANetworkSession::Session::readMore() {
                 notify->setInt32("reason", kWhatBinaryData);
                 notify->setInt32("channel", mInBuffer.c_str()[1]);
 
-                sp<ABuffer> data = new ABuffer(length);
+                sp<ABuffer> data = ABuffer::CreatePooled(length);
                 memcpy(data->data(), mInBuffer.c_str() + 4, length);
 
                 int64_t nowUs = ALooper::GetNowUs();
@@ -491,7 +941,7 @@ status_t ANetworkSession::Session::readMore() {
 
             // We have the full message.
 
-            sp<ABuffer> packet = new ABuffer(payloadLen);
+            sp<ABuffer> packet = ABuffer::CreatePooled(payloadLen);
             memcpy(packet->data(), &data[offset], payloadLen);
 
             if (mask != 0) {
@@ -521,66 +971,106 @@ status_t ANetworkSession::Session::readMore() {
     return err;
 }
 
-void ANetworkSession::Session::dumpFragmentStats(const Fragment &frag) {
-#if 0
+void ANetworkSession::Session::onTimedFragmentSent(const Fragment &frag) {
     int64_t nowUs = ALooper::GetNowUs();
-    int64_t delayMs = (nowUs - frag.mTimeUs) / 1000ll;
+    int64_t latencyUs = nowUs - frag.mTimeUs;
 
-    static const int64_t kMinDelayMs = 0;
-    static const int64_t kMaxDelayMs = 300;
+    ++mNumTimedFragments;
+    mTotalLatencyUs += latencyUs;
+    if (latencyUs > mMaxLatencyUs) {
+        mMaxLatencyUs = latencyUs;
+    }
 
-    const char *kPattern = "########################################";
-    size_t kPatternSize = strlen(kPattern);
+    if (mLastLatencyReportUs < 0ll) {
+        mLastLatencyReportUs = nowUs;
+    } else if (nowUs >= mLastLatencyReportUs + kLatencyReportIntervalUs) {
+        sp<AMessage> msg = mNotify->dup();
+        msg->setInt32("sessionID", mSessionID);
+        msg->setInt32("reason", kWhatSendLatency);
+        msg->setInt64("avgLatencyUs", mTotalLatencyUs / mNumTimedFragments);
+        msg->setInt64("maxLatencyUs", mMaxLatencyUs);
+        msg->post();
+
+        mNumTimedFragments = 0;
+        mTotalLatencyUs = 0ll;
+        mMaxLatencyUs = 0ll;
+        mLastLatencyReportUs = nowUs;
+    }
+}
 
-    int n = (kPatternSize * (delayMs - kMinDelayMs))
-                / (kMaxDelayMs - kMinDelayMs);
+void ANetworkSession::Session::notifyNetworkStall() {
+    int64_t nowUs = ALooper::GetNowUs();
 
-    if (n < 0) {
-        n = 0;
-    } else if ((size_t)n > kPatternSize) {
-        n = kPatternSize;
+    if (mLastStallReportUs >= 0ll && nowUs < mLastStallReportUs + 100000ll) {
+        return;
     }
 
-    ALOGI("[%lld]: (%4lld ms) %s\n",
-          frag.mTimeUs / 1000,
-          delayMs,
-          kPattern + kPatternSize - n);
-#endif
+    size_t numBytesQueued = 0;
+    for (List<Fragment>::iterator it = mOutFragments.begin();
+            it != mOutFragments.end(); ++it) {
+        numBytesQueued += (*it).mBuffer->size();
+    }
+
+    sp<AMessage> msg = mNotify->dup();
+    msg->setInt32("sessionID", mSessionID);
+    msg->setInt32("reason", kWhatNetworkStall);
+    msg->setSize("numBytesQueued", numBytesQueued);
+    msg->post();
+
+    mLastStallReportUs = nowUs;
 }
 
 status_t ANetworkSession::Session::writeMore() {
     if (mState == DATAGRAM) {
         CHECK(!mOutFragments.empty());
 
+        mWriteBlocked = false;
+
         status_t err;
         do {
-            const Fragment &frag = *mOutFragments.begin();
-            const sp<ABuffer> &datagram = frag.mBuffer;
+            DatagramHeader msgs[kMaxDatagramsPerSend];
+            struct iovec iov[kMaxDatagramsPerSend];
+
+            size_t count = 0;
+            for (List<Fragment>::iterator it = mOutFragments.begin();
+                    it != mOutFragments.end() && count < kMaxDatagramsPerSend;
+                    ++it, ++count) {
+                iov[count].iov_base = (*it).mBuffer->data();
+                iov[count].iov_len = (*it).mBuffer->size();
+
+                memset(&msgs[count], 0, sizeof(msgs[count]));
+                msgs[count].mHeader.msg_iov = &iov[count];
+                msgs[count].mHeader.msg_iovlen = 1;
+            }
 
             int n;
             do {
-                n = send(mSocket, datagram->data(), datagram->size(), 0);
+                n = writeDatagrams(mSocket, msgs, count);
             } while (n < 0 && errno == EINTR);
 
             err = OK;
 
-            if (n > 0) {
+            if (n < 0) {
+                err = -errno;
+            }
+
+            for (int i = 0; i < n; ++i) {
+                const Fragment &frag = *mOutFragments.begin();
+
                 if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
-                    dumpFragmentStats(frag);
+                    onTimedFragmentSent(frag);
                 }
 
                 mOutFragments.erase(mOutFragments.begin());
-            } else if (n < 0) {
-                err = -errno;
-            } else if (n == 0) {
-                err = -ECONNRESET;
             }
         } while (err == OK && !mOutFragments.empty());
 
         if (err == -EAGAIN) {
             if (!mOutFragments.empty()) {
                 ALOGI("%d datagrams remain queued.", mOutFragments.size());
+                notifyNetworkStall();
             }
+            mWriteBlocked = true;
             err = OK;
         }
 
@@ -623,6 +1113,8 @@ status_t ANetworkSession::Session::writeMore() {
     CHECK_EQ(mState, CONNECTED);
     CHECK(!mOutFragments.empty());
 
+    mWriteBlocked = false;
+
     ssize_t n;
     while (!mOutFragments.empty()) {
         const Fragment &frag = *mOutFragments.begin();
@@ -639,11 +1131,13 @@ status_t ANetworkSession::Session::writeMore() {
                 frag.mBuffer->offset() + n, frag.mBuffer->size() - n);
 
         if (frag.mBuffer->size() > 0) {
+            // The socket is full, EPOLLOUT follows once it drains.
+            mWriteBlocked = true;
             break;
         }
 
         if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
-            dumpFragmentStats(frag);
+            onTimedFragmentSent(frag);
         }
 
         mOutFragments.erase(mOutFragments.begin());
@@ -652,7 +1146,11 @@ status_t ANetworkSession::Session::writeMore() {
     status_t err = OK;
 
     if (n < 0) {
-        err = -errno;
+        if (errno == EAGAIN) {
+            mWriteBlocked = true;
+        } else {
+            err = -errno;
+        }
     } else if (n == 0) {
         err = -ECONNRESET;
     }
@@ -777,6 +1275,46 @@ status_t ANetworkSession::Session::sendRequest(
     return OK;
 }
 
+status_t ANetworkSession::Session::sendDatagrams(
+        const List<sp<ABuffer> > &datagrams, bool timeValid, int64_t timeUs) {
+    for (List<sp<ABuffer> >::const_iterator it = datagrams.begin();
+            it != datagrams.end(); ++it) {
+        const sp<ABuffer> &buffer = *it;
+
+        List<sp<ABuffer> >::const_iterator next = it;
+        bool last = (++next == datagrams.end());
+
+        if (mState != DATAGRAM) {
+            // Framed, and so copied.
+            status_t err = sendRequest(
+                    buffer->data(), buffer->size(), last && timeValid, timeUs);
+
+            if (err != OK) {
+                return err;
+            }
+            continue;
+        }
+
+        if (buffer->size() == 0) {
+            continue;
+        }
+
+        Fragment frag;
+
+        frag.mFlags = 0;
+        if (last && timeValid) {
+            frag.mFlags = FRAGMENT_FLAG_TIME_VALID;
+            frag.mTimeUs = timeUs;
+        }
+
+        frag.mBuffer = buffer;
+
+        mOutFragments.push_back(frag);
+    }
+
+    return OK;
+}
+
 void ANetworkSession::Session::notifyError(
         bool send, status_t err, const char *detail) {
     sp<AMessage> msg = mNotify->dup();
@@ -799,55 +1337,70 @@ void ANetworkSession::Session::notify(NotificationReason reason) {
 
 ANetworkSession::ANetworkSession()
     : mNextSessionID(1) {
-    mPipeFd[0] = mPipeFd[1] = -1;
 }
 
 ANetworkSession::~ANetworkSession() {
     stop();
 }
 
-status_t ANetworkSession::start() {
-    if (mThread != NULL) {
+status_t ANetworkSession::start(size_t numThreads) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mThreads.isEmpty() || numThreads == 0) {
         return INVALID_OPERATION;
     }
 
-    int res = pipe(mPipeFd);
-    if (res != 0) {
-        mPipeFd[0] = mPipeFd[1] = -1;
-        return -errno;
-    }
+    for (size_t i = 0; i < numThreads; ++i) {
+        sp<NetworkThread> thread = new NetworkThread(this);
 
-    mThread = new NetworkThread(this);
+        status_t err = thread->init();
 
-    status_t err = mThread->run("ANetworkSession", ANDROID_PRIORITY_AUDIO);
+        if (err == OK) {
+            err = thread->run("ANetworkSession", ANDROID_PRIORITY_AUDIO);
+        }
 
-    if (err != OK) {
-        mThread.clear();
+        if (err != OK) {
+            for (size_t j = 0; j < mThreads.size(); ++j) {
+                mThreads[j]->requestExit();
+                mThreads[j]->interrupt();
+                mThreads[j]->requestExitAndWait();
+            }
+            mThreads.clear();
 
-        close(mPipeFd[0]);
-        close(mPipeFd[1]);
-        mPipeFd[0] = mPipeFd[1] = -1;
+            return err;
+        }
 
-        return err;
+        mThreads.push(thread);
+    }
+
+    // Sessions created before, or left over from a previous start().
+    for (size_t i = 0; i < mSessions.size(); ++i) {
+        addSessionToThreadLocked(mSessions.valueAt(i));
     }
 
     return OK;
 }
 
 status_t ANetworkSession::stop() {
-    if (mThread == NULL) {
-        return INVALID_OPERATION;
-    }
+    Vector<sp<NetworkThread> > threads;
 
-    mThread->requestExit();
-    interrupt();
-    mThread->requestExitAndWait();
+    {
+        Mutex::Autolock autoLock(mLock);
 
-    mThread.clear();
+        if (mThreads.isEmpty()) {
+            return INVALID_OPERATION;
+        }
 
-    close(mPipeFd[0]);
-    close(mPipeFd[1]);
-    mPipeFd[0] = mPipeFd[1] = -1;
+        threads = mThreads;
+        mThreads.clear();
+    }
+
+    // Not under our lock, a thread may be waiting for it to add a client.
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->requestExit();
+        threads[i]->interrupt();
+        threads[i]->requestExitAndWait();
+    }
 
     return OK;
 }
@@ -937,9 +1490,12 @@ status_t ANetworkSession::destroySession(int32_t sessionID) {
         return -ENOENT;
     }
 
-    mSessions.removeItemsAt(index);
+    const sp<Session> session = mSessions.valueAt(index);
+    if (!mThreads.isEmpty()) {
+        mThreads[session->networkThreadIndex()]->removeSession(sessionID);
+    }
 
-    interrupt();
+    mSessions.removeItemsAt(index);
 
     return OK;
 }
@@ -1149,8 +1705,7 @@ status_t ANetworkSession::createClientOrServer(
     }
 
     mSessions.add(session->sessionID(), session);
-
-    interrupt();
+    addSessionToThreadLocked(session);
 
     *sessionID = session->sessionID();
 
@@ -1205,207 +1760,111 @@ status_t ANetworkSession::connectUDPSession(
 status_t ANetworkSession::sendRequest(
         int32_t sessionID, const void *data, ssize_t size,
         bool timeValid, int64_t timeUs) {
-    Mutex::Autolock autoLock(mLock);
-
-    ssize_t index = mSessions.indexOfKey(sessionID);
-
-    if (index < 0) {
-        return -ENOENT;
-    }
-
-    const sp<Session> session = mSessions.valueAt(index);
+    sp<Session> session;
+    sp<NetworkThread> thread;
 
-    status_t err = session->sendRequest(data, size, timeValid, timeUs);
+    {
+        Mutex::Autolock autoLock(mLock);
 
-    interrupt();
+        ssize_t index = mSessions.indexOfKey(sessionID);
 
-    return err;
-}
+        if (index < 0) {
+            return -ENOENT;
+        }
 
-status_t ANetworkSession::switchToWebSocketMode(int32_t sessionID) {
-    Mutex::Autolock autoLock(mLock);
+        session = mSessions.valueAt(index);
 
-    ssize_t index = mSessions.indexOfKey(sessionID);
+        if (mThreads.isEmpty()) {
+            // Sent once a thread picks the session up.
+            return session->sendRequest(data, size, timeValid, timeUs);
+        }
 
-    if (index < 0) {
-        return -ENOENT;
+        thread = mThreads[session->networkThreadIndex()];
     }
 
-    const sp<Session> session = mSessions.valueAt(index);
-    return session->switchToWebSocketMode();
+    // The session's thread, not ours, serializes access to it.
+    return thread->sendRequest(session, data, size, timeValid, timeUs);
 }
 
-void ANetworkSession::interrupt() {
-    static const char dummy = 0;
+status_t ANetworkSession::sendDatagrams(
+        int32_t sessionID, const List<sp<ABuffer> > &datagrams,
+        bool timeValid, int64_t timeUs) {
+    sp<Session> session;
+    sp<NetworkThread> thread;
 
-    ssize_t n;
-    do {
-        n = write(mPipeFd[1], &dummy, 1);
-    } while (n < 0 && errno == EINTR);
+    {
+        Mutex::Autolock autoLock(mLock);
 
-    if (n < 0) {
-        ALOGW("Error writing to pipe (%s)", strerror(errno));
-    }
-}
+        ssize_t index = mSessions.indexOfKey(sessionID);
 
-void ANetworkSession::threadLoop() {
-    fd_set rs, ws;
-    FD_ZERO(&rs);
-    FD_ZERO(&ws);
+        if (index < 0) {
+            return -ENOENT;
+        }
 
-    FD_SET(mPipeFd[0], &rs);
-    int maxFd = mPipeFd[0];
+        session = mSessions.valueAt(index);
 
-    {
-        Mutex::Autolock autoLock(mLock);
+        if (mThreads.isEmpty()) {
+            return session->sendDatagrams(datagrams, timeValid, timeUs);
+        }
 
-        for (size_t i = 0; i < mSessions.size(); ++i) {
-            const sp<Session> &session = mSessions.valueAt(i);
+        thread = mThreads[session->networkThreadIndex()];
+    }
 
-            int s = session->socket();
+    return thread->sendDatagrams(session, datagrams, timeValid, timeUs);
+}
 
-            if (s < 0) {
-                continue;
-            }
+status_t ANetworkSession::switchToWebSocketMode(int32_t sessionID) {
+    Mutex::Autolock autoLock(mLock);
 
-            if (session->wantsToRead()) {
-                FD_SET(s, &rs);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
+    ssize_t index = mSessions.indexOfKey(sessionID);
 
-            if (session->wantsToWrite()) {
-                FD_SET(s, &ws);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
-        }
+    if (index < 0) {
+        return -ENOENT;
     }
 
-    int res = select(maxFd + 1, &rs, &ws, NULL, NULL /* tv */);
+    const sp<Session> session = mSessions.valueAt(index);
 
-    if (res == 0) {
-        return;
+    if (mThreads.isEmpty()) {
+        return session->switchToWebSocketMode();
     }
 
-    if (res < 0) {
-        if (errno == EINTR) {
-            return;
-        }
+    return mThreads[session->networkThreadIndex()]->switchToWebSocketMode(
+            session);
+}
 
-        ALOGE("select failed w/ error %d (%s)", errno, strerror(errno));
+void ANetworkSession::addSessionToThreadLocked(const sp<Session> &session) {
+    if (mThreads.isEmpty()) {
         return;
     }
 
-    if (FD_ISSET(mPipeFd[0], &rs)) {
-        char c;
-        ssize_t n;
-        do {
-            n = read(mPipeFd[0], &c, 1);
-        } while (n < 0 && errno == EINTR);
-
-        if (n < 0) {
-            ALOGW("Error reading from pipe (%s)", strerror(errno));
+    size_t minIndex = 0;
+    size_t minNumSessions = mThreads[0]->numSessions();
+    for (size_t i = 1; i < mThreads.size(); ++i) {
+        size_t numSessions = mThreads[i]->numSessions();
+        if (numSessions < minNumSessions) {
+            minIndex = i;
+            minNumSessions = numSessions;
         }
-
-        --res;
     }
 
-    {
-        Mutex::Autolock autoLock(mLock);
-
-        List<sp<Session> > sessionsToAdd;
-
-        for (size_t i = mSessions.size(); res > 0 && i-- > 0;) {
-            const sp<Session> &session = mSessions.valueAt(i);
-
-            int s = session->socket();
-
-            if (s < 0) {
-                continue;
-            }
-
-            if (FD_ISSET(s, &rs) || FD_ISSET(s, &ws)) {
-                --res;
-            }
+    session->setNetworkThreadIndex(minIndex);
+    mThreads[minIndex]->addSession(session);
+}
 
-            if (FD_ISSET(s, &rs)) {
-                if (session->isRTSPServer() || session->isTCPDatagramServer()) {
-                    struct sockaddr_in remoteAddr;
-                    socklen_t remoteAddrLen = sizeof(remoteAddr);
-
-                    int clientSocket = accept(
-                            s, (struct sockaddr *)&remoteAddr, &remoteAddrLen);
-
-                    if (clientSocket >= 0) {
-                        status_t err = MakeSocketNonBlocking(clientSocket);
-
-                        if (err != OK) {
-                            ALOGE("Unable to make client socket non blocking, "
-                                  "failed w/ error %d (%s)",
-                                  err, strerror(-err));
-
-                            close(clientSocket);
-                            clientSocket = -1;
-                        } else {
-                            in_addr_t addr = ntohl(remoteAddr.sin_addr.s_addr);
-
-                            ALOGI("incoming connection from %d.%d.%d.%d:%d "
-                                  "(socket %d)",
-                                  (addr >> 24),
-                                  (addr >> 16) & 0xff,
-                                  (addr >> 8) & 0xff,
-                                  addr & 0xff,
-                                  ntohs(remoteAddr.sin_port),
-                                  clientSocket);
-
-                            sp<Session> clientSession =
-                                new Session(
-                                        mNextSessionID++,
-                                        Session::CONNECTED,
-                                        clientSocket,
-                                        session->getNotificationMessage());
-
-                            clientSession->setMode(
-                                    session->isRTSPServer()
-                                        ? Session::MODE_RTSP
-                                        : Session::MODE_DATAGRAM);
-
-                            sessionsToAdd.push_back(clientSession);
-                        }
-                    } else {
-                        ALOGE("accept returned error %d (%s)",
-                              errno, strerror(errno));
-                    }
-                } else {
-                    status_t err = session->readMore();
-                    if (err != OK) {
-                        ALOGE("readMore on socket %d failed w/ error %d (%s)",
-                              s, err, strerror(-err));
-                    }
-                }
-            }
+void ANetworkSession::addClientSession(
+        int s, bool isRTSP, const sp<AMessage> &notify) {
+    Mutex::Autolock autoLock(mLock);
 
-            if (FD_ISSET(s, &ws)) {
-                status_t err = session->writeMore();
-                if (err != OK) {
-                    ALOGE("writeMore on socket %d failed w/ error %d (%s)",
-                          s, err, strerror(-err));
-                }
-            }
-        }
+    sp<Session> clientSession =
+        new Session(mNextSessionID++, Session::CONNECTED, s, notify);
 
-        while (!sessionsToAdd.empty()) {
-            sp<Session> session = *sessionsToAdd.begin();
-            sessionsToAdd.erase(sessionsToAdd.begin());
+    clientSession->setMode(
+            isRTSP ? Session::MODE_RTSP : Session::MODE_DATAGRAM);
 
-            mSessions.add(session->sessionID(), session);
+    mSessions.add(clientSession->sessionID(), clientSession);
+    addSessionToThreadLocked(clientSession);
 
-            ALOGI("added clientSession %d", session->sessionID());
-        }
-    }
+    ALOGI("added clientSession %d", clientSession->sessionID());
 }
 
 }  // namespace android
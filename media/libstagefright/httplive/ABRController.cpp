@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ABRController"
+#include <utils/Log.h>
+
+#include "ABRController.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+// static
+const int64_t ThroughputABRController::kMinUpSwitchBufferedUs = 8000000ll;
+const int64_t ThroughputABRController::kMinStayBufferedUs = 5000000ll;
+
+ThroughputABRController::ThroughputABRController()
+    : mNumSamples(0),
+      mNextSample(0) {
+}
+
+ThroughputABRController::~ThroughputABRController() {
+}
+
+void ThroughputABRController::addSample(
+        size_t numBytes, int64_t startTimeUs, int64_t endTimeUs) {
+    if (numBytes == 0 || endTimeUs <= startTimeUs) {
+        return;
+    }
+
+    ALOGV("segment of %d bytes took %lld us (%.2f kbps)",
+          numBytes, endTimeUs - startTimeUs,
+          numBytes * 8000.0f / (endTimeUs - startTimeUs));
+
+    mSamples[mNextSample].mNumBytes = numBytes;
+    mSamples[mNextSample].mStartTimeUs = startTimeUs;
+    mSamples[mNextSample].mEndTimeUs = endTimeUs;
+    mNextSample = (mNextSample + 1) % kMaxNumSamples;
+
+    if (mNumSamples < kMaxNumSamples) {
+        ++mNumSamples;
+    }
+}
+
+int64_t ThroughputABRController::getBandwidthBps(size_t numSamples) const {
+    // Most recent first.
+    Sample samples[kMaxNumSamples];
+    for (size_t i = 0; i < numSamples; ++i) {
+        samples[i] = mSamples[
+            (mNextSample + kMaxNumSamples - 1 - i) % kMaxNumSamples];
+    }
+
+    // Sort by start time, then add up the bytes and the union of the
+    // intervals, so that parallel downloads count as one.
+    for (size_t i = 1; i < numSamples; ++i) {
+        for (size_t j = i; j > 0
+                && samples[j].mStartTimeUs < samples[j - 1].mStartTimeUs; --j) {
+            Sample tmp = samples[j];
+            samples[j] = samples[j - 1];
+            samples[j - 1] = tmp;
+        }
+    }
+
+    int64_t numBytes = 0ll;
+    int64_t durationUs = 0ll;
+    int64_t endTimeUs = samples[0].mStartTimeUs;
+    for (size_t i = 0; i < numSamples; ++i) {
+        numBytes += samples[i].mNumBytes;
+
+        if (samples[i].mEndTimeUs > endTimeUs) {
+            durationUs += samples[i].mEndTimeUs
+                - (samples[i].mStartTimeUs > endTimeUs
+                        ? samples[i].mStartTimeUs : endTimeUs);
+            endTimeUs = samples[i].mEndTimeUs;
+        }
+    }
+
+    return numBytes * 8000000ll / durationUs;
+}
+
+bool ThroughputABRController::estimateBandwidth(int32_t *bandwidthBps) {
+    if (mNumSamples == 0) {
+        return false;
+    }
+
+    // The average over the window, but no more than the last few segments
+    // got, so that a drop shows quickly while a rise has to last.
+    int64_t bps = getBandwidthBps(mNumSamples);
+
+    size_t numRecentSamples = kNumRecentSamples;
+    if (numRecentSamples > mNumSamples) {
+        numRecentSamples = mNumSamples;
+    }
+
+    int64_t recentBps = getBandwidthBps(numRecentSamples);
+
+    if (recentBps < bps) {
+        bps = recentBps;
+    }
+
+    *bandwidthBps = bps > 0x7fffffffll ? 0x7fffffff : (int32_t)bps;
+
+    return true;
+}
+
+size_t ThroughputABRController::pickVariant(
+        const Vector<unsigned long> &bandwidths, ssize_t currentIndex,
+        int32_t bandwidthBps, int64_t bufferedDurationUs) {
+    CHECK_GT(bandwidths.size(), 0u);
+
+    // The highest variant that fits in 80% of the estimate.
+    size_t index = 0;
+    while (index + 1 < bandwidths.size()
+            && bandwidths[index + 1] <= (unsigned long)bandwidthBps / 10 * 8) {
+        ++index;
+    }
+
+    if (currentIndex < 0 || (size_t)currentIndex >= bandwidths.size()) {
+        return index;
+    }
+
+    size_t current = currentIndex;
+
+    if (index > current) {
+        // Up one variant at a time, only if it also fits in 70% of the
+        // estimate and a wrong guess can be absorbed by the buffer.
+        if (bufferedDurationUs < kMinUpSwitchBufferedUs
+                || bandwidths[current + 1]
+                        > (unsigned long)bandwidthBps / 10 * 7) {
+            return current;
+        }
+
+        return current + 1;
+    }
+
+    if (index < current) {
+        // Ride out a dip as long as the current variant can still be
+        // downloaded in real time and enough is buffered.
+        if (bandwidths[current] <= (unsigned long)bandwidthBps
+                && bufferedDurationUs >= kMinStayBufferedUs) {
+            return current;
+        }
+
+        return index;
+    }
+
+    return current;
+}
+
+}  // namespace android
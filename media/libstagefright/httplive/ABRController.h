@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ABR_CONTROLLER_H_
+
+#define ABR_CONTROLLER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Picks the variant LiveSession plays. It is told when every segment
+// download started and ended, downloads may overlap, and is asked for a
+// variant whenever one has finished.
+struct ABRController : public RefBase {
+    ABRController() {}
+
+    virtual void addSample(
+            size_t numBytes, int64_t startTimeUs, int64_t endTimeUs) = 0;
+
+    // Returns false until a throughput estimate is available.
+    virtual bool estimateBandwidth(int32_t *bandwidthBps) = 0;
+
+    // "bandwidths" are in increasing order, currentIndex is negative if
+    // no variant has been picked yet.
+    virtual size_t pickVariant(
+            const Vector<unsigned long> &bandwidths, ssize_t currentIndex,
+            int32_t bandwidthBps, int64_t bufferedDurationUs) = 0;
+
+protected:
+    virtual ~ABRController() {}
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(ABRController);
+};
+
+// The default: estimates the throughput over the last few segments,
+// switching up only one variant at a time with enough data buffered, and
+// down only when the buffer can't ride out the variant it's on.
+struct ThroughputABRController : public ABRController {
+    ThroughputABRController();
+
+    virtual void addSample(
+            size_t numBytes, int64_t startTimeUs, int64_t endTimeUs);
+
+    virtual bool estimateBandwidth(int32_t *bandwidthBps);
+
+    virtual size_t pickVariant(
+            const Vector<unsigned long> &bandwidths, ssize_t currentIndex,
+            int32_t bandwidthBps, int64_t bufferedDurationUs);
+
+protected:
+    virtual ~ThroughputABRController();
+
+private:
+    enum {
+        kMaxNumSamples = 5,
+        kNumRecentSamples = 3,
+    };
+
+    static const int64_t kMinUpSwitchBufferedUs;
+    static const int64_t kMinStayBufferedUs;
+
+    struct Sample {
+        size_t mNumBytes;
+        int64_t mStartTimeUs;
+        int64_t mEndTimeUs;
+    };
+
+    Sample mSamples[kMaxNumSamples];
+    size_t mNumSamples;
+    size_t mNextSample;
+
+    // The bytes of the last numSamples samples over the time any of them
+    // was downloading.
+    int64_t getBandwidthBps(size_t numSamples) const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(ThroughputABRController);
+};
+
+}  // namespace android
+
+#endif  // ABR_CONTROLLER_H_
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AESDecryptor"
+#include <utils/Log.h>
+
+#include "AESDecryptor.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+AESDecryptor::AESDecryptor()
+    : mInitialized(false) {
+    EVP_CIPHER_CTX_init(&mContext);
+}
+
+AESDecryptor::~AESDecryptor() {
+    EVP_CIPHER_CTX_cleanup(&mContext);
+}
+
+status_t AESDecryptor::init(const uint8_t *key, const uint8_t *iv) {
+    if (EVP_DecryptInit_ex(
+                &mContext, EVP_aes_128_cbc(), NULL /* engine */, key, iv) != 1) {
+        ALOGE("failed to set AES decryption key.");
+        return UNKNOWN_ERROR;
+    }
+
+    // The padding is only at the end of the segment, see removePadding().
+    EVP_CIPHER_CTX_set_padding(&mContext, 0);
+
+    mInitialized = true;
+
+    return OK;
+}
+
+status_t AESDecryptor::decrypt(uint8_t *data, size_t size) {
+    CHECK(mInitialized);
+
+    if (size == 0) {
+        return OK;
+    }
+
+    // Whole blocks are decrypted right away, so it's fine in place.
+    int outLength;
+    if (EVP_DecryptUpdate(&mContext, data, &outLength, data, size) != 1
+            || outLength != (int)size) {
+        ALOGE("AES decryption of %d bytes failed.", size);
+        return UNKNOWN_ERROR;
+    }
+
+    return OK;
+}
+
+// static
+status_t AESDecryptor::removePadding(const sp<ABuffer> &buffer) {
+    size_t n = buffer->size();
+    CHECK_GT(n, 0u);
+
+    size_t pad = buffer->data()[n - 1];
+
+    CHECK_GT(pad, 0u);
+    CHECK_LE(pad, 16u);
+    CHECK_GE((size_t)n, pad);
+    for (size_t i = 0; i < pad; ++i) {
+        CHECK_EQ((unsigned)buffer->data()[n - 1 - i], pad);
+    }
+
+    n -= pad;
+
+    buffer->setRange(buffer->offset(), n);
+
+    return OK;
+}
+
+}  // namespace android
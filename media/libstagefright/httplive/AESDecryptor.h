@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AES_DECRYPTOR_H_
+
+#define AES_DECRYPTOR_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+
+#include <openssl/evp.h>
+
+namespace android {
+
+struct ABuffer;
+
+// Decrypts one AES-128 encrypted HLS segment. It goes through EVP rather
+// than AES_cbc_encrypt() so that OpenSSL picks the fastest implementation
+// the CPU supports, the ARMv8 crypto instructions or bit-sliced NEON.
+// Only one thread may use it at a time, but it needn't be the one that
+// created it.
+struct AESDecryptor : public RefBase {
+    AESDecryptor();
+
+    status_t init(const uint8_t *key, const uint8_t *iv);
+
+    // Decrypts in place. The segment may be fed in any number of pieces,
+    // all of them except the last a multiple of 16 bytes long.
+    status_t decrypt(uint8_t *data, size_t size);
+
+    // Strips the padding off the decrypted end of a segment.
+    static status_t removePadding(const sp<ABuffer> &buffer);
+
+protected:
+    virtual ~AESDecryptor();
+
+private:
+    EVP_CIPHER_CTX mContext;
+    bool mInitialized;
+
+    DISALLOW_EVIL_CONSTRUCTORS(AESDecryptor);
+};
+
+}  // namespace android
+
+#endif  // AES_DECRYPTOR_H_
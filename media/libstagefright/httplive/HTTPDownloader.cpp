@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "HTTPDownloader"
+#include <utils/Log.h>
+
+#include "HTTPDownloader.h"
+
+#include "AESDecryptor.h"
+#include "LiveSession.h"
+#include "M3UParser.h"
+
+#include "include/HTTPBase.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+namespace android {
+
+HTTPDownloader::HTTPDownloader(
+        LiveSession *session,
+        const sp<HTTPBase> &httpDataSource,
+        const sp<AMessage> &idleNotify)
+    : mSession(session),
+      mHTTPDataSource(httpDataSource),
+      mIdleNotify(idleNotify) {
+}
+
+HTTPDownloader::~HTTPDownloader() {
+}
+
+void HTTPDownloader::fetchFileAsync(
+        const char *url, int64_t range_offset, int64_t range_length,
+        const sp<AESDecryptor> &decryptor, const sp<AMessage> &notify) {
+    sp<AMessage> msg = new AMessage(kWhatFetchFile, id());
+    msg->setString("url", url);
+    msg->setInt64("rangeOffset", range_offset);
+    msg->setInt64("rangeLength", range_length);
+    if (decryptor != NULL) {
+        msg->setObject("decryptor", decryptor);
+    }
+    msg->setMessage("notify", notify);
+    msg->post();
+}
+
+void HTTPDownloader::fetchPlaylistAsync(
+        const char *url, const uint8_t *curPlaylistHash,
+        const sp<M3UParser> &previousPlaylist,
+        const sp<AMessage> &notify) {
+    sp<ABuffer> hash = new ABuffer(16);
+    memcpy(hash->data(), curPlaylistHash, 16);
+
+    sp<AMessage> msg = new AMessage(kWhatFetchPlaylist, id());
+    msg->setString("url", url);
+    msg->setBuffer("hash", hash);
+    if (previousPlaylist != NULL) {
+        msg->setObject("previous", previousPlaylist);
+    }
+    msg->setMessage("notify", notify);
+    msg->post();
+}
+
+void HTTPDownloader::onMessageReceived(const sp<AMessage> &msg) {
+    AString url;
+    CHECK(msg->findString("url", &url));
+
+    sp<AMessage> notify;
+    CHECK(msg->findMessage("notify", &notify));
+
+    switch (msg->what()) {
+        case kWhatFetchFile:
+        {
+            int64_t range_offset, range_length;
+            CHECK(msg->findInt64("rangeOffset", &range_offset));
+            CHECK(msg->findInt64("rangeLength", &range_length));
+
+            int64_t startTimeUs = ALooper::GetNowUs();
+
+            sp<ABuffer> buffer;
+            status_t err = mSession->fetchFile(
+                    url.c_str(), &buffer, range_offset, range_length,
+                    mHTTPDataSource);
+
+            int64_t endTimeUs = ALooper::GetNowUs();
+
+            ALOGV("fetched '%s' (%d bytes), err %d",
+                  url.c_str(), err == OK ? buffer->size() : 0, err);
+
+            sp<RefBase> obj;
+            if (err == OK && msg->findObject("decryptor", &obj)) {
+                sp<AESDecryptor> decryptor = static_cast<AESDecryptor *>(
+                        obj.get());
+
+                err = decryptor->decrypt(buffer->data(), buffer->size());
+
+                if (err == OK) {
+                    err = AESDecryptor::removePadding(buffer);
+                }
+            }
+
+            notify->setInt32("err", err);
+            if (err == OK) {
+                notify->setBuffer("buffer", buffer);
+                notify->setInt64("startTimeUs", startTimeUs);
+                notify->setInt64("endTimeUs", endTimeUs);
+            }
+            break;
+        }
+
+        case kWhatFetchPlaylist:
+        {
+            sp<ABuffer> hash;
+            CHECK(msg->findBuffer("hash", &hash));
+
+            sp<RefBase> obj;
+            sp<M3UParser> previousPlaylist;
+            if (msg->findObject("previous", &obj)) {
+                previousPlaylist = static_cast<M3UParser *>(obj.get());
+            }
+
+            bool unchanged;
+            sp<M3UParser> playlist = mSession->fetchPlaylist(
+                    url.c_str(), hash->data(), &unchanged, previousPlaylist,
+                    mHTTPDataSource);
+
+            notify->setInt32("unchanged", unchanged);
+            notify->setBuffer("hash", hash);
+            if (playlist != NULL) {
+                notify->setObject("playlist", playlist);
+            }
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+
+    notify->post();
+
+    mIdleNotify->dup()->post();
+}
+
+}  // namespace android
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HTTP_DOWNLOADER_H_
+
+#define HTTP_DOWNLOADER_H_
+
+#include <media/stagefright/foundation/AHandler.h>
+
+namespace android {
+
+struct AESDecryptor;
+struct HTTPBase;
+struct LiveSession;
+struct M3UParser;
+
+// Fetches files for a LiveSession over a connection of its own, on a
+// looper of its own, so that they download while the session's looper
+// is busy with another one. Once done with a request it posts a copy of
+// "idleNotify".
+struct HTTPDownloader : public AHandler {
+    HTTPDownloader(
+            LiveSession *session,
+            const sp<HTTPBase> &httpDataSource,
+            const sp<AMessage> &idleNotify);
+
+    // Posts "notify" with "err" and, if that is OK, the file in "buffer"
+    // and the "startTimeUs" and "endTimeUs" of the transfer. The file is
+    // decrypted here if a decryptor is given.
+    void fetchFileAsync(
+            const char *url, int64_t range_offset, int64_t range_length,
+            const sp<AESDecryptor> &decryptor, const sp<AMessage> &notify);
+
+    // Posts "notify" with "unchanged", the new "hash" and, unless the
+    // fetch failed or it is unchanged, the M3UParser in "playlist". The
+    // previous playlist is only read, it may still be in use elsewhere.
+    void fetchPlaylistAsync(
+            const char *url, const uint8_t *curPlaylistHash,
+            const sp<M3UParser> &previousPlaylist,
+            const sp<AMessage> &notify);
+
+protected:
+    virtual ~HTTPDownloader();
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatFetchFile      = 'fetF',
+        kWhatFetchPlaylist  = 'fetP',
+    };
+
+    // The session stops our looper before it goes away.
+    LiveSession *mSession;
+
+    sp<HTTPBase> mHTTPDataSource;
+    sp<AMessage> mIdleNotify;
+
+    DISALLOW_EVIL_CONSTRUCTORS(HTTPDownloader);
+};
+
+}  // namespace android
+
+#endif  // HTTP_DOWNLOADER_H_
@@ -20,6 +20,8 @@
 
 #include "LiveSession.h"
 
+#include "ABRController.h"
+#include "HTTPDownloader.h"
 #include "M3UParser.h"
 #include "PlaylistFetcher.h"
 
@@ -43,8 +45,12 @@
 
 namespace android {
 
+// 10 secs at 25 Mbit/s.
+const size_t LiveSession::kMaxBufferedBytes = 32 * 1024 * 1024;
+
 LiveSession::LiveSession(
-        const sp<AMessage> &notify, uint32_t flags, bool uidValid, uid_t uid)
+        const sp<AMessage> &notify, uint32_t flags, bool uidValid, uid_t uid,
+        size_t maxConnections)
     : mNotify(notify),
       mFlags(flags),
       mUIDValid(uidValid),
@@ -55,7 +61,11 @@ LiveSession::LiveSession(
                   (mFlags & kFlagIncognito)
                     ? HTTPBase::kFlagIncognito
                     : 0)),
+      mMaxConnections(maxConnections > 0 ? maxConnections : 1),
       mPrevBandwidthIndex(-1),
+      mABRController(new ThroughputABRController),
+      mMaxWidth(0),
+      mMaxHeight(0),
       mStreamMask(0),
       mCheckBandwidthGeneration(0),
       mLastDequeuedTimeUs(0ll),
@@ -74,9 +84,18 @@ LiveSession::LiveSession(
 
     mPacketSources.add(
             STREAMTYPE_SUBTITLES, new AnotherPacketSource(NULL /* meta */));
+
+    for (size_t i = 0; i < mPacketSources.size(); ++i) {
+        mPacketSources.valueAt(i)->setBufferLimits(
+                kMaxBufferedBytes, 0ll /* maxDurationUs */);
+    }
 }
 
 LiveSession::~LiveSession() {
+    // The downloaders call back into us, wait for them to finish.
+    for (size_t i = 0; i < mDownloaders.size(); ++i) {
+        mDownloaders.itemAt(i).mLooper->stop();
+    }
 }
 
 status_t LiveSession::dequeueAccessUnit(
@@ -155,7 +174,20 @@ status_t LiveSession::getStreamFormat(StreamType stream, sp<AMessage> *format) {
         return -EAGAIN;
     }
 
-    return convertMetaDataToMessage(meta, format);
+    status_t err = convertMetaDataToMessage(meta, format);
+
+    if (err == OK && stream == STREAMTYPE_VIDEO && mMaxWidth > 0) {
+        int32_t width, height;
+        if ((*format)->findInt32("width", &width)
+                && (*format)->findInt32("height", &height)) {
+            (*format)->setInt32(
+                    "max-width", width > mMaxWidth ? width : mMaxWidth);
+            (*format)->setInt32(
+                    "max-height", height > mMaxHeight ? height : mMaxHeight);
+        }
+    }
+
+    return err;
 }
 
 void LiveSession::connectAsync(
@@ -240,6 +272,34 @@ void LiveSession::onMessageReceived(const sp<AMessage> &msg) {
                         AString uri;
                         CHECK(msg->findString("uri", &uri));
                         mFetcherInfos.removeItem(uri);
+
+                        // A fetcher stopped by switchBandwidth() tells
+                        // where its streams continue.
+                        int32_t seqNumber;
+                        if (mContinuation != NULL
+                                && msg->findInt32("seqNumber", &seqNumber)) {
+                            uint32_t streamTypeMask;
+                            CHECK(msg->findInt32(
+                                        "streamTypeMask",
+                                        (int32_t *)&streamTypeMask));
+
+                            int64_t timeUs;
+                            CHECK(msg->findInt64("timeUs", &timeUs));
+
+                            for (uint32_t type = STREAMTYPE_AUDIO;
+                                    type <= STREAMTYPE_SUBTITLES; type <<= 1) {
+                                if (streamTypeMask & type) {
+                                    mContinuation->setInt32(
+                                            StringPrintf("seqNumber-%u", type)
+                                                .c_str(),
+                                            seqNumber);
+                                    mContinuation->setInt64(
+                                            StringPrintf("timeUs-%u", type)
+                                                .c_str(),
+                                            timeUs);
+                                }
+                            }
+                        }
                     }
 
                     if (mContinuation != NULL) {
@@ -313,6 +373,23 @@ void LiveSession::onMessageReceived(const sp<AMessage> &msg) {
                     break;
                 }
 
+                case PlaylistFetcher::kWhatSegmentFetched:
+                {
+                    int64_t bytes, startTimeUs, endTimeUs;
+                    CHECK(msg->findInt64("bytes", &bytes));
+                    CHECK(msg->findInt64("startTimeUs", &startTimeUs));
+                    CHECK(msg->findInt64("endTimeUs", &endTimeUs));
+
+                    mABRController->addSample(bytes, startTimeUs, endTimeUs);
+
+                    // Variants are switched between segments, so this is
+                    // the time to look at the bandwidth.
+                    if (!mReconfigurationInProgress && !mInPreparationPhase) {
+                        onCheckBandwidth();
+                    }
+                    break;
+                }
+
                 default:
                     TRESPASS();
             }
@@ -351,12 +428,27 @@ void LiveSession::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSwitchBandwidth2:
+        {
+            onSwitchBandwidth2(msg);
+            break;
+        }
+
         case kWhatFinishDisconnect2:
         {
             onFinishDisconnect2();
             break;
         }
 
+        case kWhatDownloaderIdle:
+        {
+            size_t index;
+            CHECK(msg->findSize("index", &index));
+
+            mDownloaders.editItemAt(index).mBusy = false;
+            break;
+        }
+
         default:
             TRESPASS();
             break;
@@ -431,6 +523,17 @@ void LiveSession::onConnect(const sp<AMessage> &msg) {
                 initialBandwidth = item.mBandwidth;
             }
 
+            int32_t width, height;
+            if (meta->findInt32("width", &width)
+                    && meta->findInt32("height", &height)) {
+                if (width > mMaxWidth) {
+                    mMaxWidth = width;
+                }
+                if (height > mMaxHeight) {
+                    mMaxHeight = height;
+                }
+            }
+
             mBandwidthItems.push(item);
         }
 
@@ -512,15 +615,50 @@ sp<PlaylistFetcher> LiveSession::addFetcher(const char *uri) {
     return info.mFetcher;
 }
 
-status_t LiveSession::fetchFile(
-        const char *url, sp<ABuffer> *out,
-        int64_t range_offset, int64_t range_length) {
-    *out = NULL;
+sp<HTTPDownloader> LiveSession::acquireDownloader() {
+    for (size_t i = 0; i < mDownloaders.size(); ++i) {
+        if (!mDownloaders.itemAt(i).mBusy) {
+            mDownloaders.editItemAt(i).mBusy = true;
+            return mDownloaders.itemAt(i).mDownloader;
+        }
+    }
 
-    sp<DataSource> source;
+    // One connection is our own.
+    if (mDownloaders.size() + 1 >= mMaxConnections) {
+        return NULL;
+    }
+
+    sp<HTTPBase> httpDataSource =
+        HTTPBase::Create(
+                (mFlags & kFlagIncognito) ? HTTPBase::kFlagIncognito : 0);
+
+    if (mUIDValid) {
+        httpDataSource->setUID(mUID);
+    }
+
+    sp<AMessage> idleNotify = new AMessage(kWhatDownloaderIdle, id());
+    idleNotify->setSize("index", mDownloaders.size());
+
+    DownloaderInfo info;
+    info.mLooper = new ALooper;
+    info.mLooper->setName("http downloader");
+    info.mLooper->start();
+    info.mDownloader = new HTTPDownloader(this, httpDataSource, idleNotify);
+    info.mLooper->registerHandler(info.mDownloader);
+    info.mBusy = true;
+
+    mDownloaders.push(info);
+
+    return info.mDownloader;
+}
+
+status_t LiveSession::openFile(
+        const char *url, int64_t range_offset, int64_t range_length,
+        sp<DataSource> *source, const sp<HTTPBase> &httpDataSource) {
+    *source = NULL;
 
     if (!strncasecmp(url, "file://", 7)) {
-        source = new FileSource(url + 7);
+        *source = new FileSource(url + 7);
     } else if (strncasecmp(url, "http://", 7)
             && strncasecmp(url, "https://", 8)) {
         return ERROR_UNSUPPORTED;
@@ -536,17 +674,73 @@ status_t LiveSession::fetchFile(
                             range_length < 0
                                 ? "" : StringPrintf("%lld", range_offset + range_length - 1).c_str()).c_str()));
         }
-        status_t err = mHTTPDataSource->connect(url, &headers);
+        sp<HTTPBase> http =
+            httpDataSource != NULL ? httpDataSource : mHTTPDataSource;
+
+        status_t err = http->connect(url, &headers);
 
         if (err != OK) {
             return err;
         }
 
-        source = mHTTPDataSource;
+        *source = http;
+    }
+
+    return OK;
+}
+
+ssize_t LiveSession::readFileBlock(
+        const sp<DataSource> &source, off64_t offset, int64_t range_length,
+        size_t maxBytesToRead, sp<ABuffer> *buffer) {
+    if (range_length >= 0) {
+        int64_t bytesLeftInRange = range_length - offset;
+        if (bytesLeftInRange <= 0) {
+            return 0;
+        }
+
+        if (bytesLeftInRange < (int64_t)maxBytesToRead) {
+            maxBytesToRead = bytesLeftInRange;
+        }
+    }
+
+    sp<ABuffer> buf = *buffer;
+    if (buf->capacity() - buf->offset() - buf->size() < maxBytesToRead) {
+        ALOGV("increasing download buffer to %d bytes",
+             buf->size() + maxBytesToRead);
+
+        sp<ABuffer> copy = new ABuffer(buf->size() + maxBytesToRead);
+        memcpy(copy->data(), buf->data(), buf->size());
+        copy->setRange(0, buf->size());
+
+        *buffer = buf = copy;
+    }
+
+    ssize_t n = source->readAt(
+            offset, buf->data() + buf->size(), maxBytesToRead);
+
+    if (n > 0) {
+        buf->setRange(buf->offset(), buf->size() + (size_t)n);
+    }
+
+    return n;
+}
+
+status_t LiveSession::fetchFile(
+        const char *url, sp<ABuffer> *out,
+        int64_t range_offset, int64_t range_length,
+        const sp<HTTPBase> &httpDataSource) {
+    *out = NULL;
+
+    sp<DataSource> source;
+    status_t err = openFile(
+            url, range_offset, range_length, &source, httpDataSource);
+
+    if (err != OK) {
+        return err;
     }
 
     off64_t size;
-    status_t err = source->getSize(&size);
+    err = source->getSize(&size);
 
     if (err != OK) {
         size = 65536;
@@ -560,32 +754,10 @@ status_t LiveSession::fetchFile(
 
         if (bufferRemaining == 0) {
             bufferRemaining = 32768;
-
-            ALOGV("increasing download buffer to %d bytes",
-                 buffer->size() + bufferRemaining);
-
-            sp<ABuffer> copy = new ABuffer(buffer->size() + bufferRemaining);
-            memcpy(copy->data(), buffer->data(), buffer->size());
-            copy->setRange(0, buffer->size());
-
-            buffer = copy;
         }
 
-        size_t maxBytesToRead = bufferRemaining;
-        if (range_length >= 0) {
-            int64_t bytesLeftInRange = range_length - buffer->size();
-            if (bytesLeftInRange < maxBytesToRead) {
-                maxBytesToRead = bytesLeftInRange;
-
-                if (bytesLeftInRange == 0) {
-                    break;
-                }
-            }
-        }
-
-        ssize_t n = source->readAt(
-                buffer->size(), buffer->data() + buffer->size(),
-                maxBytesToRead);
+        ssize_t n = readFileBlock(
+                source, buffer->size(), range_length, bufferRemaining, &buffer);
 
         if (n < 0) {
             return n;
@@ -594,8 +766,6 @@ status_t LiveSession::fetchFile(
         if (n == 0) {
             break;
         }
-
-        buffer->setRange(0, buffer->size() + (size_t)n);
     }
 
     *out = buffer;
@@ -604,13 +774,17 @@ status_t LiveSession::fetchFile(
 }
 
 sp<M3UParser> LiveSession::fetchPlaylist(
-        const char *url, uint8_t *curPlaylistHash, bool *unchanged) {
+        const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+        const sp<M3UParser> &previousPlaylist,
+        const sp<HTTPBase> &httpDataSource) {
     ALOGV("fetchPlaylist '%s'", url);
 
     *unchanged = false;
 
     sp<ABuffer> buffer;
-    status_t err = fetchFile(url, &buffer);
+    status_t err = fetchFile(
+            url, &buffer, 0 /* range_offset */, -1 /* range_length */,
+            httpDataSource);
 
     if (err != OK) {
         return NULL;
@@ -644,7 +818,7 @@ sp<M3UParser> LiveSession::fetchPlaylist(
 #endif
 
     sp<M3UParser> playlist =
-        new M3UParser(url, buffer->data(), buffer->size());
+        new M3UParser(url, buffer->data(), buffer->size(), previousPlaylist);
 
     if (playlist->initCheck() != OK) {
         ALOGE("failed to parse .m3u8 playlist");
@@ -679,8 +853,9 @@ size_t LiveSession::getBandwidthIndex() {
 
     if (index < 0) {
         int32_t bandwidthBps;
-        if (mHTTPDataSource != NULL
-                && mHTTPDataSource->estimateBandwidth(&bandwidthBps)) {
+        if (mABRController->estimateBandwidth(&bandwidthBps)
+                || (mHTTPDataSource != NULL
+                    && mHTTPDataSource->estimateBandwidth(&bandwidthBps))) {
             ALOGV("bandwidth estimated at %.2f kbps", bandwidthBps / 1024.0f);
         } else {
             ALOGV("no bandwidth estimate.");
@@ -699,16 +874,38 @@ size_t LiveSession::getBandwidthIndex() {
             }
         }
 
-        // Consider only 80% of the available bandwidth usable.
-        bandwidthBps = (bandwidthBps * 8) / 10;
+        // The less is buffered, the less a wrong guess can be afforded.
+        int64_t bufferedDurationUs = -1ll;
+        for (size_t i = 0; i < mPacketSources.size(); ++i) {
+            StreamType stream = mPacketSources.keyAt(i);
+            if (stream == STREAMTYPE_SUBTITLES || !(mStreamMask & stream)) {
+                continue;
+            }
+
+            status_t finalResult;
+            int64_t durationUs =
+                mPacketSources.valueAt(i)->getBufferedDurationUs(&finalResult);
+
+            if (bufferedDurationUs < 0ll || durationUs < bufferedDurationUs) {
+                bufferedDurationUs = durationUs;
+            }
+        }
 
-        // Pick the highest bandwidth stream below or equal to estimated bandwidth.
+        if (bufferedDurationUs < 0ll) {
+            bufferedDurationUs = 0ll;
+        }
 
-        index = mBandwidthItems.size() - 1;
-        while (index > 0 && mBandwidthItems.itemAt(index).mBandwidth
-                                > (size_t)bandwidthBps) {
-            --index;
+        Vector<unsigned long> bandwidths;
+        for (size_t i = 0; i < mBandwidthItems.size(); ++i) {
+            bandwidths.push(mBandwidthItems.itemAt(i).mBandwidth);
         }
+
+        index = mABRController->pickVariant(
+                bandwidths, mPrevBandwidthIndex, bandwidthBps,
+                bufferedDurationUs);
+
+        ALOGV("picked variant %d, %lld us buffered",
+              index, bufferedDurationUs);
     }
 #elif 0
     // Change bandwidth at random()
@@ -1095,6 +1292,214 @@ void LiveSession::onChangeConfiguration3(const sp<AMessage> &msg) {
     }
 }
 
+void LiveSession::switchBandwidth(size_t bandwidthIndex) {
+    CHECK(!mReconfigurationInProgress);
+
+    CHECK_LT(bandwidthIndex, mBandwidthItems.size());
+    const BandwidthItem &item = mBandwidthItems.itemAt(bandwidthIndex);
+
+    static const StreamType kStreamTypes[] = {
+        STREAMTYPE_AUDIO, STREAMTYPE_VIDEO, STREAMTYPE_SUBTITLES,
+    };
+    static const char *kURIKeys[] = {
+        "audioURI", "videoURI", "subtitleURI",
+    };
+    const AString *curURIs[] = { &mAudioURI, &mVideoURI, &mSubtitleURI };
+
+    AString uris[3];
+    bool present[3] = {
+        mPlaylist->getAudioURI(item.mPlaylistIndex, &uris[0]),
+        mPlaylist->getVideoURI(item.mPlaylistIndex, &uris[1]),
+        mPlaylist->getSubtitleURI(item.mPlaylistIndex, &uris[2]),
+    };
+
+    uint32_t streamMask = 0;
+    uint32_t switchMask = 0;
+    for (size_t i = 0; i < 3; ++i) {
+        if (present[i]) {
+            streamMask |= kStreamTypes[i];
+
+            if (!(uris[i] == *curURIs[i])) {
+                switchMask |= kStreamTypes[i];
+            }
+        }
+    }
+
+    // The old fetchers must serve nothing but streams that switch, the
+    // new ones must not be running yet.
+    bool canSwitch = (streamMask == mStreamMask);
+    for (size_t i = 0; canSwitch && i < 3; ++i) {
+        if (!(switchMask & kStreamTypes[i])) {
+            continue;
+        }
+
+        if (mFetcherInfos.indexOfKey(*curURIs[i]) < 0
+                || mFetcherInfos.indexOfKey(uris[i]) >= 0) {
+            canSwitch = false;
+        }
+
+        for (size_t j = 0; j < 3; ++j) {
+            if ((mStreamMask & kStreamTypes[j])
+                    && !(switchMask & kStreamTypes[j])
+                    && *curURIs[j] == *curURIs[i]) {
+                canSwitch = false;
+            }
+        }
+    }
+
+    if (!canSwitch) {
+        changeConfiguration(-1ll /* timeUs */, bandwidthIndex);
+        return;
+    }
+
+    mPrevBandwidthIndex = bandwidthIndex;
+
+    if (switchMask == 0) {
+        // Same renditions, nothing to fetch differently.
+        return;
+    }
+
+    mReconfigurationInProgress = true;
+
+    ALOGV("switchBandwidth => bwIndex:%d, switchMask:0x%08x",
+          bandwidthIndex, switchMask);
+
+    sp<AMessage> msg = new AMessage(kWhatSwitchBandwidth2, id());
+    msg->setInt32("switchMask", switchMask);
+    msg->setSize("bandwidthIndex", bandwidthIndex);
+
+    mContinuationCounter = 0;
+    for (size_t i = 0; i < 3; ++i) {
+        if (!(switchMask & kStreamTypes[i])) {
+            continue;
+        }
+
+        msg->setString(kURIKeys[i], uris[i].c_str());
+
+        // Streams sharing a fetcher must not stop it twice.
+        bool stopped = false;
+        for (size_t j = 0; j < i; ++j) {
+            if ((switchMask & kStreamTypes[j]) && *curURIs[j] == *curURIs[i]) {
+                stopped = true;
+            }
+        }
+
+        if (!stopped) {
+            mFetcherInfos.valueFor(*curURIs[i]).mFetcher->stopAsync(
+                    false /* clear */);
+            ++mContinuationCounter;
+        }
+    }
+
+    mContinuation = msg;
+}
+
+void LiveSession::onSwitchBandwidth2(const sp<AMessage> &msg) {
+    mContinuation.clear();
+
+    // The old fetchers have stopped after their last segment and removed
+    // themselves.
+
+    uint32_t switchMask;
+    CHECK(msg->findInt32("switchMask", (int32_t *)&switchMask));
+
+    size_t bandwidthIndex;
+    CHECK(msg->findSize("bandwidthIndex", &bandwidthIndex));
+
+    static const StreamType kStreamTypes[] = {
+        STREAMTYPE_AUDIO, STREAMTYPE_VIDEO, STREAMTYPE_SUBTITLES,
+    };
+    static const char *kURIKeys[] = {
+        "audioURI", "videoURI", "subtitleURI",
+    };
+
+    // The streams of a new fetcher have to continue at the same segment.
+    AString uris[3];
+    int32_t seqNumbers[3];
+    int64_t timesUs[3];
+    bool canSwitch = true;
+    for (size_t i = 0; i < 3; ++i) {
+        uint32_t type = kStreamTypes[i];
+        if (!(switchMask & type)) {
+            continue;
+        }
+
+        CHECK(msg->findString(kURIKeys[i], &uris[i]));
+
+        if (!msg->findInt32(
+                    StringPrintf("seqNumber-%u", type).c_str(),
+                    &seqNumbers[i])
+                || seqNumbers[i] < 0) {
+            canSwitch = false;
+            break;
+        }
+
+        CHECK(msg->findInt64(
+                    StringPrintf("timeUs-%u", type).c_str(), &timesUs[i]));
+
+        for (size_t j = 0; j < i; ++j) {
+            if ((switchMask & kStreamTypes[j]) && uris[j] == uris[i]
+                    && seqNumbers[j] != seqNumbers[i]) {
+                canSwitch = false;
+            }
+        }
+    }
+
+    if (!canSwitch) {
+        // Nothing was fetched yet, start over from what is being played.
+        ALOGI("unable to switch variants seamlessly.");
+
+        mReconfigurationInProgress = false;
+        changeConfiguration(-1ll /* timeUs */, bandwidthIndex);
+        return;
+    }
+
+    for (size_t i = 0; i < 3; ++i) {
+        if (!(switchMask & kStreamTypes[i])) {
+            continue;
+        }
+
+        sp<PlaylistFetcher> fetcher = addFetcher(uris[i].c_str());
+        if (fetcher == NULL) {
+            // Already started for a stream before this one.
+            continue;
+        }
+
+        sp<AnotherPacketSource> sources[3];
+        for (size_t j = i; j < 3; ++j) {
+            if ((switchMask & kStreamTypes[j]) && uris[j] == uris[i]) {
+                sources[j] = mPacketSources.valueFor(kStreamTypes[j]);
+            }
+        }
+
+        ALOGV("switching to '%s' at segment %d, time %lld us",
+              uris[i].c_str(), seqNumbers[i], timesUs[i]);
+
+        fetcher->startAsync(
+                sources[0], sources[1], sources[2], timesUs[i], seqNumbers[i]);
+    }
+
+    if (switchMask & STREAMTYPE_AUDIO) {
+        mAudioURI = uris[0];
+    }
+    if (switchMask & STREAMTYPE_VIDEO) {
+        mVideoURI = uris[1];
+    }
+    if (switchMask & STREAMTYPE_SUBTITLES) {
+        mSubtitleURI = uris[2];
+    }
+
+    scheduleCheckBandwidthEvent();
+
+    ALOGV("XXX bandwidth switch completed.");
+
+    mReconfigurationInProgress = false;
+
+    if (mDisconnectReplyID != 0) {
+        finishDisconnect();
+    }
+}
+
 void LiveSession::scheduleCheckBandwidthEvent() {
     sp<AMessage> msg = new AMessage(kWhatCheckBandwidth, id());
     msg->setInt32("generation", mCheckBandwidthGeneration);
@@ -1114,7 +1519,7 @@ void LiveSession::onCheckBandwidth() {
     size_t bandwidthIndex = getBandwidthIndex();
     if (mPrevBandwidthIndex < 0
             || bandwidthIndex != (size_t)mPrevBandwidthIndex) {
-        changeConfiguration(-1ll /* timeUs */, bandwidthIndex);
+        switchBandwidth(bandwidthIndex);
     }
 
     // Handling the kWhatCheckBandwidth even here does _not_ automatically
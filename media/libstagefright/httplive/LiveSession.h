@@ -24,10 +24,12 @@
 
 namespace android {
 
+struct ABRController;
 struct ABuffer;
 struct AnotherPacketSource;
 struct DataSource;
 struct HTTPBase;
+struct HTTPDownloader;
 struct LiveDataSource;
 struct M3UParser;
 struct PlaylistFetcher;
@@ -38,9 +40,20 @@ struct LiveSession : public AHandler {
         // Don't log any URLs.
         kFlagIncognito = 1,
     };
+    enum {
+        kDefaultMaxConnections = 3,
+    };
+
+    // The most each stream's packet source holds, the fetchers normally
+    // stop well before on account of the duration buffered.
+    static const size_t kMaxBufferedBytes;
+
+    // Up to maxConnections files are downloaded at a time, the segment
+    // being parsed plus the playlists and segments fetched ahead of it.
     LiveSession(
             const sp<AMessage> &notify,
-            uint32_t flags = 0, bool uidValid = false, uid_t uid = 0);
+            uint32_t flags = 0, bool uidValid = false, uid_t uid = 0,
+            size_t maxConnections = kDefaultMaxConnections);
 
     enum StreamType {
         STREAMTYPE_AUDIO        = 1,
@@ -80,6 +93,7 @@ protected:
     virtual void onMessageReceived(const sp<AMessage> &msg);
 
 private:
+    friend struct HTTPDownloader;
     friend struct PlaylistFetcher;
 
     enum {
@@ -91,7 +105,9 @@ private:
         kWhatChangeConfiguration        = 'chC0',
         kWhatChangeConfiguration2       = 'chC2',
         kWhatChangeConfiguration3       = 'chC3',
+        kWhatSwitchBandwidth2           = 'swB2',
         kWhatFinishDisconnect2          = 'fin2',
+        kWhatDownloaderIdle             = 'dlId',
     };
 
     struct BandwidthItem {
@@ -105,6 +121,12 @@ private:
         bool mIsPrepared;
     };
 
+    struct DownloaderInfo {
+        sp<ALooper> mLooper;
+        sp<HTTPDownloader> mDownloader;
+        bool mBusy;
+    };
+
     sp<AMessage> mNotify;
     uint32_t mFlags;
     bool mUIDValid;
@@ -115,11 +137,21 @@ private:
     sp<HTTPBase> mHTTPDataSource;
     KeyedVector<String8, String8> mExtraHeaders;
 
+    size_t mMaxConnections;
+    Vector<DownloaderInfo> mDownloaders;
+
     AString mMasterURL;
 
     Vector<BandwidthItem> mBandwidthItems;
     ssize_t mPrevBandwidthIndex;
 
+    sp<ABRController> mABRController;
+
+    // Largest video dimensions announced by the variant playlist, 0 if
+    // unknown. Decoders are prepared for these to switch variants without
+    // reallocating their output buffers.
+    int32_t mMaxWidth, mMaxHeight;
+
     sp<M3UParser> mPlaylist;
 
     KeyedVector<AString, FetcherInfo> mFetcherInfos;
@@ -141,16 +173,41 @@ private:
 
     sp<PlaylistFetcher> addFetcher(const char *uri);
 
+    // Returns a downloader that is idle, NULL if the connection budget is
+    // spent. It's busy until it has posted the response to its request.
+    sp<HTTPDownloader> acquireDownloader();
+
     void onConnect(const sp<AMessage> &msg);
     status_t onSeek(const sp<AMessage> &msg);
     void onFinishDisconnect2();
 
+    // These download over httpDataSource if given, which makes them safe
+    // to call from an HTTPDownloader's looper.
     status_t fetchFile(
             const char *url, sp<ABuffer> *out,
-            int64_t range_offset = 0, int64_t range_length = -1);
-
+            int64_t range_offset = 0, int64_t range_length = -1,
+            const sp<HTTPBase> &httpDataSource = NULL);
+
+    // fetchFile() in pieces, for callers that consume a file while it is
+    // downloading: openFile() connects, then each readFileBlock() appends
+    // up to maxBytesToRead bytes read at "offset" to *buffer, reallocating
+    // it if it has no room, and returns the number of bytes appended, 0
+    // at the end of the file or range.
+    status_t openFile(
+            const char *url, int64_t range_offset, int64_t range_length,
+            sp<DataSource> *source,
+            const sp<HTTPBase> &httpDataSource = NULL);
+
+    ssize_t readFileBlock(
+            const sp<DataSource> &source, off64_t offset, int64_t range_length,
+            size_t maxBytesToRead, sp<ABuffer> *buffer);
+
+    // Parses a changed playlist incrementally if given its previous
+    // version, see M3UParser.
     sp<M3UParser> fetchPlaylist(
-            const char *url, uint8_t *curPlaylistHash, bool *unchanged);
+            const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+            const sp<M3UParser> &previousPlaylist = NULL,
+            const sp<HTTPBase> &httpDataSource = NULL);
 
     size_t getBandwidthIndex();
 
@@ -162,6 +219,13 @@ private:
     void onChangeConfiguration2(const sp<AMessage> &msg);
     void onChangeConfiguration3(const sp<AMessage> &msg);
 
+    // Changes only the variant: the fetchers of the streams whose URI
+    // changes stop after the segment they're on and the new ones continue
+    // from there, without flushing what is buffered. Falls back to
+    // changeConfiguration() if that isn't possible.
+    void switchBandwidth(size_t bandwidthIndex);
+    void onSwitchBandwidth2(const sp<AMessage> &msg);
+
     void scheduleCheckBandwidthEvent();
     void cancelCheckBandwidthEvent();
 
@@ -230,7 +230,8 @@ bool M3UParser::MediaGroup::getActiveURI(AString *uri) const {
 ////////////////////////////////////////////////////////////////////////////////
 
 M3UParser::M3UParser(
-        const char *baseURI, const void *data, size_t size)
+        const char *baseURI, const void *data, size_t size,
+        const sp<M3UParser> &previous)
     : mInitCheck(NO_INIT),
       mBaseURI(baseURI),
       mIsExtM3U(false),
@@ -238,7 +239,10 @@ M3UParser::M3UParser(
       mIsComplete(false),
       mIsEvent(false),
       mSelectedIndex(-1) {
-    mInitCheck = parse(data, size);
+    mInitCheck = parse(
+            data, size,
+            previous != NULL && previous->mBaseURI == mBaseURI
+                ? previous : NULL);
 }
 
 M3UParser::~M3UParser() {
@@ -439,11 +443,62 @@ static bool MakeURL(const char *baseURL, const char *url, AString *out) {
     return true;
 }
 
-status_t M3UParser::parse(const void *_data, size_t size) {
+// Tags that can appear among a segment's lines without changing anything
+// the parser records for it, other than its duration.
+static bool IsReusableSegmentLine(const char *line, size_t n) {
+    return (n >= 7 && !strncmp(line, "#EXTINF", 7))
+        || (n >= 24 && !strncmp(line, "#EXT-X-PROGRAM-DATE-TIME", 24))
+        || n < 4 || strncmp(line, "#EXT", 4);
+}
+
+ssize_t M3UParser::getReusableItemIndex(
+        const sp<M3UParser> &previous) const {
+    if (previous == NULL || !mIsExtM3U || mIsVariantPlaylist
+            || mMeta == NULL || previous->mIsVariantPlaylist) {
+        return -1;
+    }
+
+    int32_t seqNumber = 0;
+    mMeta->findInt32("media-sequence", &seqNumber);
+
+    int32_t prevSeqNumber = 0;
+    if (previous->mMeta != NULL) {
+        previous->mMeta->findInt32("media-sequence", &prevSeqNumber);
+    }
+
+    ssize_t index = seqNumber + (ssize_t)mItems.size() - prevSeqNumber;
+    if (index < 0 || index >= (ssize_t)previous->mItems.size()) {
+        return -1;
+    }
+
+    // Keys, discontinuities and byte ranges depend on the segments around
+    // it, an item that has any of them is always parsed again.
+    const sp<AMessage> &meta = previous->mItems.itemAt(index).mMeta;
+
+    int32_t discontinuity;
+    int64_t rangeOffset;
+    AString method;
+    if (meta == NULL
+            || meta->findInt32("discontinuity", &discontinuity)
+            || meta->findInt64("range-offset", &rangeOffset)
+            || meta->findString("cipher-method", &method)) {
+        return -1;
+    }
+
+    return index;
+}
+
+status_t M3UParser::parse(
+        const void *_data, size_t size, const sp<M3UParser> &previous) {
     int32_t lineNo = 0;
 
     sp<AMessage> itemMeta;
 
+    // Where the lines of the next item start and, while they are skipped,
+    // the previous playlist's item that is taken over for it.
+    size_t itemOffset = 0;
+    ssize_t reuseIndex = -1;
+
     const char *data = (const char *)_data;
     size_t offset = 0;
     uint64_t segmentRangeOffset = 0;
@@ -453,6 +508,41 @@ status_t M3UParser::parse(const void *_data, size_t size) {
             ++offsetLF;
         }
 
+        if (reuseIndex >= 0) {
+            size_t n = offsetLF - offset;
+            if (n > 0 && data[offsetLF - 1] == '\r') {
+                --n;
+            }
+
+            const char *line = &data[offset];
+            const Item &item = previous->mItems.itemAt(reuseIndex);
+
+            if (n == 0 || (line[0] == '#' && IsReusableSegmentLine(line, n))) {
+                offset = offsetLF + 1;
+                continue;
+            }
+
+            // Compare the resolved URI as a whole, a mere suffix match would
+            // take "10.ts" for "0.ts".
+            AString uri;
+            if (line[0] != '#'
+                    && MakeURL(mBaseURI.c_str(), AString(line, n).c_str(), &uri)
+                    && uri == item.mURI) {
+                mItems.push(item);
+
+                offset = offsetLF + 1;
+
+                itemOffset = offset;
+                reuseIndex = getReusableItemIndex(previous);
+                continue;
+            }
+
+            // Not what the previous playlist had, parse it after all.
+            reuseIndex = -1;
+            offset = itemOffset;
+            continue;
+        }
+
         AString line;
         if (offsetLF > offset && data[offsetLF - 1] == '\r') {
             line.setTo(&data[offset], offsetLF - offset - 1);
@@ -556,6 +646,9 @@ status_t M3UParser::parse(const void *_data, size_t size) {
             item->mMeta = itemMeta;
 
             itemMeta.clear();
+
+            itemOffset = offsetLF + 1;
+            reuseIndex = getReusableItemIndex(previous);
         }
 
         offset = offsetLF + 1;
@@ -684,6 +777,29 @@ status_t M3UParser::parseStreamInf(
                 *meta = new AMessage;
             }
             (*meta)->setInt32("bandwidth", x);
+        } else if (!strcasecmp("resolution", key.c_str())) {
+            const char *s = val.c_str();
+            char *end;
+            unsigned long width = strtoul(s, &end, 10);
+
+            if (end == s || *end != 'x') {
+                // malformed
+                continue;
+            }
+
+            s = end + 1;
+            unsigned long height = strtoul(s, &end, 10);
+
+            if (end == s || *end != '\0') {
+                // malformed
+                continue;
+            }
+
+            if (meta->get() == NULL) {
+                *meta = new AMessage;
+            }
+            (*meta)->setInt32("width", width);
+            (*meta)->setInt32("height", height);
         } else if (!strcasecmp("audio", key.c_str())
                 || !strcasecmp("video", key.c_str())
                 || !strcasecmp("subtitles", key.c_str())) {
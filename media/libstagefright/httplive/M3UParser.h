@@ -26,7 +26,11 @@
 namespace android {
 
 struct M3UParser : public RefBase {
-    M3UParser(const char *baseURI, const void *data, size_t size);
+    // Given the previous version of the same media playlist, the segments
+    // both have in common are taken over from it rather than parsed again.
+    M3UParser(
+            const char *baseURI, const void *data, size_t size,
+            const sp<M3UParser> &previous = NULL);
 
     status_t initCheck() const;
 
@@ -75,7 +79,12 @@ private:
     // Media groups keyed by group ID.
     KeyedVector<AString, sp<MediaGroup> > mMediaGroups;
 
-    status_t parse(const void *data, size_t size);
+    status_t parse(
+            const void *data, size_t size, const sp<M3UParser> &previous);
+
+    // Returns the index of the previous playlist's item that can stand in
+    // for the next item to be parsed, or -1.
+    ssize_t getReusableItemIndex(const sp<M3UParser> &previous) const;
 
     static status_t parseMetaData(
             const AString &line, sp<AMessage> *meta, const char *key);
@@ -20,6 +20,8 @@
 
 #include "PlaylistFetcher.h"
 
+#include "AESDecryptor.h"
+#include "HTTPDownloader.h"
 #include "LiveDataSource.h"
 #include "LiveSession.h"
 #include "M3UParser.h"
@@ -40,7 +42,6 @@
 #include <media/stagefright/Utils.h>
 
 #include <ctype.h>
-#include <openssl/aes.h>
 #include <openssl/md5.h>
 
 namespace android {
@@ -58,11 +59,18 @@ PlaylistFetcher::PlaylistFetcher(
       mStreamTypeMask(0),
       mStartTimeUs(-1ll),
       mLastPlaylistFetchTimeUs(-1ll),
+      mPlaylistFetchPending(false),
       mSeqNumber(-1),
       mNumRetries(0),
       mStartup(true),
       mNextPTSTimeUs(-1ll),
+      mSwitchTimeUs(-1ll),
+      mFormatChangeMask(0),
+      mSegmentFirstTimeUs(-1ll),
+      mNextSegmentTimeUs(-1ll),
       mMonitorQueueGeneration(0),
+      mPrefetchGeneration(0),
+      mWaitingForPrefetch(false),
       mRefreshState(INITIAL_MINIMUM_RELOAD_DELAY),
       mFirstPTSValid(false),
       mAbsoluteTimeAnchorUs(0ll) {
@@ -160,25 +168,32 @@ bool PlaylistFetcher::timeToRefreshPlaylist(int64_t nowUs) const {
     return mLastPlaylistFetchTimeUs + minPlaylistAgeUs <= nowUs;
 }
 
-status_t PlaylistFetcher::decryptBuffer(
-        size_t playlistIndex, const sp<ABuffer> &buffer) {
-    sp<AMessage> itemMeta;
-    bool found = false;
-    AString method;
-
+AString PlaylistFetcher::getCipherMethod(
+        size_t playlistIndex, sp<AMessage> *itemMeta) const {
     for (ssize_t i = playlistIndex; i >= 0; --i) {
         AString uri;
-        CHECK(mPlaylist->itemAt(i, &uri, &itemMeta));
+        sp<AMessage> meta;
+        CHECK(mPlaylist->itemAt(i, &uri, &meta));
 
-        if (itemMeta->findString("cipher-method", &method)) {
-            found = true;
-            break;
+        AString method;
+        if (meta->findString("cipher-method", &method)) {
+            if (itemMeta != NULL) {
+                *itemMeta = meta;
+            }
+            return method;
         }
     }
 
-    if (!found) {
-        method = "NONE";
-    }
+    return "NONE";
+}
+
+status_t PlaylistFetcher::getDecryptor(
+        size_t playlistIndex, int32_t seqNumber,
+        sp<AESDecryptor> *decryptor) {
+    decryptor->clear();
+
+    sp<AMessage> itemMeta;
+    AString method = getCipherMethod(playlistIndex, &itemMeta);
 
     if (method == "NONE") {
         return OK;
@@ -212,13 +227,8 @@ status_t PlaylistFetcher::decryptBuffer(
         mAESKeyForURI.add(keyURI, key);
     }
 
-    AES_KEY aes_key;
-    if (AES_set_decrypt_key(key->data(), 128, &aes_key) != 0) {
-        ALOGE("failed to set AES decryption key.");
-        return UNKNOWN_ERROR;
-    }
-
-    unsigned char aes_ivec[16];
+    uint8_t aes_ivec[16];
+    memset(aes_ivec, 0, sizeof(aes_ivec));
 
     AString iv;
     if (itemMeta->findString("cipher-iv", &iv)) {
@@ -228,7 +238,6 @@ status_t PlaylistFetcher::decryptBuffer(
             return ERROR_MALFORMED;
         }
 
-        memset(aes_ivec, 0, sizeof(aes_ivec));
         for (size_t i = 0; i < 16; ++i) {
             char c1 = tolower(iv.c_str()[2 + 2 * i]);
             char c2 = tolower(iv.c_str()[3 + 2 * i]);
@@ -242,34 +251,20 @@ status_t PlaylistFetcher::decryptBuffer(
             aes_ivec[i] = nibble1 << 4 | nibble2;
         }
     } else {
-        memset(aes_ivec, 0, sizeof(aes_ivec));
-        aes_ivec[15] = mSeqNumber & 0xff;
-        aes_ivec[14] = (mSeqNumber >> 8) & 0xff;
-        aes_ivec[13] = (mSeqNumber >> 16) & 0xff;
-        aes_ivec[12] = (mSeqNumber >> 24) & 0xff;
+        aes_ivec[15] = seqNumber & 0xff;
+        aes_ivec[14] = (seqNumber >> 8) & 0xff;
+        aes_ivec[13] = (seqNumber >> 16) & 0xff;
+        aes_ivec[12] = (seqNumber >> 24) & 0xff;
     }
 
-    AES_cbc_encrypt(
-            buffer->data(), buffer->data(), buffer->size(),
-            &aes_key, aes_ivec, AES_DECRYPT);
-
-    // hexdump(buffer->data(), buffer->size());
-
-    size_t n = buffer->size();
-    CHECK_GT(n, 0u);
+    sp<AESDecryptor> aes = new AESDecryptor;
+    status_t err = aes->init(key->data(), aes_ivec);
 
-    size_t pad = buffer->data()[n - 1];
-
-    CHECK_GT(pad, 0u);
-    CHECK_LE(pad, 16u);
-    CHECK_GE((size_t)n, pad);
-    for (size_t i = 0; i < pad; ++i) {
-        CHECK_EQ((unsigned)buffer->data()[n - 1 - i], pad);
+    if (err != OK) {
+        return err;
     }
 
-    n -= pad;
-
-    buffer->setRange(buffer->offset(), n);
+    *decryptor = aes;
 
     return OK;
 }
@@ -288,7 +283,8 @@ void PlaylistFetcher::startAsync(
         const sp<AnotherPacketSource> &audioSource,
         const sp<AnotherPacketSource> &videoSource,
         const sp<AnotherPacketSource> &subtitleSource,
-        int64_t startTimeUs) {
+        int64_t startTimeUs,
+        int32_t startSeqNumberHint) {
     sp<AMessage> msg = new AMessage(kWhatStart, id());
 
     uint32_t streamTypeMask = 0ul;
@@ -310,6 +306,7 @@ void PlaylistFetcher::startAsync(
 
     msg->setInt32("streamTypeMask", streamTypeMask);
     msg->setInt64("startTimeUs", startTimeUs);
+    msg->setInt32("startSeqNumberHint", startSeqNumberHint);
     msg->post();
 }
 
@@ -317,8 +314,10 @@ void PlaylistFetcher::pauseAsync() {
     (new AMessage(kWhatPause, id()))->post();
 }
 
-void PlaylistFetcher::stopAsync() {
-    (new AMessage(kWhatStop, id()))->post();
+void PlaylistFetcher::stopAsync(bool clear) {
+    sp<AMessage> msg = new AMessage(kWhatStop, id());
+    msg->setInt32("clear", clear);
+    msg->post();
 }
 
 void PlaylistFetcher::onMessageReceived(const sp<AMessage> &msg) {
@@ -346,10 +345,22 @@ void PlaylistFetcher::onMessageReceived(const sp<AMessage> &msg) {
 
         case kWhatStop:
         {
-            onStop();
+            int32_t clear;
+            CHECK(msg->findInt32("clear", &clear));
 
             sp<AMessage> notify = mNotify->dup();
             notify->setInt32("what", kWhatStopped);
+
+            if (!clear) {
+                // Segments are fetched in one go, so this is a segment
+                // boundary.
+                notify->setInt32("streamTypeMask", mStreamTypeMask);
+                notify->setInt32("seqNumber", mSeqNumber);
+                notify->setInt64("timeUs", mNextSegmentTimeUs);
+            }
+
+            onStop(clear);
+
             notify->post();
             break;
         }
@@ -368,6 +379,35 @@ void PlaylistFetcher::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatPrefetched:
+        {
+            onPrefetched(msg);
+            break;
+        }
+
+        case kWhatPlaylistFetched:
+        {
+            mPlaylistFetchPending = false;
+
+            int32_t unchanged;
+            CHECK(msg->findInt32("unchanged", &unchanged));
+
+            sp<ABuffer> hash;
+            CHECK(msg->findBuffer("hash", &hash));
+            memcpy(mPlaylistHash, hash->data(), sizeof(mPlaylistHash));
+
+            sp<M3UParser> playlist;
+            sp<RefBase> obj;
+            if (msg->findObject("playlist", &obj)) {
+                playlist = static_cast<M3UParser *>(obj.get());
+            }
+
+            if (onPlaylistFetched(playlist, unchanged) != OK) {
+                cancelMonitorQueue();
+            }
+            break;
+        }
+
         default:
             TRESPASS();
     }
@@ -382,6 +422,9 @@ status_t PlaylistFetcher::onStart(const sp<AMessage> &msg) {
     int64_t startTimeUs;
     CHECK(msg->findInt64("startTimeUs", &startTimeUs));
 
+    int32_t startSeqNumberHint;
+    CHECK(msg->findInt32("startSeqNumberHint", &startSeqNumberHint));
+
     if (streamTypeMask & LiveSession::STREAMTYPE_AUDIO) {
         void *ptr;
         CHECK(msg->findPointer("audioSource", &ptr));
@@ -410,11 +453,26 @@ status_t PlaylistFetcher::onStart(const sp<AMessage> &msg) {
     }
 
     mStreamTypeMask = streamTypeMask;
-    mStartTimeUs = startTimeUs;
+    mWaitingForPrefetch = false;
+
+    if (startSeqNumberHint >= 0 || startTimeUs >= 0ll) {
+        cancelPrefetches();
+    }
 
-    if (mStartTimeUs >= 0ll) {
-        mSeqNumber = -1;
+    if (startSeqNumberHint >= 0) {
+        mSeqNumber = startSeqNumberHint;
         mStartup = true;
+        mStartTimeUs = -1ll;
+        mSwitchTimeUs = startTimeUs;
+        mFormatChangeMask = streamTypeMask
+            & (LiveSession::STREAMTYPE_AUDIO | LiveSession::STREAMTYPE_VIDEO);
+    } else {
+        mStartTimeUs = startTimeUs;
+
+        if (mStartTimeUs >= 0ll) {
+            mSeqNumber = -1;
+            mStartup = true;
+        }
     }
 
     postMonitorQueue();
@@ -424,16 +482,21 @@ status_t PlaylistFetcher::onStart(const sp<AMessage> &msg) {
 
 void PlaylistFetcher::onPause() {
     cancelMonitorQueue();
+    mWaitingForPrefetch = false;
 
     mPacketSources.clear();
     mStreamTypeMask = 0;
 }
 
-void PlaylistFetcher::onStop() {
+void PlaylistFetcher::onStop(bool clear) {
     cancelMonitorQueue();
+    cancelPrefetches();
+    mWaitingForPrefetch = false;
 
-    for (size_t i = 0; i < mPacketSources.size(); ++i) {
-        mPacketSources.valueAt(i)->clear();
+    if (clear) {
+        for (size_t i = 0; i < mPacketSources.size(); ++i) {
+            mPacketSources.valueAt(i)->clear();
+        }
     }
 
     mPacketSources.clear();
@@ -454,6 +517,136 @@ void PlaylistFetcher::queueDiscontinuity(
     }
 }
 
+void PlaylistFetcher::queueAccessUnit(
+        LiveSession::StreamType stream, const sp<ABuffer> &accessUnit,
+        const sp<MetaData> &format) {
+    if ((mFormatChangeMask & stream) && format != NULL) {
+        // The packet source still holds the previous variant's format,
+        // it picks this one up once it has played out the old data.
+        accessUnit->meta()->setObject("format", format);
+        mFormatChangeMask &= ~stream;
+    }
+
+    int64_t timeUs;
+    if (accessUnit->meta()->findInt64("timeUs", &timeUs)
+            && (mSegmentFirstTimeUs < 0ll || timeUs < mSegmentFirstTimeUs)) {
+        mSegmentFirstTimeUs = timeUs;
+    }
+
+    mPacketSources.valueFor(stream)->queueAccessUnit(accessUnit);
+}
+
+status_t PlaylistFetcher::onPlaylistFetched(
+        const sp<M3UParser> &playlist, bool unchanged) {
+    if (playlist == NULL) {
+        if (unchanged) {
+            // We succeeded in fetching the playlist, but it was
+            // unchanged from the last time we tried.
+
+            if (mRefreshState != THIRD_UNCHANGED_RELOAD_ATTEMPT) {
+                mRefreshState = (RefreshState)(mRefreshState + 1);
+            }
+        } else {
+            ALOGE("failed to load playlist at url '%s'", mURI.c_str());
+            notifyError(ERROR_IO);
+            return ERROR_IO;
+        }
+    } else {
+        mRefreshState = INITIAL_MINIMUM_RELOAD_DELAY;
+        mPlaylist = playlist;
+
+        if (mPlaylist->isComplete() || mPlaylist->isEvent()) {
+            updateDuration();
+        }
+    }
+
+    mLastPlaylistFetchTimeUs = ALooper::GetNowUs();
+
+    return OK;
+}
+
+void PlaylistFetcher::prefetchSegments(int32_t firstSeqNumberInPlaylist) {
+    // Drop whatever was skipped.
+    for (size_t i = mPrefetches.size(); i-- > 0;) {
+        if (mPrefetches.keyAt(i) < mSeqNumber) {
+            mPrefetches.removeItemsAt(i);
+        }
+    }
+
+    int32_t lastSeqNumberInPlaylist =
+        firstSeqNumberInPlaylist + (int32_t)mPlaylist->size() - 1;
+
+    for (int32_t seqNumber = mSeqNumber + 1;
+            seqNumber <= mSeqNumber + kMaxNumPrefetchedSegments
+                && seqNumber <= lastSeqNumberInPlaylist;
+            ++seqNumber) {
+        if (mPrefetches.indexOfKey(seqNumber) >= 0) {
+            continue;
+        }
+
+        // The key is fetched here if need be, so that the downloader can
+        // decrypt the segment on its own looper.
+        sp<AESDecryptor> decryptor;
+        if (getDecryptor(seqNumber - firstSeqNumberInPlaylist, seqNumber,
+                    &decryptor) != OK) {
+            // onDownloadNext() reports it.
+            break;
+        }
+
+        sp<HTTPDownloader> downloader = mSession->acquireDownloader();
+        if (downloader == NULL) {
+            break;
+        }
+
+        AString uri;
+        sp<AMessage> itemMeta;
+        CHECK(mPlaylist->itemAt(
+                    seqNumber - firstSeqNumberInPlaylist, &uri, &itemMeta));
+
+        int64_t range_offset, range_length;
+        if (!itemMeta->findInt64("range-offset", &range_offset)
+                || !itemMeta->findInt64("range-length", &range_length)) {
+            range_offset = 0;
+            range_length = -1;
+        }
+
+        ALOGV("prefetching segment %d", seqNumber);
+
+        sp<AMessage> notify = new AMessage(kWhatPrefetched, id());
+        notify->setInt32("generation", mPrefetchGeneration);
+        notify->setInt32("seqNumber", seqNumber);
+
+        downloader->fetchFileAsync(
+                uri.c_str(), range_offset, range_length, decryptor, notify);
+
+        mPrefetches.add(seqNumber, NULL);
+    }
+}
+
+void PlaylistFetcher::cancelPrefetches() {
+    mPrefetches.clear();
+    ++mPrefetchGeneration;
+}
+
+void PlaylistFetcher::onPrefetched(const sp<AMessage> &msg) {
+    int32_t generation, seqNumber;
+    CHECK(msg->findInt32("generation", &generation));
+    CHECK(msg->findInt32("seqNumber", &seqNumber));
+
+    ssize_t index = mPrefetches.indexOfKey(seqNumber);
+    if (generation != mPrefetchGeneration || index < 0) {
+        // Stale or skipped.
+        return;
+    }
+
+    mPrefetches.editValueAt(index) = msg;
+
+    if (mWaitingForPrefetch && seqNumber == mSeqNumber) {
+        mWaitingForPrefetch = false;
+        postMonitorQueue();
+    }
+}
+
 void PlaylistFetcher::onMonitorQueue() {
     bool downloadMore = false;
 
@@ -489,8 +682,28 @@ void PlaylistFetcher::onMonitorQueue() {
             !first && (minBufferedDurationUs < kMinBufferedDurationUs);
     }
 
+    // At high bitrates a queue can fill up before holding the duration
+    // aimed for, it lets us know when it has room again.
+    bool full = false;
     if (finalResult == OK && downloadMore) {
+        sp<AMessage> spaceNotify = new AMessage(kWhatMonitorQueue, id());
+        spaceNotify->setInt32("generation", mMonitorQueueGeneration);
+
+        for (size_t i = 0; i < mPacketSources.size(); ++i) {
+            if ((mStreamTypeMask & mPacketSources.keyAt(i))
+                    && mPacketSources.valueAt(i)->isFull(spaceNotify)) {
+                full = true;
+                break;
+            }
+        }
+    }
+
+    if (finalResult == OK && downloadMore && !full) {
         onDownloadNext();
+    } else if (full) {
+        sp<AMessage> msg = mNotify->dup();
+        msg->setInt32("what", kWhatTemporarilyDoneFetching);
+        msg->post();
     } else {
         // Nothing to do yet, try again in a second.
 
@@ -505,35 +718,31 @@ void PlaylistFetcher::onMonitorQueue() {
 void PlaylistFetcher::onDownloadNext() {
     int64_t nowUs = ALooper::GetNowUs();
 
-    if (mLastPlaylistFetchTimeUs < 0ll
-            || (!mPlaylist->isComplete() && timeToRefreshPlaylist(nowUs))) {
-        bool unchanged;
-        sp<M3UParser> playlist = mSession->fetchPlaylist(
-                mURI.c_str(), mPlaylistHash, &unchanged);
+    if (!mPlaylistFetchPending
+            && (mLastPlaylistFetchTimeUs < 0ll
+                || (!mPlaylist->isComplete() && timeToRefreshPlaylist(nowUs)))) {
+        // Once there is a playlist, refresh it in the background if a
+        // connection is to spare and keep going with the one we have.
+        sp<HTTPDownloader> downloader;
+        if (mPlaylist != NULL) {
+            downloader = mSession->acquireDownloader();
+        }
 
-        if (playlist == NULL) {
-            if (unchanged) {
-                // We succeeded in fetching the playlist, but it was
-                // unchanged from the last time we tried.
+        if (downloader != NULL) {
+            downloader->fetchPlaylistAsync(
+                    mURI.c_str(), mPlaylistHash, mPlaylist,
+                    new AMessage(kWhatPlaylistFetched, id()));
 
-                if (mRefreshState != THIRD_UNCHANGED_RELOAD_ATTEMPT) {
-                    mRefreshState = (RefreshState)(mRefreshState + 1);
-                }
-            } else {
-                ALOGE("failed to load playlist at url '%s'", mURI.c_str());
-                notifyError(ERROR_IO);
-                return;
-            }
+            mPlaylistFetchPending = true;
         } else {
-            mRefreshState = INITIAL_MINIMUM_RELOAD_DELAY;
-            mPlaylist = playlist;
+            bool unchanged;
+            sp<M3UParser> playlist = mSession->fetchPlaylist(
+                    mURI.c_str(), mPlaylistHash, &unchanged, mPlaylist);
 
-            if (mPlaylist->isComplete() || mPlaylist->isEvent()) {
-                updateDuration();
+            if (onPlaylistFetched(playlist, unchanged) != OK) {
+                return;
             }
         }
-
-        mLastPlaylistFetchTimeUs = ALooper::GetNowUs();
     }
 
     int32_t firstSeqNumberInPlaylist;
@@ -581,6 +790,7 @@ void PlaylistFetcher::onDownloadNext() {
             ALOGI("We've missed the boat, restarting playback.");
             mSeqNumber = lastSeqNumberInPlaylist;
             explicitDiscontinuity = true;
+            cancelPrefetches();
 
             // fall through
         } else {
@@ -620,38 +830,100 @@ void PlaylistFetcher::onDownloadNext() {
 
     ALOGV("fetching '%s'", uri.c_str());
 
-    sp<ABuffer> buffer;
-    status_t err = mSession->fetchFile(
-            uri.c_str(), &buffer, range_offset, range_length);
+    size_t playlistIndex = mSeqNumber - firstSeqNumberInPlaylist;
 
-    if (err != OK) {
-        ALOGE("failed to fetch .ts segment at url '%s'", uri.c_str());
-        notifyError(err);
-        return;
-    }
+    prefetchSegments(firstSeqNumberInPlaylist);
 
-    CHECK(buffer != NULL);
+    sp<ABuffer> prefetchedBuffer;
+    int64_t fetchStartTimeUs = -1ll;
+    int64_t fetchEndTimeUs = -1ll;
 
-    err = decryptBuffer(mSeqNumber - firstSeqNumberInPlaylist, buffer);
+    ssize_t prefetchIndex = mPrefetches.indexOfKey(mSeqNumber);
+    if (prefetchIndex >= 0) {
+        sp<AMessage> response = mPrefetches.valueAt(prefetchIndex);
+
+        if (response == NULL) {
+            // Still downloading, onPrefetched() gets us going again.
+            mWaitingForPrefetch = true;
+            return;
+        }
+
+        mPrefetches.removeItemsAt(prefetchIndex);
+
+        int32_t prefetchErr;
+        CHECK(response->findInt32("err", &prefetchErr));
+
+        if (prefetchErr == OK) {
+            CHECK(response->findBuffer("buffer", &prefetchedBuffer));
+            CHECK(response->findInt64("startTimeUs", &fetchStartTimeUs));
+            CHECK(response->findInt64("endTimeUs", &fetchEndTimeUs));
+        } else {
+            ALOGW("prefetching segment %d failed w/ error %d, retrying",
+                  mSeqNumber, prefetchErr);
+        }
+    }
+
+    // Get the key now; it may have to be fetched over the connection the
+    // segment is about to be downloaded on. Prefetched segments have been
+    // decrypted by their downloader already.
+    sp<AESDecryptor> decryptor;
+    status_t err = OK;
+    if (prefetchedBuffer == NULL) {
+        err = getDecryptor(playlistIndex, mSeqNumber, &decryptor);
+    }
 
     if (err != OK) {
-        ALOGE("decryptBuffer failed w/ error %d", err);
+        ALOGE("getDecryptor failed w/ error %d", err);
 
         notifyError(err);
         return;
     }
 
+    sp<DataSource> source;
+    if (prefetchedBuffer == NULL) {
+        fetchStartTimeUs = ALooper::GetNowUs();
+
+        err = mSession->openFile(
+                uri.c_str(), range_offset, range_length, &source);
+
+        if (err != OK) {
+            ALOGE("failed to fetch .ts segment at url '%s'", uri.c_str());
+            notifyError(err);
+            return;
+        }
+    }
+
     if (mStartup || seekDiscontinuity || explicitDiscontinuity) {
         // Signal discontinuity.
 
-        if (mPlaylist->isComplete() || mPlaylist->isEvent()) {
+        if (mStartup && mSwitchTimeUs >= 0ll) {
+            // Continue the timeline of the variant switched away from.
+            mNextPTSTimeUs = mSwitchTimeUs;
+        } else if (mPlaylist->isComplete() || mPlaylist->isEvent()) {
             // If this was a live event this made no sense since
             // we don't have access to all the segment before the current
             // one.
             mNextPTSTimeUs = getSegmentStartTimeUs(mSeqNumber);
         }
 
-        if (seekDiscontinuity || explicitDiscontinuity) {
+        if (mStartup && mFormatChangeMask != 0) {
+            // Switching variants, the data already queued is still played.
+            ALOGI("queueing format change (explicit=%d)",
+                 explicitDiscontinuity);
+
+            ATSParser::DiscontinuityType type = explicitDiscontinuity
+                ? ATSParser::DISCONTINUITY_FORMATCHANGE
+                : (ATSParser::DiscontinuityType)
+                    (ATSParser::DISCONTINUITY_AUDIO_FORMAT
+                        | ATSParser::DISCONTINUITY_VIDEO_FORMAT);
+
+            for (size_t i = 0; i < mPacketSources.size(); ++i) {
+                if (mFormatChangeMask & mPacketSources.keyAt(i)) {
+                    mPacketSources.valueAt(i)->queueDiscontinuity(
+                            type, NULL /* extra */, false /* discard */);
+                }
+            }
+        } else if (seekDiscontinuity || explicitDiscontinuity) {
             ALOGI("queueing discontinuity (seek=%d, explicit=%d)",
                  seekDiscontinuity, explicitDiscontinuity);
 
@@ -663,11 +935,53 @@ void PlaylistFetcher::onDownloadNext() {
         }
     }
 
-    err = extractAndQueueAccessUnits(buffer, itemMeta);
+    mSegmentFirstTimeUs = -1ll;
 
-    if (err != OK) {
-        notifyError(err);
-        return;
+    sp<ABuffer> buffer;
+    off64_t bytesRead;
+    bool isTS = false;
+
+    if (prefetchedBuffer != NULL) {
+        buffer = prefetchedBuffer;
+        bytesRead = buffer->size();
+    } else {
+        err = downloadSegment(
+                source, decryptor, range_length, &buffer, &bytesRead,
+                &isTS);
+
+        if (err != OK) {
+            notifyError(err);
+            return;
+        }
+
+        fetchEndTimeUs = ALooper::GetNowUs();
+    }
+
+    if (!isTS) {
+        err = extractAndQueueAccessUnits(buffer, itemMeta);
+
+        if (err != OK) {
+            notifyError(err);
+            return;
+        }
+    }
+
+    int64_t durationUs;
+    if (mSegmentFirstTimeUs >= 0ll
+            && itemMeta->findInt64("durationUs", &durationUs)) {
+        mNextSegmentTimeUs = mSegmentFirstTimeUs + durationUs;
+    } else {
+        mNextSegmentTimeUs = -1ll;
+    }
+
+    if (mStreamTypeMask != LiveSession::STREAMTYPE_SUBTITLES) {
+        // Subtitle files are too small to tell the throughput.
+        sp<AMessage> notify = mNotify->dup();
+        notify->setInt32("what", kWhatSegmentFetched);
+        notify->setInt64("bytes", bytesRead);
+        notify->setInt64("startTimeUs", fetchStartTimeUs);
+        notify->setInt64("endTimeUs", fetchEndTimeUs);
+        notify->post();
     }
 
     ++mSeqNumber;
@@ -675,6 +989,128 @@ void PlaylistFetcher::onDownloadNext() {
     postMonitorQueue();
 
     mStartup = false;
+    mSwitchTimeUs = -1ll;
+}
+
+status_t PlaylistFetcher::downloadSegment(
+        const sp<DataSource> &source, const sp<AESDecryptor> &decryptor,
+        int64_t range_length, sp<ABuffer> *out, off64_t *bytesRead,
+        bool *isTS) {
+    // A transport stream is decrypted and parsed block by block as it
+    // arrives, so that its first access units are queued long before the
+    // segment is complete, and only the last partial packet is kept.
+    // Anything else is collected and returned as a whole.
+
+    sp<ABuffer> buffer = new ABuffer(kDownloadBlockSize);
+    buffer->setRange(0, 0);
+
+    // What is left to collect once the buffer is full, so that it is only
+    // reallocated once, or else doubled each time.
+    off64_t totalSize;
+    if (range_length >= 0) {
+        totalSize = range_length;
+    } else if (source->getSize(&totalSize) != OK) {
+        totalSize = -1;
+    }
+
+    *bytesRead = 0;
+    *isTS = false;
+
+    size_t bytesDecrypted = 0;
+    bool formatKnown = false;
+
+    for (;;) {
+        if (buffer->offset() > 0) {
+            memmove(buffer->base(), buffer->data(), buffer->size());
+            buffer->setRange(0, buffer->size());
+        }
+
+        size_t bufferRemaining = buffer->capacity() - buffer->size();
+        if (bufferRemaining == 0) {
+            if (totalSize > *bytesRead) {
+                bufferRemaining = totalSize - *bytesRead;
+            } else {
+                bufferRemaining = buffer->capacity();
+            }
+            if (bufferRemaining < (size_t)kDownloadBlockSize) {
+                bufferRemaining = kDownloadBlockSize;
+            }
+        }
+
+        ssize_t n = mSession->readFileBlock(
+                source, *bytesRead, range_length, bufferRemaining, &buffer);
+
+        if (n < 0) {
+            ALOGE("failed to read segment w/ error %d", n);
+            return n;
+        }
+
+        *bytesRead += n;
+        bool done = (n == 0);
+
+        size_t bytesToDecrypt = buffer->size() - bytesDecrypted;
+        if (!done) {
+            bytesToDecrypt &= ~15;
+        }
+
+        if (decryptor != NULL && bytesToDecrypt > 0) {
+            status_t err = decryptor->decrypt(
+                    buffer->data() + bytesDecrypted, bytesToDecrypt);
+
+            if (err != OK) {
+                return err;
+            }
+        }
+
+        bytesDecrypted += bytesToDecrypt;
+
+        if (done && decryptor != NULL) {
+            status_t err = AESDecryptor::removePadding(buffer);
+
+            if (err != OK) {
+                return err;
+            }
+
+            bytesDecrypted = buffer->size();
+        }
+
+        if (!formatKnown && bytesDecrypted > 0) {
+            formatKnown = true;
+            *isTS = (buffer->data()[0] == 0x47);
+        }
+
+        if (*isTS) {
+            size_t bytesToParse = (bytesDecrypted / 188) * 188;
+
+            if (done && bytesToParse != buffer->size()) {
+                ALOGE("MPEG2 transport stream is not an even multiple of 188 "
+                      "bytes in length.");
+                return ERROR_MALFORMED;
+            }
+
+            status_t err = extractAndQueueTSAccessUnits(
+                    new ABuffer(buffer->data(), bytesToParse), done);
+
+            if (err != OK) {
+                return err;
+            }
+
+            buffer->setRange(
+                    buffer->offset() + bytesToParse,
+                    buffer->size() - bytesToParse);
+
+            bytesDecrypted -= bytesToParse;
+        }
+
+        if (done) {
+            break;
+        }
+    }
+
+
+    *out = buffer;
+
+    return OK;
 }
 
 int32_t PlaylistFetcher::getSeqNumberForTime(int64_t timeUs) const {
@@ -720,83 +1156,7 @@ status_t PlaylistFetcher::extractAndQueueAccessUnits(
             return ERROR_MALFORMED;
         }
 
-        if (mTSParser == NULL) {
-            mTSParser = new ATSParser;
-        }
-
-        if (mNextPTSTimeUs >= 0ll) {
-            sp<AMessage> extra = new AMessage;
-            extra->setInt64(IStreamListener::kKeyMediaTimeUs, mNextPTSTimeUs);
-
-            mTSParser->signalDiscontinuity(
-                    ATSParser::DISCONTINUITY_SEEK, extra);
-
-            mNextPTSTimeUs = -1ll;
-        }
-
-        size_t offset = 0;
-        while (offset < buffer->size()) {
-            status_t err = mTSParser->feedTSPacket(buffer->data() + offset, 188);
-
-            if (err != OK) {
-                return err;
-            }
-
-            offset += 188;
-        }
-
-        for (size_t i = mPacketSources.size(); i-- > 0;) {
-            sp<AnotherPacketSource> packetSource = mPacketSources.valueAt(i);
-
-            ATSParser::SourceType type;
-            switch (mPacketSources.keyAt(i)) {
-                case LiveSession::STREAMTYPE_VIDEO:
-                    type = ATSParser::VIDEO;
-                    break;
-
-                case LiveSession::STREAMTYPE_AUDIO:
-                    type = ATSParser::AUDIO;
-                    break;
-
-                case LiveSession::STREAMTYPE_SUBTITLES:
-                {
-                    ALOGE("MPEG2 Transport streams do not contain subtitles.");
-                    return ERROR_MALFORMED;
-                    break;
-                }
-
-                default:
-                    TRESPASS();
-            }
-
-            sp<AnotherPacketSource> source =
-                static_cast<AnotherPacketSource *>(
-                        mTSParser->getSource(type).get());
-
-            if (source == NULL) {
-                ALOGW("MPEG2 Transport stream does not contain %s data.",
-                      type == ATSParser::VIDEO ? "video" : "audio");
-
-                mStreamTypeMask &= ~mPacketSources.keyAt(i);
-                mPacketSources.removeItemsAt(i);
-                continue;
-            }
-
-            sp<ABuffer> accessUnit;
-            status_t finalResult;
-            while (source->hasBufferAvailable(&finalResult)
-                    && source->dequeueAccessUnit(&accessUnit) == OK) {
-                // Note that we do NOT dequeue any discontinuities.
-
-                packetSource->queueAccessUnit(accessUnit);
-            }
-
-            if (packetSource->getFormat() == NULL) {
-                packetSource->setFormat(source->getFormat());
-            }
-        }
-
-        return OK;
+        return extractAndQueueTSAccessUnits(buffer, true /* segmentDone */);
     } else if (buffer->size() >= 7 && !memcmp("WEBVTT\n", buffer->data(), 7)) {
         if (mStreamTypeMask != LiveSession::STREAMTYPE_SUBTITLES) {
             ALOGE("This stream only contains subtitles.");
@@ -896,7 +1256,11 @@ status_t PlaylistFetcher::extractAndQueueAccessUnits(
     sp<AnotherPacketSource> packetSource =
         mPacketSources.valueFor(LiveSession::STREAMTYPE_AUDIO);
 
-    if (packetSource->getFormat() == NULL && buffer->size() >= 7) {
+    sp<MetaData> format = packetSource->getFormat();
+
+    if ((format == NULL
+                || (mFormatChangeMask & LiveSession::STREAMTYPE_AUDIO))
+            && buffer->size() >= 7) {
         ABitReader bits(buffer->data(), buffer->size());
 
         // adts_fixed_header
@@ -918,12 +1282,16 @@ status_t PlaylistFetcher::extractAndQueueAccessUnits(
 
         meta->setInt32(kKeyIsADTS, true);
 
-        packetSource->setFormat(meta);
+        if (format == NULL) {
+            packetSource->setFormat(meta);
+        }
+
+        format = meta;
     }
 
     int64_t numSamples = 0ll;
     int32_t sampleRate;
-    CHECK(packetSource->getFormat()->findInt32(kKeySampleRate, &sampleRate));
+    CHECK(format->findInt32(kKeySampleRate, &sampleRate));
 
     size_t offset = 0;
     while (offset < buffer->size()) {
@@ -946,7 +1314,7 @@ status_t PlaylistFetcher::extractAndQueueAccessUnits(
         // Each AAC frame encodes 1024 samples.
         numSamples += 1024;
 
-        packetSource->queueAccessUnit(unit);
+        queueAccessUnit(LiveSession::STREAMTYPE_AUDIO, unit, format);
 
         offset += aac_frame_length;
     }
@@ -954,6 +1322,88 @@ status_t PlaylistFetcher::extractAndQueueAccessUnits(
     return OK;
 }
 
+status_t PlaylistFetcher::extractAndQueueTSAccessUnits(
+        const sp<ABuffer> &buffer, bool segmentDone) {
+    if (mTSParser == NULL) {
+        mTSParser = new ATSParser;
+    }
+
+    if (mNextPTSTimeUs >= 0ll) {
+        sp<AMessage> extra = new AMessage;
+        extra->setInt64(IStreamListener::kKeyMediaTimeUs, mNextPTSTimeUs);
+
+        mTSParser->signalDiscontinuity(
+                ATSParser::DISCONTINUITY_SEEK, extra);
+
+        mNextPTSTimeUs = -1ll;
+    }
+
+    status_t err = mTSParser->feedTSPackets(buffer->data(), buffer->size());
+
+    if (err != OK) {
+        return err;
+    }
+
+    for (size_t i = mPacketSources.size(); i-- > 0;) {
+        sp<AnotherPacketSource> packetSource = mPacketSources.valueAt(i);
+
+        ATSParser::SourceType type;
+        switch (mPacketSources.keyAt(i)) {
+            case LiveSession::STREAMTYPE_VIDEO:
+                type = ATSParser::VIDEO;
+                break;
+
+            case LiveSession::STREAMTYPE_AUDIO:
+                type = ATSParser::AUDIO;
+                break;
+
+            case LiveSession::STREAMTYPE_SUBTITLES:
+            {
+                ALOGE("MPEG2 Transport streams do not contain subtitles.");
+                return ERROR_MALFORMED;
+                break;
+            }
+
+            default:
+                TRESPASS();
+        }
+
+        sp<AnotherPacketSource> source =
+            static_cast<AnotherPacketSource *>(
+                    mTSParser->getSource(type).get());
+
+        if (source == NULL) {
+            if (!segmentDone) {
+                // The PMT may not have been seen yet.
+                continue;
+            }
+
+            ALOGW("MPEG2 Transport stream does not contain %s data.",
+                  type == ATSParser::VIDEO ? "video" : "audio");
+
+            mStreamTypeMask &= ~mPacketSources.keyAt(i);
+            mPacketSources.removeItemsAt(i);
+            continue;
+        }
+
+        sp<ABuffer> accessUnit;
+        status_t finalResult;
+        while (source->hasBufferAvailable(&finalResult)
+                && source->dequeueAccessUnit(&accessUnit) == OK) {
+            // Note that we do NOT dequeue any discontinuities.
+
+            queueAccessUnit(
+                    mPacketSources.keyAt(i), accessUnit, source->getFormat());
+        }
+
+        if (packetSource->getFormat() == NULL) {
+            packetSource->setFormat(source->getFormat());
+        }
+    }
+
+    return OK;
+}
+
 void PlaylistFetcher::updateDuration() {
     int64_t durationUs = 0ll;
     for (size_t index = 0; index < mPlaylist->size(); ++index) {
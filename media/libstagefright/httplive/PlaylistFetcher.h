@@ -26,11 +26,13 @@
 namespace android {
 
 struct ABuffer;
+struct AESDecryptor;
 struct AnotherPacketSource;
 struct DataSource;
 struct HTTPBase;
 struct LiveDataSource;
 struct M3UParser;
+struct MetaData;
 struct String8;
 
 struct PlaylistFetcher : public AHandler {
@@ -43,6 +45,7 @@ struct PlaylistFetcher : public AHandler {
         kWhatTemporarilyDoneFetching,
         kWhatPrepared,
         kWhatPreparationFailed,
+        kWhatSegmentFetched,
     };
 
     PlaylistFetcher(
@@ -52,15 +55,21 @@ struct PlaylistFetcher : public AHandler {
 
     sp<DataSource> getDataSource();
 
+    // With a startSeqNumberHint the fetcher takes over from the fetcher of
+    // another variant: it starts at that segment, which starts at media
+    // time startTimeUs (-1 if unknown), and keeps what is already queued.
     void startAsync(
             const sp<AnotherPacketSource> &audioSource,
             const sp<AnotherPacketSource> &videoSource,
             const sp<AnotherPacketSource> &subtitleSource,
-            int64_t startTimeUs = -1ll);
+            int64_t startTimeUs = -1ll,
+            int32_t startSeqNumberHint = -1);
 
     void pauseAsync();
 
-    void stopAsync();
+    // Unless "clear" is false the packet sources are flushed. Otherwise
+    // kWhatStopped reports the segment to continue at, see startAsync().
+    void stopAsync(bool clear = true);
 
 protected:
     virtual ~PlaylistFetcher();
@@ -69,13 +78,21 @@ protected:
 private:
     enum {
         kMaxNumRetries         = 5,
+        // Segments are read this much at a time; a multiple of both the TS
+        // packet and the AES block size.
+        kDownloadBlockSize     = 47 * 1024,
+        // Segments are downloaded this far ahead of the one being parsed,
+        // as far as the session has connections to spare.
+        kMaxNumPrefetchedSegments = 3,
     };
 
     enum {
-        kWhatStart          = 'strt',
-        kWhatPause          = 'paus',
-        kWhatStop           = 'stop',
-        kWhatMonitorQueue   = 'moni',
+        kWhatStart              = 'strt',
+        kWhatPause              = 'paus',
+        kWhatStop               = 'stop',
+        kWhatMonitorQueue       = 'moni',
+        kWhatPrefetched         = 'pref',
+        kWhatPlaylistFetched    = 'plst',
     };
 
     static const int64_t kMinBufferedDurationUs;
@@ -93,14 +110,31 @@ private:
     KeyedVector<AString, sp<ABuffer> > mAESKeyForURI;
 
     int64_t mLastPlaylistFetchTimeUs;
+    bool mPlaylistFetchPending;
     sp<M3UParser> mPlaylist;
     int32_t mSeqNumber;
     int32_t mNumRetries;
     bool mStartup;
     int64_t mNextPTSTimeUs;
 
+    // Set while taking over from another variant's fetcher.
+    int64_t mSwitchTimeUs;
+    // Streams whose next access unit has to carry its format.
+    uint32_t mFormatChangeMask;
+
+    // Media time of the first access unit of the current segment and
+    // where the next one starts, -1 if unknown.
+    int64_t mSegmentFirstTimeUs;
+    int64_t mNextSegmentTimeUs;
+
     int32_t mMonitorQueueGeneration;
 
+    // The responses to the prefetches, by sequence number, NULL while
+    // still downloading.
+    KeyedVector<int32_t, sp<AMessage> > mPrefetches;
+    int32_t mPrefetchGeneration;
+    bool mWaitingForPrefetch;
+
     enum RefreshState {
         INITIAL_MINIMUM_RELOAD_DELAY,
         FIRST_UNCHANGED_RELOAD_ATTEMPT,
@@ -117,12 +151,25 @@ private:
     uint64_t mFirstPTS;
     int64_t mAbsoluteTimeAnchorUs;
 
-    status_t decryptBuffer(
-            size_t playlistIndex, const sp<ABuffer> &buffer);
+    AString getCipherMethod(
+            size_t playlistIndex, sp<AMessage> *itemMeta) const;
+
+    // Returns a decryptor set up for the given segment, fetching its key
+    // if need be, or NULL if the segment isn't encrypted.
+    status_t getDecryptor(
+            size_t playlistIndex, int32_t seqNumber,
+            sp<AESDecryptor> *decryptor);
 
     void postMonitorQueue(int64_t delayUs = 0);
     void cancelMonitorQueue();
 
+    void prefetchSegments(int32_t firstSeqNumberInPlaylist);
+    void cancelPrefetches();
+    void onPrefetched(const sp<AMessage> &msg);
+
+    // Takes over a freshly fetched playlist.
+    status_t onPlaylistFetched(const sp<M3UParser> &playlist, bool unchanged);
+
     bool timeToRefreshPlaylist(int64_t nowUs) const;
 
     // Returns the media time in us of the segment specified by seqNumber.
@@ -131,18 +178,34 @@ private:
 
     status_t onStart(const sp<AMessage> &msg);
     void onPause();
-    void onStop();
+    void onStop(bool clear);
     void onMonitorQueue();
     void onDownloadNext();
 
+    // Downloads the segment, feeding a transport stream to the parser as it
+    // arrives; anything else is returned in *buffer.
+    status_t downloadSegment(
+            const sp<DataSource> &source, const sp<AESDecryptor> &decryptor,
+            int64_t range_length, sp<ABuffer> *buffer, off64_t *bytesRead,
+            bool *isTS);
+
     status_t extractAndQueueAccessUnits(
             const sp<ABuffer> &buffer, const sp<AMessage> &itemMeta);
 
+    // Feeds whole TS packets of the current segment to the parser and
+    // queues the access units it has so far.
+    status_t extractAndQueueTSAccessUnits(
+            const sp<ABuffer> &buffer, bool segmentDone);
+
     void notifyError(status_t err);
 
     void queueDiscontinuity(
             ATSParser::DiscontinuityType type, const sp<AMessage> &extra);
 
+    void queueAccessUnit(
+            LiveSession::StreamType stream, const sp<ABuffer> &accessUnit,
+            const sp<MetaData> &format);
+
     int32_t getSeqNumberForTime(int64_t timeUs) const;
 
     void updateDuration();
@@ -25,6 +25,7 @@
 #include <media/stagefright/Utils.h>
 #include <utils/String8.h>
 #include <byteswap.h>
+#include <ctype.h>
 
 namespace android {
 
@@ -62,8 +63,11 @@ ID3::ID3(const sp<DataSource> &source, bool ignoreV1)
       mSize(0),
       mFirstFrameOffset(0),
       mVersion(ID3_UNKNOWN),
-      mRawSize(0) {
-    mIsValid = parseV2(source);
+      mRawSize(0),
+      mAlbumArtOffset(0),
+      mAlbumArtLength(0),
+      mAlbumArtData(NULL) {
+    mIsValid = parseV2(source, true /* deferAlbumArt */);
 
     if (!mIsValid && !ignoreV1) {
         mIsValid = parseV1(source);
@@ -76,10 +80,14 @@ ID3::ID3(const uint8_t *data, size_t size, bool ignoreV1)
       mSize(0),
       mFirstFrameOffset(0),
       mVersion(ID3_UNKNOWN),
-      mRawSize(0) {
+      mRawSize(0),
+      mAlbumArtOffset(0),
+      mAlbumArtLength(0),
+      mAlbumArtData(NULL) {
     sp<MemorySource> source = new MemorySource(data, size);
 
-    mIsValid = parseV2(source);
+    // The caller's buffer isn't ours to keep, read everything.
+    mIsValid = parseV2(source, false /* deferAlbumArt */);
 
     if (!mIsValid && !ignoreV1) {
         mIsValid = parseV1(source);
@@ -91,6 +99,9 @@ ID3::~ID3() {
         free(mData);
         mData = NULL;
     }
+
+    free(mAlbumArtData);
+    mAlbumArtData = NULL;
 }
 
 bool ID3::isValid() const {
@@ -115,7 +126,7 @@ bool ID3::ParseSyncsafeInteger(const uint8_t encoded[4], size_t *x) {
     return true;
 }
 
-bool ID3::parseV2(const sp<DataSource> &source) {
+bool ID3::parseV2(const sp<DataSource> &source, bool deferAlbumArt) {
 struct id3_header {
     char id[3];
     uint8_t version_major;
@@ -176,30 +187,51 @@ struct id3_header {
         return false;
     }
 
-    mData = (uint8_t *)malloc(size);
+    mRawSize = size + sizeof(header);
 
-    if (mData == NULL) {
-        return false;
-    }
+    // Tags that are unsynchronized or have an extended header as a whole
+    // are rare enough to always be read in one go.
+    bool lazy = deferAlbumArt
+        && (header.version_major == 3 || header.version_major == 4)
+        && !(header.flags & 0xc0)
+        && parseV2Lazily(source, size, header.version_major);
 
-    mSize = size;
-    mRawSize = mSize + sizeof(header);
+    if (!lazy) {
+        mData = (uint8_t *)malloc(size);
 
-    if (source->readAt(sizeof(header), mData, mSize) != (ssize_t)mSize) {
-        free(mData);
-        mData = NULL;
+        if (mData == NULL) {
+            return false;
+        }
 
-        return false;
+        mSize = size;
+
+        if (source->readAt(sizeof(header), mData, mSize) != (ssize_t)mSize) {
+            free(mData);
+            mData = NULL;
+
+            return false;
+        }
     }
 
     if (header.version_major == 4) {
-        void *copy = malloc(size);
-        memcpy(copy, mData, size);
+        size_t dataSize = mSize;
+        void *copy = malloc(dataSize);
+        memcpy(copy, mData, dataSize);
 
         bool success = removeUnsynchronizationV2_4(false /* iTunesHack */);
-        if (!success) {
-            memcpy(mData, copy, size);
-            mSize = size;
+        if (!success && lazy) {
+            // The frames were walked assuming syncsafe sizes, start over
+            // with the whole tag.
+            free(copy);
+            free(mData);
+            mData = NULL;
+            mSource.clear();
+            mAlbumArtLength = 0;
+
+            return parseV2(source, false /* deferAlbumArt */);
+        } else if (!success) {
+            memcpy(mData, copy, dataSize);
+            mSize = dataSize;
 
             success = removeUnsynchronizationV2_4(true /* iTunesHack */);
 
@@ -307,6 +339,182 @@ struct id3_header {
     return true;
 }
 
+static void WriteSyncsafeInteger(uint8_t *dst, size_t x) {
+    for (size_t i = 0; i < 4; ++i) {
+        dst[3 - i] = (x & 0x7f);
+        x >>= 7;
+    }
+}
+
+// Returns the size of the part of an APIC frame that precedes the image,
+// or 0 if it is not within the first "size" bytes.
+static size_t GetAPICHeaderSize(
+        const uint8_t *data, size_t size, String8 *mime) {
+    if (size < 2) {
+        return 0;
+    }
+
+    uint8_t encoding = data[0];
+
+    const uint8_t *mimeEnd = (const uint8_t *)memchr(&data[1], 0, size - 1);
+    if (mimeEnd == NULL) {
+        return 0;
+    }
+
+    // Skip the terminator and the picture type.
+    size_t offset = mimeEnd - data + 2;
+
+    if (encoding == 0x01 || encoding == 0x02) {
+        // UCS-2 and UTF-16BE descriptions end with two zero bytes.
+        for (; offset + 1 < size; offset += 2) {
+            if (data[offset] == 0 && data[offset + 1] == 0) {
+                mime->setTo((const char *)&data[1]);
+                return offset + 2;
+            }
+        }
+        return 0;
+    }
+
+    for (; offset < size; ++offset) {
+        if (data[offset] == 0) {
+            mime->setTo((const char *)&data[1]);
+            return offset + 1;
+        }
+    }
+
+    return 0;
+}
+
+// Reads the frames one at a time from the source, all but the image of the
+// first APIC frame when that is large. The frame is kept, cut down to the
+// part before the image, so that the iterators see the same frames as
+// before. Returns false if there was nothing worth deferring or the frames
+// don't add up, the whole tag is then read as usual.
+bool ID3::parseV2Lazily(
+        const sp<DataSource> &source, size_t size, uint8_t majorVersion) {
+    static const size_t kMinDeferredAlbumArtSize = 16384;
+    static const size_t kMaxAPICHeaderSize = 512;
+
+    static const size_t kHeaderSize = 10;
+
+    size_t capacity = 4096;
+    uint8_t *data = (uint8_t *)malloc(capacity);
+    size_t dataSize = 0;
+
+    bool sawAPIC = false;
+    size_t offset = 0;
+    while (offset + kHeaderSize <= size) {
+        uint8_t frameHeader[kHeaderSize];
+        if (data == NULL
+                || source->readAt(kHeaderSize + offset, frameHeader, kHeaderSize)
+                        != (ssize_t)kHeaderSize) {
+            break;
+        }
+
+        if (frameHeader[0] == 0) {
+            // Padding.
+            offset = size;
+            break;
+        }
+
+        bool validID = true;
+        for (size_t i = 0; i < 4; ++i) {
+            if (!isupper(frameHeader[i]) && !isdigit(frameHeader[i])) {
+                validID = false;
+            }
+        }
+
+        size_t frameSize;
+        if (majorVersion == 4) {
+            if (!ParseSyncsafeInteger(&frameHeader[4], &frameSize)) {
+                break;
+            }
+        } else {
+            frameSize = U32_AT(&frameHeader[4]);
+        }
+
+        if (!validID || frameSize > size - offset - kHeaderSize) {
+            break;
+        }
+
+        // Compressed, encrypted or unsynchronized frames are read whole.
+        uint16_t flags = U16_AT(&frameHeader[8]);
+        bool plain = (flags & (majorVersion == 4 ? 0x000f : 0x00c0)) == 0;
+
+        off64_t frameOffset = kHeaderSize + offset + kHeaderSize;
+        size_t keep = frameSize;
+
+        if (!memcmp(frameHeader, "APIC", 4)) {
+            if (!sawAPIC && plain && frameSize >= kMinDeferredAlbumArtSize) {
+                uint8_t apicHeader[kMaxAPICHeaderSize];
+                ssize_t n = source->readAt(
+                        frameOffset, apicHeader, kMaxAPICHeaderSize);
+
+                String8 mime;
+                size_t apicHeaderSize =
+                    n > 0 ? GetAPICHeaderSize(apicHeader, n, &mime) : 0;
+
+                if (apicHeaderSize > 0) {
+                    keep = apicHeaderSize;
+
+                    mAlbumArtOffset = frameOffset + apicHeaderSize;
+                    mAlbumArtLength = frameSize - apicHeaderSize;
+                    mAlbumArtMIME = mime;
+                }
+            }
+            sawAPIC = true;
+        }
+
+        if (dataSize + kHeaderSize + keep > capacity) {
+            while (dataSize + kHeaderSize + keep > capacity) {
+                capacity *= 2;
+            }
+            uint8_t *newData = (uint8_t *)realloc(data, capacity);
+            if (newData == NULL) {
+                break;
+            }
+            data = newData;
+        }
+
+        memcpy(&data[dataSize], frameHeader, kHeaderSize);
+
+        if (keep != frameSize) {
+            if (majorVersion == 4) {
+                WriteSyncsafeInteger(&data[dataSize + 4], keep);
+            } else {
+                data[dataSize + 4] = keep >> 24;
+                data[dataSize + 5] = (keep >> 16) & 0xff;
+                data[dataSize + 6] = (keep >> 8) & 0xff;
+                data[dataSize + 7] = keep & 0xff;
+            }
+        }
+
+        if (source->readAt(frameOffset, &data[dataSize + kHeaderSize], keep)
+                != (ssize_t)keep) {
+            break;
+        }
+
+        dataSize += kHeaderSize + keep;
+        offset += kHeaderSize + frameSize;
+    }
+
+    if (offset + kHeaderSize <= size || mAlbumArtLength == 0) {
+        free(data);
+
+        mAlbumArtLength = 0;
+        return false;
+    }
+
+    ALOGV("deferred %d bytes of album art at %lld",
+          mAlbumArtLength, mAlbumArtOffset);
+
+    mData = data;
+    mSize = dataSize;
+    mSource = source;
+
+    return true;
+}
+
 void ID3::removeUnsynchronization() {
     for (size_t i = 0; i + 1 < mSize; ++i) {
         if (mData[i] == 0xff && mData[i + 1] == 0x00) {
@@ -316,13 +524,6 @@ void ID3::removeUnsynchronization() {
     }
 }
 
-static void WriteSyncsafeInteger(uint8_t *dst, size_t x) {
-    for (size_t i = 0; i < 4; ++i) {
-        dst[3 - i] = (x & 0x7f);
-        x >>= 7;
-    }
-}
-
 bool ID3::removeUnsynchronizationV2_4(bool iTunesHack) {
     size_t oldSize = mSize;
 
@@ -801,6 +1002,26 @@ ID3::getAlbumArt(size_t *length, String8 *mime) const {
     *length = 0;
     mime->setTo("");
 
+    if (mAlbumArtLength > 0) {
+        if (mAlbumArtData == NULL) {
+            uint8_t *data = (uint8_t *)malloc(mAlbumArtLength);
+
+            if (data == NULL
+                    || mSource->readAt(mAlbumArtOffset, data, mAlbumArtLength)
+                            != (ssize_t)mAlbumArtLength) {
+                free(data);
+                return NULL;
+            }
+
+            mAlbumArtData = data;
+        }
+
+        *length = mAlbumArtLength;
+        mime->setTo(mAlbumArtMIME);
+
+        return mAlbumArtData;
+    }
+
     Iterator it(
             *this,
             (mVersion == ID3_V2_3 || mVersion == ID3_V2_4) ? "APIC" : "PIC");
@@ -861,6 +1082,19 @@ ID3::getAlbumArt(size_t *length, String8 *mime) const {
     return NULL;
 }
 
+bool ID3::getAlbumArtRange(
+        off64_t *offset, size_t *length, String8 *mime) const {
+    if (mAlbumArtLength == 0) {
+        return false;
+    }
+
+    *offset = mAlbumArtOffset;
+    *length = mAlbumArtLength;
+    mime->setTo(mAlbumArtMIME);
+
+    return true;
+}
+
 bool ID3::parseV1(const sp<DataSource> &source) {
     const size_t V1_TAG_SIZE = 128;
 
@@ -21,6 +21,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/MediaExtractor.h>
 #include <media/stagefright/MediaSource.h>
+#include <utils/threads.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -44,14 +45,36 @@ private:
     struct AVISource;
     struct MP3Splitter;
 
-    struct SampleInfo {
-        uint32_t mOffset;
-        bool mIsKey;
+    enum {
+        // Set in SampleEntry::mSize for samples that are not sync samples,
+        // as in OpenDML standard index entries.
+        kNotSyncSample = 0x80000000,
+    };
+
+    struct SampleEntry {
+        uint32_t mOffset;  // of the chunk payload, relative to mBaseOffset
+        uint32_t mSize;    // payload size, possibly or'ed with kNotSyncSample
+    };
+
+    // A run of consecutive samples described by one index: either the
+    // whole idx1 chunk or one OpenDML standard index (ix##) chunk. The
+    // entries of a standard index are only read once one of its samples
+    // is needed.
+    struct IndexSegment {
+        off64_t mBaseOffset;
+        off64_t mIndexOffset;  // first entry of the ix## chunk
+        size_t mFirstSample;
+        size_t mNumSamples;
+        bool mLoaded;
+        Vector<SampleEntry> mEntries;
     };
 
     struct Track {
         sp<MetaData> mMeta;
-        Vector<SampleInfo> mSamples;
+        Vector<IndexSegment> mSegments;
+        size_t mNumSamples;
+        bool mHasSuperIndex;
+        uint32_t mSuggestedBufferSize;
         uint32_t mRate;
         uint32_t mScale;
 
@@ -67,7 +90,6 @@ private:
 
         } mKind;
 
-        size_t mNumSyncSamples;
         size_t mThumbnailSampleSize;
         ssize_t mThumbnailSampleIndex;
         size_t mMaxSampleSize;
@@ -85,13 +107,27 @@ private:
     bool mFoundIndex;
     bool mOffsetsAreAbsolute;
 
+    // Protects lazy loading of the index segments.
+    Mutex mIndexLock;
+
     ssize_t parseChunk(off64_t offset, off64_t size, int depth = 0);
     status_t parseStreamHeader(off64_t offset, size_t size);
     status_t parseStreamFormat(off64_t offset, size_t size);
+    status_t parseSuperIndex(off64_t offset, size_t size);
     status_t parseIndex(off64_t offset, size_t size);
+    status_t finishIndex();
 
     status_t parseHeaders();
 
+    bool hasSuperIndexes() const;
+    bool isChunkAt(size_t trackIndex, off64_t offset);
+
+    status_t loadIndexSegment(Track *track, size_t segmentIndex);
+
+    status_t getSampleEntry_l(
+            size_t trackIndex, size_t sampleIndex,
+            off64_t *offset, size_t *size, bool *isKey);
+
     status_t getSampleInfo(
             size_t trackIndex, size_t sampleIndex,
             off64_t *offset, size_t *size, bool *isKey,
@@ -103,7 +139,7 @@ private:
     status_t getSampleIndexAtTime(
             size_t trackIndex,
             int64_t timeUs, MediaSource::ReadOptions::SeekMode mode,
-            size_t *sampleIndex) const;
+            size_t *sampleIndex);
 
     status_t addMPEG4CodecSpecificData(size_t trackIndex);
     status_t addH264CodecSpecificData(size_t trackIndex);
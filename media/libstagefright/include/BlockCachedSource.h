@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BLOCK_CACHED_SOURCE_H_
+
+#define BLOCK_CACHED_SOURCE_H_
+
+#include <media/stagefright/DataSource.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Keeps the most recently used fixed size, aligned blocks of the wrapped DataSource in memory,
+// so that the many small and overlapping reads of the extractors while they parse headers and
+// sample tables turn into a few block sized reads of the source. Reads of a block or more go
+// straight to the source and do not evict anything.
+struct BlockCachedSource : public DataSource {
+    BlockCachedSource(
+            const sp<DataSource> &source, size_t blockSize, size_t numBlocks);
+
+    // Returns source wrapped in a BlockCachedSource configured by the
+    // media.stagefright.block-cache property ("<block size in KB>/<number of blocks>",
+    // 0 blocks disables the cache), or source itself if it already caches its data.
+    static sp<DataSource> Wrap(const sp<DataSource> &source);
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size);
+
+    // following methods all call through to the wrapped DataSource's methods
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        return mSource->getSize(size);
+    }
+
+    virtual uint32_t flags() {
+        return mSource->flags();
+    }
+
+    virtual status_t reconnectAtOffset(off64_t offset) {
+        return mSource->reconnectAtOffset(offset);
+    }
+
+    // Once the source decrypts, the cached blocks hold what the sniffers read before
+    // DRM was set up, so they are dropped and the cache is bypassed from then on.
+    virtual sp<DecryptHandle> DrmInitialization(const char *mime = NULL);
+
+    virtual void getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client) {
+        mSource->getDrmInfo(handle, client);
+    };
+
+    virtual String8 getUri() {
+        return mSource->getUri();
+    }
+
+    virtual String8 getMIMEType() const {
+        return mSource->getMIMEType();
+    }
+
+protected:
+    virtual ~BlockCachedSource();
+
+private:
+    struct Block {
+        off64_t mOffset;    // -1 if the block is unused
+        size_t mSize;       // less than the block size at the end of the source
+        uint32_t mLastUse;
+        uint8_t *mData;
+    };
+
+    Mutex mLock;
+
+    sp<DataSource> mSource;
+    size_t mBlockSize;
+    Vector<Block> mBlocks;
+    uint32_t mUseCounter;
+    bool mBypass;
+
+    ssize_t readFromBlocks_l(off64_t offset, void *data, size_t size);
+    Block *getBlock_l(off64_t offset, status_t *err);
+
+    BlockCachedSource(const BlockCachedSource &);
+    BlockCachedSource &operator=(const BlockCachedSource &);
+};
+
+}  // namespace android
+
+#endif  // BLOCK_CACHED_SOURCE_H_
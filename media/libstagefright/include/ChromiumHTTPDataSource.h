@@ -70,6 +70,13 @@ private:
         DISCONNECTING
     };
 
+    enum {
+        // Bounds on how far readAt reads and discards data to reach a
+        // slightly later offset instead of issuing a new range request.
+        kMinSkipBytes = 16 * 1024,
+        kMaxSkipBytes = 1024 * 1024,
+    };
+
     const uint32_t mFlags;
 
     mutable Mutex mLock;
@@ -90,6 +97,10 @@ private:
 
     int64_t mContentSize;
 
+    // Average time connect_l took to get a response, used to decide when
+    // skipping forward on the open connection is cheaper than reconnecting.
+    int64_t mConnectDelayUs;
+
     String8 mContentType;
 
     sp<DecryptHandle> mDecryptHandle;
@@ -102,6 +113,9 @@ private:
             const KeyedVector<String8, String8> *headers,
             off64_t offset);
 
+    ssize_t read_l(void *data, size_t size);
+    status_t skipTo_l(off64_t offset);
+
     static void InitiateRead(
             ChromiumHTTPDataSource *me, void *data, size_t size);
 
@@ -19,11 +19,11 @@
 #define ID3_H_
 
 #include <utils/RefBase.h>
+#include <utils/String8.h>
 
 namespace android {
 
 struct DataSource;
-struct String8;
 
 struct ID3 {
     enum Version {
@@ -45,6 +45,11 @@ struct ID3 {
 
     const void *getAlbumArt(size_t *length, String8 *mime) const;
 
+    // Large album art is left in the source while the tag is parsed. If
+    // that is the case, returns where in the source it is, so that it can
+    // be handed out without being read, otherwise returns false.
+    bool getAlbumArtRange(off64_t *offset, size_t *length, String8 *mime) const;
+
     struct Iterator {
         Iterator(const ID3 &parent, const char *id);
         ~Iterator();
@@ -85,8 +90,18 @@ private:
     // only valid for IDV2+
     size_t mRawSize;
 
+    // The album art that was not read by parseV2Lazily(), if any, and
+    // its copy once getAlbumArt() asked for it.
+    sp<DataSource> mSource;
+    off64_t mAlbumArtOffset;
+    size_t mAlbumArtLength;
+    String8 mAlbumArtMIME;
+    mutable uint8_t *mAlbumArtData;
+
     bool parseV1(const sp<DataSource> &source);
-    bool parseV2(const sp<DataSource> &source);
+    bool parseV2(const sp<DataSource> &source, bool deferAlbumArt);
+    bool parseV2Lazily(
+            const sp<DataSource> &source, size_t size, uint8_t majorVersion);
     void removeUnsynchronization();
     bool removeUnsynchronizationV2_4(bool iTunesHack);
 
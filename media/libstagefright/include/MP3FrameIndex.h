@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MP3_FRAME_INDEX_H_
+
+#define MP3_FRAME_INDEX_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+class DataSource;
+
+// Seek table for MP3 files without a XING or VBRI header. The position of a
+// frame is recorded about once a second while frames are read from a known
+// start time, so that seeking back into the part already played (or
+// scanned) is exact instead of an estimate from the bitrate.
+//
+// Indices are kept in a small process wide cache keyed by the size of the
+// file and a hash of its first frames, so that opening the same file again
+// starts with the table built the last time.
+struct MP3FrameIndex : public RefBase {
+    static sp<MP3FrameIndex> Get(
+            const sp<DataSource> &source, off64_t firstFramePos);
+
+    // Records that the frame at "pos" starts at "timeUs". Only frames whose
+    // time is exact, i.e. counted from the first frame or from a position
+    // returned by getOffsetForTime, may be recorded.
+    void addFrame(int64_t timeUs, off64_t pos);
+
+    // Finds the last indexed frame at or before "*timeUs". Returns false if
+    // the index is empty.
+    bool getOffsetForTime(int64_t *timeUs, off64_t *pos);
+
+    // Time up to which the file is indexed.
+    int64_t indexedDurationUs();
+
+protected:
+    virtual ~MP3FrameIndex();
+
+private:
+    enum {
+        kIndexIntervalUs    = 1000000,
+        kMaxNumEntries      = 4 * 3600,
+        kMaxNumCachedIndices = 16,
+        kIdentityBytes      = 4096,
+    };
+
+    struct Entry {
+        int64_t mTimeUs;
+        off64_t mPos;
+    };
+
+    struct Key {
+        off64_t mFileSize;
+        off64_t mFirstFramePos;
+        uint32_t mHash;
+    };
+
+    Mutex mLock;
+    Key mKey;
+    Vector<Entry> mEntries;
+
+    static Mutex gCacheLock;
+    // Most recently used last.
+    static Vector<sp<MP3FrameIndex> > gCache;
+
+    MP3FrameIndex(const Key &key);
+
+    DISALLOW_EVIL_CONSTRUCTORS(MP3FrameIndex);
+};
+
+}  // namespace android
+
+#endif  // MP3_FRAME_INDEX_H_
@@ -37,6 +37,10 @@ class String8;
 struct SidxEntry {
     size_t mSize;
     uint32_t mDurationUs;
+    // Presentation time and file offset at which this segment starts, so
+    // that a seek can binary search the index instead of summing it.
+    int64_t mStartTimeUs;
+    off64_t mOffset;
 };
 
 class MPEG4Extractor : public MediaExtractor {
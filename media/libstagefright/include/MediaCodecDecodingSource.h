@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_CODEC_DECODING_SOURCE_H_
+
+#define MEDIA_CODEC_DECODING_SOURCE_H_
+
+#include <media/stagefright/foundation/AHandlerReflector.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/OMXCodec.h>
+#include <utils/KeyedVector.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ABuffer;
+struct ALooper;
+struct AMessage;
+struct MediaCodec;
+
+// A decoder MediaSource for the OMXCodec clients, backed by MediaCodec and
+// therefore by ACodec. Input is pulled from the source and queued to the
+// codec on a looper of its own, so that the component keeps all of its
+// input buffers busy while the client is still consuming earlier output.
+// Output buffers are handed to the client without a copy, as with OMXCodec
+// the client must return them before seeking or stopping.
+struct MediaCodecDecodingSource : public MediaSource,
+                                  public MediaBufferObserver {
+    // Returns NULL if none of the components could be configured.
+    static sp<MediaSource> Create(
+            const sp<MetaData> &meta,
+            const sp<MediaSource> &source,
+            const Vector<OMXCodec::CodecNameAndQuirks> &matchingCodecs);
+
+    virtual status_t start(MetaData *params = NULL);
+    virtual status_t stop();
+
+    virtual sp<MetaData> getFormat();
+
+    virtual status_t read(
+            MediaBuffer **buffer, const ReadOptions *options = NULL);
+
+    // from MediaBufferObserver
+    virtual void signalBufferReturned(MediaBuffer *buffer);
+
+protected:
+    virtual ~MediaCodecDecodingSource();
+
+private:
+    friend struct AHandlerReflector<MediaCodecDecodingSource>;
+
+    enum {
+        kWhatCodecNotify    = 'cdcN',
+        kWhatSeek           = 'seek',
+        kWhatStop           = 'stop',
+    };
+
+    // A buffer dequeued from the codec, or an output format change if
+    // mIndex is negative.
+    struct OutputItem {
+        ssize_t mIndex;
+        size_t mOffset;
+        size_t mSize;
+        int64_t mTimeUs;
+        uint32_t mFlags;
+        sp<AMessage> mFormat;
+    };
+
+    struct ClientBuffer {
+        size_t mIndex;
+        int32_t mGeneration;
+    };
+
+    sp<MediaSource> mSource;
+    sp<ALooper> mCodecLooper;
+    sp<MediaCodec> mCodec;
+    AString mComponentName;
+    int64_t mDurationUs;
+
+    sp<ALooper> mLooper;
+    sp<AHandlerReflector<MediaCodecDecodingSource> > mReflector;
+
+    // Only used on mLooper.
+    bool mStarted;
+    bool mInputEOS;
+    bool mCodecError;
+    ReadOptions mReadOptions;
+    Vector<sp<ABuffer> > mInputBuffers;
+
+    Mutex mLock;
+    Condition mOutputAvailable;
+    sp<MetaData> mFormat;
+    Vector<sp<ABuffer> > mOutputBuffers;
+    List<OutputItem> mOutputQueue;
+    KeyedVector<MediaBuffer *, ClientBuffer> mClientBuffers;
+    int32_t mOutputGeneration;
+    status_t mInputResult;
+    status_t mOutputResult;
+
+    MediaCodecDecodingSource(
+            const sp<MetaData> &meta,
+            const sp<MediaSource> &source,
+            const sp<ALooper> &codecLooper,
+            const sp<MediaCodec> &codec,
+            const char *componentName);
+
+    void onMessageReceived(const sp<AMessage> &msg);
+
+    void onDrainCodec();
+    void feedInputBuffers();
+    void drainOutputBuffers();
+    void onSeek(int64_t seekTimeUs, ReadOptions::SeekMode mode);
+    void onStop();
+    void signalCodecError(status_t err);
+
+    sp<MetaData> convertOutputFormat(const sp<AMessage> &format) const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(MediaCodecDecodingSource);
+};
+
+}  // namespace android
+
+#endif  // MEDIA_CODEC_DECODING_SOURCE_H_
@@ -21,6 +21,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/DataSource.h>
+#include <utils/List.h>
 
 namespace android {
 
@@ -75,6 +76,19 @@ private:
         kDefaultHighWaterThreshold      = 20 * 1024 * 1024,
         kDefaultLowWaterThreshold       = 4 * 1024 * 1024,
 
+        // When a seek leaves the cached range, up to this much of it is
+        // kept as a separate segment so that seeking back to it does not
+        // refetch it.
+        kMaxNumRetainedSegments         = 4,
+        kMaxRetainedSegmentSize         = 2 * 1024 * 1024,
+
+        // With adaptive watermarks the low watermark is raised so that
+        // this much playback, at the measured consumption rate, is still
+        // cached when the prefetcher restarts. Doubled if the measured
+        // bandwidth is less than twice the consumption rate.
+        kLowWaterDurationUs             = 10000000,
+        kRateSampleIntervalUs           = 1000000,
+
         // Read data after a 15 sec timeout whether we're actively
         // fetching or not.
         kDefaultKeepAliveIntervalUs     = 15000000,
@@ -89,6 +103,11 @@ private:
         kMaxNumRetries = 10,
     };
 
+    struct CacheSegment {
+        off64_t mOffset;
+        PageCache *mCache;
+    };
+
     sp<DataSource> mSource;
     sp<AHandlerReflector<NuCachedSource2> > mReflector;
     sp<ALooper> mLooper;
@@ -99,6 +118,9 @@ private:
 
     PageCache *mCache;
     off64_t mCacheOffset;
+
+    // Most recently used first.
+    List<CacheSegment> mRetainedSegments;
     status_t mFinalStatus;
     off64_t mLastAccessPos;
     sp<AMessage> mAsyncResult;
@@ -110,6 +132,14 @@ private:
     size_t mHighwaterThresholdBytes;
     size_t mLowwaterThresholdBytes;
 
+    // Set unless the watermarks were configured explicitly.
+    bool mAdaptiveWatermarks;
+    size_t mBaseLowwaterThresholdBytes;
+    int64_t mRateSampleTimeUs;
+    off64_t mRateSampleAccessPos;
+    int64_t mConsumedBytesPerSec;
+    int64_t mFetchedBytesPerSec;
+
     // If the keep-alive interval is 0, keep-alives are disabled.
     int64_t mKeepAliveIntervalUs;
 
@@ -122,6 +152,9 @@ private:
     void fetchInternal();
     ssize_t readInternal(off64_t offset, void *data, size_t size);
     status_t seekInternal_l(off64_t offset);
+    void retainActiveSegment_l();
+    bool restoreRetainedSegment_l(off64_t offset);
+    void updateWatermarks_l();
 
     size_t approxDataRemaining_l(status_t *finalStatus) const;
 
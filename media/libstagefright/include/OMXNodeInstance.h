@@ -110,7 +110,7 @@ struct OMXNodeInstance {
             const void *data,
             size_t size);
 
-    void onMessage(const omx_message &msg);
+    void onMessages(const List<omx_message> &messages);
     void onObserverDied(OMXMaster *master);
     void onGetHandleFailed();
     void onEvent(OMX_EVENTTYPE event, OMX_U32 arg1, OMX_U32 arg2);
@@ -167,6 +167,8 @@ private:
 
     status_t storeMetaDataInBuffers_l(OMX_U32 portIndex, OMX_BOOL enable);
 
+    bool handleMessage(const omx_message &msg);
+
     sp<GraphicBufferSource> getGraphicBufferSource();
     void setGraphicBufferSource(const sp<GraphicBufferSource>& bufferSource);
 
@@ -111,6 +111,14 @@ private:
     uint32_t mTimeToSampleCount;
     uint32_t *mTimeToSample;
 
+    // Index and decoding time of the first sample of each time to sample entry, so that
+    // the time of any sample is found with a binary search on the entries.
+    struct TimeToSampleStart {
+        uint32_t mSampleIndex;
+        uint32_t mSampleTime;
+    };
+    TimeToSampleStart *mTimeToSampleStarts;
+
     struct SampleTimeEntry {
         uint32_t mSampleIndex;
         uint32_t mCompositionTime;
@@ -123,6 +131,8 @@ private:
 
     off64_t mSyncSampleOffset;
     uint32_t mNumSyncSamples;
+    // The sync sample table is only read in on first use, so that parsing the moov of a
+    // long file does not have to fetch it before playback can start.
     uint32_t *mSyncSamples;
     size_t mLastSyncSampleIndex;
 
@@ -132,18 +142,29 @@ private:
         uint32_t startChunk;
         uint32_t samplesPerChunk;
         uint32_t chunkDesc;
+        uint32_t firstSampleIndex;
     };
     SampleToChunkEntry *mSampleToChunkEntries;
 
+    // true if the firstSampleIndex of the entries increase, which is the case unless the
+    // table is malformed, and lets SampleIterator binary search them
+    bool mSampleToChunkIndexed;
+
     friend struct SampleIterator;
 
     status_t getSampleSize_l(uint32_t sample_index, size_t *sample_size);
+    status_t loadSyncSamples_l();
     uint32_t getCompositionTimeOffset(uint32_t sampleIndex);
 
     static int CompareIncreasingTime(const void *, const void *);
 
     void buildSampleEntriesTable();
 
+    uint32_t findTimeToSampleEntry(uint32_t sampleIndex) const;
+    uint32_t getDecodingTime(uint32_t sampleIndex) const;
+    status_t findSampleAtDecodingTime(
+            uint32_t req_time, uint32_t *sample_index, uint32_t flags);
+
     SampleTable(const SampleTable &);
     SampleTable &operator=(const SampleTable &);
 };
@@ -21,6 +21,7 @@
 #include "SoftOMXComponent.h"
 
 #include <media/stagefright/foundation/AHandlerReflector.h>
+#include <ui/GraphicBuffer.h>
 #include <utils/RefBase.h>
 #include <utils/threads.h>
 #include <utils/Vector.h>
@@ -44,6 +45,9 @@ protected:
     struct BufferInfo {
         OMX_BUFFERHEADERTYPE *mHeader;
         bool mOwnedByUs;
+
+        // Set if the buffer is backed by a native window buffer.
+        sp<GraphicBuffer> mGraphicBuffer;
     };
 
     struct PortInfo {
@@ -66,6 +70,22 @@ protected:
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    // Lets subclasses name the port a vendor parameter applies to, so that
+    // it may be set while that port is disabled outside of OMX_StateLoaded.
+    virtual bool getParameterPortIndex(
+            OMX_INDEXTYPE index, const OMX_PTR params,
+            OMX_U32 *portIndex) const;
+
+    // Registers a buffer with a port, must be called with mLock held, i.e.
+    // from internalSetParameter.
+    OMX_ERRORTYPE internalUseBuffer(
+            OMX_BUFFERHEADERTYPE **buffer,
+            OMX_U32 portIndex,
+            OMX_PTR appPrivate,
+            OMX_U32 size,
+            OMX_U8 *ptr,
+            const sp<GraphicBuffer> &graphicBuffer = NULL);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
     List<BufferInfo *> &getPortQueue(OMX_U32 portIndex);
 
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SOFT_OMX_WORKER_POOL_H_
+
+#define SOFT_OMX_WORKER_POOL_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/List.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// A process-wide set of worker threads shared by all software components.
+// Work is submitted as a batch of independent jobs that run on the workers
+// and on the calling thread, run() returns once every job has completed.
+// Since batches complete synchronously, results stay in the order in which
+// the component produces them and no reordering is needed at the port.
+// The pool is created on first use and deliberately never destroyed, its
+// workers may still be blocked on it when the process exits.
+struct SoftOMXWorkerPool {
+    typedef void (*JobFunc)(void *cookie, size_t jobIndex);
+
+    static SoftOMXWorkerPool *Get();
+
+    // Number of jobs that can make progress at the same time, including
+    // the calling thread.
+    size_t parallelism() const;
+
+    void run(JobFunc func, void *cookie, size_t numJobs);
+
+    // Copies "numRows" rows of "rowBytes" bytes each, splitting the rows
+    // across the pool when the plane is large enough to be worth it.
+    void copyRows(
+            uint8_t *dst, size_t dstStride,
+            const uint8_t *src, size_t srcStride,
+            size_t rowBytes, size_t numRows);
+
+private:
+    struct Batch;
+    struct WorkerThread;
+
+    Mutex mLock;
+    Condition mWorkAvailable;
+    List<Batch *> mBatches;
+    Vector<sp<WorkerThread> > mWorkers;
+
+    SoftOMXWorkerPool(size_t numWorkers);
+    ~SoftOMXWorkerPool();   // not implemented, see above
+
+    bool takeJob_l(Batch **batch, size_t *jobIndex);
+    void runJob_l(Batch *batch, size_t jobIndex);
+    bool workerLoop();
+
+    DISALLOW_EVIL_CONSTRUCTORS(SoftOMXWorkerPool);
+};
+
+}  // namespace android
+
+#endif  // SOFT_OMX_WORKER_POOL_H_
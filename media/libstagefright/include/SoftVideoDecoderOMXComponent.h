@@ -57,6 +57,38 @@ protected:
     virtual OMX_ERRORTYPE getConfig(
             OMX_INDEXTYPE index, OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
+    virtual bool getParameterPortIndex(
+            OMX_INDEXTYPE index, const OMX_PTR params,
+            OMX_U32 *portIndex) const;
+
+    // Decoders that copy each picture out of memory of their own return
+    // true to let the output port be backed by native window buffers and
+    // to support adaptive playback, they must then fill output buffers
+    // through copyPictureToOutput and report size changes through
+    // handlePortSettingsChange.
+    virtual bool supportsNativeBuffers() const;
+
+    // Called when the decoder finds a picture size of "width" x "height" in
+    // the stream. In adaptive playback mode a picture that fits the output
+    // buffers only changes the crop rectangle. Otherwise the port definitions
+    // are updated and the output port is reconfigured, in which case this
+    // returns true and the decoder must stop producing output until the
+    // port has been enabled again.
+    bool handlePortSettingsChange(uint32_t width, uint32_t height);
+
+    // Copies an I420 picture of mWidth x mHeight into an output buffer and
+    // sets its nFilledLen. Ordinary buffers receive it packed as
+    // OMX_COLOR_FormatYUV420Planar, native window buffers as YV12 at the
+    // stride of the graphic buffer, so that they can be queued to the
+    // window without another copy or conversion.
+    status_t copyPictureToOutput(
+            BufferInfo *outInfo,
+            const uint8_t *srcY, size_t srcYStride,
+            const uint8_t *srcU, const uint8_t *srcV, size_t srcUVStride);
+
     void initPorts(OMX_U32 numInputBuffers,
             OMX_U32 inputBufferSize,
             OMX_U32 numOutputBuffers,
@@ -64,6 +96,11 @@ protected:
 
     virtual void updatePortDefinitions();
 
+    // Dimensions of the output buffers, which exceed those of the picture
+    // in adaptive playback mode.
+    uint32_t outputBufferWidth() const;
+    uint32_t outputBufferHeight() const;
+
     enum {
         kInputPortIndex  = 0,
         kOutputPortIndex = 1,
@@ -80,6 +117,18 @@ protected:
     } mOutputPortSettingsChange;
 
 private:
+    enum {
+        kEnableAndroidNativeBuffersIndex = OMX_IndexVendorStartUnused + 1,
+        kUseAndroidNativeBufferIndex,
+        kGetAndroidNativeBufferUsageIndex,
+        kPrepareForAdaptivePlaybackIndex,
+    };
+
+    bool mUseNativeBuffers;
+
+    bool mIsAdaptive;
+    uint32_t mAdaptiveMaxWidth, mAdaptiveMaxHeight;
+
     const char *mComponentRole;
     OMX_VIDEO_CODINGTYPE mCodingType;
     const CodecProfileLevel *mProfileLevels;
@@ -26,6 +26,7 @@
 namespace android {
 
 struct DataSource;
+struct MediaSource;
 class MediaExtractor;
 
 struct StagefrightMetadataRetriever : public MediaMetadataRetrieverInterface {
@@ -43,7 +44,10 @@ struct StagefrightMetadataRetriever : public MediaMetadataRetrieverInterface {
     virtual const char *extractMetadata(int keyCode);
 
 private:
+    // Only connected once a frame is asked for, metadata alone doesn't
+    // need OMX.
     OMXClient mClient;
+    bool mClientConnected;
     sp<DataSource> mSource;
     sp<MediaExtractor> mExtractor;
 
@@ -51,7 +55,16 @@ private:
     KeyedVector<int, String8> mMetaData;
     MediaAlbumArt *mAlbumArt;
 
+    // Where in mSource the album art is if the extractor didn't read it.
+    off64_t mAlbumArtOffset;
+    size_t mAlbumArtSize;
+
+    // Started decoder kept between FRAME_OPTION_THUMBNAIL calls.
+    sp<MediaSource> mThumbnailDecoder;
+
     void parseMetaData();
+    void clearThumbnailDecoder();
+    status_t connectClient();
 
     StagefrightMetadataRetriever(const StagefrightMetadataRetriever &);
 
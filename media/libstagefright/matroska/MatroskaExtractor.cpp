@@ -37,9 +37,20 @@ namespace android {
 
 struct DataSourceReader : public mkvparser::IMkvReader {
     DataSourceReader(const sp<DataSource> &source)
-        : mSource(source) {
+        : mSource(source),
+          mCache(NULL),
+          mCacheOffset(0),
+          mCacheSize(0) {
     }
 
+    virtual ~DataSourceReader() {
+        delete[] mCache;
+        mCache = NULL;
+    }
+
+    // libwebm reads element headers and frames a few bytes at a time, small
+    // reads are served from a read-ahead cache instead of each becoming a
+    // readAt on the data source.
     virtual int Read(long long position, long length, unsigned char* buffer) {
         CHECK(position >= 0);
         CHECK(length >= 0);
@@ -48,6 +59,22 @@ struct DataSourceReader : public mkvparser::IMkvReader {
             return 0;
         }
 
+        {
+            Mutex::Autolock autoLock(mLock);
+
+            if (readFromCache_l(position, length, buffer)) {
+                return 0;
+            }
+
+            if (length < kReadAheadSize) {
+                fillCache_l(position, kReadAheadSize);
+
+                if (readFromCache_l(position, length, buffer)) {
+                    return 0;
+                }
+            }
+        }
+
         ssize_t n = mSource->readAt(position, buffer, length);
 
         if (n <= 0) {
@@ -57,6 +84,25 @@ struct DataSourceReader : public mkvparser::IMkvReader {
         return 0;
     }
 
+    // Reads a whole cluster (up to kMaxPrefetchSize) into the cache at once,
+    // so that the blocks of the cluster need no further I/O.
+    void prefetch(long long position, long long length) {
+        Mutex::Autolock autoLock(mLock);
+
+        if (length < kReadAheadSize) {
+            length = kReadAheadSize;
+        } else if (length > kMaxPrefetchSize) {
+            length = kMaxPrefetchSize;
+        }
+
+        if (position >= mCacheOffset
+                && position + length <= mCacheOffset + mCacheSize) {
+            return;
+        }
+
+        fillCache_l(position, length);
+    }
+
     virtual int Length(long long* total, long long* available) {
         off64_t size;
         if (mSource->getSize(&size) != OK) {
@@ -78,7 +124,37 @@ struct DataSourceReader : public mkvparser::IMkvReader {
     }
 
 private:
+    enum {
+        kReadAheadSize   = 64 * 1024,
+        kMaxPrefetchSize = 1024 * 1024,
+    };
+
+    Mutex mLock;
     sp<DataSource> mSource;
+    uint8_t *mCache;
+    long long mCacheOffset;
+    long long mCacheSize;
+
+    bool readFromCache_l(long long position, long length, unsigned char *buffer) {
+        if (position < mCacheOffset
+                || position + length > mCacheOffset + mCacheSize) {
+            return false;
+        }
+
+        memcpy(buffer, mCache + (position - mCacheOffset), length);
+        return true;
+    }
+
+    void fillCache_l(long long position, long long length) {
+        if (mCache == NULL) {
+            mCache = new uint8_t[kMaxPrefetchSize];
+        }
+
+        ssize_t n = mSource->readAt(position, mCache, length);
+
+        mCacheOffset = position;
+        mCacheSize = (n > 0) ? n : 0;
+    }
 
     DataSourceReader(const DataSourceReader &);
     DataSourceReader &operator=(const DataSourceReader &);
@@ -110,6 +186,8 @@ private:
     long mBlockEntryIndex;
 
     void advance_l();
+    void setCluster_l(const mkvparser::Cluster *cluster, long blockEntryIndex);
+    bool seekWithCues_l(int64_t seekTimeNs);
 
     BlockIterator(const BlockIterator &);
     BlockIterator &operator=(const BlockIterator &);
@@ -274,13 +352,13 @@ void BlockIterator::advance_l() {
             CHECK(nextCluster != NULL);
             CHECK(!nextCluster->EOS());
 
-            mCluster = nextCluster;
+            mExtractor->indexCluster_l(mCluster, nextCluster);
+            setCluster_l(nextCluster, 0);
 
             res = mCluster->Parse(pos, len);
             ALOGV("Parse (2) returned %ld", res);
             CHECK_GE(res, 0);
 
-            mBlockEntryIndex = 0;
             continue;
         }
 
@@ -294,12 +372,27 @@ void BlockIterator::advance_l() {
     }
 }
 
+void BlockIterator::setCluster_l(
+        const mkvparser::Cluster *cluster, long blockEntryIndex) {
+    mCluster = cluster;
+    mBlockEntry = NULL;
+    mBlockEntryIndex = blockEntryIndex;
+
+    if (mCluster == NULL || mCluster->EOS()) {
+        return;
+    }
+
+    mExtractor->mReader->prefetch(
+            mCluster->m_element_start, mCluster->GetElementSize());
+}
+
 void BlockIterator::reset() {
     Mutex::Autolock autoLock(mExtractor->mLock);
 
-    mCluster = mExtractor->mSegment->GetFirst();
-    mBlockEntry = NULL;
-    mBlockEntryIndex = 0;
+    setCluster_l(mExtractor->mSegment->GetFirst(), 0);
+    if (!eos()) {
+        mExtractor->indexCluster_l(NULL, mCluster);
+    }
 
     do {
         advance_l();
@@ -321,8 +414,7 @@ void BlockIterator::seek(
     // extraneously seeks to 0 before playing.
     if (seekTimeNs <= 0) {
         ALOGV("Seek to beginning: %lld", seekTimeUs);
-        mCluster = pSegment->GetFirst();
-        mBlockEntryIndex = 0;
+        setCluster_l(pSegment->GetFirst(), 0);
         do {
             advance_l();
         } while (!eos() && block()->GetTrackNumber() != mTrackNum);
@@ -331,7 +423,40 @@ void BlockIterator::seek(
 
     ALOGV("Seeking to: %lld", seekTimeUs);
 
-    // If the Cues have not been located then find them.
+    if (!seekWithCues_l(seekTimeNs)) {
+        // No usable Cues, use the index of the clusters seen so far,
+        // extending it up to the requested time if needed.
+        const mkvparser::Cluster *cluster =
+            mExtractor->findCluster_l(seekTimeNs);
+
+        if (cluster == NULL) {
+            ALOGE("Unable to locate a cluster for seeking");
+            return;
+        }
+
+        setCluster_l(cluster, 0);
+    }
+
+    for (;;) {
+        advance_l();
+
+        if (eos()) break;
+
+        if (isAudio || block()->IsKey()) {
+            // Accept the first key frame
+            *actualFrameTimeUs = (block()->GetTime(mCluster) + 500LL) / 1000LL;
+            ALOGV("Requested seek point: %lld actual: %lld",
+                  seekTimeUs, actualFrameTimeUs);
+            break;
+        }
+    }
+}
+
+bool BlockIterator::seekWithCues_l(int64_t seekTimeNs) {
+    mkvparser::Segment* const pSegment = mExtractor->mSegment;
+
+    // If the Cues have not been located then find them. They are only
+    // loaded up to the requested time, later seeks load more as needed.
     const mkvparser::Cues* pCues = pSegment->GetCues();
     const mkvparser::SeekHead* pSH = pSegment->GetSeekHead();
     if (!pCues && pSH) {
@@ -350,15 +475,11 @@ void BlockIterator::seek(
                 break;
             }
         }
-
-        if (!pCues) {
-            ALOGE("No Cues in file");
-            return;
-        }
     }
-    else if (!pSH) {
-        ALOGE("No SeekHead");
-        return;
+
+    if (!pCues) {
+        ALOGV("No Cues in file");
+        return false;
     }
 
     const mkvparser::CuePoint* pCP;
@@ -372,7 +493,8 @@ void BlockIterator::seek(
         }
     }
 
-    // The Cue index is built around video keyframes
+    // The Cue index is built around video keyframes, fall back to our own
+    // track for files without video.
     mkvparser::Tracks const *pTracks = pSegment->GetTracks();
     const mkvparser::Track *pTrack = NULL;
     for (size_t index = 0; index < pTracks->GetTracksCount(); ++index) {
@@ -383,37 +505,29 @@ void BlockIterator::seek(
         }
     }
 
+    if (!pTrack || pTrack->GetType() != 1) {
+        pTrack = pTracks->GetTrackByNumber(mTrackNum);
+    }
+
     // Always *search* based on the video track, but finalize based on mTrackNum
     const mkvparser::CuePoint::TrackPosition* pTP;
-    if (pTrack && pTrack->GetType() == 1) {
-        pCues->Find(seekTimeNs, pTrack, pCP, pTP);
-    } else {
-        ALOGE("Did not locate the video track for seeking");
-        return;
+    if (!pTrack || !pCues->Find(seekTimeNs, pTrack, pCP, pTP)
+            || pTP == NULL || pTP->m_block <= 0) {
+        ALOGV("Cues do not index this track");
+        return false;
     }
 
-    mCluster = pSegment->FindOrPreloadCluster(pTP->m_pos);
+    const mkvparser::Cluster *cluster =
+        pSegment->FindOrPreloadCluster(pTP->m_pos);
 
-    CHECK(mCluster);
-    CHECK(!mCluster->EOS());
+    if (cluster == NULL || cluster->EOS()) {
+        return false;
+    }
 
     // mBlockEntryIndex starts at 0 but m_block starts at 1
-    CHECK_GT(pTP->m_block, 0);
-    mBlockEntryIndex = pTP->m_block - 1;
+    setCluster_l(cluster, pTP->m_block - 1);
 
-    for (;;) {
-        advance_l();
-
-        if (eos()) break;
-
-        if (isAudio || block()->IsKey()) {
-            // Accept the first key frame
-            *actualFrameTimeUs = (block()->GetTime(mCluster) + 500LL) / 1000LL;
-            ALOGV("Requested seek point: %lld actual: %lld",
-                  seekTimeUs, actualFrameTimeUs);
-            break;
-        }
-    }
+    return true;
 }
 
 const mkvparser::Block *BlockIterator::block() const {
@@ -677,6 +791,60 @@ MatroskaExtractor::MatroskaExtractor(const sp<DataSource> &source)
     addTracks();
 }
 
+void MatroskaExtractor::indexCluster_l(
+        const mkvparser::Cluster *prev, const mkvparser::Cluster *cluster) {
+    // Only clusters directly following the last indexed one are added, so
+    // that the index never has gaps (e.g. after a seek through the Cues).
+    const mkvparser::Cluster *last =
+        mClusterIndex.isEmpty() ? NULL : mClusterIndex.top().mCluster;
+    if (prev != last) {
+        return;
+    }
+
+    ClusterIndexEntry entry;
+    entry.mTimeNs = cluster->GetTime();
+    entry.mCluster = cluster;
+    mClusterIndex.push(entry);
+}
+
+const mkvparser::Cluster *MatroskaExtractor::findCluster_l(int64_t seekTimeNs) {
+    if (mClusterIndex.isEmpty()) {
+        const mkvparser::Cluster *first = mSegment->GetFirst();
+        if (first == NULL || first->EOS()) {
+            return NULL;
+        }
+        indexCluster_l(NULL, first);
+    }
+
+    // Parse cluster headers beyond the index until one starts after the
+    // requested time, this only happens for parts not played yet.
+    while (mClusterIndex.top().mTimeNs <= seekTimeNs) {
+        const mkvparser::Cluster *next;
+        long long pos;
+        long len;
+        if (mSegment->ParseNext(mClusterIndex.top().mCluster, next, pos, len) != 0
+                || next == NULL || next->EOS()) {
+            break;
+        }
+
+        indexCluster_l(mClusterIndex.top().mCluster, next);
+    }
+
+    // Find the last cluster starting at or before the requested time.
+    size_t lo = 0;
+    size_t hi = mClusterIndex.size();
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mClusterIndex.itemAt(mid).mTimeNs <= seekTimeNs) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return mClusterIndex.itemAt(lo).mCluster;
+}
+
 MatroskaExtractor::~MatroskaExtractor() {
     delete mSegment;
     mSegment = NULL;
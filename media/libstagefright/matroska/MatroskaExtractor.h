@@ -24,6 +24,7 @@
 
 namespace mkvparser {
 struct Segment;
+class Cluster;
 };
 
 namespace android {
@@ -60,8 +61,16 @@ private:
         sp<MetaData> mMeta;
     };
 
+    // Start time of each cluster parsed so far, in file order. Used to
+    // seek in files without Cues.
+    struct ClusterIndexEntry {
+        int64_t mTimeNs;
+        const mkvparser::Cluster *mCluster;
+    };
+
     Mutex mLock;
     Vector<TrackInfo> mTracks;
+    Vector<ClusterIndexEntry> mClusterIndex;
 
     sp<DataSource> mDataSource;
     DataSourceReader *mReader;
@@ -73,6 +82,10 @@ private:
     void addTracks();
     void findThumbnails();
 
+    void indexCluster_l(
+            const mkvparser::Cluster *prev, const mkvparser::Cluster *cluster);
+    const mkvparser::Cluster *findCluster_l(int64_t seekTimeNs);
+
     bool isLiveStreaming() const;
 
     MatroskaExtractor(const MatroskaExtractor &);
@@ -50,10 +50,8 @@ struct ATSParser::Program : public RefBase {
     bool parsePSISection(
             unsigned pid, ABitReader *br, status_t *err);
 
-    bool parsePID(
-            unsigned pid, unsigned continuity_counter,
-            unsigned payload_unit_start_indicator,
-            ABitReader *br, status_t *err);
+    // Adds the streams whose PIDs aren't in "streams" yet.
+    void addStreams(KeyedVector<unsigned, sp<Stream> > *streams) const;
 
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
@@ -108,7 +106,7 @@ struct ATSParser::Stream : public RefBase {
     status_t parse(
             unsigned continuity_counter,
             unsigned payload_unit_start_indicator,
-            ABitReader *br);
+            const uint8_t *data, size_t size);
 
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
@@ -196,21 +194,13 @@ bool ATSParser::Program::parsePSISection(
     return true;
 }
 
-bool ATSParser::Program::parsePID(
-        unsigned pid, unsigned continuity_counter,
-        unsigned payload_unit_start_indicator,
-        ABitReader *br, status_t *err) {
-    *err = OK;
-
-    ssize_t index = mStreams.indexOfKey(pid);
-    if (index < 0) {
-        return false;
+void ATSParser::Program::addStreams(
+        KeyedVector<unsigned, sp<Stream> > *streams) const {
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+        if (streams->indexOfKey(mStreams.keyAt(i)) < 0) {
+            streams->add(mStreams.keyAt(i), mStreams.valueAt(i));
+        }
     }
-
-    *err = mStreams.editValueAt(index)->parse(
-            continuity_counter, payload_unit_start_indicator, br);
-
-    return true;
 }
 
 void ATSParser::Program::signalDiscontinuity(
@@ -525,7 +515,8 @@ ATSParser::Stream::~Stream() {
 
 status_t ATSParser::Stream::parse(
         unsigned continuity_counter,
-        unsigned payload_unit_start_indicator, ABitReader *br) {
+        unsigned payload_unit_start_indicator,
+        const uint8_t *data, size_t size) {
     if (mQueue == NULL) {
         return OK;
     }
@@ -573,10 +564,7 @@ status_t ATSParser::Stream::parse(
         return OK;
     }
 
-    size_t payloadSizeBits = br->numBitsLeft();
-    CHECK_EQ(payloadSizeBits % 8, 0u);
-
-    size_t neededSize = mBuffer->size() + payloadSizeBits / 8;
+    size_t neededSize = mBuffer->size() + size;
     if (mBuffer->capacity() < neededSize) {
         // Increment in multiples of 64K.
         neededSize = (neededSize + 65535) & ~65535;
@@ -589,8 +577,8 @@ status_t ATSParser::Stream::parse(
         mBuffer = newBuffer;
     }
 
-    memcpy(mBuffer->data() + mBuffer->size(), br->data(), payloadSizeBits / 8);
-    mBuffer->setRange(0, mBuffer->size() + payloadSizeBits / 8);
+    memcpy(mBuffer->data() + mBuffer->size(), data, size);
+    mBuffer->setRange(0, mBuffer->size() + size);
 
     return OK;
 }
@@ -937,6 +925,7 @@ ATSParser::ATSParser(uint32_t flags)
       mTimeOffsetValid(false),
       mTimeOffsetUs(0ll),
       mNumTSPacketsParsed(0),
+      mStreamsByPIDValid(false),
       mNumPCRs(0) {
     mPSISections.add(0 /* PID */, new PSISection);
 }
@@ -947,8 +936,21 @@ ATSParser::~ATSParser() {
 status_t ATSParser::feedTSPacket(const void *data, size_t size) {
     CHECK_EQ(size, kTSPacketSize);
 
-    ABitReader br((const uint8_t *)data, kTSPacketSize);
-    return parseTS(&br);
+    return parseTS((const uint8_t *)data);
+}
+
+status_t ATSParser::feedTSPackets(const void *data, size_t size) {
+    CHECK_EQ(size % kTSPacketSize, 0u);
+
+    for (size_t offset = 0; offset < size; offset += kTSPacketSize) {
+        status_t err = parseTS((const uint8_t *)data + offset);
+
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    return OK;
 }
 
 void ATSParser::signalDiscontinuity(
@@ -1053,7 +1055,7 @@ void ATSParser::parseProgramAssociationTable(ABitReader *br) {
 }
 
 status_t ATSParser::parsePID(
-        ABitReader *br, unsigned PID,
+        const uint8_t *data, size_t size, unsigned PID,
         unsigned continuity_counter,
         unsigned payload_unit_start_indicator) {
     ssize_t sectionIndex = mPSISections.indexOfKey(PID);
@@ -1064,12 +1066,15 @@ status_t ATSParser::parsePID(
         if (payload_unit_start_indicator) {
             CHECK(section->isEmpty());
 
-            unsigned skip = br->getBits(8);
-            br->skipBits(skip * 8);
+            CHECK_GE(size, 1u);
+            unsigned skip = data[0];
+            CHECK_GE(size - 1, skip);
+
+            data += 1 + skip;
+            size -= 1 + skip;
         }
 
-        CHECK((br->numBitsLeft() % 8) == 0);
-        status_t err = section->append(br->data(), br->numBitsLeft() / 8);
+        status_t err = section->append(data, size);
 
         if (err != OK) {
             return err;
@@ -1081,6 +1086,9 @@ status_t ATSParser::parsePID(
 
         ABitReader sectionBits(section->data(), section->size());
 
+        // Either table may change the streams.
+        mStreamsByPIDValid = false;
+
         if (PID == 0) {
             parseProgramAssociationTable(&sectionBits);
         } else {
@@ -1113,56 +1121,54 @@ status_t ATSParser::parsePID(
         return OK;
     }
 
-    bool handled = false;
-    for (size_t i = 0; i < mPrograms.size(); ++i) {
-        status_t err;
-        if (mPrograms.editItemAt(i)->parsePID(
-                    PID, continuity_counter, payload_unit_start_indicator,
-                    br, &err)) {
-            if (err != OK) {
-                return err;
-            }
-
-            handled = true;
-            break;
+    if (!mStreamsByPIDValid) {
+        mStreamsByPID.clear();
+        for (size_t i = 0; i < mPrograms.size(); ++i) {
+            mPrograms.itemAt(i)->addStreams(&mStreamsByPID);
         }
+        mStreamsByPIDValid = true;
     }
 
-    if (!handled) {
+    ssize_t streamIndex = mStreamsByPID.indexOfKey(PID);
+
+    if (streamIndex < 0) {
         ALOGV("PID 0x%04x not handled.", PID);
+        return OK;
     }
 
-    return OK;
+    return mStreamsByPID.editValueAt(streamIndex)->parse(
+            continuity_counter, payload_unit_start_indicator, data, size);
 }
 
-void ATSParser::parseAdaptationField(ABitReader *br, unsigned PID) {
-    unsigned adaptation_field_length = br->getBits(8);
+size_t ATSParser::parseAdaptationField(const uint8_t *data, unsigned PID) {
+    unsigned adaptation_field_length = data[0];
+    CHECK_LE(adaptation_field_length, kTSPacketSize - 5);
 
     if (adaptation_field_length > 0) {
-        unsigned discontinuity_indicator = br->getBits(1);
+        unsigned discontinuity_indicator = data[1] >> 7;
 
         if (discontinuity_indicator) {
             ALOGV("PID 0x%04x: discontinuity_indicator = 1 (!!!)", PID);
         }
 
-        br->skipBits(2);
-        unsigned PCR_flag = br->getBits(1);
-
-        size_t numBitsRead = 4;
+        unsigned PCR_flag = (data[1] >> 4) & 1;
 
         if (PCR_flag) {
-            br->skipBits(4);
-            uint64_t PCR_base = br->getBits(32);
-            PCR_base = (PCR_base << 1) | br->getBits(1);
+            CHECK_GE(adaptation_field_length, 7u);
+
+            uint64_t PCR_base =
+                ((uint64_t)data[2] << 25)
+                    | (data[3] << 17)
+                    | (data[4] << 9)
+                    | (data[5] << 1)
+                    | (data[6] >> 7);
 
-            br->skipBits(6);
-            unsigned PCR_ext = br->getBits(9);
+            unsigned PCR_ext = ((data[6] & 1) << 8) | data[7];
 
             // The number of bytes from the start of the current
             // MPEG2 transport stream packet up and including
             // the final byte of this PCR_ext field.
-            size_t byteOffsetFromStartOfTSPacket =
-                (188 - br->numBitsLeft() / 8);
+            size_t byteOffsetFromStartOfTSPacket = 4 + 8;
 
             uint64_t PCR = PCR_base * 300 + PCR_ext;
 
@@ -1177,51 +1183,45 @@ void ATSParser::parseAdaptationField(ABitReader *br, unsigned PID) {
             for (size_t i = 0; i < mPrograms.size(); ++i) {
                 updatePCR(PID, PCR, byteOffsetFromStart);
             }
-
-            numBitsRead += 52;
         }
-
-        CHECK_GE(adaptation_field_length * 8, numBitsRead);
-
-        br->skipBits(adaptation_field_length * 8 - numBitsRead);
     }
+
+    return 1 + adaptation_field_length;
 }
 
-status_t ATSParser::parseTS(ABitReader *br) {
+status_t ATSParser::parseTS(const uint8_t *data) {
     ALOGV("---");
 
-    unsigned sync_byte = br->getBits(8);
+    // The header is taken apart by hand, this runs for every packet.
+    unsigned sync_byte = data[0];
     CHECK_EQ(sync_byte, 0x47u);
 
-    MY_LOGV("transport_error_indicator = %u", br->getBits(1));
-
-    unsigned payload_unit_start_indicator = br->getBits(1);
+    unsigned payload_unit_start_indicator = (data[1] >> 6) & 1;
     ALOGV("payload_unit_start_indicator = %u", payload_unit_start_indicator);
 
-    MY_LOGV("transport_priority = %u", br->getBits(1));
-
-    unsigned PID = br->getBits(13);
+    unsigned PID = ((data[1] & 0x1f) << 8) | data[2];
     ALOGV("PID = 0x%04x", PID);
 
-    MY_LOGV("transport_scrambling_control = %u", br->getBits(2));
-
-    unsigned adaptation_field_control = br->getBits(2);
+    unsigned adaptation_field_control = (data[3] >> 4) & 3;
     ALOGV("adaptation_field_control = %u", adaptation_field_control);
 
-    unsigned continuity_counter = br->getBits(4);
+    unsigned continuity_counter = data[3] & 0x0f;
     ALOGV("PID = 0x%04x, continuity_counter = %u", PID, continuity_counter);
 
     // ALOGI("PID = 0x%04x, continuity_counter = %u", PID, continuity_counter);
 
+    size_t offset = 4;
+
     if (adaptation_field_control == 2 || adaptation_field_control == 3) {
-        parseAdaptationField(br, PID);
+        offset += parseAdaptationField(&data[offset], PID);
     }
 
     status_t err = OK;
 
     if (adaptation_field_control == 1 || adaptation_field_control == 3) {
         err = parsePID(
-                br, PID, continuity_counter, payload_unit_start_indicator);
+                &data[offset], kTSPacketSize - offset,
+                PID, continuity_counter, payload_unit_start_indicator);
     }
 
     ++mNumTSPacketsParsed;
@@ -65,6 +65,10 @@ struct ATSParser : public RefBase {
 
     status_t feedTSPacket(const void *data, size_t size);
 
+    // Same as feeding the packets one by one, "size" must be a multiple of
+    // the packet size.
+    status_t feedTSPackets(const void *data, size_t size);
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -112,17 +116,23 @@ private:
 
     size_t mNumTSPacketsParsed;
 
+    // The elementary streams of all programs by PID, rebuilt after the
+    // program tables change.
+    KeyedVector<unsigned, sp<Stream> > mStreamsByPID;
+    bool mStreamsByPIDValid;
+
     void parseProgramAssociationTable(ABitReader *br);
     void parseProgramMap(ABitReader *br);
     void parsePES(ABitReader *br);
 
     status_t parsePID(
-        ABitReader *br, unsigned PID,
+        const uint8_t *data, size_t size, unsigned PID,
         unsigned continuity_counter,
         unsigned payload_unit_start_indicator);
 
-    void parseAdaptationField(ABitReader *br, unsigned PID);
-    status_t parseTS(ABitReader *br);
+    // Returns the size of the adaptation field.
+    size_t parseAdaptationField(const uint8_t *data, unsigned PID);
+    status_t parseTS(const uint8_t *data);
 
     void updatePCR(unsigned PID, uint64_t PCR, size_t byteOffsetFromStart);
 
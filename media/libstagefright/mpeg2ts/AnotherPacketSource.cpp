@@ -34,7 +34,13 @@ AnotherPacketSource::AnotherPacketSource(const sp<MetaData> &meta)
     : mIsAudio(false),
       mFormat(NULL),
       mLastQueuedTimeUs(0),
-      mEOSResult(OK) {
+      mEOSResult(OK),
+      mQueuedBytes(0),
+      mBufferedDurationUs(0ll),
+      mMaxBytes(0),
+      mMaxDurationUs(0ll),
+      mHighWaterBytes(0),
+      mHighWaterDurationUs(0ll) {
     setFormat(meta);
 }
 
@@ -59,6 +65,8 @@ void AnotherPacketSource::setFormat(const sp<MetaData> &meta) {
 }
 
 AnotherPacketSource::~AnotherPacketSource() {
+    ALOGV("at most %d bytes, %lld us were queued",
+          mHighWaterBytes, mHighWaterDurationUs);
 }
 
 status_t AnotherPacketSource::start(MetaData *params) {
@@ -82,13 +90,12 @@ status_t AnotherPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
     }
 
     if (!mBuffers.empty()) {
-        *buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+        *buffer = dequeueBufferLocked();
 
         int32_t discontinuity;
         if ((*buffer)->meta()->findInt32("discontinuity", &discontinuity)) {
             if (wasFormatChange(discontinuity)) {
-                mFormat.clear();
+                onFormatChangeLocked();
             }
 
             return INFO_DISCONTINUITY;
@@ -110,13 +117,12 @@ status_t AnotherPacketSource::read(
     }
 
     if (!mBuffers.empty()) {
-        const sp<ABuffer> buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+        const sp<ABuffer> buffer = dequeueBufferLocked();
 
         int32_t discontinuity;
         if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
             if (wasFormatChange(discontinuity)) {
-                mFormat.clear();
+                onFormatChangeLocked();
             }
 
             return INFO_DISCONTINUITY;
@@ -136,6 +142,46 @@ status_t AnotherPacketSource::read(
     return mEOSResult;
 }
 
+sp<ABuffer> AnotherPacketSource::dequeueBufferLocked() {
+    sp<ABuffer> buffer = *mBuffers.begin();
+    mBuffers.erase(mBuffers.begin());
+
+    mQueuedBytes -= buffer->size();
+
+    int64_t timeUs, nextTimeUs;
+    if (buffer->meta()->findInt64("timeUs", &timeUs)
+            && !mBuffers.empty()
+            && (*mBuffers.begin())->meta()->findInt64("timeUs", &nextTimeUs)) {
+        mBufferedDurationUs -= nextTimeUs - timeUs;
+    }
+
+    notifySpaceLocked();
+
+    return buffer;
+}
+
+void AnotherPacketSource::onFormatChangeLocked() {
+    mFormat.clear();
+
+    // The data queued behind a format change that didn't discard the old
+    // data may already carry the new format.
+    List<sp<ABuffer> >::iterator it = mBuffers.begin();
+    while (it != mBuffers.end()) {
+        int32_t discontinuity;
+        if ((*it)->meta()->findInt32("discontinuity", &discontinuity)) {
+            break;
+        }
+
+        sp<RefBase> format;
+        if ((*it)->meta()->findObject("format", &format)) {
+            mFormat = static_cast<MetaData *>(format.get());
+            break;
+        }
+
+        ++it;
+    }
+}
+
 bool AnotherPacketSource::wasFormatChange(
         int32_t discontinuityType) const {
     if (mIsAudio) {
@@ -152,10 +198,34 @@ void AnotherPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
         return;
     }
 
-    CHECK(buffer->meta()->findInt64("timeUs", &mLastQueuedTimeUs));
+    int64_t timeUs;
+    CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
+    mLastQueuedTimeUs = timeUs;
     ALOGV("queueAccessUnit timeUs=%lld us (%.2f secs)", mLastQueuedTimeUs, mLastQueuedTimeUs / 1E6);
 
     Mutex::Autolock autoLock(mLock);
+
+    sp<RefBase> format;
+    if (mFormat == NULL && buffer->meta()->findObject("format", &format)) {
+        mFormat = static_cast<MetaData *>(format.get());
+    }
+
+    int64_t prevTimeUs;
+    if (!mBuffers.empty()
+            && (*--mBuffers.end())->meta()->findInt64("timeUs", &prevTimeUs)) {
+        mBufferedDurationUs += timeUs - prevTimeUs;
+    }
+
+    mQueuedBytes += buffer->size();
+
+    if (mQueuedBytes > mHighWaterBytes) {
+        mHighWaterBytes = mQueuedBytes;
+    }
+
+    if (mBufferedDurationUs > mHighWaterDurationUs) {
+        mHighWaterDurationUs = mBufferedDurationUs;
+    }
+
     mBuffers.push_back(buffer);
     mCondition.signal();
 }
@@ -166,31 +236,44 @@ void AnotherPacketSource::clear() {
     mBuffers.clear();
     mEOSResult = OK;
 
+    mQueuedBytes = 0;
+    mBufferedDurationUs = 0ll;
+    notifySpaceLocked();
+
     mFormat = NULL;
 }
 
 void AnotherPacketSource::queueDiscontinuity(
         ATSParser::DiscontinuityType type,
-        const sp<AMessage> &extra) {
+        const sp<AMessage> &extra,
+        bool discard) {
     Mutex::Autolock autoLock(mLock);
 
-    // Leave only discontinuities in the queue.
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    while (it != mBuffers.end()) {
-        sp<ABuffer> oldBuffer = *it;
+    if (discard) {
+        // Leave only discontinuities in the queue.
+        List<sp<ABuffer> >::iterator it = mBuffers.begin();
+        while (it != mBuffers.end()) {
+            sp<ABuffer> oldBuffer = *it;
+
+            int32_t oldDiscontinuityType;
+            if (!oldBuffer->meta()->findInt32(
+                        "discontinuity", &oldDiscontinuityType)) {
+                it = mBuffers.erase(it);
+                continue;
+            }
 
-        int32_t oldDiscontinuityType;
-        if (!oldBuffer->meta()->findInt32(
-                    "discontinuity", &oldDiscontinuityType)) {
-            it = mBuffers.erase(it);
-            continue;
+            ++it;
         }
 
-        ++it;
+        // Only the discontinuities are left, they take no space.
+        mQueuedBytes = 0;
+        mBufferedDurationUs = 0ll;
+        notifySpaceLocked();
+
+        mLastQueuedTimeUs = 0;
     }
 
     mEOSResult = OK;
-    mLastQueuedTimeUs = 0;
 
     sp<ABuffer> buffer = new ABuffer(0);
     buffer->meta()->setInt32("discontinuity", static_cast<int32_t>(type));
@@ -223,33 +306,51 @@ int64_t AnotherPacketSource::getBufferedDurationUs(status_t *finalResult) {
 
     *finalResult = mEOSResult;
 
-    if (mBuffers.empty()) {
-        return 0;
-    }
+    return mBufferedDurationUs;
+}
 
-    int64_t time1 = -1;
-    int64_t time2 = -1;
+void AnotherPacketSource::setBufferLimits(
+        size_t maxBytes, int64_t maxDurationUs) {
+    Mutex::Autolock autoLock(mLock);
 
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    while (it != mBuffers.end()) {
-        const sp<ABuffer> &buffer = *it;
+    mMaxBytes = maxBytes;
+    mMaxDurationUs = maxDurationUs;
 
-        int64_t timeUs;
-        if (buffer->meta()->findInt64("timeUs", &timeUs)) {
-            if (time1 < 0) {
-                time1 = timeUs;
-            }
+    notifySpaceLocked();
+}
 
-            time2 = timeUs;
-        } else {
-            // This is a discontinuity, reset everything.
-            time1 = time2 = -1;
-        }
+bool AnotherPacketSource::isFull(const sp<AMessage> &spaceNotify) {
+    Mutex::Autolock autoLock(mLock);
 
-        ++it;
+    if (!isFullLocked()) {
+        return false;
     }
 
-    return time2 - time1;
+    if (spaceNotify != NULL) {
+        mSpaceNotify = spaceNotify;
+    }
+
+    return true;
+}
+
+void AnotherPacketSource::getHighWaterMarks(
+        size_t *bytes, int64_t *durationUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    *bytes = mHighWaterBytes;
+    *durationUs = mHighWaterDurationUs;
+}
+
+bool AnotherPacketSource::isFullLocked() const {
+    return (mMaxBytes > 0 && mQueuedBytes >= mMaxBytes)
+        || (mMaxDurationUs > 0ll && mBufferedDurationUs >= mMaxDurationUs);
+}
+
+void AnotherPacketSource::notifySpaceLocked() {
+    if (mSpaceNotify != NULL && !isFullLocked()) {
+        mSpaceNotify->post();
+        mSpaceNotify.clear();
+    }
 }
 
 status_t AnotherPacketSource::nextBufferTime(int64_t *timeUs) {
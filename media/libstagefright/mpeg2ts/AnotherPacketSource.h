@@ -45,16 +45,30 @@ struct AnotherPacketSource : public MediaSource {
 
     bool hasBufferAvailable(status_t *finalResult);
 
-    // Returns the difference between the last and the first queued
-    // presentation timestamps since the last discontinuity (if any).
+    // Returns the sum of the differences between the last and the first
+    // queued presentation timestamps between discontinuities.
     int64_t getBufferedDurationUs(status_t *finalResult);
 
+    // Caps the queue at the given number of bytes and buffered duration,
+    // 0 meaning no limit. Nothing is ever refused, producers are expected
+    // to check isFull() before queueing more.
+    void setBufferLimits(size_t maxBytes, int64_t maxDurationUs);
+
+    // If the queue is full and "spaceNotify" is given, it is posted once
+    // the queue has room again, replacing any earlier one.
+    bool isFull(const sp<AMessage> &spaceNotify = NULL);
+
+    // The most that has been queued at any one time.
+    void getHighWaterMarks(size_t *bytes, int64_t *durationUs);
+
     status_t nextBufferTime(int64_t *timeUs);
 
     void queueAccessUnit(const sp<ABuffer> &buffer);
 
+    // Unless "discard" is false the access units still queued are dropped.
     void queueDiscontinuity(
-            ATSParser::DiscontinuityType type, const sp<AMessage> &extra);
+            ATSParser::DiscontinuityType type, const sp<AMessage> &extra,
+            bool discard = true);
 
     void signalEOS(status_t result);
 
@@ -75,7 +89,24 @@ private:
     List<sp<ABuffer> > mBuffers;
     status_t mEOSResult;
 
+    // Kept up to date as buffers come and go, the buffered duration as
+    // the sum of the differences between neighbouring access units.
+    size_t mQueuedBytes;
+    int64_t mBufferedDurationUs;
+
+    size_t mMaxBytes;
+    int64_t mMaxDurationUs;
+    sp<AMessage> mSpaceNotify;
+
+    size_t mHighWaterBytes;
+    int64_t mHighWaterDurationUs;
+
     bool wasFormatChange(int32_t discontinuityType) const;
+    void onFormatChangeLocked();
+
+    sp<ABuffer> dequeueBufferLocked();
+    bool isFullLocked() const;
+    void notifySpaceLocked();
 
     DISALLOW_EVIL_CONSTRUCTORS(AnotherPacketSource);
 };
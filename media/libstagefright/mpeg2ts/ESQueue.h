@@ -72,6 +72,14 @@ private:
     sp<ABuffer> dequeueAccessUnitMPEG4Video();
     sp<ABuffer> dequeueAccessUnitPCMAudio();
 
+    // An access unit made of the given range of the queued data, pointing
+    // into mBuffer rather than copied. The data stays put until every such
+    // access unit is gone, see appendData().
+    sp<ABuffer> slice(size_t offset, size_t size);
+
+    // Drops data from the front of the queue without moving the rest.
+    void consume(size_t size);
+
     // consume a logical (compressed) access unit of size "size",
     // returns its timestamp in us (or -1 if no time information).
     int64_t fetchTimestamp(size_t size);
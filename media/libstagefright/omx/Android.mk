@@ -9,6 +9,7 @@ LOCAL_SRC_FILES:=                     \
         SimpleSoftOMXComponent.cpp    \
         SoftOMXComponent.cpp          \
         SoftOMXPlugin.cpp             \
+        SoftOMXWorkerPool.cpp         \
         SoftVideoDecoderOMXComponent.cpp \
 
 LOCAL_C_INCLUDES += \
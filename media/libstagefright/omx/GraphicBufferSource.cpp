@@ -31,6 +31,10 @@ namespace android {
 
 static const bool EXTRA_CHECK = true;
 
+// Frames arriving this much ahead of their slot under the max-fps cap are
+// still accepted, to absorb jitter in producer timestamps.
+static const int64_t kMaxFrameJitterUs = 2000ll;
+
 
 GraphicBufferSource::GraphicBufferSource(OMXNodeInstance* nodeInstance,
         uint32_t bufferWidth, uint32_t bufferHeight, uint32_t bufferCount) :
@@ -46,7 +50,11 @@ GraphicBufferSource::GraphicBufferSource(OMXNodeInstance* nodeInstance,
     mLatestSubmittedBufferId(-1),
     mLatestSubmittedBufferFrameNum(0),
     mLatestSubmittedBufferUseCount(0),
-    mRepeatBufferDeferred(false) {
+    mRepeatLastFrameTimestamp(0ll),
+    mRepeatBufferDeferred(false),
+    mMinFrameIntervalUs(-1ll),
+    mNextFrameTimeUs(-1ll),
+    mPrevFrameTimeUs(-1ll) {
 
     ALOGV("GraphicBufferSource w=%u h=%u c=%u",
             bufferWidth, bufferHeight, bufferCount);
@@ -335,21 +343,54 @@ bool GraphicBufferSource::fillCodecBuffer_l() {
         return false;
     }
 
-    ALOGV("fillCodecBuffer_l: acquiring buffer, avail=%d",
-            mNumFramesAvailable);
     BufferQueue::BufferItem item;
-    status_t err = mBufferQueue->acquireBuffer(&item, 0);
-    if (err == BufferQueue::NO_BUFFER_AVAILABLE) {
-        // shouldn't happen
-        ALOGW("fillCodecBuffer_l: frame was not available");
-        return false;
-    } else if (err != OK) {
-        // now what? fake end-of-stream?
-        ALOGW("fillCodecBuffer_l: acquireBuffer returned err=%d", err);
-        return false;
-    }
+    status_t err;
+    for (;;) {
+        ALOGV("fillCodecBuffer_l: acquiring buffer, avail=%d",
+                mNumFramesAvailable);
+        err = mBufferQueue->acquireBuffer(&item, 0);
+        if (err == BufferQueue::NO_BUFFER_AVAILABLE) {
+            // shouldn't happen
+            ALOGW("fillCodecBuffer_l: frame was not available");
+            return false;
+        } else if (err != OK) {
+            // now what? fake end-of-stream?
+            ALOGW("fillCodecBuffer_l: acquireBuffer returned err=%d", err);
+            return false;
+        }
+
+        mNumFramesAvailable--;
+
+        // If this is the first time we're seeing this buffer, add it to our
+        // slot table.
+        if (item.mGraphicBuffer != NULL) {
+            ALOGV("fillCodecBuffer_l: setting mBufferSlot %d", item.mBuf);
+            mBufferSlot[item.mBuf] = item.mGraphicBuffer;
+        }
+
+        if (!shouldDropFrame_l(item.mTimestamp / 1000)) {
+            break;
+        }
 
-    mNumFramesAvailable--;
+        ALOGV("fillCodecBuffer_l: dropping frame at %lld us",
+                item.mTimestamp / 1000);
+
+        if (mReflector != NULL) {
+            // Hold on to the newest contents even though they weren't
+            // submitted, so that they still reach the encoder as the
+            // repeated frame if the producer goes idle now.
+            setLatestSubmittedBuffer_l(item);
+            mLatestSubmittedBufferUseCount = 0;
+        } else {
+            mBufferQueue->releaseBuffer(item.mBuf, item.mFrameNumber,
+                    EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, item.mFence);
+        }
+
+        if (mNumFramesAvailable == 0) {
+            // The codec buffer is still available for the next frame.
+            return true;
+        }
+    }
 
     // Wait for it to become available.
     err = item.mFence->waitForever("GraphicBufferSource::fillCodecBuffer_l");
@@ -358,13 +399,6 @@ bool GraphicBufferSource::fillCodecBuffer_l() {
         // keep going
     }
 
-    // If this is the first time we're seeing this buffer, add it to our
-    // slot table.
-    if (item.mGraphicBuffer != NULL) {
-        ALOGV("fillCodecBuffer_l: setting mBufferSlot %d", item.mBuf);
-        mBufferSlot[item.mBuf] = item.mGraphicBuffer;
-    }
-
     err = submitBuffer_l(item, cbi);
     if (err != OK) {
         ALOGV("submitBuffer_l failed, releasing bq buf %d", item.mBuf);
@@ -395,6 +429,7 @@ bool GraphicBufferSource::repeatLatestSubmittedBuffer_l() {
     BufferQueue::BufferItem item;
     item.mBuf = mLatestSubmittedBufferId;
     item.mFrameNumber = mLatestSubmittedBufferFrameNum;
+    item.mTimestamp = mRepeatLastFrameTimestamp;
 
     status_t err = submitBuffer_l(item, cbi);
 
@@ -404,6 +439,9 @@ bool GraphicBufferSource::repeatLatestSubmittedBuffer_l() {
 
     ++mLatestSubmittedBufferUseCount;
 
+    mPrevFrameTimeUs = mRepeatLastFrameTimestamp / 1000;
+    mRepeatLastFrameTimestamp += mRepeatAfterUs * 1000;
+
     return true;
 }
 
@@ -426,6 +464,7 @@ void GraphicBufferSource::setLatestSubmittedBuffer_l(
     mLatestSubmittedBufferFrameNum = item.mFrameNumber;
     mLatestSubmittedBufferUseCount = 1;
     mRepeatBufferDeferred = false;
+    mRepeatLastFrameTimestamp = item.mTimestamp + mRepeatAfterUs * 1000;
 
     if (mReflector != NULL) {
         sp<AMessage> msg = new AMessage(kWhatRepeatLastFrame, mReflector->id());
@@ -622,6 +661,56 @@ status_t GraphicBufferSource::setRepeatPreviousFrameDelayUs(
     return OK;
 }
 
+status_t GraphicBufferSource::setMaxFps(float maxFps) {
+    Mutex::Autolock autoLock(mMutex);
+
+    if (maxFps > 0.0f) {
+        mMinFrameIntervalUs = (int64_t)(1000000.0f / maxFps);
+    } else {
+        mMinFrameIntervalUs = -1ll;
+    }
+
+    mNextFrameTimeUs = -1ll;
+
+    ALOGV("setMaxFps %.2f, min frame interval %lld us",
+            maxFps, mMinFrameIntervalUs);
+
+    return OK;
+}
+
+bool GraphicBufferSource::shouldDropFrame_l(int64_t timeUs) {
+    if (mMinFrameIntervalUs <= 0ll) {
+        mPrevFrameTimeUs = timeUs;
+        return false;
+    }
+
+    if (mPrevFrameTimeUs >= 0ll && timeUs <= mPrevFrameTimeUs) {
+        // The encoder requires increasing timestamps.
+        return true;
+    }
+
+    if (mNextFrameTimeUs >= 0ll) {
+        if (timeUs < mNextFrameTimeUs - kMaxFrameJitterUs) {
+            return true;
+        }
+
+        if (timeUs < mNextFrameTimeUs + mMinFrameIntervalUs) {
+            // Advance by whole intervals so that the output rate doesn't
+            // drift below the cap when frames arrive slightly late.
+            mNextFrameTimeUs += mMinFrameIntervalUs;
+        } else {
+            // Resync after a gap in the input.
+            mNextFrameTimeUs = timeUs + mMinFrameIntervalUs;
+        }
+    } else {
+        mNextFrameTimeUs = timeUs + mMinFrameIntervalUs;
+    }
+
+    mPrevFrameTimeUs = timeUs;
+
+    return false;
+}
+
 void GraphicBufferSource::onMessageReceived(const sp<AMessage> &msg) {
     switch (msg->what()) {
         case kWhatRepeatLastFrame:
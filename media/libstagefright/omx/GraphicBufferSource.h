@@ -100,6 +100,13 @@ public:
     // state and once this behaviour is specified it cannot be reset.
     status_t setRepeatPreviousFrameDelayUs(int64_t repeatAfterUs);
 
+    // Caps the rate at which frames are submitted to the encoder.  Frames
+    // arriving faster than "maxFps" according to their timestamps, as well
+    // as frames whose timestamps go backwards, are returned to the producer
+    // without being encoded.  A value <= 0 disables the cap.  Unlike the
+    // repeat delay this may be changed while executing.
+    status_t setMaxFps(float maxFps);
+
 protected:
     // BufferQueue::ConsumerListener interface, called when a new frame of
     // data is available.  If we're executing and a codec buffer is
@@ -158,6 +165,10 @@ private:
     // doing anything if we don't have a codec buffer available.
     void submitEndOfInputStream_l();
 
+    // Returns true if the frame with the given timestamp should not be
+    // submitted to the encoder because of the max-fps cap.
+    bool shouldDropFrame_l(int64_t timeUs);
+
     void setLatestSubmittedBuffer_l(const BufferQueue::BufferItem &item);
     bool repeatLatestSubmittedBuffer_l();
 
@@ -213,10 +224,22 @@ private:
     uint64_t mLatestSubmittedBufferFrameNum;
     int32_t mLatestSubmittedBufferUseCount;
 
+    // Timestamp (in nsecs) given to the next repeat of the latest buffer.
+    int64_t mRepeatLastFrameTimestamp;
+
     // The previously submitted buffer should've been repeated but
     // no codec buffer was available at the time.
     bool mRepeatBufferDeferred;
 
+    // Minimum spacing of submitted frames, -1 if there is no max-fps cap.
+    int64_t mMinFrameIntervalUs;
+
+    // Earliest timestamp at which the next frame is accepted under the cap.
+    int64_t mNextFrameTimeUs;
+
+    // Timestamp of the last frame submitted to the encoder.
+    int64_t mPrevFrameTimeUs;
+
     void onMessageReceived(const sp<AMessage> &msg);
 
     DISALLOW_EVIL_CONSTRUCTORS(GraphicBufferSource);
@@ -849,6 +849,7 @@ status_t OMXNodeInstance::setInternalOption(
     switch (type) {
         case IOMX::INTERNAL_OPTION_SUSPEND:
         case IOMX::INTERNAL_OPTION_REPEAT_PREVIOUS_FRAME_DELAY:
+        case IOMX::INTERNAL_OPTION_MAX_FPS:
         {
             const sp<GraphicBufferSource> &bufferSource =
                 getGraphicBufferSource();
@@ -864,6 +865,14 @@ status_t OMXNodeInstance::setInternalOption(
 
                 bool suspend = *(bool *)data;
                 bufferSource->suspend(suspend);
+            } else if (type == IOMX::INTERNAL_OPTION_MAX_FPS) {
+                if (size != sizeof(float)) {
+                    return INVALID_OPERATION;
+                }
+
+                float maxFps = *(float *)data;
+
+                return bufferSource->setMaxFps(maxFps);
             } else {
                 if (size != sizeof(int64_t)) {
                     return INVALID_OPERATION;
@@ -882,7 +891,24 @@ status_t OMXNodeInstance::setInternalOption(
     }
 }
 
-void OMXNodeInstance::onMessage(const omx_message &msg) {
+void OMXNodeInstance::onMessages(const List<omx_message> &messages) {
+    List<omx_message> observerMessages;
+
+    for (List<omx_message>::const_iterator it = messages.begin();
+         it != messages.end(); ++it) {
+        if (!handleMessage(*it)) {
+            observerMessages.push_back(*it);
+        }
+    }
+
+    if (!observerMessages.empty()) {
+        mObserver->onMessages(observerMessages);
+    }
+}
+
+// Returns true if the message was consumed here and must not be forwarded
+// to the observer.
+bool OMXNodeInstance::handleMessage(const omx_message &msg) {
     if (msg.type == omx_message::FILL_BUFFER_DONE) {
         OMX_BUFFERHEADERTYPE *buffer =
             static_cast<OMX_BUFFERHEADERTYPE *>(
@@ -907,11 +933,11 @@ void OMXNodeInstance::onMessage(const omx_message &msg) {
                         msg.u.buffer_data.buffer);
 
             bufferSource->codecBufferEmptied(buffer);
-            return;
+            return true;
         }
     }
 
-    mObserver->onMessage(msg);
+    return false;
 }
 
 void OMXNodeInstance::onObserverDied(OMXMaster *master) {
@@ -94,7 +94,10 @@ bool SimpleSoftOMXComponent::isSetParameterAllowed(
         }
 
         default:
-            return false;
+            if (!getParameterPortIndex(index, params, &portIndex)) {
+                return false;
+            }
+            break;
     }
 
     CHECK(portIndex < mPorts.size());
@@ -182,6 +185,12 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::internalSetParameter(
     }
 }
 
+bool SimpleSoftOMXComponent::getParameterPortIndex(
+        OMX_INDEXTYPE index, const OMX_PTR params,
+        OMX_U32 *portIndex) const {
+    return false;
+}
+
 OMX_ERRORTYPE SimpleSoftOMXComponent::useBuffer(
         OMX_BUFFERHEADERTYPE **header,
         OMX_U32 portIndex,
@@ -189,6 +198,17 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::useBuffer(
         OMX_U32 size,
         OMX_U8 *ptr) {
     Mutex::Autolock autoLock(mLock);
+
+    return internalUseBuffer(header, portIndex, appPrivate, size, ptr);
+}
+
+OMX_ERRORTYPE SimpleSoftOMXComponent::internalUseBuffer(
+        OMX_BUFFERHEADERTYPE **header,
+        OMX_U32 portIndex,
+        OMX_PTR appPrivate,
+        OMX_U32 size,
+        OMX_U8 *ptr,
+        const sp<GraphicBuffer> &graphicBuffer) {
     CHECK_LT(portIndex, mPorts.size());
 
     *header = new OMX_BUFFERHEADERTYPE;
@@ -226,6 +246,7 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::useBuffer(
 
     buffer->mHeader = *header;
     buffer->mOwnedByUs = false;
+    buffer->mGraphicBuffer = graphicBuffer;
 
     if (port->mBuffers.size() == port->mDef.nBufferCountActual) {
         port->mDef.bPopulated = OMX_TRUE;
@@ -22,6 +22,7 @@
 #include "include/SoftOMXComponent.h"
 
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AString.h>
 
 #include <dlfcn.h>
@@ -61,9 +62,22 @@ static const struct {
 static const size_t kNumComponents =
     sizeof(kComponents) / sizeof(kComponents[0]);
 
+// How long an unused component library is kept loaded.
+static const int64_t kLibraryIdleTimeoutUs = 30000000ll;
+
 SoftOMXPlugin::SoftOMXPlugin() {
 }
 
+SoftOMXPlugin::~SoftOMXPlugin() {
+    for (size_t i = 0; i < mLibraries.size(); ++i) {
+        const Library &library = mLibraries.valueAt(i);
+
+        if (library.mNumInstances == 0) {
+            dlclose(library.mHandle);
+        }
+    }
+}
+
 OMX_ERRORTYPE SoftOMXPlugin::makeComponentInstance(
         const char *name,
         const OMX_CALLBACKTYPE *callbacks,
@@ -80,45 +94,29 @@ OMX_ERRORTYPE SoftOMXPlugin::makeComponentInstance(
         libName.append(kComponents[i].mLibNameSuffix);
         libName.append(".so");
 
-        void *libHandle = dlopen(libName.c_str(), RTLD_NOW);
-
-        if (libHandle == NULL) {
-            ALOGE("unable to dlopen %s", libName.c_str());
+        Mutex::Autolock autoLock(mLock);
 
+        Library *library;
+        if (acquireLibrary_l(libName, &library) != OK) {
             return OMX_ErrorComponentNotFound;
         }
 
-        typedef SoftOMXComponent *(*CreateSoftOMXComponentFunc)(
-                const char *, const OMX_CALLBACKTYPE *,
-                OMX_PTR, OMX_COMPONENTTYPE **);
-
-        CreateSoftOMXComponentFunc createSoftOMXComponent =
-            (CreateSoftOMXComponentFunc)dlsym(
-                    libHandle,
-                    "_Z22createSoftOMXComponentPKcPK16OMX_CALLBACKTYPE"
-                    "PvPP17OMX_COMPONENTTYPE");
-
-        if (createSoftOMXComponent == NULL) {
-            dlclose(libHandle);
-            libHandle = NULL;
-
-            return OMX_ErrorComponentNotFound;
-        }
+        void *libHandle = library->mHandle;
 
         sp<SoftOMXComponent> codec =
-            (*createSoftOMXComponent)(name, callbacks, appData, component);
+            (*library->mCreate)(name, callbacks, appData, component);
 
         if (codec == NULL) {
-            dlclose(libHandle);
-            libHandle = NULL;
+            releaseLibrary_l(libHandle);
 
             return OMX_ErrorInsufficientResources;
         }
 
         OMX_ERRORTYPE err = codec->initCheck();
         if (err != OMX_ErrorNone) {
-            dlclose(libHandle);
-            libHandle = NULL;
+            // Drop the component before its code can go away.
+            codec.clear();
+            releaseLibrary_l(libHandle);
 
             return err;
         }
@@ -146,12 +144,94 @@ OMX_ERRORTYPE SoftOMXPlugin::destroyComponentInstance(
     me->decStrong(this);
     me = NULL;
 
-    dlclose(libHandle);
-    libHandle = NULL;
+    Mutex::Autolock autoLock(mLock);
+    releaseLibrary_l(libHandle);
 
     return OMX_ErrorNone;
 }
 
+status_t SoftOMXPlugin::acquireLibrary_l(
+        const AString &libName, Library **library) {
+    unloadIdleLibraries_l();
+
+    ssize_t index = mLibraries.indexOfKey(libName);
+    if (index >= 0) {
+        *library = &mLibraries.editValueAt(index);
+        ++(*library)->mNumInstances;
+
+        return OK;
+    }
+
+    void *libHandle = dlopen(libName.c_str(), RTLD_NOW);
+
+    if (libHandle == NULL) {
+        ALOGE("unable to dlopen %s", libName.c_str());
+
+        return UNKNOWN_ERROR;
+    }
+
+    CreateSoftOMXComponentFunc createSoftOMXComponent =
+        (CreateSoftOMXComponentFunc)dlsym(
+                libHandle,
+                "_Z22createSoftOMXComponentPKcPK16OMX_CALLBACKTYPE"
+                "PvPP17OMX_COMPONENTTYPE");
+
+    if (createSoftOMXComponent == NULL) {
+        dlclose(libHandle);
+        libHandle = NULL;
+
+        return UNKNOWN_ERROR;
+    }
+
+    Library entry;
+    entry.mHandle = libHandle;
+    entry.mCreate = createSoftOMXComponent;
+    entry.mNumInstances = 1;
+    entry.mIdleSinceUs = 0;
+
+    index = mLibraries.add(libName, entry);
+    *library = &mLibraries.editValueAt(index);
+
+    return OK;
+}
+
+void SoftOMXPlugin::releaseLibrary_l(void *libHandle) {
+    for (size_t i = 0; i < mLibraries.size(); ++i) {
+        Library *library = &mLibraries.editValueAt(i);
+
+        if (library->mHandle != libHandle) {
+            continue;
+        }
+
+        CHECK_GT(library->mNumInstances, 0u);
+        if (--library->mNumInstances == 0) {
+            library->mIdleSinceUs = ALooper::GetNowUs();
+        }
+        break;
+    }
+
+    unloadIdleLibraries_l();
+}
+
+void SoftOMXPlugin::unloadIdleLibraries_l() {
+    int64_t nowUs = ALooper::GetNowUs();
+
+    size_t i = 0;
+    while (i < mLibraries.size()) {
+        const Library &library = mLibraries.valueAt(i);
+
+        if (library.mNumInstances == 0
+                && nowUs - library.mIdleSinceUs >= kLibraryIdleTimeoutUs) {
+            ALOGV("unloading %s", mLibraries.keyAt(i).c_str());
+
+            dlclose(library.mHandle);
+            mLibraries.removeItemsAt(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
 OMX_ERRORTYPE SoftOMXPlugin::enumerateComponents(
         OMX_STRING name,
         size_t size,
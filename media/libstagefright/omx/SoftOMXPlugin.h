@@ -19,12 +19,18 @@
 #define SOFT_OMX_PLUGIN_H_
 
 #include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
 #include <OMXPluginBase.h>
 
 namespace android {
 
+struct SoftOMXComponent;
+
 struct SoftOMXPlugin : public OMXPluginBase {
     SoftOMXPlugin();
+    virtual ~SoftOMXPlugin();
 
     virtual OMX_ERRORTYPE makeComponentInstance(
             const char *name,
@@ -45,6 +51,27 @@ struct SoftOMXPlugin : public OMXPluginBase {
             Vector<String8> *roles);
 
 private:
+    typedef SoftOMXComponent *(*CreateSoftOMXComponentFunc)(
+            const char *, const OMX_CALLBACKTYPE *,
+            OMX_PTR, OMX_COMPONENTTYPE **);
+
+    // Component libraries stay loaded for a while after their last
+    // instance is gone, so that a codec that is immediately recreated
+    // doesn't pay for dlopen and relocation again.
+    struct Library {
+        void *mHandle;
+        CreateSoftOMXComponentFunc mCreate;
+        size_t mNumInstances;
+        int64_t mIdleSinceUs;
+    };
+
+    Mutex mLock;
+    KeyedVector<AString, Library> mLibraries;
+
+    status_t acquireLibrary_l(const AString &libName, Library **library);
+    void releaseLibrary_l(void *libHandle);
+    void unloadIdleLibraries_l();
+
     DISALLOW_EVIL_CONSTRUCTORS(SoftOMXPlugin);
 };
 
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SoftOMXWorkerPool"
+#include <utils/Log.h>
+
+#include "include/SoftOMXWorkerPool.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+
+#include <unistd.h>
+
+namespace android {
+
+// Upper bound on the number of worker threads, on top of the caller.
+static const size_t kMaxNumWorkers = 3;
+
+// Planes smaller than this are copied on the calling thread only.
+static const size_t kMinParallelCopyBytes = 256 * 1024;
+
+struct SoftOMXWorkerPool::Batch {
+    JobFunc mFunc;
+    void *mCookie;
+    size_t mNumJobs;
+    size_t mNextJob;
+    size_t mNumPending;
+    Condition mDone;
+};
+
+struct SoftOMXWorkerPool::WorkerThread : public Thread {
+    WorkerThread(SoftOMXWorkerPool *pool)
+        : Thread(false /* canCallJava */),
+          mPool(pool) {
+    }
+
+private:
+    SoftOMXWorkerPool *mPool;
+
+    virtual bool threadLoop() {
+        return mPool->workerLoop();
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(WorkerThread);
+};
+
+static Mutex sPoolLock;
+static SoftOMXWorkerPool *sPool;
+
+// static
+SoftOMXWorkerPool *SoftOMXWorkerPool::Get() {
+    Mutex::Autolock autoLock(sPoolLock);
+
+    if (sPool == NULL) {
+        long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t numWorkers = numCores > 1 ? numCores - 1 : 0;
+        if (numWorkers > kMaxNumWorkers) {
+            numWorkers = kMaxNumWorkers;
+        }
+
+        sPool = new SoftOMXWorkerPool(numWorkers);
+    }
+
+    return sPool;
+}
+
+SoftOMXWorkerPool::SoftOMXWorkerPool(size_t numWorkers) {
+    ALOGV("starting %d worker threads", numWorkers);
+
+    for (size_t i = 0; i < numWorkers; ++i) {
+        sp<WorkerThread> worker = new WorkerThread(this);
+        if (worker->run("SoftOMXWorker", ANDROID_PRIORITY_FOREGROUND) != OK) {
+            break;
+        }
+        mWorkers.push(worker);
+    }
+}
+
+size_t SoftOMXWorkerPool::parallelism() const {
+    return mWorkers.size() + 1;
+}
+
+void SoftOMXWorkerPool::run(JobFunc func, void *cookie, size_t numJobs) {
+    if (mWorkers.empty() || numJobs <= 1) {
+        for (size_t i = 0; i < numJobs; ++i) {
+            (*func)(cookie, i);
+        }
+        return;
+    }
+
+    Batch batch;
+    batch.mFunc = func;
+    batch.mCookie = cookie;
+    batch.mNumJobs = numJobs;
+    batch.mNextJob = 0;
+    batch.mNumPending = numJobs;
+
+    Mutex::Autolock autoLock(mLock);
+
+    mBatches.push_back(&batch);
+    mWorkAvailable.broadcast();
+
+    // Work on our own batch until all of its jobs have been handed out,
+    // then wait for the workers to finish theirs.
+    while (batch.mNextJob < batch.mNumJobs) {
+        size_t jobIndex = batch.mNextJob++;
+
+        if (batch.mNextJob == batch.mNumJobs) {
+            for (List<Batch *>::iterator it = mBatches.begin();
+                 it != mBatches.end(); ++it) {
+                if (*it == &batch) {
+                    mBatches.erase(it);
+                    break;
+                }
+            }
+        }
+
+        runJob_l(&batch, jobIndex);
+    }
+
+    while (batch.mNumPending > 0) {
+        batch.mDone.wait(mLock);
+    }
+}
+
+bool SoftOMXWorkerPool::takeJob_l(Batch **batch, size_t *jobIndex) {
+    if (mBatches.empty()) {
+        return false;
+    }
+
+    *batch = *mBatches.begin();
+    *jobIndex = (*batch)->mNextJob++;
+
+    if ((*batch)->mNextJob == (*batch)->mNumJobs) {
+        mBatches.erase(mBatches.begin());
+    }
+
+    return true;
+}
+
+void SoftOMXWorkerPool::runJob_l(Batch *batch, size_t jobIndex) {
+    mLock.unlock();
+    (*batch->mFunc)(batch->mCookie, jobIndex);
+    mLock.lock();
+
+    CHECK_GT(batch->mNumPending, 0u);
+    if (--batch->mNumPending == 0) {
+        batch->mDone.signal();
+    }
+}
+
+bool SoftOMXWorkerPool::workerLoop() {
+    Mutex::Autolock autoLock(mLock);
+
+    Batch *batch;
+    size_t jobIndex;
+    while (!takeJob_l(&batch, &jobIndex)) {
+        mWorkAvailable.wait(mLock);
+    }
+
+    runJob_l(batch, jobIndex);
+
+    return true;
+}
+
+namespace {
+
+struct CopyRowsJob {
+    uint8_t *mDst;
+    size_t mDstStride;
+    const uint8_t *mSrc;
+    size_t mSrcStride;
+    size_t mRowBytes;
+    size_t mNumRows;
+    size_t mNumJobs;
+};
+
+}  // namespace
+
+static void CopyRows(void *cookie, size_t jobIndex) {
+    const CopyRowsJob *job = static_cast<const CopyRowsJob *>(cookie);
+
+    size_t firstRow = jobIndex * job->mNumRows / job->mNumJobs;
+    size_t endRow = (jobIndex + 1) * job->mNumRows / job->mNumJobs;
+
+    uint8_t *dst = job->mDst + firstRow * job->mDstStride;
+    const uint8_t *src = job->mSrc + firstRow * job->mSrcStride;
+
+    if (job->mDstStride == job->mRowBytes
+            && job->mSrcStride == job->mRowBytes) {
+        memcpy(dst, src, (endRow - firstRow) * job->mRowBytes);
+        return;
+    }
+
+    for (size_t i = firstRow; i < endRow; ++i) {
+        memcpy(dst, src, job->mRowBytes);
+
+        dst += job->mDstStride;
+        src += job->mSrcStride;
+    }
+}
+
+void SoftOMXWorkerPool::copyRows(
+        uint8_t *dst, size_t dstStride,
+        const uint8_t *src, size_t srcStride,
+        size_t rowBytes, size_t numRows) {
+    CopyRowsJob job;
+    job.mDst = dst;
+    job.mDstStride = dstStride;
+    job.mSrc = src;
+    job.mSrcStride = srcStride;
+    job.mRowBytes = rowBytes;
+    job.mNumRows = numRows;
+    job.mNumJobs = 1;
+
+    if (rowBytes * numRows >= kMinParallelCopyBytes) {
+        job.mNumJobs = parallelism();
+        if (job.mNumJobs > numRows) {
+            job.mNumJobs = numRows;
+        }
+    }
+
+    run(CopyRows, &job, job.mNumJobs);
+}
+
+}  // namespace android
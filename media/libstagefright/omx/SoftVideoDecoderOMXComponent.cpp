@@ -19,14 +19,20 @@
 #include <utils/Log.h>
 
 #include "include/SoftVideoDecoderOMXComponent.h"
+#include "include/SoftOMXWorkerPool.h"
 
+#include <HardwareAPI.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaDefs.h>
+#include <ui/GraphicBufferMapper.h>
+#include <ui/Rect.h>
 
 namespace android {
 
+#define ALIGN(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
 template<class T>
 static void InitOMXParams(T *params) {
     params->nSize = sizeof(T);
@@ -55,6 +61,10 @@ SoftVideoDecoderOMXComponent::SoftVideoDecoderOMXComponent(
         mCropWidth(width),
         mCropHeight(height),
         mOutputPortSettingsChange(NONE),
+        mUseNativeBuffers(false),
+        mIsAdaptive(false),
+        mAdaptiveMaxWidth(0),
+        mAdaptiveMaxHeight(0),
         mComponentRole(componentRole),
         mCodingType(codingType),
         mProfileLevels(profileLevels),
@@ -125,8 +135,8 @@ void SoftVideoDecoderOMXComponent::updatePortDefinitions() {
     def->format.video.nSliceHeight = def->format.video.nFrameHeight;
 
     def = &editPortInfo(kOutputPortIndex)->mDef;
-    def->format.video.nFrameWidth = mWidth;
-    def->format.video.nFrameHeight = mHeight;
+    def->format.video.nFrameWidth = outputBufferWidth();
+    def->format.video.nFrameHeight = outputBufferHeight();
     def->format.video.nStride = def->format.video.nFrameWidth;
     def->format.video.nSliceHeight = def->format.video.nFrameHeight;
 
@@ -140,6 +150,58 @@ void SoftVideoDecoderOMXComponent::updatePortDefinitions() {
     mCropHeight = mHeight;
 }
 
+uint32_t SoftVideoDecoderOMXComponent::outputBufferWidth() const {
+    return mIsAdaptive ? mAdaptiveMaxWidth : mWidth;
+}
+
+uint32_t SoftVideoDecoderOMXComponent::outputBufferHeight() const {
+    return mIsAdaptive ? mAdaptiveMaxHeight : mHeight;
+}
+
+bool SoftVideoDecoderOMXComponent::handlePortSettingsChange(
+        uint32_t width, uint32_t height) {
+    if (width == mWidth && height == mHeight) {
+        return false;
+    }
+
+    mWidth = width;
+    mHeight = height;
+
+    if (mIsAdaptive
+            && width <= mAdaptiveMaxWidth && height <= mAdaptiveMaxHeight) {
+        ALOGV("picture size now %ux%u, keeping %ux%u output buffers",
+                width, height, mAdaptiveMaxWidth, mAdaptiveMaxHeight);
+
+        mCropLeft = 0;
+        mCropTop = 0;
+        mCropWidth = width;
+        mCropHeight = height;
+
+        notify(OMX_EventPortSettingsChanged, kOutputPortIndex,
+                OMX_IndexConfigCommonOutputCrop, NULL);
+
+        return false;
+    }
+
+    if (mIsAdaptive) {
+        // Grow the buffers so that we don't have to go through this again
+        // when switching back to a larger dimension in the other direction.
+        if (width > mAdaptiveMaxWidth) {
+            mAdaptiveMaxWidth = width;
+        }
+        if (height > mAdaptiveMaxHeight) {
+            mAdaptiveMaxHeight = height;
+        }
+    }
+
+    updatePortDefinitions();
+
+    notify(OMX_EventPortSettingsChanged, kOutputPortIndex, 0, NULL);
+    mOutputPortSettingsChange = AWAITING_DISABLED;
+
+    return true;
+}
+
 OMX_ERRORTYPE SoftVideoDecoderOMXComponent::internalGetParameter(
         OMX_INDEXTYPE index, OMX_PTR params) {
     switch (index) {
@@ -190,6 +252,20 @@ OMX_ERRORTYPE SoftVideoDecoderOMXComponent::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kGetAndroidNativeBufferUsageIndex:
+        {
+            GetAndroidNativeBufferUsageParams *usageParams =
+                (GetAndroidNativeBufferUsageParams *)params;
+
+            if (!supportsNativeBuffers()
+                    || usageParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            usageParams->nUsage = GRALLOC_USAGE_SW_WRITE_OFTEN;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalGetParameter(index, params);
     }
@@ -228,6 +304,81 @@ OMX_ERRORTYPE SoftVideoDecoderOMXComponent::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kEnableAndroidNativeBuffersIndex:
+        {
+            const EnableAndroidNativeBuffersParams *enableParams =
+                (const EnableAndroidNativeBuffersParams *)params;
+
+            if (!supportsNativeBuffers()
+                    || enableParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            mUseNativeBuffers = enableParams->enable;
+
+            // The client sets up the window from the port definition.
+            editPortInfo(kOutputPortIndex)->mDef.format.video.eColorFormat =
+                mUseNativeBuffers
+                    ? (OMX_COLOR_FORMATTYPE)HAL_PIXEL_FORMAT_YV12
+                    : OMX_COLOR_FormatYUV420Planar;
+
+            return OMX_ErrorNone;
+        }
+
+        case kUseAndroidNativeBufferIndex:
+        {
+            const UseAndroidNativeBufferParams *useParams =
+                (const UseAndroidNativeBufferParams *)params;
+
+            if (!mUseNativeBuffers
+                    || useParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            sp<GraphicBuffer> graphicBuffer =
+                new GraphicBuffer(useParams->nativeBuffer.get(), false);
+
+            return internalUseBuffer(
+                    useParams->bufferHeader,
+                    kOutputPortIndex,
+                    useParams->pAppPrivate,
+                    editPortInfo(kOutputPortIndex)->mDef.nBufferSize,
+                    NULL /* ptr */,
+                    graphicBuffer);
+        }
+
+        case kPrepareForAdaptivePlaybackIndex:
+        {
+            const PrepareForAdaptivePlaybackParams *adaptiveParams =
+                (const PrepareForAdaptivePlaybackParams *)params;
+
+            if (!supportsNativeBuffers()
+                    || adaptiveParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            mIsAdaptive = adaptiveParams->bEnable;
+            if (mIsAdaptive) {
+                mAdaptiveMaxWidth = adaptiveParams->nMaxFrameWidth;
+                mAdaptiveMaxHeight = adaptiveParams->nMaxFrameHeight;
+
+                if (mAdaptiveMaxWidth < mWidth) {
+                    mAdaptiveMaxWidth = mWidth;
+                }
+                if (mAdaptiveMaxHeight < mHeight) {
+                    mAdaptiveMaxHeight = mHeight;
+                }
+            }
+
+            ALOGV("adaptive playback %s, max %ux%u",
+                    mIsAdaptive ? "enabled" : "disabled",
+                    mAdaptiveMaxWidth, mAdaptiveMaxHeight);
+
+            updatePortDefinitions();
+
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalSetParameter(index, params);
     }
@@ -257,6 +408,128 @@ OMX_ERRORTYPE SoftVideoDecoderOMXComponent::getConfig(
     }
 }
 
+OMX_ERRORTYPE SoftVideoDecoderOMXComponent::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!supportsNativeBuffers()) {
+        return SimpleSoftOMXComponent::getExtensionIndex(name, index);
+    }
+
+    if (!strcmp(name, "OMX.google.android.index.enableAndroidNativeBuffers")) {
+        *index = (OMX_INDEXTYPE)kEnableAndroidNativeBuffersIndex;
+        return OMX_ErrorNone;
+    } else if (!strcmp(name, "OMX.google.android.index.useAndroidNativeBuffer")) {
+        *index = (OMX_INDEXTYPE)kUseAndroidNativeBufferIndex;
+        return OMX_ErrorNone;
+    } else if (!strcmp(name,
+                "OMX.google.android.index.getAndroidNativeBufferUsage")) {
+        *index = (OMX_INDEXTYPE)kGetAndroidNativeBufferUsageIndex;
+        return OMX_ErrorNone;
+    } else if (!strcmp(name,
+                "OMX.google.android.index.prepareForAdaptivePlayback")) {
+        *index = (OMX_INDEXTYPE)kPrepareForAdaptivePlaybackIndex;
+        return OMX_ErrorNone;
+    }
+
+    return SimpleSoftOMXComponent::getExtensionIndex(name, index);
+}
+
+bool SoftVideoDecoderOMXComponent::getParameterPortIndex(
+        OMX_INDEXTYPE index, const OMX_PTR params,
+        OMX_U32 *portIndex) const {
+    switch ((int)index) {
+        case kEnableAndroidNativeBuffersIndex:
+            *portIndex =
+                ((const EnableAndroidNativeBuffersParams *)params)->nPortIndex;
+            return true;
+
+        case kUseAndroidNativeBufferIndex:
+            *portIndex =
+                ((const UseAndroidNativeBufferParams *)params)->nPortIndex;
+            return true;
+
+        case kPrepareForAdaptivePlaybackIndex:
+            *portIndex =
+                ((const PrepareForAdaptivePlaybackParams *)params)->nPortIndex;
+            return true;
+
+        default:
+            return SimpleSoftOMXComponent::getParameterPortIndex(
+                    index, params, portIndex);
+    }
+}
+
+bool SoftVideoDecoderOMXComponent::supportsNativeBuffers() const {
+    return false;
+}
+
+status_t SoftVideoDecoderOMXComponent::copyPictureToOutput(
+        BufferInfo *outInfo,
+        const uint8_t *srcY, size_t srcYStride,
+        const uint8_t *srcU, const uint8_t *srcV, size_t srcUVStride) {
+    OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+    SoftOMXWorkerPool *pool = SoftOMXWorkerPool::Get();
+
+    if (outInfo->mGraphicBuffer == NULL) {
+        // The layout follows the output port definition, which describes
+        // buffers larger than the picture in adaptive playback mode.
+        size_t dstYStride = outputBufferWidth();
+        size_t dstSliceHeight = outputBufferHeight();
+
+        uint8_t *dst = outHeader->pBuffer + outHeader->nOffset;
+
+        pool->copyRows(dst, dstYStride, srcY, srcYStride, mWidth, mHeight);
+        dst += dstYStride * dstSliceHeight;
+
+        pool->copyRows(
+                dst, dstYStride / 2, srcU, srcUVStride,
+                mWidth / 2, mHeight / 2);
+        dst += (dstYStride / 2) * (dstSliceHeight / 2);
+
+        pool->copyRows(
+                dst, dstYStride / 2, srcV, srcUVStride,
+                mWidth / 2, mHeight / 2);
+
+        outHeader->nFilledLen = (dstYStride * dstSliceHeight * 3) / 2;
+        return OK;
+    }
+
+    const sp<GraphicBuffer> &buffer = outInfo->mGraphicBuffer;
+    GraphicBufferMapper &mapper = GraphicBufferMapper::get();
+
+    void *dst;
+    status_t err = mapper.lock(
+            buffer->handle, GRALLOC_USAGE_SW_WRITE_OFTEN,
+            Rect(mWidth, mHeight), &dst);
+
+    if (err != OK) {
+        ALOGE("unable to lock output graphic buffer (%d)", err);
+        return err;
+    }
+
+    // YV12 is a Y plane followed by V and U planes whose stride is half the
+    // Y stride, aligned to 16 bytes.
+    size_t dstYStride = buffer->getStride();
+    size_t dstCStride = ALIGN(dstYStride / 2, 16);
+
+    uint8_t *dstY = (uint8_t *)dst;
+    uint8_t *dstV = dstY + dstYStride * buffer->getHeight();
+    uint8_t *dstU = dstV + dstCStride * (buffer->getHeight() / 2);
+
+    pool->copyRows(dstY, dstYStride, srcY, srcYStride, mWidth, mHeight);
+    pool->copyRows(
+            dstU, dstCStride, srcU, srcUVStride, mWidth / 2, mHeight / 2);
+    pool->copyRows(
+            dstV, dstCStride, srcV, srcUVStride, mWidth / 2, mHeight / 2);
+
+    mapper.unlock(buffer->handle);
+
+    // The picture lives in the graphic buffer, the length only tells the
+    // client that the buffer holds one.
+    outHeader->nFilledLen = (mWidth * mHeight * 3) / 2;
+
+    return OK;
+}
+
 void SoftVideoDecoderOMXComponent::onReset() {
     mOutputPortSettingsChange = NONE;
 }
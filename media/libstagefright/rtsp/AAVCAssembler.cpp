@@ -129,15 +129,28 @@ void AAVCAssembler::addSingleNALUnit(const sp<ABuffer> &buffer) {
     hexdump(buffer->data(), buffer->size());
 #endif
 
-    uint32_t rtpTime;
-    CHECK(buffer->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
+    addNALSlice(buffer, 0, buffer->size(), true /* startsNALUnit */);
+}
+
+void AAVCAssembler::addNALSlice(
+        const sp<ABuffer> &buffer, size_t offset, size_t size,
+        bool startsNALUnit) {
+    if (startsNALUnit) {
+        uint32_t rtpTime;
+        CHECK(buffer->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
 
-    if (!mNALUnits.empty() && rtpTime != mAccessUnitRTPTime) {
-        submitAccessUnit();
+        if (!mNALSlices.empty() && rtpTime != mAccessUnitRTPTime) {
+            submitAccessUnit();
+        }
+        mAccessUnitRTPTime = rtpTime;
     }
-    mAccessUnitRTPTime = rtpTime;
 
-    mNALUnits.push_back(buffer);
+    NALSlice slice;
+    slice.mBuffer = buffer;
+    slice.mOffset = offset;
+    slice.mSize = size;
+    slice.mStartsNALUnit = startsNALUnit;
+    mNALSlices.push_back(slice);
 }
 
 bool AAVCAssembler::addSingleTimeAggregationPacket(const sp<ABuffer> &buffer) {
@@ -159,12 +172,9 @@ bool AAVCAssembler::addSingleTimeAggregationPacket(const sp<ABuffer> &buffer) {
             return false;
         }
 
-        sp<ABuffer> unit = new ABuffer(nalSize);
-        memcpy(unit->data(), &data[2], nalSize);
-
-        CopyTimes(unit, buffer);
-
-        addSingleNALUnit(unit);
+        addNALSlice(
+                buffer, data + 2 - buffer->data(), nalSize,
+                true /* startsNALUnit */);
 
         data += 2 + nalSize;
         size -= 2 + nalSize;
@@ -212,7 +222,6 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
     uint32_t nri = (data[0] >> 5) & 3;
 
     uint32_t expectedSeqNo = (uint32_t)buffer->int32Data() + 1;
-    size_t totalSize = size - 2;
     size_t totalCount = 1;
     bool complete = false;
 
@@ -257,7 +266,6 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
                 return MALFORMED_PACKET;
             }
 
-            totalSize += size - 2;
             ++totalCount;
 
             expectedSeqNo = expectedSeqNo + 1;
@@ -280,16 +288,9 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
 
     // We found all the fragments that make up the complete NAL unit.
 
-    // Leave room for the header. So far totalSize did not include the
-    // header byte.
-    ++totalSize;
-
-    sp<ABuffer> unit = new ABuffer(totalSize);
-    CopyTimes(unit, *queue->begin());
+    // The fragments become the slices of the NAL unit as they are. The NAL
+    // header is rebuilt in place of the FU header of the first fragment.
 
-    unit->data()[0] = (nri << 5) | nalType;
-
-    size_t offset = 1;
     List<sp<ABuffer> >::iterator it = queue->begin();
     for (size_t i = 0; i < totalCount; ++i) {
         const sp<ABuffer> &buffer = *it;
@@ -299,45 +300,50 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
         hexdump(buffer->data(), buffer->size());
 #endif
 
-        memcpy(unit->data() + offset, buffer->data() + 2, buffer->size() - 2);
-        offset += buffer->size() - 2;
+        if (i == 0) {
+            buffer->data()[1] = (nri << 5) | nalType;
+            addNALSlice(
+                    buffer, 1, buffer->size() - 1, true /* startsNALUnit */);
+        } else {
+            addNALSlice(
+                    buffer, 2, buffer->size() - 2, false /* startsNALUnit */);
+        }
 
         it = queue->erase(it);
     }
 
-    unit->setRange(0, totalSize);
-
-    addSingleNALUnit(unit);
-
     ALOGV("successfully assembled a NAL unit from fragments.");
 
     return OK;
 }
 
 void AAVCAssembler::submitAccessUnit() {
-    CHECK(!mNALUnits.empty());
+    CHECK(!mNALSlices.empty());
 
-    ALOGV("Access unit complete (%d nal units)", mNALUnits.size());
+    ALOGV("Access unit complete (%d nal slices)", mNALSlices.size());
 
     size_t totalSize = 0;
-    for (List<sp<ABuffer> >::iterator it = mNALUnits.begin();
-         it != mNALUnits.end(); ++it) {
-        totalSize += 4 + (*it)->size();
+    for (List<NALSlice>::iterator it = mNALSlices.begin();
+         it != mNALSlices.end(); ++it) {
+        totalSize += ((*it).mStartsNALUnit ? 4 : 0) + (*it).mSize;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(totalSize);
-    size_t offset = 0;
-    for (List<sp<ABuffer> >::iterator it = mNALUnits.begin();
-         it != mNALUnits.end(); ++it) {
-        memcpy(accessUnit->data() + offset, "\x00\x00\x00\x01", 4);
-        offset += 4;
+    sp<ABuffer> accessUnit = ABuffer::CreatePooled(totalSize);
+    uint8_t *dst = accessUnit->data();
+    for (List<NALSlice>::iterator it = mNALSlices.begin();
+         it != mNALSlices.end(); ++it) {
+        const NALSlice &slice = *it;
+
+        if (slice.mStartsNALUnit) {
+            memcpy(dst, "\x00\x00\x00\x01", 4);
+            dst += 4;
+        }
 
-        sp<ABuffer> nal = *it;
-        memcpy(accessUnit->data() + offset, nal->data(), nal->size());
-        offset += nal->size();
+        memcpy(dst, slice.mBuffer->data() + slice.mOffset, slice.mSize);
+        dst += slice.mSize;
     }
 
-    CopyTimes(accessUnit, *mNALUnits.begin());
+    CopyTimes(accessUnit, (*mNALSlices.begin()).mBuffer);
 
 #if 0
     printf(mAccessUnitDamaged ? "X" : ".");
@@ -348,7 +354,7 @@ void AAVCAssembler::submitAccessUnit() {
         accessUnit->meta()->setInt32("damaged", true);
     }
 
-    mNALUnits.clear();
+    mNALSlices.clear();
     mAccessUnitDamaged = false;
 
     sp<AMessage> msg = mNotifyMsg->dup();
@@ -45,10 +45,22 @@ private:
     bool mNextExpectedSeqNoValid;
     uint32_t mNextExpectedSeqNo;
     bool mAccessUnitDamaged;
-    List<sp<ABuffer> > mNALUnits;
+
+    // The pieces of the NAL units of the current access unit, as ranges of
+    // the received packets. They are only copied once, in submitAccessUnit.
+    struct NALSlice {
+        sp<ABuffer> mBuffer;
+        size_t mOffset;
+        size_t mSize;
+        bool mStartsNALUnit;
+    };
+    List<NALSlice> mNALSlices;
 
     AssemblyStatus addNALUnit(const sp<ARTPSource> &source);
     void addSingleNALUnit(const sp<ABuffer> &buffer);
+    void addNALSlice(
+            const sp<ABuffer> &buffer, size_t offset, size_t size,
+            bool startsNALUnit);
     AssemblyStatus addFragmentedNALUnit(List<sp<ABuffer> > *queue);
     bool addSingleTimeAggregationPacket(const sp<ABuffer> &buffer);
 
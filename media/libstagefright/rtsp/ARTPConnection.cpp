@@ -32,11 +32,51 @@
 
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace android {
 
 static const size_t kMaxUDPSize = 1500;
 
+// RTP datagrams are read up to this many at a time, each into a slot of
+// the receive ring. Packetizers keep RTP datagrams within the path MTU,
+// anything larger than a slot is dropped.
+static const size_t kMaxRTPDatagramsPerReceive = 16;
+static const size_t kMaxRTPDatagramSize = 16384;
+
+// Same layout as the kernel's struct mmsghdr, which not every libc
+// declares.
+struct RTPMessageHeader {
+    struct msghdr mHeader;
+    unsigned int mLength;
+};
+
+// Reads up to "count" queued datagrams without blocking, using
+// recvmmsg where the kernel has it and one recvmsg per datagram
+// otherwise. Returns the number read, or -1 with errno set if none
+// could be.
+static int receiveDatagrams(int s, RTPMessageHeader *msgs, size_t count) {
+#ifdef __NR_recvmmsg
+    int res = syscall(__NR_recvmmsg, s, msgs, count, MSG_DONTWAIT, NULL);
+    if (res >= 0 || errno != ENOSYS) {
+        return res;
+    }
+#endif
+
+    size_t n = 0;
+    while (n < count) {
+        ssize_t nbytes = recvmsg(s, &msgs[n].mHeader, MSG_DONTWAIT);
+        if (nbytes < 0) {
+            return n > 0 ? (int)n : -1;
+        }
+
+        msgs[n++].mLength = nbytes;
+    }
+
+    return (int)n;
+}
+
 static uint16_t u16at(const uint8_t *data) {
     return data[0] << 8 | data[1];
 }
@@ -65,12 +105,17 @@ struct ARTPConnection::StreamInfo {
     struct sockaddr_in mRemoteRTCPAddr;
 
     bool mIsInjected;
+
+    // The source of the last packet, most streams only have one.
+    uint32_t mLastSourceID;
+    sp<ARTPSource> mLastSource;
 };
 
 ARTPConnection::ARTPConnection(uint32_t flags)
     : mFlags(flags),
       mPollEventPending(false),
       mLastReceiverReportTimeUs(-1) {
+    mReceiveRing.insertAt(sp<ABuffer>(), 0, kMaxRTPDatagramsPerReceive);
 }
 
 ARTPConnection::~ARTPConnection() {
@@ -204,6 +249,7 @@ void ARTPConnection::onAddStream(const sp<AMessage> &msg) {
     info->mNumRTCPPacketsReceived = 0;
     info->mNumRTPPacketsReceived = 0;
     memset(&info->mRemoteRTCPAddr, 0, sizeof(info->mRemoteRTCPAddr));
+    info->mLastSourceID = 0;
 
     if (!injected) {
         postPollEvent();
@@ -288,6 +334,10 @@ void ARTPConnection::onPollStreams() {
             status_t err = OK;
             if (FD_ISSET(it->mRTPSocket, &rs)) {
                 err = receive(&*it, true);
+
+                if (err == OK) {
+                    sendNACKs(&*it);
+                }
             }
             if (err == OK && FD_ISSET(it->mRTCPSocket, &rs)) {
                 err = receive(&*it, false);
@@ -370,12 +420,63 @@ void ARTPConnection::onPollStreams() {
     }
 }
 
+// Sends the NACKs of all sources of the stream right away, as a compound
+// packet behind the receiver reports.
+void ARTPConnection::sendNACKs(StreamInfo *s) {
+    if (s->mNumRTCPPacketsReceived == 0) {
+        // No idea where to send them yet.
+        return;
+    }
+
+    bool pending = false;
+    for (size_t i = 0; i < s->mSources.size(); ++i) {
+        if (s->mSources.valueAt(i)->hasPendingNACKs()) {
+            pending = true;
+            break;
+        }
+    }
+
+    if (!pending) {
+        return;
+    }
+
+    sp<ABuffer> buffer = new ABuffer(kMaxUDPSize);
+    buffer->setRange(0, 0);
+
+    for (size_t i = 0; i < s->mSources.size(); ++i) {
+        s->mSources.valueAt(i)->addReceiverReport(buffer);
+    }
+
+    for (size_t i = 0; i < s->mSources.size(); ++i) {
+        s->mSources.valueAt(i)->addNACK(buffer);
+    }
+
+    ALOGV("Sending NACK...");
+
+    ssize_t n;
+    do {
+        n = sendto(
+            s->mRTCPSocket, buffer->data(), buffer->size(), 0,
+            (const struct sockaddr *)&s->mRemoteRTCPAddr,
+            sizeof(s->mRemoteRTCPAddr));
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+        ALOGW("failed to send RTCP NACK (%s).",
+             n == 0 ? "connection gone" : strerror(errno));
+    }
+}
+
 status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
     ALOGV("receiving %s", receiveRTP ? "RTP" : "RTCP");
 
     CHECK(!s->mIsInjected);
 
-    sp<ABuffer> buffer = new ABuffer(65536);
+    if (receiveRTP) {
+        return receiveRTPDatagrams(s);
+    }
+
+    sp<ABuffer> buffer = ABuffer::CreatePooled(65536);
 
     socklen_t remoteAddrLen =
         (!receiveRTP && s->mNumRTCPPacketsReceived == 0)
@@ -410,6 +511,55 @@ status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
     return err;
 }
 
+status_t ARTPConnection::receiveRTPDatagrams(StreamInfo *s) {
+    RTPMessageHeader msgs[kMaxRTPDatagramsPerReceive];
+    struct iovec iov[kMaxRTPDatagramsPerReceive];
+
+    // Slots handed out with the previous batch are refilled from the
+    // buffer pool, the others are still empty.
+    for (size_t i = 0; i < kMaxRTPDatagramsPerReceive; ++i) {
+        sp<ABuffer> &buffer = mReceiveRing.editItemAt(i);
+        if (buffer == NULL) {
+            buffer = ABuffer::CreatePooled(kMaxRTPDatagramSize);
+        }
+
+        iov[i].iov_base = buffer->base();
+        iov[i].iov_len = buffer->capacity();
+
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].mHeader.msg_iov = &iov[i];
+        msgs[i].mHeader.msg_iovlen = 1;
+    }
+
+    int n;
+    do {
+        n = receiveDatagrams(
+                s->mRTPSocket, msgs, kMaxRTPDatagramsPerReceive);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? OK : -ECONNRESET;
+    }
+
+    ALOGV("received %d RTP datagrams.", n);
+
+    for (int i = 0; i < n; ++i) {
+        if (msgs[i].mHeader.msg_flags & MSG_TRUNC) {
+            ALOGW("dropping RTP datagram larger than %zu bytes.",
+                  kMaxRTPDatagramSize);
+            continue;
+        }
+
+        sp<ABuffer> buffer = mReceiveRing.itemAt(i);
+        mReceiveRing.editItemAt(i).clear();
+
+        buffer->setRange(0, msgs[i].mLength);
+        parseRTP(s, buffer);
+    }
+
+    return OK;
+}
+
 status_t ARTPConnection::parseRTP(StreamInfo *s, const sp<ABuffer> &buffer) {
     if (s->mNumRTPPacketsReceived++ == 0) {
         sp<AMessage> notify = s->mNotifyMsg->dup();
@@ -622,6 +772,10 @@ status_t ARTPConnection::parseSR(
 }
 
 sp<ARTPSource> ARTPConnection::findSource(StreamInfo *info, uint32_t srcId) {
+    if (info->mLastSource != NULL && info->mLastSourceID == srcId) {
+        return info->mLastSource;
+    }
+
     sp<ARTPSource> source;
     ssize_t index = info->mSources.indexOfKey(srcId);
     if (index < 0) {
@@ -635,6 +789,9 @@ sp<ARTPSource> ARTPConnection::findSource(StreamInfo *info, uint32_t srcId) {
         source = info->mSources.valueAt(index);
     }
 
+    info->mLastSourceID = srcId;
+    info->mLastSource = source;
+
     return source;
 }
 
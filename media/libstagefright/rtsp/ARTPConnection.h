@@ -20,6 +20,7 @@
 
 #include <media/stagefright/foundation/AHandler.h>
 #include <utils/List.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -72,6 +73,10 @@ private:
     bool mPollEventPending;
     int64_t mLastReceiverReportTimeUs;
 
+    // Receive slots for the next batch of RTP datagrams, a slot is
+    // emptied when its buffer is handed to the source.
+    Vector<sp<ABuffer> > mReceiveRing;
+
     void onAddStream(const sp<AMessage> &msg);
     void onRemoveStream(const sp<AMessage> &msg);
     void onPollStreams();
@@ -79,6 +84,8 @@ private:
     void onSendReceiverReports();
 
     status_t receive(StreamInfo *info, bool receiveRTP);
+    status_t receiveRTPDatagrams(StreamInfo *info);
+    void sendNACKs(StreamInfo *info);
 
     status_t parseRTP(StreamInfo *info, const sp<ABuffer> &buffer);
     status_t parseRTCP(StreamInfo *info, const sp<ABuffer> &buffer);
@@ -37,6 +37,17 @@ namespace android {
 
 static const uint32_t kSourceID = 0xdeadbeef;
 
+// Gaps larger than this are an outage rather than loss, they aren't NACK'ed.
+static const uint32_t kMaxNACKGap = 64;
+
+// Lost packets waiting for a NACK beyond this are too old to ask for.
+static const size_t kMaxPendingNACKs = 256;
+
+// Assemblers wait kMinLossTimeoutUs plus a few times the jitter for a
+// missing packet, up to kMaxLossTimeoutUs.
+static const int64_t kMinLossTimeoutUs = 10000ll;
+static const int64_t kMaxLossTimeoutUs = 200000ll;
+
 ARTPSource::ARTPSource(
         uint32_t id,
         const sp<ASessionDescription> &sessionDesc, size_t index,
@@ -44,6 +55,14 @@ ARTPSource::ARTPSource(
     : mID(id),
       mHighestSeqNumber(0),
       mNumBuffersReceived(0),
+      mBaseSeqNumber(0),
+      mExpectedPrior(0),
+      mReceivedPrior(0),
+      mClockRate(0),
+      mLastTransitValid(false),
+      mLastTransit(0),
+      mJitter(0),
+      mIssueNACKs(false),
       mLastNTPTime(0),
       mLastNTPTimeUpdateUs(0),
       mIssueFIRRequests(false),
@@ -55,6 +74,18 @@ ARTPSource::ARTPSource(
     AString params;
     sessionDesc->getFormatType(index, &PT, &desc, &params);
 
+    memset(mReceivedMask, 0, sizeof(mReceivedMask));
+
+    int32_t numChannels;
+    ASessionDescription::ParseFormatDesc(
+            desc.c_str(), &mClockRate, &numChannels);
+
+    AString feedback;
+    if (sessionDesc->findAttribute(index, "a=rtcp-fb", &feedback)
+            && strstr(feedback.c_str(), "nack") != NULL) {
+        mIssueNACKs = true;
+    }
+
     if (!strncmp(desc.c_str(), "H264/", 5)) {
         mAssembler = new AAVCAssembler(notify);
         mIssueFIRRequests = true;
@@ -86,6 +117,8 @@ static uint32_t AbsDiff(uint32_t seq1, uint32_t seq2) {
 }
 
 void ARTPSource::processRTPPacket(const sp<ABuffer> &buffer) {
+    updateJitter(buffer);
+
     if (queuePacket(buffer) && mAssembler != NULL) {
         mAssembler->onPacketReceived(this);
     }
@@ -107,6 +140,8 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
 
     if (mNumBuffersReceived++ == 0) {
         mHighestSeqNumber = seqNum;
+        mBaseSeqNumber = seqNum;
+        markReceived(seqNum);
         mQueue.push_back(buffer);
         return true;
     }
@@ -138,20 +173,29 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
         seqNum = seq3;
     }
 
-    if (seqNum > mHighestSeqNumber) {
-        mHighestSeqNumber = seqNum;
+    if (!markReceived(seqNum)) {
+        ALOGW("Discarding duplicate buffer");
+        return false;
     }
 
     buffer->setInt32Data(seqNum);
 
-    List<sp<ABuffer> >::iterator it = mQueue.begin();
-    while (it != mQueue.end() && (uint32_t)(*it)->int32Data() < seqNum) {
-        ++it;
-    }
+    // Packets mostly arrive in order or only slightly reordered, so the
+    // spot is found from the back of the queue.
+    List<sp<ABuffer> >::iterator it = mQueue.end();
+    while (it != mQueue.begin()) {
+        List<sp<ABuffer> >::iterator prev = it;
+        --prev;
+
+        uint32_t prevSeqNum = (uint32_t)(*prev)->int32Data();
+        if (prevSeqNum < seqNum) {
+            break;
+        } else if (prevSeqNum == seqNum) {
+            ALOGW("Discarding duplicate buffer");
+            return false;
+        }
 
-    if (it != mQueue.end() && (uint32_t)(*it)->int32Data() == seqNum) {
-        ALOGW("Discarding duplicate buffer");
-        return false;
+        it = prev;
     }
 
     mQueue.insert(it, buffer);
@@ -159,6 +203,92 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
     return true;
 }
 
+// Returns false for a duplicate within the receive window. Advances the
+// highest sequence number and records the packets skipped over as lost.
+bool ARTPSource::markReceived(uint32_t seqNum) {
+    if (seqNum > mHighestSeqNumber) {
+        uint32_t gap = seqNum - mHighestSeqNumber;
+
+        if (gap >= kReceiveWindow) {
+            memset(mReceivedMask, 0, sizeof(mReceivedMask));
+        } else {
+            for (uint32_t i = mHighestSeqNumber + 1; i != seqNum; ++i) {
+                mReceivedMask[(i % kReceiveWindow) / 32] &=
+                    ~(1u << (i % 32));
+            }
+        }
+
+        if (mIssueNACKs && gap > 1 && gap <= kMaxNACKGap) {
+            for (uint32_t i = mHighestSeqNumber + 1; i != seqNum; ++i) {
+                mLostSeqNumbers.push(i);
+            }
+
+            if (mLostSeqNumbers.size() > kMaxPendingNACKs) {
+                mLostSeqNumbers.removeItemsAt(
+                        0, mLostSeqNumbers.size() - kMaxPendingNACKs);
+            }
+        }
+
+        mHighestSeqNumber = seqNum;
+    } else if (mHighestSeqNumber - seqNum < kReceiveWindow) {
+        if (mReceivedMask[(seqNum % kReceiveWindow) / 32]
+                & (1u << (seqNum % 32))) {
+            return false;
+        }
+
+        // Late rather than lost.
+        for (size_t i = 0; i < mLostSeqNumbers.size(); ++i) {
+            if (mLostSeqNumbers.itemAt(i) == seqNum) {
+                mLostSeqNumbers.removeAt(i);
+                break;
+            }
+        }
+    } else {
+        // Too old to tell, the queue catches duplicates.
+        return true;
+    }
+
+    mReceivedMask[(seqNum % kReceiveWindow) / 32] |= 1u << (seqNum % 32);
+
+    return true;
+}
+
+void ARTPSource::updateJitter(const sp<ABuffer> &buffer) {
+    uint32_t rtpTime;
+    if (mClockRate <= 0
+            || !buffer->meta()->findInt32("rtp-time", (int32_t *)&rtpTime)) {
+        return;
+    }
+
+    uint32_t arrival = (uint32_t)
+        ((ALooper::GetNowUs() * mClockRate) / 1000000ll);
+
+    int32_t transit = (int32_t)(arrival - rtpTime);
+
+    if (mLastTransitValid) {
+        int32_t d = transit - mLastTransit;
+        if (d < 0) {
+            d = -d;
+        }
+
+        mJitter += d - ((mJitter + 8) >> 4);
+    }
+
+    mLastTransit = transit;
+    mLastTransitValid = true;
+}
+
+int64_t ARTPSource::lossTimeoutUs() const {
+    if (mClockRate <= 0) {
+        return kMinLossTimeoutUs;
+    }
+
+    int64_t jitterUs = ((int64_t)(mJitter >> 4) * 1000000ll) / mClockRate;
+    int64_t timeoutUs = kMinLossTimeoutUs + 4 * jitterUs;
+
+    return timeoutUs < kMaxLossTimeoutUs ? timeoutUs : kMaxLossTimeoutUs;
+}
+
 void ARTPSource::byeReceived() {
     mAssembler->onByeReceived();
 }
@@ -235,21 +365,45 @@ void ARTPSource::addReceiverReport(const sp<ABuffer> &buffer) {
     data[10] = (mID >> 8) & 0xff;
     data[11] = mID & 0xff;
 
-    data[12] = 0x00;  // fraction lost
+    uint32_t expected = mHighestSeqNumber - mBaseSeqNumber + 1;
+    int32_t lost = (int32_t)(expected - (uint32_t)mNumBuffersReceived);
+    if (mNumBuffersReceived == 0) {
+        expected = 0;
+        lost = 0;
+    } else if (lost > 0x7fffff) {
+        lost = 0x7fffff;
+    } else if (lost < -0x800000) {
+        lost = -0x800000;
+    }
+
+    uint32_t expectedInterval = expected - mExpectedPrior;
+    int32_t receivedInterval = mNumBuffersReceived - mReceivedPrior;
+    int32_t lostInterval = (int32_t)expectedInterval - receivedInterval;
+    mExpectedPrior = expected;
+    mReceivedPrior = mNumBuffersReceived;
+
+    uint8_t fraction = 0;
+    if (expectedInterval > 0 && lostInterval > 0) {
+        fraction = (lostInterval << 8) / expectedInterval;
+    }
+
+    data[12] = fraction;  // fraction lost
 
-    data[13] = 0x00;  // cumulative lost
-    data[14] = 0x00;
-    data[15] = 0x00;
+    data[13] = (lost >> 16) & 0xff;  // cumulative lost
+    data[14] = (lost >> 8) & 0xff;
+    data[15] = lost & 0xff;
 
     data[16] = mHighestSeqNumber >> 24;
     data[17] = (mHighestSeqNumber >> 16) & 0xff;
     data[18] = (mHighestSeqNumber >> 8) & 0xff;
     data[19] = mHighestSeqNumber & 0xff;
 
-    data[20] = 0x00;  // Interarrival jitter
-    data[21] = 0x00;
-    data[22] = 0x00;
-    data[23] = 0x00;
+    uint32_t jitter = mJitter >> 4;
+
+    data[20] = jitter >> 24;  // Interarrival jitter
+    data[21] = (jitter >> 16) & 0xff;
+    data[22] = (jitter >> 8) & 0xff;
+    data[23] = jitter & 0xff;
 
     uint32_t LSR = 0;
     uint32_t DLSR = 0;
@@ -273,6 +427,63 @@ void ARTPSource::addReceiverReport(const sp<ABuffer> &buffer) {
     buffer->setRange(buffer->offset(), buffer->size() + 32);
 }
 
-}  // namespace android
+bool ARTPSource::hasPendingNACKs() const {
+    return !mLostSeqNumbers.isEmpty();
+}
+
+void ARTPSource::addNACK(const sp<ABuffer> &buffer) {
+    if (mLostSeqNumbers.isEmpty()) {
+        return;
+    }
+
+    if (buffer->size() + 16 > buffer->capacity()) {
+        ALOGW("RTCP buffer too small to accomodate NACK.");
+        return;
+    }
 
+    uint8_t *data = buffer->data() + buffer->size();
+
+    data[0] = 0x80 | 1;  // Generic NACK
+    data[1] = 205;  // RTPFB
+    data[4] = kSourceID >> 24;
+    data[5] = (kSourceID >> 16) & 0xff;
+    data[6] = (kSourceID >> 8) & 0xff;
+    data[7] = kSourceID & 0xff;
+
+    data[8] = mID >> 24;
+    data[9] = (mID >> 16) & 0xff;
+    data[10] = (mID >> 8) & 0xff;
+    data[11] = mID & 0xff;
 
+    // Each entry covers a lost packet (PID) and the 16 after it (BLP),
+    // the lost sequence numbers were recorded in increasing order.
+    size_t size = 12;
+    size_t i = 0;
+    while (i < mLostSeqNumbers.size()
+            && buffer->size() + size + 4 <= buffer->capacity()) {
+        uint32_t pid = mLostSeqNumbers.itemAt(i++);
+        uint16_t blp = 0;
+
+        while (i < mLostSeqNumbers.size()
+                && mLostSeqNumbers.itemAt(i) - pid <= 16) {
+            blp |= 1 << (mLostSeqNumbers.itemAt(i++) - pid - 1);
+        }
+
+        data[size] = (pid >> 8) & 0xff;
+        data[size + 1] = pid & 0xff;
+        data[size + 2] = blp >> 8;
+        data[size + 3] = blp & 0xff;
+        size += 4;
+    }
+
+    data[2] = 0;
+    data[3] = size / 4 - 1;
+
+    buffer->setRange(buffer->offset(), buffer->size() + size);
+
+    ALOGV("Added NACK for %d lost packets.", i);
+
+    mLostSeqNumbers.clear();
+}
+
+}  // namespace android
@@ -23,6 +23,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -46,11 +47,40 @@ struct ARTPSource : public RefBase {
     void addReceiverReport(const sp<ABuffer> &buffer);
     void addFIR(const sp<ABuffer> &buffer);
 
+    // Generic NACKs (RFC 4585) for the packets found missing since the
+    // last call, if the session description allows them.
+    bool hasPendingNACKs() const;
+    void addNACK(const sp<ABuffer> &buffer);
+
+    // How long assemblers wait for a missing packet before they declare
+    // it lost, derived from the interarrival jitter.
+    int64_t lossTimeoutUs() const;
+
 private:
+    enum {
+        // Sequence numbers within this distance of the highest one are
+        // tracked in mReceivedMask.
+        kReceiveWindow = 1024,
+    };
+
     uint32_t mID;
     uint32_t mHighestSeqNumber;
     int32_t mNumBuffersReceived;
 
+    // Receiver report statistics, see RFC 3550 A.3 and A.8.
+    uint32_t mBaseSeqNumber;
+    uint32_t mExpectedPrior;
+    int32_t mReceivedPrior;
+    int32_t mClockRate;
+    bool mLastTransitValid;
+    int32_t mLastTransit;
+    uint32_t mJitter;  // in RTP time units, times 16
+
+    uint32_t mReceivedMask[kReceiveWindow / 32];
+
+    bool mIssueNACKs;
+    Vector<uint32_t> mLostSeqNumbers;
+
     List<sp<ABuffer> > mQueue;
     sp<ARTPAssembler> mAssembler;
 
@@ -64,6 +94,8 @@ private:
     sp<AMessage> mNotify;
 
     bool queuePacket(const sp<ABuffer> &buffer);
+    bool markReceived(uint32_t seqNum);
+    void updateJitter(const sp<ABuffer> &buffer);
 
     DISALLOW_EVIL_CONSTRUCTORS(ARTPSource);
 };
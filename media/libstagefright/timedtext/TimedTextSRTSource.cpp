@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include <binder/Parcel.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>  // for CHECK_xx
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/DataSource.h>
@@ -32,6 +33,9 @@
 
 namespace android {
 
+// Anything larger is not a subtitle file.
+static const size_t kMaxFileSize = 16 * 1024 * 1024;
+
 TimedTextSRTSource::TimedTextSRTSource(const sp<DataSource>& dataSource)
         : mSource(dataSource),
           mMetaData(new MetaData),
@@ -45,7 +49,10 @@ TimedTextSRTSource::~TimedTextSRTSource() {
 }
 
 status_t TimedTextSRTSource::start() {
-    status_t err = scanFile();
+    status_t err = loadFile();
+    if (err == OK) {
+        err = scanFile();
+    }
     if (err != OK) {
         reset();
     }
@@ -55,6 +62,7 @@ status_t TimedTextSRTSource::start() {
 void TimedTextSRTSource::reset() {
     mTextVector.clear();
     mIndex = 0;
+    mFileData.clear();
 }
 
 status_t TimedTextSRTSource::stop() {
@@ -82,6 +90,59 @@ sp<MetaData> TimedTextSRTSource::getFormat() {
     return mMetaData;
 }
 
+status_t TimedTextSRTSource::loadFile() {
+    off64_t fileSize;
+    bool sizeKnown = false;
+    size_t capacity = 4096;
+    if (mSource->getSize(&fileSize) == OK) {
+        if (fileSize > (off64_t)kMaxFileSize) {
+            ALOGE("subtitle file too large (%lld bytes)", fileSize);
+            return ERROR_MALFORMED;
+        }
+        sizeKnown = true;
+        capacity = fileSize;
+    }
+
+    sp<ABuffer> data = new ABuffer(capacity);
+    data->setRange(0, 0);
+
+    for (;;) {
+        if (data->size() == data->capacity()) {
+            if (sizeKnown) {
+                // The buffer holds exactly the file, no need to look further.
+                break;
+            }
+
+            if (data->capacity() >= kMaxFileSize) {
+                ALOGE("subtitle file too large");
+                return ERROR_MALFORMED;
+            }
+
+            // The size is unknown, check for more.
+            sp<ABuffer> larger = new ABuffer(2 * data->capacity() + 1);
+            memcpy(larger->data(), data->data(), data->size());
+            larger->setRange(0, data->size());
+            data = larger;
+        }
+
+        ssize_t n = mSource->readAt(
+                data->size(),
+                data->data() + data->size(),
+                data->capacity() - data->size());
+
+        if (n < 0) {
+            return ERROR_IO;
+        } else if (n == 0) {
+            break;
+        }
+
+        data->setRange(0, data->size() + n);
+    }
+
+    mFileData = data;
+    return OK;
+}
+
 status_t TimedTextSRTSource::scanFile() {
     off64_t offset = 0;
     int64_t startTimeUs;
@@ -176,37 +237,35 @@ status_t TimedTextSRTSource::getNextSubtitleInfo(
 
 status_t TimedTextSRTSource::readNextLine(off64_t *offset, AString *data) {
     data->clear();
-    while (true) {
-        ssize_t readSize;
-        char character;
-        if ((readSize = mSource->readAt(*offset, &character, 1)) < 1) {
-            if (readSize == 0) {
-                return ERROR_END_OF_STREAM;
-            }
-            return ERROR_IO;
-        }
 
-        (*offset)++;
+    const char *text = (const char *)mFileData->data();
+    size_t size = mFileData->size();
 
-        // a line could end with CR, LF or CR + LF
-        if (character == 10) {
-            break;
-        } else if (character == 13) {
-            if ((readSize = mSource->readAt(*offset, &character, 1)) < 1) {
-                if (readSize == 0) {  // end of the stream
-                    return OK;
-                }
-                return ERROR_IO;
-            }
+    if ((size_t)*offset >= size) {
+        return ERROR_END_OF_STREAM;
+    }
 
-            (*offset)++;
-            if (character != 10) {
-                (*offset)--;
-            }
-            break;
-        }
-        data->append(character);
+    size_t start = *offset;
+    size_t end = start;
+
+    // a line could end with CR, LF or CR + LF
+    while (end < size && text[end] != 10 && text[end] != 13) {
+        ++end;
+    }
+
+    data->setTo(&text[start], end - start);
+
+    if (end == size) {
+        // An unterminated last line ends the stream, as it always has.
+        *offset = end;
+        return ERROR_END_OF_STREAM;
     }
+
+    if (text[end] == 13 && end + 1 < size && text[end + 1] == 10) {
+        ++end;
+    }
+
+    *offset = end + 1;
     return OK;
 }
 
@@ -256,13 +315,10 @@ status_t TimedTextSRTSource::getText(
     *endTimeUs = info.endTimeUs;
     mIndex++;
 
-    char *str = new char[info.textLen];
-    if (mSource->readAt(info.offset, str, info.textLen) < info.textLen) {
-        delete[] str;
+    if (info.offset + info.textLen > (off64_t)mFileData->size()) {
         return ERROR_IO;
     }
-    text->append(str, info.textLen);
-    delete[] str;
+    text->setTo((const char *)mFileData->data() + info.offset, info.textLen);
     return OK;
 }
 
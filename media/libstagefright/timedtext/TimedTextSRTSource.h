@@ -25,6 +25,7 @@
 
 namespace android {
 
+struct ABuffer;
 class AString;
 class DataSource;
 class MediaBuffer;
@@ -49,6 +50,10 @@ private:
     sp<DataSource> mSource;
     sp<MetaData> mMetaData;
 
+    // The whole file, read once by start(). Subtitle files are small, and
+    // scanning and reading them byte by byte from mSource is not.
+    sp<ABuffer> mFileData;
+
     struct TextInfo {
         int64_t endTimeUs;
         // The offset of the text in the original file.
@@ -60,6 +65,7 @@ private:
     KeyedVector<int64_t, TextInfo> mTextVector;
 
     void reset();
+    status_t loadFile();
     status_t scanFile();
     status_t getNextSubtitleInfo(
             off64_t *offset, int64_t *startTimeUs, TextInfo *info);
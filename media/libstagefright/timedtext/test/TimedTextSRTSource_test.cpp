@@ -220,5 +220,31 @@ TEST_F(TimedTextSRTSourceTest, checkEdgeCase) {
     CheckDataEquals(parcel, subtitle.c_str());
 }
 
+TEST_F(TimedTextSRTSourceTest, crlfLineEndings) {
+    static const char *kCRLFString =
+        "1\r\n00:00:1,000 --> 00:00:1,500\r\nA\r\n\r\n"
+        "2\r\n00:00:2,000 --> 00:00:2,500\r\nB\r\n";
+
+    sp<TimedTextSource> source = new TimedTextSRTSource(
+            new SRTDataSourceStub(kCRLFString, strlen(kCRLFString)));
+    EXPECT_EQ(OK, source->start());
+
+    Parcel first;
+    err = source->read(&startTimeUs, &endTimeUs, &first);
+    EXPECT_EQ(OK, err);
+    CheckStartTimeMs(first, 1000);
+    CheckDataEquals(first, "A\r\n\r\n");
+
+    Parcel second;
+    err = source->read(&startTimeUs, &endTimeUs, &second);
+    EXPECT_EQ(OK, err);
+    CheckStartTimeMs(second, 2000);
+    CheckDataEquals(second, "B\r\n");
+
+    Parcel third;
+    err = source->read(&startTimeUs, &endTimeUs, &third);
+    EXPECT_EQ(ERROR_END_OF_STREAM, err);
+}
+
 }  // namespace test
 }  // namespace android
@@ -43,6 +43,8 @@ MediaSender::MediaSender(
       mMode(MODE_UNDEFINED),
       mGeneration(0),
       mPrevTimeUs(-1ll),
+      mNextSinkID(1),
+      mPacingRate(0),
       mInitDoneCount(0),
       mLogFile(NULL) {
     // mLogFile = fopen("/data/misc/log.ts", "wb");
@@ -125,6 +127,7 @@ status_t MediaSender::initAsync(
             notify->setInt32("generation", mGeneration);
             mTSSender = new RTPSender(mNetSession, notify);
             looper()->registerHandler(mTSSender);
+            mTSSender->setPacingRate(mPacingRate);
 
             err = mTSSender->initAsync(
                     remoteHost,
@@ -177,6 +180,10 @@ status_t MediaSender::initAsync(
     info->mSender = new RTPSender(mNetSession, notify);
     looper()->registerHandler(info->mSender);
 
+    if (!info->mIsAudio) {
+        info->mSender->setPacingRate(mPacingRate);
+    }
+
     status_t err = info->mSender->initAsync(
             remoteHost,
             remoteRTPPort,
@@ -213,10 +220,15 @@ status_t MediaSender::queueAccessUnit(
 
     if (mMode == MODE_TRANSPORT_STREAM) {
         TrackInfo *info = &mTrackInfos.editItemAt(trackIndex);
-        info->mAccessUnits.push_back(accessUnit);
 
         mTSPacketizer->extractCSDIfNecessary(info->mPacketizerTrackIndex);
 
+        if (info->mFlags & FLAG_LOW_LATENCY) {
+            return sendTSAccessUnit(trackIndex, accessUnit);
+        }
+
+        info->mAccessUnits.push_back(accessUnit);
+
         for (;;) {
             ssize_t minTrackIndex = -1;
             int64_t minTimeUs = -1ll;
@@ -224,6 +236,10 @@ status_t MediaSender::queueAccessUnit(
             for (size_t i = 0; i < mTrackInfos.size(); ++i) {
                 const TrackInfo &info = mTrackInfos.itemAt(i);
 
+                if (info.mFlags & FLAG_LOW_LATENCY) {
+                    continue;
+                }
+
                 if (info.mAccessUnits.empty()) {
                     minTrackIndex = -1;
                     minTimeUs = -1ll;
@@ -248,24 +264,7 @@ status_t MediaSender::queueAccessUnit(
             sp<ABuffer> accessUnit = *info->mAccessUnits.begin();
             info->mAccessUnits.erase(info->mAccessUnits.begin());
 
-            sp<ABuffer> tsPackets;
-            status_t err = packetizeAccessUnit(
-                    minTrackIndex, accessUnit, &tsPackets);
-
-            if (err == OK) {
-                if (mLogFile != NULL) {
-                    fwrite(tsPackets->data(), 1, tsPackets->size(), mLogFile);
-                }
-
-                int64_t timeUs;
-                CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
-                tsPackets->meta()->setInt64("timeUs", timeUs);
-
-                err = mTSSender->queueBuffer(
-                        tsPackets,
-                        33 /* packetType */,
-                        RTPSender::PACKETIZATION_TRANSPORT_STREAM);
-            }
+            status_t err = sendTSAccessUnit(minTrackIndex, accessUnit);
 
             if (err != OK) {
                 return err;
@@ -282,6 +281,82 @@ status_t MediaSender::queueAccessUnit(
                 ? RTPSender::PACKETIZATION_AAC : RTPSender::PACKETIZATION_H264);
 }
 
+ssize_t MediaSender::addSinkAsync(
+        const char *remoteHost,
+        int32_t remoteRTPPort,
+        RTPSender::TransportMode rtpMode,
+        int32_t remoteRTCPPort,
+        RTPSender::TransportMode rtcpMode,
+        int32_t *localRTPPort) {
+    // The stream is encrypted for the primary sink only.
+    if (mMode != MODE_TRANSPORT_STREAM || mHDCP != NULL) {
+        return INVALID_OPERATION;
+    }
+
+    int32_t sinkID = mNextSinkID++;
+
+    sp<AMessage> notify = new AMessage(kWhatSenderNotify, id());
+    notify->setInt32("generation", mGeneration);
+    notify->setInt32("sinkID", sinkID);
+
+    sp<RTPSender> sender = new RTPSender(mNetSession, notify);
+    looper()->registerHandler(sender);
+    sender->setPacingRate(mPacingRate);
+
+    status_t err = sender->initAsync(
+            remoteHost,
+            remoteRTPPort,
+            rtpMode,
+            remoteRTCPPort,
+            rtcpMode,
+            localRTPPort);
+
+    if (err != OK) {
+        looper()->unregisterHandler(sender->id());
+        return err;
+    }
+
+    mExtraTSSenders.add(sinkID, sender);
+
+    ALOGI("added sink %d at %s:%d", sinkID, remoteHost, remoteRTPPort);
+
+    return sinkID;
+}
+
+status_t MediaSender::removeSink(int32_t sinkID) {
+    ssize_t index = mExtraTSSenders.indexOfKey(sinkID);
+    if (index < 0) {
+        return -ENOENT;
+    }
+
+    looper()->unregisterHandler(mExtraTSSenders.valueAt(index)->id());
+    mExtraTSSenders.removeItemsAt(index);
+
+    ALOGI("removed sink %d", sinkID);
+
+    return OK;
+}
+
+void MediaSender::setPacingRate(int32_t bitsPerSecond) {
+    mPacingRate = bitsPerSecond;
+
+    if (mTSSender != NULL) {
+        mTSSender->setPacingRate(mPacingRate);
+    }
+
+    for (size_t i = 0; i < mExtraTSSenders.size(); ++i) {
+        mExtraTSSenders.valueAt(i)->setPacingRate(mPacingRate);
+    }
+
+    for (size_t i = 0; i < mTrackInfos.size(); ++i) {
+        const TrackInfo &info = mTrackInfos.itemAt(i);
+
+        if (!info.mIsAudio && info.mSender != NULL) {
+            info.mSender->setPacingRate(mPacingRate);
+        }
+    }
+}
+
 void MediaSender::onMessageReceived(const sp<AMessage> &msg) {
     switch (msg->what()) {
         case kWhatSenderNotify:
@@ -302,6 +377,12 @@ void MediaSender::onMessageReceived(const sp<AMessage> &msg) {
 }
 
 void MediaSender::onSenderNotify(const sp<AMessage> &msg) {
+    int32_t sinkID;
+    if (msg->findInt32("sinkID", &sinkID)) {
+        onExtraSinkNotify(sinkID, msg);
+        return;
+    }
+
     int32_t what;
     CHECK(msg->findInt32("what", &what));
 
@@ -343,6 +424,34 @@ void MediaSender::onSenderNotify(const sp<AMessage> &msg) {
             break;
         }
 
+        case RTPSender::kWhatReceiverReport:
+        {
+            int32_t fractionLost;
+            CHECK(msg->findInt32("fractionLost", &fractionLost));
+
+            sp<AMessage> notify = mNotify->dup();
+            notify->setInt32("what", kWhatReceiverReport);
+            notify->setInt32("fractionLost", fractionLost);
+            notify->post();
+            break;
+        }
+
+        case RTPSender::kWhatSendLatency:
+        {
+            int64_t avgLatencyUs;
+            CHECK(msg->findInt64("avgLatencyUs", &avgLatencyUs));
+
+            int64_t maxLatencyUs;
+            CHECK(msg->findInt64("maxLatencyUs", &maxLatencyUs));
+
+            sp<AMessage> notify = mNotify->dup();
+            notify->setInt32("what", kWhatSendLatency);
+            notify->setInt64("avgLatencyUs", avgLatencyUs);
+            notify->setInt64("maxLatencyUs", maxLatencyUs);
+            notify->post();
+            break;
+        }
+
         case kWhatInformSender:
         {
             int64_t avgLatencyUs;
@@ -364,6 +473,23 @@ void MediaSender::onSenderNotify(const sp<AMessage> &msg) {
     }
 }
 
+void MediaSender::onExtraSinkNotify(
+        int32_t sinkID, const sp<AMessage> &msg) {
+    if (mExtraTSSenders.indexOfKey(sinkID) < 0) {
+        return;
+    }
+
+    int32_t what;
+    CHECK(msg->findInt32("what", &what));
+
+    int32_t err;
+    if ((what == RTPSender::kWhatInitDone || what == RTPSender::kWhatError)
+            && msg->findInt32("err", &err) && err != OK) {
+        ALOGW("sink %d failed (err %d), dropping it.", sinkID, err);
+        removeSink(sinkID);
+    }
+}
+
 void MediaSender::notifyInitDone(status_t err) {
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", kWhatInitDone);
@@ -385,6 +511,78 @@ void MediaSender::notifyNetworkStall(size_t numBytesQueued) {
     notify->post();
 }
 
+status_t MediaSender::sendTSAccessUnit(
+        size_t trackIndex, const sp<ABuffer> &accessUnit) {
+    sp<ABuffer> tsPackets;
+    status_t err = packetizeAccessUnit(trackIndex, accessUnit, &tsPackets);
+
+    if (err != OK) {
+        return err;
+    }
+
+    if (mLogFile != NULL) {
+        // Leave out the room reserved for the RTP headers.
+        static const size_t kRunSize =
+            TSPacketizer::kRTPHeaderSize
+                + TSPacketizer::kNumTSPacketsPerRTPPacket * 188;
+
+        for (size_t offset = 0; offset < tsPackets->size();
+                offset += kRunSize) {
+            size_t size = tsPackets->size() - offset;
+            if (size > kRunSize) {
+                size = kRunSize;
+            }
+
+            fwrite(tsPackets->data() + offset + TSPacketizer::kRTPHeaderSize,
+                   1,
+                   size - TSPacketizer::kRTPHeaderSize,
+                   mLogFile);
+        }
+    }
+
+    int64_t timeUs;
+    CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
+    tsPackets->meta()->setInt64("timeUs", timeUs);
+
+    // Only the video timestamps are on the capture clock.
+    tsPackets->meta()->setInt32(
+            "latency-tracked", !mTrackInfos.itemAt(trackIndex).mIsAudio);
+
+    // Audio is small and the sink has little of it buffered, don't let it
+    // wait behind a large video frame.
+    tsPackets->meta()->setInt32(
+            "high-priority", mTrackInfos.itemAt(trackIndex).mIsAudio);
+
+    err = mTSSender->queueBuffer(
+            tsPackets,
+            33 /* packetType */,
+            RTPSender::PACKETIZATION_TRANSPORT_STREAM);
+
+    if (err != OK || mExtraTSSenders.isEmpty()) {
+        return err;
+    }
+
+    // The primary sender has written its RTP headers into the buffer, the
+    // others must leave it alone.
+    tsPackets->meta()->setInt32("shared", true);
+
+    for (size_t i = mExtraTSSenders.size(); i-- > 0;) {
+        status_t sinkErr = mExtraTSSenders.valueAt(i)->queueBuffer(
+                tsPackets,
+                33 /* packetType */,
+                RTPSender::PACKETIZATION_TRANSPORT_STREAM);
+
+        if (sinkErr != OK) {
+            ALOGW("sink %d failed (err %d), dropping it.",
+                  mExtraTSSenders.keyAt(i), sinkErr);
+
+            removeSink(mExtraTSSenders.keyAt(i));
+        }
+    }
+
+    return OK;
+}
+
 status_t MediaSender::packetizeAccessUnit(
         size_t trackIndex,
         sp<ABuffer> accessUnit,
@@ -397,9 +595,17 @@ status_t MediaSender::packetizeAccessUnit(
     uint64_t inputCTR;
     uint8_t HDCP_private_data[16];
 
+    // The later slices of a frame sent slice by slice don't get the
+    // SPS and PPS again.
+    int32_t continuesFrame;
+    if (!accessUnit->meta()->findInt32("continues-frame", &continuesFrame)) {
+        continuesFrame = false;
+    }
+
     bool manuallyPrependSPSPPS =
         !info.mIsAudio
         && (info.mFlags & FLAG_MANUALLY_PREPEND_SPS_PPS)
+        && !continuesFrame
         && IsIDR(accessUnit);
 
     if (mHDCP != NULL && !info.mIsAudio) {
@@ -493,6 +699,9 @@ status_t MediaSender::packetizeAccessUnit(
         flags |= TSPacketizer::PREPEND_SPS_PPS_TO_IDR_FRAMES;
     }
 
+    // RTPSender sends the runs of TS packets as they are.
+    flags |= TSPacketizer::RESERVE_RTP_HEADERS;
+
     int64_t timeUs = ALooper::GetNowUs();
     if (mPrevTimeUs < 0ll || mPrevTimeUs + 100000ll <= timeUs) {
         flags |= TSPacketizer::EMIT_PCR;
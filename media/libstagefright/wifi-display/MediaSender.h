@@ -23,6 +23,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/AHandler.h>
 #include <utils/Errors.h>
+#include <utils/KeyedVector.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -44,6 +45,13 @@ struct MediaSender : public AHandler {
         kWhatError,
         kWhatNetworkStall,
         kWhatInformSender,
+
+        // Average and maximum time from the capture of the video access
+        // units to their RTP packets being written to the socket.
+        kWhatSendLatency,
+
+        // The "fractionLost" of an RTCP report from the sink, in 1/256.
+        kWhatReceiverReport,
     };
 
     MediaSender(
@@ -54,6 +62,11 @@ struct MediaSender : public AHandler {
 
     enum FlagBits {
         FLAG_MANUALLY_PREPEND_SPS_PPS = 1,
+
+        // In transport stream mode, access units of the track are sent as
+        // soon as they arrive instead of being interleaved with the other
+        // tracks' by time.
+        FLAG_LOW_LATENCY              = 2,
     };
     ssize_t addTrack(const sp<AMessage> &format, uint32_t flags);
 
@@ -70,6 +83,26 @@ struct MediaSender : public AHandler {
     status_t queueAccessUnit(
             size_t trackIndex, const sp<ABuffer> &accessUnit);
 
+    // In transport stream mode, also sends the stream to another sink over
+    // its own RTP session. Packetization (and encoding) is shared with the
+    // primary sink, each sink only gets its own RTP headers. The extra sinks
+    // don't feed back into rate control, an error on one removes just that
+    // sink. Returns the sink's id.
+    ssize_t addSinkAsync(
+            const char *remoteHost,
+            int32_t remoteRTPPort,
+            RTPSender::TransportMode rtpMode,
+            int32_t remoteRTCPPort,
+            RTPSender::TransportMode rtcpMode,
+            int32_t *localRTPPort);
+
+    status_t removeSink(int32_t sinkID);
+
+    // Paces the RTP packets of the video (and in transport stream mode the
+    // muxed audio, which goes first) at "bitsPerSecond", 0 disables pacing.
+    // See RTPSender::setPacingRate().
+    void setPacingRate(int32_t bitsPerSecond);
+
 protected:
     virtual void onMessageReceived(const sp<AMessage> &msg);
     virtual ~MediaSender();
@@ -108,11 +141,17 @@ private:
     sp<RTPSender> mTSSender;
     int64_t mPrevTimeUs;
 
+    KeyedVector<int32_t, sp<RTPSender> > mExtraTSSenders;
+    int32_t mNextSinkID;
+
+    int32_t mPacingRate;
+
     size_t mInitDoneCount;
 
     FILE *mLogFile;
 
     void onSenderNotify(const sp<AMessage> &msg);
+    void onExtraSinkNotify(int32_t sinkID, const sp<AMessage> &msg);
 
     void notifyInitDone(status_t err);
     void notifyError(status_t err);
@@ -123,6 +162,8 @@ private:
             sp<ABuffer> accessUnit,
             sp<ABuffer> *tsPackets);
 
+    status_t sendTSAccessUnit(size_t trackIndex, const sp<ABuffer> &accessUnit);
+
     DISALLOW_EVIL_CONSTRUCTORS(MediaSender);
 };
 
@@ -32,6 +32,20 @@
 
 namespace android {
 
+// An RTP packet that TSPacketizer built in place, it keeps the buffer of
+// the whole access unit alive.
+struct RTPPacketSlice : public ABuffer {
+    RTPPacketSlice(const sp<ABuffer> &buffer, size_t offset, size_t size)
+        : ABuffer(buffer->data() + offset, size),
+          mBuffer(buffer) {
+    }
+
+private:
+    sp<ABuffer> mBuffer;
+
+    DISALLOW_EVIL_CONSTRUCTORS(RTPPacketSlice);
+};
+
 RTPSender::RTPSender(
         const sp<ANetworkSession> &netSession,
         const sp<AMessage> &notify)
@@ -49,7 +63,15 @@ RTPSender::RTPSender(
       mNumRTPOctetsSent(0),
       mNumSRsSent(0),
       mRTPSeqNo(0),
-      mHistorySize(0) {
+      mHistorySize(0),
+      mPacingRate(0),
+      mPacingTokens(0),
+      mLastPacingRefillUs(-1ll),
+      mPacedDrainPending(false),
+      mPacingDelaySumUs(0),
+      mPacingDelayMaxUs(0),
+      mNumPacedPacketsSent(0),
+      mLastPacingReportUs(-1ll) {
 }
 
 RTPSender::~RTPSender() {
@@ -212,7 +234,7 @@ status_t RTPSender::queueRawPacket(
     int64_t timeUs;
     CHECK(packet->meta()->findInt64("timeUs", &timeUs));
 
-    sp<ABuffer> udpPacket = new ABuffer(12 + packet->size());
+    sp<ABuffer> udpPacket = ABuffer::CreatePooled(12 + packet->size());
 
     udpPacket->setInt32Data(mRTPSeqNo);
 
@@ -247,31 +269,76 @@ status_t RTPSender::queueRawPacket(
 
 status_t RTPSender::queueTSPackets(
         const sp<ABuffer> &tsPackets, uint8_t packetType) {
-    CHECK_EQ(0, tsPackets->size() % 188);
-
     int64_t timeUs;
     CHECK(tsPackets->meta()->findInt64("timeUs", &timeUs));
 
-    const size_t numTSPackets = tsPackets->size() / 188;
+    // TSPacketizer may have laid the packets out as RTP packets already,
+    // with room for the header in front of each run.
+    int32_t numTSPacketsPerRun;
+    bool inPlace = tsPackets->meta()->findInt32(
+            "ts-packets-per-rtp-packet", &numTSPacketsPerRun);
+
+    // Another sender already owns the headers in the buffer, this one
+    // sends copies of the runs.
+    int32_t shared;
+    if (!tsPackets->meta()->findInt32("shared", &shared)) {
+        shared = false;
+    }
+
+    if (inPlace) {
+        CHECK_GT(numTSPacketsPerRun, 0);
+        CHECK_LE(numTSPacketsPerRun, (int32_t)kMaxNumTSPacketsPerRTPPacket);
+    } else {
+        CHECK_EQ(0, tsPackets->size() % 188);
+    }
+
+    uint32_t rtpTime = (ALooper::GetNowUs() * 9) / 100ll;
+
+    List<sp<ABuffer> > packets;
 
     size_t srcOffset = 0;
     while (srcOffset < tsPackets->size()) {
-        sp<ABuffer> udpPacket =
-            new ABuffer(12 + kMaxNumTSPacketsPerRTPPacket * 188);
+        sp<ABuffer> udpPacket;
 
-        udpPacket->setInt32Data(mRTPSeqNo);
+        if (inPlace) {
+            size_t size = tsPackets->size() - srcOffset;
+            if (size > 12 + (size_t)numTSPacketsPerRun * 188) {
+                size = 12 + (size_t)numTSPacketsPerRun * 188;
+            }
+            CHECK_EQ(0u, (size - 12) % 188);
+
+            if (shared) {
+                udpPacket = ABuffer::CreatePooled(size);
+                memcpy(udpPacket->data() + 12,
+                       tsPackets->data() + srcOffset + 12,
+                       size - 12);
+                udpPacket->setRange(0, size);
+            } else {
+                udpPacket = new RTPPacketSlice(tsPackets, srcOffset, size);
+            }
+            srcOffset += size;
+        } else {
+            udpPacket = ABuffer::CreatePooled(
+                    12 + kMaxNumTSPacketsPerRTPPacket * 188);
 
+            size_t numTSPackets = (tsPackets->size() - srcOffset) / 188;
+            if (numTSPackets > kMaxNumTSPacketsPerRTPPacket) {
+                numTSPackets = kMaxNumTSPacketsPerRTPPacket;
+            }
+
+            memcpy(udpPacket->data() + 12,
+                   tsPackets->data() + srcOffset,
+                   numTSPackets * 188);
+
+            udpPacket->setRange(0, 12 + numTSPackets * 188);
+            srcOffset += numTSPackets * 188;
+        }
+
+        // The sequence number is filled in by sendRTPPackets().
         uint8_t *rtp = udpPacket->data();
         rtp[0] = 0x80;
         rtp[1] = packetType;
 
-        rtp[2] = (mRTPSeqNo >> 8) & 0xff;
-        rtp[3] = mRTPSeqNo & 0xff;
-        ++mRTPSeqNo;
-
-        int64_t nowUs = ALooper::GetNowUs();
-        uint32_t rtpTime = (nowUs * 9) / 100ll;
-
         rtp[4] = rtpTime >> 24;
         rtp[5] = (rtpTime >> 16) & 0xff;
         rtp[6] = (rtpTime >> 8) & 0xff;
@@ -282,30 +349,22 @@ status_t RTPSender::queueTSPackets(
         rtp[10] = (kSourceID >> 8) & 0xff;
         rtp[11] = kSourceID & 0xff;
 
-        size_t numTSPackets = (tsPackets->size() - srcOffset) / 188;
-        if (numTSPackets > kMaxNumTSPacketsPerRTPPacket) {
-            numTSPackets = kMaxNumTSPacketsPerRTPPacket;
-        }
-
-        memcpy(&rtp[12], tsPackets->data() + srcOffset, numTSPackets * 188);
-
-        udpPacket->setRange(0, 12 + numTSPackets * 188);
-
-        srcOffset += numTSPackets * 188;
-        bool isLastPacket = (srcOffset == tsPackets->size());
+        packets.push_back(udpPacket);
+    }
 
-        status_t err = sendRTPPacket(
-                udpPacket,
-                true /* storeInHistory */,
-                isLastPacket /* timeValid */,
-                timeUs);
+    // The time goes with the last packet of the access unit, for the
+    // latency reports.
+    int32_t latencyTracked;
+    if (!tsPackets->meta()->findInt32("latency-tracked", &latencyTracked)) {
+        latencyTracked = true;
+    }
 
-        if (err != OK) {
-            return err;
-        }
+    int32_t highPriority;
+    if (!tsPackets->meta()->findInt32("high-priority", &highPriority)) {
+        highPriority = false;
     }
 
-    return OK;
+    return queueRTPPackets(packets, latencyTracked, timeUs, highPriority);
 }
 
 status_t RTPSender::queueAVCBuffer(
@@ -317,7 +376,7 @@ status_t RTPSender::queueAVCBuffer(
 
     List<sp<ABuffer> > packets;
 
-    sp<ABuffer> out = new ABuffer(kMaxUDPPacketSize);
+    sp<ABuffer> out = ABuffer::CreatePooled(kMaxUDPPacketSize);
     size_t outBytesUsed = 12;  // Placeholder for RTP header.
 
     const uint8_t *data = accessUnit->data();
@@ -350,7 +409,7 @@ status_t RTPSender::queueAVCBuffer(
             if (outBytesUsed > 12) {
                 out->setRange(0, outBytesUsed);
                 packets.push_back(out);
-                out = new ABuffer(kMaxUDPPacketSize);
+                out = ABuffer::CreatePooled(kMaxUDPPacketSize);
                 outBytesUsed = 12;  // Placeholder for RTP header
             }
 
@@ -408,7 +467,7 @@ status_t RTPSender::queueAVCBuffer(
             out->setRange(0, outBytesUsed + copy + 2);
 
             packets.push_back(out);
-            out = new ABuffer(kMaxUDPPacketSize);
+            out = ABuffer::CreatePooled(kMaxUDPPacketSize);
             outBytesUsed = 12;  // Placeholder for RTP header
         }
     }
@@ -418,14 +477,14 @@ status_t RTPSender::queueAVCBuffer(
         packets.push_back(out);
     }
 
-    while (!packets.empty()) {
-        sp<ABuffer> out = *packets.begin();
-        packets.erase(packets.begin());
-
-        out->setInt32Data(mRTPSeqNo);
+    for (List<sp<ABuffer> >::iterator it = packets.begin();
+            it != packets.end(); ++it) {
+        const sp<ABuffer> &out = *it;
 
-        bool last = packets.empty();
+        List<sp<ABuffer> >::iterator next = it;
+        bool last = (++next == packets.end());
 
+        // The sequence number is filled in by sendRTPPackets().
         uint8_t *dst = out->data();
 
         dst[0] = 0x80;
@@ -435,10 +494,6 @@ status_t RTPSender::queueAVCBuffer(
             dst[1] |= 1 << 7;  // M-bit
         }
 
-        dst[2] = (mRTPSeqNo >> 8) & 0xff;
-        dst[3] = mRTPSeqNo & 0xff;
-        ++mRTPSeqNo;
-
         dst[4] = rtpTime >> 24;
         dst[5] = (rtpTime >> 16) & 0xff;
         dst[6] = (rtpTime >> 8) & 0xff;
@@ -447,15 +502,15 @@ status_t RTPSender::queueAVCBuffer(
         dst[9] = (kSourceID >> 16) & 0xff;
         dst[10] = (kSourceID >> 8) & 0xff;
         dst[11] = kSourceID & 0xff;
+    }
 
-        status_t err = sendRTPPacket(out, true /* storeInHistory */);
-
-        if (err != OK) {
-            return err;
-        }
+    int32_t highPriority;
+    if (!accessUnit->meta()->findInt32("high-priority", &highPriority)) {
+        highPriority = false;
     }
 
-    return OK;
+    return queueRTPPackets(
+            packets, false /* timeValid */, -1ll /* timeUs */, highPriority);
 }
 
 status_t RTPSender::sendRTPPacket(
@@ -471,6 +526,208 @@ status_t RTPSender::sendRTPPacket(
         return err;
     }
 
+    onRTPPacketSent(buffer, storeInHistory);
+
+    return OK;
+}
+
+status_t RTPSender::sendRTPPackets(
+        const List<sp<ABuffer> > &packets, bool timeValid, int64_t timeUs) {
+    CHECK(mRTPConnected);
+
+    // Numbering the packets only now keeps the sequence in sending order
+    // when the pacer lets high priority packets overtake.
+    for (List<sp<ABuffer> >::const_iterator it = packets.begin();
+            it != packets.end(); ++it) {
+        const sp<ABuffer> &packet = *it;
+
+        packet->setInt32Data(mRTPSeqNo);
+
+        uint8_t *rtp = packet->data();
+        rtp[2] = (mRTPSeqNo >> 8) & 0xff;
+        rtp[3] = mRTPSeqNo & 0xff;
+        ++mRTPSeqNo;
+    }
+
+    status_t err = mNetSession->sendDatagrams(
+            mRTPSessionID, packets, timeValid, timeUs);
+
+    if (err != OK) {
+        return err;
+    }
+
+    for (List<sp<ABuffer> >::const_iterator it = packets.begin();
+            it != packets.end(); ++it) {
+        onRTPPacketSent(*it, true /* storeInHistory */);
+    }
+
+    return OK;
+}
+
+void RTPSender::setPacingRate(int32_t bitsPerSecond) {
+    CHECK_GE(bitsPerSecond, 0);
+
+    bool wasPacing = (mPacingRate > 0);
+    mPacingRate = bitsPerSecond / 8;
+
+    if (wasPacing && mPacingRate == 0) {
+        // Don't strand what has been queued so far.
+        mPacingTokens = 1ll << 62;
+        drainPacedPackets();
+        mPacingTokens = 0;
+    }
+
+    ALOGV("pacing rate now %d bits/sec", bitsPerSecond);
+}
+
+status_t RTPSender::queueRTPPackets(
+        const List<sp<ABuffer> > &packets, bool timeValid, int64_t timeUs,
+        bool highPriority) {
+    if (mPacingRate == 0) {
+        return sendRTPPackets(packets, timeValid, timeUs);
+    }
+
+    List<PacedPacket> *queue = &mPacedPackets[highPriority ? 0 : 1];
+    int64_t nowUs = ALooper::GetNowUs();
+
+    for (List<sp<ABuffer> >::const_iterator it = packets.begin();
+            it != packets.end(); ++it) {
+        PacedPacket paced;
+        paced.mPacket = *it;
+        paced.mTimeValid = false;
+        paced.mTimeUs = -1ll;
+        paced.mQueuedUs = nowUs;
+
+        queue->push_back(paced);
+    }
+
+    if (timeValid && !packets.empty()) {
+        PacedPacket *last = &*--queue->end();
+        last->mTimeValid = true;
+        last->mTimeUs = timeUs;
+    }
+
+    if (!mPacedDrainPending) {
+        drainPacedPackets();
+    }
+
+    return OK;
+}
+
+void RTPSender::drainPacedPackets() {
+    // A burst of this many microseconds worth of data may go out at once,
+    // but never less than two full packets.
+    static const int64_t kMaxBurstUs = 2000ll;
+    static const int64_t kPacingReportIntervalUs = 5000000ll;
+
+    // Set again below if another drain gets scheduled, but not on the
+    // error paths, so that the next queueRTPPackets() restarts draining.
+    mPacedDrainPending = false;
+
+    int64_t nowUs = ALooper::GetNowUs();
+
+    if (mLastPacingRefillUs >= 0ll) {
+        mPacingTokens +=
+            (nowUs - mLastPacingRefillUs) * mPacingRate / 1000000ll;
+    }
+    mLastPacingRefillUs = nowUs;
+
+    int64_t maxTokens = mPacingRate * kMaxBurstUs / 1000000ll;
+    if (maxTokens < 2 * kMaxUDPPacketSize) {
+        maxTokens = 2 * kMaxUDPPacketSize;
+    }
+    if (mPacingRate > 0 && mPacingTokens > maxTokens) {
+        mPacingTokens = maxTokens;
+    }
+
+    List<sp<ABuffer> > batch;
+    List<PacedPacket> *queue = NULL;
+
+    for (;;) {
+        queue = mPacedPackets[0].empty()
+            ? &mPacedPackets[1] : &mPacedPackets[0];
+
+        if (queue->empty()) {
+            queue = NULL;
+            break;
+        }
+
+        const PacedPacket &paced = *queue->begin();
+        if (mPacingTokens < (int64_t)paced.mPacket->size()) {
+            break;
+        }
+
+        mPacingTokens -= paced.mPacket->size();
+
+        int64_t delayUs = nowUs - paced.mQueuedUs;
+        mPacingDelaySumUs += delayUs;
+        if (delayUs > mPacingDelayMaxUs) {
+            mPacingDelayMaxUs = delayUs;
+        }
+        ++mNumPacedPacketsSent;
+
+        batch.push_back(paced.mPacket);
+
+        bool timeValid = paced.mTimeValid;
+        int64_t timeUs = paced.mTimeUs;
+        queue->erase(queue->begin());
+
+        if (timeValid) {
+            status_t err = sendRTPPackets(batch, true /* timeValid */, timeUs);
+            batch.clear();
+
+            if (err != OK) {
+                notifyError(err);
+                return;
+            }
+        }
+    }
+
+    if (!batch.empty()) {
+        status_t err = sendRTPPackets(batch, false /* timeValid */, -1ll);
+
+        if (err != OK) {
+            notifyError(err);
+            return;
+        }
+    }
+
+    if (mLastPacingReportUs < 0ll) {
+        mLastPacingReportUs = nowUs;
+    } else if (nowUs >= mLastPacingReportUs + kPacingReportIntervalUs
+            && mNumPacedPacketsSent > 0) {
+        ALOGI("pacing delay avg %lld us, max %lld us over %d packets, "
+              "%d/%d packets queued",
+              mPacingDelaySumUs / (int64_t)mNumPacedPacketsSent,
+              mPacingDelayMaxUs,
+              mNumPacedPacketsSent,
+              mPacedPackets[0].size(),
+              mPacedPackets[1].size());
+
+        mPacingDelaySumUs = 0;
+        mPacingDelayMaxUs = 0;
+        mNumPacedPacketsSent = 0;
+        mLastPacingReportUs = nowUs;
+    }
+
+    mPacedDrainPending = (queue != NULL);
+
+    if (mPacedDrainPending) {
+        // Come back once the bucket holds enough for the next packet.
+        int64_t deficit =
+            (int64_t)(*queue->begin()).mPacket->size() - mPacingTokens;
+
+        int64_t delayUs = deficit * 1000000ll / mPacingRate;
+        if (delayUs < 1000ll) {
+            delayUs = 1000ll;
+        }
+
+        (new AMessage(kWhatDrainPacedPackets, id()))->post(delayUs);
+    }
+}
+
+void RTPSender::onRTPPacketSent(
+        const sp<ABuffer> &buffer, bool storeInHistory) {
     mLastNTPTime = GetNowNTP();
     mLastRTPTime = U32_AT(buffer->data() + 4);
 
@@ -485,8 +742,6 @@ status_t RTPSender::sendRTPPacket(
         }
         mHistory.push_back(buffer);
     }
-
-    return OK;
 }
 
 // static
@@ -511,6 +766,12 @@ void RTPSender::onMessageReceived(const sp<AMessage> &msg) {
             onNetNotify(msg->what() == kWhatRTPNotify, msg);
             break;
 
+        case kWhatDrainPacedPackets:
+        {
+            drainPacedPackets();
+            break;
+        }
+
         default:
             TRESPASS();
     }
@@ -607,6 +868,18 @@ void RTPSender::onNetNotify(bool isRTP, const sp<AMessage> &msg) {
             break;
         }
 
+        case ANetworkSession::kWhatSendLatency:
+        {
+            int64_t avgLatencyUs;
+            CHECK(msg->findInt64("avgLatencyUs", &avgLatencyUs));
+
+            int64_t maxLatencyUs;
+            CHECK(msg->findInt64("maxLatencyUs", &maxLatencyUs));
+
+            notifySendLatency(avgLatencyUs, maxLatencyUs);
+            break;
+        }
+
         default:
             TRESPASS();
     }
@@ -688,10 +961,22 @@ status_t RTPSender::onRTCPData(const sp<ABuffer> &buffer) {
 status_t RTPSender::parseReceiverReport(const uint8_t *data, size_t size) {
     // hexdump(data, size);
 
-    float fractionLost = data[12] / 256.0f;
+    // The report blocks of a sender report follow its sender info.
+    size_t offset = (data[1] == 200) ? 28 : 8;
+
+    if ((data[0] & 0x1f) == 0 || size < offset + 24) {
+        return OK;
+    }
+
+    uint8_t fractionLost = data[offset + 4];
 
     ALOGI("lost %.2f %% of packets during report interval.",
-          100.0f * fractionLost);
+          100.0f * fractionLost / 256.0f);
+
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatReceiverReport);
+    notify->setInt32("fractionLost", fractionLost);
+    notify->post();
 
     return OK;
 }
@@ -801,5 +1086,13 @@ void RTPSender::notifyNetworkStall(size_t numBytesQueued) {
     notify->post();
 }
 
+void RTPSender::notifySendLatency(int64_t avgLatencyUs, int64_t maxLatencyUs) {
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatSendLatency);
+    notify->setInt64("avgLatencyUs", avgLatencyUs);
+    notify->setInt64("maxLatencyUs", maxLatencyUs);
+    notify->post();
+}
+
 }  // namespace android
 
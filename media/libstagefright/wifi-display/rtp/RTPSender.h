@@ -38,6 +38,10 @@ struct RTPSender : public RTPBase, public AHandler {
         kWhatError,
         kWhatNetworkStall,
         kWhatInformSender,
+        kWhatSendLatency,
+
+        // "fractionLost" of the sink's latest report, in 1/256.
+        kWhatReceiverReport,
     };
     RTPSender(
             const sp<ANetworkSession> &netSession,
@@ -56,6 +60,12 @@ struct RTPSender : public RTPBase, public AHandler {
             uint8_t packetType,
             PacketizationMode mode);
 
+    // Spreads the RTP packets of the transport stream and H.264 modes over
+    // time at "bitsPerSecond" instead of writing all of an access unit's
+    // packets at once. Packets of buffers with "high-priority" set go out
+    // ahead of the others. 0, the default, disables pacing.
+    void setPacingRate(int32_t bitsPerSecond);
+
 protected:
     virtual ~RTPSender();
     virtual void onMessageReceived(const sp<AMessage> &msg);
@@ -64,6 +74,7 @@ private:
     enum {
         kWhatRTPNotify,
         kWhatRTCPNotify,
+        kWhatDrainPacedPackets,
     };
 
     enum {
@@ -92,6 +103,27 @@ private:
     List<sp<ABuffer> > mHistory;
     size_t mHistorySize;
 
+    struct PacedPacket {
+        sp<ABuffer> mPacket;
+        bool mTimeValid;
+        int64_t mTimeUs;
+        int64_t mQueuedUs;
+    };
+
+    // In bytes per second, 0 if pacing is disabled.
+    int32_t mPacingRate;
+    int64_t mPacingTokens;
+    int64_t mLastPacingRefillUs;
+    bool mPacedDrainPending;
+
+    // The high priority packets, then the others.
+    List<PacedPacket> mPacedPackets[2];
+
+    int64_t mPacingDelaySumUs;
+    int64_t mPacingDelayMaxUs;
+    size_t mNumPacedPacketsSent;
+    int64_t mLastPacingReportUs;
+
     static uint64_t GetNowNTP();
 
     status_t queueRawPacket(const sp<ABuffer> &tsPackets, uint8_t packetType);
@@ -102,6 +134,20 @@ private:
             const sp<ABuffer> &packet, bool storeInHistory,
             bool timeValid = false, int64_t timeUs = -1ll);
 
+    // Numbers "packets" and hands all of them to the network thread at
+    // once.
+    status_t sendRTPPackets(
+            const List<sp<ABuffer> > &packets, bool timeValid, int64_t timeUs);
+
+    // Sends "packets" through the pacer if it is enabled.
+    status_t queueRTPPackets(
+            const List<sp<ABuffer> > &packets, bool timeValid, int64_t timeUs,
+            bool highPriority);
+
+    void drainPacedPackets();
+
+    void onRTPPacketSent(const sp<ABuffer> &packet, bool storeInHistory);
+
     void onNetNotify(bool isRTP, const sp<AMessage> &msg);
 
     status_t onRTCPData(const sp<ABuffer> &data);
@@ -112,6 +158,7 @@ private:
     void notifyInitDone(status_t err);
     void notifyError(status_t err);
     void notifyNetworkStall(size_t numBytesQueued);
+    void notifySendLatency(int64_t avgLatencyUs, int64_t maxLatencyUs);
 
     DISALLOW_EVIL_CONSTRUCTORS(RTPSender);
 };
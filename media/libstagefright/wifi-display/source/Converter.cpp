@@ -61,6 +61,7 @@ Converter::Converter(
       ,mPrevVideoBitrate(-1)
       ,mNumFramesToDrop(0)
       ,mEncodingSuspended(false)
+      ,mPrevOutputTimeUs(-1ll)
     {
     AString mime;
     CHECK(mOutputFormat->findString("mime", &mime));
@@ -87,6 +88,14 @@ static void ReleaseMediaBufferReference(const sp<ABuffer> &accessUnit) {
     }
 }
 
+// Copies 16 bit samples, converting them to network byte order.
+static void CopySwapped16(uint8_t *dst, const uint8_t *src, size_t size) {
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        dst[i] = src[i + 1];
+        dst[i + 1] = src[i];
+    }
+}
+
 void Converter::releaseEncoder() {
     if (mEncoder == NULL) {
         return;
@@ -213,6 +222,14 @@ status_t Converter::initEncoder() {
         // to recover from a lost/corrupted packet.
         mbs = (((width + 15) / 16) * ((height + 15) / 16) * 10) / 100;
         mOutputFormat->setInt32("intra-refresh-CIR-mbs", mbs);
+
+        if (mFlags & FLAG_LOW_LATENCY) {
+            // Four slices per frame, in whole macroblock rows.
+            int32_t mbsPerRow = (width + 15) / 16;
+            int32_t rowsPerSlice = ((height + 15) / 16 + 3) / 4;
+            mOutputFormat->setInt32(
+                    "slice-header-spacing", mbsPerRow * rowsPerSlice);
+        }
     }
 
     ALOGV("output format is '%s'", mOutputFormat->debugString(0).c_str());
@@ -367,6 +384,7 @@ void Converter::onMessageReceived(const sp<AMessage> &msg) {
                 if (!mIsVideo) {
                     if (IsSilence(accessUnit)) {
                         if (mInSilentMode) {
+                            ReleaseMediaBufferReference(accessUnit);
                             break;
                         }
 
@@ -377,6 +395,7 @@ void Converter::onMessageReceived(const sp<AMessage> &msg) {
                         } else if (nowUs >= mFirstSilentFrameUs + 10000000ll) {
                             mInSilentMode = true;
                             ALOGI("audio in silent mode now.");
+                            ReleaseMediaBufferReference(accessUnit);
                             break;
                         }
                     } else {
@@ -523,13 +542,6 @@ status_t Converter::feedRawAudioInputBuffers() {
         sp<ABuffer> buffer = *mInputBufferQueue.begin();
         mInputBufferQueue.erase(mInputBufferQueue.begin());
 
-        int16_t *ptr = (int16_t *)buffer->data();
-        int16_t *stop = (int16_t *)(buffer->data() + buffer->size());
-        while (ptr < stop) {
-            *ptr = htons(*ptr);
-            ++ptr;
-        }
-
         static const size_t kFrameSize = 2 * sizeof(int16_t);  // stereo
         static const size_t kFramesPerAU = 80;
         static const size_t kNumAUsPerPESPacket = 6;
@@ -544,9 +556,10 @@ status_t Converter::feedRawAudioInputBuffers() {
                 copy = bytesMissingForFullAU;
             }
 
-            memcpy(mPartialAudioAU->data() + mPartialAudioAU->size(),
-                   buffer->data(),
-                   copy);
+            CopySwapped16(
+                    mPartialAudioAU->data() + mPartialAudioAU->size(),
+                    buffer->data(),
+                    copy);
 
             mPartialAudioAU->setRange(0, mPartialAudioAU->size() + copy);
 
@@ -593,7 +606,7 @@ status_t Converter::feedRawAudioInputBuffers() {
                 copy = partialAudioAU->size() - 4;
             }
 
-            memcpy(&ptr[4], buffer->data(), copy);
+            CopySwapped16(&ptr[4], buffer->data(), copy);
 
             partialAudioAU->setRange(0, 4 + copy);
             buffer->setRange(buffer->offset() + copy, buffer->size() - copy);
@@ -619,6 +632,8 @@ status_t Converter::feedRawAudioInputBuffers() {
 
             mPartialAudioAU = partialAudioAU;
         }
+
+        ReleaseMediaBufferReference(buffer);
     }
 
     return OK;
@@ -648,7 +663,11 @@ status_t Converter::feedEncoderInputBuffers() {
                    buffer->size());
 
             void *mediaBuffer;
-            if (buffer->meta()->findPointer("mediaBuffer", &mediaBuffer)
+            if (!mIsVideo) {
+                // The PCM has been copied, no need to hold on to it until
+                // the encoder returns the input buffer.
+                ReleaseMediaBufferReference(buffer);
+            } else if (buffer->meta()->findPointer("mediaBuffer", &mediaBuffer)
                     && mediaBuffer != NULL) {
                 mEncoderInputBuffers.itemAt(bufferIndex)->meta()
                     ->setPointer("mediaBuffer", mediaBuffer);
@@ -765,7 +784,7 @@ status_t Converter::doMoreWork() {
                 buffer->meta()->setInt32("rangeLength", rangeLength);
                 buffer->meta()->setMessage("notify", notify);
             } else {
-                buffer = new ABuffer(size);
+                buffer = ABuffer::CreatePooled(size);
             }
 
             buffer->meta()->setInt64("timeUs", timeUs);
@@ -783,7 +802,16 @@ status_t Converter::doMoreWork() {
                     mOutputFormat->setBuffer("csd-0", buffer);
                 }
             } else {
-                if (mNeedToManuallyPrependSPSPPS
+                // Only the low latency mode asks for slices to be output on
+                // their own, otherwise a repeated timestamp is no reason to
+                // skip the CSD.
+                bool continuesFrame = (mFlags & FLAG_LOW_LATENCY)
+                        && timeUs == mPrevOutputTimeUs;
+                mPrevOutputTimeUs = timeUs;
+
+                if (continuesFrame) {
+                    buffer->meta()->setInt32("continues-frame", true);
+                } else if (mNeedToManuallyPrependSPSPPS
                         && mIsH264
                         && (mFlags & FLAG_PREPEND_CSD_IF_NECESSARY)
                         && IsIDR(buffer)) {
@@ -42,6 +42,12 @@ struct Converter : public AHandler {
     enum FlagBits {
         FLAG_USE_SURFACE_INPUT          = 1,
         FLAG_PREPEND_CSD_IF_NECESSARY   = 2,
+
+        // Video is encoded as several slices per frame. Encoders that
+        // output each slice as soon as it is done get each one sent on
+        // as its own access unit, all but the first of a frame marked
+        // "continues-frame".
+        FLAG_LOW_LATENCY                = 4,
     };
     Converter(const sp<AMessage> &notify,
               const sp<ALooper> &codecLooper,
@@ -129,6 +135,9 @@ private:
     int32_t mNumFramesToDrop;
     bool mEncodingSuspended;
 
+    // Of the last output buffer, slices of one frame share it.
+    int64_t mPrevOutputTimeUs;
+
     status_t initEncoder();
     void releaseEncoder();
 
@@ -165,23 +165,28 @@ void MediaPuller::onMessageReceived(const sp<AMessage> &msg) {
                 int64_t timeUs;
                 CHECK(mbuf->meta_data()->findInt64(kKeyTime, &timeUs));
 
-                sp<ABuffer> accessUnit = new ABuffer(mbuf->range_length());
-
-                memcpy(accessUnit->data(),
-                       (const uint8_t *)mbuf->data() + mbuf->range_offset(),
-                       mbuf->range_length());
-
-                accessUnit->meta()->setInt64("timeUs", timeUs);
+                sp<ABuffer> accessUnit;
 
                 if (mIsAudio) {
-                    mbuf->release();
-                    mbuf = NULL;
+                    // The PCM is referenced in place, the converter
+                    // releases the MediaBuffer once it has consumed it.
+                    accessUnit = new ABuffer(
+                            (uint8_t *)mbuf->data() + mbuf->range_offset(),
+                            mbuf->range_length());
                 } else {
-                    // video encoder will release MediaBuffer when done
-                    // with underlying data.
-                    accessUnit->meta()->setPointer("mediaBuffer", mbuf);
+                    accessUnit = new ABuffer(mbuf->range_length());
+
+                    memcpy(accessUnit->data(),
+                           (const uint8_t *)mbuf->data() + mbuf->range_offset(),
+                           mbuf->range_length());
                 }
 
+                accessUnit->meta()->setInt64("timeUs", timeUs);
+
+                // video encoder will release MediaBuffer when done
+                // with underlying data.
+                accessUnit->meta()->setPointer("mediaBuffer", mbuf);
+
                 sp<AMessage> notify = mNotify->dup();
 
                 notify->setInt32("what", kWhatAccessUnit);
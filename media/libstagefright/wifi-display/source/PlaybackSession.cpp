@@ -362,7 +362,10 @@ WifiDisplaySource::PlaybackSession::PlaybackSession(
       mPullExtractorPending(false),
       mPullExtractorGeneration(0),
       mFirstSampleTimeRealUs(-1ll),
-      mFirstSampleTimeUs(-1ll) {
+      mFirstSampleTimeUs(-1ll),
+      mMaxVideoBitrate(0),
+      mLastCongestionUs(-1ll),
+      mLastBitrateChangeUs(-1ll) {
     if (path != NULL) {
         mMediaPath.setTo(path);
     }
@@ -449,6 +452,37 @@ status_t WifiDisplaySource::PlaybackSession::onMediaSenderInitialized() {
         CHECK_EQ((status_t)OK, mTracks.editValueAt(i)->start());
     }
 
+    // "media.wfd.mirror-to" = "<host>:<port>" additionally sends the stream
+    // over plain RTP/UDP to e.g. a recorder, without encoding it again.
+    char val[PROPERTY_VALUE_MAX];
+    if (property_get("media.wfd.mirror-to", val, NULL)) {
+        AString host = val;
+        ssize_t colonPos = host.find(":");
+
+        char *end;
+        long port = (colonPos > 0)
+            ? strtol(host.c_str() + colonPos + 1, &end, 10) : 0;
+
+        if (colonPos > 0 && *end == '\0' && port > 0 && port < 65536) {
+            host.erase(colonPos, host.size() - colonPos);
+
+            int32_t localRTPPort;
+            ssize_t sinkID = mMediaSender->addSinkAsync(
+                    host.c_str(),
+                    port,
+                    RTPSender::TRANSPORT_UDP,
+                    -1 /* remoteRTCPPort */,
+                    RTPSender::TRANSPORT_NONE,
+                    &localRTPPort);
+
+            if (sinkID < 0) {
+                ALOGW("unable to mirror to '%s' (err %d)", val, sinkID);
+            }
+        } else {
+            ALOGW("ignoring malformed media.wfd.mirror-to '%s'", val);
+        }
+    }
+
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", kWhatSessionEstablished);
     notify->post();
@@ -563,8 +597,26 @@ void WifiDisplaySource::PlaybackSession::onMessageReceived(
                         converter->dropAFrame();
                     }
                 }
+
+                adaptVideoBitrate(true /* congested */);
+            } else if (what == MediaSender::kWhatReceiverReport) {
+                int32_t fractionLost;
+                CHECK(msg->findInt32("fractionLost", &fractionLost));
+
+                // More than 2% lost.
+                adaptVideoBitrate(fractionLost > 5 /* congested */);
             } else if (what == MediaSender::kWhatInformSender) {
                 onSinkFeedback(msg);
+            } else if (what == MediaSender::kWhatSendLatency) {
+                int64_t avgLatencyUs;
+                CHECK(msg->findInt64("avgLatencyUs", &avgLatencyUs));
+
+                int64_t maxLatencyUs;
+                CHECK(msg->findInt64("maxLatencyUs", &maxLatencyUs));
+
+                ALOGI("capture to send latency avg. %lld ms (max %lld ms)",
+                      avgLatencyUs / 1000ll,
+                      maxLatencyUs / 1000ll);
             } else {
                 TRESPASS();
             }
@@ -703,6 +755,7 @@ void WifiDisplaySource::PlaybackSession::onSinkFeedback(const sp<AMessage> &msg)
                     ALOGI("setting video bitrate to %d bps", videoBitrate);
 
                     converter->setVideoBitrate(videoBitrate);
+                    updatePacingRate();
                 }
             }
         }
@@ -743,6 +796,89 @@ void WifiDisplaySource::PlaybackSession::onSinkFeedback(const sp<AMessage> &msg)
     }
 }
 
+void WifiDisplaySource::PlaybackSession::adaptVideoBitrate(bool congested) {
+    static const int32_t kMinVideoBitrate = 500000;
+
+    // After a cut, give the queues time to drain before the next one.
+    static const int64_t kDecreaseIntervalUs = 1000000ll;
+
+    // How long things must be clear before the bitrate creeps back up,
+    // and how often it does.
+    static const int64_t kIncreaseHoldOffUs = 5000000ll;
+    static const int64_t kIncreaseIntervalUs = 1000000ll;
+
+    if (mVideoTrackIndex < 0 || mMaxVideoBitrate <= 0) {
+        return;
+    }
+
+    sp<Converter> converter = mTracks.valueFor(mVideoTrackIndex)->converter();
+    if (converter == NULL) {
+        return;
+    }
+
+    int64_t nowUs = ALooper::GetNowUs();
+    int32_t videoBitrate = converter->getVideoBitrate();
+
+    if (congested) {
+        mLastCongestionUs = nowUs;
+
+        if (mLastBitrateChangeUs >= 0ll
+                && nowUs < mLastBitrateChangeUs + kDecreaseIntervalUs) {
+            return;
+        }
+
+        videoBitrate -= videoBitrate / 4;
+    } else {
+        if ((mLastCongestionUs >= 0ll
+                    && nowUs < mLastCongestionUs + kIncreaseHoldOffUs)
+                || (mLastBitrateChangeUs >= 0ll
+                    && nowUs < mLastBitrateChangeUs + kIncreaseIntervalUs)) {
+            return;
+        }
+
+        videoBitrate += videoBitrate / 20;
+    }
+
+    if (videoBitrate < kMinVideoBitrate) {
+        videoBitrate = kMinVideoBitrate;
+    } else if (videoBitrate > mMaxVideoBitrate) {
+        videoBitrate = mMaxVideoBitrate;
+    }
+
+    if (videoBitrate == converter->getVideoBitrate()) {
+        return;
+    }
+
+    ALOGI("%s video bitrate to %d bps",
+          congested ? "lowering" : "raising", videoBitrate);
+
+    converter->setVideoBitrate(videoBitrate);
+    mLastBitrateChangeUs = nowUs;
+
+    updatePacingRate();
+}
+
+void WifiDisplaySource::PlaybackSession::updatePacingRate() {
+    // At three times the average rate a regular frame goes out within a
+    // third of a frame interval and an IDR frame over a few intervals.
+    // The headroom covers the audio (LPCM is 1.5 Mbps) and the muxing.
+    static const int32_t kPacingFactor = 3;
+    static const int32_t kPacingHeadroom = 2000000;
+
+    if (mVideoTrackIndex < 0
+            || Converter::GetInt32Property("media.wfd.pacing", 1) == 0) {
+        return;
+    }
+
+    sp<Converter> converter = mTracks.valueFor(mVideoTrackIndex)->converter();
+    if (converter == NULL) {
+        return;
+    }
+
+    mMediaSender->setPacingRate(
+            kPacingFactor * converter->getVideoBitrate() + kPacingHeadroom);
+}
+
 status_t WifiDisplaySource::PlaybackSession::setupMediaPacketizer(
         bool enableAudio, bool enableVideo) {
     DataSource::RegisterDefaultSniffers();
@@ -956,7 +1092,18 @@ status_t WifiDisplaySource::PlaybackSession::addSource(
     notify = new AMessage(kWhatConverterNotify, id());
     notify->setSize("trackIndex", trackIndex);
 
-    sp<Converter> converter = new Converter(notify, codecLooper, format);
+    // Trades some compression and A/V interleaving for latency, see
+    // Converter::FLAG_LOW_LATENCY.
+    bool lowLatency = isVideo
+        && Converter::GetInt32Property("media.wfd.low-latency", 0) > 0;
+
+    uint32_t converterFlags = 0;
+    if (lowLatency) {
+        converterFlags |= Converter::FLAG_LOW_LATENCY;
+    }
+
+    sp<Converter> converter =
+        new Converter(notify, codecLooper, format, converterFlags);
 
     looper()->registerHandler(converter);
 
@@ -1000,6 +1147,14 @@ status_t WifiDisplaySource::PlaybackSession::addSource(
     if (converter->needToManuallyPrependSPSPPS()) {
         flags |= MediaSender::FLAG_MANUALLY_PREPEND_SPS_PPS;
     }
+    if (lowLatency) {
+        flags |= MediaSender::FLAG_LOW_LATENCY;
+    }
+
+    if (isVideo
+            && Converter::GetInt32Property("media.wfd.video-bitrate", -1) < 0) {
+        mMaxVideoBitrate = converter->getVideoBitrate();
+    }
 
     ssize_t mediaSenderTrackIndex =
         mMediaSender->addTrack(converter->getOutputFormat(), flags);
@@ -1007,6 +1162,10 @@ status_t WifiDisplaySource::PlaybackSession::addSource(
 
     track->setMediaSenderTrackIndex(mediaSenderTrackIndex);
 
+    if (isVideo) {
+        updatePacingRate();
+    }
+
     return OK;
 }
 
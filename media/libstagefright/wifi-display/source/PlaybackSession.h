@@ -125,6 +125,12 @@ private:
     int64_t mFirstSampleTimeRealUs;
     int64_t mFirstSampleTimeUs;
 
+    // Congestion control of the video bitrate, up to the bitrate the
+    // encoder started out with. 0 if a fixed bitrate was asked for.
+    int32_t mMaxVideoBitrate;
+    int64_t mLastCongestionUs;
+    int64_t mLastBitrateChangeUs;
+
     status_t setupMediaPacketizer(bool enableAudio, bool enableVideo);
 
     status_t setupPacketizer(
@@ -163,6 +169,13 @@ private:
 
     void onSinkFeedback(const sp<AMessage> &msg);
 
+    // Called on every network stall or receiver report.
+    void adaptVideoBitrate(bool congested);
+
+    // Paces the media packets at a multiple of the current video bitrate
+    // unless "media.wfd.pacing" is 0.
+    void updatePacingRate();
+
     DISALLOW_EVIL_CONSTRUCTORS(PlaybackSession);
 };
 
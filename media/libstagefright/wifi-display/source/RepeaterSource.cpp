@@ -12,6 +12,9 @@
 
 namespace android {
 
+// How often an unchanged buffer is still sent once idle.
+static const int64_t kIdleRepeatIntervalUs = 1000000ll;
+
 RepeaterSource::RepeaterSource(const sp<MediaSource> &source, double rateHz)
     : mStarted(false),
       mSource(source),
@@ -20,7 +23,9 @@ RepeaterSource::RepeaterSource(const sp<MediaSource> &source, double rateHz)
       mResult(OK),
       mLastBufferUpdateUs(-1ll),
       mStartTimeUs(-1ll),
-      mFrameCount(0) {
+      mFrameCount(0),
+      mBufferSendCount(0),
+      mLastSendTimeUs(-1ll) {
 }
 
 RepeaterSource::~RepeaterSource() {
@@ -59,6 +64,8 @@ status_t RepeaterSource::start(MetaData *params) {
     mResult = OK;
     mStartTimeUs = -1ll;
     mFrameCount = 0;
+    mBufferSendCount = 0;
+    mLastSendTimeUs = -1ll;
 
     mLooper = new ALooper;
     mLooper->setName("repeater_looper");
@@ -144,6 +151,13 @@ status_t RepeaterSource::read(
                 return mResult;
             }
 
+            if (mBufferSendCount >= kNumSendsBeforeIdle
+                    && bufferTimeUs < mLastSendTimeUs + kIdleRepeatIntervalUs) {
+                // Nothing changed on screen, skip this frame.
+                ++mFrameCount;
+                continue;
+            }
+
 #if SUSPEND_VIDEO_IF_IDLE
             int64_t nowUs = ALooper::GetNowUs();
             if (nowUs - mLastBufferUpdateUs > 1000000ll) {
@@ -156,6 +170,9 @@ status_t RepeaterSource::read(
                 *buffer = mBuffer;
                 (*buffer)->meta_data()->setInt64(kKeyTime, bufferTimeUs);
                 ++mFrameCount;
+
+                ++mBufferSendCount;
+                mLastSendTimeUs = bufferTimeUs;
             }
         }
 
@@ -192,6 +209,7 @@ void RepeaterSource::onMessageReceived(const sp<AMessage> &msg) {
             mBuffer = buffer;
             mResult = err;
             mLastBufferUpdateUs = ALooper::GetNowUs();
+            mBufferSendCount = 0;
 
             mCondition.broadcast();
 
@@ -11,7 +11,8 @@
 namespace android {
 
 // This MediaSource delivers frames at a constant rate by repeating buffers
-// if necessary.
+// if necessary. A buffer that stays unchanged is only repeated for a while,
+// after that just once a second until the screen changes again.
 struct RepeaterSource : public MediaSource {
     RepeaterSource(const sp<MediaSource> &source, double rateHz);
 
@@ -39,6 +40,11 @@ private:
         kWhatRead,
     };
 
+    enum {
+        // Enough for the encoder's cyclic intra refresh to cover the frame.
+        kNumSendsBeforeIdle = 15,
+    };
+
     Mutex mLock;
     Condition mCondition;
 
@@ -57,6 +63,10 @@ private:
     int64_t mStartTimeUs;
     int32_t mFrameCount;
 
+    // How often mBuffer was handed out, and when it was last.
+    int32_t mBufferSendCount;
+    int64_t mLastSendTimeUs;
+
     void postRead();
 
     DISALLOW_EVIL_CONSTRUCTORS(RepeaterSource);
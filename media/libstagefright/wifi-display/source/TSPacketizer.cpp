@@ -32,6 +32,41 @@
 
 namespace android {
 
+// Hands out where each TS packet of a packetized access unit goes, leaving
+// "headerSize" bytes in front of every run of "packetsPerRun" packets.
+struct TSPacketCursor {
+    TSPacketCursor(
+            uint8_t *start, size_t numPackets, size_t packetsPerRun,
+            size_t headerSize)
+        : mPacket(start),
+          mNumPackets(numPackets),
+          mPacketsPerRun(packetsPerRun),
+          mHeaderSize(headerSize),
+          mNumPacketsWritten(0) {
+    }
+
+    uint8_t *first() {
+        mPacket += mHeaderSize;
+        return mPacket;
+    }
+
+    uint8_t *next() {
+        mPacket += 188;
+        if ((++mNumPacketsWritten % mPacketsPerRun) == 0
+                && mNumPacketsWritten < mNumPackets) {
+            mPacket += mHeaderSize;
+        }
+        return mPacket;
+    }
+
+private:
+    uint8_t *mPacket;
+    size_t mNumPackets;
+    size_t mPacketsPerRun;
+    size_t mHeaderSize;
+    size_t mNumPacketsWritten;
+};
+
 struct TSPacketizer::Track : public RefBase {
     Track(const sp<AMessage> &format,
           unsigned PID, unsigned streamType, unsigned streamID);
@@ -639,8 +674,25 @@ status_t TSPacketizer::packetize(
         ++numTSPackets;
     }
 
-    sp<ABuffer> buffer = new ABuffer(numTSPackets * 188);
-    uint8_t *packetDataStart = buffer->data();
+    size_t packetsPerRun = numTSPackets;
+    size_t headerSize = 0;
+    if (flags & RESERVE_RTP_HEADERS) {
+        packetsPerRun = kNumTSPacketsPerRTPPacket;
+        headerSize = kRTPHeaderSize;
+    }
+    size_t numRuns = (numTSPackets + packetsPerRun - 1) / packetsPerRun;
+
+    sp<ABuffer> buffer =
+        ABuffer::CreatePooled(numTSPackets * 188 + numRuns * headerSize);
+
+    if (flags & RESERVE_RTP_HEADERS) {
+        buffer->meta()->setInt32(
+                "ts-packets-per-rtp-packet", kNumTSPacketsPerRTPPacket);
+    }
+
+    TSPacketCursor cursor(
+            buffer->data(), numTSPackets, packetsPerRun, headerSize);
+    uint8_t *packetDataStart = cursor.first();
 
     if (flags & EMIT_PAT_AND_PMT) {
         // Program Association Table (PAT):
@@ -704,7 +756,7 @@ status_t TSPacketizer::packetize(
         size_t sizeLeft = packetDataStart + 188 - ptr;
         memset(ptr, 0xff, sizeLeft);
 
-        packetDataStart += 188;
+        packetDataStart = cursor.next();
 
         // Program Map (PMT):
         // 0x47
@@ -819,7 +871,7 @@ status_t TSPacketizer::packetize(
         sizeLeft = packetDataStart + 188 - ptr;
         memset(ptr, 0xff, sizeLeft);
 
-        packetDataStart += 188;
+        packetDataStart = cursor.next();
     }
 
     if (flags & EMIT_PCR) {
@@ -867,7 +919,7 @@ status_t TSPacketizer::packetize(
         size_t sizeLeft = packetDataStart + 188 - ptr;
         memset(ptr, 0xff, sizeLeft);
 
-        packetDataStart += 188;
+        packetDataStart = cursor.next();
     }
 
     uint64_t PTS = (timeUs * 9ll) / 100ll;
@@ -950,7 +1002,7 @@ status_t TSPacketizer::packetize(
     ptr += copy;
 
     CHECK_EQ(ptr, packetDataStart + 188);
-    packetDataStart += 188;
+    packetDataStart = cursor.next();
 
     size_t offset = copy;
     while (offset < accessUnit->size()) {
@@ -1001,7 +1053,7 @@ status_t TSPacketizer::packetize(
         CHECK_EQ(ptr, packetDataStart + 188);
 
         offset += copy;
-        packetDataStart += 188;
+        packetDataStart = cursor.next();
     }
 
     CHECK(packetDataStart == buffer->data() + buffer->capacity());
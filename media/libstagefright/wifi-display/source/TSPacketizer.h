@@ -46,7 +46,18 @@ struct TSPacketizer : public RefBase {
         EMIT_PCR                        = 2,
         IS_ENCRYPTED                    = 4,
         PREPEND_SPS_PPS_TO_IDR_FRAMES   = 8,
+        RESERVE_RTP_HEADERS             = 16,
     };
+
+    // With RESERVE_RTP_HEADERS the packets come in runs of
+    // kNumTSPacketsPerRTPPacket (the last one may be shorter), each one
+    // preceded by kRTPHeaderSize bytes for the sender to fill in, so that
+    // every run can be sent as an RTP packet in place.
+    enum {
+        kRTPHeaderSize              = 12,
+        kNumTSPacketsPerRTPPacket   = 7,
+    };
+
     status_t packetize(
             size_t trackIndex, const sp<ABuffer> &accessUnit,
             sp<ABuffer> *packets,
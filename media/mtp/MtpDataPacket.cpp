@@ -26,6 +26,9 @@
 #include "MtpStringBuffer.h"
 
 #define MTP_BUFFER_SIZE 16384
+// Upper bound on a data container assembled in user space by readAll().
+// Object contents never take this path, so anything larger is bogus.
+#define MTP_MAX_DATA_PACKET_SIZE (1024 * 1024)
 
 namespace android {
 
@@ -347,6 +350,7 @@ void MtpDataPacket::putString(const uint16_t* string) {
 
 #ifdef MTP_DEVICE 
 int MtpDataPacket::read(int fd) {
+    // f_mtp rejects reads larger than its 16 KB request buffers
     int ret = ::read(fd, mBuffer, MTP_BUFFER_SIZE);
     if (ret < MTP_CONTAINER_HEADER_SIZE)
         return -1;
@@ -355,6 +359,36 @@ int MtpDataPacket::read(int fd) {
     return ret;
 }
 
+int MtpDataPacket::readAll(int fd) {
+    int length = read(fd);
+    if (length < 0)
+        return length;
+
+    // The driver returns at most one bulk transfer per read, so keep going
+    // until the whole container announced in the header has arrived.
+    uint32_t totalLength = MtpPacket::getUInt32(MTP_CONTAINER_LENGTH_OFFSET);
+    if (totalLength < MTP_CONTAINER_HEADER_SIZE || totalLength > MTP_MAX_DATA_PACKET_SIZE) {
+        ALOGE("bogus data container length %u", totalLength);
+        return -1;
+    }
+    if (totalLength > (uint32_t)length) {
+        allocate(totalLength);
+        while ((uint32_t)length < totalLength) {
+            uint32_t chunk = totalLength - length;
+            if (chunk > MTP_BUFFER_SIZE)
+                chunk = MTP_BUFFER_SIZE;
+            int ret = ::read(fd, mBuffer + length, chunk);
+            if (ret < 0)
+                return ret;
+            if (ret == 0)
+                break;
+            length += ret;
+        }
+        mPacketSize = length;
+    }
+    return length;
+}
+
 int MtpDataPacket::write(int fd) {
     MtpPacket::putUInt32(MTP_CONTAINER_LENGTH_OFFSET, mPacketSize);
     MtpPacket::putUInt16(MTP_CONTAINER_TYPE_OFFSET, MTP_CONTAINER_TYPE_DATA);
@@ -96,6 +96,8 @@ public:
 #ifdef MTP_DEVICE
     // fill our buffer with data from the given file descriptor
     int                 read(int fd);
+    // read a complete data container, which may span several transfers
+    int                 readAll(int fd);
 
     // write our data to the given file descriptor
     int                 write(int fd);
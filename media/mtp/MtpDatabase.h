@@ -18,12 +18,13 @@
 #define _MTP_DATABASE_H
 
 #include "MtpTypes.h"
+#include "MtpObjectInfo.h"
+#include "mtp.h"
 
 namespace android {
 
 class MtpDataPacket;
 class MtpProperty;
-class MtpObjectInfo;
 
 class MtpDatabase {
 public:
@@ -84,6 +85,21 @@ public:
     virtual MtpResponseCode         getObjectInfo(MtpObjectHandle handle,
                                             MtpObjectInfo& info) = 0;
 
+    // appends one newly allocated MtpObjectInfo per handle to infos, or NULL for
+    // handles that could not be looked up. The caller deletes the results.
+    // Databases that can answer for many objects in one query should override this.
+    virtual void                    getObjectInfoList(const MtpObjectHandleList& handles,
+                                            Vector<MtpObjectInfo*>& infos) {
+        for (size_t i = 0; i < handles.size(); i++) {
+            MtpObjectInfo* info = new MtpObjectInfo(handles[i]);
+            if (getObjectInfo(handles[i], *info) != MTP_RESPONSE_OK) {
+                delete info;
+                info = NULL;
+            }
+            infos.push(info);
+        }
+    }
+
     virtual void*                   getThumbnail(MtpObjectHandle handle, size_t& outThumbSize) = 0;
 
     virtual MtpResponseCode         getObjectFilePath(MtpObjectHandle handle,
@@ -107,11 +107,13 @@ MtpServer::MtpServer(int fd, MtpDatabase* database, bool ptp,
         mSessionOpen(false),
         mSendObjectHandle(kInvalidObjectHandle),
         mSendObjectFormat(0),
-        mSendObjectFileSize(0)
+        mSendObjectFileSize(0),
+        mObjectInfoGeneration(0)
 {
 }
 
 MtpServer::~MtpServer() {
+    clearObjectInfoCache();
 }
 
 void MtpServer::addStorage(MtpStorage* storage) {
@@ -177,7 +179,7 @@ void MtpServer::run() {
                     || operation == MTP_OPERATION_SET_OBJECT_PROP_VALUE
                     || operation == MTP_OPERATION_SET_DEVICE_PROP_VALUE);
         if (dataIn) {
-            int ret = mData.read(fd);
+            int ret = mData.readAll(fd);
             if (ret < 0) {
                 ALOGE("data read returned %d, errno: %d", ret, errno);
                 if (errno == ECANCELED) {
@@ -234,6 +236,7 @@ void MtpServer::run() {
         delete edit;
     }
     mObjectEditList.clear();
+    clearObjectInfoCache();
 
     if (mSessionOpen)
         mDatabase->sessionEnded();
@@ -243,11 +246,13 @@ void MtpServer::run() {
 
 void MtpServer::sendObjectAdded(MtpObjectHandle handle) {
     ALOGV("sendObjectAdded %d\n", handle);
+    invalidateObjectInfo(handle);
     sendEvent(MTP_EVENT_OBJECT_ADDED, handle);
 }
 
 void MtpServer::sendObjectRemoved(MtpObjectHandle handle) {
     ALOGV("sendObjectRemoved %d\n", handle);
+    invalidateObjectInfo(handle);
     sendEvent(MTP_EVENT_OBJECT_REMOVED, handle);
 }
 
@@ -303,6 +308,119 @@ void MtpServer::commitEdit(ObjectEdit* edit) {
     mDatabase->endSendObject((const char *)edit->mPath, edit->mHandle, edit->mFormat, true);
 }
 
+// number of handles following a cache miss to fetch from the database in one go
+static const size_t kObjectInfoBatchSize = 64;
+// drop the whole cache rather than grow past this many objects
+static const size_t kMaxCachedObjectInfos = 4096;
+
+MtpObjectInfo* MtpServer::getCachedObjectInfo_l(MtpObjectHandle handle) {
+    ssize_t index = mObjectInfoCache.indexOfKey(handle);
+    if (index >= 0)
+        return mObjectInfoCache.valueAt(index);
+
+    // Hosts usually ask for every object of the folder they just listed,
+    // so fetch the ones after this handle along with it.
+    MtpObjectHandleList handles;
+    handles.push(handle);
+    for (size_t i = 0; i < mLastObjectList.size(); i++) {
+        if (mLastObjectList[i] != handle)
+            continue;
+        for (size_t j = i + 1; j < mLastObjectList.size()
+                && handles.size() < kObjectInfoBatchSize; j++) {
+            if (mObjectInfoCache.indexOfKey(mLastObjectList[j]) < 0)
+                handles.push(mLastObjectList[j]);
+        }
+        break;
+    }
+
+    if (mObjectInfoCache.size() + handles.size() > kMaxCachedObjectInfos)
+        clearObjectInfoCache_l();
+
+    // the database calls into Java, don't hold up the notification threads meanwhile
+    uint32_t generation = mObjectInfoGeneration;
+    Vector<MtpObjectInfo*> infos;
+    mObjectInfoLock.unlock();
+    mDatabase->getObjectInfoList(handles, infos);
+    mObjectInfoLock.lock();
+
+    for (size_t i = 0; i < infos.size(); i++) {
+        MtpObjectInfo* info = infos[i];
+        if (!info)
+            continue;
+        // after an invalidation only keep what this request needs
+        if ((generation != mObjectInfoGeneration && info->mHandle != handle)
+                || mObjectInfoCache.indexOfKey(info->mHandle) >= 0) {
+            delete info;
+            continue;
+        }
+        mObjectInfoCache.add(info->mHandle, info);
+    }
+
+    index = mObjectInfoCache.indexOfKey(handle);
+    return (index >= 0 ? mObjectInfoCache.valueAt(index) : NULL);
+}
+
+void MtpServer::invalidateObjectInfo(MtpObjectHandle handle) {
+    Mutex::Autolock autoLock(mObjectInfoLock);
+
+    ssize_t index = mObjectInfoCache.indexOfKey(handle);
+    if (index >= 0) {
+        delete mObjectInfoCache.valueAt(index);
+        mObjectInfoCache.removeItemsAt(index);
+    }
+    mObjectInfoGeneration++;
+}
+
+void MtpServer::clearObjectInfoCache() {
+    Mutex::Autolock autoLock(mObjectInfoLock);
+    clearObjectInfoCache_l();
+}
+
+void MtpServer::clearObjectInfoCache_l() {
+    for (size_t i = 0; i < mObjectInfoCache.size(); i++)
+        delete mObjectInfoCache.valueAt(i);
+    mObjectInfoCache.clear();
+    mObjectInfoGeneration++;
+}
+
+bool MtpServer::getCachedObjectPropertyValue(MtpObjectHandle handle,
+        MtpObjectProperty property) {
+    switch (property) {
+        case MTP_PROPERTY_STORAGE_ID:
+        case MTP_PROPERTY_OBJECT_FORMAT:
+        case MTP_PROPERTY_PROTECTION_STATUS:
+        case MTP_PROPERTY_PARENT_OBJECT:
+        case MTP_PROPERTY_OBJECT_FILE_NAME:
+            break;
+        default:
+            return false;
+    }
+
+    Mutex::Autolock autoLock(mObjectInfoLock);
+    MtpObjectInfo* info = getCachedObjectInfo_l(handle);
+    if (!info)
+        return false;
+
+    switch (property) {
+        case MTP_PROPERTY_STORAGE_ID:
+            mData.putUInt32(info->mStorageID);
+            break;
+        case MTP_PROPERTY_OBJECT_FORMAT:
+            mData.putUInt16(info->mFormat);
+            break;
+        case MTP_PROPERTY_PROTECTION_STATUS:
+            mData.putUInt16(info->mProtectionStatus);
+            break;
+        case MTP_PROPERTY_PARENT_OBJECT:
+            mData.putUInt32(info->mParent);
+            break;
+        case MTP_PROPERTY_OBJECT_FILE_NAME:
+            mData.putString(info->mName);
+            break;
+    }
+    return true;
+}
+
 
 bool MtpServer::handleRequest() {
     Mutex::Autolock autoLock(mMutex);
@@ -413,6 +531,21 @@ bool MtpServer::handleRequest() {
             break;
     }
 
+    switch (operation) {
+        case MTP_OPERATION_SET_OBJECT_PROP_VALUE:
+            invalidateObjectInfo(mRequest.getParameter(1));
+            break;
+        case MTP_OPERATION_SEND_OBJECT_INFO:
+        case MTP_OPERATION_SEND_OBJECT:
+        case MTP_OPERATION_DELETE_OBJECT:
+        case MTP_OPERATION_SET_OBJECT_REFERENCES:
+        case MTP_OPERATION_SEND_PARTIAL_OBJECT:
+        case MTP_OPERATION_TRUNCATE_OBJECT:
+        case MTP_OPERATION_END_EDIT_OBJECT:
+            clearObjectInfoCache();
+            break;
+    }
+
     if (response == MTP_RESPONSE_TRANSACTION_CANCELLED)
         return false;
     mResponse.setResponseCode(response);
@@ -481,6 +614,7 @@ MtpResponseCode MtpServer::doOpenSession() {
     }
     mSessionID = mRequest.getParameter(1);
     mSessionOpen = true;
+    clearObjectInfoCache();
 
     mDatabase->sessionStarted();
 
@@ -554,6 +688,15 @@ MtpResponseCode MtpServer::doGetObjectHandles() {
 
     MtpObjectHandleList* handles = mDatabase->getObjectList(storageID, format, parent);
     mData.putAUInt32(handles);
+    {
+        // the host lists a folder again to pick up changes, start from fresh info
+        Mutex::Autolock autoLock(mObjectInfoLock);
+        clearObjectInfoCache_l();
+        if (handles)
+            mLastObjectList = *handles;
+        else
+            mLastObjectList.clear();
+    }
     delete handles;
     return MTP_RESPONSE_OK;
 }
@@ -617,6 +760,8 @@ MtpResponseCode MtpServer::doGetObjectPropValue() {
     ALOGV("GetObjectPropValue %d %s\n", handle,
             MtpDebug::getObjectPropCodeName(property));
 
+    if (getCachedObjectPropertyValue(handle, property))
+        return MTP_RESPONSE_OK;
     return mDatabase->getObjectPropertyValue(handle, property, mData);
 }
 
@@ -676,37 +821,38 @@ MtpResponseCode MtpServer::doGetObjectInfo() {
     if (!hasStorage())
         return MTP_RESPONSE_INVALID_OBJECT_HANDLE;
     MtpObjectHandle handle = mRequest.getParameter(1);
-    MtpObjectInfo info(handle);
-    MtpResponseCode result = mDatabase->getObjectInfo(handle, info);
+    Mutex::Autolock autoLock(mObjectInfoLock);
+    MtpObjectInfo* info = getCachedObjectInfo_l(handle);
+    MtpResponseCode result = (info ? MTP_RESPONSE_OK : MTP_RESPONSE_INVALID_OBJECT_HANDLE);
     if (result == MTP_RESPONSE_OK) {
         char    date[20];
 
-        mData.putUInt32(info.mStorageID);
-        mData.putUInt16(info.mFormat);
-        mData.putUInt16(info.mProtectionStatus);
+        mData.putUInt32(info->mStorageID);
+        mData.putUInt16(info->mFormat);
+        mData.putUInt16(info->mProtectionStatus);
 
         // if object is being edited the database size may be out of date
-        uint32_t size = info.mCompressedSize;
+        uint32_t size = info->mCompressedSize;
         ObjectEdit* edit = getEditObject(handle);
         if (edit)
             size = (edit->mSize > 0xFFFFFFFFLL ? 0xFFFFFFFF : (uint32_t)edit->mSize);
         mData.putUInt32(size);
 
-        mData.putUInt16(info.mThumbFormat);
-        mData.putUInt32(info.mThumbCompressedSize);
-        mData.putUInt32(info.mThumbPixWidth);
-        mData.putUInt32(info.mThumbPixHeight);
-        mData.putUInt32(info.mImagePixWidth);
-        mData.putUInt32(info.mImagePixHeight);
-        mData.putUInt32(info.mImagePixDepth);
-        mData.putUInt32(info.mParent);
-        mData.putUInt16(info.mAssociationType);
-        mData.putUInt32(info.mAssociationDesc);
-        mData.putUInt32(info.mSequenceNumber);
-        mData.putString(info.mName);
-        formatDateTime(info.mDateCreated, date, sizeof(date));
+        mData.putUInt16(info->mThumbFormat);
+        mData.putUInt32(info->mThumbCompressedSize);
+        mData.putUInt32(info->mThumbPixWidth);
+        mData.putUInt32(info->mThumbPixHeight);
+        mData.putUInt32(info->mImagePixWidth);
+        mData.putUInt32(info->mImagePixHeight);
+        mData.putUInt32(info->mImagePixDepth);
+        mData.putUInt32(info->mParent);
+        mData.putUInt16(info->mAssociationType);
+        mData.putUInt32(info->mAssociationDesc);
+        mData.putUInt32(info->mSequenceNumber);
+        mData.putString(info->mName);
+        formatDateTime(info->mDateCreated, date, sizeof(date));
         mData.putString(date);   // date created
-        formatDateTime(info.mDateModified, date, sizeof(date));
+        formatDateTime(info->mDateModified, date, sizeof(date));
         mData.putString(date);   // date modified
         mData.putEmptyString();   // keywords
     }
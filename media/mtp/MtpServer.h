@@ -24,11 +24,13 @@
 #include "mtp.h"
 #include "MtpUtils.h"
 
+#include <utils/KeyedVector.h>
 #include <utils/threads.h>
 
 namespace android {
 
 class MtpDatabase;
+class MtpObjectInfo;
 class MtpStorage;
 
 class MtpServer {
@@ -89,6 +91,19 @@ private:
     };
     Vector<ObjectEdit*>  mObjectEditList;
 
+    // object info fetched from the database, so that hosts enumerating a folder
+    // with GetObjectInfo and GetObjectPropValue don't query it once per property.
+    // It only lives until the next GetObjectHandles, which the host sends to see
+    // changes made on the device. Guarded by mObjectInfoLock since the add/remove
+    // notifications arrive on other threads.
+    KeyedVector<MtpObjectHandle, MtpObjectInfo*> mObjectInfoCache;
+    // the last list returned by GetObjectHandles, used to prefetch object info
+    MtpObjectHandleList mLastObjectList;
+    // bumped whenever cached entries are dropped, so that results fetched from
+    // the database with the lock released are not cached past an invalidation
+    uint32_t            mObjectInfoGeneration;
+    Mutex               mObjectInfoLock;
+
 public:
                         MtpServer(int fd, MtpDatabase* database, bool ptp,
                                     int fileGroup, int filePerm, int directoryPerm);
@@ -116,6 +131,14 @@ private:
     void                removeEditObject(MtpObjectHandle handle);
     void                commitEdit(ObjectEdit* edit);
 
+    // releases mObjectInfoLock while it queries the database
+    MtpObjectInfo*      getCachedObjectInfo_l(MtpObjectHandle handle);
+    void                invalidateObjectInfo(MtpObjectHandle handle);
+    void                clearObjectInfoCache();
+    void                clearObjectInfoCache_l();
+    bool                getCachedObjectPropertyValue(MtpObjectHandle handle,
+                                MtpObjectProperty property);
+
     bool                handleRequest();
 
     MtpResponseCode     doGetDeviceInfo();
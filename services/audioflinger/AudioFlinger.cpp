@@ -56,6 +56,7 @@
 #include <powermanager/PowerManager.h>
 
 #include <common_time/cc_helper.h>
+#include <cpustats/ThreadCpuStats.h>
 
 #include <media/IMediaLogService.h>
 
@@ -199,6 +200,12 @@ void AudioFlinger::onFirstRef()
     }
 
     mMode = AUDIO_MODE_NORMAL;
+
+    // monitor the deadlines of the audio threads, a debugging aid so off unless requested
+    if (property_get("af.watchdog", val_str, "0") > 0 && atoi(val_str) != 0) {
+        mDeadlineWatchdog = new AudioWatchdog(kDeadlineWatchdogPeriodMs);
+        mDeadlineWatchdog->run("AudioDeadlineWatchdog", PRIORITY_URGENT_AUDIO);
+    }
 }
 
 AudioFlinger::~AudioFlinger()
@@ -364,6 +371,12 @@ status_t AudioFlinger::dump(int fd, const Vector<String16>& args)
             mRecordThreads.valueAt(i)->dump(fd, args);
         }
 
+        ThreadCpuStats::dump(fd);
+
+        if (mDeadlineWatchdog != 0) {
+            mDeadlineWatchdog->dumpClients(fd);
+        }
+
         // dump all hardware devs
         for (size_t i = 0; i < mAudioHwDevs.size(); i++) {
             audio_hw_device_t *dev = mAudioHwDevs.valueAt(i)->hwDevice();
@@ -1388,7 +1401,8 @@ AudioFlinger::Client::Client(const sp<AudioFlinger>& audioFlinger, pid_t pid)
         // FIXME should be a "k" constant not hard-coded, in .h or ro. property, see 4 lines below
         mMemoryDealer(new MemoryDealer(1024*1024, "AudioFlinger::Client")),
         mPid(pid),
-        mTimedTrackCount(0)
+        mTimedTrackCount(0),
+        mFreeTrackMemorySize(0)
 {
     // 1 MB of address space is good for 32 tracks, 8 buffers each, 4 KB/buffer
 }
@@ -1404,6 +1418,57 @@ sp<MemoryDealer> AudioFlinger::Client::heap() const
     return mMemoryDealer;
 }
 
+sp<IMemory> AudioFlinger::Client::allocateTrackMemory(size_t size)
+{
+    if (size <= kMaxTrackMemorySizeClass) {
+        size_t sizeClass = kMinTrackMemorySizeClass;
+        while (sizeClass < size) {
+            sizeClass <<= 1;
+        }
+        size = sizeClass;
+
+        Mutex::Autolock _l(mTrackMemoryLock);
+        for (size_t i = 0; i < mFreeTrackMemory.size(); ++i) {
+            if (mFreeTrackMemory[i]->size() == size) {
+                sp<IMemory> memory = mFreeTrackMemory[i];
+                mFreeTrackMemory.removeAt(i);
+                mFreeTrackMemorySize -= size;
+                return memory;
+            }
+        }
+    }
+
+    sp<IMemory> memory = mMemoryDealer->allocate(size);
+    if (memory == 0) {
+        // regions held for reuse may be what is keeping the heap full
+        freeTrackMemory();
+        memory = mMemoryDealer->allocate(size);
+    }
+    return memory;
+}
+
+void AudioFlinger::Client::releaseTrackMemory(sp<IMemory>& memory)
+{
+    size_t size = memory->size();
+    // only recycle the region once nobody else, in particular the client process through
+    // binder, still holds it: it could otherwise keep writing into the next track's cblk
+    if (size <= kMaxTrackMemorySizeClass && memory->getStrongCount() == 1) {
+        Mutex::Autolock _l(mTrackMemoryLock);
+        if (mFreeTrackMemorySize + size <= kMaxFreeTrackMemory) {
+            mFreeTrackMemory.push(memory);
+            mFreeTrackMemorySize += size;
+        }
+    }
+    memory.clear();
+}
+
+void AudioFlinger::Client::freeTrackMemory()
+{
+    Mutex::Autolock _l(mTrackMemoryLock);
+    mFreeTrackMemory.clear();
+    mFreeTrackMemorySize = 0;
+}
+
 // Reserve one of the limited slots for a timed audio track associated
 // with this client
 bool AudioFlinger::Client::reserveTimedTrack()
@@ -1695,6 +1760,43 @@ status_t AudioFlinger::setLowRamDevice(bool isLowRamDevice)
     return NO_ERROR;
 }
 
+status_t AudioFlinger::applyUpdates(const Vector<Update>& updates, Vector<status_t> *statuses)
+{
+    // Each update goes through the same entry point as its individual binder call, with the
+    // same permission checks and locking: setParameters() in particular must not hold mLock
+    // while a thread applies the new parameters.  What is saved is the round trip per update.
+    status_t status = NO_ERROR;
+    if (statuses != NULL) {
+        statuses->clear();
+    }
+    for (size_t i = 0; i < updates.size(); i++) {
+        const Update& update = updates[i];
+        status_t lStatus;
+        switch (update.mType) {
+        case Update::STREAM_VOLUME:
+            lStatus = setStreamVolume(update.mStream, update.mValue, update.mIoHandle);
+            break;
+        case Update::PARAMETERS:
+            lStatus = setParameters(update.mIoHandle, update.mKeyValuePairs);
+            break;
+        case Update::VOICE_VOLUME:
+            lStatus = setVoiceVolume(update.mValue);
+            break;
+        default:
+            lStatus = BAD_VALUE;
+            break;
+        }
+        if (lStatus != NO_ERROR && status == NO_ERROR) {
+            status = lStatus;
+        }
+        if (statuses != NULL) {
+            statuses->add(lStatus);
+        }
+    }
+    ALOGV("applyUpdates() %u updates status %d", updates.size(), status);
+    return status;
+}
+
 // ----------------------------------------------------------------------------
 
 audio_io_handle_t AudioFlinger::openOutput(audio_module_handle_t module,
@@ -2702,6 +2804,12 @@ void AudioFlinger::dumpTee(int fd, const sp<NBAIO_Source>& source, audio_io_hand
 {
     NBAIO_Source *teeSource = source.get();
     if (teeSource != NULL) {
+        // before the reads below, which reset the lag
+        NBAIO_Stats stats;
+        if (fd >= 0 && teeSource->getStats(stats) == NO_ERROR) {
+            fdprintf(fd, "tee source: frames read %u, overruns %u (%u frames), lag %u (max %u)\n",
+                    stats.mFrames, stats.mLosses, stats.mFramesLost, stats.mLag, stats.mMaxLag);
+        }
         // .wav rotation
         // There is a benign race condition if 2 threads call this simultaneously.
         // They would both traverse the directory, but the result would simply be
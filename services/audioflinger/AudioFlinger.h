@@ -53,8 +53,10 @@
 #include <media/AudioBufferProvider.h>
 #include <media/ExtendedAudioBufferProvider.h>
 #include "FastMixer.h"
+#include "FastCapture.h"
 #include <media/nbaio/NBAIO.h>
 #include "AudioWatchdog.h"
+#include "ProcessTimeHistogram.h"
 
 #include <powermanager/IPowerManager.h>
 #include <utils/List.h>
@@ -239,6 +241,8 @@ public:
 
     virtual status_t setLowRamDevice(bool isLowRamDevice);
 
+    virtual status_t applyUpdates(const Vector<Update>& updates, Vector<status_t> *statuses);
+
     virtual     status_t    onTransact(
                                 uint32_t code,
                                 const Parcel& data,
@@ -258,7 +262,13 @@ public:
 private:
     static const size_t kLogMemorySize = 10 * 1024;
     sp<MemoryDealer>    mLogMemoryDealer;   // == 0 when NBLog is disabled
+
+    // period of mDeadlineWatchdog, which determines how soon a stall is snapshotted
+    static const unsigned kDeadlineWatchdogPeriodMs = 10;
 public:
+    // monitors the deadlines of all playback, record, and fast mixer threads,
+    // == 0 unless enabled by property af.watchdog
+    sp<AudioWatchdog>   mDeadlineWatchdog;
 
     class SyncEvent;
 
@@ -349,6 +359,11 @@ private:
         bool reserveTimedTrack();
         void releaseTimedTrack();
 
+        // Track cblk+buffer regions from heap(). Small regions are rounded up to a
+        // power of two size class and kept for the next track once released.
+        sp<IMemory>         allocateTrackMemory(size_t size);
+        void                releaseTrackMemory(sp<IMemory>& memory);
+
     private:
                             Client(const Client&);
                             Client& operator = (const Client&);
@@ -358,6 +373,16 @@ private:
 
         Mutex               mTimedTrackLock;
         int                 mTimedTrackCount;
+
+        static const size_t kMinTrackMemorySizeClass = 4 * 1024;
+        static const size_t kMaxTrackMemorySizeClass = 64 * 1024;
+        static const size_t kMaxFreeTrackMemory = 256 * 1024;
+
+        void                freeTrackMemory();
+
+        Mutex               mTrackMemoryLock;
+        Vector< sp<IMemory> > mFreeTrackMemory;
+        size_t              mFreeTrackMemorySize;
     };
 
     // --- Notification Client ---
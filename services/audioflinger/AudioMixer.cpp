@@ -26,6 +26,7 @@
 
 #include <utils/Errors.h>
 #include <utils/Log.h>
+#include <utils/Timers.h>
 
 #include <cutils/bitops.h>
 #include <cutils/compiler.h>
@@ -41,8 +42,206 @@
 
 #include "AudioMixer.h"
 
+#if defined(__arm__) && !defined(__thumb__)
+#define USE_INLINE_ASSEMBLY (true)
+#else
+#define USE_INLINE_ASSEMBLY (false)
+#endif
+
+#if USE_INLINE_ASSEMBLY && defined(__ARM_NEON__)
+#define USE_NEON (true)
+#else
+#define USE_NEON (false)
+#endif
+
 namespace android {
 
+// ----------------------------------------------------------------------------
+
+// NEON versions of the constant gain inner loops. Each of them consumes frameCount rounded
+// down to a multiple of 4 and updates in, out and frameCount, leaving the remaining frames
+// to the scalar code.  The results are bit-exact with the scalar code: vmlal.s16 performs the
+// same 16x16+32 multiply-accumulate as mulAdd()/mulAddRL(), and vqshrn.s32 the same
+// shift and saturation as clamp16().
+
+static inline void mixStereo16ConstantGain(int32_t*& out, const int16_t*& in,
+        size_t& frameCount, uint32_t vrl)
+{
+#if USE_NEON
+    size_t count = frameCount & ~3;
+    if (count == 0) {
+        return;
+    }
+    frameCount -= count;
+    asm (
+        "vdup.32        d4, %[vrl]               \n"    // d4 = vl, vr, vl, vr
+        "1:                                      \n"
+        "vld1.16        {d0, d1}, [%[in]]!       \n"    // load 4 16-bits stereo frames
+        "vld1.32        {d16-d19}, [%[out]]      \n"    // load 4 32-bits stereo accumulators
+        "subs           %[count], %[count], #4   \n"    // update loop counter
+        "vmlal.s16      q8, d0, d4               \n"    // accumulate frames 0 and 1
+        "vmlal.s16      q9, d1, d4               \n"    // accumulate frames 2 and 3
+        "vst1.32        {d16-d19}, [%[out]]!     \n"    // store accumulators
+        "bne            1b                       \n"    // loop
+        : [out]     "+r" (out),
+          [in]      "+r" (in),
+          [count]   "+r" (count)
+        : [vrl]     "r" (vrl)
+        : "cc", "memory",
+          "q0", "q2", "q8", "q9"
+    );
+#endif
+}
+
+static inline void mixMono16ConstantGain(int32_t*& out, const int16_t*& in,
+        size_t& frameCount, uint32_t vrl)
+{
+#if USE_NEON
+    size_t count = frameCount & ~3;
+    if (count == 0) {
+        return;
+    }
+    frameCount -= count;
+    asm (
+        "vdup.32        d4, %[vrl]               \n"    // d4 = vl, vr, vl, vr
+        "1:                                      \n"
+        "vld1.16        {d0}, [%[in]]!           \n"    // load 4 16-bits mono samples
+        "vld1.32        {d16-d19}, [%[out]]      \n"    // load 4 32-bits stereo accumulators
+        "vmov           d1, d0                   \n"
+        "vzip.16        d0, d1                   \n"    // duplicate each sample to L and R
+        "subs           %[count], %[count], #4   \n"    // update loop counter
+        "vmlal.s16      q8, d0, d4               \n"    // accumulate frames 0 and 1
+        "vmlal.s16      q9, d1, d4               \n"    // accumulate frames 2 and 3
+        "vst1.32        {d16-d19}, [%[out]]!     \n"    // store accumulators
+        "bne            1b                       \n"    // loop
+        : [out]     "+r" (out),
+          [in]      "+r" (in),
+          [count]   "+r" (count)
+        : [vrl]     "r" (vrl)
+        : "cc", "memory",
+          "q0", "q2", "q8", "q9"
+    );
+#endif
+}
+
+// out and in may point to packed 16-bit stereo frames in the same buffer, as the loop never
+// writes ahead of what it reads.
+static inline void scaleStereo16ConstantGain(int32_t*& out, const int16_t*& in,
+        size_t& frameCount, uint32_t vrl)
+{
+#if USE_NEON
+    size_t count = frameCount & ~3;
+    if (count == 0) {
+        return;
+    }
+    frameCount -= count;
+    asm (
+        "vdup.32        d4, %[vrl]               \n"    // d4 = vl, vr, vl, vr
+        "1:                                      \n"
+        "vld1.16        {d0, d1}, [%[in]]!       \n"    // load 4 16-bits stereo frames
+        "subs           %[count], %[count], #4   \n"    // update loop counter
+        "vmull.s16      q8, d0, d4               \n"    // apply volume to frames 0 and 1
+        "vmull.s16      q9, d1, d4               \n"    // apply volume to frames 2 and 3
+        "vqshrn.s32     d0, q8, #12              \n"    // back to 16 bits and clamp
+        "vqshrn.s32     d1, q9, #12              \n"    // back to 16 bits and clamp
+        "vst1.16        {d0, d1}, [%[out]]!      \n"    // store 4 16-bits stereo frames
+        "bne            1b                       \n"    // loop
+        : [out]     "+r" (out),
+          [in]      "+r" (in),
+          [count]   "+r" (count)
+        : [vrl]     "r" (vrl)
+        : "cc", "memory",
+          "q0", "q2", "q8", "q9"
+    );
+#endif
+}
+
+// Same as ditherAndClamp() from audio_utils, which is a scalar loop.
+static inline void clampStereo16(int32_t* out, const int32_t* sums, size_t frameCount)
+{
+#if USE_NEON
+    size_t count = frameCount & ~3;
+    if (count != 0) {
+        asm (
+            "1:                                      \n"
+            "vld1.32        {d16-d19}, [%[sums]]!    \n"    // load 4 32-bits stereo sums
+            "subs           %[count], %[count], #4   \n"    // update loop counter
+            "vqshrn.s32     d0, q8, #12              \n"    // back to 16 bits and clamp
+            "vqshrn.s32     d1, q9, #12              \n"    // back to 16 bits and clamp
+            "vst1.16        {d0, d1}, [%[out]]!      \n"    // store 4 16-bits stereo frames
+            "bne            1b                       \n"    // loop
+            : [out]     "+r" (out),
+              [sums]    "+r" (sums),
+              [count]   "+r" (count)
+            :
+            : "cc", "memory",
+              "q0", "q8", "q9"
+        );
+        frameCount -= frameCount & ~3;
+    }
+#endif
+    if (frameCount) {
+        ditherAndClamp(out, sums, frameCount);
+    }
+}
+
+// Writes frameCount stereo frames of Q4.27 sums to out in the given mixer format,
+// and returns out advanced past the frames written.
+static inline int32_t* writeMixerOutput(int32_t* out, audio_format_t format,
+        const int32_t* sums, size_t frameCount)
+{
+    if (CC_LIKELY(format == AUDIO_FORMAT_PCM_16_BIT)) {
+        clampStereo16(out, sums, frameCount);
+        return out + frameCount;
+    }
+    // AUDIO_FORMAT_PCM_8_24_BIT: Q4.27 to Q8.23, which has enough headroom to avoid clamping
+    for (size_t i = 0; i < frameCount * 2; i++) {
+        out[i] = sums[i] >> 4;
+    }
+    return out + frameCount * 2;
+}
+
+// Same as writeMixerOutput() for any number of channels, with sampleCount = frames * channels.
+static inline void writeMixerOutputMultichannel(int32_t* out, audio_format_t format,
+        const int32_t* sums, size_t sampleCount)
+{
+    if (CC_LIKELY(format == AUDIO_FORMAT_PCM_16_BIT)) {
+        int16_t *out16 = reinterpret_cast<int16_t *>(out);
+        for (size_t i = 0; i < sampleCount; i++) {
+            out16[i] = clamp16(sums[i] >> 12);
+        }
+        return;
+    }
+    for (size_t i = 0; i < sampleCount; i++) {
+        out[i] = sums[i] >> 4;
+    }
+}
+
+static inline size_t mixerFrameSize(audio_format_t format, uint32_t channelCount)
+{
+    return (format == AUDIO_FORMAT_PCM_16_BIT ? sizeof(int16_t) : sizeof(int32_t)) * channelCount;
+}
+
+// Side of each channel of a channel mask, in interleaved order:
+// 0 for the left channels, 1 for the right channels, 2 for the others.
+static inline void getChannelSides(audio_channel_mask_t mask, uint8_t *sides)
+{
+    static const uint32_t kLeftMask = AUDIO_CHANNEL_OUT_FRONT_LEFT |
+            AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER | AUDIO_CHANNEL_OUT_BACK_LEFT |
+            AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT |
+            AUDIO_CHANNEL_OUT_TOP_BACK_LEFT;
+    static const uint32_t kRightMask = AUDIO_CHANNEL_OUT_FRONT_RIGHT |
+            AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER | AUDIO_CHANNEL_OUT_BACK_RIGHT |
+            AUDIO_CHANNEL_OUT_SIDE_RIGHT | AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT |
+            AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT;
+    uint32_t bits = mask;
+    while (bits) {
+        const uint32_t bit = bits & -bits;
+        bits &= ~bit;
+        *sides++ = (bit & kLeftMask) ? 0 : (bit & kRightMask) ? 1 : 2;
+    }
+}
+
 // ----------------------------------------------------------------------------
 AudioMixer::DownmixerBufferProvider::DownmixerBufferProvider() : AudioBufferProvider(),
         mTrackBufferProvider(NULL), mDownmixHandle(NULL)
@@ -124,7 +323,8 @@ AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTr
     mState.outputTemp   = NULL;
     mState.resampleTemp = NULL;
     mState.mLog         = &mDummyLog;
-    // mState.reserved
+    mState.multichannelTemp = NULL;
+    mState.trackTiming  = false;
 
     // FIXME Most of the following initialization is probably redundant since
     // tracks[i] should only be referenced if (mTrackNames & (1 << i)) != 0
@@ -133,6 +333,7 @@ AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTr
     for (unsigned i=0 ; i < MAX_NUM_TRACKS ; i++) {
         t->resampler = NULL;
         t->downmixerBufferProvider = NULL;
+        t->processNs = 0;
         t++;
     }
 
@@ -169,6 +370,7 @@ AudioMixer::~AudioMixer()
     }
     delete [] mState.outputTemp;
     delete [] mState.resampleTemp;
+    delete [] mState.multichannelTemp;
 }
 
 void AudioMixer::setLog(NBLog::Writer *log)
@@ -216,6 +418,11 @@ int AudioMixer::getTrackName(audio_channel_mask_t channelMask, int sessionId)
         t->mainBuffer = NULL;
         t->auxBuffer = NULL;
         t->downmixerBufferProvider = NULL;
+        t->mixerFormat = AUDIO_FORMAT_PCM_16_BIT;
+        t->mixerChannelMask = AUDIO_CHANNEL_OUT_STEREO;
+        t->mixerChannelCount = MAX_NUM_CHANNELS;
+        t->resamplerQuality = AudioResampler::DEFAULT_QUALITY;
+        t->processNs = 0;
 
         status_t status = initTrackDownmix(&mState.tracks[n], n, channelMask);
         if (status == OK) {
@@ -240,7 +447,10 @@ status_t AudioMixer::initTrackDownmix(track_t* pTrack, int trackNum, audio_chann
     uint32_t channelCount = popcount(mask);
     ALOG_ASSERT((channelCount <= MAX_NUM_CHANNELS_TO_DOWNMIX) && channelCount);
     status_t status = OK;
-    if (channelCount > MAX_NUM_CHANNELS) {
+    // a track with the same channel mask as its main buffer is mixed natively,
+    // but the resamplers only support up to 2 channels
+    if (channelCount > MAX_NUM_CHANNELS &&
+            (mask != pTrack->mixerChannelMask || pTrack->doesResample())) {
         pTrack->channelMask = mask;
         pTrack->channelCount = channelCount;
         ALOGV("initTrackDownmix(track=%d, mask=0x%x) calls prepareTrackForDownmix()",
@@ -441,6 +651,20 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
                 invalidateState(1 << name);
             }
             } break;
+        case MIXER_CHANNEL_MASK: {
+            audio_channel_mask_t mask = (audio_channel_mask_t) value;
+            if (track.mixerChannelMask != mask) {
+                uint32_t channelCount = popcount(mask);
+                ALOG_ASSERT((channelCount <= MAX_NUM_CHANNELS_TO_DOWNMIX) &&
+                        (channelCount >= MAX_NUM_CHANNELS), "bad mixer channel mask %#x", mask);
+                track.mixerChannelMask = mask;
+                track.mixerChannelCount = channelCount;
+                // this may change whether the track needs a downmixer
+                initTrackDownmix(&mState.tracks[name], name, track.channelMask);
+                ALOGV("setParameter(TRACK, MIXER_CHANNEL_MASK, %x)", mask);
+                invalidateState(1 << name);
+            }
+            } break;
         case MAIN_BUFFER:
             if (track.mainBuffer != valueBuf) {
                 track.mainBuffer = valueBuf;
@@ -458,6 +682,16 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
         case FORMAT:
             ALOG_ASSERT(valueInt == AUDIO_FORMAT_PCM_16_BIT);
             break;
+        case MIXER_FORMAT: {
+            audio_format_t format = (audio_format_t) valueInt;
+            ALOG_ASSERT(format == AUDIO_FORMAT_PCM_16_BIT ||
+                    format == AUDIO_FORMAT_PCM_8_24_BIT, "bad mixer format %#x", format);
+            if (track.mixerFormat != format) {
+                track.mixerFormat = format;
+                ALOGV("setParameter(TRACK, MIXER_FORMAT, %#x)", format);
+                invalidateState(1 << name);
+            }
+            } break;
         // FIXME do we want to support setting the downmix type from AudioFlinger?
         //         for a specific track? or per mixer?
         /* case DOWNMIX_TYPE:
@@ -474,6 +708,11 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
             if (track.setResampler(uint32_t(valueInt), mSampleRate)) {
                 ALOGV("setParameter(RESAMPLE, SAMPLE_RATE, %u)",
                         uint32_t(valueInt));
+                if (track.channelCount > MAX_NUM_CHANNELS &&
+                        track.downmixerBufferProvider == NULL) {
+                    // a natively mixed multichannel track now needs a downmixer
+                    initTrackDownmix(&mState.tracks[name], name, track.channelMask);
+                }
                 invalidateState(1 << name);
             }
             break;
@@ -485,8 +724,18 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
             delete track.resampler;
             track.resampler = NULL;
             track.sampleRate = mSampleRate;
+            if (track.downmixerBufferProvider != NULL &&
+                    track.channelMask == track.mixerChannelMask) {
+                // the track may now be mixed natively
+                initTrackDownmix(&mState.tracks[name], name, track.channelMask);
+            }
             invalidateState(1 << name);
             break;
+        case QUALITY:
+            ALOG_ASSERT(valueInt >= AudioResampler::DEFAULT_QUALITY &&
+                    valueInt <= AudioResampler::VERY_HIGH_QUALITY, "bad quality %d", valueInt);
+            track.resamplerQuality = uint8_t(valueInt);
+            break;
         default:
             LOG_FATAL("bad param");
         }
@@ -557,7 +806,10 @@ bool AudioMixer::track_t::setResampler(uint32_t value, uint32_t devSampleRate)
                 // FIXME this is flawed for dynamic sample rates, as we choose the resampler
                 // quality level based on the initial ratio, but that could change later.
                 // Should have a way to distinguish tracks with static ratios vs. dynamic ratios.
-                if (!((value == 44100 && devSampleRate == 48000) ||
+                if (resamplerQuality != AudioResampler::DEFAULT_QUALITY) {
+                    // explicitly requested, e.g. by the fast mixer which needs a bounded cost
+                    quality = AudioResampler::src_quality(resamplerQuality);
+                } else if (!((value == 44100 && devSampleRate == 48000) ||
                       (value == 48000 && devSampleRate == 44100))) {
                     quality = AudioResampler::LOW_QUALITY;
                 } else {
@@ -565,11 +817,14 @@ bool AudioMixer::track_t::setResampler(uint32_t value, uint32_t devSampleRate)
                 }
                 resampler = AudioResampler::create(
                         format,
-                        // the resampler sees the number of channels after the downmixer, if any
-                        downmixerBufferProvider != NULL ? MAX_NUM_CHANNELS : channelCount,
+                        // the resampler sees the number of channels after the downmixer,
+                        // which is set up by the caller if not already there
+                        channelCount > MAX_NUM_CHANNELS ? MAX_NUM_CHANNELS : channelCount,
                         devSampleRate, quality);
                 resampler->setLocalTimeFreq(sLocalTimeFreq);
             }
+            // let the resampler prepare for the new ratio now rather than in the mix loop
+            resampler->setSampleRate(value);
             return true;
         }
     }
@@ -629,7 +884,22 @@ void AudioMixer::setBufferProvider(int name, AudioBufferProvider* bufferProvider
 
 void AudioMixer::process(int64_t pts)
 {
+    if (CC_LIKELY(!mState.trackTiming)) {
+        mState.hook(&mState, pts);
+        return;
+    }
+    uint32_t names = mTrackNames;
+    while (names) {
+        const int i = 31 - __builtin_clz(names);
+        names &= ~(1 << i);
+        mState.tracks[i].processNs = 0;
+    }
+    nsecs_t start = systemTime();
     mState.hook(&mState, pts);
+    if (mState.hook == process__OneTrack16BitsStereoNoResampling) {
+        // the whole mix is for this one track
+        mState.tracks[31 - __builtin_clz(mState.enabledTracks)].processNs = systemTime() - start;
+    }
 }
 
 
@@ -659,6 +929,7 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
     bool all16BitsStereoNoResample = true;
     bool resampling = false;
     bool volumeRamp = false;
+    bool multichannel = false;
     uint32_t en = state->enabledTracks;
     while (en) {
         const int i = 31 - __builtin_clz(en);
@@ -681,6 +952,16 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
         }
         t.needs = n;
 
+        if (t.mixerFormat != AUDIO_FORMAT_PCM_16_BIT) {
+            // process__OneTrack16BitsStereoNoResampling only writes 16-bit output
+            all16BitsStereoNoResample = false;
+        }
+        if (t.mixerChannelCount > MAX_NUM_CHANNELS) {
+            // only process__genericResampling handles multichannel main buffers
+            all16BitsStereoNoResample = false;
+            multichannel = true;
+        }
+
         if ((n & NEEDS_MUTE__MASK) == NEEDS_MUTE_ENABLED) {
             t.hook = track__nop;
         } else {
@@ -703,6 +984,11 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
                     ALOGV_IF((n & NEEDS_CHANNEL_COUNT__MASK) > NEEDS_CHANNEL_2,
                             "Track %d needs downmix", i);
                 }
+                if ((n & NEEDS_CHANNEL_COUNT__MASK) > NEEDS_CHANNEL_2 &&
+                        t.downmixerBufferProvider == NULL &&
+                        t.channelMask == t.mixerChannelMask) {
+                    t.hook = track__16BitsMultichannel;
+                }
             }
         }
     }
@@ -710,7 +996,16 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
     // select the processing hooks
     state->hook = process__nop;
     if (countActiveTracks) {
-        if (resampling) {
+        if (multichannel) {
+            if (!state->multichannelTemp) {
+                state->multichannelTemp =
+                        new int32_t[MAX_NUM_CHANNELS_TO_DOWNMIX * state->frameCount];
+            }
+        } else if (state->multichannelTemp) {
+            delete [] state->multichannelTemp;
+            state->multichannelTemp = NULL;
+        }
+        if (resampling || multichannel) {
             if (!state->outputTemp) {
                 state->outputTemp = new int32_t[MAX_NUM_CHANNELS * state->frameCount];
             }
@@ -737,9 +1032,9 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
     }
 
     ALOGV("mixer configuration change: %d activeTracks (%08x) "
-        "all16BitsStereoNoResample=%d, resampling=%d, volumeRamp=%d",
+        "all16BitsStereoNoResample=%d, resampling=%d, volumeRamp=%d, multichannel=%d",
         countActiveTracks, state->enabledTracks,
-        all16BitsStereoNoResample, resampling, volumeRamp);
+        all16BitsStereoNoResample, resampling, volumeRamp, multichannel);
 
    state->hook(state, pts);
 
@@ -961,13 +1256,14 @@ void AudioMixer::track__16BitsStereo(track_t* t, int32_t* out, size_t frameCount
         // constant gain
         else {
             const uint32_t vrl = t->volumeRL;
-            do {
+            mixStereo16ConstantGain(out, in, frameCount, vrl);
+            while (frameCount--) {
                 uint32_t rl = *reinterpret_cast<const uint32_t *>(in);
                 in += 2;
                 out[0] = mulAddRL(1, rl, vrl, out[0]);
                 out[1] = mulAddRL(0, rl, vrl, out[1]);
                 out += 2;
-            } while (--frameCount);
+            }
         }
     }
     t->in = in;
@@ -1049,22 +1345,70 @@ void AudioMixer::track__16BitsMono(track_t* t, int32_t* out, size_t frameCount,
         else {
             const int16_t vl = t->volume[0];
             const int16_t vr = t->volume[1];
-            do {
+            mixMono16ConstantGain(out, in, frameCount, t->volumeRL);
+            while (frameCount--) {
                 int16_t l = *in++;
                 out[0] = mulAdd(l, vl, out[0]);
                 out[1] = mulAdd(l, vr, out[1]);
                 out += 2;
-            } while (--frameCount);
+            }
         }
     }
     t->in = in;
 }
 
+// multichannel track mixed natively into a main buffer with the same channel mask,
+// volume[0] applies to the left channels, volume[1] to the right ones and their average to
+// the others.
+void AudioMixer::track__16BitsMultichannel(track_t* t, int32_t* out, size_t frameCount,
+        int32_t* temp, int32_t* aux)
+{
+    const int16_t *in = static_cast<const int16_t *>(t->in);
+    const uint32_t channelCount = t->channelCount;
+    uint8_t sides[MAX_NUM_CHANNELS_TO_DOWNMIX];
+    getChannelSides(t->channelMask, sides);
+
+    // prevVolume and prevAuxLevel are the constant gain << 16 when not ramping
+    int32_t vl = t->prevVolume[0];
+    int32_t vr = t->prevVolume[1];
+    const int32_t vlInc = t->volumeInc[0];
+    const int32_t vrInc = t->volumeInc[1];
+    int32_t va = t->prevAuxLevel;
+    const int32_t vaInc = aux != NULL ? t->auxInc : 0;
+
+    do {
+        int32_t v[3];
+        v[0] = vl >> 16;
+        v[1] = vr >> 16;
+        v[2] = (v[0] + v[1]) >> 1;
+        for (uint32_t c = 0; c < channelCount; c++) {
+            out[c] += v[sides[c]] * in[c];
+        }
+        if (CC_UNLIKELY(aux != NULL)) {
+            *aux++ += (va >> 17) * ((int32_t)in[0] + in[1]);
+            va += vaInc;
+        }
+        in += channelCount;
+        out += channelCount;
+        vl += vlInc;
+        vr += vrInc;
+    } while (--frameCount);
+
+    if (CC_UNLIKELY(vlInc | vrInc | vaInc)) {
+        t->prevVolume[0] = vl;
+        t->prevVolume[1] = vr;
+        if (aux != NULL) {
+            t->prevAuxLevel = va;
+        }
+        t->adjustVolumeRamp(aux != NULL);
+    }
+    t->in = in;
+}
+
 // no-op case
 void AudioMixer::process__nop(state_t* state, int64_t pts)
 {
     uint32_t e0 = state->enabledTracks;
-    size_t bufSize = state->frameCount * sizeof(int16_t) * MAX_NUM_CHANNELS;
     while (e0) {
         // process by group of tracks with same output buffer to
         // avoid multiple memset() on same buffer
@@ -1083,7 +1427,8 @@ void AudioMixer::process__nop(state_t* state, int64_t pts)
             }
             e0 &= ~(e1);
 
-            memset(t1.mainBuffer, 0, bufSize);
+            memset(t1.mainBuffer, 0, state->frameCount *
+                    mixerFrameSize(t1.mixerFormat, t1.mixerChannelCount));
         }
 
         while (e1) {
@@ -1145,7 +1490,7 @@ void AudioMixer::process__genericNoResampling(state_t* state, int64_t pts)
             }
         }
         e0 &= ~(e1);
-        // this assumes output 16 bits stereo, no resampling
+        // this assumes output stereo, no resampling
         int32_t *out = t1.mainBuffer;
         size_t numFrames = 0;
         do {
@@ -1163,8 +1508,12 @@ void AudioMixer::process__genericNoResampling(state_t* state, int64_t pts)
                 while (outFrames) {
                     size_t inFrames = (t.frameCount > outFrames)?outFrames:t.frameCount;
                     if (inFrames) {
+                        nsecs_t start = CC_UNLIKELY(state->trackTiming) ? systemTime() : 0;
                         t.hook(&t, outTemp + (BLOCKSIZE-outFrames)*MAX_NUM_CHANNELS, inFrames,
                                 state->resampleTemp, aux);
+                        if (CC_UNLIKELY(state->trackTiming)) {
+                            t.processNs += systemTime() - start;
+                        }
                         t.frameCount -= inFrames;
                         outFrames -= inFrames;
                         if (CC_UNLIKELY(aux != NULL)) {
@@ -1188,8 +1537,7 @@ void AudioMixer::process__genericNoResampling(state_t* state, int64_t pts)
                     }
                 }
             }
-            ditherAndClamp(out, outTemp, BLOCKSIZE);
-            out += BLOCKSIZE;
+            out = writeMixerOutput(out, t1.mixerFormat, outTemp, BLOCKSIZE);
             numFrames += BLOCKSIZE;
         } while (numFrames < state->frameCount);
     }
@@ -1206,6 +1554,9 @@ void AudioMixer::process__genericNoResampling(state_t* state, int64_t pts)
 
 
 // generic code with resampling
+// This is also used when any track is mixed into a multichannel main buffer: tracks with the
+// same channel mask as the main buffer are mixed natively at full channel count, and all the
+// other tracks are mixed in stereo and then added to the front left and right channels.
 void AudioMixer::process__genericResampling(state_t* state, int64_t pts)
 {
     // this const just means that local variable outTemp doesn't change
@@ -1232,22 +1583,41 @@ void AudioMixer::process__genericResampling(state_t* state, int64_t pts)
         }
         e0 &= ~(e1);
         int32_t *out = t1.mainBuffer;
-        memset(outTemp, 0, size);
+        const uint32_t outChannels = t1.mixerChannelCount;
+        int32_t* const multiTemp = state->multichannelTemp;
+        if (CC_UNLIKELY(outChannels > MAX_NUM_CHANNELS)) {
+            memset(multiTemp, 0, sizeof(int32_t) * outChannels * numFrames);
+        } else {
+            memset(outTemp, 0, size);
+        }
         while (e1) {
             const int i = 31 - __builtin_clz(e1);
             e1 &= ~(1<<i);
             track_t& t = state->tracks[i];
+            nsecs_t start = CC_UNLIKELY(state->trackTiming) ? systemTime() : 0;
             int32_t *aux = NULL;
             if (CC_UNLIKELY((t.needs & NEEDS_AUX__MASK) == NEEDS_AUX_ENABLED)) {
                 aux = t.auxBuffer;
             }
 
+            // where this track is accumulated, and its number of channels there
+            int32_t *trackOut = outTemp;
+            uint32_t trackChannels = MAX_NUM_CHANNELS;
+            if (CC_UNLIKELY(outChannels > MAX_NUM_CHANNELS)) {
+                if (t.hook == track__16BitsMultichannel) {
+                    trackOut = multiTemp;
+                    trackChannels = outChannels;
+                } else {
+                    memset(outTemp, 0, size);
+                }
+            }
+
             // this is a little goofy, on the resampling case we don't
             // acquire/release the buffers because it's done by
             // the resampler.
             if ((t.needs & NEEDS_RESAMPLE__MASK) == NEEDS_RESAMPLE_ENABLED) {
                 t.resampler->setPTS(pts);
-                t.hook(&t, outTemp, numFrames, state->resampleTemp, aux);
+                t.hook(&t, trackOut, numFrames, state->resampleTemp, aux);
             } else {
 
                 size_t outFrames = 0;
@@ -1264,14 +1634,33 @@ void AudioMixer::process__genericResampling(state_t* state, int64_t pts)
                     if (CC_UNLIKELY(aux != NULL)) {
                         aux += outFrames;
                     }
-                    t.hook(&t, outTemp + outFrames*MAX_NUM_CHANNELS, t.buffer.frameCount,
+                    t.hook(&t, trackOut + outFrames*trackChannels, t.buffer.frameCount,
                             state->resampleTemp, aux);
                     outFrames += t.buffer.frameCount;
                     t.bufferProvider->releaseBuffer(&t.buffer);
                 }
             }
+
+            if (CC_UNLIKELY(trackOut != multiTemp && outChannels > MAX_NUM_CHANNELS)) {
+                // add the stereo mix of this track to the front left and right channels
+                const int32_t *in = outTemp;
+                int32_t *acc = multiTemp;
+                for (size_t k = 0; k < numFrames; k++) {
+                    acc[0] += in[0];
+                    acc[1] += in[1];
+                    in += MAX_NUM_CHANNELS;
+                    acc += outChannels;
+                }
+            }
+            if (CC_UNLIKELY(state->trackTiming)) {
+                t.processNs = systemTime() - start;
+            }
+        }
+        if (CC_UNLIKELY(outChannels > MAX_NUM_CHANNELS)) {
+            writeMixerOutputMultichannel(out, t1.mixerFormat, multiTemp, numFrames * outChannels);
+        } else {
+            writeMixerOutput(out, t1.mixerFormat, outTemp, numFrames);
         }
-        ditherAndClamp(out, outTemp, numFrames);
     }
 }
 
@@ -1312,10 +1701,12 @@ void AudioMixer::process__OneTrack16BitsStereoNoResampling(state_t* state,
         }
         size_t outFrames = b.frameCount;
 
+        // the NEON loop always clamps, which is a no-op when the volume is not boosted
+        scaleStereo16ConstantGain(out, in, outFrames, vrl);
         if (CC_UNLIKELY(uint32_t(vl) > UNITY_GAIN || uint32_t(vr) > UNITY_GAIN)) {
             // volume is boosted, so we might need to clamp even though
             // we process only one track.
-            do {
+            while (outFrames--) {
                 uint32_t rl = *reinterpret_cast<const uint32_t *>(in);
                 in += 2;
                 int32_t l = mulRL(1, rl, vrl) >> 12;
@@ -1324,15 +1715,15 @@ void AudioMixer::process__OneTrack16BitsStereoNoResampling(state_t* state,
                 l = clamp16(l);
                 r = clamp16(r);
                 *out++ = (r<<16) | (l & 0xFFFF);
-            } while (--outFrames);
+            }
         } else {
-            do {
+            while (outFrames--) {
                 uint32_t rl = *reinterpret_cast<const uint32_t *>(in);
                 in += 2;
                 int32_t l = mulRL(1, rl, vrl) >> 12;
                 int32_t r = mulRL(0, rl, vrl) >> 12;
                 *out++ = (r<<16) | (l & 0xFFFF);
-            } while (--outFrames);
+            }
         }
         numFrames -= b.frameCount;
         t.bufferProvider->releaseBuffer(&b);
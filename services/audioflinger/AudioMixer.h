@@ -48,7 +48,8 @@ public:
     static const uint32_t MAX_NUM_TRACKS = 32;
     // maximum number of channels supported by the mixer
 
-    // This mixer has a hard-coded upper limit of 2 channels for output.
+    // This mixer has a hard-coded upper limit of 2 channels for output, except for
+    // main buffers configured with a MIXER_CHANNEL_MASK of up to MAX_NUM_CHANNELS_TO_DOWNMIX.
     // There is support for > 2 channel tracks down-mixed to 2 channel output via a down-mix effect.
     // Adding support for > 2 channel output would require more than simply changing this value.
     static const uint32_t MAX_NUM_CHANNELS = 2;
@@ -77,6 +78,14 @@ public:
         MAIN_BUFFER     = 0x4002,
         AUX_BUFFER      = 0x4003,
         DOWNMIX_TYPE    = 0X4004,
+        MIXER_FORMAT    = 0x4005, // format of the main buffer: AUDIO_FORMAT_PCM_16_BIT (default),
+                                  // or AUDIO_FORMAT_PCM_8_24_BIT to get the unclamped mix with
+                                  // its full headroom, for a single conversion at the sink.
+        MIXER_CHANNEL_MASK = 0x4006, // channel mask of the main buffer, AUDIO_CHANNEL_OUT_STEREO
+                                  // by default. Tracks with this same channel mask are mixed at
+                                  // full channel count without a downmixer, unless they need
+                                  // resampling; other tracks go to the front left and right.
+                                  // All tracks sharing a main buffer must use the same mask.
         // for target RESAMPLE
         SAMPLE_RATE     = 0x4100, // Configure sample rate conversion on this track name;
                                   // parameter 'value' is the new sample rate in Hz.
@@ -89,6 +98,11 @@ public:
                                   // This clears out the resampler's input buffer.
         REMOVE          = 0x4102, // Remove the sample rate converter on this track name;
                                   // the track is restored to the mix sample rate.
+        QUALITY         = 0x4103, // Select the sample rate converter quality for this track name;
+                                  // parameter 'value' is an AudioResampler::src_quality.
+                                  // DEFAULT_QUALITY (the default) lets the mixer choose based on
+                                  // the ratio. Takes effect the next time a converter is created,
+                                  // so set it before SAMPLE_RATE.
         // for target RAMP_VOLUME and VOLUME (8 channels max)
         VOLUME0         = 0x4200,
         VOLUME1         = 0x4201,
@@ -117,6 +131,16 @@ public:
 
     size_t      getUnreleasedFrames(int name) const;
 
+    // Enable measurement of the time spent on each track by process(), including its buffer
+    // provider, resampler and volume.  Costs two clock reads per track and mix block,
+    // so it is meant for the normal mixer rather than the fast mixer.
+    void        setTrackTiming(bool enabled) { mState.trackTiming = enabled; }
+
+    // Time spent on the track by the last process(), in nanoseconds,
+    // or 0 if it was not mixed or track timing is disabled
+    uint32_t    getProcessTimeNs(int name) const {
+                    return mState.tracks[name - TRACK0].processNs; }
+
 private:
 
     enum {
@@ -201,10 +225,18 @@ private:
 
         int32_t     sessionId;
 
-        int32_t     padding[2];
+        audio_format_t mixerFormat; // format of mainBuffer, see MIXER_FORMAT
+
+        uint8_t     mixerChannelCount; // 2 to MAX_NUM_CHANNELS_TO_DOWNMIX, see MIXER_CHANNEL_MASK
+        uint8_t     resamplerQuality; // AudioResampler::src_quality, see QUALITY
+        uint8_t     padding[2];
 
         // 16-byte boundary
 
+        audio_channel_mask_t mixerChannelMask;
+        uint32_t    processNs;      // time spent mixing this track in the last process(),
+                                    // only measured if state_t::trackTiming
+
         bool        setResampler(uint32_t sampleRate, uint32_t devSampleRate);
         bool        doesResample() const { return resampler != NULL; }
         void        resetResampler() { if (resampler != NULL) resampler->reset(); }
@@ -222,7 +254,8 @@ private:
         int32_t         *outputTemp;
         int32_t         *resampleTemp;
         NBLog::Writer*  mLog;
-        int32_t         reserved[1];
+        int32_t         *multichannelTemp;  // only allocated if a main buffer is multichannel
+        bool            trackTiming;        // whether to measure track_t::processNs
         // FIXME allocate dynamically to save some memory when maxNumTracks < MAX_NUM_TRACKS
         track_t         tracks[MAX_NUM_TRACKS]; __attribute__((aligned(32)));
     };
@@ -275,6 +308,8 @@ private:
             int32_t* aux);
     static void track__16BitsMono(track_t* t, int32_t* out, size_t numFrames, int32_t* temp,
             int32_t* aux);
+    static void track__16BitsMultichannel(track_t* t, int32_t* out, size_t numFrames,
+            int32_t* temp, int32_t* aux);
     static void volumeRampStereo(track_t* t, int32_t* out, size_t frameCount, int32_t* temp,
             int32_t* aux);
     static void volumeStereo(track_t* t, int32_t* out, size_t frameCount, int32_t* temp,
@@ -702,6 +702,16 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                 mAudioCommands.removeAt(0);
                 mLastCommand = *command;
 
+                // several volume and parameter commands due at once, as on a route change or
+                // a device connection: send them to AudioFlinger in a single transaction
+                if (isUpdateCommand(command->mCommand) && !mAudioCommands.isEmpty() &&
+                        isUpdateCommand(mAudioCommands[0]->mCommand) &&
+                        mAudioCommands[0]->mTime <= curTime) {
+                    applyUpdates_l(command, curTime);
+                    waitTime = INT64_MAX;
+                    continue;
+                }
+
                 switch (command->mCommand) {
                 case START_TONE: {
                     mLock.unlock();
@@ -867,6 +877,76 @@ void AudioPolicyService::AudioCommandThread::stopToneCommand()
     mWaitWorkCV.signal();
 }
 
+void AudioPolicyService::AudioCommandThread::applyUpdates_l(AudioCommand *first,
+                                                             nsecs_t curTime)
+{
+    Vector <AudioCommand *> commands;
+    commands.add(first);
+    while (!mAudioCommands.isEmpty() && commands.size() < IAudioFlinger::kMaxUpdates &&
+            isUpdateCommand(mAudioCommands[0]->mCommand) &&
+            mAudioCommands[0]->mTime <= curTime) {
+        commands.add(mAudioCommands[0]);
+        mAudioCommands.removeAt(0);
+    }
+
+    Vector<IAudioFlinger::Update> updates;
+    for (size_t i = 0; i < commands.size(); i++) {
+        AudioCommand *command = commands[i];
+        IAudioFlinger::Update update;
+        update.mStream = AUDIO_STREAM_DEFAULT;
+        update.mValue = 0.0f;
+        update.mIoHandle = 0;
+        switch (command->mCommand) {
+        case SET_VOLUME: {
+            VolumeData *data = (VolumeData *)command->mParam;
+            update.mType = IAudioFlinger::Update::STREAM_VOLUME;
+            update.mStream = data->mStream;
+            update.mValue = data->mVolume;
+            update.mIoHandle = data->mIO;
+            } break;
+        case SET_PARAMETERS: {
+            ParametersData *data = (ParametersData *)command->mParam;
+            update.mType = IAudioFlinger::Update::PARAMETERS;
+            update.mIoHandle = data->mIO;
+            update.mKeyValuePairs = data->mKeyValuePairs;
+            } break;
+        case SET_VOICE_VOLUME: {
+            VoiceVolumeData *data = (VoiceVolumeData *)command->mParam;
+            update.mType = IAudioFlinger::Update::VOICE_VOLUME;
+            update.mValue = data->mVolume;
+            } break;
+        }
+        updates.add(update);
+    }
+
+    Vector<status_t> statuses;
+    status_t status = AudioSystem::applyUpdates(updates, &statuses);
+    ALOGV("AudioCommandThread() applied %u updates in one transaction, status %d",
+            updates.size(), status);
+
+    for (size_t i = 0; i < commands.size(); i++) {
+        AudioCommand *command = commands[i];
+        command->mStatus = i < statuses.size() ? statuses[i] : status;
+        mLastCommand = *command;
+        if (command->mWaitStatus) {
+            command->mCond.signal();
+            command->mCond.waitRelative(mLock, kAudioCommandTimeout);
+        }
+        switch (command->mCommand) {
+        case SET_VOLUME:
+            delete (VolumeData *)command->mParam;
+            break;
+        case SET_PARAMETERS:
+            delete (ParametersData *)command->mParam;
+            break;
+        case SET_VOICE_VOLUME:
+            delete (VoiceVolumeData *)command->mParam;
+            break;
+        }
+        delete command;
+    }
+}
+
 status_t AudioPolicyService::AudioCommandThread::volumeCommand(audio_stream_type_t stream,
                                                                float volume,
                                                                audio_io_handle_t output,
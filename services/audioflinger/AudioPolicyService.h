@@ -197,6 +197,15 @@ private:
                     void        insertCommand_l(AudioCommand *command, int delayMs = 0);
 
     private:
+        // true for the commands that can be sent to AudioFlinger with applyUpdates()
+        static      bool        isUpdateCommand(int command) {
+                                    return command == SET_VOLUME || command == SET_PARAMETERS ||
+                                            command == SET_VOICE_VOLUME;
+                                }
+                    // execute first and all following update commands due by curTime
+                    // in a single transaction to AudioFlinger, then delete them
+                    void        applyUpdates_l(AudioCommand *first, nsecs_t curTime);
+
         // descriptor for requested tone playback event
         class AudioCommand {
 
@@ -24,9 +24,137 @@
 #include "AudioResampler.h"
 #include "AudioResamplerCubic.h"
 
+#if defined(__arm__) && !defined(__thumb__)
+#define USE_INLINE_ASSEMBLY (true)
+#else
+#define USE_INLINE_ASSEMBLY (false)
+#endif
+
+#if USE_INLINE_ASSEMBLY && defined(__ARM_NEON__)
+#define USE_NEON (true)
+#else
+#define USE_NEON (false)
+#endif
+
 namespace android {
 // ----------------------------------------------------------------------------
 
+// Inner loops of the exact 2x upsampler, for input frames whose whole interpolation window is
+// in the current buffer. in points to the first sample of the window y0 y1 y2 y3 of the first
+// input step, and each step accumulates two output frames: y1 and the interpolation half way
+// between y1 and y2, then moves the window by one frame. The results are bit-exact with
+// interp() since the cubic coefficients are computed the same way, in 32 bits.
+
+static inline void up2xStereo16NEON(int32_t*& out, const int16_t*& in, size_t& steps,
+        int32_t vl, int32_t vr)
+{
+#if USE_NEON
+    size_t count = steps & ~1;
+    if (count == 0) {
+        return;
+    }
+    steps -= count;
+    const int32_t vlr[2] = { vl, vr };
+    int32_t next;
+    asm (
+        "vld1.32        {d30}, [%[vlr]]          \n"
+        "vmov           d31, d30                 \n"    // q15 = vl vr vl vr
+        "1:                                      \n"
+        "vld1.16        {d0, d1}, [%[in]]        \n"    // frames j-3 .. j
+        "add            %[next], %[in], #16      \n"
+        "vld1.32        {d2[0]}, [%[next]]       \n"    // frame j+1
+        "add            %[in], %[in], #8         \n"    // two input steps
+        "vext.16        d3, d0, d1, #2           \n"    // frames j-2 j-1
+        "vext.16        d4, d1, d2, #2           \n"    // frames j j+1
+        "vmovl.s16      q8, d0                   \n"    // y0 of steps j and j+1
+        "vmovl.s16      q9, d3                   \n"    // y1
+        "vmovl.s16      q10, d1                  \n"    // y2
+        "vmovl.s16      q11, d4                  \n"    // y3
+        "vsub.i32       q12, q9, q10             \n"    // a = (3 * (y1 - y2) - y0 + y3) >> 1
+        "vadd.i32       q13, q12, q12            \n"
+        "vadd.i32       q12, q12, q13            \n"
+        "vsub.i32       q12, q12, q8             \n"
+        "vadd.i32       q12, q12, q11            \n"
+        "vshr.s32       q12, q12, #1             \n"
+        "vshl.i32       q13, q9, #2              \n"    // b = (y2 << 1) + y0 - ((5 * y1 + y3) >> 1)
+        "vadd.i32       q13, q13, q9             \n"
+        "vadd.i32       q13, q13, q11            \n"
+        "vshr.s32       q13, q13, #1             \n"
+        "vshl.i32       q14, q10, #1             \n"
+        "vadd.i32       q14, q14, q8             \n"
+        "vsub.i32       q14, q14, q13            \n"
+        "vsub.i32       q13, q10, q8             \n"    // c = (y2 - y0) >> 1
+        "vshr.s32       q13, q13, #1             \n"
+        "vshr.s32       q12, q12, #1             \n"    // (((a >> 1) + b) >> 1) + c) >> 1) + y1
+        "vadd.i32       q12, q12, q14            \n"
+        "vshr.s32       q12, q12, #1             \n"
+        "vadd.i32       q12, q12, q13            \n"
+        "vshr.s32       q12, q12, #1             \n"
+        "vadd.i32       q12, q12, q9             \n"
+        "vmul.i32       q9, q9, q15              \n"    // apply volume
+        "vmul.i32       q12, q12, q15            \n"
+        "vld1.32        {d0-d3}, [%[out]]        \n"    // load 4 32-bits stereo accumulators
+        "subs           %[count], %[count], #2   \n"    // update loop counter
+        "vadd.i32       d0, d0, d18              \n"    // y1 of step j
+        "vadd.i32       d1, d1, d24              \n"    // half way of step j
+        "vadd.i32       d2, d2, d19              \n"    // y1 of step j+1
+        "vadd.i32       d3, d3, d25              \n"    // half way of step j+1
+        "vst1.32        {d0-d3}, [%[out]]!       \n"    // store accumulators
+        "bne            1b                       \n"    // loop
+        : [out]     "+r" (out),
+          [in]      "+r" (in),
+          [count]   "+r" (count),
+          [next]    "=&r" (next)
+        : [vlr]     "r" (vlr)
+        : "cc", "memory",
+          "q0", "q1", "q2", "q8", "q9", "q10", "q11", "q12", "q13", "q14", "q15"
+    );
+#endif
+}
+
+static inline int32_t up2xHalf(const int16_t* in, int stride)
+{
+    int32_t y0 = in[0];
+    int32_t y1 = in[stride];
+    int32_t y2 = in[2 * stride];
+    int32_t y3 = in[3 * stride];
+    int32_t a = (3 * (y1 - y2) - y0 + y3) >> 1;
+    int32_t b = (y2 << 1) + y0 - (((5 * y1 + y3)) >> 1);
+    int32_t c = (y2 - y0) >> 1;
+    return (((((a >> 1) + b) >> 1) + c) >> 1) + y1;
+}
+
+static void up2xStereo16(int32_t* out, const int16_t* in, size_t steps,
+        int32_t vl, int32_t vr)
+{
+    up2xStereo16NEON(out, in, steps, vl, vr);
+    while (steps--) {
+        out[0] += vl * in[2];
+        out[1] += vr * in[3];
+        out[2] += vl * up2xHalf(in, 2);
+        out[3] += vr * up2xHalf(in + 1, 2);
+        out += 4;
+        in += 2;
+    }
+}
+
+static void up2xMono16(int32_t* out, const int16_t* in, size_t steps,
+        int32_t vl, int32_t vr)
+{
+    while (steps--) {
+        int32_t sample = in[1];
+        out[0] += vl * sample;
+        out[1] += vr * sample;
+        sample = up2xHalf(in, 1);
+        out[2] += vl * sample;
+        out[3] += vr * sample;
+        out += 4;
+        in += 1;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 void AudioResamplerCubic::init() {
     memset(&left, 0, sizeof(state));
     memset(&right, 0, sizeof(state));
@@ -46,6 +174,18 @@ void AudioResamplerCubic::resample(int32_t* out, size_t outFrameCount,
     // should never happen, but we overflow if it does
     // ALOG_ASSERT(outFrameCount < 32767);
 
+    // exact 2x conversions: the phase only takes one or two values, so there is no need to
+    // track it, and the cubic coefficients are mostly not needed or computed once per output
+    if ((uint32_t) mPhaseIncrement == kPhaseIncrementUp2x &&
+            (mPhaseFraction == 0 || mPhaseFraction == kPhaseIncrementUp2x)) {
+        resampleUp2x16(out, outFrameCount, provider);
+        return;
+    }
+    if ((uint32_t) mPhaseIncrement == kPhaseIncrementDown2x) {
+        resampleDown2x16(out, outFrameCount, provider);
+        return;
+    }
+
     // select the appropriate resampler
     switch (mChannelCount) {
     case 1:
@@ -188,6 +328,172 @@ save_state:
     mPhaseFraction = phaseFraction;
 }
 
+// Same output as resampleMono16() and resampleStereo16() for a phase increment of exactly 1/2,
+// with a phase fraction starting at 0 or 1/2: outputs alternate between y1 and the
+// interpolation half way between y1 and y2, and every other output consumes one input frame.
+void AudioResamplerCubic::resampleUp2x16(int32_t* out, size_t outFrameCount,
+        AudioBufferProvider* provider) {
+
+    int32_t vl = mVolume[0];
+    int32_t vr = mVolume[1];
+    const bool stereo = mChannelCount == 2;
+
+    size_t inputIndex = mInputIndex;
+    uint32_t phaseFraction = mPhaseFraction;
+    size_t outputIndex = 0;
+    size_t outputSampleCount = outFrameCount * 2;
+    size_t inFrameCount = (outFrameCount*mInSampleRate)/mSampleRate;
+
+    // fetch first buffer
+    if (mBuffer.frameCount == 0) {
+        mBuffer.frameCount = inFrameCount;
+        provider->getNextBuffer(&mBuffer, mPTS);
+        if (mBuffer.raw == NULL)
+            return;
+    }
+    int16_t *in = mBuffer.i16;
+
+    while (outputIndex < outputSampleCount) {
+        int32_t sample;
+
+        if (phaseFraction == 0) {
+            // x is 0: the interpolation is y1
+            out[outputIndex++] += vl * left.y1;
+            out[outputIndex++] += vr * (stereo ? right.y1 : left.y1);
+            phaseFraction = kPhaseIncrementUp2x;
+            continue;
+        }
+
+        sample = interpHalf(&left);
+        out[outputIndex++] += vl * sample;
+        out[outputIndex++] += vr * (stereo ? interpHalf(&right) : sample);
+        phaseFraction = 0;
+
+        // time to fetch another sample
+        inputIndex++;
+        if (inputIndex == mBuffer.frameCount) {
+            inputIndex = 0;
+            provider->releaseBuffer(&mBuffer);
+            mBuffer.frameCount = inFrameCount;
+            provider->getNextBuffer(&mBuffer,
+                                    calculateOutputPTS(outputIndex / 2));
+            if (mBuffer.raw == NULL)
+                goto save_state;  // ugly, but efficient
+            in = mBuffer.i16;
+        }
+        if (stereo) {
+            advance(&left, in[inputIndex*2]);
+            advance(&right, in[inputIndex*2+1]);
+        } else {
+            advance(&left, in[inputIndex]);
+        }
+
+        // as long as the whole interpolation window is in the buffer, work from the buffer
+        // directly instead of the sample state, and update the state at the end.
+        // The first frame of the very first buffer never enters the state, so the window
+        // must not start at frame 0.
+        if (inputIndex >= 4) {
+            size_t steps = (outputSampleCount - outputIndex) / 4;
+            size_t available = mBuffer.frameCount - 1 - inputIndex;
+            if (steps > available) {
+                steps = available;
+            }
+            if (steps != 0) {
+                if (stereo) {
+                    up2xStereo16(out + outputIndex, in + (inputIndex - 3) * 2, steps, vl, vr);
+                } else {
+                    up2xMono16(out + outputIndex, in + inputIndex - 3, steps, vl, vr);
+                }
+                outputIndex += steps * 4;
+                inputIndex += steps;
+                if (stereo) {
+                    setWindow(&left, in + (inputIndex - 3) * 2, 2);
+                    setWindow(&right, in + (inputIndex - 3) * 2 + 1, 2);
+                } else {
+                    setWindow(&left, in + inputIndex - 3, 1);
+                }
+            }
+        }
+    }
+
+save_state:
+    mInputIndex = inputIndex;
+    mPhaseFraction = phaseFraction;
+}
+
+// Same output as resampleMono16() and resampleStereo16() for a phase increment of exactly 2:
+// the phase fraction does not change, and each output consumes two input frames, so the cubic
+// coefficients only need to be computed for the second one.
+void AudioResamplerCubic::resampleDown2x16(int32_t* out, size_t outFrameCount,
+        AudioBufferProvider* provider) {
+
+    int32_t vl = mVolume[0];
+    int32_t vr = mVolume[1];
+    const bool stereo = mChannelCount == 2;
+
+    size_t inputIndex = mInputIndex;
+    const int32_t x = mPhaseFraction >> kPreInterpShift;
+    size_t outputIndex = 0;
+    size_t outputSampleCount = outFrameCount * 2;
+    size_t inFrameCount = (outFrameCount*mInSampleRate)/mSampleRate;
+
+    // fetch first buffer
+    if (mBuffer.frameCount == 0) {
+        mBuffer.frameCount = inFrameCount;
+        provider->getNextBuffer(&mBuffer, mPTS);
+        if (mBuffer.raw == NULL)
+            return;
+    }
+    int16_t *in = mBuffer.i16;
+
+    while (outputIndex < outputSampleCount) {
+        int32_t sample;
+
+        // calculate output sample
+        sample = interp(&left, x);
+        out[outputIndex++] += vl * sample;
+        out[outputIndex++] += vr * (stereo ? interp(&right, x) : sample);
+
+        if (inputIndex >= 2 && inputIndex + 2 < mBuffer.frameCount) {
+            // both samples and the rest of the window are in the buffer, see resampleUp2x16()
+            inputIndex += 2;
+            if (stereo) {
+                setWindow(&left, in + (inputIndex - 3) * 2, 2);
+                setWindow(&right, in + (inputIndex - 3) * 2 + 1, 2);
+            } else {
+                setWindow(&left, in + inputIndex - 3, 1);
+            }
+            continue;
+        }
+
+        // time to fetch two more samples
+        for (int i = 0; i < 2; i++) {
+            inputIndex++;
+            if (inputIndex == mBuffer.frameCount) {
+                inputIndex = 0;
+                provider->releaseBuffer(&mBuffer);
+                mBuffer.frameCount = inFrameCount;
+                provider->getNextBuffer(&mBuffer,
+                                        calculateOutputPTS(outputIndex / 2));
+                if (mBuffer.raw == NULL)
+                    goto save_state;  // ugly, but efficient
+                in = mBuffer.i16;
+            }
+
+            // advance sample state
+            if (stereo) {
+                advance(&left, in[inputIndex*2]);
+                advance(&right, in[inputIndex*2+1]);
+            } else {
+                advance(&left, in[inputIndex]);
+            }
+        }
+    }
+
+save_state:
+    mInputIndex = inputIndex;
+}
+
 // ----------------------------------------------------------------------------
 }
 ; // namespace android
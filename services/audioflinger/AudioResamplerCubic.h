@@ -39,6 +39,11 @@ private:
 
     // bits to shift the phase fraction down to avoid overflow
     static const int kPreInterpShift = kNumPhaseBits - kNumInterpBits;
+
+    // phase increments of the exact 2x up and 2x down conversions, e.g. 24 kHz or 96 kHz
+    // to 48 kHz, which have their own loops
+    static const uint32_t kPhaseIncrementUp2x = 1LU << (kNumPhaseBits - 1);
+    static const uint32_t kPhaseIncrementDown2x = 2LU << kNumPhaseBits;
     typedef struct {
         int32_t a, b, c, y0, y1, y2, y3;
     } state;
@@ -48,9 +53,28 @@ private:
             AudioBufferProvider* provider);
     void resampleStereo16(int32_t* out, size_t outFrameCount,
             AudioBufferProvider* provider);
+    void resampleUp2x16(int32_t* out, size_t outFrameCount,
+            AudioBufferProvider* provider);
+    void resampleDown2x16(int32_t* out, size_t outFrameCount,
+            AudioBufferProvider* provider);
     static inline int32_t interp(state* p, int32_t x) {
         return (((((p->a * x >> 14) + p->b) * x >> 14) + p->c) * x >> 14) + p->y1;
     }
+    // same as interp(p, 1 << 13), half way between y1 and y2: the multiplies by x followed by
+    // a shift by 14 are exactly a shift by 1
+    static inline int32_t interpHalf(state* p) {
+        return (((((p->a >> 1) + p->b) >> 1) + p->c) >> 1) + p->y1;
+    }
+    // same state as after advance() with in[0], in[stride], in[2 * stride] and in[3 * stride]
+    static inline void setWindow(state* p, const int16_t* in, int stride) {
+        p->y0 = in[0];
+        p->y1 = in[stride];
+        p->y2 = in[2 * stride];
+        p->y3 = in[3 * stride];
+        p->a = (3 * (p->y1 - p->y2) - p->y0 + p->y3) >> 1;
+        p->b = (p->y2 << 1) + p->y0 - (((5 * p->y1 + p->y3)) >> 1);
+        p->c = (p->y2 - p->y0) >> 1;
+    }
     static inline void advance(state* p, int16_t in) {
         p->y0 = p->y1;
         p->y1 = p->y2;
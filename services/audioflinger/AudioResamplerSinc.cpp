@@ -452,7 +452,7 @@ int32_t mulAddRL(int left, uint32_t inRL, int32_t v, int32_t a)
 AudioResamplerSinc::AudioResamplerSinc(int bitDepth,
         int inChannelCount, int32_t sampleRate, src_quality quality)
     : AudioResampler(bitDepth, inChannelCount, sampleRate, quality),
-    mState(0), mImpulse(0), mRingFull(0), mFirCoefs(0)
+    mState(0), mImpulse(0), mRingFull(0), mFirCoefs(0), mPolyphaseBank(0)
 {
     /*
      * Layout of the state buffer for 32 tap:
@@ -484,6 +484,7 @@ AudioResamplerSinc::AudioResamplerSinc(int bitDepth,
 
 
 AudioResamplerSinc::~AudioResamplerSinc() {
+    releasePolyphaseBank(mPolyphaseBank);
     free(mState);
 }
 
@@ -495,6 +496,12 @@ void AudioResamplerSinc::init() {
     memset(mState, 0, sizeof(int16_t)*stateSize);
     mImpulse  = mState   + (c.halfNumCoefs-1)*mChannelCount;
     mRingFull = mImpulse + (numCoefs+1)*mChannelCount;
+    updateCoefficients();
+}
+
+void AudioResamplerSinc::setSampleRate(int32_t inSampleRate) {
+    AudioResampler::setSampleRate(inSampleRate);
+    updateCoefficients();
 }
 
 void AudioResamplerSinc::reset(){
@@ -515,16 +522,18 @@ void AudioResamplerSinc::setVolume(int16_t left, int16_t right) {
 void AudioResamplerSinc::resample(int32_t* out, size_t outFrameCount,
             AudioBufferProvider* provider)
 {
-    // FIXME store current state (up or down sample) and only load the coefs when the state
-    // changes. Or load two pointers one for up and one for down in the init function.
-    // Not critical now since the read functions are fast, but would be important if read was slow.
-    if (mConstants == &veryHighQualityConstants && readResampleCoefficients) {
-        mFirCoefs = readResampleCoefficients( mInSampleRate <= mSampleRate );
-    } else {
-        mFirCoefs = (const int32_t *) ((mInSampleRate <= mSampleRate) ? mFirCoefsUp : mFirCoefsDown);
-    }
-
     // select the appropriate resampler
+    if (mPolyphaseBank != NULL) {
+        switch (mChannelCount) {
+        case 1:
+            resamplePolyphase<1>(out, outFrameCount, provider);
+            break;
+        case 2:
+            resamplePolyphase<2>(out, outFrameCount, provider);
+            break;
+        }
+        return;
+    }
     switch (mChannelCount) {
     case 1:
         resample<1>(out, outFrameCount, provider);
@@ -535,6 +544,218 @@ void AudioResamplerSinc::resample(int32_t* out, size_t outFrameCount,
     }
 }
 
+// ----------------------------------------------------------------------------
+
+/*static*/ pthread_mutex_t AudioResamplerSinc::sPolyphaseLock = PTHREAD_MUTEX_INITIALIZER;
+/*static*/ AudioResamplerSinc::PolyphaseBank* AudioResamplerSinc::sPolyphaseBanks = NULL;
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Called whenever the sample rate changes, so that the coefficients and the polyphase bank
+// (which may need the global lock and an allocation) are never looked up by resample().
+void AudioResamplerSinc::updateCoefficients()
+{
+    if (mConstants == &veryHighQualityConstants && readResampleCoefficients) {
+        mFirCoefs = readResampleCoefficients( mInSampleRate <= mSampleRate );
+    } else {
+        mFirCoefs = (const int32_t *) ((mInSampleRate <= mSampleRate) ? mFirCoefsUp : mFirCoefsDown);
+    }
+    updatePolyphaseBank();
+}
+
+void AudioResamplerSinc::updatePolyphaseBank()
+{
+    PolyphaseBank* bank = mPolyphaseBank;
+    if (bank != NULL && bank->firCoefs == mFirCoefs && bank->constants == mConstants &&
+            bank->inSampleRate == uint32_t(mInSampleRate)) {
+        return;
+    }
+    PolyphaseBank* newBank = acquirePolyphaseBank(mConstants, mFirCoefs,
+            mInSampleRate, mSampleRate);
+
+    // convert the phase to the units of the new mode, keeping the frames still to be read
+    const uint64_t one = bank != NULL ? bank->phaseCount : 1LLU<<kNumPhaseBits;
+    const uint64_t newOne = newBank != NULL ? newBank->phaseCount : 1LLU<<kNumPhaseBits;
+    if (one != newOne) {
+        const uint32_t frames = mPhaseFraction / one;
+        const uint64_t fraction = mPhaseFraction % one;
+        mPhaseFraction = frames * newOne + (fraction * newOne) / one;
+    }
+
+    releasePolyphaseBank(bank);
+    mPolyphaseBank = newBank;
+}
+
+AudioResamplerSinc::PolyphaseBank* AudioResamplerSinc::acquirePolyphaseBank(
+        const Constants* constants, const int32_t* firCoefs,
+        uint32_t inSampleRate, uint32_t outSampleRate)
+{
+    const uint32_t div = gcd(inSampleRate, outSampleRate);
+    if (div == 0 || outSampleRate / div > kMaxPolyphaseCount) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&sPolyphaseLock);
+    PolyphaseBank* bank;
+    for (bank = sPolyphaseBanks; bank != NULL; bank = bank->next) {
+        if (bank->constants == constants && bank->firCoefs == firCoefs &&
+                bank->inSampleRate == inSampleRate && bank->outSampleRate == outSampleRate) {
+            bank->refCount++;
+            pthread_mutex_unlock(&sPolyphaseLock);
+            return bank;
+        }
+    }
+
+    // Precompute the coefficients filterCoefficient() would interpolate for each phase
+    const Constants& c(*constants);
+    const size_t offset = c.halfNumCoefs;
+    const uint32_t phaseCount = outSampleRate / div;
+    int32_t* coefs = (int32_t*)memalign(32, phaseCount * 2 * offset * sizeof(int32_t));
+    if (coefs == NULL) {
+        pthread_mutex_unlock(&sPolyphaseLock);
+        return NULL;
+    }
+    const uint32_t ONE = c.cMask | c.pMask;
+    for (uint32_t p = 0; p < phaseCount; p++) {
+        const uint32_t phase = (uint32_t)((uint64_t(p) << kNumPhaseBits) / phaseCount);
+        const uint32_t indexP = ( phase & c.cMask) >> c.cShift;
+        const uint32_t lerpP  = ( phase & c.pMask) >> c.pShift;
+        const uint32_t indexN = ((ONE-phase) & c.cMask) >> c.cShift;
+        const uint32_t lerpN  = ((ONE-phase) & c.pMask) >> c.pShift;
+        const int32_t* coefsP = firCoefs + indexP * offset;
+        const int32_t* coefsN = firCoefs + indexN * offset;
+        int32_t* dst = coefs + p * 2 * offset;
+        for (size_t i = 0; i < offset; i++) {
+            dst[i] = mulAdd(lerpP, (coefsP[i + offset] - coefsP[i]) << 1, coefsP[i]);
+            dst[offset + i] = mulAdd(lerpN, (coefsN[i + offset] - coefsN[i]) << 1, coefsN[i]);
+        }
+    }
+
+    bank = new PolyphaseBank;
+    bank->constants = constants;
+    bank->firCoefs = firCoefs;
+    bank->inSampleRate = inSampleRate;
+    bank->outSampleRate = outSampleRate;
+    bank->phaseCount = phaseCount;
+    bank->phaseStep = inSampleRate / div;
+    bank->coefs = coefs;
+    bank->refCount = 1;
+    bank->next = sPolyphaseBanks;
+    sPolyphaseBanks = bank;
+    pthread_mutex_unlock(&sPolyphaseLock);
+    ALOGV("created polyphase bank %u -> %u Hz, %u phases", inSampleRate, outSampleRate,
+            phaseCount);
+    return bank;
+}
+
+void AudioResamplerSinc::releasePolyphaseBank(PolyphaseBank* bank)
+{
+    if (bank == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&sPolyphaseLock);
+    if (--bank->refCount == 0) {
+        PolyphaseBank** pp = &sPolyphaseBanks;
+        while (*pp != bank) {
+            pp = &(*pp)->next;
+        }
+        *pp = bank->next;
+        free(bank->coefs);
+        delete bank;
+    }
+    pthread_mutex_unlock(&sPolyphaseLock);
+}
+
+// Same as resample() below, except that mPhaseFraction is in units of 1/phaseCount frame
+// and advances by phaseStep per output frame, so that the phase is always exactly one of the
+// phases of the bank.  This also lifts the 2x limit on downsampling.
+template<int CHANNELS>
+void AudioResamplerSinc::resamplePolyphase(int32_t* out, size_t outFrameCount,
+        AudioBufferProvider* provider)
+{
+    const Constants& c(*mConstants);
+    const size_t headOffset = c.halfNumCoefs*CHANNELS;
+    const size_t coefsStride = c.halfNumCoefs*2;
+    const int32_t* const coefs = mPolyphaseBank->coefs;
+    const uint32_t phaseOne = mPolyphaseBank->phaseCount;
+    const uint32_t phaseStep = mPolyphaseBank->phaseStep;
+    int16_t* impulse = mImpulse;
+    uint32_t vRL = mVolumeRL;
+    size_t inputIndex = mInputIndex;
+    uint32_t phaseFraction = mPhaseFraction;
+    size_t outputIndex = 0;
+    size_t outputSampleCount = outFrameCount * 2;
+    size_t inFrameCount = (outFrameCount*mInSampleRate)/mSampleRate;
+
+    while (outputIndex < outputSampleCount) {
+        // buffer is empty, fetch a new one
+        while (mBuffer.frameCount == 0) {
+            mBuffer.frameCount = inFrameCount;
+            provider->getNextBuffer(&mBuffer,
+                                    calculateOutputPTS(outputIndex / 2));
+            if (mBuffer.raw == NULL) {
+                goto resample_exit;
+            }
+            // read the frames that were still pending at the end of the previous buffer
+            while (phaseFraction >= phaseOne) {
+                read<CHANNELS>(impulse, phaseFraction, phaseOne, mBuffer.i16, inputIndex);
+                if (phaseFraction < phaseOne) {
+                    break;
+                }
+                inputIndex++;
+                if (inputIndex >= mBuffer.frameCount) {
+                    inputIndex -= mBuffer.frameCount;
+                    provider->releaseBuffer(&mBuffer);
+                    break;
+                }
+            }
+        }
+        int16_t const * const in = mBuffer.i16;
+        const size_t frameCount = mBuffer.frameCount;
+
+        // Always read-in the first samples from the input buffer
+        int16_t* head = impulse + headOffset;
+        for (size_t i=0 ; i<CHANNELS ; i++) {
+            head[i] = in[inputIndex*CHANNELS + i];
+        }
+
+        // handle boundary case
+        while (CC_LIKELY(outputIndex < outputSampleCount)) {
+            filterPolyphase<CHANNELS>(&out[outputIndex], coefs + phaseFraction * coefsStride,
+                    impulse, vRL);
+            outputIndex += 2;
+
+            phaseFraction += phaseStep;
+            while (phaseFraction >= phaseOne) {
+                inputIndex++;
+                if (inputIndex >= frameCount) {
+                    goto done;  // need a new buffer
+                }
+                read<CHANNELS>(impulse, phaseFraction, phaseOne, in, inputIndex);
+            }
+        }
+done:
+        // if done with buffer, save samples
+        if (inputIndex >= frameCount) {
+            inputIndex -= frameCount;
+            provider->releaseBuffer(&mBuffer);
+        }
+    }
+
+resample_exit:
+    mImpulse = impulse;
+    mInputIndex = inputIndex;
+    mPhaseFraction = phaseFraction;
+}
+
 
 template<int CHANNELS>
 void AudioResamplerSinc::resample(int32_t* out, size_t outFrameCount,
@@ -563,16 +784,16 @@ void AudioResamplerSinc::resample(int32_t* out, size_t outFrameCount,
             const uint32_t phaseIndex = phaseFraction >> kNumPhaseBits;
             if (phaseIndex == 1) {
                 // read one frame
-                read<CHANNELS>(impulse, phaseFraction, mBuffer.i16, inputIndex);
+                read<CHANNELS>(impulse, phaseFraction, 1LU<<kNumPhaseBits, mBuffer.i16, inputIndex);
             } else if (phaseIndex == 2) {
                 // read 2 frames
-                read<CHANNELS>(impulse, phaseFraction, mBuffer.i16, inputIndex);
+                read<CHANNELS>(impulse, phaseFraction, 1LU<<kNumPhaseBits, mBuffer.i16, inputIndex);
                 inputIndex++;
                 if (inputIndex >= mBuffer.frameCount) {
                     inputIndex -= mBuffer.frameCount;
                     provider->releaseBuffer(&mBuffer);
                 } else {
-                    read<CHANNELS>(impulse, phaseFraction, mBuffer.i16, inputIndex);
+                    read<CHANNELS>(impulse, phaseFraction, 1LU<<kNumPhaseBits, mBuffer.i16, inputIndex);
                 }
             }
         }
@@ -597,7 +818,7 @@ void AudioResamplerSinc::resample(int32_t* out, size_t outFrameCount,
                 if (inputIndex >= frameCount) {
                     goto done;  // need a new buffer
                 }
-                read<CHANNELS>(impulse, phaseFraction, in, inputIndex);
+                read<CHANNELS>(impulse, phaseFraction, 1LU<<kNumPhaseBits, in, inputIndex);
             }
         }
 done:
@@ -623,11 +844,11 @@ template<int CHANNELS>
 *
 **/
 void AudioResamplerSinc::read(
-        int16_t*& impulse, uint32_t& phaseFraction,
+        int16_t*& impulse, uint32_t& phaseFraction, uint32_t phaseOne,
         const int16_t* in, size_t inputIndex)
 {
     impulse += CHANNELS;
-    phaseFraction -= 1LU<<kNumPhaseBits;
+    phaseFraction -= phaseOne;
 
     const Constants& c(*mConstants);
     if (CC_UNLIKELY(impulse >= mRingFull)) {
@@ -827,6 +1048,149 @@ void AudioResamplerSinc::filterCoefficient(
     }
 }
 
+// Same as filterCoefficient(), with the coefficients of the phase already interpolated:
+// coefs holds halfNumCoefs coefficients for the positive side followed by as many for the
+// negative side.
+template<int CHANNELS>
+void AudioResamplerSinc::filterPolyphase(
+        int32_t* out, const int32_t* coefs, const int16_t *samples, uint32_t vRL)
+{
+    const size_t offset = mConstants->halfNumCoefs;
+    int32_t const* coefsP = coefs;
+    int32_t const* coefsN = coefs + offset;
+    int16_t const* sP = samples;
+    int16_t const* sN = samples + CHANNELS;
+
+    size_t count = offset;
+
+    if (!USE_NEON) {
+        int32_t l = 0;
+        int32_t r = 0;
+        for (size_t i=0 ; i<count ; i++) {
+            if (CHANNELS == 2) {
+                uint32_t rlP = *reinterpret_cast<const uint32_t*>(sP);
+                uint32_t rlN = *reinterpret_cast<const uint32_t*>(sN);
+                l = mulAddRL(1, rlP, *coefsP, l);
+                r = mulAddRL(0, rlP, *coefsP++, r);
+                l = mulAddRL(1, rlN, *coefsN, l);
+                r = mulAddRL(0, rlN, *coefsN++, r);
+            } else {
+                l = mulAdd(sP[0], *coefsP++, l);
+                l = mulAdd(sN[0], *coefsN++, l);
+                r = l;
+            }
+            sP -= CHANNELS;
+            sN += CHANNELS;
+        }
+        out[0] += 2 * mulRL(1, l, vRL);
+        out[1] += 2 * mulRL(0, r, vRL);
+    } else if (CHANNELS == 1) {
+        sP -= CHANNELS*3;
+        asm (
+            "veor           q0, q0, q0               \n"    // result, initialize to 0
+
+            "1:                                      \n"
+            "vld1.16        { d4}, [%[sP]]           \n"    // load 4 16-bits mono samples
+            "vld1.32        { q8}, [%[coefsP0]:128]! \n"    // load 4 32-bits coefs
+            "vld1.16        { d6}, [%[sN]]!          \n"    // load 4 16-bits mono samples
+            "vld1.32        {q10}, [%[coefsN0]:128]! \n"    // load 4 32-bits coefs
+
+            "vrev64.16      d4, d4                   \n"    // reverse 2 frames of the positive side
+
+            "vshll.s16      q12,  d4, #15            \n"    // extend samples to 31 bits
+            "vshll.s16      q14,  d6, #15            \n"    // extend samples to 31 bits
+            "subs           %[count], %[count], #4   \n"    // update loop counter
+
+            "vqrdmulh.s32   q12, q12, q8             \n"    // multiply samples by coef
+            "vqrdmulh.s32   q14, q14, q10            \n"    // multiply samples by coef
+            "sub            %[sP], %[sP], #8         \n"    // move pointer to next set of samples
+
+            "vadd.s32       q0, q0, q12              \n"    // accumulate result
+            "vadd.s32       q0, q0, q14              \n"    // accumulate result
+
+            "bne            1b                       \n"    // loop
+
+            "vld1.s32       {d2}, [%[vLR]]           \n"    // load volumes
+            "vld1.s32       {d3}, %[out]             \n"    // load the output
+            "vpadd.s32      d0, d0, d1               \n"    // add all 4 partial sums
+            "vpadd.s32      d0, d0, d0               \n"    // together
+            "vdup.i32       d0, d0[0]                \n"    // interleave L,R channels
+            "vqrdmulh.s32   d0, d0, d2               \n"    // apply volume
+            "vadd.s32       d3, d3, d0               \n"    // accumulate result
+            "vst1.s32       {d3}, %[out]             \n"    // store result
+
+            : [out]     "=Uv" (out[0]),
+              [count]   "+r" (count),
+              [coefsP0] "+r" (coefsP),
+              [coefsN0] "+r" (coefsN),
+              [sP]      "+r" (sP),
+              [sN]      "+r" (sN)
+            : [vLR]     "r" (mVolumeSIMD)
+            : "cc", "memory",
+              "q0", "q1", "q2", "q3",
+              "q8", "q10",
+              "q12", "q14"
+        );
+    } else if (CHANNELS == 2) {
+        sP -= CHANNELS*3;
+        asm (
+            "veor           q0, q0, q0               \n"    // result, initialize to 0
+            "veor           q4, q4, q4               \n"    // result, initialize to 0
+
+            "1:                                      \n"
+            "vld2.16        {d4,d5}, [%[sP]]         \n"    // load 4 16-bits stereo samples
+            "vld1.32        { q8}, [%[coefsP0]:128]! \n"    // load 4 32-bits coefs
+            "vld2.16        {d6,d7}, [%[sN]]!        \n"    // load 4 16-bits stereo samples
+            "vld1.32        {q10}, [%[coefsN0]:128]! \n"    // load 4 32-bits coefs
+
+            "vrev64.16      d4, d4                   \n"    // reverse 2 frames of the positive side
+            "vrev64.16      d5, d5                   \n"    // reverse 2 frames of the positive side
+
+            "vshll.s16      q12,  d4, #15            \n"    // extend samples to 31 bits
+            "vshll.s16      q13,  d5, #15            \n"    // extend samples to 31 bits
+            "vshll.s16      q14,  d6, #15            \n"    // extend samples to 31 bits
+            "vshll.s16      q15,  d7, #15            \n"    // extend samples to 31 bits
+            "subs           %[count], %[count], #4   \n"    // update loop counter
+
+            "vqrdmulh.s32   q12, q12, q8             \n"    // multiply samples by coef
+            "vqrdmulh.s32   q13, q13, q8             \n"    // multiply samples by coef
+            "vqrdmulh.s32   q14, q14, q10            \n"    // multiply samples by coef
+            "vqrdmulh.s32   q15, q15, q10            \n"    // multiply samples by coef
+            "sub            %[sP], %[sP], #16        \n"    // move pointer to next set of samples
+
+            "vadd.s32       q0, q0, q12              \n"    // accumulate result
+            "vadd.s32       q4, q4, q13              \n"    // accumulate result
+            "vadd.s32       q0, q0, q14              \n"    // accumulate result
+            "vadd.s32       q4, q4, q15              \n"    // accumulate result
+
+            "bne            1b                       \n"    // loop
+
+            "vld1.s32       {d2}, [%[vLR]]           \n"    // load volumes
+            "vld1.s32       {d3}, %[out]             \n"    // load the output
+            "vpadd.s32      d0, d0, d1               \n"    // add all 4 partial sums from q0
+            "vpadd.s32      d8, d8, d9               \n"    // add all 4 partial sums from q4
+            "vpadd.s32      d0, d0, d0               \n"    // together
+            "vpadd.s32      d8, d8, d8               \n"    // together
+            "vtrn.s32       d0, d8                   \n"    // interlace L,R channels
+            "vqrdmulh.s32   d0, d0, d2               \n"    // apply volume
+            "vadd.s32       d3, d3, d0               \n"    // accumulate result
+            "vst1.s32       {d3}, %[out]             \n"    // store result
+
+            : [out]     "=Uv" (out[0]),
+              [count]   "+r" (count),
+              [coefsP0] "+r" (coefsP),
+              [coefsN0] "+r" (coefsN),
+              [sP]      "+r" (sP),
+              [sN]      "+r" (sN)
+            : [vLR]     "r" (mVolumeSIMD)
+            : "cc", "memory",
+              "q0", "q1", "q2", "q3", "q4",
+              "q8", "q10",
+              "q12", "q13", "q14", "q15"
+        );
+    }
+}
+
 template<int CHANNELS>
 void AudioResamplerSinc::interpolate(
         int32_t& l, int32_t& r,
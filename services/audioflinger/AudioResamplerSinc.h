@@ -18,6 +18,7 @@
 #define ANDROID_AUDIO_RESAMPLER_SINC_H
 
 #include <stdint.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <cutils/log.h>
 
@@ -48,6 +49,10 @@ private:
 
     virtual void setVolume(int16_t left, int16_t right);
 
+    virtual void setSampleRate(int32_t inSampleRate);
+
+    void updateCoefficients();
+
     template<int CHANNELS>
     void resample(int32_t* out, size_t outFrameCount,
             AudioBufferProvider* provider);
@@ -63,7 +68,7 @@ private:
             int32_t lerp, const int16_t* samples);
 
     template<int CHANNELS>
-    inline void read(int16_t*& impulse, uint32_t& phaseFraction,
+    inline void read(int16_t*& impulse, uint32_t& phaseFraction, uint32_t phaseOne,
             const int16_t* in, size_t inputIndex);
 
     int16_t *mState;
@@ -94,6 +99,43 @@ private:
     const Constants *mConstants;    // points to appropriate set of coefficient parameters
 
     static void init_routine();
+
+    // Polyphase filter bank for a fixed rational ratio of sample rates, holding the
+    // interpolated coefficients of every phase the ratio can produce. Banks are shared by
+    // all the resamplers with the same coefficients and ratio.
+    struct PolyphaseBank {
+        const Constants*    constants;
+        const int32_t*      firCoefs;
+        uint32_t            inSampleRate;
+        uint32_t            outSampleRate;
+        uint32_t            phaseCount;     // L: number of phases, i.e. output rate / gcd
+        uint32_t            phaseStep;      // M: input rate / gcd, in units of 1/L frame
+        int32_t*            coefs;          // phaseCount * 2 * halfNumCoefs, 32-byte aligned
+        int                 refCount;
+        PolyphaseBank*      next;
+    };
+
+    // above this many phases, the bank costs more memory than it is worth
+    static const uint32_t kMaxPolyphaseCount = 256;
+
+    // non-NULL while the current ratio is handled by resamplePolyphase(), in which case
+    // mPhaseFraction is in units of 1/phaseCount frame instead of 1/(1<<kNumPhaseBits)
+    PolyphaseBank *mPolyphaseBank;
+
+    void updatePolyphaseBank();
+    static PolyphaseBank* acquirePolyphaseBank(const Constants* c, const int32_t* firCoefs,
+            uint32_t inSampleRate, uint32_t outSampleRate);
+    static void releasePolyphaseBank(PolyphaseBank* bank);
+    static pthread_mutex_t sPolyphaseLock;  // protects sPolyphaseBanks and their refCount
+    static PolyphaseBank* sPolyphaseBanks;
+
+    template<int CHANNELS>
+    void resamplePolyphase(int32_t* out, size_t outFrameCount,
+            AudioBufferProvider* provider);
+
+    template<int CHANNELS>
+    inline void filterPolyphase(
+            int32_t* out, const int32_t* coefs, const int16_t *samples, uint32_t vRL);
 };
 
 // ----------------------------------------------------------------------------
@@ -17,14 +17,32 @@
 #define LOG_TAG "AudioWatchdog"
 //#define LOG_NDEBUG 0
 
+#define ATRACE_TAG ATRACE_TAG_AUDIO
+
 #include "Configuration.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
 #include <utils/Log.h>
+#include <utils/Trace.h>
 #include "AudioWatchdog.h"
 
-#ifdef AUDIO_WATCHDOG
-
 namespace android {
 
+AudioWatchdogClient::AudioWatchdogClient(AudioWatchdog *watchdog, const char *name, pid_t tid,
+        nsecs_t deadlineNs)
+    : mWatchdog(watchdog), mTid(tid), mDeadlineUs((uint32_t) (deadlineNs / 1000)), mLastKickUs(0), mActive(0),
+      mMisses(0), mStalls(0), mSnapshotKickUs(0), mMaxLateUs(0), mSnapshotTime(0)
+{
+    strlcpy(mName, name, sizeof(mName));
+    mSnapshot[0] = '\0';
+}
+
+void AudioWatchdogClient::activated()
+{
+    mWatchdog->resume();
+}
+
 void AudioWatchdogDump::dump(int fd)
 {
     char buf[32];
@@ -96,6 +114,16 @@ bool AudioWatchdog::threadLoop()
             mLogTs.tv_nsec = 0;
         }
     }
+    {
+        AutoMutex _l(mMyLock);
+        // park while every monitored thread is in standby, rather than wake up each period
+        // for nothing; checked and set under the lock that AudioWatchdogClient::activated()
+        // takes to resume us, so a client leaving standby meanwhile is not missed
+        if (!checkClients_l(newTs) && !mClients.isEmpty()) {
+            mPaused = true;
+            return true;
+        }
+    }
     struct timespec req;
     req.tv_sec = 0;
     req.tv_nsec = mPeriodNs;
@@ -107,6 +135,166 @@ bool AudioWatchdog::threadLoop()
     return true;
 }
 
+AudioWatchdog::~AudioWatchdog()
+{
+    for (size_t i = 0; i < mClients.size(); i++) {
+        delete mClients[i];
+    }
+}
+
+bool AudioWatchdog::checkClients_l(const struct timespec& now)
+{
+    bool anyActive = false;
+    // same clock and units as AudioWatchdogClient::kick()
+    uint32_t nowUs = (uint32_t) (now.tv_sec * 1000000LL + now.tv_nsec / 1000);
+    uint32_t misses = 0;
+    for (size_t i = 0; i < mClients.size(); i++) {
+        AudioWatchdogClient *client = mClients[i];
+        misses += client->mMisses;
+        if (!android_atomic_acquire_load(&client->mActive)) {
+            continue;
+        }
+        anyActive = true;
+        uint32_t lastKickUs = client->mLastKickUs;
+        int32_t lateUs = (int32_t) (nowUs - lastKickUs - client->mDeadlineUs);
+        if (lateUs <= 0) {
+            continue;
+        }
+        if ((uint32_t) lateUs > client->mMaxLateUs) {
+            client->mMaxLateUs = lateUs;
+        }
+        // take only one snapshot per stall, as early as possible
+        if (client->mSnapshotTime != 0 && client->mSnapshotKickUs == lastKickUs) {
+            continue;
+        }
+        time_t previous = client->mSnapshotTime;
+        client->mStalls++;
+        client->mSnapshotKickUs = lastKickUs;
+        snapshot(client);
+        if (client->mSnapshotTime - previous >= MIN_TIME_BETWEEN_LOGS_SEC) {
+            ALOGW("%s tid %d missed its deadline of %.1f ms by %.1f ms: %s; stalls=%u",
+                    client->mName, client->mTid, client->mDeadlineUs * 1e-3, lateUs * 1e-3,
+                    client->mSnapshot, client->mStalls);
+        }
+    }
+    if (misses != mTracedMisses) {
+        // a counter in systrace, to line up the misses with the scheduler events
+        ATRACE_INT("deadline_misses", misses);
+        mTracedMisses = misses;
+    }
+    return anyActive;
+}
+
+// Read up to size - 1 bytes of a small file into buf, NUL-terminated, and return the length
+static ssize_t readFile(const char *path, char *buf, size_t size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        buf[0] = '\0';
+        return -1;
+    }
+    ssize_t length = read(fd, buf, size - 1);
+    close(fd);
+    buf[length > 0 ? length : 0] = '\0';
+    return length;
+}
+
+/*static*/
+void AudioWatchdog::snapshot(AudioWatchdogClient *client)
+{
+    char path[64];
+    char buf[1024];
+    char state = '?';
+    int cpu = -1;
+    snprintf(path, sizeof(path), "/proc/self/task/%d/stat", client->mTid);
+    if (readFile(path, buf, sizeof(buf)) > 0) {
+        // the fields after the parenthesized command name start at field 3, state,
+        // and field 39 is the CPU last run on
+        const char *p = strrchr(buf, ')');
+        if (p != NULL && sscanf(p + 1, " %c", &state) == 1) {
+            for (int field = 3; field < 39 && p != NULL; field++) {
+                p = strchr(p + 1, ' ');
+            }
+            if (p != NULL) {
+                cpu = atoi(p + 1);
+            }
+        }
+    }
+    unsigned nonvoluntary = 0;
+    snprintf(path, sizeof(path), "/proc/self/task/%d/status", client->mTid);
+    if (readFile(path, buf, sizeof(buf)) > 0) {
+        const char *p = strstr(buf, "nonvoluntary_ctxt_switches:");
+        if (p != NULL) {
+            nonvoluntary = strtoul(p + strlen("nonvoluntary_ctxt_switches:"), NULL, 10);
+        }
+    }
+    // the kernel function the thread is blocked in, if any
+    char wchan[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/wchan", client->mTid);
+    if (readFile(path, wchan, sizeof(wchan)) <= 0 || strcmp(wchan, "0") == 0) {
+        strcpy(wchan, "-");
+    }
+    snprintf(client->mSnapshot, sizeof(client->mSnapshot),
+            "state=%c cpu=%d nonvoluntary_ctxt_switches=%u wchan=%s",
+            state, cpu, nonvoluntary, wchan);
+    client->mSnapshotTime = time(NULL);
+}
+
+AudioWatchdogClient* AudioWatchdog::addClient(const char *name, pid_t tid, nsecs_t deadlineNs)
+{
+    AudioWatchdogClient *client = new AudioWatchdogClient(this, name, tid, deadlineNs);
+    AutoMutex _l(mMyLock);
+    mClients.add(client);
+    return client;
+}
+
+void AudioWatchdog::removeClient(AudioWatchdogClient *client)
+{
+    if (client == NULL) {
+        return;
+    }
+    {
+        AutoMutex _l(mMyLock);
+        for (size_t i = 0; i < mClients.size(); i++) {
+            if (mClients[i] == client) {
+                mClients.removeAt(i);
+                break;
+            }
+        }
+    }
+    delete client;
+}
+
+uint32_t AudioWatchdog::misses()
+{
+    AutoMutex _l(mMyLock);
+    uint32_t misses = 0;
+    for (size_t i = 0; i < mClients.size(); i++) {
+        misses += mClients[i]->mMisses;
+    }
+    return misses;
+}
+
+void AudioWatchdog::dumpClients(int fd)
+{
+    AutoMutex _l(mMyLock);
+    fdprintf(fd, "Deadline watchdog: %u threads, period %u ms\n", mClients.size(),
+            mPeriodNs / 1000000);
+    fdprintf(fd, "  Name             Tid Deadline(ms) Active Misses Stalls MaxLate(ms)\n");
+    for (size_t i = 0; i < mClients.size(); i++) {
+        const AudioWatchdogClient *client = mClients[i];
+        fdprintf(fd, "  %-15s %5d %12.1f %6s %6u %6u %11.1f\n", client->mName, client->mTid,
+                client->mDeadlineUs * 1e-3, client->mActive ? "yes" : "no", client->mMisses,
+                client->mStalls, client->mMaxLateUs * 1e-3);
+        if (client->mSnapshotTime != 0) {
+            char buf[32];
+            // includes NUL terminator
+            ctime_r(&client->mSnapshotTime, buf);
+            fdprintf(fd, "    most recent stall: %s at %s", client->mSnapshot, buf);
+        }
+    }
+}
+
 void AudioWatchdog::requestExit()
 {
     // must be in this order to avoid a race condition
@@ -135,5 +323,3 @@ void AudioWatchdog::setDump(AudioWatchdogDump *dump)
 }
 
 }   // namespace android
-
-#endif // AUDIO_WATCHDOG
@@ -17,13 +17,16 @@
 // The watchdog thread runs periodically.  It has two functions:
 //   (a) verify that adequate CPU time is available, and log
 //       as soon as possible when there appears to be a CPU shortage
-//   (b) monitor the other threads [not yet implemented]
+//   (b) monitor the deadlines of the other threads, see AudioWatchdogClient
 
 #ifndef AUDIO_WATCHDOG_H
 #define AUDIO_WATCHDOG_H
 
 #include <time.h>
+#include <cutils/atomic.h>
 #include <utils/Thread.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -38,6 +41,61 @@ struct AudioWatchdogDump {
     void     dump(int fd);  // should only be called on a stable copy, not the original
 };
 
+class AudioWatchdog;
+
+// Deadline record of one monitored thread, allocated by AudioWatchdog::addClient().
+// The monitored thread calls kick() once per cycle, which costs a few loads and stores,
+// and counts its own deadline misses, so the count is exact and available without a syscall.
+// The watchdog thread polls the records, and when it finds an active thread that has not
+// kicked within its deadline, it takes a snapshot of the stalled thread's scheduler state.
+// While none of its clients is active the watchdog parks, and the first kick() out of
+// standby resumes it.
+// Fields written by the monitored thread are 32-bit, so each is read atomically by the
+// watchdog, but the usual caveats about consistency between fields apply.
+struct AudioWatchdogClient {
+    AudioWatchdogClient(AudioWatchdog *watchdog, const char *name, pid_t tid,
+            nsecs_t deadlineNs);
+
+    // Called by the monitored thread once per cycle.  Cycles that start while the thread is
+    // active and end more than the deadline later are counted as misses.
+    void kick(nsecs_t now, bool active) {
+        uint32_t nowUs = (uint32_t) (now / 1000);
+        bool wasActive = mActive;
+        if (active && wasActive && nowUs - mLastKickUs > mDeadlineUs) {
+            mMisses++;
+        }
+        mLastKickUs = nowUs;
+        android_atomic_release_store(active, &mActive);
+        if (active && !wasActive) {
+            // leaving standby, the watchdog may be parked
+            activated();
+        }
+    }
+
+    // Called by the monitored thread before it blocks with no deadline, such as in standby
+    void idle() { android_atomic_release_store(0, &mActive); }
+
+    void activated();
+
+    // set at construction
+    AudioWatchdog*  mWatchdog;
+    char            mName[16];
+    pid_t           mTid;           // may be set after construction, before the first kick()
+    const uint32_t  mDeadlineUs;
+
+    // written by the monitored thread
+    volatile uint32_t mLastKickUs;  // low 32 bits of monotonic time of the most recent kick()
+    volatile int32_t  mActive;      // whether the thread is expected to kick() again in time
+    volatile uint32_t mMisses;      // total number of cycles longer than the deadline
+
+    // written by the watchdog thread
+    uint32_t        mStalls;        // number of stalls observed while still in progress
+    uint32_t        mSnapshotKickUs; // mLastKickUs of the stall in mSnapshot, to take one each
+    uint32_t        mMaxLateUs;     // maximum time observed past the deadline
+    time_t          mSnapshotTime;  // wall clock time of mSnapshot, 0 if none
+    char            mSnapshot[128]; // scheduler state of the thread during the most recent stall
+};
+
 class AudioWatchdog : public Thread {
 
 public:
@@ -45,14 +103,14 @@ public:
             mPeriodNs(periodMs * 1000000), mMaxCycleNs(mPeriodNs * 2),
             // mOldTs
             // mLogTs initialized below
-            mOldTsValid(false), mUnderruns(0), mLogs(0), mDump(&mDummyDump)
+            mOldTsValid(false), mUnderruns(0), mLogs(0), mDump(&mDummyDump), mTracedMisses(0)
         {
 #define MIN_TIME_BETWEEN_LOGS_SEC 60
             // force an immediate log on first underrun
             mLogTs.tv_sec = MIN_TIME_BETWEEN_LOGS_SEC;
             mLogTs.tv_nsec = 0;
         }
-    virtual         ~AudioWatchdog() { }
+    virtual         ~AudioWatchdog();
 
      // Do not call Thread::requestExitAndWait() without first calling requestExit().
     // Thread::requestExitAndWait() is not virtual, and the implementation doesn't do enough.
@@ -65,8 +123,23 @@ public:
     // Where to store the dump, or NULL to not update
     void            setDump(AudioWatchdogDump* dump);
 
+    // Start monitoring the thread with the given tid, which must then call kick() on the
+    // returned record at least once per deadline while it is active.
+    AudioWatchdogClient* addClient(const char *name, pid_t tid, nsecs_t deadlineNs);
+    // Stop monitoring, must be called before the thread exits; the record is deleted
+    void            removeClient(AudioWatchdogClient *client);
+
+    // Sum of AudioWatchdogClient::mMisses over all current clients
+    uint32_t        misses();
+
+    // Dump the deadline records of all clients
+    void            dumpClients(int fd);
+
 private:
     virtual bool    threadLoop();
+    // returns whether any client is active
+    bool            checkClients_l(const struct timespec& now);
+    static void     snapshot(AudioWatchdogClient *client);
 
     Mutex           mMyLock;        // Thread::mLock is private
     Condition       mMyCond;        // Thread::mThreadExitedCondition is private
@@ -81,6 +154,8 @@ private:
     uint32_t        mLogs;          // total number of logs
     AudioWatchdogDump*  mDump;      // where to store the dump, always non-NULL
     AudioWatchdogDump   mDummyDump; // default area for dump in case setDump() is not called
+    Vector<AudioWatchdogClient *> mClients; // protected by mMyLock
+    uint32_t        mTracedMisses;  // most recent value of misses() sent to systrace
 };
 
 }   // namespace android
@@ -29,14 +29,29 @@
 // uncomment to display CPU load adjusted for CPU frequency
 //#define CPU_FREQUENCY_STATISTICS
 
+// uncomment to let the normal mixer double its period during long-running playback of
+// deep-buffered normal tracks, returning to the default period when a fast track appears
+//#define ADAPTIVE_NORMAL_MIX_PERIOD
+
+// uncomment to let offload threads waiting for data sleep for up to half of the audio estimated
+// to remain in the DSP, rather than polling every 10 ms; relies on the stream latency being the
+// duration of the DSP buffer
+//#define OFFLOAD_PARTIAL_WAKEUP
+
+// uncomment to collect normal mixer time per track and effect engine time per effect,
+// as histograms in dumpsys
+//#define MIXER_TRACK_STATISTICS
+
 // uncomment to enable fast mixer to take performance samples for later statistical analysis
 #define FAST_MIXER_STATISTICS
 
-// uncomment to allow fast tracks at non-native sample rate
-//#define FAST_TRACKS_AT_NON_NATIVE_SAMPLE_RATE
+// comment out to restrict fast tracks to the native sample rate; otherwise they are resampled
+// by the fast mixer with the linear resampler, up to twice the native sample rate
+#define FAST_TRACKS_AT_NON_NATIVE_SAMPLE_RATE
 
-// uncomment for debugging timing problems related to StateQueue::push()
-//#define STATE_QUEUE_DUMP
+// comment out to disable the StateQueue::push() statistics in dumpsys, which are also useful for
+// debugging timing problems; the cost is a few unsynchronized counter increments per push
+#define STATE_QUEUE_DUMP
 
 // uncomment to allow tee sink debugging to be enabled by property
 //#define TEE_SINK
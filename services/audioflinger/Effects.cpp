@@ -269,9 +269,15 @@ void AudioFlinger::EffectModule::process()
         }
 
         // do the actual processing in the effect engine
+#ifdef MIXER_TRACK_STATISTICS
+        nsecs_t start = systemTime();
+#endif
         int ret = (*mEffectInterface)->process(mEffectInterface,
                                                &mConfig.inputCfg.buffer,
                                                &mConfig.outputCfg.buffer);
+#ifdef MIXER_TRACK_STATISTICS
+        mProcessTimeHistogram.add(systemTime() - start);
+#endif
 
         // force transition to IDLE state when engine is ready
         if (mState == STOPPED && ret == -ENODATA) {
@@ -914,6 +920,10 @@ void AudioFlinger::EffectModule::dump(int fd, const Vector<String16>& args)
             mConfig.outputCfg.format);
     result.append(buffer);
 
+#ifdef MIXER_TRACK_STATISTICS
+    mProcessTimeHistogram.dump(result, "\t\t- Process time per cycle, buckets in us:\n\t\t\t");
+#endif
+
     snprintf(buffer, SIZE, "\t\t%d Clients:\n", mHandles.size());
     result.append(buffer);
     result.append("\t\t\tPid   Priority Ctrl Locked client server\n");
@@ -1257,7 +1267,8 @@ void AudioFlinger::EffectHandle::dump(char* buffer, size_t size)
 AudioFlinger::EffectChain::EffectChain(ThreadBase *thread,
                                         int sessionId)
     : mThread(thread), mSessionId(sessionId), mActiveTrackCnt(0), mTrackCnt(0), mTailBufferCount(0),
-      mOwnInBuffer(false), mVolumeCtrlIdx(-1), mLeftVolume(UINT_MAX), mRightVolume(UINT_MAX),
+      mSilentTailBufferCount(0), mSilentBuffersSkipped(0),
+      mOwnInBuffer(false), mOwnOutBuffer(false), mVolumeCtrlIdx(-1), mLeftVolume(UINT_MAX), mRightVolume(UINT_MAX),
       mNewLeftVolume(UINT_MAX), mNewRightVolume(UINT_MAX), mIsForLPATrack(false)
 {
     mStrategy = AudioSystem::getStrategyForStream(AUDIO_STREAM_MUSIC);
@@ -1266,12 +1277,16 @@ AudioFlinger::EffectChain::EffectChain(ThreadBase *thread,
     }
     mMaxTailBuffers = ((kProcessTailDurationMs * thread->sampleRate()) / 1000) /
                                     thread->frameCount();
+    mSilentTailBufferCount = mMaxTailBuffers;
 }
 
 AudioFlinger::EffectChain::~EffectChain()
 {
     if (mOwnInBuffer) {
-        delete mInBuffer;
+        delete[] mInBuffer;
+    }
+    if (mOwnOutBuffer) {
+        delete[] mOutBuffer;
     }
 
 }
@@ -1347,6 +1362,26 @@ void AudioFlinger::EffectChain::clearInputBuffer_l(sp<ThreadBase> thread)
     memset(mInBuffer, 0, thread->frameCount() * thread->frameSize());
 }
 
+// Must be called with EffectChain::mLock locked
+bool AudioFlinger::EffectChain::isInputSilent_l(const sp<ThreadBase>& thread) const
+{
+    // auxiliary effects are fed by the tracks through their own input buffer
+    for (size_t i = 0; i < mEffects.size(); i++) {
+        if ((mEffects[i]->desc().flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_AUXILIARY) {
+            return false;
+        }
+    }
+    // the input buffer is 32 bit aligned and holds a whole number of 16 bit stereo frames
+    const int32_t *in = (const int32_t *) mInBuffer;
+    size_t count = (thread->frameCount() * thread->frameSize()) / sizeof(int32_t);
+    for (size_t i = 0; i < count; i++) {
+        if (in[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
 // Must be called with EffectChain::mLock locked
 void AudioFlinger::EffectChain::process_l()
 {
@@ -1380,6 +1415,20 @@ void AudioFlinger::EffectChain::process_l()
         }
     }
 
+    // Once the input has been digital silence for longer than the effect tail, the output of the
+    // effects is silent as well: skip processing until audio comes back.  For session chains
+    // this accumulates nothing into the mix, and global chains leave their silent buffer as is.
+    if (doProcess && !isForLPATrack()) {
+        if (!isInputSilent_l(thread)) {
+            mSilentTailBufferCount = mMaxTailBuffers;
+        } else if (mSilentTailBufferCount > 0) {
+            mSilentTailBufferCount--;
+        } else {
+            doProcess = false;
+            mSilentBuffersSkipped++;
+        }
+    }
+
     size_t size = mEffects.size();
     if (doProcess || isForLPATrack()) {
         for (size_t i = 0; i < size; i++) {
@@ -1650,6 +1699,8 @@ void AudioFlinger::EffectChain::dump(int fd, const Vector<String16>& args)
             (uint32_t)mOutBuffer,
             mActiveTrackCnt);
     result.append(buffer);
+    snprintf(buffer, SIZE, "\tSilent input buffers skipped: %u\n", mSilentBuffersSkipped);
+    result.append(buffer);
     write(fd, result.string(), result.size());
 
     for (size_t i = 0; i < mEffects.size(); ++i) {
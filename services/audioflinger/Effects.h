@@ -160,6 +160,8 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
     bool     mSuspended;            // effect is suspended: temporarily disabled by framework
     bool     mOffloaded;            // effect is currently offloaded to the audio DSP
     bool     mIsForLPA;
+    ProcessTimeHistogram mProcessTimeHistogram; // engine process() time per cycle,
+                                                // see MIXER_TRACK_STATISTICS
 };
 
 // The EffectHandle class implements the IEffect interface. It provides resources
@@ -284,18 +286,26 @@ public:
     void setAudioSource_l(audio_source_t source);
 
     void setInBuffer(int16_t *buffer, bool ownsBuffer = false) {
+        if (mOwnInBuffer && mInBuffer != buffer) {
+            delete[] mInBuffer;
+        }
         mInBuffer = buffer;
         mOwnInBuffer = ownsBuffer;
     }
     int16_t *inBuffer() const {
         return mInBuffer;
     }
-    void setOutBuffer(int16_t *buffer) {
+    void setOutBuffer(int16_t *buffer, bool ownsBuffer = false) {
+        if (mOwnOutBuffer && mOutBuffer != buffer) {
+            delete[] mOutBuffer;
+        }
         mOutBuffer = buffer;
+        mOwnOutBuffer = ownsBuffer;
     }
     int16_t *outBuffer() const {
         return mOutBuffer;
     }
+    bool ownsOutBuffer() const { return mOwnOutBuffer; }
 
     void incTrackCnt() { android_atomic_inc(&mTrackCnt); }
     void decTrackCnt() { android_atomic_dec(&mTrackCnt); }
@@ -355,6 +365,8 @@ protected:
     bool isEffectEligibleForSuspend(const effect_descriptor_t& desc);
 
     void clearInputBuffer_l(sp<ThreadBase> thread);
+    // true if the chain input is digital silence, and the chain has no auxiliary effect
+    bool isInputSilent_l(const sp<ThreadBase>& thread) const;
 
     wp<ThreadBase> mThread;     // parent mixer thread
     Mutex mLock;                // mutex protecting effect list
@@ -369,7 +381,10 @@ protected:
 
     int32_t mTailBufferCount;   // current effect tail buffer count
     int32_t mMaxTailBuffers;    // maximum effect tail buffers
+    int32_t mSilentTailBufferCount; // buffers to process before skipping a silent input
+    uint32_t mSilentBuffersSkipped; // number of cycles skipped on silent input, for dumpsys
     bool mOwnInBuffer;          // true if the chain owns its input buffer
+    bool mOwnOutBuffer;         // true if the chain owns its output buffer
     int mVolumeCtrlIdx;         // index of insert effect having control over volume
     uint32_t mLeftVolume;       // previous volume on left channel
     uint32_t mRightVolume;      // previous volume on right channel
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FastCapture"
+//#define LOG_NDEBUG 0
+
+#include "Configuration.h"
+#include <unistd.h>
+#include <utils/Log.h>
+#include "FastCapture.h"
+
+namespace android {
+
+// sleep time after a HAL read error, before trying again
+static const useconds_t kReadErrorSleepUs = 5000;
+
+void FastCaptureDump::dump(int fd)
+{
+    fdprintf(fd, "Fast capture: reads=%u readErrors=%u overruns=%u framesDropped=%u\n",
+            mReads, mReadErrors, mOverruns, mFramesDropped);
+}
+
+FastCapture::FastCapture(audio_stream_in *input, const sp<MonoPipe>& pipe, size_t frameCount,
+        size_t frameSize) :
+    Thread(false /*canCallJava*/),
+    mInput(input), mPipe(pipe), mFrameCount(frameCount), mFrameSize(frameSize),
+    mReadBuffer(new int8_t[frameCount * frameSize]),
+    mActive(false), mReading(false), mDump(&mDummyDump)
+{
+}
+
+FastCapture::~FastCapture()
+{
+    delete[] mReadBuffer;
+}
+
+bool FastCapture::threadLoop()
+{
+    {
+        AutoMutex _l(mMyLock);
+        if (!mActive) {
+            mMyCond.wait(mMyLock);
+            // caller will check for exitPending()
+            return true;
+        }
+        mReading = true;
+    }
+
+    // The HAL read is the only place this thread blocks while active
+    ssize_t bytesRead = mInput->read(mInput, mReadBuffer, mFrameCount * mFrameSize);
+    if (bytesRead > 0) {
+        size_t frames = bytesRead / mFrameSize;
+        // the pipe is non-blocking: if the RecordThread is too late, the newest data is lost
+        ssize_t written = mPipe->write(mReadBuffer, frames);
+        mDump->mReads++;
+        if (written < (ssize_t) frames) {
+            mDump->mOverruns++;
+            mDump->mFramesDropped += frames - (written > 0 ? written : 0);
+        }
+    } else {
+        mDump->mReadErrors++;
+    }
+
+    {
+        AutoMutex _l(mMyLock);
+        mReading = false;
+        mMyCond.broadcast();
+    }
+    if (bytesRead <= 0) {
+        usleep(kReadErrorSleepUs);
+    }
+    return true;
+}
+
+void FastCapture::requestExit()
+{
+    // must be in this order to avoid a race condition
+    Thread::requestExit();
+    AutoMutex _l(mMyLock);
+    mMyCond.broadcast();
+}
+
+bool FastCapture::start()
+{
+    AutoMutex _l(mMyLock);
+    if (mActive) {
+        return false;
+    }
+    mActive = true;
+    mMyCond.broadcast();
+    return true;
+}
+
+void FastCapture::standby()
+{
+    {
+        AutoMutex _l(mMyLock);
+        mActive = false;
+        while (mReading) {
+            mMyCond.wait(mMyLock);
+        }
+    }
+    mInput->common.standby(&mInput->common);
+}
+
+void FastCapture::setDump(FastCaptureDump *dump)
+{
+    mDump = dump != NULL ? dump : &mDummyDump;
+}
+
+}   // namespace android
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The fast capture thread is the capture counterpart of the fast mixer.  It runs at SCHED_FIFO
+// and does nothing but read the input HAL, one HAL buffer at a time, into a non-blocking
+// MonoPipe.  The RecordThread then reads from the MonoPipeReader at its own pace, so a late
+// RecordThread cycle no longer delays the HAL read and causes an input overrun.
+
+#ifndef ANDROID_AUDIO_FAST_CAPTURE_H
+#define ANDROID_AUDIO_FAST_CAPTURE_H
+
+#include <utils/Thread.h>
+#include <hardware/audio.h>
+#include <media/nbaio/MonoPipe.h>
+
+namespace android {
+
+// Keeps a cache of FastCapture statistics that can be logged by dumpsys.
+// The usual caveats about atomicity of information apply.
+struct FastCaptureDump {
+    FastCaptureDump() : mReads(0), mReadErrors(0), mOverruns(0), mFramesDropped(0) { }
+    /*virtual*/ ~FastCaptureDump() { }
+    uint32_t mReads;            // number of successful HAL reads
+    uint32_t mReadErrors;       // number of failed HAL reads
+    uint32_t mOverruns;         // number of HAL reads that did not entirely fit in the pipe
+    uint32_t mFramesDropped;    // total number of frames that did not fit in the pipe
+    void     dump(int fd);      // should only be called on a stable copy, not the original
+};
+
+class FastCapture : public Thread {
+
+public:
+    // The input must be PCM, and stays owned by the caller.  frameCount is the HAL buffer size.
+    FastCapture(audio_stream_in *input, const sp<MonoPipe>& pipe, size_t frameCount,
+            size_t frameSize);
+    virtual         ~FastCapture();
+
+    // Do not call Thread::requestExitAndWait() without first calling requestExit().
+    // Thread::requestExitAndWait() is not virtual, and the implementation doesn't do enough.
+    virtual void        requestExit();
+
+    // Start reading the HAL into the pipe, if not already doing so.  Returns true if the
+    // thread was in standby, in which case the pipe may still contain stale data.
+    bool            start();
+
+    // Stop reading the HAL, wait for a HAL read in progress to complete, then put the HAL input
+    // in standby.  Must be used instead of calling standby() on the input directly.
+    void            standby();
+
+    // Where to store the dump, or NULL to not update
+    void            setDump(FastCaptureDump* dump);
+
+private:
+    virtual bool    threadLoop();
+
+    audio_stream_in * const mInput;
+    const sp<MonoPipe> mPipe;
+    const size_t    mFrameCount;
+    const size_t    mFrameSize;
+    int8_t*         mReadBuffer;    // one HAL buffer
+
+    Mutex           mMyLock;        // Thread::mLock is private
+    Condition       mMyCond;        // Thread::mThreadExitedCondition is private
+    bool            mActive;        // whether the HAL should be read
+    bool            mReading;       // whether a HAL read is in progress
+
+    FastCaptureDump*    mDump;      // where to store the dump, always non-NULL
+    FastCaptureDump     mDummyDump; // default area for dump in case setDump() is not called
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_FAST_CAPTURE_H
@@ -38,6 +38,7 @@
 #endif
 #endif
 #include "AudioMixer.h"
+#include "AudioWatchdog.h"
 #include "FastMixer.h"
 
 #define FAST_HOT_IDLE_NS     1000000L   // 1 ms: time to sleep while hot idling
@@ -86,6 +87,8 @@ bool FastMixer::threadLoop()
     bool oldLoadValid = false;  // whether oldLoad is valid
     uint32_t bounds = 0;
     bool full = false;      // whether we have collected at least mSamplingN samples
+    struct timespec lastUnderrunTs = {0, 0};    // time of the most recent underrun
+    bool lastUnderrunValid = false;             // whether lastUnderrunTs is valid
 #ifdef CPU_FREQUENCY_STATISTICS
     ThreadCpuUsage tcu;     // for reading the current CPU clock frequency in kHz
 #endif
@@ -96,6 +99,7 @@ bool FastMixer::threadLoop()
     uint32_t warmupCycles = 0;  // counter of number of loop cycles required to warmup
     NBAIO_Sink* teeSink = NULL; // if non-NULL, then duplicate write() to this non-blocking sink
     NBLog::Writer dummyLogWriter, *logWriter = &dummyLogWriter;
+    AudioWatchdogClient *watchdogClient = NULL; // if non-NULL, report deadlines to watchdog
     uint32_t totalNativeFramesWritten = 0;  // copied to dumpState->mFramesWritten
 
     // next 2 fields are valid only when timestampStatus == NO_ERROR
@@ -133,6 +137,7 @@ bool FastMixer::threadLoop()
             dumpState = next->mDumpState != NULL ? next->mDumpState : &dummyDumpState;
             teeSink = next->mTeeSink;
             logWriter = next->mNBLogWriter != NULL ? next->mNBLogWriter : &dummyLogWriter;
+            watchdogClient = next->mWatchdogClient;
             if (mixer != NULL) {
                 mixer->setLog(logWriter);
             }
@@ -166,6 +171,10 @@ bool FastMixer::threadLoop()
 
         dumpState->mCommand = command;
 
+        if ((command & FastMixerState::IDLE) && watchdogClient != NULL) {
+            watchdogClient->idle();
+        }
+
         switch (command) {
         case FastMixerState::INITIAL:
         case FastMixerState::HOT_IDLE:
@@ -204,6 +213,9 @@ bool FastMixer::threadLoop()
             }
             continue;
         case FastMixerState::EXIT:
+            if (watchdogClient != NULL) {
+                watchdogClient->idle();
+            }
             delete mixer;
             delete[] mixBuffer;
             return false;
@@ -321,6 +333,10 @@ bool FastMixer::threadLoop()
                         mixer->setParameter(name, AudioMixer::TRACK, AudioMixer::MAIN_BUFFER,
                                 (void *) mixBuffer);
                         // newly allocated track names default to full scale volume
+                        // the fast mixer can't afford the multi-tap resamplers, whose cost
+                        // depends on the ratio; the linear one has a small fixed cost per frame
+                        mixer->setParameter(name, AudioMixer::RESAMPLE, AudioMixer::QUALITY,
+                                (void *) AudioResampler::LOW_QUALITY);
                         if (fastTrack->mSampleRate != 0 && fastTrack->mSampleRate != sampleRate) {
                             mixer->setParameter(name, AudioMixer::RESAMPLE,
                                     AudioMixer::SAMPLE_RATE, (void*) fastTrack->mSampleRate);
@@ -394,7 +410,6 @@ bool FastMixer::threadLoop()
                 if (timestampStatus == NO_ERROR) {
                     uint32_t trackFramesWrittenButNotPresented;
                     uint32_t trackSampleRate = fastTrack->mSampleRate;
-                    // There is currently no sample rate conversion for fast tracks currently
                     if (trackSampleRate != 0 && trackSampleRate != sampleRate) {
                         trackFramesWrittenButNotPresented =
                                 ((int64_t) nativeFramesWrittenButNotPresented * trackSampleRate) /
@@ -436,9 +451,16 @@ bool FastMixer::threadLoop()
                     traceName[5] = '\0';
                     ATRACE_INT(traceName, framesReady);
                 }
+                // a resampled track consumes its own number of frames per mix cycle,
+                // plus one frame of look-ahead for the interpolator
+                size_t framesNeeded = frameCount;
+                if (fastTrack->mSampleRate != 0 && fastTrack->mSampleRate != sampleRate) {
+                    framesNeeded = ((uint64_t) frameCount * fastTrack->mSampleRate) /
+                            sampleRate + 1;
+                }
                 FastTrackDump *ftDump = &dumpState->mTracks[i];
                 FastTrackUnderruns underruns = ftDump->mUnderruns;
-                if (framesReady < frameCount) {
+                if (framesReady < framesNeeded) {
                     if (framesReady == 0) {
                         underruns.mBitFields.mEmpty++;
                         underruns.mBitFields.mMostRecent = UNDERRUN_EMPTY;
@@ -518,6 +540,9 @@ bool FastMixer::threadLoop()
         int rc = clock_gettime(CLOCK_MONOTONIC, &newTs);
         if (rc == 0) {
             //logWriter->logTimestamp(newTs);
+            if (watchdogClient != NULL) {
+                watchdogClient->kick(newTs.tv_sec * 1000000000LL + newTs.tv_nsec, isWarm);
+            }
             if (oldTsValid) {
                 time_t sec = newTs.tv_sec - oldTs.tv_sec;
                 long nsec = newTs.tv_nsec - oldTs.tv_nsec;
@@ -558,6 +583,15 @@ bool FastMixer::threadLoop()
                                 (int) sec, nsec / 1000000L);
                         dumpState->mUnderruns++;
                         ignoreNextOverrun = true;
+#ifdef FAST_MIXER_STATISTICS
+                        if (lastUnderrunValid) {
+                            dumpState->mUnderrunGapHistogram.add(
+                                    (newTs.tv_sec - lastUnderrunTs.tv_sec) * 1000000000LL +
+                                    (newTs.tv_nsec - lastUnderrunTs.tv_nsec));
+                        }
+                        lastUnderrunTs = newTs;
+                        lastUnderrunValid = true;
+#endif
                     } else if (nsec < overrunNs) {
                         if (ignoreNextOverrun) {
                             ignoreNextOverrun = false;
@@ -593,6 +627,7 @@ bool FastMixer::threadLoop()
                     if (sec > 0 && sec < 4) {
                         monotonicNs += sec * 1000000000;
                     }
+                    dumpState->mCycleHistogram.add(sec * 1000000000LL + nsec);
                     // compute raw CPU load = delta value of clock_gettime(CLOCK_THREAD_CPUTIME_ID)
                     uint32_t loadNs = 0;
                     struct timespec newLoad;
@@ -626,6 +661,7 @@ bool FastMixer::threadLoop()
                     // or with respect to store #4 below
                     dumpState->mMonotonicNs[i] = monotonicNs;
                     dumpState->mLoadNs[i] = loadNs;
+                    dumpState->mLoadHistogram.add(loadNs);
 #ifdef CPU_FREQUENCY_STATISTICS
                     dumpState->mCpukHz[i] = kHz;
 #endif
@@ -835,6 +871,12 @@ void FastMixerDumpState::dump(int fd) const
                      right.stddev()*1e-6);
         delete[] tail;
     }
+    String8 histograms;
+    histograms.append("Log-scale histograms over all warm cycles since start:\n");
+    mCycleHistogram.dump(histograms, "  wall clock time in ms per mix cycle");
+    mLoadHistogram.dump(histograms, "  raw CPU load in ms per mix cycle");
+    mUnderrunGapHistogram.dump(histograms, "  time in ms between underruns");
+    fdprintf(fd, "%s", histograms.string());
 #endif
     // The active track mask and track states are updated non-atomically.
     // So if we relied on isActive to decide whether to display,
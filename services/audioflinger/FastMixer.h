@@ -24,6 +24,7 @@ extern "C" {
 }
 #include "StateQueue.h"
 #include "FastMixerState.h"
+#include "LogHistogram.h"
 
 namespace android {
 
@@ -132,6 +133,10 @@ struct FastMixerDumpState {
 #endif
     // Increase sampling window after construction, must be a power of 2 <= kSamplingN
     void    increaseSamplingN(uint32_t samplingN);
+    // Unlike the samples above, these cover every warm cycle since the fast mixer started
+    LogHistogram mCycleHistogram;       // delta monotonic (wall clock) time per cycle
+    LogHistogram mLoadHistogram;        // delta CPU load in time per cycle
+    LogHistogram mUnderrunGapHistogram; // monotonic time between successive underruns
 #endif
 };
 
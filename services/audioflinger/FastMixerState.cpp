@@ -32,7 +32,7 @@ FastTrack::~FastTrack()
 FastMixerState::FastMixerState() :
     mFastTracksGen(0), mTrackMask(0), mOutputSink(NULL), mOutputSinkGen(0),
     mFrameCount(0), mCommand(INITIAL), mColdFutexAddr(NULL), mColdGen(0),
-    mDumpState(NULL), mTeeSink(NULL), mNBLogWriter(NULL)
+    mDumpState(NULL), mTeeSink(NULL), mNBLogWriter(NULL), mWatchdogClient(NULL)
 {
 }
 
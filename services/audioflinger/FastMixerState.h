@@ -24,6 +24,7 @@
 
 namespace android {
 
+struct AudioWatchdogClient;
 struct FastMixerDumpState;
 
 class VolumeProvider {
@@ -53,7 +54,7 @@ struct FastMixerState {
                 FastMixerState();
     /*virtual*/ ~FastMixerState();
 
-    static const unsigned kMaxFastTracks = 8;   // must be between 2 and 32 inclusive
+    static const unsigned kMaxFastTracks = 16;  // must be between 2 and 32 inclusive
 
     // all pointer fields use raw pointers; objects are owned and ref-counted by the normal mixer
     FastTrack   mFastTracks[kMaxFastTracks];
@@ -79,6 +80,7 @@ struct FastMixerState {
     FastMixerDumpState* mDumpState; // if non-NULL, then update dump state periodically
     NBAIO_Sink* mTeeSink;       // if non-NULL, then duplicate write()s to this non-blocking sink
     NBLog::Writer* mNBLogWriter; // non-blocking logger
+    AudioWatchdogClient* mWatchdogClient; // if non-NULL, then kick() once per cycle
 };  // struct FastMixerState
 
 }   // namespace android
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_LOG_HISTOGRAM_H
+#define ANDROID_AUDIO_LOG_HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <utils/String8.h>
+
+namespace android {
+
+// Log-scale histogram of durations in nanoseconds, with kSubBuckets linear sub-buckets per
+// octave, so each bucket is at most 25% wide.  Unlike a window of samples it has a fixed size
+// no matter how long it runs, so it can cover an entire session and still show the rare
+// outliers.  Only POD types are used, and no locks or barriers: it is updated by one thread
+// and read by dumpsys, which may see a slightly inconsistent histogram.
+struct LogHistogram {
+    static const unsigned kSubBuckets = 4;      // must be a power of 2
+    static const unsigned kSubShift = 2;        // log2(kSubBuckets)
+    static const unsigned kMinShift = 10;       // bucket 0 counts durations < 2^10 ns ~= 1 us
+    static const unsigned kMaxShift = 44;       // the last bucket counts >= 2^44 ns ~= 4.9 hr
+    static const unsigned kNumBuckets = 1 + (kMaxShift - kMinShift) * kSubBuckets;
+
+    LogHistogram() { reset(); }
+
+    void reset() { memset(this, 0, sizeof(*this)); }
+
+    void add(uint64_t ns) {
+        mBuckets[bucket(ns)]++;
+        mCount++;
+        if (ns > mMaxNs) {
+            mMaxNs = ns;
+        }
+    }
+
+    // Return an upper bound in ns on the given fraction 0.0 < p <= 1.0 of the durations,
+    // accurate to the width of one bucket, or 0 if empty.
+    uint64_t percentile(double p) const {
+        uint64_t rank = (uint64_t) (p * mCount + 0.5);
+        if (rank == 0) {
+            rank = 1;
+        }
+        uint64_t sum = 0;
+        for (unsigned i = 0; i < kNumBuckets; ++i) {
+            sum += mBuckets[i];
+            if (sum >= rank) {
+                uint64_t upper = upperBound(i);
+                return upper < mMaxNs ? upper : mMaxNs;
+            }
+        }
+        return mMaxNs;
+    }
+
+    // Append a one-line summary in ms, prefixed by name, with p50, p99, and p99.9,
+    // followed by the non-empty buckets as "<upper bound in ms:count"
+    void dump(String8& result, const char *name) const {
+        result.appendFormat("%s: count=%llu", name, (unsigned long long) mCount);
+        if (mCount == 0) {
+            result.append("\n");
+            return;
+        }
+        result.appendFormat(" p50=%.3f p99=%.3f p99.9=%.3f max=%.3f ms\n   ",
+                percentile(0.5) * 1e-6, percentile(0.99) * 1e-6, percentile(0.999) * 1e-6,
+                mMaxNs * 1e-6);
+        for (unsigned i = 0; i < kNumBuckets; ++i) {
+            if (mBuckets[i] == 0) {
+                continue;
+            }
+            if (i < kNumBuckets - 1) {
+                result.appendFormat(" <%.3g:%u", upperBound(i) * 1e-6, mBuckets[i]);
+            } else {
+                result.appendFormat(" >=%.3g:%u", lowerBound(i) * 1e-6, mBuckets[i]);
+            }
+        }
+        result.append("\n");
+    }
+
+    static unsigned bucket(uint64_t ns) {
+        if (ns < (1ULL << kMinShift)) {
+            return 0;
+        }
+        unsigned octave = 63 - __builtin_clzll(ns);
+        if (octave >= kMaxShift) {
+            return kNumBuckets - 1;
+        }
+        unsigned sub = (ns >> (octave - kSubShift)) & (kSubBuckets - 1);
+        return 1 + (octave - kMinShift) * kSubBuckets + sub;
+    }
+
+    static uint64_t lowerBound(unsigned i) {
+        if (i == 0) {
+            return 0;
+        }
+        unsigned octave = kMinShift + (i - 1) / kSubBuckets;
+        unsigned sub = (i - 1) & (kSubBuckets - 1);
+        return (uint64_t) (kSubBuckets + sub) << (octave - kSubShift);
+    }
+
+    static uint64_t upperBound(unsigned i) {
+        return i < kNumBuckets - 1 ? lowerBound(i + 1) : ~0ULL;
+    }
+
+    uint64_t    mCount;                 // number of durations added
+    uint64_t    mMaxNs;
+    uint32_t    mBuckets[kNumBuckets];
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_LOG_HISTOGRAM_H
@@ -61,6 +61,8 @@ public:
             int         auxEffectId() const { return mAuxEffectId; }
     virtual status_t    getTimestamp(AudioTimestamp& timestamp);
             void        signal();
+            // publish the timestamp in shared memory, for the client to read without binder
+            void        publishTimestamp_l(PlaybackThread *playbackThread);
 
 // implement FastMixerState::VolumeProvider interface
     virtual uint32_t    getVolumeLR();
@@ -91,6 +93,7 @@ protected:
     bool isResuming() const { return mState == RESUMING; }
     bool isReady() const;
     void setPaused() { mState = PAUSED; }
+    status_t getTimestamp_l(PlaybackThread *playbackThread, AudioTimestamp& timestamp);
     void reset();
 
     bool isOutputTrack() const {
@@ -153,6 +156,8 @@ private:
     bool                mIsInvalid; // non-resettable latch, set by invalidate()
     AudioTrackServerProxy*  mAudioTrackServerProxy;
     bool                mResumeToStopping; // track was paused in stopping state.
+    ProcessTimeHistogram mMixTimeHistogram; // normal mixer time per cycle,
+                                            // see MIXER_TRACK_STATISTICS
 };  // end of Track
 
 class TimedTrack : public Track {
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_PROCESS_TIME_HISTOGRAM_H
+#define ANDROID_AUDIO_PROCESS_TIME_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <utils/String8.h>
+
+namespace android {
+
+// Log2 histogram of the time spent per mix cycle by one track or effect in the normal mixer.
+// Only POD types are used, and no locks or barriers: it is updated by the mixer thread and read
+// by dumpsys, which may see a slightly inconsistent histogram.
+struct ProcessTimeHistogram {
+    // bucket 0 counts cycles < 16 us, bucket i counts cycles < (16 << i) us,
+    // and the last bucket counts everything longer
+    static const unsigned kNumBuckets = 11;
+
+    ProcessTimeHistogram() { reset(); }
+
+    void reset() { memset(this, 0, sizeof(*this)); }
+
+    void add(uint32_t ns) {
+        uint32_t us = ns / 1000;
+        unsigned bucket = 0;
+        if (us >= 16) {
+            bucket = (31 - __builtin_clz(us)) - 3;
+            if (bucket >= kNumBuckets) {
+                bucket = kNumBuckets - 1;
+            }
+        }
+        mBuckets[bucket]++;
+        mCount++;
+        mTotalNs += ns;
+        if (ns > mMaxNs) {
+            mMaxNs = ns;
+        }
+    }
+
+    // Append a one-line summary, prefixed by name, followed by the non-empty buckets
+    void dump(String8& result, const char *name) const {
+        if (mCount == 0) {
+            return;
+        }
+        result.appendFormat("%s cycles=%u mean=%.1f max=%.1f us:", name, mCount,
+                (mTotalNs / (double) mCount) * 1e-3, mMaxNs * 1e-3);
+        for (unsigned i = 0; i < kNumBuckets; ++i) {
+            if (mBuckets[i] == 0) {
+                continue;
+            }
+            if (i < kNumBuckets - 1) {
+                result.appendFormat(" <%u:%u", 16 << i, mBuckets[i]);
+            } else {
+                result.appendFormat(" >=%u:%u", 16 << (i - 1), mBuckets[i]);
+            }
+        }
+        result.append("\n");
+    }
+
+    uint32_t    mCount;                 // number of cycles added
+    uint32_t    mMaxNs;
+    uint64_t    mTotalNs;
+    uint32_t    mBuckets[kNumBuckets];
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_PROCESS_TIME_HISTOGRAM_H
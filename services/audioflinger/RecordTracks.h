@@ -61,4 +61,6 @@ private:
     track_flags_t       mFlags;
     bool                mOverflow;  // overflow on most recent attempt to fill client buffer
     AudioRecordServerProxy* mAudioRecordServerProxy;
+    // non-NULL while the track is active as a secondary reader of the input
+    SharedCapture*      mSharedCapture;
 };
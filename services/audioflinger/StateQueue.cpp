@@ -33,8 +33,9 @@ void StateQueueObserverDump::dump(int fd)
 
 void StateQueueMutatorDump::dump(int fd)
 {
-    fdprintf(fd, "State queue mutator: pushDirty=%u pushAck=%u blockedSequence=%u\n",
-            mPushDirty, mPushAck, mBlockedSequence);
+    fdprintf(fd, "State queue mutator: pushDirty=%u pushAck=%u pushDeferred=%u squashed=%u "
+            "blockedSequence=%u\n",
+            mPushDirty, mPushAck, mPushDeferred, mSquashed, mBlockedSequence);
 }
 #endif
 
@@ -75,6 +76,11 @@ template<typename T> T* StateQueue<T>::begin()
 {
     ALOG_ASSERT(!mInMutation, "begin() called when in a mutation");
     mInMutation = true;
+#ifdef STATE_QUEUE_DUMP
+    if (mIsDirty) {
+        mMutatorDump->mSquashed++;
+    }
+#endif
     return mMutating;
 }
 
@@ -122,6 +128,9 @@ template<typename T> bool StateQueue<T>::push(StateQueue<T>::block_t block)
                     break;
                 }
                 if (block == BLOCK_NEVER) {
+#ifdef STATE_QUEUE_DUMP
+                    mMutatorDump->mPushDeferred++;
+#endif
                     return false;
                 }
 #ifdef STATE_QUEUE_DUMP
@@ -108,10 +108,15 @@ struct StateQueueObserverDump {
 };
 
 struct StateQueueMutatorDump {
-    StateQueueMutatorDump() : mPushDirty(0), mPushAck(0), mBlockedSequence(0) { }
+    StateQueueMutatorDump() : mPushDirty(0), mPushAck(0), mPushDeferred(0), mSquashed(0),
+            mBlockedSequence(0) { }
     /*virtual*/ ~StateQueueMutatorDump() { }
     unsigned    mPushDirty;       // incremented each time push() is called with a dirty state
     unsigned    mPushAck;         // incremented each time push(BLOCK_UNTIL_ACKED) is called
+    unsigned    mPushDeferred;    // incremented each time push(BLOCK_NEVER) returns false,
+                                  // because the observer has not yet acknowledged a prior push
+    unsigned    mSquashed;        // incremented each time begin() is called with a dirty state,
+                                  // so that the new mutation is batched with an unpushed one
     unsigned    mBlockedSequence; // incremented before and after each time that push()
                                   // blocks for more than one PUSH_BLOCK_ACK_NS;
                                   // if odd, then mutator is currently blocked inside push()
@@ -24,6 +24,7 @@
 #include "Configuration.h"
 #include <math.h>
 #include <fcntl.h>
+#include <sched.h>
 #include <sys/stat.h>
 #include <cutils/properties.h>
 #include <media/AudioParameter.h>
@@ -60,6 +61,8 @@
 #include <media/IMediaDeathNotifier.h>
 #endif
 
+#include <cpustats/ThreadCpuStats.h>
+
 #ifdef DEBUG_CPU_USAGE
 #include <cpustats/CentralTendencyStatistics.h>
 #include <cpustats/ThreadCpuUsage.h>
@@ -102,9 +105,16 @@ static const int8_t kMaxTrackRetriesDirect = 2;
 // don't warn about blocked writes or record buffer overflows more often than this
 static const nsecs_t kWarningThrottleNs = seconds(5);
 
+// A thread that is active misses its deadline if one cycle takes longer than this many periods
+static const int kWatchdogDeadlinePeriods = 3;
+
 // RecordThread loop sleep time upon application overrun or audio HAL read error
 static const int kRecordThreadSleepUs = 5000;
 
+// Idle sleeps of all playback and record threads end on a common grid of this period on the
+// monotonic clock, so that threads which are open but idle wake up together
+static const nsecs_t kIdleWakeupGridNs = milliseconds(10);
+
 // maximum time to wait for setParameters to complete
 static const nsecs_t kSetParametersTimeoutNs = seconds(2);
 
@@ -118,9 +128,25 @@ static const uint32_t kMinNormalMixBufferSizeMs = 20;
 // maximum normal mix buffer size
 static const uint32_t kMaxNormalMixBufferSizeMs = 24;
 
+#ifdef ADAPTIVE_NORMAL_MIX_PERIOD
+// The normal mix buffer is doubled when only normal tracks with deep enough buffers have been
+// playing for this long, and restored as soon as a fast track or a shallow normal track appears.
+// Doubling keeps the normal mixer's writes within the MonoPipe, which holds 4 normal periods.
+static const nsecs_t kLongNormalMixPeriodDelayNs = seconds(5);
+#endif
+
 // Offloaded output thread standby delay: allows track transition without going to standby
 static const nsecs_t kOffloadStandbyDelayNs = seconds(1);
 
+#ifdef OFFLOAD_PARTIAL_WAKEUP
+// maximum sleep of an offload thread waiting for data while the DSP still has plenty to play
+static const uint32_t kMaxOffloadSleepTimeUs = 100000;
+#endif
+
+// maximum number of threads helping a mixer thread process the effect chains of its sessions,
+// as configured by property ro.audio.effect_workers
+static const int kMaxEffectWorkers = 3;
+
 // Whether to use fast mixer
 static const enum {
     FastMixer_Never,    // never initialize or use: for debugging only
@@ -141,6 +167,7 @@ static const enum {
 // Priorities for requestPriority
 static const int kPriorityAudioApp = 2;
 static const int kPriorityFastMixer = 3;
+static const int kPriorityFastCapture = 3;
 
 // IAudioFlinger::createTrack() reports back to client the total size of shared memory area
 // for the track.  The client then sub-divides this into smaller buffers for its use.
@@ -284,8 +311,25 @@ AudioFlinger::ThreadBase::ThreadBase(const sp<AudioFlinger>& audioFlinger, audio
         mStandby(false), mOutDevice(outDevice), mInDevice(inDevice),
         mAudioSource(AUDIO_SOURCE_DEFAULT), mId(id),
         // mName will be set by concrete (non-virtual) subclass
-        mDeathRecipient(new PMDeathRecipient(this))
+        mDeathRecipient(new PMDeathRecipient(this)),
+        mWatchdogClient(NULL)
+{
+}
+
+void AudioFlinger::ThreadBase::addWatchdogClient(nsecs_t deadlineNs)
 {
+    if (mAudioFlinger->mDeadlineWatchdog != 0 && mWatchdogClient == NULL) {
+        mWatchdogClient = mAudioFlinger->mDeadlineWatchdog->addClient(mName, gettid(),
+                deadlineNs);
+    }
+}
+
+void AudioFlinger::ThreadBase::removeWatchdogClient()
+{
+    if (mWatchdogClient != NULL) {
+        mAudioFlinger->mDeadlineWatchdog->removeClient(mWatchdogClient);
+        mWatchdogClient = NULL;
+    }
 }
 
 AudioFlinger::ThreadBase::~ThreadBase()
@@ -998,17 +1042,171 @@ void AudioFlinger::ThreadBase::disconnectEffect(const sp<EffectModule>& effect,
     }
 }
 
+// Returns the sleep time, at least sleepTimeUs, that makes an idle thread wake up on the next
+// point of the shared idle wakeup grid.  Must only be used where a later wakeup is harmless,
+// i.e. when nothing is being written to or read from the HAL.
+static uint32_t coalescedIdleSleepTimeUs(uint32_t sleepTimeUs)
+{
+    nsecs_t now = systemTime();
+    nsecs_t wakeup = now + (nsecs_t) sleepTimeUs * 1000;
+    wakeup = ((wakeup + kIdleWakeupGridNs - 1) / kIdleWakeupGridNs) * kIdleWakeupGridNs;
+    return (uint32_t) ((wakeup - now) / 1000);
+}
+
 // ----------------------------------------------------------------------------
 //      Playback
 // ----------------------------------------------------------------------------
 
+// A bounded pool of threads which, together with the mixer thread, process the effect chains of
+// independent sessions concurrently.  The chains are processed with their locks held by the
+// mixer thread, which blocks in process() until all of them are done.
+class AudioFlinger::PlaybackThread::EffectWorkers : public RefBase {
+public:
+    EffectWorkers(const char *name, int numWorkers);
+    virtual ~EffectWorkers();
+
+    // Process the effect chains and return when they have all been processed
+    void process(const Vector< sp<EffectChain> >& chains);
+
+private:
+    class Worker : public Thread {
+    public:
+        Worker(EffectWorkers& workers) : Thread(false /*canCallJava*/), mWorkers(workers) { }
+    private:
+        virtual bool threadLoop();
+        EffectWorkers& mWorkers;
+    };
+
+    // process chains until there are none left, called with mLock held
+    void processChains_l();
+
+    Mutex                       mLock;
+    Condition                   mWorkCond;  // signaled when there are chains to process
+    Condition                   mDoneCond;  // signaled when the last chain has been processed
+    Vector< sp<EffectChain> >   mChains;    // of the current cycle, protected by mLock
+    size_t                      mNext;      // index of the next chain to process
+    size_t                      mDone;      // count of chains processed in the current cycle
+    bool                        mExiting;
+    Vector< sp<Worker> >        mWorkers;
+};
+
+AudioFlinger::PlaybackThread::EffectWorkers::EffectWorkers(const char *name, int numWorkers)
+    :   mNext(0), mDone(0), mExiting(false)
+{
+    for (int i = 0; i < numWorkers; i++) {
+        char workerName[16];
+        snprintf(workerName, sizeof(workerName), "%s_fx%d", name, i);
+        sp<Worker> worker = new Worker(*this);
+        worker->run(workerName, PRIORITY_URGENT_AUDIO);
+        mWorkers.add(worker);
+    }
+}
+
+AudioFlinger::PlaybackThread::EffectWorkers::~EffectWorkers()
+{
+    {
+        Mutex::Autolock _l(mLock);
+        mExiting = true;
+        for (size_t i = 0; i < mWorkers.size(); i++) {
+            mWorkers[i]->requestExit();
+        }
+        mWorkCond.broadcast();
+    }
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        mWorkers[i]->join();
+    }
+}
+
+void AudioFlinger::PlaybackThread::EffectWorkers::process(
+        const Vector< sp<EffectChain> >& chains)
+{
+    if (chains.size() < 2) {
+        // nothing to parallelize, don't bother waking up the workers
+        for (size_t i = 0; i < chains.size(); i++) {
+            chains[i]->process_l();
+        }
+        return;
+    }
+    Mutex::Autolock _l(mLock);
+    mChains = chains;
+    mNext = 0;
+    mDone = 0;
+    mWorkCond.broadcast();
+    // the mixer thread takes its share of the work
+    processChains_l();
+    while (mDone < mChains.size()) {
+        mDoneCond.wait(mLock);
+    }
+    mChains.clear();
+}
+
+void AudioFlinger::PlaybackThread::EffectWorkers::processChains_l()
+{
+    while (mNext < mChains.size()) {
+        sp<EffectChain> chain = mChains[mNext++];
+        mLock.unlock();
+        chain->process_l();
+        mLock.lock();
+        if (++mDone == mChains.size()) {
+            mDoneCond.signal();
+        }
+    }
+}
+
+bool AudioFlinger::PlaybackThread::EffectWorkers::Worker::threadLoop()
+{
+    Mutex::Autolock _l(mWorkers.mLock);
+    while (!mWorkers.mExiting && mWorkers.mNext >= mWorkers.mChains.size()) {
+        mWorkers.mWorkCond.wait(mWorkers.mLock);
+    }
+    if (mWorkers.mExiting) {
+        return false;
+    }
+    mWorkers.processChains_l();
+    return true;
+}
+
+void AudioFlinger::PlaybackThread::processEffectChains_l(
+        const Vector< sp<EffectChain> >& effectChains)
+{
+    // Session chains accumulate into their own output buffer and are independent of each other,
+    // so they are processed concurrently.  Then their outputs are accumulated into the mix buffer,
+    // in the same order as before, and the global chains are processed on the result.
+    mConcurrentEffectChains.clear();
+    for (size_t i = 0; i < effectChains.size(); i++) {
+        const sp<EffectChain>& chain = effectChains[i];
+        if (chain != mAudioFlinger->mLPAEffectChain && chain->ownsOutBuffer()) {
+            mConcurrentEffectChains.add(chain);
+        }
+    }
+    mEffectWorkers->process(mConcurrentEffectChains);
+
+    const size_t numSamples = mNormalFrameCount * mChannelCount;
+    for (size_t i = 0; i < mConcurrentEffectChains.size(); i++) {
+        int16_t *out = mConcurrentEffectChains[i]->outBuffer();
+        for (size_t j = 0; j < numSamples; j++) {
+            mMixBuffer[j] = clamp16((int32_t) mMixBuffer[j] + out[j]);
+        }
+        // ready for the next cycle, as the last effect of the chain accumulates
+        memset(out, 0, numSamples * sizeof(int16_t));
+    }
+    mConcurrentEffectChains.clear();
+
+    for (size_t i = 0; i < effectChains.size(); i++) {
+        const sp<EffectChain>& chain = effectChains[i];
+        if (chain != mAudioFlinger->mLPAEffectChain && !chain->ownsOutBuffer()) {
+            chain->process_l();
+        }
+    }
+}
+
 AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinger,
                                              AudioStreamOut* output,
                                              audio_io_handle_t id,
                                              audio_devices_t device,
                                              type_t type)
     :   ThreadBase(audioFlinger, id, device, AUDIO_DEVICE_NONE, type),
-        mNormalFrameCount(0), mMixBuffer(NULL),
+        mNormalFrameCount(0), mLongNormalMixPeriod(false), mMixBuffer(NULL), mWriteBuffer(NULL),
         mAllocMixBuffer(NULL), mSuspended(0), mBytesWritten(0),
         // mStreamTypes[] initialized in constructor body
         mOutput(output),
@@ -1026,7 +1224,8 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
         // index 0 is reserved for normal mixer's submix
         mFastTrackAvailMask(((1 << FastMixerState::kMaxFastTracks) - 1) & ~1),
         // mLatchD, mLatchQ,
-        mLatchDValid(false), mLatchQValid(false)
+        mLatchDValid(false), mLatchQValid(false),
+        mLatencyFrames(0), mMinLatencyFrames(UINT_MAX), mMaxLatencyFrames(0)
 {
     snprintf(mName, kNameLength, "AudioOut_%X", id);
     mNBLogWriter = audioFlinger->newWriter_l(kLogSize, mName);
@@ -1118,6 +1317,17 @@ void AudioFlinger::PlaybackThread::dumpTracks(int fd, const Vector<String16>& ar
             result.append(buffer);
         }
     }
+
+#ifdef MIXER_TRACK_STATISTICS
+    result.append("Normal mixer time per cycle by track name, buckets in us:\n");
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        sp<Track> track = mTracks[i];
+        if (track != 0 && !track->isFastTrack()) {
+            snprintf(buffer, SIZE, "   %4d", track->name() - AudioMixer::TRACK0);
+            track->mMixTimeHistogram.dump(result, buffer);
+        }
+    }
+#endif
     write(fd, result.string(), result.size());
 
     // These values are "raw"; they will wrap around.  See prepareTracks_l() for a better way.
@@ -1149,6 +1359,12 @@ void AudioFlinger::PlaybackThread::dumpInternals(int fd, const Vector<String16>&
     result.append(buffer);
     snprintf(buffer, SIZE, "mix buffer : %p\n", mMixBuffer);
     result.append(buffer);
+    if (mMinLatencyFrames != UINT_MAX && mSampleRate != 0) {
+        snprintf(buffer, SIZE, "measured latency (msecs): %.1f, min %.1f, max %.1f\n",
+                mLatencyFrames * 1000.0 / mSampleRate, mMinLatencyFrames * 1000.0 / mSampleRate,
+                mMaxLatencyFrames * 1000.0 / mSampleRate);
+        result.append(buffer);
+    }
     write(fd, result.string(), result.size());
     fdprintf(fd, "Fast track availMask=%#x\n", mFastTrackAvailMask);
 
@@ -1226,6 +1442,9 @@ sp<AudioFlinger::PlaybackThread::Track> AudioFlinger::PlaybackThread::createTrac
 #ifndef FAST_TRACKS_AT_NON_NATIVE_SAMPLE_RATE
             // hardware sample rate
             (sampleRate == mSampleRate) &&
+#else
+            // within the range of the fast mixer's linear resampler
+            (sampleRate <= mSampleRate * 2) &&
 #endif
             // normal mixer has an associated fast mixer
             hasFastMixer() &&
@@ -1237,6 +1456,13 @@ sp<AudioFlinger::PlaybackThread::Track> AudioFlinger::PlaybackThread::createTrac
         // if frameCount not specified, then it defaults to fast mixer (HAL) frame count
         if (frameCount == 0) {
             frameCount = mFrameCount * kFastTrackMultiplier;
+#ifdef FAST_TRACKS_AT_NON_NATIVE_SAMPLE_RATE
+            // a resampled fast track consumes more than mFrameCount frames per cycle
+            // when its sample rate is above the HAL sample rate
+            if (sampleRate > mSampleRate) {
+                frameCount = (frameCount * sampleRate + mSampleRate - 1) / mSampleRate;
+            }
+#endif
         }
         ALOGV("AUDIO_OUTPUT_FLAG_FAST accepted: frameCount=%d mFrameCount=%d",
                 frameCount, mFrameCount);
@@ -1247,6 +1473,9 @@ sp<AudioFlinger::PlaybackThread::Track> AudioFlinger::PlaybackThread::createTrac
                 isTimed, sharedBuffer.get(), frameCount, mFrameCount, format,
                 audio_is_linear_pcm(format),
                 channelMask, sampleRate, mSampleRate, hasFastMixer(), tid, mFastTrackAvailMask);
+        ALOGW_IF(hasFastMixer() && mFastTrackAvailMask == 0,
+                "AUDIO_OUTPUT_FLAG_FAST denied: all %u fast track slots are in use",
+                FastMixerState::kMaxFastTracks - 1);
         *flags &= ~IAudioFlinger::TRACK_FAST;
         // For compatibility with AudioTrack calculation, buffer depth is forced
         // to be at least 2 x the normal mixer frame count and cover audio hardware latency.
@@ -1707,6 +1936,9 @@ void AudioFlinger::PlaybackThread::readOutputParameters()
     mNormalFrameCount = multiplier * mFrameCount;
     // round up to nearest 16 frames to satisfy AudioMixer
     mNormalFrameCount = (mNormalFrameCount + 15) & ~15;
+    if (mLongNormalMixPeriod) {
+        mNormalFrameCount *= 2;
+    }
     ALOGI("HAL output buffer size %u frames, normal mix buffer size %u frames", mFrameCount,
             mNormalFrameCount);
 
@@ -1715,6 +1947,7 @@ void AudioFlinger::PlaybackThread::readOutputParameters()
     mAllocMixBuffer = new int8_t[mNormalFrameCount * mFrameSize + align - 1];
     mMixBuffer = (int16_t *) ((((size_t)mAllocMixBuffer + align - 1) / align) * align);
     memset(mMixBuffer, 0, mNormalFrameCount * mFrameSize);
+    mWriteBuffer = mMixBuffer;
 
     // force reconfiguration of effect chains and engines to take new buffer size and audio
     // parameters into account
@@ -1919,6 +2152,15 @@ ssize_t AudioFlinger::PlaybackThread::threadLoop_write()
             if (totalFramesWritten >= mLatchD.mTimestamp.mPosition) {
                 mLatchD.mUnpresentedFrames = totalFramesWritten - mLatchD.mTimestamp.mPosition;
                 mLatchDValid = true;
+                // frames written but not yet presented at the time of the timestamp
+                uint32_t latency = mLatchD.mUnpresentedFrames;
+                mLatencyFrames = latency;
+                if (latency < mMinLatencyFrames) {
+                    mMinLatencyFrames = latency;
+                }
+                if (latency > mMaxLatencyFrames) {
+                    mMaxLatencyFrames = latency;
+                }
             }
         }
     // otherwise use the HAL / AudioStreamOut directly
@@ -1935,7 +2177,7 @@ ssize_t AudioFlinger::PlaybackThread::threadLoop_write()
         // FIXME We should have an implementation of timestamps for direct output threads.
         // They are used e.g for multichannel PCM playback over HDMI.
         bytesWritten = mOutput->stream->write(mOutput->stream,
-                                                   mMixBuffer + offset, mBytesRemaining);
+                                                   mWriteBuffer + offset, mBytesRemaining);
         if (mUseAsyncWrite &&
                 ((bytesWritten < 0) || (bytesWritten == (ssize_t)mBytesRemaining))) {
             // do not wait for async callback in case of error of full write
@@ -2056,7 +2298,16 @@ status_t AudioFlinger::PlaybackThread::addEffectChain_l(const sp<EffectChain>& c
     }
 
     chain->setInBuffer(buffer, ownsBuffer);
-    chain->setOutBuffer(mMixBuffer);
+    if (ownsBuffer && mEffectWorkers != 0) {
+        // so that the chain can be processed concurrently with other sessions, it accumulates
+        // into its own output buffer, which processEffectChains_l() accumulates into mMixBuffer
+        size_t numSamples = mNormalFrameCount * mChannelCount;
+        int16_t *outBuffer = new int16_t[numSamples];
+        memset(outBuffer, 0, numSamples * sizeof(int16_t));
+        chain->setOutBuffer(outBuffer, true /*ownsBuffer*/);
+    } else {
+        chain->setOutBuffer(mMixBuffer);
+    }
     // Effect chain for session AUDIO_SESSION_OUTPUT_STAGE is inserted at end of effect
     // chains list in order to be processed last as it contains output stage effects
     // Effect chain for session AUDIO_SESSION_OUTPUT_MIX is inserted before
@@ -2185,6 +2436,13 @@ if (mType == MIXER) {
 
     CpuStats cpuStats;
     const String8 myName(String8::format("thread %p type %d TID %d", this, mType, gettid()));
+    ThreadCpuStats threadCpuStats(mName);
+
+    // An offloaded thread blocks for as long as the DSP has data, so has no useful deadline.
+    // Otherwise a cycle is late if it takes more than a few normal mix periods.
+    if (mType != OFFLOAD) {
+        addWatchdogClient(kWatchdogDeadlinePeriods * seconds(mNormalFrameCount) / mSampleRate);
+    }
 
     acquireWakeLock();
 
@@ -2198,6 +2456,11 @@ if (mType == MIXER) {
     while (!exitPending())
     {
         cpuStats.sample(myName);
+        threadCpuStats.sample();
+
+        if (mWatchdogClient != NULL) {
+            mWatchdogClient->kick(systemTime(), !mStandby);
+        }
 
         Vector< sp<EffectChain> > effectChains;
 
@@ -2218,6 +2481,13 @@ if (mType == MIXER) {
                 mLatchDValid = false;
                 mLatchQValid = true;
             }
+            // so that clients polling the position don't need a binder call each time
+            for (size_t i = 0; i < mActiveTracks.size(); i++) {
+                sp<Track> t = mActiveTracks[i].promote();
+                if (t != 0) {
+                    t->publishTimestamp_l(this);
+                }
+            }
 
             if (checkForNewParameters_l()) {
                 cacheParameters_l();
@@ -2232,6 +2502,9 @@ if (mType == MIXER) {
                     break;
                 }
                 releaseWakeLock_l();
+                if (mWatchdogClient != NULL) {
+                    mWatchdogClient->idle();
+                }
                 ALOGV("wait async completion");
                 mWaitWorkCV.wait(mLock);
                 ALOGV("async completion/wake");
@@ -2262,6 +2535,9 @@ if (mType == MIXER) {
                     }
 
                     releaseWakeLock_l();
+                    if (mWatchdogClient != NULL) {
+                        mWatchdogClient->idle();
+                    }
                     // wait until we have something to do...
                     ALOGV("%s going to sleep", myName.string());
                     mWaitWorkCV.wait(mLock);
@@ -2315,7 +2591,9 @@ if (mType == MIXER) {
             }
 
             // only process effects if we're going to write
-            if (sleepTime == 0 && mType != OFFLOAD) {
+            if (sleepTime == 0 && mType != OFFLOAD && mEffectWorkers != 0) {
+                processEffectChains_l(effectChains);
+            } else if (sleepTime == 0 && mType != OFFLOAD) {
                 for (size_t i = 0; i < effectChains.size(); i ++) {
                     if (effectChains[i] != mAudioFlinger->mLPAEffectChain) {
                         effectChains[i]->process_l();
@@ -2376,8 +2654,19 @@ if (mType == MIXER) {
 }
 
                 mStandby = false;
+#ifdef OFFLOAD_PARTIAL_WAKEUP
+            } else if (mType == OFFLOAD && sleepTime > activeSleepTime) {
+                // the long sleeps waiting for offloaded data are interrupted by broadcast_l(),
+                // so that pause, flush and stop requests are still handled promptly
+                Mutex::Autolock _l(mLock);
+                if (!mSignalPending) {
+                    mWaitWorkCV.waitRelative(mLock, microseconds(sleepTime));
+                }
+#endif
             } else {
-                usleep(sleepTime);
+                // while in standby with no track ready to mix, align with other idle threads
+                usleep((mStandby && mMixerStatus == MIXER_IDLE) ?
+                        coalescedIdleSleepTimeUs(sleepTime) : sleepTime);
             }
         }
 
@@ -2418,6 +2707,7 @@ if (mType == MIXER) {
         }
 #endif
     releaseWakeLock();
+    removeWatchdogClient();
 
     ALOGV("Thread %p type %d exiting", this, mType);
     return false;
@@ -2469,7 +2759,11 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
     :   PlaybackThread(audioFlinger, output, id, device, type),
         // mAudioMixer below
         // mFastMixer below
+        mFastMixerWatchdogClient(NULL),
         mFastMixerFutex(0)
+#ifdef ADAPTIVE_NORMAL_MIX_PERIOD
+        , mLongNormalMixPeriodSince(0)
+#endif
         // mOutputSink below
         // mPipeSink below
         // mNormalSink below
@@ -2480,6 +2774,20 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
             mSampleRate, mChannelMask, mChannelCount, mFormat, mFrameSize, mFrameCount,
             mNormalFrameCount);
     mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+#ifdef MIXER_TRACK_STATISTICS
+    mAudioMixer->setTrackTiming(true);
+#endif
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("ro.audio.effect_workers", value, NULL) > 0) {
+        int numWorkers = atoi(value);
+        if (numWorkers > kMaxEffectWorkers) {
+            numWorkers = kMaxEffectWorkers;
+        }
+        if (numWorkers > 0) {
+            mEffectWorkers = new EffectWorkers(mName, numWorkers);
+        }
+    }
 
     // FIXME - Current mixer implementation only supports stereo output
     if (mChannelCount != FCC_2) {
@@ -2568,19 +2876,45 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         state->mTeeSink = mTeeSink.get();
 #endif
         mFastMixerNBLogWriter = audioFlinger->newWriter_l(kFastMixerLogSize, "FastMixer");
+        // the fast mixer must not format on its own thread
+        mFastMixerNBLogWriter->setBinary(true);
         state->mNBLogWriter = mFastMixerNBLogWriter.get();
+        if (audioFlinger->mDeadlineWatchdog != 0) {
+            // the tid is filled in once the fast mixer is running
+            mFastMixerWatchdogClient = audioFlinger->mDeadlineWatchdog->addClient("FastMixer",
+                    0 /*tid*/, kWatchdogDeadlinePeriods * seconds(mFrameCount) / mSampleRate);
+            state->mWatchdogClient = mFastMixerWatchdogClient;
+        }
         sq->end();
         sq->push(FastMixerStateQueue::BLOCK_UNTIL_PUSHED);
 
         // start the fast mixer
         mFastMixer->run("FastMixer", PRIORITY_URGENT_AUDIO);
         pid_t tid = mFastMixer->getTid();
+        if (mFastMixerWatchdogClient != NULL) {
+            mFastMixerWatchdogClient->mTid = tid;
+        }
         int err = requestPriority(getpid_cached, tid, kPriorityFastMixer);
         if (err != 0) {
             ALOGW("Policy SCHED_FIFO priority %d is unavailable for pid %d tid %d; error %d",
                     kPriorityFastMixer, getpid_cached, tid, err);
         }
 
+        // optionally pin the fast mixer to a core, so it is not migrated away from a warm cache
+        // or onto a core that is being brought down by hotplug
+        char value[PROPERTY_VALUE_MAX];
+        if (property_get("af.fast_mixer.cpu", value, NULL) > 0) {
+            int cpu = atoi(value);
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                cpu_set_t cpuSet;
+                CPU_ZERO(&cpuSet);
+                CPU_SET(cpu, &cpuSet);
+                if (sched_setaffinity(tid, sizeof(cpuSet), &cpuSet) != 0) {
+                    ALOGW("Unable to pin fast mixer tid %d to cpu %d; errno %d", tid, cpu, errno);
+                }
+            }
+        }
+
 #ifdef AUDIO_WATCHDOG
         // create and start the watchdog
         mAudioWatchdog = new AudioWatchdog();
@@ -2637,6 +2971,10 @@ AudioFlinger::MixerThread::~MixerThread()
         delete fastTrack->mBufferProvider;
         sq->end(false /*didModify*/);
         delete mFastMixer;
+        if (mFastMixerWatchdogClient != NULL) {
+            mAudioFlinger->mDeadlineWatchdog->removeClient(mFastMixerWatchdogClient);
+            mFastMixerWatchdogClient = NULL;
+        }
 #ifdef AUDIO_WATCHDOG
         if (mAudioWatchdog != 0) {
             mAudioWatchdog->requestExit();
@@ -2698,6 +3036,8 @@ ssize_t AudioFlinger::MixerThread::threadLoop_write()
             }
         } else {
             sq->end(false /*didModify*/);
+            // retry a push that prepareTracks_l() deferred, if any
+            sq->push(FastMixerStateQueue::BLOCK_NEVER);
         }
     }
     return PlaybackThread::threadLoop_write();
@@ -2862,7 +3202,10 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
     FastMixerStateQueue *sq = NULL;
     FastMixerState *state = NULL;
     bool didModify = false;
-    FastMixerStateQueue::block_t block = FastMixerStateQueue::BLOCK_UNTIL_PUSHED;
+    // All of this cycle's fast track mutations are batched into a single push.  Unless one of them
+    // needs an acknowledgement, don't wait for the fast mixer: if it hasn't yet acknowledged the
+    // prior push, the state stays dirty and is squashed into the next cycle's mutations.
+    FastMixerStateQueue::block_t block = FastMixerStateQueue::BLOCK_NEVER;
     if (mFastMixer != NULL) {
         sq = mFastMixer->sq();
         state = sq->begin();
@@ -3034,6 +3377,13 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
         // The first time a track is added we wait
         // for all its buffers to be filled before processing it
         int name = track->name();
+#ifdef MIXER_TRACK_STATISTICS
+        // account for the time this track took in the previous mix cycle, if it was mixed
+        uint32_t mixNs = mAudioMixer->getProcessTimeNs(name);
+        if (mixNs != 0) {
+            track->mMixTimeHistogram.add(mixNs);
+        }
+#endif
         // make sure that we have enough frames to mix one full buffer.
         // enforce this condition only once to enable draining the buffer in case the client
         // app does not call stop() and relies on underrun to stop:
@@ -3356,6 +3706,71 @@ void AudioFlinger::MixerThread::deleteTrackName_l(int name)
     mAudioMixer->deleteTrackName(name);
 }
 
+#ifdef ADAPTIVE_NORMAL_MIX_PERIOD
+// adaptNormalMixPeriod_l() must be called with ThreadBase::mLock held, between mix cycles
+bool AudioFlinger::MixerThread::adaptNormalMixPeriod_l()
+{
+    // Only when there is a fast mixer: the normal mixer then writes to the MonoPipe rather than
+    // to the HAL, so the HAL write size is not affected.
+    // Also wait for a partial write to complete, as the mix buffer is reallocated.
+    if (mFastMixer == NULL || mType != MIXER || mBytesRemaining != 0) {
+        return false;
+    }
+
+    // A longer period is only worthwhile for long-running playback, and only safe if every track
+    // has at least the 2 normal mix buffers that createTrack_l() would give it at that period.
+    // Fast tracks want the short period, as they are only added to the fast mixer once per cycle.
+    size_t longFrameCount = mLongNormalMixPeriod ? mNormalFrameCount : mNormalFrameCount * 2;
+    bool wantLong = !mActiveTracks.isEmpty();
+    for (size_t i = 0; wantLong && i < mTracks.size(); i++) {
+        const sp<Track>& track = mTracks[i];
+        if (track->isFastTrack() || track->mFrameCount < longFrameCount * 2) {
+            wantLong = false;
+        }
+    }
+
+    nsecs_t now = systemTime();
+    if (!wantLong) {
+        mLongNormalMixPeriodSince = 0;
+        if (!mLongNormalMixPeriod) {
+            return false;
+        }
+    } else if (!mLongNormalMixPeriod) {
+        if (mLongNormalMixPeriodSince == 0) {
+            mLongNormalMixPeriodSince = now;
+        }
+        if (now - mLongNormalMixPeriodSince < kLongNormalMixPeriodDelayNs) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    mLongNormalMixPeriod = wantLong;
+    ALOGV("normal mix period %s", wantLong ? "doubled" : "restored");
+    readOutputParameters();
+    delete mAudioMixer;
+    mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+#ifdef MIXER_TRACK_STATISTICS
+    mAudioMixer->setTrackTiming(true);
+#endif
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        int name = getTrackName_l(mTracks[i]->mChannelMask, mTracks[i]->mSessionId);
+        if (name < 0) {
+            break;
+        }
+        mTracks[i]->mName = name;
+    }
+    MonoPipe *pipe = (MonoPipe *)mPipeSink.get();
+    if (pipe != NULL) {
+        pipe->setAvgFrames((mScreenState & 1) ?
+                (pipe->maxFrames() * 7) / 8 : mNormalFrameCount * 2);
+    }
+    sendIoConfigEvent_l(AudioSystem::OUTPUT_CONFIG_CHANGED);
+    return true;
+}
+#endif
+
 // checkForNewParameters_l() must be called with ThreadBase::mLock held
 bool AudioFlinger::MixerThread::checkForNewParameters_l()
 {
@@ -3363,6 +3778,10 @@ bool AudioFlinger::MixerThread::checkForNewParameters_l()
     FastMixerState::Command previousCommand = FastMixerState::HOT_IDLE;
     bool reconfig = false;
 
+#ifdef ADAPTIVE_NORMAL_MIX_PERIOD
+    reconfig = adaptNormalMixPeriod_l();
+#endif
+
     while (!mNewParameters.isEmpty()) {
 
         if (mFastMixer != NULL) {
@@ -3461,6 +3880,9 @@ bool AudioFlinger::MixerThread::checkForNewParameters_l()
                 readOutputParameters();
                 delete mAudioMixer;
                 mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+#ifdef MIXER_TRACK_STATISTICS
+                mAudioMixer->setTrackTiming(true);
+#endif
                 for (size_t i = 0; i < mTracks.size() ; i++) {
                     int name = getTrackName_l(mTracks[i]->mChannelMask, mTracks[i]->mSessionId);
                     if (name < 0) {
@@ -3560,6 +3982,7 @@ AudioFlinger::DirectOutputThread::DirectOutputThread(const sp<AudioFlinger>& aud
         AudioStreamOut* output, audio_io_handle_t id, audio_devices_t device)
     :   PlaybackThread(audioFlinger, output, id, device, DIRECT)
         // mLeftVolFloat, mRightVolFloat
+        , mWriteInPlace(false)
 {
 }
 
@@ -3568,6 +3991,7 @@ AudioFlinger::DirectOutputThread::DirectOutputThread(const sp<AudioFlinger>& aud
         ThreadBase::type_t type)
     :   PlaybackThread(audioFlinger, output, id, device, type)
         // mLeftVolFloat, mRightVolFloat
+        , mWriteInPlace(false)
 {
 }
 
@@ -3627,6 +4051,9 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::DirectOutputThread::prep
     size_t count = mActiveTracks.size();
     mixer_state mixerStatus = MIXER_IDLE;
 
+    // effects process the mix buffer in place, and a suspended thread does not write
+    mWriteInPlace = (mType == DIRECT) && mEffectChains.isEmpty() && !isSuspended();
+
     // find out which tracks need to be processed
     for (size_t i = 0; i < count; i++) {
         sp<Track> t = mActiveTracks[i].promote();
@@ -3720,6 +4147,34 @@ void AudioFlinger::DirectOutputThread::threadLoop_mix()
 {
     size_t frameCount = mFrameCount;
     int8_t *curBuf = (int8_t *)mMixBuffer;
+    if (mPendingTrack != 0) {
+        // the thread was suspended after the buffer was obtained, and nothing was written
+        mWriteBuffer = mMixBuffer;
+        mPendingTrack->releaseBuffer(&mPendingBuffer);
+        mPendingTrack.clear();
+    }
+    if (mWriteInPlace) {
+        // When the track's buffer holds the whole period contiguously, write it in place and
+        // release it after the write, rather than copying it into the mix buffer
+        mPendingBuffer.frameCount = frameCount;
+        mActiveTrack->getNextBuffer(&mPendingBuffer);
+        if (mPendingBuffer.raw != NULL && mPendingBuffer.frameCount == frameCount) {
+            mWriteBuffer = mPendingBuffer.i16;
+            mPendingTrack = mActiveTrack;
+            mCurrentWriteLength = frameCount * mFrameSize;
+            sleepTime = 0;
+            standbyTime = systemTime() + standbyDelay;
+            mActiveTrack.clear();
+            return;
+        }
+        // otherwise copy what was obtained, and continue as usual
+        if (mPendingBuffer.raw != NULL) {
+            memcpy(curBuf, mPendingBuffer.raw, mPendingBuffer.frameCount * mFrameSize);
+            frameCount -= mPendingBuffer.frameCount;
+            curBuf += mPendingBuffer.frameCount * mFrameSize;
+            mActiveTrack->releaseBuffer(&mPendingBuffer);
+        }
+    }
     // output audio to hardware
     while (frameCount) {
         AudioBufferProvider::Buffer buffer;
@@ -3740,6 +4195,24 @@ void AudioFlinger::DirectOutputThread::threadLoop_mix()
     mActiveTrack.clear();
 }
 
+ssize_t AudioFlinger::DirectOutputThread::threadLoop_write()
+{
+    ssize_t bytesWritten = PlaybackThread::threadLoop_write();
+    if (mPendingTrack != 0) {
+        // the client may overwrite its buffer once released, so keep any remainder of a short
+        // write in the mix buffer, where the next write will find it
+        if (bytesWritten >= 0 && (size_t) bytesWritten < mBytesRemaining) {
+            size_t offset = mCurrentWriteLength - mBytesRemaining + bytesWritten;
+            memcpy((int8_t *) mMixBuffer + offset, (int8_t *) mWriteBuffer + offset,
+                    mBytesRemaining - bytesWritten);
+        }
+        mWriteBuffer = mMixBuffer;
+        mPendingTrack->releaseBuffer(&mPendingBuffer);
+        mPendingTrack.clear();
+    }
+    return bytesWritten;
+}
+
 void AudioFlinger::DirectOutputThread::threadLoop_sleepTime()
 {
     if (sleepTime == 0) {
@@ -3965,6 +4438,9 @@ AudioFlinger::OffloadThread::OffloadThread(const sp<AudioFlinger>& audioFlinger,
         mFlushPending(false),
         mPausedBytesRemaining(0),
         mPreviousTrack(NULL)
+#ifdef OFFLOAD_PARTIAL_WAKEUP
+        , mDspFullNs(0)
+#endif
 {
 }
 
@@ -4002,8 +4478,21 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::OffloadThread::prepareTr
         }
         Track* const track = t.get();
         audio_track_cblk_t* cblk = track->cblk();
-        if (mPreviousTrack != NULL) {
-            if (t.get() != mPreviousTrack) {
+        bool last = (i == (count - 1));
+        // Only the last track is written, so a switch happens when it changes.  Other tracks are
+        // either stopping or paused, and must not be mistaken for a switch back.
+        if (last && mPreviousTrack != NULL && t.get() != mPreviousTrack) {
+            // On a gapless transition the previous track is stopping and still active: its data
+            // still in the mix buffer must be written before the next track's
+            bool previousStopping = false;
+            for (size_t j = 0; j < count; j++) {
+                sp<Track> previous = mActiveTracks[j].promote();
+                if (previous.get() == mPreviousTrack) {
+                    previousStopping = previous->isStopping();
+                    break;
+                }
+            }
+            if (!previousStopping) {
                 // Flush any data still being written from last track
                 mBytesRemaining = 0;
                 if (mPausedBytesRemaining) {
@@ -4018,8 +4507,9 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::OffloadThread::prepareTr
                 }
             }
         }
-        mPreviousTrack = t.get();
-        bool last = (i == (count - 1));
+        if (last) {
+            mPreviousTrack = t.get();
+        }
         if (track->isPausing()) {
             track->setPaused();
             if (last) {
@@ -4154,6 +4644,39 @@ void AudioFlinger::OffloadThread::flushOutput_l()
     mFlushPending = true;
 }
 
+#ifdef OFFLOAD_PARTIAL_WAKEUP
+ssize_t AudioFlinger::OffloadThread::threadLoop_write()
+{
+    ssize_t bytesWritten = DirectOutputThread::threadLoop_write();
+    // a short write, or an asynchronous write still waiting for its callback,
+    // means that the DSP buffer is full
+    if ((bytesWritten >= 0 && (size_t) bytesWritten < mBytesRemaining) ||
+            (mUseAsyncWrite && (mWriteAckSequence & 1))) {
+        mDspFullNs = systemTime();
+    }
+    return bytesWritten;
+}
+
+void AudioFlinger::OffloadThread::threadLoop_sleepTime()
+{
+    bool wasWriting = (sleepTime == 0);
+    DirectOutputThread::threadLoop_sleepTime();
+    if (!wasWriting || mMixerStatus != MIXER_TRACKS_ENABLED || mDspFullNs == 0 ||
+            mHwPaused || mStandby) {
+        return;
+    }
+    // The active track has no data yet, but the DSP was full not long ago: rather than polling,
+    // sleep for half of what the DSP is estimated to have left to play, so that the client has
+    // written more by then.  The stream latency is the duration of the full DSP buffer.
+    nsecs_t remainingNs = mDspFullNs +
+            milliseconds(mOutput->stream->get_latency(mOutput->stream)) - systemTime();
+    if (remainingNs > 2 * microseconds(sleepTime)) {
+        uint32_t sleepUs = (uint32_t) (remainingNs / 2000);
+        sleepTime = sleepUs < kMaxOffloadSleepTimeUs ? sleepUs : kMaxOffloadSleepTimeUs;
+    }
+}
+#endif
+
 // must be called with thread mutex locked
 bool AudioFlinger::OffloadThread::waitingAsyncCallback_l()
 {
@@ -4189,6 +4712,9 @@ bool AudioFlinger::OffloadThread::waitingAsyncCallback()
 void AudioFlinger::OffloadThread::flushHw_l()
 {
     mOutput->stream->flush(mOutput->stream);
+#ifdef OFFLOAD_PARTIAL_WAKEUP
+    mDspFullNs = 0;
+#endif
     // Flush anything still waiting in the mixbuffer
     mCurrentWriteLength = 0;
     mBytesRemaining = 0;
@@ -4206,6 +4732,148 @@ void AudioFlinger::OffloadThread::flushHw_l()
 
 // ----------------------------------------------------------------------------
 
+class AudioFlinger::DuplicatingThread::OutputWriter : public Thread {
+public:
+    OutputWriter(DuplicatingThread& thread, const sp<OutputTrack>& outputTrack,
+            size_t frameCount);
+    virtual ~OutputWriter();
+
+    // The following are called by the duplicating thread with mWriteLock held
+
+    // Queue frames for writing, or if frames == 0 tell the track that no more data is coming
+    void queue_l(const int16_t *data, size_t frames);
+    void stop_l();
+    // true until the writer has written everything queued
+    bool isBusy_l() const { return mBusy; }
+
+    // Stop the writer thread and wait for it to exit, called without mWriteLock held
+    void exit();
+
+    const sp<OutputTrack>& outputTrack() const { return mOutputTrack; }
+
+private:
+    virtual bool threadLoop();
+
+    DuplicatingThread&      mThread;
+    const sp<OutputTrack>   mOutputTrack;
+    const size_t            mFrameCount;    // maximum frames per OutputTrack::write()
+    int16_t*                mBuffer;        // [mFrameCount * channels]
+    sp<MonoPipe>            mPipe;          // from the duplicating thread
+    sp<MonoPipeReader>      mPipeReader;    // to mOutputTrack
+    Condition               mWorkCond;      // waited on by the writer, with mWriteLock
+
+    // protected by mThread.mWriteLock
+    bool                    mBusy;
+    bool                    mFlush;         // write(x, 0) after the queued frames
+    bool                    mStop;
+    bool                    mExiting;
+    size_t                  mFramesDropped; // for the log, when the output is too slow
+};
+
+AudioFlinger::DuplicatingThread::OutputWriter::OutputWriter(DuplicatingThread& thread,
+        const sp<OutputTrack>& outputTrack, size_t frameCount)
+    :   Thread(false /*canCallJava*/),
+        mThread(thread), mOutputTrack(outputTrack), mFrameCount(frameCount),
+        mBuffer(new int16_t[frameCount * thread.mChannelCount]),
+        mBusy(false), mFlush(false), mStop(false), mExiting(false), mFramesDropped(0)
+{
+    // The pipe bounds how far the output may lag behind the fastest one: beyond that,
+    // frames are dropped instead of accumulating latency
+    NBAIO_Format format = Format_from_SR_C(thread.mSampleRate, thread.mChannelCount);
+    mPipe = new MonoPipe(frameCount * 4, format, false /*writeCanBlock*/);
+    const NBAIO_Format offers[1] = {format};
+    size_t numCounterOffers = 0;
+    ssize_t index = mPipe->negotiate(offers, 1, NULL, numCounterOffers);
+    ALOG_ASSERT(index == 0);
+    mPipeReader = new MonoPipeReader(mPipe.get());
+    numCounterOffers = 0;
+    index = mPipeReader->negotiate(offers, 1, NULL, numCounterOffers);
+    ALOG_ASSERT(index == 0);
+}
+
+AudioFlinger::DuplicatingThread::OutputWriter::~OutputWriter()
+{
+    delete[] mBuffer;
+}
+
+void AudioFlinger::DuplicatingThread::OutputWriter::queue_l(const int16_t *data, size_t frames)
+{
+    if (frames == 0) {
+        mFlush = true;
+    } else {
+        ssize_t written = mPipe->write(data, frames);
+        if (written < (ssize_t) frames) {
+            mFramesDropped += frames - (written > 0 ? written : 0);
+            ALOGV("OutputWriter %p output too slow, %u frames dropped", this, mFramesDropped);
+        }
+    }
+    mBusy = true;
+    mWorkCond.signal();
+}
+
+void AudioFlinger::DuplicatingThread::OutputWriter::stop_l()
+{
+    mStop = true;
+    mWorkCond.signal();
+}
+
+void AudioFlinger::DuplicatingThread::OutputWriter::exit()
+{
+    {
+        Mutex::Autolock _l(mThread.mWriteLock);
+        mExiting = true;
+        // so that the duplicating thread does not wait for us any more
+        mBusy = false;
+        mWorkCond.signal();
+    }
+    requestExitAndWait();
+}
+
+bool AudioFlinger::DuplicatingThread::OutputWriter::threadLoop()
+{
+    bool flush;
+    bool stop;
+    {
+        Mutex::Autolock _l(mThread.mWriteLock);
+        while (!mExiting && !mBusy && !mStop) {
+            mWorkCond.wait(mThread.mWriteLock);
+        }
+        if (mExiting) {
+            return false;
+        }
+        flush = mFlush;
+        stop = mStop;
+        mFlush = false;
+        mStop = false;
+    }
+
+    // OutputTrack::write() blocks for at most the duplicating thread's wait time,
+    // and only this thread calls it
+    ssize_t avail;
+    while ((avail = mPipeReader->availableToRead()) > 0) {
+        ssize_t frames = mPipeReader->read(mBuffer,
+                (size_t) avail < mFrameCount ? avail : mFrameCount,
+                AudioBufferProvider::kInvalidPTS);
+        if (frames <= 0) {
+            break;
+        }
+        mOutputTrack->write(mBuffer, frames);
+    }
+    if (flush) {
+        mOutputTrack->write(mBuffer, 0);
+    }
+    if (stop) {
+        mOutputTrack->stop();
+    }
+
+    Mutex::Autolock _l(mThread.mWriteLock);
+    if (!mFlush && mPipeReader->availableToRead() <= 0) {
+        mBusy = false;
+    }
+    mThread.mWriteCond.signal();
+    return true;
+}
+
 AudioFlinger::DuplicatingThread::DuplicatingThread(const sp<AudioFlinger>& audioFlinger,
         AudioFlinger::MixerThread* mainThread, audio_io_handle_t id)
     :   MixerThread(audioFlinger, mainThread->getOutput(), id, mainThread->outDevice(),
@@ -4217,6 +4885,9 @@ AudioFlinger::DuplicatingThread::DuplicatingThread(const sp<AudioFlinger>& audio
 
 AudioFlinger::DuplicatingThread::~DuplicatingThread()
 {
+    for (size_t i = 0; i < mOutputWriters.size(); i++) {
+        mOutputWriters[i]->exit();
+    }
     for (size_t i = 0; i < mOutputTracks.size(); i++) {
         mOutputTracks[i]->destroy();
     }
@@ -4258,28 +4929,50 @@ void AudioFlinger::DuplicatingThread::threadLoop_sleepTime()
 
 ssize_t AudioFlinger::DuplicatingThread::threadLoop_write()
 {
-    for (size_t i = 0; i < outputTracks.size(); i++) {
-        outputTracks[i]->write(mMixBuffer, writeFrames);
+    Mutex::Autolock _l(mWriteLock);
+    for (size_t i = 0; i < outputWriters.size(); i++) {
+        outputWriters[i]->queue_l(mMixBuffer, writeFrames);
+    }
+    // The writes used to be done here one output after the other, which paced this thread on
+    // the sum of the outputs' delays.  Now pace on the fastest output: wait until one of the
+    // writers is done, for no longer than an output would have been waited for.
+    nsecs_t deadline = systemTime() + milliseconds(mWaitTimeMs);
+    while (!outputWriters.isEmpty()) {
+        bool written = false;
+        for (size_t i = 0; i < outputWriters.size(); i++) {
+            if (!outputWriters[i]->isBusy_l()) {
+                written = true;
+                break;
+            }
+        }
+        nsecs_t timeout = deadline - systemTime();
+        if (written || timeout <= 0) {
+            break;
+        }
+        mWriteCond.waitRelative(mWriteLock, timeout);
     }
     return (ssize_t)mixBufferSize;
 }
 
 void AudioFlinger::DuplicatingThread::threadLoop_standby()
 {
-    // DuplicatingThread implements standby by stopping all tracks
-    for (size_t i = 0; i < outputTracks.size(); i++) {
-        outputTracks[i]->stop();
+    // DuplicatingThread implements standby by stopping all tracks, from their writer thread
+    Mutex::Autolock _l(mWriteLock);
+    for (size_t i = 0; i < outputWriters.size(); i++) {
+        outputWriters[i]->stop_l();
     }
 }
 
 void AudioFlinger::DuplicatingThread::saveOutputTracks()
 {
     outputTracks = mOutputTracks;
+    outputWriters = mOutputWriters;
 }
 
 void AudioFlinger::DuplicatingThread::clearOutputTracks()
 {
     outputTracks.clear();
+    outputWriters.clear();
 }
 
 void AudioFlinger::DuplicatingThread::addOutputTrack(MixerThread *thread)
@@ -4299,6 +4992,11 @@ void AudioFlinger::DuplicatingThread::addOutputTrack(MixerThread *thread)
     if (outputTrack->cblk() != NULL) {
         thread->setStreamVolume(AUDIO_STREAM_CNT, 1.0f);
         mOutputTracks.add(outputTrack);
+        sp<OutputWriter> writer = new OutputWriter(*this, outputTrack, mNormalFrameCount);
+        char name[kNameLength + 8];
+        snprintf(name, sizeof(name), "%s_w%u", mName, mOutputWriters.size());
+        writer->run(name, PRIORITY_URGENT_AUDIO);
+        mOutputWriters.add(writer);
         ALOGV("addOutputTrack() track %p, on thread %p", outputTrack, thread);
         updateWaitTime_l();
     }
@@ -4309,6 +5007,14 @@ void AudioFlinger::DuplicatingThread::removeOutputTrack(MixerThread *thread)
     Mutex::Autolock _l(mLock);
     for (size_t i = 0; i < mOutputTracks.size(); i++) {
         if (mOutputTracks[i]->thread() == thread) {
+            // the writer must be gone before the track is destroyed
+            for (size_t j = 0; j < mOutputWriters.size(); j++) {
+                if (mOutputWriters[j]->outputTrack() == mOutputTracks[i]) {
+                    mOutputWriters[j]->exit();
+                    mOutputWriters.removeAt(j);
+                    break;
+                }
+            }
             mOutputTracks[i]->destroy();
             mOutputTracks.removeAt(i);
             updateWaitTime_l();
@@ -4372,6 +5078,124 @@ void AudioFlinger::DuplicatingThread::cacheParameters_l()
 //      Record
 // ----------------------------------------------------------------------------
 
+// Reads the frames captured by the RecordThread from its share pipe, and converts them to the
+// sample rate and channel count of one secondary track.  Only used by the RecordThread's thread.
+class AudioFlinger::RecordThread::SharedCapture {
+public:
+    SharedCapture(Pipe& pipe, uint32_t inSampleRate, uint32_t inChannelCount,
+            uint32_t outSampleRate, uint32_t outChannelCount, size_t maxFrames);
+    ~SharedCapture();
+
+    // Convert everything available into the track's buffer,
+    // and return false if the track's buffer was found full
+    bool process(RecordTrack* track);
+
+private:
+    const sp<PipeReader>        mReader;
+    SourceAudioBufferProvider*  mProvider;      // only when resampling
+    AudioResampler*             mResampler;     // only when resampling
+    int32_t*                    mRsmpOutBuffer; // [mMaxFrames * FCC_2] Q19.12 when resampling
+    int16_t*                    mInBuffer;      // [mMaxFrames * FCC_2] for channel conversion
+    const uint32_t              mInSampleRate;
+    const uint32_t              mInChannelCount;
+    const uint32_t              mOutSampleRate;
+    const uint32_t              mOutChannelCount;
+    const size_t                mMaxFrames;     // per conversion
+};
+
+AudioFlinger::RecordThread::SharedCapture::SharedCapture(Pipe& pipe,
+        uint32_t inSampleRate, uint32_t inChannelCount,
+        uint32_t outSampleRate, uint32_t outChannelCount, size_t maxFrames) :
+    mReader(new PipeReader(pipe)), mProvider(NULL), mResampler(NULL), mRsmpOutBuffer(NULL),
+    mInBuffer(NULL), mInSampleRate(inSampleRate), mInChannelCount(inChannelCount),
+    mOutSampleRate(outSampleRate), mOutChannelCount(outChannelCount), mMaxFrames(maxFrames)
+{
+    if (mInSampleRate != mOutSampleRate) {
+        // the provider negotiates with the reader
+        mProvider = new SourceAudioBufferProvider(mReader);
+        mResampler = AudioResampler::create(16, mInChannelCount, mOutSampleRate);
+        mResampler->setSampleRate(mInSampleRate);
+        mResampler->setVolume(AudioMixer::UNITY_GAIN, AudioMixer::UNITY_GAIN);
+        mRsmpOutBuffer = new int32_t[mMaxFrames * FCC_2];
+    } else {
+        const NBAIO_Format offers[1] = {pipe.format()};
+        size_t numCounterOffers = 0;
+        ssize_t index = mReader->negotiate(offers, 1, NULL, numCounterOffers);
+        ALOG_ASSERT(index == 0);
+        if (mInChannelCount != mOutChannelCount) {
+            mInBuffer = new int16_t[mMaxFrames * FCC_2];
+        }
+    }
+}
+
+AudioFlinger::RecordThread::SharedCapture::~SharedCapture()
+{
+    delete mResampler;
+    delete mProvider;
+    delete[] mRsmpOutBuffer;
+    delete[] mInBuffer;
+}
+
+bool AudioFlinger::RecordThread::SharedCapture::process(RecordTrack* track)
+{
+    for (;;) {
+        ssize_t framesIn = mReader->availableToRead();
+        if (framesIn <= 0) {
+            // an overrun was reported if < 0, and the reader has skipped ahead
+            return true;
+        }
+        size_t framesOut;
+        if (mResampler != NULL) {
+            // leave the resampler a couple of input frames of history, so that it never runs
+            // out of input in the middle of a buffer, which would insert a gap of silence
+            framesOut = framesIn > 2 ?
+                    ((uint64_t) (framesIn - 2) * mOutSampleRate) / mInSampleRate : 0;
+        } else {
+            framesOut = framesIn;
+        }
+        if (framesOut == 0) {
+            return true;
+        }
+        if (framesOut > mMaxFrames) {
+            framesOut = mMaxFrames;
+        }
+
+        AudioBufferProvider::Buffer buffer;
+        buffer.frameCount = framesOut;
+        if (track->getNextBuffer(&buffer) != NO_ERROR) {
+            return false;
+        }
+        framesOut = buffer.frameCount;
+
+        if (mResampler != NULL) {
+            // the resampler accumulates, and always outputs stereo
+            memset(mRsmpOutBuffer, 0, framesOut * FCC_2 * sizeof(int32_t));
+            mResampler->resample(mRsmpOutBuffer, framesOut, mProvider);
+            if (mOutChannelCount == 1) {
+                // temporarily type pun mRsmpOutBuffer from Q19.12 to int16_t
+                ditherAndClamp(mRsmpOutBuffer, mRsmpOutBuffer, framesOut);
+                downmix_to_mono_i16_from_stereo_i16(buffer.i16, (int16_t *)mRsmpOutBuffer,
+                        framesOut);
+            } else {
+                ditherAndClamp((int32_t *)buffer.raw, mRsmpOutBuffer, framesOut);
+            }
+        } else if (mInChannelCount == mOutChannelCount) {
+            framesIn = mReader->read(buffer.raw, framesOut, AudioBufferProvider::kInvalidPTS);
+            buffer.frameCount = framesIn > 0 ? framesIn : 0;
+        } else {
+            framesIn = mReader->read(mInBuffer, framesOut, AudioBufferProvider::kInvalidPTS);
+            buffer.frameCount = framesIn > 0 ? framesIn : 0;
+            if (mInChannelCount == 1) {
+                upmix_to_stereo_i16_from_mono_i16(buffer.i16, mInBuffer, buffer.frameCount);
+            } else {
+                downmix_to_mono_i16_from_stereo_i16(buffer.i16, mInBuffer, buffer.frameCount);
+            }
+        }
+        track->releaseBuffer(&buffer);
+    }
+}
+
+
 AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
                                          AudioStreamIn *input,
                                          uint32_t sampleRate,
@@ -4393,16 +5217,19 @@ AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
 #ifdef TEE_SINK
     , mTeeSink(teeSink)
 #endif
+    , mShareInput(false)
 {
     snprintf(mName, kNameLength, "AudioIn_%X", id);
 
     readInputParameters();
+    setupFastCapture_l();
     mClientUid = IPCThreadState::self()->getCallingUid();
 }
 
 
 AudioFlinger::RecordThread::~RecordThread()
 {
+    teardownFastCapture_l();
     delete[] mRsmpInBuffer;
     delete mResampler;
     delete[] mRsmpOutBuffer;
@@ -4425,24 +5252,55 @@ bool AudioFlinger::RecordThread::threadLoop()
     AudioBufferProvider::Buffer buffer;
     sp<RecordTrack> activeTrack;
     Vector< sp<EffectChain> > effectChains;
+    SortedVector< sp<RecordTrack> > sharedTracks;
 
     nsecs_t lastWarning = 0;
 
     inputStandBy();
     acquireWakeLock(mClientUid);
+    addWatchdogClient(kWatchdogDeadlinePeriods * seconds(mFrameCount) / mSampleRate);
 
     // used to verify we've read at least once before evaluating how many bytes were read
     bool readOnce = false;
 
+    ThreadCpuStats threadCpuStats(mName);
+
     // start recording
     while (!exitPending()) {
+        threadCpuStats.sample();
+
+        if (mWatchdogClient != NULL) {
+            mWatchdogClient->kick(systemTime(), !mStandby);
+        }
 
         processConfigEvents();
 
         { // scope for mLock
             Mutex::Autolock _l(mLock);
             checkForNewParameters_l();
-            if (mActiveTrack == 0 && mConfigEvents.isEmpty()) {
+
+            // secondary tracks are stopped and removed here, as their converter is in use
+            // outside of mLock
+            bool sharedTrackRemoved = false;
+            for (size_t i = mSharedTracks.size(); i > 0; ) {
+                sp<RecordTrack> track = mSharedTracks[--i];
+                if (track->isTerminated() || track->mState == TrackBase::PAUSING) {
+                    delete track->mSharedCapture;
+                    track->mSharedCapture = NULL;
+                    mSharedTracks.removeAt(i);
+                    if (track->isTerminated()) {
+                        removeTrack_l(track);
+                    }
+                    sharedTrackRemoved = true;
+                }
+            }
+            if (sharedTrackRemoved) {
+                mStartStopCond.broadcast();
+            }
+            sharedTracks = mSharedTracks;
+            mShareInput = !sharedTracks.isEmpty();
+
+            if (mActiveTrack == 0 && mSharedTracks.isEmpty() && mConfigEvents.isEmpty()) {
                 standby();
 
                 if (exitPending()) {
@@ -4450,6 +5308,9 @@ bool AudioFlinger::RecordThread::threadLoop()
                 }
 
                 releaseWakeLock_l();
+                if (mWatchdogClient != NULL) {
+                    mWatchdogClient->idle();
+                }
                 ALOGV("RecordThread: loop stopping");
                 // go to sleep
                 mWaitWorkCV.wait(mLock);
@@ -4462,7 +5323,10 @@ bool AudioFlinger::RecordThread::threadLoop()
                     removeTrack_l(mActiveTrack);
                     mActiveTrack.clear();
                 } else if (mActiveTrack->mState == TrackBase::PAUSING) {
-                    standby();
+                    // keep capturing if other tracks are still sharing the input
+                    if (mSharedTracks.isEmpty()) {
+                        standby();
+                    }
                     mActiveTrack.clear();
                     mStartStopCond.broadcast();
                 } else if (mActiveTrack->mState == TrackBase::RESUMING) {
@@ -4481,6 +5345,8 @@ bool AudioFlinger::RecordThread::threadLoop()
                     }
                     mStandby = false;
                 }
+            } else if (!mSharedTracks.isEmpty()) {
+                mStandby = false;
             }
 
             lockEffectChains_l(effectChains);
@@ -4490,7 +5356,7 @@ bool AudioFlinger::RecordThread::threadLoop()
             if (mActiveTrack->mState != TrackBase::ACTIVE &&
                 mActiveTrack->mState != TrackBase::RESUMING) {
                 unlockEffectChains(effectChains);
-                usleep(kRecordThreadSleepUs);
+                usleep(coalescedIdleSleepTimeUs(kRecordThreadSleepUs));
                 continue;
             }
             for (size_t i = 0; i < effectChains.size(); i ++) {
@@ -4547,8 +5413,7 @@ bool AudioFlinger::RecordThread::threadLoop()
                                      mRsmpInIndex = 0;
                                      InputBytes = mBufferSize;
                              }
-                            mBytesRead = mInput->stream->read(mInput->stream, readInto,
-                                    InputBytes);
+                            mBytesRead = readInput(readInto, InputBytes);
                             if (mBytesRead <= 0) {
                                 if ((mBytesRead < 0) && (mActiveTrack->mState == TrackBase::ACTIVE))
                                 {
@@ -4633,9 +5498,35 @@ bool AudioFlinger::RecordThread::threadLoop()
                 usleep(kRecordThreadSleepUs);
             }
         }
+
+        if (!sharedTracks.isEmpty()) {
+            if (mActiveTrack == 0) {
+                // nobody else is reading the input, so read it on behalf of the secondary tracks
+                mBytesRead = readInput(mRsmpInBuffer, mBufferSize);
+                if (mBytesRead < 0) {
+                    ALOGE("Error reading audio input");
+                    inputStandBy();
+                    usleep(kRecordThreadSleepUs);
+                }
+            }
+            for (size_t i = 0; i < sharedTracks.size(); i++) {
+                RecordTrack *track = sharedTracks[i].get();
+                if (track->mSharedCapture->process(track)) {
+                    track->clearOverflow();
+                } else if (!track->setOverflow()) {
+                    nsecs_t now = systemTime();
+                    if ((now - lastWarning) > kWarningThrottleNs) {
+                        ALOGW("RecordThread: buffer overflow on shared track");
+                        lastWarning = now;
+                    }
+                }
+            }
+        }
+
         // enable changes in effect chain
         unlockEffectChains(effectChains);
         effectChains.clear();
+        sharedTracks.clear();
     }
 
     standby();
@@ -4647,10 +5538,17 @@ bool AudioFlinger::RecordThread::threadLoop()
             track->invalidate();
         }
         mActiveTrack.clear();
+        for (size_t i = 0; i < mSharedTracks.size(); i++) {
+            delete mSharedTracks[i]->mSharedCapture;
+            mSharedTracks[i]->mSharedCapture = NULL;
+        }
+        mSharedTracks.clear();
+        mShareInput = false;
         mStartStopCond.broadcast();
     }
 
     releaseWakeLock();
+    removeWatchdogClient();
 
     ALOGV("RecordThread %p exiting", this);
     return false;
@@ -4666,7 +5564,115 @@ void AudioFlinger::RecordThread::standby()
 
 void AudioFlinger::RecordThread::inputStandBy()
 {
-    mInput->stream->common.standby(&mInput->stream->common);
+    if (mFastCapture != 0) {
+        // also stops the fast capture thread from reading, so it doesn't bring the HAL back up
+        mFastCapture->standby();
+    } else {
+        mInput->stream->common.standby(&mInput->stream->common);
+    }
+}
+
+void AudioFlinger::RecordThread::setupFastCapture_l()
+{
+    if (mFormat != AUDIO_FORMAT_PCM_16_BIT || mChannelCount > FCC_2) {
+        return;
+    }
+    char value[PROPERTY_VALUE_MAX];
+    property_get("ro.audio.fast_capture", value, "0");
+    if (strcmp(value, "1") && strcasecmp(value, "true")) {
+        return;
+    }
+    NBAIO_Format format = Format_from_SR_C(mSampleRate, mChannelCount);
+    if (format == Format_Invalid) {
+        ALOGW("Fast capture unavailable at %u Hz, %u channels", mSampleRate, mChannelCount);
+        return;
+    }
+
+    // This pipe depth compensates for scheduling latency of the record thread, which reads
+    // one HAL buffer per cycle.  The pipe implementation rounds up the request to a power of 2.
+    MonoPipe *monoPipe = new MonoPipe(mFrameCount * 4, format, false /*writeCanBlock*/);
+    const NBAIO_Format offers[1] = {format};
+    size_t numCounterOffers = 0;
+    ssize_t index = monoPipe->negotiate(offers, 1, NULL, numCounterOffers);
+    ALOG_ASSERT(index == 0);
+    MonoPipeReader *monoPipeReader = new MonoPipeReader(monoPipe);
+    numCounterOffers = 0;
+    index = monoPipeReader->negotiate(offers, 1, NULL, numCounterOffers);
+    ALOG_ASSERT(index == 0);
+    mPipeSource = monoPipeReader;
+
+    mFastCapture = new FastCapture(mInput->stream, monoPipe, mFrameCount, mFrameSize);
+    mFastCapture->setDump(&mFastCaptureDump);
+    mFastCapture->run("FastCapture", PRIORITY_URGENT_AUDIO);
+    pid_t tid = mFastCapture->getTid();
+    int err = requestPriority(getpid_cached, tid, kPriorityFastCapture);
+    if (err != 0) {
+        ALOGW("Policy SCHED_FIFO priority %d is unavailable for pid %d tid %d; error %d",
+                kPriorityFastCapture, getpid_cached, tid, err);
+    }
+}
+
+void AudioFlinger::RecordThread::teardownFastCapture_l()
+{
+    if (mFastCapture == 0) {
+        return;
+    }
+    mFastCapture->standby();
+    mFastCapture->requestExit();
+    mFastCapture->requestExitAndWait();
+    mFastCapture.clear();
+    mPipeSource.clear();
+}
+
+ssize_t AudioFlinger::RecordThread::readInput(void *buffer, size_t bytes)
+{
+    if (mFastCapture == 0) {
+        ssize_t bytesRead = mInput->stream->read(mInput->stream, buffer, bytes);
+        if (mShareInput && bytesRead > 0) {
+            (void) mSharePipe->write(buffer, bytesRead / mFrameSize);
+        }
+        return bytesRead;
+    }
+
+    if (mFastCapture->start()) {
+        // discard whatever was captured before the last standby
+        ssize_t stale = mPipeSource->availableToRead();
+        while (stale > 0) {
+            ssize_t discarded = mPipeSource->read(mRsmpInBuffer,
+                    (size_t) stale < mFrameCount ? stale : mFrameCount,
+                    AudioBufferProvider::kInvalidPTS);
+            if (discarded <= 0) {
+                break;
+            }
+            stale -= discarded;
+        }
+    }
+
+    // The pipe is non-blocking, so simulate a blocking HAL read.  Give up after about
+    // twice the HAL buffer duration without any data, as the HAL read would have failed.
+    const size_t frames = bytes / mFrameSize;
+    const useconds_t waitUs = (useconds_t) ((mFrameCount * 1000000LL) / mSampleRate / 4);
+    size_t framesRead = 0;
+    int waits = 0;
+    while (framesRead < frames) {
+        ssize_t ret = mPipeSource->read((int8_t *) buffer + framesRead * mFrameSize,
+                frames - framesRead, AudioBufferProvider::kInvalidPTS);
+        if (ret < 0) {
+            return ret;
+        }
+        if (ret > 0) {
+            framesRead += ret;
+            waits = 0;
+        } else if (++waits > 8) {
+            break;
+        } else {
+            usleep(waitUs);
+        }
+    }
+    if (mShareInput && framesRead > 0) {
+        (void) mSharePipe->write(buffer, framesRead);
+    }
+    return framesRead * mFrameSize;
 }
 
 sp<AudioFlinger::RecordThread::RecordTrack>  AudioFlinger::RecordThread::createRecordTrack_l(
@@ -4808,14 +5814,15 @@ status_t AudioFlinger::RecordThread::start(RecordThread::RecordTrack* recordTrac
 
     {
         AutoMutex lock(mLock);
-        if (mActiveTrack != 0) {
-            if (recordTrack != mActiveTrack.get()) {
-                status = -EBUSY;
-            } else if (mActiveTrack->mState == TrackBase::PAUSING) {
+        if (mActiveTrack != 0 && recordTrack == mActiveTrack.get()) {
+            if (mActiveTrack->mState == TrackBase::PAUSING) {
                 mActiveTrack->mState = TrackBase::ACTIVE;
             }
             return status;
         }
+        if (mActiveTrack != 0 || !mSharedTracks.isEmpty()) {
+            return startSharedTrack_l(recordTrack);
+        }
 
         recordTrack->mState = TrackBase::IDLE;
         mActiveTrack = recordTrack;
@@ -4889,6 +5896,21 @@ void AudioFlinger::RecordThread::handleSyncStartEvent(const sp<SyncEvent>& event
 bool AudioFlinger::RecordThread::stop(RecordThread::RecordTrack* recordTrack) {
     ALOGV("RecordThread::stop");
     AutoMutex _l(mLock);
+    if (mSharedTracks.indexOf(recordTrack) >= 0) {
+        if (recordTrack->mState == TrackBase::PAUSING) {
+            return false;
+        }
+        recordTrack->mState = TrackBase::PAUSING;
+        while (!exitPending() && recordTrack->mState == TrackBase::PAUSING &&
+                mSharedTracks.indexOf(recordTrack) >= 0) {
+            mStartStopCond.wait(mLock);
+        }
+        if (mSharedTracks.indexOf(recordTrack) >= 0) {
+            // restarted
+            return false;
+        }
+        return exitPending() || isLastActiveTrack_l(recordTrack);
+    }
     if (recordTrack != mActiveTrack.get() || recordTrack->mState == TrackBase::PAUSING) {
         return false;
     }
@@ -4901,11 +5923,50 @@ bool AudioFlinger::RecordThread::stop(RecordThread::RecordTrack* recordTrack) {
     // if we have been restarted, recordTrack == mActiveTrack.get() here
     if (exitPending() || recordTrack != mActiveTrack.get()) {
         ALOGV("Record stopped OK");
-        return true;
+        // the input remains started for the secondary tracks, if any
+        return exitPending() || mSharedTracks.isEmpty();
     }
     return false;
 }
 
+status_t AudioFlinger::RecordThread::startSharedTrack_l(RecordThread::RecordTrack* recordTrack)
+{
+    if (mSharedTracks.indexOf(recordTrack) >= 0) {
+        if (recordTrack->mState == TrackBase::PAUSING) {
+            recordTrack->mState = TrackBase::ACTIVE;
+        }
+        return NO_ERROR;
+    }
+    if (mSharePipe == 0 || recordTrack->format() != AUDIO_FORMAT_PCM_16_BIT ||
+            recordTrack->channelCount() > FCC_2) {
+        return -EBUSY;
+    }
+    // the input has already been started by the first track, and mSharePipe only sees the frames
+    // read from now on, so there is no need to wait for the thread
+    recordTrack->mSharedCapture = new SharedCapture(*mSharePipe, mSampleRate, mChannelCount,
+            recordTrack->sampleRate(), recordTrack->channelCount(),
+            (mBufferSize / mFrameSize) * 2);
+    recordTrack->mState = TrackBase::ACTIVE;
+    mSharedTracks.add(recordTrack);
+    mWaitWorkCV.broadcast();
+    ALOGV("Record started as secondary track %p", recordTrack);
+    return NO_ERROR;
+}
+
+bool AudioFlinger::RecordThread::isLastActiveTrack_l(const RecordThread::RecordTrack* recordTrack)
+        const
+{
+    if (mActiveTrack != 0 && mActiveTrack.get() != recordTrack) {
+        return false;
+    }
+    for (size_t i = 0; i < mSharedTracks.size(); i++) {
+        if (mSharedTracks[i].get() != recordTrack) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool AudioFlinger::RecordThread::isValidSyncEvent(const sp<SyncEvent>& event) const
 {
     return false;
@@ -4942,7 +6003,7 @@ void AudioFlinger::RecordThread::destroyTrack_l(const sp<RecordTrack>& track)
     track->terminate();
     track->mState = TrackBase::STOPPED;
     // active tracks are removed by threadLoop()
-    if (mActiveTrack != track) {
+    if (mActiveTrack != track && mSharedTracks.indexOf(track) < 0) {
         removeTrack_l(track);
     }
 }
@@ -4983,9 +6044,24 @@ void AudioFlinger::RecordThread::dumpInternals(int fd, const Vector<String16>& a
     } else {
         result.append("No active record client\n");
     }
+    snprintf(buffer, SIZE, "Shared tracks: %u\n", mSharedTracks.size());
+    result.append(buffer);
+    NBAIO_Stats stats;
+    if (mSharePipe != 0 && mSharePipe->getStats(stats) == NO_ERROR) {
+        snprintf(buffer, SIZE, "Share pipe: frames written %u, readers' overruns %u (%u frames),"
+                " max reader lag %u frames\n",
+                stats.mFrames, stats.mLosses, stats.mFramesLost, stats.mMaxLag);
+        result.append(buffer);
+    }
 
     write(fd, result.string(), result.size());
 
+    if (mFastCapture != 0) {
+        // Make a non-atomic copy of fast capture dump state so it won't change underneath us
+        FastCaptureDump copy = mFastCaptureDump;
+        copy.dump(fd);
+    }
+
     dumpBase(fd, args);
 }
 
@@ -5025,7 +6101,7 @@ status_t AudioFlinger::RecordThread::getNextBuffer(AudioBufferProvider::Buffer*
     int channelCount;
 
     if (framesReady == 0) {
-        mBytesRead = mInput->stream->read(mInput->stream, mRsmpInBuffer, mBufferSize);
+        mBytesRead = readInput(mRsmpInBuffer, mBufferSize);
         if (mBytesRead <= 0) {
             if ((mBytesRead < 0) && (mActiveTrack->mState == TrackBase::ACTIVE)) {
                 ALOGE("RecordThread::getNextBuffer() Error reading audio input");
@@ -5140,6 +6216,10 @@ bool AudioFlinger::RecordThread::checkForNewParameters_l()
             mAudioSource = (audio_source_t)value;
         }
         if (status == NO_ERROR) {
+            if (reconfig) {
+                // the fast capture pipe format depends on the input configuration
+                teardownFastCapture_l();
+            }
             status = mInput->stream->common.set_parameters(&mInput->stream->common,
                     keyValuePair.string());
             if (status == INVALID_OPERATION) {
@@ -5162,6 +6242,7 @@ bool AudioFlinger::RecordThread::checkForNewParameters_l()
                     readInputParameters();
                     sendIoConfigEvent_l(AudioSystem::INPUT_CONFIG_CHANGED);
                 }
+                setupFastCapture_l();
             }
         }
 
@@ -5252,6 +6333,42 @@ void AudioFlinger::RecordThread::readInputParameters()
 
     }
     mRsmpInIndex = mFrameCount;
+
+    resetSharedCapture_l();
+}
+
+void AudioFlinger::RecordThread::resetSharedCapture_l()
+{
+    for (size_t i = 0; i < mSharedTracks.size(); i++) {
+        delete mSharedTracks[i]->mSharedCapture;
+        mSharedTracks[i]->mSharedCapture = NULL;
+    }
+    mSharePipe.clear();
+    mShareInput = false;
+
+    if (mFormat != AUDIO_FORMAT_PCM_16_BIT || mChannelCount > FCC_2) {
+        // secondary tracks can't follow the new configuration
+        for (size_t i = 0; i < mSharedTracks.size(); i++) {
+            mSharedTracks[i]->invalidate();
+        }
+        mSharedTracks.clear();
+        mStartStopCond.broadcast();
+        return;
+    }
+
+    const size_t halFrameCount = mBufferSize / mFrameSize;
+    NBAIO_Format format = Format_from_SR_C(mSampleRate, mChannelCount);
+    mSharePipe = new Pipe(halFrameCount * 4, format);
+    const NBAIO_Format offers[1] = {format};
+    size_t numCounterOffers = 0;
+    ssize_t index = mSharePipe->negotiate(offers, 1, NULL, numCounterOffers);
+    ALOG_ASSERT(index == 0);
+
+    for (size_t i = 0; i < mSharedTracks.size(); i++) {
+        sp<RecordTrack> track = mSharedTracks[i];
+        track->mSharedCapture = new SharedCapture(*mSharePipe, mSampleRate, mChannelCount,
+                track->sampleRate(), track->channelCount(), halFrameCount * 2);
+    }
 }
 
 unsigned int AudioFlinger::RecordThread::getInputFramesLost()
@@ -243,6 +243,10 @@ protected:
                 void        acquireWakeLock_l(int uid = -1);
                 void        releaseWakeLock();
                 void        releaseWakeLock_l();
+                // register and unregister with AudioFlinger::mDeadlineWatchdog, if enabled;
+                // only called on the thread itself, at entry and exit of threadLoop()
+                void        addWatchdogClient(nsecs_t deadlineNs);
+                void        removeWatchdogClient();
                 void setEffectSuspended_l(const effect_uuid_t *type,
                                           bool suspend,
                                           int sessionId);
@@ -326,6 +330,9 @@ protected:
                                         mSuspendedSessions;
                 static const size_t     kLogSize = 4 * 1024;
                 sp<NBLog::Writer>       mNBLogWriter;
+                // deadline record of this thread, NULL if not monitored;
+                // accessed only by threadLoop()
+                AudioWatchdogClient*    mWatchdogClient;
 };
 
 // --- PlaybackThread ---
@@ -473,10 +480,26 @@ public:
                 status_t         getTimestamp_l(AudioTimestamp& timestamp);
 
 protected:
+    // Helper threads for processing the effect chains of several sessions concurrently
+    class EffectWorkers;
+
+    // Process the effect chains, using mEffectWorkers
+                void        processEffectChains_l(const Vector< sp<EffectChain> >& effectChains);
+
+    // non-0 if ro.audio.effect_workers is set, and only for mixer threads
+    sp<EffectWorkers>               mEffectWorkers;
+    // chains handed to mEffectWorkers, kept to avoid reallocation on each cycle
+    Vector< sp<EffectChain> >       mConcurrentEffectChains;
+
     // updated by readOutputParameters()
     size_t                          mNormalFrameCount;  // normal mixer and effects
+    bool                            mLongNormalMixPeriod; // double the normal mixer period,
+                                                          // see ADAPTIVE_NORMAL_MIX_PERIOD
 
     int16_t*                        mMixBuffer;         // frame size aligned mix buffer
+    // buffer written to the HAL by threadLoop_write(), which is mMixBuffer
+    // unless DirectOutputThread writes a track's buffer in place
+    int16_t*                        mWriteBuffer;
     int8_t*                         mAllocMixBuffer;    // mixer buffer allocation address
 
     // suspend count, > 0 means suspended.  While suspended, the thread continues to pull from
@@ -636,6 +659,12 @@ private:
     } mLatchD, mLatchQ;
     bool mLatchDValid;  // true means mLatchD is valid, and clock it into latch at next opportunity
     bool mLatchQValid;  // true means mLatchQ is valid
+
+    // End-to-end latency from the normal mixer's write to presentation, in frames, as measured
+    // from the sink's timestamps.  Written by threadLoop_write, read without lock by dump.
+    uint32_t mLatencyFrames;        // most recent
+    uint32_t mMinLatencyFrames;     // UINT_MAX if no measurement yet
+    uint32_t mMaxLatencyFrames;
 };
 
 class MixerThread : public PlaybackThread {
@@ -673,6 +702,8 @@ private:
                 // one-time initialization, no locks required
                 FastMixer*  mFastMixer;         // non-NULL if there is also a fast mixer
                 sp<AudioWatchdog> mAudioWatchdog; // non-0 if there is an audio watchdog thread
+                // deadline record of the fast mixer, NULL if not monitored
+                AudioWatchdogClient* mFastMixerWatchdogClient;
 
                 // contents are not guaranteed to be consistent, no locks required
                 FastMixerDumpState mFastMixerDumpState;
@@ -686,6 +717,13 @@ private:
                 //          mFastMixer->sq()    // for mutating and pushing state
                 int32_t     mFastMixerFutex;    // for cold idle
 
+#ifdef ADAPTIVE_NORMAL_MIX_PERIOD
+                // accessible only within the threadLoop(), with mLock held
+                bool        adaptNormalMixPeriod_l();
+                nsecs_t     mLongNormalMixPeriodSince;  // when a long period was first wanted,
+                                                        // or 0 if not currently wanted
+#endif
+
 public:
     virtual     bool        hasFastMixer() const { return mFastMixer != NULL; }
     virtual     FastTrackUnderruns getFastTrackUnderruns(size_t fastIndex) const {
@@ -716,6 +754,7 @@ protected:
     // threadLoop snippets
     virtual     mixer_state prepareTracks_l(Vector< sp<Track> > *tracksToRemove);
     virtual     void        threadLoop_mix();
+    virtual     ssize_t     threadLoop_write();
     virtual     void        threadLoop_sleepTime();
 
     // volumes last sent to audio HAL with stream->set_volume()
@@ -728,6 +767,13 @@ protected:
 
     // prepareTracks_l() tells threadLoop_mix() the name of the single active track
     sp<Track>               mActiveTrack;
+
+    // set by prepareTracks_l() on a DIRECT thread without effects and not suspended:
+    // threadLoop_mix() may then have threadLoop_write() write the track's buffer in place
+    bool                        mWriteInPlace;
+    // track and buffer being written in place, released by threadLoop_write()
+    sp<Track>                   mPendingTrack;
+    AudioBufferProvider::Buffer mPendingBuffer;
 public:
     virtual     bool        hasFastMixer() const { return false; }
 };
@@ -744,6 +790,10 @@ protected:
     virtual     mixer_state prepareTracks_l(Vector< sp<Track> > *tracksToRemove);
     virtual     void        threadLoop_exit();
     virtual     void        flushOutput_l();
+#ifdef OFFLOAD_PARTIAL_WAKEUP
+    virtual     ssize_t     threadLoop_write();
+    virtual     void        threadLoop_sleepTime();
+#endif
 
     virtual     bool        waitingAsyncCallback();
     virtual     bool        waitingAsyncCallback_l();
@@ -758,6 +808,9 @@ private:
     size_t      mPausedWriteLength;     // length in bytes of write interrupted by pause
     size_t      mPausedBytesRemaining;  // bytes still waiting in mixbuffer after resume
     Track       *mPreviousTrack;         // used to detect track switch
+#ifdef OFFLOAD_PARTIAL_WAKEUP
+    nsecs_t     mDspFullNs;             // when a write last found the DSP buffer full, or 0
+#endif
 };
 
 class AsyncCallbackThread : public Thread {
@@ -823,10 +876,19 @@ protected:
     virtual     void        saveOutputTracks();
     virtual     void        clearOutputTracks();
 private:
+    // Writes the duplicated mix to one OutputTrack from its own thread, so that an output
+    // which is slow to accept data does not hold up the others
+    class OutputWriter;
 
                 uint32_t    mWaitTimeMs;
     SortedVector < sp<OutputTrack> >  outputTracks;
     SortedVector < sp<OutputTrack> >  mOutputTracks;
+    // one per entry of mOutputTracks, and the copy used by threadLoop like outputTracks
+    SortedVector < sp<OutputWriter> > outputWriters;
+    SortedVector < sp<OutputWriter> > mOutputWriters;
+    // protects the state shared with the writers; mWriteCond is signaled when a writer is done
+    Mutex                             mWriteLock;
+    Condition                         mWriteCond;
 public:
     virtual     bool        hasFastMixer() const { return false; }
 };
@@ -838,6 +900,9 @@ class RecordThread : public ThreadBase, public AudioBufferProvider
 {
 public:
 
+            // Converts the input for one of the secondary tracks sharing it; see mSharedTracks
+            class SharedCapture;
+
 #include "RecordTracks.h"
 
             RecordThread(const sp<AudioFlinger>& audioFlinger,
@@ -917,11 +982,27 @@ public:
            void handleSyncStartEvent(const sp<SyncEvent>& event);
 
     virtual size_t      frameCount() const { return mFrameCount; }
-            bool        hasFastRecorder() const { return false; }
+            bool        hasFastRecorder() const { return mFastCapture != 0; }
 
 private:
             void clearSyncStartEvent();
 
+            // Create the fast capture thread and its pipe if configured and the input supports it,
+            // or destroy them; called at construction and around input reconfiguration
+            void setupFastCapture_l();
+            void teardownFastCapture_l();
+
+            // Read from the fast capture pipe if there is one, otherwise from the HAL directly
+            ssize_t readInput(void *buffer, size_t bytes);
+
+            // Start a track as a secondary reader of an input already started by another track
+            status_t startSharedTrack_l(RecordTrack* recordTrack);
+            // (Re)create the share pipe and the converters of the secondary tracks, called
+            // whenever the input configuration changes
+            void resetSharedCapture_l();
+            // true if no track other than the specified one is capturing from the input
+            bool isLastActiveTrack_l(const RecordTrack* recordTrack) const;
+
             // Enter standby if not already in standby, and set mStandby flag
             void standby();
 
@@ -956,4 +1037,17 @@ private:
             // For dumpsys
             const sp<NBAIO_Sink>                mTeeSink;
             int                                 mClientUid;
+
+            // non-0 if ro.audio.fast_capture is set and the input is PCM 16-bit
+            sp<FastCapture>                     mFastCapture;
+            sp<NBAIO_Source>                    mPipeSource;    // reads what mFastCapture captured
+            FastCaptureDump                     mFastCaptureDump;
+
+            // Tracks capturing from the input at the same time as mActiveTrack, each at its own
+            // sample rate and channel count.  Every frame read from the HAL is also written to
+            // mSharePipe, and each secondary track has its own PipeReader on it.
+            // Only the first track to start and the last track to stop call start/stopInput.
+            SortedVector< sp<RecordTrack> >     mSharedTracks;
+            sp<Pipe>                            mSharePipe;     // non-0 if the input is PCM 16-bit
+            bool                                mShareInput;    // mSharePipe has readers
 };
@@ -124,7 +124,7 @@ AudioFlinger::ThreadBase::TrackBase::TrackBase(
     }
 
     if (client != 0) {
-        mCblkMemory = client->heap()->allocate(size);
+        mCblkMemory = client->allocateTrackMemory(size);
         if (mCblkMemory != 0) {
             mCblk = static_cast<audio_track_cblk_t *>(mCblkMemory->pointer());
             // can't assume mCblk != NULL
@@ -212,6 +212,9 @@ AudioFlinger::ThreadBase::TrackBase::~TrackBase()
             mCblk->~audio_track_cblk_t();   // destroy our shared-structure.
         }
     }
+    if (mClient != 0 && mCblkMemory != 0) {
+        mClient->releaseTrackMemory(mCblkMemory);   // recycle it for the client's next track
+    }
     mCblkMemory.clear();    // free the shared memory before releasing the heap it belongs to
     if (mClient != 0) {
         // Client destructor must run with AudioFlinger mutex locked
@@ -785,6 +788,8 @@ void AudioFlinger::PlaybackThread::Track::reset()
         android_atomic_and(~CBLK_FORCEREADY, &mCblk->mFlags);
         mFillingUpStatus = FS_FILLING;
         mResetDone = true;
+        // until the server has a position for the new data
+        mAudioTrackServerProxy->clearTimestamp();
         if (mState == FLUSHED) {
             mState = IDLE;
         }
@@ -816,7 +821,12 @@ status_t AudioFlinger::PlaybackThread::Track::getTimestamp(AudioTimestamp& times
         return INVALID_OPERATION;
     }
     Mutex::Autolock _l(thread->mLock);
-    PlaybackThread *playbackThread = (PlaybackThread *)thread.get();
+    return getTimestamp_l((PlaybackThread *)thread.get(), timestamp);
+}
+
+status_t AudioFlinger::PlaybackThread::Track::getTimestamp_l(PlaybackThread *playbackThread,
+        AudioTimestamp& timestamp)
+{
     if (!isOffloaded()) {
         if (!playbackThread->mLatchQValid) {
             return INVALID_OPERATION;
@@ -836,6 +846,18 @@ status_t AudioFlinger::PlaybackThread::Track::getTimestamp(AudioTimestamp& times
     return playbackThread->getTimestamp_l(timestamp);
 }
 
+void AudioFlinger::PlaybackThread::Track::publishTimestamp_l(PlaybackThread *playbackThread)
+{
+    // fast tracks have no timestamp yet, see getTimestamp()
+    if (isFastTrack()) {
+        return;
+    }
+    AudioTimestamp timestamp;
+    if (getTimestamp_l(playbackThread, timestamp) == NO_ERROR) {
+        mAudioTrackServerProxy->setTimestamp(timestamp);
+    }
+}
+
 status_t AudioFlinger::PlaybackThread::Track::attachAuxEffect(int EffectId)
 {
     status_t status = DEAD_OBJECT;
@@ -1787,7 +1809,7 @@ AudioFlinger::RecordThread::RecordTrack::RecordTrack(
             int sessionId)
     :   TrackBase(thread, client, sampleRate, format, channelMask, frameCount,
         flags, 0 /*sharedBuffer*/, sessionId, false /*isOut*/),
-        mOverflow(false)
+        mOverflow(false), mSharedCapture(NULL)
 {
     ALOGV("RecordTrack constructor");
     mFlags = flags;
@@ -1849,12 +1871,19 @@ void AudioFlinger::RecordThread::RecordTrack::destroy()
     {
         sp<ThreadBase> thread = mThread.promote();
         if (thread != 0) {
-            if (mState == ACTIVE || mState == RESUMING) {
+            RecordThread *recordThread = (RecordThread *) thread.get();
+            bool stopInput;
+            {
+                // other tracks may still be sharing the input
+                Mutex::Autolock _l(thread->mLock);
+                stopInput = (mState == ACTIVE || mState == RESUMING) &&
+                        recordThread->isLastActiveTrack_l(this);
+            }
+            if (stopInput) {
                 AudioSystem::stopInput(thread->id());
             }
             AudioSystem::releaseInput(thread->id());
             Mutex::Autolock _l(thread->mLock);
-            RecordThread *recordThread = (RecordThread *) thread.get();
             recordThread->destroyTrack_l(this);
         }
     }
@@ -0,0 +1,472 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Repeatable benchmark of the audio DSP code run on the mixer and record paths: the
+// AudioMixer process hooks, the AudioResampler qualities, and every effect known to the
+// effects factory (LVM bundle and reverb, downmix, pre processing, ...).
+//
+// Each case is driven with the same synthetic signal (a log sweep plus low level noise from a
+// fixed seed) at typical buffer sizes, and reports ns per frame, CPU cycles per sample at the
+// current frequency of cpu0, and a checksum of the output.  The checksum only depends on the
+// code being run, so it can be compared between builds to check that an optimized path is
+// bit-exact, and between a reference and a vendor build to spot changed DSP.
+//
+// For stable numbers, pin the CPU frequency and run with the screen off.
+
+#include "AudioMixer.h"
+#include "AudioResampler.h"
+#include <media/AudioBufferProvider.h>
+#include <media/EffectsFactoryApi.h>
+#include <audio_effects/effect_downmix.h>
+#include <cutils/bitops.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+
+using namespace android;
+
+static int64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Returns the current frequency of cpu0 in kHz, or 0 if unknown.
+static uint32_t cpuFreqKHz() {
+    uint32_t freq = 0;
+    FILE *f = fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq", "r");
+    if (f != NULL) {
+        if (fscanf(f, "%u", &freq) != 1) {
+            freq = 0;
+        }
+        fclose(f);
+    }
+    return freq;
+}
+
+// FNV-1a over the bytes of a buffer, chained across calls through hash.
+static uint32_t checksum(uint32_t hash, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *) data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static const uint32_t kChecksumSeed = 2166136261u;
+
+// Fills frames of channelCount 16-bit samples with a log sweep from 20 Hz to sampleRate / 2
+// at -6 dBFS, different on each channel, plus white noise at -40 dBFS.
+static void makeSignal(int16_t *buffer, size_t frames, int channelCount, uint32_t sampleRate) {
+    uint32_t seed = 1;
+    double phase = 0;
+    const double f0 = 20.0;
+    const double f1 = sampleRate / 2.0;
+    for (size_t i = 0; i < frames; i++) {
+        double f = f0 * pow(f1 / f0, (double) i / frames);
+        phase += 2 * M_PI * f / sampleRate;
+        for (int j = 0; j < channelCount; j++) {
+            seed = seed * 1103515245u + 12345u;
+            double noise = ((int32_t) seed >> 16) / 32768.0 * 0.01;
+            double y = 0.5 * sin(phase * (1 + j * 0.01) + j) + noise;
+            buffer[i * channelCount + j] = (int16_t) floor(y * 32767.0 + 0.5);
+        }
+    }
+}
+
+// Serves the same signal over and over, in chunks of at most the requested size.
+class SignalProvider : public AudioBufferProvider {
+public:
+    SignalProvider(int channelCount, uint32_t sampleRate, size_t frames)
+        : mChannelCount(channelCount), mFrames(frames), mPosition(0) {
+        mSignal = new int16_t[frames * channelCount];
+        makeSignal(mSignal, frames, channelCount, sampleRate);
+    }
+    virtual ~SignalProvider() { delete[] mSignal; }
+
+    virtual status_t getNextBuffer(Buffer* buffer, int64_t pts = kInvalidPTS) {
+        size_t available = mFrames - mPosition;
+        if (buffer->frameCount > available) {
+            buffer->frameCount = available;
+        }
+        buffer->i16 = mSignal + mPosition * mChannelCount;
+        return NO_ERROR;
+    }
+    virtual void releaseBuffer(Buffer* buffer) {
+        mPosition += buffer->frameCount;
+        if (mPosition >= mFrames) {
+            mPosition = 0;
+        }
+        buffer->raw = NULL;
+        buffer->frameCount = 0;
+    }
+
+private:
+    const int mChannelCount;
+    const size_t mFrames;
+    size_t mPosition;
+    int16_t *mSignal;
+};
+
+struct Options {
+    size_t frameCount;      // frames per buffer on the mixer side
+    uint32_t sampleRate;    // sample rate of the mixer side
+    int iterations;         // buffers processed per case
+    const char *filter;     // only run cases whose name contains this
+};
+
+static void report(const char *name, int64_t ns, size_t frames,
+        int channelCount, uint32_t hash) {
+    double nsPerFrame = (double) ns / frames;
+    uint32_t freq = cpuFreqKHz();
+    if (freq != 0) {
+        double cyclesPerSample = nsPerFrame * freq * 1e-6 / channelCount;
+        printf("%-44s %10.2f ns/frame %10.2f cycles/sample  checksum %08x\n",
+                name, nsPerFrame, cyclesPerSample, hash);
+    } else {
+        printf("%-44s %10.2f ns/frame %10s cycles/sample  checksum %08x\n",
+                name, nsPerFrame, "n/a", hash);
+    }
+}
+
+static bool selected(const Options& options, const char *name) {
+    return options.filter == NULL || strstr(name, options.filter) != NULL;
+}
+
+// ----------------------------------------------------------------------------
+
+static void benchResampler(const Options& options, AudioResampler::src_quality quality,
+        const char *qualityName, int channelCount, uint32_t inputRate) {
+    char name[64];
+    snprintf(name, sizeof(name), "resampler %s %s %u->%u", qualityName,
+            channelCount == 1 ? "mono" : "stereo", inputRate, options.sampleRate);
+    if (!selected(options, name)) {
+        return;
+    }
+    SignalProvider provider(channelCount, inputRate, inputRate);
+    AudioResampler *resampler = AudioResampler::create(16, channelCount, options.sampleRate,
+            quality);
+    resampler->setSampleRate(inputRate);
+    resampler->setVolume(AudioMixer::UNITY_GAIN, AudioMixer::UNITY_GAIN);
+    int32_t *out = new int32_t[options.frameCount * 2];
+    uint32_t hash = kChecksumSeed;
+    int64_t ns = 0;
+    for (int i = 0; i < options.iterations; i++) {
+        memset(out, 0, options.frameCount * 2 * sizeof(int32_t));
+        int64_t start = nowNs();
+        resampler->resample(out, options.frameCount, &provider);
+        ns += nowNs() - start;
+        hash = checksum(hash, out, options.frameCount * 2 * sizeof(int32_t));
+    }
+    report(name, ns, options.frameCount * options.iterations, 2, hash);
+    delete[] out;
+    delete resampler;
+}
+
+// ----------------------------------------------------------------------------
+
+struct MixerCase {
+    const char *name;
+    int trackCount;
+    audio_channel_mask_t channelMask;
+    uint32_t trackRate;     // 0 for the mixer sample rate
+    audio_format_t mixerFormat;
+};
+
+static void benchMixer(const Options& options, const MixerCase& mixerCase) {
+    char name[64];
+    snprintf(name, sizeof(name), "mixer %s", mixerCase.name);
+    if (!selected(options, name)) {
+        return;
+    }
+    uint32_t trackRate = mixerCase.trackRate != 0 ? mixerCase.trackRate : options.sampleRate;
+    int channelCount = popcount(mixerCase.channelMask);
+    AudioMixer *mixer = new AudioMixer(options.frameCount, options.sampleRate);
+    int32_t *mainBuffer = new int32_t[options.frameCount * 2];
+    SignalProvider *providers[AudioMixer::MAX_NUM_TRACKS];
+    int trackCount = mixerCase.trackCount;
+    for (int i = 0; i < mixerCase.trackCount; i++) {
+        providers[i] = new SignalProvider(channelCount, trackRate, trackRate + i * 7);
+        int trackName = mixer->getTrackName(mixerCase.channelMask, 0);
+        if (trackName < 0) {
+            printf("%-44s getTrackName() failed\n", name);
+            delete providers[i];
+            trackCount = i;
+            break;
+        }
+        mixer->setBufferProvider(trackName, providers[i]);
+        mixer->setParameter(trackName, AudioMixer::TRACK, AudioMixer::MAIN_BUFFER, mainBuffer);
+        mixer->setParameter(trackName, AudioMixer::TRACK, AudioMixer::MIXER_FORMAT,
+                (void *) mixerCase.mixerFormat);
+        mixer->setParameter(trackName, AudioMixer::TRACK, AudioMixer::FORMAT,
+                (void *) AUDIO_FORMAT_PCM_16_BIT);
+        mixer->setParameter(trackName, AudioMixer::TRACK, AudioMixer::CHANNEL_MASK,
+                (void *) mixerCase.channelMask);
+        mixer->setParameter(trackName, AudioMixer::RESAMPLE, AudioMixer::SAMPLE_RATE,
+                (void *) trackRate);
+        mixer->setParameter(trackName, AudioMixer::VOLUME, AudioMixer::VOLUME0,
+                (void *) (AudioMixer::UNITY_GAIN / mixerCase.trackCount));
+        mixer->setParameter(trackName, AudioMixer::VOLUME, AudioMixer::VOLUME1,
+                (void *) (AudioMixer::UNITY_GAIN / mixerCase.trackCount));
+        mixer->enable(trackName);
+    }
+    size_t frameSize = mixerCase.mixerFormat == AUDIO_FORMAT_PCM_8_24_BIT ?
+            2 * sizeof(int32_t) : 2 * sizeof(int16_t);
+    if (trackCount != mixerCase.trackCount) {
+        delete mixer;
+        for (int i = 0; i < trackCount; i++) {
+            delete providers[i];
+        }
+        delete[] mainBuffer;
+        return;
+    }
+    uint32_t hash = kChecksumSeed;
+    int64_t ns = 0;
+    for (int i = 0; i < options.iterations; i++) {
+        int64_t start = nowNs();
+        mixer->process(AudioBufferProvider::kInvalidPTS);
+        ns += nowNs() - start;
+        hash = checksum(hash, mainBuffer, options.frameCount * frameSize);
+    }
+    report(name, ns, options.frameCount * options.iterations, 2, hash);
+    delete mixer;
+    for (int i = 0; i < trackCount; i++) {
+        delete providers[i];
+    }
+    delete[] mainBuffer;
+}
+
+// ----------------------------------------------------------------------------
+
+static int effectCommand(effect_handle_t handle, uint32_t cmdCode, uint32_t cmdSize,
+        void *pCmdData) {
+    int status;
+    uint32_t size = sizeof(int);
+    int ret = (*handle)->command(handle, cmdCode, cmdSize, pCmdData, &size, &status);
+    return ret != 0 ? ret : status;
+}
+
+// Runs one effect the way AudioFlinger would: pre processing effects on a 10 ms mono capture
+// buffer, auxiliary effects on a mono send accumulated into a stereo buffer, and insert
+// effects in place on stereo, except the downmixer which gets inputChannelMask.
+static void benchEffect(const Options& options, const effect_descriptor_t& desc,
+        audio_channel_mask_t inputChannelMask) {
+    char name[64];
+    uint32_t type = desc.flags & EFFECT_FLAG_TYPE_MASK;
+    if (inputChannelMask != AUDIO_CHANNEL_OUT_STEREO) {
+        snprintf(name, sizeof(name), "effect %.24s %dch", desc.name,
+                popcount(inputChannelMask));
+    } else {
+        snprintf(name, sizeof(name), "effect %.32s", desc.name);
+    }
+    if (!selected(options, name)) {
+        return;
+    }
+
+    effect_config_t config;
+    memset(&config, 0, sizeof(config));
+    uint32_t sampleRate = options.sampleRate;
+    size_t frameCount = options.frameCount;
+    if (type == EFFECT_FLAG_TYPE_PRE_PROC) {
+        sampleRate = 16000;
+        frameCount = sampleRate / 100;
+        config.inputCfg.channels = AUDIO_CHANNEL_IN_MONO;
+        config.outputCfg.channels = AUDIO_CHANNEL_IN_MONO;
+    } else if (type == EFFECT_FLAG_TYPE_AUXILIARY) {
+        config.inputCfg.channels = AUDIO_CHANNEL_OUT_MONO;
+        config.outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+    } else {
+        config.inputCfg.channels = inputChannelMask;
+        config.outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+    }
+    const bool inPlace = type != EFFECT_FLAG_TYPE_AUXILIARY &&
+            inputChannelMask == AUDIO_CHANNEL_OUT_STEREO;
+    int inChannelCount = popcount(config.inputCfg.channels);
+    int outChannelCount = popcount(config.outputCfg.channels);
+    config.inputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    config.outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    config.inputCfg.samplingRate = sampleRate;
+    config.outputCfg.samplingRate = sampleRate;
+    config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+    config.outputCfg.accessMode = inPlace || type == EFFECT_FLAG_TYPE_PRE_PROC ?
+            EFFECT_BUFFER_ACCESS_WRITE : EFFECT_BUFFER_ACCESS_ACCUMULATE;
+    config.inputCfg.mask = EFFECT_CONFIG_ALL;
+    config.outputCfg.mask = EFFECT_CONFIG_ALL;
+    config.inputCfg.buffer.frameCount = frameCount;
+    config.outputCfg.buffer.frameCount = frameCount;
+
+    effect_handle_t handle;
+    int ret = EffectCreate(&desc.uuid, 1, 0, &handle);
+    if (ret != 0) {
+        printf("%-44s EffectCreate() failed %d\n", name, ret);
+        return;
+    }
+    ret = effectCommand(handle, EFFECT_CMD_INIT, 0, NULL);
+    if (ret == 0) {
+        ret = effectCommand(handle, EFFECT_CMD_SET_CONFIG, sizeof(config), &config);
+    }
+    if (ret == 0) {
+        ret = effectCommand(handle, EFFECT_CMD_ENABLE, 0, NULL);
+    }
+    if (ret != 0) {
+        printf("%-44s not configurable %d, skipped\n", name, ret);
+        EffectRelease(handle);
+        return;
+    }
+
+    // the signal is one second long and is walked through one buffer at a time
+    size_t signalFrames = sampleRate - sampleRate % frameCount;
+    int16_t *signal = new int16_t[signalFrames * inChannelCount];
+    makeSignal(signal, signalFrames, inChannelCount, sampleRate);
+    int16_t *in = new int16_t[frameCount * inChannelCount];
+    int16_t *out = inPlace ? in : new int16_t[frameCount * outChannelCount];
+    if (!inPlace) {
+        memset(out, 0, frameCount * outChannelCount * sizeof(int16_t));
+    }
+    audio_buffer_t inBuffer, outBuffer;
+    size_t position = 0;
+    uint32_t hash = kChecksumSeed;
+    int64_t ns = 0;
+    for (int i = 0; i < options.iterations; i++) {
+        memcpy(in, signal + position * inChannelCount,
+                frameCount * inChannelCount * sizeof(int16_t));
+        position = (position + frameCount) % signalFrames;
+        inBuffer.frameCount = frameCount;
+        inBuffer.s16 = in;
+        outBuffer.frameCount = frameCount;
+        outBuffer.s16 = out;
+        int64_t start = nowNs();
+        (*handle)->process(handle, &inBuffer, &outBuffer);
+        ns += nowNs() - start;
+        hash = checksum(hash, out, frameCount * outChannelCount * sizeof(int16_t));
+        if (config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
+            memset(out, 0, frameCount * outChannelCount * sizeof(int16_t));
+        }
+    }
+    report(name, ns, frameCount * options.iterations, inChannelCount, hash);
+
+    effectCommand(handle, EFFECT_CMD_DISABLE, 0, NULL);
+    EffectRelease(handle);
+    if (!inPlace) {
+        delete[] out;
+    }
+    delete[] in;
+    delete[] signal;
+}
+
+// ----------------------------------------------------------------------------
+
+static int usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-f frame-count] [-r sample-rate] [-n iterations] "
+                    "[<name-filter>]\n", name);
+    fprintf(stderr, "    -f    frames per buffer on the mixer side, default 1024\n");
+    fprintf(stderr, "    -r    mixer sample rate in Hz, default 48000\n");
+    fprintf(stderr, "    -n    number of buffers processed per case, default 1000\n");
+    fprintf(stderr, "    only the cases whose name contains name-filter are run\n");
+    return -1;
+}
+
+int main(int argc, char* argv[]) {
+    const char* const progname = argv[0];
+    Options options;
+    options.frameCount = 1024;
+    options.sampleRate = 48000;
+    options.iterations = 1000;
+    options.filter = NULL;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "f:r:n:")) != -1) {
+        switch (ch) {
+        case 'f':
+            options.frameCount = atoi(optarg);
+            break;
+        case 'r':
+            options.sampleRate = atoi(optarg);
+            break;
+        case 'n':
+            options.iterations = atoi(optarg);
+            break;
+        case '?':
+        default:
+            return usage(progname);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc == 1) {
+        options.filter = argv[0];
+    } else if (argc > 1 || options.frameCount == 0 || options.sampleRate == 0 ||
+            options.iterations <= 0) {
+        return usage(progname);
+    }
+
+    printf("%u frames per buffer at %u Hz, %d buffers per case, cpu0 at %u kHz\n",
+            (unsigned) options.frameCount, options.sampleRate, options.iterations, cpuFreqKHz());
+
+    static const struct {
+        AudioResampler::src_quality quality;
+        const char *name;
+    } kQualities[] = {
+        { AudioResampler::LOW_QUALITY,       "lq" },
+        { AudioResampler::MED_QUALITY,       "mq" },
+        { AudioResampler::HIGH_QUALITY,      "hq" },
+        { AudioResampler::VERY_HIGH_QUALITY, "vhq" },
+    };
+    for (size_t i = 0; i < sizeof(kQualities) / sizeof(kQualities[0]); i++) {
+        benchResampler(options, kQualities[i].quality, kQualities[i].name, 1, 44100);
+        benchResampler(options, kQualities[i].quality, kQualities[i].name, 2, 44100);
+        benchResampler(options, kQualities[i].quality, kQualities[i].name, 2, 32000);
+    }
+
+    static const MixerCase kMixerCases[] = {
+        { "1 stereo track",         1, AUDIO_CHANNEL_OUT_STEREO,  0,     AUDIO_FORMAT_PCM_16_BIT },
+        { "2 stereo tracks",        2, AUDIO_CHANNEL_OUT_STEREO,  0,     AUDIO_FORMAT_PCM_16_BIT },
+        { "4 stereo tracks",        4, AUDIO_CHANNEL_OUT_STEREO,  0,     AUDIO_FORMAT_PCM_16_BIT },
+        { "1 mono track",           1, AUDIO_CHANNEL_OUT_MONO,    0,     AUDIO_FORMAT_PCM_16_BIT },
+        { "1 stereo track 44100",   1, AUDIO_CHANNEL_OUT_STEREO,  44100, AUDIO_FORMAT_PCM_16_BIT },
+        { "2 stereo tracks 44100",  2, AUDIO_CHANNEL_OUT_STEREO,  44100, AUDIO_FORMAT_PCM_16_BIT },
+        { "1 5.1 track",            1, AUDIO_CHANNEL_OUT_5POINT1, 0,     AUDIO_FORMAT_PCM_16_BIT },
+        { "2 stereo tracks 8.24",   2, AUDIO_CHANNEL_OUT_STEREO,  0,     AUDIO_FORMAT_PCM_8_24_BIT },
+    };
+    for (size_t i = 0; i < sizeof(kMixerCases) / sizeof(kMixerCases[0]); i++) {
+        benchMixer(options, kMixerCases[i]);
+    }
+
+    uint32_t numEffects = 0;
+    if (EffectQueryNumberEffects(&numEffects) != 0) {
+        fprintf(stderr, "error querying the effects factory\n");
+        return -1;
+    }
+    for (uint32_t i = 0; i < numEffects; i++) {
+        effect_descriptor_t desc;
+        if (EffectQueryEffect(i, &desc) != 0) {
+            continue;
+        }
+        if (memcmp(&desc.type, EFFECT_UIID_DOWNMIX, sizeof(effect_uuid_t)) == 0) {
+            benchEffect(options, desc, AUDIO_CHANNEL_OUT_QUAD);
+            benchEffect(options, desc, AUDIO_CHANNEL_OUT_5POINT1);
+            benchEffect(options, desc, AUDIO_CHANNEL_OUT_7POINT1);
+        } else {
+            benchEffect(options, desc, AUDIO_CHANNEL_OUT_STEREO);
+        }
+    }
+
+    return 0;
+}
@@ -36,6 +36,11 @@ LOCAL_SRC_FILES:=               \
     device3/StatusTracker.cpp \
     gui/RingBufferConsumer.cpp \
 
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_SRC_FILES += api1/client2/CallbackProcessorNEON.cpp.neon
+LOCAL_CFLAGS += -DCALLBACK_PROCESSOR_NEON
+endif
+
 LOCAL_SHARED_LIBRARIES:= \
     libui \
     liblog \
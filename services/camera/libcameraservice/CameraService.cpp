@@ -96,6 +96,7 @@ CameraService::CameraService()
 
     for (size_t i = 0; i < MAX_CAMERAS; ++i) {
         mStatusList[i] = ICameraServiceListener::STATUS_PRESENT;
+        mCameraInfoValid[i] = false;
     }
 
     this->camera_device_status_change = android::camera_device_status_change;
@@ -160,6 +161,12 @@ void CameraService::onDeviceStatusChanged(int cameraId,
         return;
     }
 
+    // A camera plugged in again may not be the same camera
+    {
+        Mutex::Autolock al(mCameraInfoLock);
+        mCameraInfoValid[cameraId] = false;
+    }
+
     /* don't do this in updateStatus
        since it is also called from connect and we could get into a deadlock */
     if (newStatus == CAMERA_DEVICE_STATUS_NOT_PRESENT) {
@@ -219,7 +226,7 @@ status_t CameraService::getCameraInfo(int cameraId,
     }
 
     struct camera_info info;
-    status_t rc = mModule->get_camera_info(cameraId, &info);
+    status_t rc = getCachedCameraInfo(cameraId, &info);
     cameraInfo->facing = info.facing;
     cameraInfo->orientation = info.orientation;
     return rc;
@@ -262,15 +269,35 @@ status_t CameraService::getCameraCharacteristics(int cameraId,
     }
 
     struct camera_info info;
-    status_t ret = mModule->get_camera_info(cameraId, &info);
+    status_t ret = getCachedCameraInfo(cameraId, &info);
     *cameraInfo = info.static_camera_characteristics;
 
     return ret;
 }
 
+status_t CameraService::getCachedCameraInfo(int cameraId,
+                                            struct camera_info *info) {
+    if (cameraId < 0 || cameraId >= MAX_CAMERAS) {
+        return BAD_VALUE;
+    }
+
+    Mutex::Autolock al(mCameraInfoLock);
+    if (!mCameraInfoValid[cameraId]) {
+        status_t rc = mModule->get_camera_info(cameraId,
+                &mCameraInfo[cameraId]);
+        if (rc != OK) {
+            return rc;
+        }
+        mCameraInfoValid[cameraId] = true;
+    }
+
+    *info = mCameraInfo[cameraId];
+    return OK;
+}
+
 int CameraService::getDeviceVersion(int cameraId, int* facing) {
     struct camera_info info;
-    if (mModule->get_camera_info(cameraId, &info) != OK) {
+    if (getCachedCameraInfo(cameraId, &info) != OK) {
         return -1;
     }
 
@@ -1176,7 +1203,7 @@ status_t CameraService::dump(int fd, const Vector<String16>& args) {
             result = String8::format("Camera %d static information:\n", i);
             camera_info info;
 
-            status_t rc = mModule->get_camera_info(i, &info);
+            status_t rc = getCachedCameraInfo(i, &info);
             if (rc != OK) {
                 result.appendFormat("  Error reading static information!\n");
                 write(fd, result.string(), result.size());
@@ -363,6 +363,16 @@ private:
 
     camera_module_t *mModule;
 
+    // camera_info of each camera, read from the HAL on first use and dropped
+    // when the device status changes
+    Mutex               mCameraInfoLock;
+    struct camera_info  mCameraInfo[MAX_CAMERAS];
+    bool                mCameraInfoValid[MAX_CAMERAS];
+
+    // Read the camera_info of a camera through the cache above
+    status_t            getCachedCameraInfo(int cameraId,
+                                            struct camera_info *info);
+
     Vector<sp<ICameraServiceListener> >
                         mListenerList;
 
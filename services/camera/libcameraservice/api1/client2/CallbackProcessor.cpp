@@ -31,6 +31,18 @@
 namespace android {
 namespace camera2 {
 
+#ifdef CALLBACK_PROCESSOR_NEON
+// In CallbackProcessorNEON.cpp; convert a multiple of 16 chroma samples
+// from the start of the row and return how many they did.
+size_t interleaveChromaNEON(
+        uint8_t *dst, const uint8_t *first, const uint8_t *second,
+        size_t step, size_t width);
+size_t deinterleaveChromaNEON(
+        uint8_t *firstDst, uint8_t *secondDst,
+        const uint8_t *first, const uint8_t *second,
+        size_t step, size_t width);
+#endif
+
 CallbackProcessor::CallbackProcessor(sp<Camera2Client> client):
         Thread(false),
         mClient(client),
@@ -397,7 +409,8 @@ status_t CallbackProcessor::processNewCallback(sp<Camera2Client> &client) {
         mCallbackHeapFree--;
 
         // TODO: Get rid of this copy by passing the gralloc queue all the way
-        // to app
+        // to app. Apps that can take the frames from a buffer queue already
+        // get them without a copy through setCallbackWindow().
 
         ssize_t offset;
         size_t size;
@@ -460,13 +473,19 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
         return INVALID_OPERATION;
     }
 
-    // Copy Y plane, adjusting for stride
+    // Copy Y plane, adjusting for stride. When the strides match the plane
+    // is copied in one go, which is much cheaper than a call per row.
     const uint8_t *ySrc = src.data;
     uint8_t *yDst = dst;
-    for (size_t row = 0; row < src.height; row++) {
-        memcpy(yDst, ySrc, src.width);
-        ySrc += src.stride;
-        yDst += dstYStride;
+    if (src.stride == dstYStride && src.height > 0) {
+        memcpy(yDst, ySrc, dstYStride * (src.height - 1) + src.width);
+        yDst += dstYStride * src.height;
+    } else {
+        for (size_t row = 0; row < src.height; row++) {
+            memcpy(yDst, ySrc, src.width);
+            ySrc += src.stride;
+            yDst += dstYStride;
+        }
     }
 
     // Copy/swizzle chroma planes, 4:2:0 subsampling
@@ -484,17 +503,30 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
         // Check for shortcuts
         if (cbSrc == crSrc + 1 && src.chromaStep == 2) {
             ALOGV("%s: Fast NV21->NV21", __FUNCTION__);
-            // Source has semiplanar CrCb chroma layout, can copy by rows
-            for (size_t row = 0; row < chromaHeight; row++) {
-                memcpy(crcbDst, crSrc, src.width);
-                crcbDst += src.width;
-                crSrc += src.chromaStride;
+            // Source has semiplanar CrCb chroma layout, can copy by rows,
+            // or all at once if there's no padding between them
+            if (src.chromaStride == src.width) {
+                memcpy(crcbDst, crSrc, src.width * chromaHeight);
+            } else {
+                for (size_t row = 0; row < chromaHeight; row++) {
+                    memcpy(crcbDst, crSrc, src.width);
+                    crcbDst += src.width;
+                    crSrc += src.chromaStride;
+                }
             }
         } else {
             ALOGV("%s: Generic->NV21", __FUNCTION__);
             // Generic copy, always works but not very efficient
             for (size_t row = 0; row < chromaHeight; row++) {
-                for (size_t col = 0; col < chromaWidth; col++) {
+                size_t col = 0;
+#ifdef CALLBACK_PROCESSOR_NEON
+                col = interleaveChromaNEON(crcbDst, crSrc, cbSrc,
+                        src.chromaStep, chromaWidth);
+                crcbDst += 2 * col;
+                crSrc += col * src.chromaStep;
+                cbSrc += col * src.chromaStep;
+#endif
+                for (; col < chromaWidth; col++) {
                     *(crcbDst++) = *crSrc;
                     *(crcbDst++) = *cbSrc;
                     crSrc += src.chromaStep;
@@ -512,22 +544,39 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
         uint8_t *cbDst = yDst + chromaHeight * dstCStride;
         if (src.chromaStep == 1) {
             ALOGV("%s: Fast YV12->YV12", __FUNCTION__);
-            // Source has planar chroma layout, can copy by row
-            for (size_t row = 0; row < chromaHeight; row++) {
-                memcpy(crDst, crSrc, chromaWidth);
-                crDst += dstCStride;
-                crSrc += src.chromaStride;
-            }
-            for (size_t row = 0; row < chromaHeight; row++) {
-                memcpy(cbDst, cbSrc, chromaWidth);
-                cbDst += dstCStride;
-                cbSrc += src.chromaStride;
+            // Source has planar chroma layout, can copy by row, or by
+            // plane if the strides match
+            if (src.chromaStride == dstCStride && chromaHeight > 0) {
+                size_t planeSize =
+                        dstCStride * (chromaHeight - 1) + chromaWidth;
+                memcpy(crDst, crSrc, planeSize);
+                memcpy(cbDst, cbSrc, planeSize);
+            } else {
+                for (size_t row = 0; row < chromaHeight; row++) {
+                    memcpy(crDst, crSrc, chromaWidth);
+                    crDst += dstCStride;
+                    crSrc += src.chromaStride;
+                }
+                for (size_t row = 0; row < chromaHeight; row++) {
+                    memcpy(cbDst, cbSrc, chromaWidth);
+                    cbDst += dstCStride;
+                    cbSrc += src.chromaStride;
+                }
             }
         } else {
             ALOGV("%s: Generic->YV12", __FUNCTION__);
             // Generic copy, always works but not very efficient
             for (size_t row = 0; row < chromaHeight; row++) {
-                for (size_t col = 0; col < chromaWidth; col++) {
+                size_t col = 0;
+#ifdef CALLBACK_PROCESSOR_NEON
+                col = deinterleaveChromaNEON(crDst, cbDst, crSrc, cbSrc,
+                        src.chromaStep, chromaWidth);
+                crDst += col;
+                cbDst += col;
+                crSrc += col * src.chromaStep;
+                cbSrc += col * src.chromaStep;
+#endif
+                for (; col < chromaWidth; col++) {
                     *(crDst++) = *crSrc;
                     *(cbDst++) = *cbSrc;
                     crSrc += src.chromaStep;
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <arm_neon.h>
+
+namespace android {
+namespace camera2 {
+
+// NEON versions of the generic chroma loops in
+// CallbackProcessor::convertFromFlexibleYuv(), 16 chroma samples at a time.
+// Only sample steps of 1 (planar) and 2 (semiplanar, in either order) are
+// handled; the number of samples converted is returned and the caller
+// finishes the row. With a step of 2 a block loads one byte past its last
+// sample, so the last block is left to the caller unless another sample
+// follows it.
+
+static inline size_t numBlocks(size_t step, size_t width) {
+    if (step == 1) {
+        return width / 16;
+    }
+    return width > 0 ? (width - 1) / 16 : 0;
+}
+
+size_t interleaveChromaNEON(
+        uint8_t *dst, const uint8_t *first, const uint8_t *second,
+        size_t step, size_t width) {
+    if (step != 1 && step != 2) {
+        return 0;
+    }
+
+    size_t blocks = numBlocks(step, width);
+    for (size_t i = 0; i < blocks; i++) {
+        uint8x16x2_t out;
+        if (step == 1) {
+            out.val[0] = vld1q_u8(first);
+            out.val[1] = vld1q_u8(second);
+        } else {
+            out.val[0] = vld2q_u8(first).val[0];
+            out.val[1] = vld2q_u8(second).val[0];
+        }
+        vst2q_u8(dst, out);
+
+        first += 16 * step;
+        second += 16 * step;
+        dst += 32;
+    }
+
+    return blocks * 16;
+}
+
+size_t deinterleaveChromaNEON(
+        uint8_t *firstDst, uint8_t *secondDst,
+        const uint8_t *first, const uint8_t *second,
+        size_t step, size_t width) {
+    if (step != 2) {
+        // A step of 1 is already planar and copied by rows.
+        return 0;
+    }
+
+    size_t blocks = numBlocks(step, width);
+    for (size_t i = 0; i < blocks; i++) {
+        vst1q_u8(firstDst, vld2q_u8(first).val[0]);
+        vst1q_u8(secondDst, vld2q_u8(second).val[0]);
+
+        first += 32;
+        second += 32;
+        firstDst += 16;
+        secondDst += 16;
+    }
+
+    return blocks * 16;
+}
+
+}; // namespace camera2
+}; // namespace android
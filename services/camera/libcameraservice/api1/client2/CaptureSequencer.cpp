@@ -406,6 +406,12 @@ CaptureSequencer::CaptureState CaptureSequencer::manageStandardStart(
         if (l.mParameters.flashMode != Parameters::FLASH_MODE_ON && isAeConverged) {
             return STANDARD_CAPTURE;
         }
+        // Never run a precapture sequence for a video snapshot; metering
+        // (and possibly flash) would show up in the recording, and the
+        // snapshot is taken with the exposure the video already has.
+        if (l.mParameters.state == Parameters::VIDEO_SNAPSHOT) {
+            return STANDARD_CAPTURE;
+        }
 
         mTriggerId = l.mParameters.precaptureTriggerCounter++;
     }
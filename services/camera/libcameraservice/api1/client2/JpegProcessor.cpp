@@ -361,13 +361,23 @@ size_t JpegProcessor::findJpegSize(uint8_t* jpegBuffer, size_t maxSize) {
     }
 
     // Find End of Image
-    // Scan JPEG buffer until End of Image (EOI)
+    // Scan JPEG buffer until End of Image (EOI). The entropy coded data is
+    // most of the buffer, so let memchr skip to the next marker byte.
     bool foundEnd = false;
-    for ( ; size <= maxSize - MARKER_LENGTH; size++) {
-        if ( checkJpegEnd(jpegBuffer + size) ) {
-            foundEnd = true;
-            size += MARKER_LENGTH;
-            break;
+    if (size <= maxSize - MARKER_LENGTH) {
+        uint8_t *pos = jpegBuffer + size;
+        uint8_t *last = jpegBuffer + maxSize - MARKER_LENGTH;
+        while (pos <= last) {
+            pos = (uint8_t *)memchr(pos, MARK, last - pos + 1);
+            if (pos == NULL) {
+                break;
+            }
+            if ( checkJpegEnd(pos) ) {
+                foundEnd = true;
+                size = pos - jpegBuffer + MARKER_LENGTH;
+                break;
+            }
+            pos++;
         }
     }
     if (!foundEnd) {
@@ -50,7 +50,11 @@ StreamingProcessor::StreamingProcessor(sp<Camera2Client> client):
         mRecordingStreamId(NO_STREAM),
         mRecordingFrameAvailable(false),
         mRecordingHeapCount(kDefaultRecordingHeapCount),
-        mRecordingHeapFree(kDefaultRecordingHeapCount)
+        mRecordingHeapFree(kDefaultRecordingHeapCount),
+        mRecordingReleasedCount(0),
+        mRecordingDroppedCount(0),
+        mRecordingHoldTotal(0),
+        mRecordingHoldMax(0)
 {
 }
 
@@ -680,21 +684,35 @@ status_t StreamingProcessor::processRecordingFrame() {
             mRecordingBuffers.clear();
             mRecordingBuffers.setCapacity(mRecordingHeapCount);
             mRecordingBuffers.insertAt(0, mRecordingHeapCount);
+            mRecordingSendTimes.clear();
+            mRecordingSendTimes.insertAt(0, 0, mRecordingHeapCount);
 
             mRecordingHeapHead = 0;
             mRecordingHeapFree = mRecordingHeapCount;
+            mRecordingReleasedCount = 0;
+            mRecordingDroppedCount = 0;
+            mRecordingHoldTotal = 0;
+            mRecordingHoldMax = 0;
         }
 
         if ( mRecordingHeapFree == 0) {
             ALOGE("%s: Camera %d: No free recording buffers, dropping frame",
                     __FUNCTION__, mId);
+            mRecordingDroppedCount++;
             mRecordingConsumer->releaseBuffer(imgBuffer);
             return NO_MEMORY;
         }
 
+        // The encoder may release frames out of order, so skip any slot
+        // still held; reusing it would lose track of that buffer for good.
         heapIdx = mRecordingHeapHead;
-        mRecordingHeapHead = (mRecordingHeapHead + 1) % mRecordingHeapCount;
+        while (mRecordingBuffers[heapIdx].mBuf !=
+                BufferItemConsumer::INVALID_BUFFER_SLOT) {
+            heapIdx = (heapIdx + 1) % mRecordingHeapCount;
+        }
+        mRecordingHeapHead = (heapIdx + 1) % mRecordingHeapCount;
         mRecordingHeapFree--;
+        mRecordingSendTimes.editItemAt(heapIdx) = systemTime();
 
         ALOGVV("%s: Camera %d: Timestamp %lld",
                 __FUNCTION__, mId, timestamp);
@@ -785,6 +803,13 @@ void StreamingProcessor::releaseRecordingFrame(const sp<IMemory>& mem) {
     }
     mRecordingBuffers.replaceAt(itemIndex);
 
+    nsecs_t holdTime = systemTime() - mRecordingSendTimes[itemIndex];
+    mRecordingReleasedCount++;
+    mRecordingHoldTotal += holdTime;
+    if (holdTime > mRecordingHoldMax) {
+        mRecordingHoldMax = holdTime;
+    }
+
     mRecordingHeapFree++;
     ALOGV_IF(mRecordingHeapFree == mRecordingHeapCount,
             "%s: Camera %d: All %d recording buffers returned",
@@ -869,6 +894,17 @@ status_t StreamingProcessor::dump(int fd, const Vector<String16>& /*args*/) {
     result.append(String8::format("   Active request: %s (paused: %s)\n",
                                   streamTypeString[mActiveRequest],
                                   mPaused ? "yes" : "no"));
+    result.append(String8::format("   Recording buffers: %d of %d free, "
+                                  "%d frames dropped with none free\n",
+                                  mRecordingHeapFree, mRecordingHeapCount,
+                                  mRecordingDroppedCount));
+    result.append(String8::format("   Recording buffer hold time: "
+                                  "avg %.1f ms, max %.1f ms over %d frames\n",
+                                  mRecordingReleasedCount > 0 ?
+                                  mRecordingHoldTotal / 1e6 /
+                                  mRecordingReleasedCount : 0.0,
+                                  mRecordingHoldMax / 1e6,
+                                  mRecordingReleasedCount));
 
     write(fd, result.string(), result.size());
 
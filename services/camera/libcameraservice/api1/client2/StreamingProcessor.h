@@ -124,6 +124,13 @@ class StreamingProcessor:
     Vector<BufferItemConsumer::BufferItem> mRecordingBuffers;
     size_t mRecordingHeapHead, mRecordingHeapFree;
 
+    // How long the encoder holds recording buffers, and how often it held
+    // all of them when a new frame arrived
+    Vector<nsecs_t> mRecordingSendTimes;
+    int mRecordingReleasedCount;
+    int mRecordingDroppedCount;
+    nsecs_t mRecordingHoldTotal, mRecordingHoldMax;
+
     virtual bool threadLoop();
 
     status_t processRecordingFrame();
@@ -25,6 +25,9 @@
 #define ALOGVV(...) ((void)0)
 #endif
 
+#include <stdlib.h>
+
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
 #include <gui/Surface.h>
@@ -133,7 +136,8 @@ status_t ZslProcessor3::updateStream(const Parameters &params) {
         // Note that format specified internally in Camera3ZslStream
         res = device->createZslStream(
                 params.fastInfo.arrayWidth, params.fastInfo.arrayHeight,
-                kZslBufferDepth,
+                getZslBufferDepth(params.fastInfo.arrayWidth,
+                        params.fastInfo.arrayHeight),
                 &mZslStreamId,
                 &mZslStream);
         if (res != OK) {
@@ -150,6 +154,33 @@ status_t ZslProcessor3::updateStream(const Parameters &params) {
     return OK;
 }
 
+size_t ZslProcessor3::getZslBufferDepth(int32_t width, int32_t height) {
+    // The ring holds full sensor size frames, so bound its memory rather
+    // than its depth; assume 12 bits per pixel for the implementation
+    // defined format.
+    char value[PROPERTY_VALUE_MAX];
+    property_get("camera.zsl.max_memory_mb", value, "");
+    size_t budgetMb = kDefaultZslMemoryMb;
+    if (value[0] != '\0') {
+        budgetMb = atoi(value);
+    }
+
+    size_t bufferSize = (size_t)width * height * 3 / 2;
+    size_t depth = kZslBufferDepth;
+    if (bufferSize > 0) {
+        depth = (budgetMb << 20) / bufferSize;
+    }
+
+    if (depth > kZslBufferDepth) {
+        depth = kZslBufferDepth;
+    } else if (depth < kMinZslBufferDepth) {
+        depth = kMinZslBufferDepth;
+    }
+
+    ALOGV("%s: %d x %d, ZSL depth %zu", __FUNCTION__, width, height, depth);
+    return depth;
+}
+
 status_t ZslProcessor3::deleteStream() {
     ATRACE_CALL();
     status_t res;
@@ -108,6 +108,11 @@ class ZslProcessor3 :
     };
 
     static const size_t kZslBufferDepth = 4;
+    // Fewest buffers the ZSL ring is shrunk to for large sensors
+    static const size_t kMinZslBufferDepth = 2;
+    // Default memory budget for the ZSL ring, camera.zsl.max_memory_mb
+    static const size_t kDefaultZslMemoryMb = 48;
+    static size_t getZslBufferDepth(int32_t width, int32_t height);
     static const size_t kFrameListDepth = kZslBufferDepth * 2;
     Vector<CameraMetadata> mFrameList;
     size_t mFrameListHead;
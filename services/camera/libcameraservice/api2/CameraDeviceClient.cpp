@@ -347,8 +347,9 @@ status_t CameraDeviceClient::createStream(int width, int height, int format,
     int streamId = -1;
     if (format == HAL_PIXEL_FORMAT_BLOB) {
         // JPEG buffers need to be sized for maximum possible compressed size
-        CameraMetadata staticInfo = mDevice->info();
-        camera_metadata_entry_t entry = staticInfo.find(ANDROID_JPEG_MAX_SIZE);
+        const CameraMetadata& staticInfo = mDevice->info();
+        camera_metadata_ro_entry_t entry =
+                staticInfo.find(ANDROID_JPEG_MAX_SIZE);
         if (entry.count == 0) {
             ALOGE("%s: Camera %d: Can't find maximum JPEG size in "
                     "static metadata!", __FUNCTION__, mCameraId);
@@ -575,10 +576,11 @@ bool CameraDeviceClient::enforceRequestPermissions(CameraMetadata& metadata) {
      * Mixin default important security values
      * - android.led.transmit = defaulted ON
      */
-    CameraMetadata staticInfo = mDevice->info();
-    entry = staticInfo.find(ANDROID_LED_AVAILABLE_LEDS);
-    for(size_t i = 0; i < entry.count; ++i) {
-        uint8_t led = entry.data.u8[i];
+    const CameraMetadata& staticInfo = mDevice->info();
+    camera_metadata_ro_entry_t leds =
+            staticInfo.find(ANDROID_LED_AVAILABLE_LEDS);
+    for(size_t i = 0; i < leds.count; ++i) {
+        uint8_t led = leds.data.u8[i];
 
         switch(led) {
             case ANDROID_LED_AVAILABLE_LEDS_TRANSMIT: {
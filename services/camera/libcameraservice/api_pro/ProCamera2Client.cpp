@@ -383,11 +383,14 @@ void ProCamera2Client::onFrameAvailable(int32_t requestId,
     SharedCameraCallbacks::Lock l(mSharedCameraCallbacks);
 
     if (mRemoteCallback != NULL) {
-        CameraMetadata tmp(frame);
-        camera_metadata_t* meta = tmp.release();
+        // The proxy only parcels the result, so lend it the frame's buffer
+        // rather than cloning every result just to drop the const.
+        CameraMetadata &tmp = const_cast<CameraMetadata&>(frame);
+        const camera_metadata_t* meta = tmp.getAndLock();
         ALOGV("%s: meta = %p ", __FUNCTION__, meta);
-        mRemoteCallback->onResultReceived(requestId, meta);
-        tmp.acquire(meta);
+        mRemoteCallback->onResultReceived(requestId,
+                const_cast<camera_metadata_t*>(meta));
+        tmp.unlock(meta);
     }
 
 }
@@ -838,6 +838,9 @@ status_t Camera3Device::deleteStream(int id) {
         mOutputStreams.removeItem(id);
     }
 
+    // A disconnected stream must not be finished by the request thread
+    mRequestThread->removeUnfinishedStream(deletedStream);
+
     // Free up the stream endpoint so that it can be used by some other stream
     res = deletedStream->disconnect();
     if (res != OK) {
@@ -1203,13 +1206,11 @@ sp<Camera3Device::CaptureRequest> Camera3Device::createCaptureRequest(
 
         // Lazy completion of stream configuration (allocation/registration)
         // on first use
-        if (stream->isConfiguring()) {
-            res = stream->finishConfiguration(mHal3Device);
-            if (res != OK) {
-                SET_ERR_L("Unable to finish configuring stream %d: %s (%d)",
-                        stream->getId(), strerror(-res), res);
-                return NULL;
-            }
+        res = mRequestThread->finishStreamConfiguration(stream);
+        if (res != OK) {
+            SET_ERR_L("Unable to finish configuring stream %d: %s (%d)",
+                    stream->getId(), strerror(-res), res);
+            return NULL;
         }
 
         newRequest->mOutputStreams.push(stream);
@@ -1286,9 +1287,10 @@ status_t Camera3Device::configureStreamsLocked() {
         return res;
     }
 
-    // Finish all stream configuration immediately.
-    // TODO: Try to relax this later back to lazy completion, which should be
-    // faster
+    // Finish the input stream configuration immediately, the output streams
+    // are finished by the request thread; either when a request first uses
+    // them, or in between requests so that buffers are still allocated ahead
+    // of the first capture.
 
     if (mInputStream != NULL && mInputStream->isConfiguring()) {
         res = mInputStream->finishConfiguration(mHal3Device);
@@ -1299,22 +1301,18 @@ status_t Camera3Device::configureStreamsLocked() {
         }
     }
 
+    Vector<sp<Camera3OutputStreamInterface> > unfinishedStreams;
     for (size_t i = 0; i < mOutputStreams.size(); i++) {
         sp<Camera3OutputStreamInterface> outputStream =
             mOutputStreams.editValueAt(i);
         if (outputStream->isConfiguring()) {
-            res = outputStream->finishConfiguration(mHal3Device);
-            if (res != OK) {
-                SET_ERR_L("Can't finish configuring output stream %d: %s (%d)",
-                        outputStream->getId(), strerror(-res), res);
-                return res;
-            }
+            unfinishedStreams.push(outputStream);
         }
     }
 
     // Request thread needs to know to avoid using repeat-last-settings protocol
     // across configure_streams() calls
-    mRequestThread->configurationComplete();
+    mRequestThread->configurationComplete(unfinishedStreams);
 
     // Update device state
 
@@ -1457,21 +1455,11 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
 
     }
 
-    // Process the result metadata, if provided
+    // Process the result metadata, if provided. The metadata is cloned and
+    // checked before taking mOutputLock, so that the HAL callback threads
+    // don't hold up result consumers and shutter notifications with it.
     if (result->result != NULL) {
-        Mutex::Autolock l(mOutputLock);
-
-        if (frameNumber != mNextResultFrameNumber) {
-            SET_ERR("Out-of-order capture result metadata submitted! "
-                    "(got frame number %d, expecting %d)",
-                    frameNumber, mNextResultFrameNumber);
-            return;
-        }
-        mNextResultFrameNumber++;
-
-        CameraMetadata &captureResult =
-                *mResultQueue.insert(mResultQueue.end(), CameraMetadata());
-
+        CameraMetadata captureResult;
         captureResult = result->result;
         if (captureResult.update(ANDROID_REQUEST_FRAME_COUNT,
                         (int32_t*)&frameNumber, 1) != OK) {
@@ -1494,6 +1482,19 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
                     " metadata for frame %d (%lld vs %lld respectively)",
                     frameNumber, timestamp, entry.data.i64[0]);
         }
+
+        Mutex::Autolock l(mOutputLock);
+
+        if (frameNumber != mNextResultFrameNumber) {
+            SET_ERR("Out-of-order capture result metadata submitted! "
+                    "(got frame number %d, expecting %d)",
+                    frameNumber, mNextResultFrameNumber);
+            return;
+        }
+        mNextResultFrameNumber++;
+
+        mResultQueue.insert(mResultQueue.end(), CameraMetadata())->acquire(
+                captureResult);
     } // scope for mOutputLock
 
     // Return completed buffers to their streams with the timestamp
@@ -1641,11 +1642,60 @@ Camera3Device::RequestThread::RequestThread(wp<Camera3Device> parent,
     mStatusId = statusTracker->addComponent();
 }
 
-void Camera3Device::RequestThread::configurationComplete() {
+void Camera3Device::RequestThread::configurationComplete(
+        const Vector<sp<Camera3OutputStreamInterface> > &unfinishedStreams) {
+    {
+        Mutex::Autolock l(mStreamConfigLock);
+        mUnfinishedStreams = unfinishedStreams;
+    }
     Mutex::Autolock l(mRequestLock);
     mReconfigured = true;
 }
 
+status_t Camera3Device::RequestThread::finishStreamConfiguration(
+        const sp<Camera3OutputStreamInterface> &stream) {
+    Mutex::Autolock l(mStreamConfigLock);
+    for (size_t i = 0; i < mUnfinishedStreams.size(); i++) {
+        if (mUnfinishedStreams[i] == stream) {
+            mUnfinishedStreams.removeAt(i);
+            break;
+        }
+    }
+
+    if (!stream->isConfiguring()) {
+        return OK;
+    }
+    return stream->finishConfiguration(mHal3Device);
+}
+
+void Camera3Device::RequestThread::removeUnfinishedStream(
+        const sp<Camera3StreamInterface> &stream) {
+    Mutex::Autolock l(mStreamConfigLock);
+    for (size_t i = 0; i < mUnfinishedStreams.size(); i++) {
+        if (mUnfinishedStreams[i] == stream) {
+            mUnfinishedStreams.removeAt(i);
+            break;
+        }
+    }
+}
+
+void Camera3Device::RequestThread::finishUnfinishedStream() {
+    sp<Camera3OutputStreamInterface> stream;
+    {
+        Mutex::Autolock l(mStreamConfigLock);
+        if (mUnfinishedStreams.isEmpty()) {
+            return;
+        }
+        stream = mUnfinishedStreams[0];
+    }
+
+    status_t res = finishStreamConfiguration(stream);
+    if (res != OK) {
+        SET_ERR("RequestThread: Unable to finish configuring stream %d:"
+                " %s (%d)", stream->getId(), strerror(-res), res);
+    }
+}
+
 status_t Camera3Device::RequestThread::queueRequest(
          sp<CaptureRequest> request) {
     Mutex::Autolock l(mRequestLock);
@@ -1834,6 +1884,17 @@ bool Camera3Device::RequestThread::threadLoop() {
          *   are O(logn). Sidenote, sorting a sorted metadata is nop.
          */
         nextRequest->mSettings.sort();
+    }
+
+    if (mPrevRequest != nextRequest && !triggersMixedIn &&
+            hasSameSettingsAsPrevRequest(nextRequest)) {
+        // Burst and high speed repeating lists cycle through requests that
+        // only differ in their buffers; spare the HAL from parsing the
+        // settings again, and us from cloning them into mLatestRequest.
+        mPrevRequest = nextRequest;
+        ALOGVV("%s: Request settings are the same as last, REUSED",
+               __FUNCTION__);
+    } else if (mPrevRequest != nextRequest || triggersMixedIn) {
         request.settings = nextRequest->mSettings.getAndLock();
         mPrevRequest = nextRequest;
         ALOGVV("%s: Request settings are NEW", __FUNCTION__);
@@ -1879,6 +1940,16 @@ bool Camera3Device::RequestThread::threadLoop() {
             nextRequest->mOutputStreams.size());
     request.output_buffers = outputBuffers.array();
     for (size_t i = 0; i < nextRequest->mOutputStreams.size(); i++) {
+        // Repeating requests may refer to streams reconfigured since they
+        // were created
+        res = finishStreamConfiguration(nextRequest->mOutputStreams[i]);
+        if (res != OK) {
+            SET_ERR("RequestThread: Unable to finish configuring stream %d:"
+                    " %s (%d)", nextRequest->mOutputStreams[i]->getId(),
+                    strerror(-res), res);
+            cleanUpFailedRequest(request, nextRequest, outputBuffers);
+            return false;
+        }
         res = nextRequest->mOutputStreams.editItemAt(i)->
                 getBuffer(&outputBuffers.editItemAt(i));
         if (res != OK) {
@@ -1967,9 +2038,46 @@ bool Camera3Device::RequestThread::threadLoop() {
         }
     }
 
+    // Allocate the buffers of one stream not in use yet while the HAL works
+    // on this request, to keep that off the first capture using it
+    finishUnfinishedStream();
+
     return true;
 }
 
+bool Camera3Device::RequestThread::hasSameSettingsAsPrevRequest(
+        const sp<CaptureRequest> &request) {
+    if (mPrevRequest == NULL || mPrevRequest == request ||
+            mPrevRequest->mSettings.entryCount() !=
+            request->mSettings.entryCount()) {
+        return false;
+    }
+
+    // Both are sorted, so identical settings list the same entries in the
+    // same order.
+    const camera_metadata_t *prev = mPrevRequest->mSettings.getAndLock();
+    const camera_metadata_t *next = request->mSettings.getAndLock();
+
+    bool same = true;
+    size_t count = get_camera_metadata_entry_count(next);
+    for (size_t i = 0; same && i < count; i++) {
+        camera_metadata_ro_entry_t a, b;
+        if (get_camera_metadata_ro_entry(prev, i, &a) != OK ||
+                get_camera_metadata_ro_entry(next, i, &b) != OK) {
+            same = false;
+            break;
+        }
+        same = a.tag == b.tag && a.type == b.type && a.count == b.count &&
+                !memcmp(a.data.u8, b.data.u8,
+                        a.count * camera_metadata_type_size[a.type]);
+    }
+
+    mPrevRequest->mSettings.unlock(prev);
+    request->mSettings.unlock(next);
+
+    return same;
+}
+
 CameraMetadata Camera3Device::RequestThread::getLatestRequest() const {
     Mutex::Autolock al(mLatestRequestMutex);
 
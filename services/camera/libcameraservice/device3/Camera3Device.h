@@ -296,9 +296,28 @@ class Camera3Device :
                 camera3_device_t *hal3Device);
 
         /**
-         * Call after stream (re)-configuration is completed.
+         * Call after stream (re)-configuration is completed. The given
+         * output streams still have to finish their configuration; the
+         * thread does that when a request first uses one, or in between
+         * requests otherwise.
          */
-        void     configurationComplete();
+        void     configurationComplete(
+                const Vector<sp<camera3::Camera3OutputStreamInterface> >
+                        &unfinishedStreams);
+
+        /**
+         * Finish configuring an output stream if still needed. Safe to call
+         * from any thread.
+         */
+        status_t finishStreamConfiguration(
+                const sp<camera3::Camera3OutputStreamInterface> &stream);
+
+        /**
+         * Forget about a stream to be finished, e.g. when it is deleted
+         * before its first use.
+         */
+        void     removeUnfinishedStream(
+                const sp<camera3::Camera3StreamInterface> &stream);
 
         /**
          * Set or clear the list of repeating requests. Does not block
@@ -364,10 +383,18 @@ class Camera3Device :
         //  restoring the old field values for those tags.
         status_t           removeTriggers(const sp<CaptureRequest> &request);
 
+        // Finish configuring one stream not used by requests so far
+        void               finishUnfinishedStream();
+
         // HAL workaround: Make sure a trigger ID always exists if
         // a trigger does
         status_t          addDummyTriggerIds(const sp<CaptureRequest> &request);
 
+        // True if the request's settings are identical to those of
+        // mPrevRequest, so the HAL can be told to reuse them
+        bool               hasSameSettingsAsPrevRequest(
+                const sp<CaptureRequest> &request);
+
         static const nsecs_t kRequestTimeout = 50e6; // 50 ms
 
         // Waits for a request, or returns NULL if times out.
@@ -402,6 +429,10 @@ class Camera3Device :
         RequestList        mRepeatingRequests;
 
         bool               mReconfigured;
+        // Output streams that haven't finished configuring yet; the lock
+        // also serializes finishing a stream between threads
+        Mutex              mStreamConfigLock;
+        Vector<sp<camera3::Camera3OutputStreamInterface> > mUnfinishedStreams;
 
         // Used by waitIfPaused, waitForNextRequest, and waitUntilPaused
         Mutex              mPauseLock;
@@ -21,6 +21,8 @@
 // This is needed for stdint.h to define INT64_MAX in C++
 #define __STDC_LIMIT_MACROS
 
+#include <string.h>
+
 #include <utils/Log.h>
 #include <utils/Trace.h>
 #include "device3/Camera3IOStreamBase.h"
@@ -37,7 +39,9 @@ Camera3IOStreamBase::Camera3IOStreamBase(int id, camera3_stream_type_t type,
         mTotalBufferCount(0),
         mDequeuedBufferCount(0),
         mFrameCount(0),
-        mLastTimestamp(0) {
+        mLastTimestamp(0),
+        mHalBuffersTraceName(String8::format("cam3 stream %d HAL buffers",
+                id)) {
 
     mCombinedFence = new Fence();
 
@@ -77,9 +81,54 @@ void Camera3IOStreamBase::dump(int fd, const Vector<String16> &args) const {
             mFrameCount, mLastTimestamp);
     lines.appendFormat("      Total buffers: %d, currently dequeued: %d\n",
             mTotalBufferCount, mDequeuedBufferCount);
+    lines.appendFormat("      Latency (ms):     ");
+    for (size_t i = 0; i + 1 < LatencyHistogram::kNumBuckets; i++) {
+        lines.appendFormat(" <%-5d", 1 << i);
+    }
+    lines.appendFormat(" >=%-4d   avg    max\n",
+            1 << (LatencyHistogram::kNumBuckets - 2));
+    mDequeueWait.dump(&lines, "Dequeue wait");
+    mHalTime.dump(&lines, "In HAL");
+    mQueueTime.dump(&lines, "Queue to consumer");
     write(fd, lines.string(), lines.size());
 }
 
+Camera3IOStreamBase::LatencyHistogram::LatencyHistogram() :
+        mSamples(0),
+        mTotal(0),
+        mMax(0) {
+    memset(mCounts, 0, sizeof(mCounts));
+}
+
+void Camera3IOStreamBase::LatencyHistogram::add(nsecs_t latency) {
+    size_t bucket = 0;
+    nsecs_t bound = 1000000;
+    while (bucket + 1 < kNumBuckets && latency >= bound) {
+        bucket++;
+        bound *= 2;
+    }
+    mCounts[bucket]++;
+    mSamples++;
+    mTotal += latency;
+    if (latency > mMax) {
+        mMax = latency;
+    }
+}
+
+void Camera3IOStreamBase::LatencyHistogram::dump(String8 *lines,
+        const char *name) const {
+    lines->appendFormat("        %-18s", name);
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        lines->appendFormat(" %-6u", mCounts[i]);
+    }
+    lines->appendFormat(" %6.2f %6.2f\n",
+            mSamples > 0 ? mTotal / 1e6 / mSamples : 0.0, mMax / 1e6);
+}
+
+bool Camera3IOStreamBase::isStreamingLocked() const {
+    return mState == STATE_CONFIGURED;
+}
+
 status_t Camera3IOStreamBase::configureQueueLocked() {
     status_t res;
 
@@ -153,6 +202,11 @@ void Camera3IOStreamBase::handoutBufferLocked(camera3_stream_buffer &buffer,
         }
     }
     mDequeuedBufferCount++;
+
+    if (isStreamingLocked()) {
+        mHandoutTimes.add(handle, systemTime());
+        ATRACE_INT(mHalBuffersTraceName.string(), mDequeuedBufferCount);
+    }
 }
 
 status_t Camera3IOStreamBase::getBufferPreconditionCheckLocked() const {
@@ -223,6 +277,14 @@ status_t Camera3IOStreamBase::returnAnyBufferLocked(
     }
 
     mDequeuedBufferCount--;
+
+    ssize_t idx = mHandoutTimes.indexOfKey(buffer.buffer);
+    if (idx >= 0) {
+        mHalTime.add(systemTime() - mHandoutTimes.valueAt(idx));
+        mHandoutTimes.removeItemsAt(idx);
+        ATRACE_INT(mHalBuffersTraceName.string(), mDequeuedBufferCount);
+    }
+
     if (mDequeuedBufferCount == 0 && mState != STATE_IN_CONFIG &&
             mState != STATE_IN_RECONFIG) {
         ALOGV("%s: Stream %d: All buffers returned; now idle", __FUNCTION__,
@@ -18,6 +18,7 @@
 #define ANDROID_SERVERS_CAMERA3_IO_STREAM_BASE_H
 
 #include <utils/RefBase.h>
+#include <utils/KeyedVector.h>
 #include <gui/Surface.h>
 
 #include "Camera3Stream.h"
@@ -57,6 +58,37 @@ class Camera3IOStreamBase :
     // The merged release fence for all returned buffers
     sp<Fence>         mCombinedFence;
 
+    /**
+     * Latency distribution for dumpsys; bucket i counts the samples below
+     * 2^i ms and the last one everything slower.
+     */
+    struct LatencyHistogram {
+        static const size_t kNumBuckets = 8;
+
+        LatencyHistogram();
+        void         add(nsecs_t latency);
+        void         dump(String8 *lines, const char *name) const;
+
+        uint32_t     mCounts[kNumBuckets];
+        uint32_t     mSamples;
+        nsecs_t      mTotal;
+        nsecs_t      mMax;
+    };
+
+    // Time the consumer took to hand us a buffer
+    LatencyHistogram  mDequeueWait;
+    // Time from handing a buffer to the HAL until the HAL returned it
+    LatencyHistogram  mHalTime;
+    // Time to return a filled buffer to the consumer
+    LatencyHistogram  mQueueTime;
+    // When each buffer held by the HAL was handed out
+    KeyedVector<buffer_handle_t*, nsecs_t> mHandoutTimes;
+    // Counter name for the buffers held by the HAL in systrace
+    const String8     mHalBuffersTraceName;
+
+    // Whether buffers are moving for captures, not for registration
+    bool             isStreamingLocked() const;
+
     status_t         returnAnyBufferLocked(
             const camera3_stream_buffer &buffer,
             nsecs_t timestamp,
@@ -106,8 +106,12 @@ status_t Camera3OutputStream::getBufferLocked(camera3_stream_buffer *buffer) {
     sp<ANativeWindow> currentConsumer = mConsumer;
     mLock.unlock();
 
+    nsecs_t dequeueStart = systemTime();
     res = currentConsumer->dequeueBuffer(currentConsumer.get(), &anb, &fenceFd);
     mLock.lock();
+    if (res == OK && isStreamingLocked()) {
+        mDequeueWait.add(systemTime() - dequeueStart);
+    }
     if (res != OK) {
         ALOGE("%s: Stream %d: Can't dequeue next output buffer: %s (%d)",
                 __FUNCTION__, mId, strerror(-res), res);
@@ -189,6 +193,8 @@ status_t Camera3OutputStream::returnBufferCheckedLocked(
     sp<ANativeWindow> currentConsumer = mConsumer;
     mLock.unlock();
 
+    nsecs_t queueStart = systemTime();
+
     /**
      * Return buffer back to ANativeWindow
      */
@@ -213,6 +219,9 @@ status_t Camera3OutputStream::returnBufferCheckedLocked(
     mLock.lock();
     if (res != OK) {
         close(anwReleaseFence);
+    } else if (buffer.status != CAMERA3_BUFFER_STATUS_ERROR &&
+            isStreamingLocked()) {
+        mQueueTime.add(systemTime() - queueStart);
     }
 
     *releaseFenceOut = releaseFence;
@@ -17,7 +17,13 @@
 #define LOG_TAG "MediaLog"
 //#define LOG_NDEBUG 0
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
 #include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <binder/PermissionCache.h>
 #include <media/nbaio/NBLog.h>
@@ -26,6 +32,17 @@
 
 namespace android {
 
+static const char kStreamDir[] = "/data/misc/media";
+
+void MediaLogService::onFirstRef()
+{
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("persist.media.log.stream", value, "0") > 0 && atoi(value) == 1) {
+        mStreamThread = new StreamThread(this);
+        mStreamThread->run("MediaLogStream", PRIORITY_BACKGROUND);
+    }
+}
+
 void MediaLogService::registerWriter(const sp<IMemory>& shared, size_t size, const char *name)
 {
     if (IPCThreadState::self()->getCallingUid() != AID_MEDIA || shared == 0 ||
@@ -34,8 +51,8 @@ void MediaLogService::registerWriter(const sp<IMemory>& shared, size_t size, con
         return;
     }
     sp<NBLog::Reader> reader(new NBLog::Reader(size, shared));
-    NamedReader namedReader(reader, name);
     Mutex::Autolock _l(mLock);
+    NamedReader namedReader(reader, name, mNextId++);
     mNamedReaders.add(namedReader);
 }
 
@@ -80,6 +97,9 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args)
         }
         namedReader.reader()->dump(fd, 0 /*indent*/);
     }
+    if (mStreamThread != 0) {
+        mStreamThread->dump(fd);
+    }
     return NO_ERROR;
 }
 
@@ -89,4 +109,115 @@ status_t MediaLogService::onTransact(uint32_t code, const Parcel& data, Parcel*
     return BnMediaLogService::onTransact(code, data, reply, flags);
 }
 
+// ----------------------------------------------------------------------------
+
+MediaLogService::StreamThread::StreamThread(MediaLogService *service)
+    : Thread(false /*canCallJava*/), mService(service), mBuffer(new uint8_t[kMaxSize]),
+      mFd(-1), mFileIndex(kStreamFiles - 1), mFileSize(0), mBytesWritten(0), mBytesLost(0)
+{
+}
+
+MediaLogService::StreamThread::~StreamThread()
+{
+    if (mFd >= 0) {
+        close(mFd);
+    }
+    delete[] mBuffer;
+}
+
+bool MediaLogService::StreamThread::threadLoop()
+{
+    usleep(kStreamPeriodMs * 1000);
+    Vector<NamedReader> namedReaders;
+    {
+        Mutex::Autolock _l(mService->mLock);
+        namedReaders = mService->mNamedReaders;
+    }
+    for (size_t i = 0; i < namedReaders.size(); i++) {
+        drain(namedReaders[i]);
+    }
+    // forget the sequence numbers of writers that have been unregistered
+    for (size_t i = 0; i < mSequences.size(); ) {
+        size_t j;
+        for (j = 0; j < namedReaders.size(); j++) {
+            if (namedReaders[j].id() == mSequences.keyAt(i)) {
+                break;
+            }
+        }
+        if (j == namedReaders.size()) {
+            mSequences.removeItemsAt(i);
+        } else {
+            i++;
+        }
+    }
+    return true;
+}
+
+void MediaLogService::StreamThread::drain(const NamedReader& namedReader)
+{
+    StreamRecord record;
+    size_t lost;
+    size_t length = namedReader.reader()->drain(mBuffer, kMaxSize, &record.mPosition, &lost);
+    if (length == 0 && lost == 0) {
+        return;
+    }
+    // the sequence number advances even if the record can't be written, to reveal the gap
+    ssize_t index = mSequences.indexOfKey(namedReader.id());
+    if (index < 0) {
+        index = mSequences.add(namedReader.id(), 0);
+    }
+    record.mSequence = mSequences.valueAt(index);
+    mSequences.editValueAt(index)++;
+    mBytesLost += lost;
+    if ((mFd < 0 || mFileSize + sizeof(record) + length > kStreamFileSize) && !openFile()) {
+        mBytesLost += length;
+        return;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    record.mMagic = kStreamMagic;
+    record.mWriter = namedReader.id();
+    record.mLost = lost;
+    record.mLength = length;
+    record.mTimeNs = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    memset(record.mName, 0, sizeof(record.mName));
+    strlcpy(record.mName, namedReader.name(), sizeof(record.mName));
+    // A short write leaves a truncated record at the end of the file, which the decoder
+    // detects by its length.  The next record goes to the next file.
+    if (write(mFd, &record, sizeof(record)) != (ssize_t) sizeof(record) ||
+            (length > 0 && write(mFd, mBuffer, length) != (ssize_t) length)) {
+        ALOGW("write to stream file failed: %s", strerror(errno));
+        close(mFd);
+        mFd = -1;
+        mBytesLost += length;
+        return;
+    }
+    mFileSize += sizeof(record) + length;
+    mBytesWritten += sizeof(record) + length;
+}
+
+bool MediaLogService::StreamThread::openFile()
+{
+    if (mFd >= 0) {
+        close(mFd);
+    }
+    mFileIndex = (mFileIndex + 1) % kStreamFiles;
+    mFileSize = 0;
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/medialog.%u", kStreamDir, mFileIndex);
+    mFd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+    if (mFd < 0) {
+        ALOGW("can't open stream file %s: %s", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void MediaLogService::StreamThread::dump(int fd)
+{
+    fdprintf(fd, "\nStreaming to %s/medialog.%u: %llu bytes written, %llu bytes lost\n",
+            kStreamDir, mFileIndex, (unsigned long long) mBytesWritten,
+            (unsigned long long) mBytesLost);
+}
+
 }   // namespace android
@@ -20,6 +20,8 @@
 #include <binder/BinderService.h>
 #include <media/IMediaLogService.h>
 #include <media/nbaio/NBLog.h>
+#include <utils/KeyedVector.h>
+#include <utils/Thread.h>
 
 namespace android {
 
@@ -27,14 +29,35 @@ class MediaLogService : public BinderService<MediaLogService>, public BnMediaLog
 {
     friend class BinderService<MediaLogService>;    // for MediaLogService()
 public:
-    MediaLogService() : BnMediaLogService() { }
+    MediaLogService() : BnMediaLogService(), mNextId(1) { }
     virtual ~MediaLogService() { }
-    virtual void onFirstRef() { }
+    virtual void onFirstRef();
 
     static const char*  getServiceName() { return "media.log"; }
 
     static const size_t kMinSize = 0x100;
     static const size_t kMaxSize = 0x10000;
+
+    // Streaming mode is enabled by setting property persist.media.log.stream to 1.
+    // Every kStreamPeriodMs, the raw entries of each registered writer are drained into a set
+    // of kStreamFiles rotating files in kStreamDir, each at most kStreamFileSize bytes.
+    // A file is a sequence of StreamRecords, each followed by mLength bytes of raw NBLog
+    // entries as laid out in shared memory, which can be decoded offline like NBLog::Reader.
+    static const uint32_t kStreamPeriodMs = 200;
+    static const size_t kStreamFiles = 4;
+    static const size_t kStreamFileSize = 16 * 1024 * 1024;
+
+    struct StreamRecord {
+        uint32_t    mMagic;         // kStreamMagic
+        uint32_t    mWriter;        // unique ID of the writer, assigned at registerWriter
+        uint32_t    mSequence;      // per-writer record number, a gap means records were lost
+        uint32_t    mPosition;      // writer's buffer index of the first byte that follows
+        uint32_t    mLost;          // bytes overwritten by the writer before they were drained
+        uint32_t    mLength;        // bytes of raw entries that follow
+        int64_t     mTimeNs;        // CLOCK_REALTIME when the record was drained
+        char        mName[32];      // writer name, NUL-terminated
+    };
+    static const uint32_t kStreamMagic = 0x474c4f4e;    // 'NOLG'
     virtual void        registerWriter(const sp<IMemory>& shared, size_t size, const char *name);
     virtual void        unregisterWriter(const sp<IMemory>& shared);
 
@@ -46,18 +69,47 @@ private:
     Mutex               mLock;
     class NamedReader {
     public:
-        NamedReader() : mReader(0) { mName[0] = '\0'; } // for Vector
-        NamedReader(const sp<NBLog::Reader>& reader, const char *name) : mReader(reader)
+        NamedReader() : mReader(0), mId(0) { mName[0] = '\0'; } // for Vector
+        NamedReader(const sp<NBLog::Reader>& reader, const char *name, uint32_t id)
+            : mReader(reader), mId(id)
             { strlcpy(mName, name, sizeof(mName)); }
         ~NamedReader() { }
         const sp<NBLog::Reader>&  reader() const { return mReader; }
         const char*               name() const { return mName; }
+        uint32_t                  id() const { return mId; }
     private:
         sp<NBLog::Reader>   mReader;
         static const size_t kMaxName = 32;
         char                mName[kMaxName];
+        uint32_t            mId;
     };
     Vector<NamedReader> mNamedReaders;
+    uint32_t            mNextId;        // next writer ID
+
+    // Periodically drains all readers into the rotating stream files
+    class StreamThread : public Thread {
+    public:
+        StreamThread(MediaLogService *service);
+        virtual ~StreamThread();
+
+        void                dump(int fd);
+
+    private:
+        virtual bool        threadLoop();
+        void                drain(const NamedReader& namedReader);
+        bool                openFile();
+
+        MediaLogService* const mService;
+        uint8_t*            mBuffer;        // kMaxSize bytes of drained entries
+        int                 mFd;            // current stream file, or -1
+        size_t              mFileIndex;     // index of current stream file
+        size_t              mFileSize;      // bytes written to current stream file
+        KeyedVector<uint32_t, uint32_t> mSequences; // next sequence number, by writer ID
+        // statistics, read by dump() without a lock
+        volatile uint64_t   mBytesWritten;
+        volatile uint64_t   mBytesLost;
+    };
+    sp<StreamThread>    mStreamThread;  // only if streaming mode is enabled
 };
 
 }   // namespace android